@@ -9,6 +9,7 @@
 #include <stdbool.h>
 #include "pico/stdlib.h"
 #include "hardware/flash.h"
+#include "pico/flash.h"
 #include "pico/bootrom.h"
 #include "wizchip_conf.h"
 // #include "socket.h"             // <-- need separate set_source_files_properties for this to avoid pulling in socket dependency to other targets that include config_efu.h
@@ -17,6 +18,8 @@
 #include "partition.h"
 
 #include "utility.h"
+#include "trace.h"
+#include "dlog.h"
 
 // #define _EFU_DEBUG_
 // size of the CHUNK in python app.
@@ -67,6 +70,26 @@ uint8_t ack[2] = {'O', 'K'};    // write ack
 uint8_t err[2] = {'E', 'R'};    // error nack
 uint8_t crc[2] = {'C', 'C'};    // crc ack
 
+/**
+ * Flash erase/program run through flash_safe_execute(): interrupts are off
+ * and, when the other core runs (e.g. WS2815_CORE1), it is parked in RAM.
+ */
+typedef struct {
+    uint32_t offs;
+    const uint8_t *data;
+    uint32_t len;
+} efu_flash_prog_t;
+
+static void efu_flash_erase(void *param) {
+    (void)param;
+    flash_range_erase(efu_srv.write_addr - XIP_BASE, efu_srv.partition_size);
+}
+
+static void efu_flash_program(void *param) {
+    const efu_flash_prog_t *prog = param;
+    flash_range_program(prog->offs, prog->data, prog->len);
+}
+
 
 uint8_t get_efu_socket_status(void) {
     uint8_t sn = efu_srv.socket;
@@ -139,7 +162,8 @@ void efu_server_poll(void) {
 
         ret = recv(sn, efu_srv.buf, rx_size);
         if (ret <= 0) break;
-        printf("st=%d \trec:%d \tsum=%d\n", efu_srv.state, ret, efu_srv.header_received + ret);
+        TRACE_INSTANT(TR_EFU_RECV, efu_srv.state, (uint32_t)ret);
+        DLOG_EVERY(1000, "st=%d \trec:%d \tsum=%d\n", efu_srv.state, ret, efu_srv.header_received + ret);
 
         consumed = 0;
         // switch(efu_srv.state) {
@@ -216,9 +240,9 @@ void efu_server_poll(void) {
                 efu_srv.write_addr, alt_part->size / 1024);
             #endif
             // Erase alternate partition
-            uint32_t save = save_and_disable_interrupts();
-            flash_range_erase(efu_srv.write_addr - XIP_BASE, efu_srv.partition_size);
-            restore_interrupts(save);
+            TRACE_BEGIN(TR_EFU_ERASE, efu_srv.partition_size, 0);
+            flash_safe_execute(efu_flash_erase, NULL, UINT32_MAX);
+            TRACE_END(TR_EFU_ERASE, efu_srv.partition_size, 0);
             printf("[EFU] Erase done, ret=%d consumed=%d\r\n", ret, consumed);
 
             // Send ACK for header
@@ -233,7 +257,7 @@ void efu_server_poll(void) {
 
             if (consumed > ret) break;
             uint16_t data_len = (typeof(data_len))(ret - consumed);
-            printf("write %d bytes at 0x%08x\n", data_len, flash_offs);
+            DLOG_EVERY(1000, "write %d bytes at 0x%08x\n", data_len, flash_offs);
 
             if (flash_offs + data_len > end) {
                 printf("[EFU] Error: incoming image too large (%lu + %d > %u)\r\n",
@@ -251,9 +275,10 @@ void efu_server_poll(void) {
 
             // printf("[EFU] Programming %d bytes at flash offset 0x%08x\n", data_len, flash_offs);
             // Program flash
-            uint32_t ints = save_and_disable_interrupts();
-            flash_range_program(flash_offs, efu_srv.buf + consumed, (uint32_t)data_len);
-            restore_interrupts(ints);
+            efu_flash_prog_t prog = { flash_offs, efu_srv.buf + consumed, data_len };
+            TRACE_BEGIN(TR_EFU_PROGRAM, data_len, flash_offs);
+            flash_safe_execute(efu_flash_program, &prog, UINT32_MAX);
+            TRACE_END(TR_EFU_PROGRAM, data_len, flash_offs);
 
             efu_srv.total_written += (uint32_t)data_len;
 
@@ -295,6 +320,7 @@ void efu_server_poll(void) {
             printf("[EFU] CRC expected: %08x, calculated: %08x\n",
                 efu_srv.expected_crc, efu_srv.crc_calc);
 
+            TRACE_INSTANT(TR_EFU_CRC, efu_srv.crc_calc == efu_srv.expected_crc, efu_srv.crc_calc);
             if (efu_srv.crc_calc != efu_srv.expected_crc) {
                 printf("[EFU] CRC MISMATCH — update aborted\n");
                 efu_srv.state = EFU_ERROR;
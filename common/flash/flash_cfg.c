@@ -10,17 +10,20 @@
 #include "partition.h"
 #include "hardware/flash.h"
 #include "flash_cfg.h"
+#include "kv_store.h"
 #include "utility.h"
 #include "wizchip_conf.h"
 #include "pico/unique_id.h"
 
 /**
- * Configuration for Flash memory Config partition
+ * The Config partition holds the key/value store of kv_store.c. Before
+ * it, config_t was in its first sector and blob slot n in sector 1 + n,
+ * each sector erased and rewritten on a save; that layout is imported
+ * once, by config_store_init().
  */
-#define CONFIG_FLASH_OFFSET 0x001f6000
-#define CONFIG_SECTOR_SIZE  4096
-#define CONFIG_DATA_OFFSET (CONFIG_FLASH_OFFSET + CONFIG_SECTOR_SIZE)
-#define CONFIG_DATA_SIZE   (32*1024 - CONFIG_SECTOR_SIZE)
+#define CONFIG_KEY_NET              KV_KEY(KV_TYPE_NET, 0)
+#define CONFIG_LEGACY_BLOB_SLOTS    (KV_SECTORS - 1)
+#define CONFIG_LEGACY_BLOB_MAX      (256 - 12)
 
 /**
  * Configuration for networking
@@ -73,6 +76,68 @@ config_t default_config = {
 static config_t gen_cfg[3];
 
 
+/* ---------- the layout before the store ---------- */
+typedef struct {
+    uint32_t magic;
+    uint16_t len;
+    uint16_t slot;
+    uint32_t crc32;         // of the data only
+} __attribute__((packed)) config_blob_hdr_t;
+
+static bool legacy_config(config_t *cfg) {
+    return kv_flash_read(0, cfg, sizeof(*cfg)) &&
+           cfg->crc32 == config_crc32(cfg, sizeof(*cfg) - sizeof(uint32_t));
+}
+
+/* page: the header and the data of the blob */
+static bool legacy_blob(uint8_t slot, uint8_t *page) {
+    config_blob_hdr_t hdr;
+
+    if (!kv_flash_read((uint32_t)(slot + 1u) * KV_SECTOR_SIZE, page, FLASH_PAGE_SIZE))
+        return false;
+    memcpy(&hdr, page, sizeof(hdr));
+    return hdr.magic == CONFIG_BLOB_MAGIC && hdr.slot == slot && hdr.len <= CONFIG_LEGACY_BLOB_MAX &&
+           config_crc32(page + sizeof(hdr), hdr.len) == hdr.crc32;
+}
+
+static bool config_import(void *ctx) {
+    static uint8_t page[FLASH_PAGE_SIZE];
+    config_t cfg;
+    (void)ctx;
+
+    if (legacy_config(&cfg) && !kv_put(CONFIG_KEY_NET, &cfg, sizeof(cfg)))
+        return false;
+    for (uint8_t slot = 0; slot < CONFIG_LEGACY_BLOB_SLOTS; slot++) {
+        const config_blob_hdr_t *hdr = (const config_blob_hdr_t *)page;
+
+        if (legacy_blob(slot, page) &&
+            !kv_put(KV_KEY(KV_TYPE_BLOB, slot), page + sizeof(*hdr), hdr->len))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Mount the store; without one, make it in the first sector that holds
+ * nothing of the older layout and import that
+ */
+static void config_store_init(void) {
+    static uint8_t page[FLASH_PAGE_SIZE];
+    config_t cfg;
+    uint8_t first = 0;
+
+    if (kv_mount())
+        return;
+    if (legacy_config(&cfg)) {
+        for (first = 1; first < KV_SECTORS - 1 && legacy_blob((uint8_t)(first - 1), page); first++)
+            ;
+    }
+    printf("Config store: new in sector %u, older layout imported\r\n", first);
+    if (!kv_format(first, config_import, NULL))
+        printf("Config store: format failed\r\n");
+}
+
+
 /**
  * Try to get configuration from flash,
  * if not present, use default configuration
@@ -86,6 +151,7 @@ void config_init(const network_t *default_network) {
     memcpy(default_config.net_info.gw, default_network->gw, sizeof(default_config.net_info.gw));
     memcpy(default_config.net_info.dns, default_network->dns, sizeof(default_config.net_info.dns));
 
+    config_store_init();
     if (config_load() == BOOTROM_OK) {
         // loaded successfully from flash
         memcpy(&gen_cfg[0], &gen_cfg[2], sizeof(config_t));
@@ -171,23 +237,10 @@ int config_show(config_t *cfg, int id, char *msg, size_t msg_max_sz) {
 
 
 int config_load(void) {
-    int ret;
     config_t *flash_cfg = &gen_cfg[2];
-    // uint8_t flash_buf[sizeof(config_t)];
-    uint32_t offset = XIP_BASE + CONFIG_FLASH_OFFSET;
-    cflash_flags_t flags;
-    flags.flags = (CFLASH_OP_VALUE_READ << CFLASH_OP_LSB) | (CFLASH_SECLEVEL_VALUE_SECURE << CFLASH_SECLEVEL_LSB);
-
-    // printf("Loading config using flash_read() from 0x%08x\n", offset);
-
-    ret = rom_flash_op(flags, offset, sizeof(config_t), (uint8_t *)flash_cfg);
-    if (ret == BOOTROM_ERROR_NOT_PERMITTED) {
-        printf("Not permitted, as expected\n");
-        return ret;
-    } else if (ret) {
-        printf("Flash OP failed with %d\n", ret);
-        return ret;
-    }
+
+    if (kv_get(CONFIG_KEY_NET, flash_cfg, sizeof(config_t)) != (int)sizeof(config_t))
+        return BOOTROM_ERROR_NOT_FOUND;
 
     uint32_t flash_crc32 = config_crc32(flash_cfg, sizeof(config_t) - sizeof(uint32_t));
     if (flash_crc32 != flash_cfg->crc32) {
@@ -201,7 +254,7 @@ int config_load(void) {
 
 /**
  * Saving configuration
- * Writes must erase the entire 4 KB block.
+ * One record appended to the store; a cut keeps the config saved before.
  */
 bool config_save(const config_t *cfg) {
     config_t tmp;
@@ -209,19 +262,23 @@ bool config_save(const config_t *cfg) {
 
     tmp.crc32 = config_crc32(&tmp, sizeof(tmp) - sizeof(uint32_t));
 
-    uint32_t ints = save_and_disable_interrupts();
-    /* Erase 4KB block */
-    flash_range_erase(CONFIG_FLASH_OFFSET, CONFIG_SECTOR_SIZE);
-
-    /* Write exactly sizeof(config_t), but flash writes require 256-byte alignment */
-    flash_range_program(CONFIG_FLASH_OFFSET, 
-                        (const uint8_t *)&tmp,
-                        sizeof(tmp));
-
-    restore_interrupts(ints);
-    return true;
+    return kv_put(CONFIG_KEY_NET, &tmp, sizeof(tmp));
 }
 
 
+/* ---------- application blobs ---------- */
 
+/**
+ * Read a blob into data; false when there is none or it has another length
+ */
+bool config_blob_load(uint8_t slot, void *data, uint16_t len) {
+    if (len > CONFIG_BLOB_MAX)
+        return false;
+    return kv_get(KV_KEY(KV_TYPE_BLOB, slot), data, len) == len;
+}
 
+bool config_blob_save(uint8_t slot, const void *data, uint16_t len) {
+    if (len > CONFIG_BLOB_MAX)
+        return false;
+    return kv_put(KV_KEY(KV_TYPE_BLOB, slot), data, len);
+}
@@ -8,6 +8,7 @@
 
 #include <stdint.h>
 #include "wizchip_conf.h"
+#include "kv_store.h"
 
 #define CONFIG_MAGIC 0x434F4E46u   /* 'CONF' */
 
@@ -35,3 +36,17 @@ bool config_save(const config_t *cfg);
 
 void config_default(void);
 void config_recovery(void);
+
+/**
+ * Application blobs, KV_TYPE_BLOB keys of the Config partition store
+ * (kv_store.h). A blob whose length differs from the request (layout
+ * changed) does not load.
+ */
+#define CONFIG_BLOB_MAGIC       0x424C4F42u     /* 'BLOB', of the layout before the store */
+#define CONFIG_BLOB_MAX         KV_VALUE_MAX
+
+#define CONFIG_BLOB_PRESENCE    0               /* kitchen_pwm/presence.c rules */
+#define CONFIG_BLOB_OCCUPANCY   1               /* kitchen_pwm/occupancy.c zones */
+
+bool config_blob_load(uint8_t slot, void *data, uint16_t len);
+bool config_blob_save(uint8_t slot, const void *data, uint16_t len);
@@ -0,0 +1,605 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "kv_store.h"
+#include "utility.h"
+
+#define KV_MAGIC        0x3153564Bu     /* 'KVS1' */
+#define KV_KEY_FREE     0xFFFFu         // erased flash
+#define KV_KEY_COMMIT   0xFFFEu         // ends transaction txn
+#define KV_TXN_NONE     0xFFFFu
+
+#define KV_F_DELETE     0x01u
+#define KV_F_TXN        0x02u           // counts once the commit of its txn is read
+
+#define KV_CHUNK        64              // bytes read at a time for CRCs and checks
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;                       // +1 per sector taken into use, the highest is active
+    uint32_t erases;                    // of this sector
+    uint32_t crc32;
+} kv_sector_hdr_t;
+
+typedef struct {
+    uint16_t key;
+    uint16_t len;                       // of the value that follows
+    uint32_t seq;                       // +1 per record
+    uint16_t txn;                       // of a KV_F_TXN record or a commit
+    uint8_t  flags;
+    uint8_t  rsv;
+    uint32_t crc32;                     // of the header before it and the value
+} kv_rec_hdr_t;
+
+_Static_assert(sizeof(kv_sector_hdr_t) == 16 && sizeof(kv_rec_hdr_t) == 16, "kv: header sizes");
+
+typedef struct {
+    uint16_t key;
+    uint16_t len;
+    uint32_t addr;                      // of the record in the partition, 0 = deleted
+} kv_entry_t;
+
+typedef enum { REC_OK, REC_FREE, REC_BAD } rec_state_t;
+
+static kv_entry_t s_index[KV_KEYS_MAX];
+static uint8_t s_keys;
+static kv_entry_t s_txn[KV_TXN_MAX];    // puts of the open (or, mounting, the last read) transaction
+static uint8_t s_txn_n;
+static uint16_t s_txn_id;
+static uint32_t s_txn_bytes;
+static bool s_in_txn;
+
+static bool s_mounted;
+static bool s_formatting;               // no rolling: the other sectors may hold what is imported
+static uint8_t s_active;
+static uint32_t s_sector_seq;           // of the active sector
+static uint32_t s_rec_seq;              // of the last record written
+static uint32_t s_wr;                   // next record in the active sector
+static uint32_t s_erases[KV_SECTORS];
+static kv_stats_t s_stats;
+static uint8_t s_buf[sizeof(kv_rec_hdr_t) + KV_VALUE_MAX];
+
+static uint32_t rec_size(uint16_t len)
+{
+    return (sizeof(kv_rec_hdr_t) + len + 3u) & ~3u;
+}
+
+static uint32_t sector_addr(uint8_t s)
+{
+    return (uint32_t)s * KV_SECTOR_SIZE;
+}
+
+static uint32_t hdr_crc(const kv_rec_hdr_t *h)
+{
+    return crc32_step(0, (const uint8_t *)h, offsetof(kv_rec_hdr_t, crc32));
+}
+
+static kv_entry_t *find(kv_entry_t *table, uint8_t n, uint16_t key)
+{
+    for (uint8_t i = 0; i < n; i++) {
+        if (table[i].key == key)
+            return &table[i];
+    }
+    return NULL;
+}
+
+/* the newest record of key, addr 0 drops the key */
+static void index_set(uint16_t key, uint16_t len, uint32_t addr)
+{
+    kv_entry_t *e = find(s_index, s_keys, key);
+
+    if (!addr) {
+        if (e)
+            *e = s_index[--s_keys];
+    } else if (e) {
+        e->len = len;
+        e->addr = addr;
+    } else if (s_keys < KV_KEYS_MAX) {
+        s_index[s_keys++] = (kv_entry_t){ key, len, addr };
+    }
+}
+
+static void txn_add(uint16_t key, uint16_t len, uint32_t addr)
+{
+    kv_entry_t *e = find(s_txn, s_txn_n, key);
+
+    if (e) {
+        e->len = len;
+        e->addr = addr;
+    } else if (s_txn_n < KV_TXN_MAX) {
+        s_txn[s_txn_n++] = (kv_entry_t){ key, len, addr };
+    }
+}
+
+static void txn_apply(void)
+{
+    for (uint8_t i = 0; i < s_txn_n; i++)
+        index_set(s_txn[i].key, s_txn[i].len, s_txn[i].addr);
+    s_txn_n = 0;
+}
+
+static bool sector_hdr(uint8_t s, kv_sector_hdr_t *h)
+{
+    return kv_flash_read(sector_addr(s), h, sizeof(*h)) && h->magic == KV_MAGIC &&
+           h->crc32 == config_crc32(h, offsetof(kv_sector_hdr_t, crc32));
+}
+
+static bool erased(uint32_t addr, uint32_t len)
+{
+    uint8_t chunk[KV_CHUNK];
+
+    while (len) {
+        uint32_t n = (len < sizeof(chunk)) ? len : sizeof(chunk);
+
+        if (!kv_flash_read(addr, chunk, n))
+            return false;
+        for (uint32_t i = 0; i < n; i++) {
+            if (chunk[i] != 0xFF)
+                return false;
+        }
+        addr += n;
+        len -= n;
+    }
+    return true;
+}
+
+/* the record header at addr, REC_OK only with the CRC of the value checked */
+static rec_state_t read_rec(uint32_t addr, uint32_t end, kv_rec_hdr_t *h)
+{
+    uint8_t chunk[KV_CHUNK];
+
+    if (addr + sizeof(*h) > end || !kv_flash_read(addr, h, sizeof(*h)))
+        return REC_BAD;
+    if (h->key == KV_KEY_FREE && h->len == 0xFFFF && h->crc32 == 0xFFFFFFFFu)
+        return REC_FREE;
+    if (h->len > KV_VALUE_MAX || addr + rec_size(h->len) > end)
+        return REC_BAD;
+
+    uint32_t crc = hdr_crc(h);
+
+    for (uint32_t off = 0; off < h->len; ) {
+        uint32_t n = (h->len - off < sizeof(chunk)) ? h->len - off : sizeof(chunk);
+
+        if (!kv_flash_read(addr + (uint32_t)sizeof(*h) + off, chunk, n))
+            return REC_BAD;
+        crc = crc32_step(crc, chunk, n);
+        off += n;
+    }
+    return (crc == h->crc32) ? REC_OK : REC_BAD;
+}
+
+/* programs and reads back */
+static bool program(uint32_t addr, const void *data, uint32_t len)
+{
+    uint8_t chunk[KV_CHUNK];
+
+    s_stats.programmed += len;
+    if (!kv_flash_program(addr, data, len))
+        return false;
+    for (uint32_t off = 0; off < len; ) {
+        uint32_t n = (len - off < sizeof(chunk)) ? len - off : sizeof(chunk);
+
+        if (!kv_flash_read(addr + off, chunk, n) || memcmp(chunk, (const uint8_t *)data + off, n))
+            return false;
+        off += n;
+    }
+    return true;
+}
+
+static bool erase(uint8_t s)
+{
+    s_erases[s]++;
+    s_stats.erases++;
+    return kv_flash_erase(sector_addr(s));
+}
+
+/**
+ * Appends the record at the end of the active sector, the room is there.
+ * The value may already be in s_buf behind the header.
+ */
+static bool write_rec(kv_rec_hdr_t *h, const void *value)
+{
+    uint32_t size = rec_size(h->len);
+    uint32_t addr = sector_addr(s_active) + s_wr;
+
+    h->seq = ++s_rec_seq;
+    h->rsv = 0xFF;
+    h->crc32 = crc32_step(hdr_crc(h), value, h->len);
+    memcpy(s_buf, h, sizeof(*h));
+    if (h->len && value != s_buf + sizeof(*h))
+        memcpy(s_buf + sizeof(*h), value, h->len);
+    memset(s_buf + sizeof(*h) + h->len, 0xFF, size - sizeof(*h) - h->len);
+
+    if (!program(addr, s_buf, size)) {
+        s_wr = KV_SECTOR_SIZE;          // not clean any more, the next record rolls on
+        return false;
+    }
+    s_wr += size;
+    return true;
+}
+
+/* copies what is still the newest of its key in sector s to the active one, erases s */
+static bool collect(uint8_t s)
+{
+    kv_sector_hdr_t sh;
+    kv_rec_hdr_t h;
+    uint32_t end = sector_addr(s) + KV_SECTOR_SIZE;
+
+    // no header: nothing of the store (blank, torn, older layout)
+    if (sector_hdr(s, &sh)) {
+        for (uint32_t addr = sector_addr(s) + sizeof(sh); read_rec(addr, end, &h) == REC_OK;
+             addr += rec_size(h.len)) {
+            kv_entry_t *e = find(s_index, s_keys, h.key);
+
+            if (!e || e->addr != addr)
+                continue;               // overwritten, deleted, a commit, an open transaction
+            if (s_wr + rec_size(h.len) > KV_SECTOR_SIZE ||
+                !kv_flash_read(addr + sizeof(h), s_buf + sizeof(h), h.len))
+                return false;
+
+            kv_rec_hdr_t c = { .key = h.key, .len = h.len, .txn = KV_TXN_NONE, .flags = 0 };
+            uint32_t to = sector_addr(s_active) + s_wr;
+
+            if (!write_rec(&c, s_buf + sizeof(c)))
+                return false;
+            e->addr = to;
+            s_stats.copied++;
+        }
+    }
+    return erase(s);
+}
+
+static bool write_sector_hdr(uint8_t s, uint32_t seq)
+{
+    kv_sector_hdr_t h = { KV_MAGIC, seq, s_erases[s], 0 };
+
+    h.crc32 = config_crc32(&h, offsetof(kv_sector_hdr_t, crc32));
+    return program(sector_addr(s), &h, sizeof(h));
+}
+
+/* the erased sector after the active one takes over, the oldest is collected into it */
+static bool roll(void)
+{
+    uint8_t next = (uint8_t)((s_active + 1u) % KV_SECTORS);
+
+    if (!write_sector_hdr(next, s_sector_seq + 1u))
+        return false;
+    s_active = next;
+    s_sector_seq++;
+    s_wr = sizeof(kv_sector_hdr_t);
+    return collect((uint8_t)((next + 1u) % KV_SECTORS));
+}
+
+/* size bytes free in the active sector, rolling on as often as it takes */
+static bool room(uint32_t size)
+{
+    for (uint8_t n = 0; s_wr + size > KV_SECTOR_SIZE; n++) {
+        if (s_formatting || n == KV_SECTORS - 1)
+            return false;
+        if (!roll()) {
+            s_mounted = false;          // half a roll: kv_mount() finishes it
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint32_t live(void)
+{
+    uint32_t sum = 0;
+
+    for (uint8_t i = 0; i < s_keys; i++)
+        sum += rec_size(s_index[i].len);
+    return sum;
+}
+
+/* the records of sector s in order, into the index; the active one also sets s_wr */
+static void scan(uint8_t s, bool active)
+{
+    uint32_t end = sector_addr(s) + KV_SECTOR_SIZE;
+    uint32_t addr = sector_addr(s) + sizeof(kv_sector_hdr_t);
+    kv_rec_hdr_t h;
+    rec_state_t st;
+
+    while ((st = read_rec(addr, end, &h)) == REC_OK) {
+        if (h.seq > s_rec_seq)
+            s_rec_seq = h.seq;
+        if (h.key == KV_KEY_COMMIT) {
+            if (h.txn == s_txn_id)
+                txn_apply();
+            s_txn_id = h.txn;
+        } else if (h.flags & KV_F_TXN) {
+            if (h.txn != s_txn_id)
+                s_txn_n = 0;            // one that never committed
+            s_txn_id = h.txn;
+            txn_add(h.key, h.len, (h.flags & KV_F_DELETE) ? 0 : addr);
+        } else {
+            index_set(h.key, h.len, (h.flags & KV_F_DELETE) ? 0 : addr);
+        }
+        addr += rec_size(h.len);
+    }
+    // a torn record, or a clean end with programmed bits behind it: nothing more goes here
+    if (st == REC_BAD && addr + sizeof(h) <= end)
+        s_stats.torn++;
+    if (active)
+        s_wr = (st == REC_FREE && erased(addr, end - addr)) ? addr - sector_addr(s) : KV_SECTOR_SIZE;
+}
+
+bool kv_mount(void)
+{
+    kv_sector_hdr_t h[KV_SECTORS];
+    bool valid[KV_SECTORS];
+    bool found = false;
+
+    s_mounted = s_in_txn = false;
+    s_keys = s_txn_n = 0;
+    s_txn_id = KV_TXN_NONE;
+    s_rec_seq = 0;
+    memset(&s_stats, 0, sizeof(s_stats));
+
+    for (uint8_t s = 0; s < KV_SECTORS; s++) {
+        valid[s] = sector_hdr(s, &h[s]);
+        if (valid[s] && (!found || h[s].seq > s_sector_seq)) {
+            s_active = s;
+            s_sector_seq = h[s].seq;
+            found = true;
+        }
+    }
+    if (!found)
+        return false;
+
+    // oldest first; a sector counts when its seq fits its place in the ring
+    for (uint8_t back = KV_SECTORS - 1; back < KV_SECTORS; back--) {
+        uint8_t s = (uint8_t)((s_active + KV_SECTORS - back) % KV_SECTORS);
+
+        s_erases[s] = valid[s] ? h[s].erases : h[s_active].erases;
+        if (valid[s] && h[s].seq == s_sector_seq - back)
+            scan(s, back == 0);
+    }
+    s_txn_n = 0;                        // never committed
+    s_mounted = true;
+
+    // the sector after the active one is the spare; if not, a collection was cut short
+    uint8_t spare = (uint8_t)((s_active + 1u) % KV_SECTORS);
+
+    if (!erased(sector_addr(spare), KV_SECTOR_SIZE) && !collect(spare)) {
+        // no room for the copies (one was torn): undo the roll, the active sector holds only copies
+        uint8_t prev = (uint8_t)((s_active + KV_SECTORS - 1u) % KV_SECTORS);
+
+        s_mounted = false;
+        if (valid[prev] && h[prev].seq == s_sector_seq - 1u && erase(s_active))
+            return kv_mount();
+    }
+    return s_mounted;
+}
+
+bool kv_format(uint8_t first, kv_import_fn import, void *ctx)
+{
+    bool ok;
+
+    if (first >= KV_SECTORS)
+        return false;
+    s_mounted = s_in_txn = false;
+    s_keys = s_txn_n = 0;
+    s_txn_id = KV_TXN_NONE;
+    s_rec_seq = 0;
+    memset(&s_stats, 0, sizeof(s_stats));
+    memset(s_erases, 0, sizeof(s_erases));
+    if (!erase(first))
+        return false;
+
+    // records first, the header last: a cut before it leaves no store
+    s_active = first;
+    s_sector_seq = 1;
+    s_wr = sizeof(kv_sector_hdr_t);
+    s_mounted = s_formatting = true;
+    ok = !import || import(ctx);
+    s_formatting = false;
+    s_mounted = false;
+    if (!ok || s_in_txn || !write_sector_hdr(first, 1))
+        return false;
+    return kv_mount();
+}
+
+int kv_get(uint16_t key, void *value, uint16_t size)
+{
+    const kv_entry_t *e = s_mounted ? find(s_index, s_keys, key) : NULL;
+    kv_rec_hdr_t h;
+
+    if (!e || e->len > size)
+        return -1;
+    if (!kv_flash_read(e->addr, &h, sizeof(h)) || h.key != key || h.len != e->len ||
+        !kv_flash_read(e->addr + sizeof(h), value, e->len) ||
+        crc32_step(hdr_crc(&h), value, e->len) != h.crc32)
+        return -1;
+    return e->len;
+}
+
+static bool put(uint16_t key, const void *value, uint16_t len, uint8_t flags)
+{
+    uint32_t size = rec_size(len);
+    const kv_entry_t *e;
+
+    if (!s_mounted || key == KV_KEY_FREE || key == KV_KEY_COMMIT || len > KV_VALUE_MAX)
+        return false;
+    if (!(flags & KV_F_DELETE)) {
+        e = find(s_index, s_keys, key);
+        if (!e && s_keys + s_txn_n >= KV_KEYS_MAX)
+            return false;
+        if (live() - (e ? rec_size(e->len) : 0) + size > KV_LIVE_MAX)
+            return false;
+    }
+    if (s_in_txn) {
+        if (!find(s_txn, s_txn_n, key) && s_txn_n == KV_TXN_MAX)
+            return false;
+        if (s_txn_bytes + size > KV_SECTOR_SIZE / 2)
+            return false;               // stays clear of the sector being collected
+        flags |= KV_F_TXN;
+    }
+    if (!room(size))
+        return false;
+
+    kv_rec_hdr_t h = { .key = key, .len = len, .flags = flags,
+                       .txn = s_in_txn ? s_txn_id : KV_TXN_NONE };
+    uint32_t addr = sector_addr(s_active) + s_wr;
+
+    s_stats.puts++;
+    s_stats.bytes += len;
+    if (!write_rec(&h, value))
+        return false;
+    if (s_in_txn) {
+        txn_add(key, len, (flags & KV_F_DELETE) ? 0 : addr);
+        s_txn_bytes += size;
+    } else {
+        index_set(key, len, (flags & KV_F_DELETE) ? 0 : addr);
+    }
+    return true;
+}
+
+bool kv_put(uint16_t key, const void *value, uint16_t len)
+{
+    return put(key, value, len, 0);
+}
+
+bool kv_delete(uint16_t key)
+{
+    if (!find(s_index, s_keys, key) && !find(s_txn, s_txn_n, key))
+        return s_mounted;
+    return put(key, NULL, 0, KV_F_DELETE);
+}
+
+bool kv_begin(void)
+{
+    if (!s_mounted || s_in_txn)
+        return false;
+    s_in_txn = true;
+    s_txn_id = (uint16_t)(s_txn_id + 1u);
+    if (s_txn_id == KV_TXN_NONE)
+        s_txn_id = 0;
+    s_txn_n = 0;
+    s_txn_bytes = 0;
+    return true;
+}
+
+bool kv_commit(void)
+{
+    kv_rec_hdr_t h = { .key = KV_KEY_COMMIT, .len = 0, .txn = s_txn_id, .flags = 0 };
+
+    if (!s_in_txn)
+        return false;
+    s_in_txn = false;
+    if (!s_txn_n)
+        return true;
+    s_stats.puts++;
+    if (!room(rec_size(0)) || !write_rec(&h, NULL)) {
+        s_txn_n = 0;
+        return false;
+    }
+    txn_apply();
+    return true;
+}
+
+void kv_abort(void)
+{
+    s_in_txn = false;                   // its records stay on flash and never count
+    s_txn_n = 0;
+}
+
+void kv_stats(kv_stats_t *stats)
+{
+    *stats = s_stats;
+    memcpy(stats->sector_erases, s_erases, sizeof(s_erases));
+    stats->live = live();
+    stats->free = (uint16_t)(KV_SECTOR_SIZE - s_wr);
+    stats->keys = s_keys;
+    stats->active = s_active;
+    stats->seq = s_sector_seq;
+}
+
+int kv_show(char *msg, size_t msg_max_sz)
+{
+    char *cursor = msg;
+    size_t remaining = msg_max_sz;
+    kv_stats_t st;
+
+    if (!s_mounted) {
+        msg_printf(&cursor, &remaining, "Config store: not mounted\r\n");
+        return (int)(msg_max_sz - remaining);
+    }
+    kv_stats(&st);
+    msg_printf(&cursor, &remaining,
+        "Config store: sector %u seq %lu, %u keys, %lu bytes live of %u, %u free in the sector\r\n"
+        "\tputs %lu (%lu bytes), programmed %lu, copied %lu, erases %lu, torn %lu\r\n"
+        "\tsector erases:",
+        st.active, (unsigned long)st.seq, st.keys, (unsigned long)st.live, KV_LIVE_MAX, st.free,
+        (unsigned long)st.puts, (unsigned long)st.bytes, (unsigned long)st.programmed,
+        (unsigned long)st.copied, (unsigned long)st.erases, (unsigned long)st.torn);
+    for (uint8_t s = 0; s < KV_SECTORS; s++)
+        msg_printf(&cursor, &remaining, " %lu", (unsigned long)st.sector_erases[s]);
+    msg_printf(&cursor, &remaining, "\r\n");
+    return (int)(msg_max_sz - remaining);
+}
+
+#ifndef KV_HOST
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "pico/flash.h"
+#include "partition.h"
+
+typedef struct {
+    uint32_t offset;
+    const uint8_t *data;
+    uint32_t len;
+} kv_flash_op_t;
+
+bool kv_flash_read(uint32_t offset, void *data, uint32_t len)
+{
+    cflash_flags_t flags;
+
+    flags.flags = (CFLASH_OP_VALUE_READ << CFLASH_OP_LSB) | (CFLASH_SECLEVEL_VALUE_SECURE << CFLASH_SECLEVEL_LSB);
+    return rom_flash_op(flags, XIP_BASE + KV_FLASH_OFFSET + offset, len, data) == BOOTROM_OK;
+}
+
+/* page by page, 0xFF around the data leaves the bytes there as they are */
+static void kv_flash_program_pages(void *param)
+{
+    static uint8_t page[FLASH_PAGE_SIZE];
+    const kv_flash_op_t *op = param;
+    uint32_t offset = KV_FLASH_OFFSET + op->offset;
+
+    for (uint32_t done = 0; done < op->len; ) {
+        uint32_t base = offset & ~(FLASH_PAGE_SIZE - 1u);
+        uint32_t in = offset - base;
+        uint32_t n = (FLASH_PAGE_SIZE - in < op->len - done) ? FLASH_PAGE_SIZE - in : op->len - done;
+
+        memset(page, 0xFF, sizeof(page));
+        memcpy(page + in, op->data + done, n);
+        flash_range_program(base, page, FLASH_PAGE_SIZE);
+        offset += n;
+        done += n;
+    }
+}
+
+bool kv_flash_program(uint32_t offset, const void *data, uint32_t len)
+{
+    kv_flash_op_t op = { offset, data, len };
+
+    /* Interrupts off here, and the other core parked if it runs (e.g. WS2815_CORE1) */
+    return flash_safe_execute(kv_flash_program_pages, &op, UINT32_MAX) == PICO_OK;
+}
+
+static void kv_flash_erase_sector(void *param)
+{
+    flash_range_erase(KV_FLASH_OFFSET + *(const uint32_t *)param, KV_SECTOR_SIZE);
+}
+
+bool kv_flash_erase(uint32_t offset)
+{
+    return flash_safe_execute(kv_flash_erase_sector, &offset, UINT32_MAX) == PICO_OK;
+}
+#endif // KV_HOST
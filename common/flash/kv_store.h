@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Key/value store over the Config partition: 32 KB, 8 sectors of 4 KB.
+ *
+ * A log, nothing is rewritten in place. A put appends a record (header,
+ * value, CRC32 of both) to the active sector; the newest record of a key
+ * is its value, a RAM index points at it. A record that does not fit
+ * takes the next sector of the ring, and the sector after that one, the
+ * oldest, is collected: its records that are still the newest of their
+ * key are copied to the active sector and it is erased. One sector is
+ * always erased and waiting, so the erases go round all 8 sectors and a
+ * save costs a record, not a sector.
+ *
+ * Power cuts: a record with a bad CRC ends its sector when mounting, the
+ * key keeps the value it had. A collection cut short is finished by
+ * kv_mount(). kv_begin() .. kv_commit() makes several puts one: their
+ * records count once the commit record is on flash, or not at all.
+ *
+ * Keys are typed, KV_KEY(KV_TYPE_..., index). The values are whatever the
+ * owner of the type writes; a reader checks the length it gets.
+ *
+ * The flash is reached through kv_flash_read() / kv_flash_program() /
+ * kv_flash_erase() with offsets into the partition; the pico backend is in
+ * kv_store.c, a host build defines KV_HOST and provides them.
+ */
+#define KV_FLASH_OFFSET     0x001f6000  // Config partition, partition table id 2
+#define KV_SECTOR_SIZE      4096
+#define KV_SECTORS          8
+#define KV_KEYS_MAX         32          // in the RAM index, 8 bytes each
+#define KV_VALUE_MAX        1024
+#define KV_TXN_MAX          8           // puts in one transaction
+/* records of all keys: a sector always frees room for the largest record */
+#define KV_LIVE_MAX         ((KV_SECTORS - 1) * (KV_SECTOR_SIZE - 16 - 16 - KV_VALUE_MAX))
+
+typedef enum {
+    KV_TYPE_NET = 1,                    // config_t of flash_cfg.c
+    KV_TYPE_BLOB,                       // config_blob_*(): presence rules, occupancy zones
+    KV_TYPE_LAYOUT,                     // LED strip layouts
+    KV_TYPE_PATTERN,                    // pattern parameters
+    KV_TYPE_CALIB,                      // sensor calibration
+} kv_type_t;
+
+#define KV_KEY(type, index) ((uint16_t)(((unsigned)(type) << 8) | ((unsigned)(index) & 0xFFu)))
+#define KV_KEY_TYPE(key)    ((uint8_t)((key) >> 8))
+
+typedef struct {
+    uint32_t puts;                      // records asked for, deletes and commits too
+    uint32_t bytes;                     // value bytes of those
+    uint32_t programmed;                // flash bytes programmed: headers, padding, copies
+    uint32_t copied;                    // records moved by collections
+    uint32_t erases;                    // sectors erased, since mounting
+    uint32_t torn;                      // damaged records that ended a sector when mounting
+    uint32_t sector_erases[KV_SECTORS]; // over the life of the store, from the sector headers
+    uint32_t live;                      // bytes of the newest records of all keys
+    uint16_t free;                      // bytes left in the active sector
+    uint8_t  keys;
+    uint8_t  active;
+    uint32_t seq;                       // of the active sector
+} kv_stats_t;
+
+/* fills a new store from older data, with kv_put() calls; false aborts the format */
+typedef bool (*kv_import_fn)(void *ctx);
+
+/* reads the store into the RAM index; false when there is none (blank or older layout) */
+bool kv_mount(void);
+
+/**
+ * A new store in sector first, when kv_mount() found none. import() runs
+ * with the store open; the sector header is written after it, so a cut
+ * leaves no store and the next boot imports again. The other sectors are
+ * erased when the ring reaches them: the import may read them meanwhile.
+ */
+bool kv_format(uint8_t first, kv_import_fn import, void *ctx);
+
+/* copies the value when it fits size; returns its length, -1 when there is none */
+int kv_get(uint16_t key, void *value, uint16_t size);
+bool kv_put(uint16_t key, const void *value, uint16_t len);
+bool kv_delete(uint16_t key);
+
+/* the puts up to kv_commit() are written, kv_get() sees them after the commit */
+bool kv_begin(void);
+bool kv_commit(void);
+void kv_abort(void);
+
+void kv_stats(kv_stats_t *stats);
+int kv_show(char *msg, size_t msg_max_sz);
+
+bool kv_flash_read(uint32_t offset, void *data, uint32_t len);
+bool kv_flash_program(uint32_t offset, const void *data, uint32_t len);
+bool kv_flash_erase(uint32_t offset);   // one sector
@@ -0,0 +1,307 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cli_cmd.h"
+#include "tcp_cli.h"
+
+static const cli_cmd_t *s_index[CLI_CMDS_MAX];     // sorted by name
+static uint8_t s_count;
+
+void cli_cmd_reset(void)
+{
+    s_count = 0;
+}
+
+/* strcmp(name, key) where key is argv[0..words-1] joined with one space */
+static int cmp_key(const char *name, char *const *argv, int words)
+{
+    const unsigned char *n = (const unsigned char *)name;
+
+    for (int w = 0; w < words; w++) {
+        const unsigned char *k = (const unsigned char *)argv[w];
+
+        if (w) {
+            if (*n != ' ')
+                return (int)*n - ' ';
+            n++;
+        }
+        for (; *k; k++, n++) {
+            if (*n != *k)
+                return (int)*n - (int)*k;
+        }
+    }
+    return (int)*n;
+}
+
+/* first index whose name is not below key */
+static uint8_t lower_bound(char *const *argv, int words)
+{
+    uint8_t lo = 0, hi = s_count;
+
+    while (lo < hi) {
+        uint8_t mid = (uint8_t)((lo + hi) / 2u);
+        if (cmp_key(s_index[mid]->name, argv, words) < 0)
+            lo = (uint8_t)(mid + 1u);
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static const cli_cmd_t *search(char *const *argv, int words)
+{
+    uint8_t i = lower_bound(argv, words);
+
+    if (i < s_count && cmp_key(s_index[i]->name, argv, words) == 0)
+        return s_index[i];
+    return NULL;
+}
+
+bool cli_cmd_register(const cli_cmd_t *cmds, uint8_t n)
+{
+    if (s_count + n > CLI_CMDS_MAX)
+        return false;
+    for (uint8_t i = 0; i < n; i++) {
+        for (uint8_t j = 0; j < s_count; j++)
+            if (strcmp(cmds[i].name, s_index[j]->name) == 0)
+                return false;
+        for (uint8_t j = 0; j < i; j++)
+            if (strcmp(cmds[i].name, cmds[j].name) == 0)
+                return false;
+    }
+
+    for (uint8_t i = 0; i < n; i++) {
+        uint8_t k = s_count;
+
+        while (k > 0 && strcmp(s_index[k - 1]->name, cmds[i].name) > 0) {
+            s_index[k] = s_index[k - 1];
+            k--;
+        }
+        s_index[k] = &cmds[i];
+        s_count++;
+    }
+    return true;
+}
+
+int cli_cmd_tokenize(char *line, char **argv, int max)
+{
+    int argc = 0;
+    char *p = line;
+
+    while (argc < max) {
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p == '\0')
+            break;
+        argv[argc++] = p;
+        if (argc == max)
+            break;                  // the last word keeps the rest of the line
+        while (*p != '\0' && *p != ' ' && *p != '\t')
+            p++;
+        if (*p == '\0')
+            break;
+        *p++ = '\0';
+    }
+    return argc;
+}
+
+const cli_cmd_t *cli_cmd_find(int argc, char *const *argv, int *words)
+{
+    const cli_cmd_t *c = NULL;
+
+    *words = 0;
+    if (argc >= 2 && (c = search(argv, 2)) != NULL)
+        *words = 2;
+    else if (argc >= 1 && (c = search(argv, 1)) != NULL)
+        *words = 1;
+    return c;
+}
+
+void cli_cmd_usage(uint8_t sn, const cli_cmd_t *c)
+{
+    char msg[128];
+
+    snprintf(msg, sizeof(msg), "Usage: %s%s%s\r\n", c->name, c->args[0] ? " " : "", c->args);
+    cli_flush(sn, msg);
+}
+
+/* name is word, or word and more words */
+static bool has_word(const char *name, const char *word, size_t len)
+{
+    return strncmp(name, word, len) == 0 && (name[len] == '\0' || name[len] == ' ');
+}
+
+/* the commands named word or starting with it, all if word is NULL; returns how many */
+static int list(uint8_t sn, const char *word, bool with_help)
+{
+    size_t len = word ? strlen(word) : 0;
+    uint8_t i = word ? lower_bound((char *const *)&word, 1) : 0;
+    int n = 0;
+    char msg[160];
+
+    for (; i < s_count && (!word || has_word(s_index[i]->name, word, len)); i++) {
+        const cli_cmd_t *c = s_index[i];
+
+        if (with_help && !c->help)
+            continue;
+        if (with_help) {
+            char use[64];
+            snprintf(use, sizeof(use), "%s%s%s", c->name, c->args[0] ? " " : "", c->args);
+            snprintf(msg, sizeof(msg), "  %-30s - %s\r\n", use, c->help);
+        } else {
+            snprintf(msg, sizeof(msg), "  %s%s%s\r\n", c->name, c->args[0] ? " " : "", c->args);
+        }
+        cli_send(sn, msg);
+        n++;
+    }
+    return n;
+}
+
+static void help(uint8_t sn, const char *word)
+{
+    char msg[128];
+
+    if (!word)
+        cli_send(sn, "\r\nAvailable commands:\r\n");
+    if (list(sn, word, true) == 0) {
+        cli_flush(sn, "No such command\r\n");
+        return;
+    }
+    if (word) {
+        cli_flush(sn, "");
+        return;
+    }
+    snprintf(msg, sizeof(msg), "  %-30s - %s\r\n", "help [word]", "This list, or the commands starting with word");
+    cli_flush(sn, msg);
+}
+
+bool cli_cmd_dispatch(char *line, uint8_t sn)
+{
+    char *argv[CLI_ARGS_MAX];
+    int argc = cli_cmd_tokenize(line, argv, CLI_ARGS_MAX);
+    const cli_cmd_t *c;
+    int words;
+
+    if (argc == 0) {
+        cli_flush(sn, "");
+        return true;
+    }
+    if (strcmp(argv[0], "help") == 0) {
+        help(sn, (argc > 1) ? argv[1] : NULL);
+        return true;
+    }
+
+    c = cli_cmd_find(argc, argv, &words);
+    if (!c) {
+        uint8_t i = lower_bound(argv, 1);
+
+        if (i == s_count || !has_word(s_index[i]->name, argv[0], strlen(argv[0]))) {
+            cli_flush(sn, "Unknown command\r\n");
+            return false;
+        }
+        // "config" alone or with an unknown word: the usage of the config commands
+        cli_send(sn, "Usage:\r\n");
+        list(sn, argv[0], false);
+        cli_flush(sn, "");
+        return true;
+    }
+
+    cli_ctx_t ctx = { sn, argc - words, argv + words };
+    if (ctx.argc < c->min_args || ctx.argc > c->max_args || !c->fn(&ctx))
+        cli_cmd_usage(sn, c);
+    return true;
+}
+
+void cli_cmd_handle(const char *cmd, uint8_t sn)
+{
+    char line[CLI_LINE_MAX];
+
+    strncpy(line, cmd, sizeof(line) - 1);
+    line[sizeof(line) - 1] = '\0';
+    cli_cmd_dispatch(line, sn);
+}
+
+/* ---------- typed arguments ---------- */
+static bool parse_dec(const char *s, uint32_t *out)
+{
+    uint32_t v = 0;
+
+    if (*s == '\0')
+        return false;
+    for (; *s; s++) {
+        uint32_t d = (uint32_t)(unsigned char)*s - '0';
+        if (d > 9u || v > (UINT32_MAX - d) / 10u)
+            return false;
+        v = v * 10u + d;
+    }
+    *out = v;
+    return true;
+}
+
+bool cli_arg_u32(const char *s, uint32_t min, uint32_t max, uint32_t *out)
+{
+    uint32_t v;
+
+    if (!parse_dec(s, &v) || v < min || v > max)
+        return false;
+    *out = v;
+    return true;
+}
+
+bool cli_args_u32(char *const *argv, int n, uint32_t min, uint32_t max, uint32_t *out)
+{
+    for (int i = 0; i < n; i++)
+        if (!cli_arg_u32(argv[i], min, max, &out[i]))
+            return false;
+    return true;
+}
+
+bool cli_arg_i32(const char *s, int32_t min, int32_t max, int32_t *out)
+{
+    bool neg = (*s == '-');
+    uint32_t m;
+    int64_t v;
+
+    if (!parse_dec(s + neg, &m))
+        return false;
+    v = neg ? -(int64_t)m : (int64_t)m;
+    if (v < min || v > max)
+        return false;
+    *out = (int32_t)v;
+    return true;
+}
+
+bool cli_arg_ipv4(const char *s, uint8_t out[4])
+{
+    uint8_t ip[4];
+
+    for (int i = 0; i < 4; i++) {
+        uint32_t v = 0;
+        int digits = 0;
+
+        for (; *s >= '0' && *s <= '9' && digits < 4; s++, digits++)
+            v = v * 10u + (uint32_t)(*s - '0');
+        if (digits == 0 || digits > 3 || v > 255u)
+            return false;
+        if (*s != ((i < 3) ? '.' : '\0'))
+            return false;
+        ip[i] = (uint8_t)v;
+        s++;
+    }
+    memcpy(out, ip, sizeof(ip));
+    return true;
+}
+
+int cli_arg_enum(const char *s, const char *const *names, uint8_t n)
+{
+    for (uint8_t i = 0; i < n; i++)
+        if (strcmp(s, names[i]) == 0)
+            return i;
+    return -1;
+}
@@ -0,0 +1,81 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Command dispatch of the telnet CLI.
+ *
+ * Every module registers a table of commands. The names of all tables are
+ * kept in one index sorted with strcmp(), so a line is looked up with a
+ * binary search: first on its first two words ("config ip", "vl53 gpio"),
+ * then on its first word. The line is split into words in place, in one
+ * pass; the words after the name are the handler's argv.
+ *
+ * A word count outside min_args..max_args, or a handler returning false,
+ * answers "Usage: <name> <args>". A first word that only starts two word
+ * names ("config") answers with their usage lines. "help" is built in and
+ * lists all commands from the tables, "help <word>" the ones starting
+ * with it.
+ *
+ * Output goes through cli_send() / cli_flush() of tcp_cli.c. No SDK
+ * dependency.
+ */
+#define CLI_CMDS_MAX        128     // commands of all tables together, 4 bytes each; kitchen uses 66
+#define CLI_ARGS_MAX        16      // words of a line, name included
+#define CLI_LINE_MAX        256     // longer lines are cut
+
+typedef struct {
+    uint8_t sn;                     // socket of the client, for cli_send() / cli_flush()
+    int     argc;                   // words after the command name
+    char  **argv;
+} cli_ctx_t;
+
+/* false: wrong arguments, answered with the usage line */
+typedef bool (*cli_cmd_fn)(const cli_ctx_t *ctx);
+
+typedef struct {
+    const char *name;               // one word, or two separated by one space
+    const char *args;               // usage after the name, "" if none
+    const char *help;               // one line for "help", NULL to hide
+    uint8_t     min_args;
+    uint8_t     max_args;
+    cli_cmd_fn  fn;
+} cli_cmd_t;
+
+/* adds a table, which must stay valid; false if full or a name is taken, nothing added then */
+bool cli_cmd_register(const cli_cmd_t *cmds, uint8_t n);
+
+/* drops all tables */
+void cli_cmd_reset(void);
+
+/* splits line at spaces and tabs, returns the word count (at most max) */
+int cli_cmd_tokenize(char *line, char **argv, int max);
+
+/* command of argv[0..argc-1], words = words of its name; NULL if none */
+const cli_cmd_t *cli_cmd_find(int argc, char *const *argv, int *words);
+
+/* runs one line, writable; false for an unknown command */
+bool cli_cmd_dispatch(char *line, uint8_t sn);
+
+/* tcp_cli_hooks_t.handle_command: dispatch of a copy of cmd */
+void cli_cmd_handle(const char *cmd, uint8_t sn);
+
+/* "Usage: <name> <args>" and the prompt */
+void cli_cmd_usage(uint8_t sn, const cli_cmd_t *c);
+
+/* typed arguments: the whole word has to parse and be in range */
+bool cli_arg_u32(const char *s, uint32_t min, uint32_t max, uint32_t *out);
+bool cli_arg_i32(const char *s, int32_t min, int32_t max, int32_t *out);
+bool cli_arg_ipv4(const char *s, uint8_t out[4]);
+
+/* n words of argv into out[], all in min..max */
+bool cli_args_u32(char *const *argv, int n, uint32_t min, uint32_t max, uint32_t *out);
+
+/* index of s in names[0..n-1], -1 if not there */
+int cli_arg_enum(const char *s, const char *const *names, uint8_t n);
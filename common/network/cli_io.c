@@ -0,0 +1,190 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "cli_io.h"
+#include "tcp_cli.h"
+
+#define TELNET_PROMPT   "> "
+
+/* telnet: RFC 854 */
+#define IAC             255
+#define SB              250
+#define SE              240
+#define WILL            251
+#define DONT            254
+
+enum { IAC_NONE, IAC_CMD, IAC_OPT, IAC_SB_DATA, IAC_SB_IAC };
+
+static cli_io_send_fn s_send;
+static cli_io_line_fn s_on_line;
+static cli_io_stats_t s_stats;
+
+static cli_io_rx_t *s_rx;           // the one cli_io_rx() is running
+
+static uint8_t  s_tx[CLI_TX_BUF_SIZE];
+static uint16_t s_tx_len;
+static uint8_t  s_tx_sn = 0xFF;
+
+void cli_io_init(cli_io_send_fn send_fn, cli_io_line_fn on_line)
+{
+    s_send = send_fn;
+    s_on_line = on_line;
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_tx_len = 0;
+}
+
+void cli_io_rx_reset(cli_io_rx_t *rx)
+{
+    memset(rx, 0, sizeof(*rx));
+}
+
+void cli_io_stop(void)
+{
+    if (s_rx) {
+        cli_io_rx_reset(s_rx);
+        s_rx->stop = true;
+    }
+    s_tx_len = 0;
+}
+
+/* ---------- TX ---------- */
+void cli_io_tx_flush(uint8_t sn)
+{
+    if (s_tx_len == 0 || sn != s_tx_sn)
+        return;
+    s_stats.segments++;
+    s_stats.bytes += s_tx_len;
+    if (s_send)
+        s_send(sn, s_tx, s_tx_len);     // < 0: the socket is gone, so is the output
+    s_tx_len = 0;
+}
+
+static void tx_put(uint8_t sn, const char *msg, size_t len)
+{
+    if (s_tx_len && sn != s_tx_sn)
+        cli_io_tx_flush(s_tx_sn);
+    s_tx_sn = sn;
+
+    while (len) {
+        size_t n = sizeof(s_tx) - s_tx_len;
+
+        if (n > len)
+            n = len;
+        memcpy(s_tx + s_tx_len, msg, n);
+        s_tx_len = (uint16_t)(s_tx_len + n);
+        msg += n;
+        len -= n;
+        if (s_tx_len == sizeof(s_tx))
+            cli_io_tx_flush(sn);
+    }
+}
+
+void cli_send(uint8_t sn, const char *msg)
+{
+    // "" is only the prompt of cli_flush()
+    if (*msg) {
+        s_stats.writes++;
+        tx_put(sn, msg, strlen(msg));
+    }
+}
+
+void cli_flush(uint8_t sn, const char *msg)
+{
+    cli_send(sn, msg);
+    s_stats.writes++;
+    tx_put(sn, TELNET_PROMPT, sizeof(TELNET_PROMPT) - 1);
+}
+
+/* ---------- RX ---------- */
+static bool end_line(cli_io_rx_t *rx, uint8_t sn)
+{
+    bool ran = false;
+
+    if (rx->too_long) {
+        s_stats.dropped++;
+        cli_flush(sn, "Line too long\r\n");
+    } else if (s_on_line) {
+        rx->line[rx->len] = '\0';
+        rx->lines++;
+        s_stats.lines++;
+        s_on_line(rx->line, sn);    // may cli_io_stop()
+        ran = true;
+    }
+    rx->len = 0;
+    rx->too_long = false;
+    return ran;
+}
+
+/* false: byte taken by a telnet command */
+static bool telnet_byte(cli_io_rx_t *rx, uint8_t c)
+{
+    switch (rx->iac) {
+    case IAC_NONE:
+        if (c != IAC)
+            return true;
+        rx->iac = IAC_CMD;
+        break;
+    case IAC_CMD:
+        // IAC IAC is a data 255, not a character of a command line either
+        rx->iac = (c >= WILL && c <= DONT) ? IAC_OPT : (c == SB) ? IAC_SB_DATA : IAC_NONE;
+        break;
+    case IAC_OPT:
+        rx->iac = IAC_NONE;
+        break;
+    case IAC_SB_DATA:
+        if (c == IAC)
+            rx->iac = IAC_SB_IAC;
+        break;
+    default:
+        rx->iac = (c == SE) ? IAC_NONE : IAC_SB_DATA;
+        break;
+    }
+    return false;
+}
+
+uint16_t cli_io_rx(cli_io_rx_t *rx, uint8_t sn, const uint8_t *data, uint16_t len, uint16_t max_lines)
+{
+    uint16_t ran = 0, i = 0;
+
+    s_rx = rx;
+    rx->stop = false;
+    while (i < len && ran < max_lines) {
+        uint8_t c = data[i++];
+        bool after_cr = rx->cr;
+
+        if (!telnet_byte(rx, c))
+            continue;
+        rx->cr = false;
+
+        if (c == '\r' || (c == '\n' && !after_cr)) {
+            rx->cr = (c == '\r');
+            if (end_line(rx, sn))
+                ran++;
+            if (rx->stop) {
+                i = len;            // the rest of the read goes with the connection
+                break;
+            }
+        } else if (c == '\b' || c == 0x7F) {
+            if (rx->len && !rx->too_long)
+                rx->len--;
+        } else if (c >= ' ' || c == '\t') {
+            if (rx->len < sizeof(rx->line) - 1)
+                rx->line[rx->len++] = (char)c;
+            else
+                rx->too_long = true;
+        }
+        // NUL after CR, LF after CR, other control characters: nothing
+    }
+    s_rx = NULL;
+    return i;
+}
+
+const cli_io_stats_t *cli_io_stats(void)
+{
+    return &s_stats;
+}
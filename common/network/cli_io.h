@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cli_cmd.h"
+
+/**
+ * Byte stream side of the telnet CLI.
+ *
+ * RX: bytes of every recv() are put together into lines, whatever the
+ * packet boundaries are, in one cli_io_rx_t per connection. A line ends at
+ * CR, LF, CRLF or CR NUL, so a pasted script runs line by line and a
+ * command split over two packets runs once.
+ * Telnet option negotiation (IAC ...) is dropped, backspace and DEL erase,
+ * other control characters are ignored. A line longer than CLI_LINE_MAX is
+ * dropped up to its end and answered with "Line too long".
+ *
+ * TX: cli_send() / cli_flush() append to one buffer instead of one W6100
+ * send() each. The buffer goes out when full and once per service pass
+ * (cli_io_tx_flush()), so the answer of a command is one TCP segment
+ * instead of one per line.
+ *
+ * No SDK dependency: send() and the line handler are passed in.
+ */
+#define CLI_TX_BUF_SIZE     1460    // one full segment, less than the socket TX buffer
+
+/* the W6100 send(); < 0 when the socket is gone */
+typedef int32_t (*cli_io_send_fn)(uint8_t sn, uint8_t *buf, uint16_t len);
+
+/* one complete line, without its end of line; writable */
+typedef void (*cli_io_line_fn)(char *line, uint8_t sn);
+
+/* line assembly of one connection */
+typedef struct {
+    char     line[CLI_LINE_MAX];
+    uint16_t len;
+    bool     too_long;              // the line went past CLI_LINE_MAX
+    bool     cr;                    // last line ended with CR: LF or NUL after it is the same end
+    bool     stop;                  // cli_io_stop() from a line handler
+    uint8_t  iac;                   // telnet command state
+    uint32_t lines;                 // lines run
+} cli_io_rx_t;
+
+typedef struct {
+    uint32_t lines;                 // lines handed to the handler
+    uint32_t dropped;               // lines too long
+    uint32_t writes;                // cli_send() / cli_flush() messages and prompts
+    uint32_t segments;              // send() calls
+    uint32_t bytes;
+} cli_io_stats_t;
+
+void cli_io_init(cli_io_send_fn send_fn, cli_io_line_fn on_line);
+
+/* new connection: drops the partial line */
+void cli_io_rx_reset(cli_io_rx_t *rx);
+
+/* feeds received bytes, runs the complete lines, at most max_lines of them;
+   returns the bytes used, the rest is for the next call */
+uint16_t cli_io_rx(cli_io_rx_t *rx, uint8_t sn, const uint8_t *data, uint16_t len, uint16_t max_lines);
+
+/* from a line handler: the rest of the read being run and the partial
+   line are dropped, the pending output too */
+void cli_io_stop(void);
+
+/* sends the pending output now */
+void cli_io_tx_flush(uint8_t sn);
+
+const cli_io_stats_t *cli_io_stats(void);
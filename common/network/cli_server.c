@@ -0,0 +1,214 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "pico/stdio.h"
+#include "pico/time.h"
+#include "cli_server.h"
+
+static cli_session_t   s_sessions[CLI_SESSIONS_MAX];
+static uint8_t         s_count;
+static uint8_t         s_next;      // first turn of the next pass
+static uint16_t        s_port;
+static uint64_t        s_timeout_us;
+static tcp_cli_hooks_t s_hooks;
+
+/* cli_io line handler */
+static void on_line(char *line, uint8_t sn)
+{
+    printf("[CLI] %d: '%s'\r\n", sn, line);
+    if (s_hooks.handle_command)
+        s_hooks.handle_command(line, sn);
+    else
+        cli_send(sn, "No command handler\r\n");
+}
+
+void cli_server_init(uint8_t first, uint8_t n, uint16_t port,
+                     uint32_t timeout_ms)
+{
+    if (n > CLI_SESSIONS_MAX)
+        n = CLI_SESSIONS_MAX;
+    memset(s_sessions, 0, sizeof(s_sessions));
+    for (uint8_t i = 0; i < n; i++)
+        s_sessions[i].sn = (uint8_t)(first + i);
+    s_count = n;
+    s_next = 0;
+    s_port = port;
+    s_timeout_us = (uint64_t)timeout_ms * 1000u;
+    cli_io_init(cli_sock_send, on_line);
+}
+
+void cli_server_hooks(const tcp_cli_hooks_t *hooks)
+{
+    if (hooks)
+        s_hooks = *hooks;
+    else
+        memset(&s_hooks, 0, sizeof(s_hooks));
+}
+
+static cli_session_t *find(uint8_t sn)
+{
+    for (uint8_t i = 0; i < s_count; i++)
+        if (s_sessions[i].sn == sn)
+            return &s_sessions[i];
+    return NULL;
+}
+
+static void end(cli_session_t *s, const char *why)
+{
+    printf("[CLI] %d: %s, closed\r\n", s->sn, why);
+    s->connected = false;
+    s->in_len = s->in_pos = 0;
+    cli_io_rx_reset(&s->rx);
+}
+
+/* one line of the session, read as far as needed for it; true when more is waiting */
+static bool run_line(cli_session_t *s, uint64_t now)
+{
+    uint8_t sn = s->sn;
+
+    // a line over CLI_TURN_BYTES takes more reads, bytes without a line (the
+    // LF of a CRLF, telnet options) do not make a turn on their own
+    for (uint8_t reads = 0; reads < CLI_LINE_MAX / CLI_TURN_BYTES + 1; ) {
+        if (s->in_pos == s->in_len) {
+            uint16_t size = cli_sock_rx_size(sn);
+            if (size == 0)
+                return false;
+            uint16_t n = (size < sizeof(s->in)) ? size : (uint16_t)sizeof(s->in);
+            int32_t ret = cli_sock_recv(sn, s->in, n);
+            if (ret <= 0)
+                return false;
+            s->in_len = (uint8_t)ret;
+            s->in_pos = 0;
+            s->in_more = (size > n);
+            s->last_rx_us = now;
+            s->reads++;
+            reads++;
+        }
+
+        uint32_t lines = s->rx.lines;
+        uint16_t used = cli_io_rx(&s->rx, sn, s->in + s->in_pos, (uint16_t)(s->in_len - s->in_pos), 1);
+        if (!s->connected)
+            return false;           // "exit": end() dropped the rest
+        s->in_pos = (uint8_t)(s->in_pos + used);
+        if (s->rx.lines != lines)
+            break;
+    }
+    return s->in_pos < s->in_len || s->in_more;
+}
+
+static bool established(cli_session_t *s)
+{
+    uint64_t now = time_us_64();
+    uint8_t sn = s->sn;
+
+    if (cli_sock_accepted(sn, s->ip)) {
+        printf("[CLI] %d: connected from %d.%d.%d.%d\r\n", sn, s->ip[0], s->ip[1], s->ip[2], s->ip[3]);
+        s->connected = true;
+        s->last_rx_us = now;
+        s->reads = 0;
+        s->connects++;
+        s->in_len = s->in_pos = 0;
+        cli_io_rx_reset(&s->rx);
+        if (s_hooks.on_connect)
+            s_hooks.on_connect(sn, s->ip);
+    }
+    if (!s->connected)
+        return false;
+
+    if (run_line(s, now))
+        return true;
+    if (s->connected && now - s->last_rx_us >= s_timeout_us) {
+        cli_send(sn, "timeout\r\n");
+        cli_io_tx_flush(sn);
+        cli_sock_disconnect(sn);
+        end(s, "idle timeout");
+    }
+    return false;
+}
+
+/* first turn of a session in a pass; true when it has more to run */
+static bool turn(cli_session_t *s)
+{
+    uint8_t st = cli_sock_status(s->sn);
+
+    if (s->connected && st != CLI_SOCK_ESTABLISHED)
+        end(s, "peer gone");
+
+    switch (st) {
+    case CLI_SOCK_ESTABLISHED:
+        return established(s);
+    case CLI_SOCK_CLOSE_WAIT:
+        cli_sock_disconnect(s->sn);
+        break;
+    case CLI_SOCK_INIT:
+        if (!cli_sock_listen(s->sn))
+            printf("[CLI] %d: listen error\r\n", s->sn);
+        break;
+    case CLI_SOCK_CLOSED:
+        if (!cli_sock_open(s->sn, s_port))
+            printf("[CLI] %d: socket open error\r\n", s->sn);
+        break;
+    default:
+        break;
+    }
+    return false;
+}
+
+void cli_server_service(void)
+{
+    uint64_t start = time_us_64();
+    uint8_t more = 0;               // bit i: session i has more to run
+    bool first = true, over = false;
+
+    // first round: every session; then rounds over the ones with more to run
+    for (uint8_t round = 0; !over && (round == 0 || more); round++) {
+        for (uint8_t k = 0; k < s_count; k++) {
+            uint8_t i = s_next;
+            cli_session_t *s = &s_sessions[i];
+
+            if (round && !(more >> i & 1u)) {
+                s_next = (uint8_t)((i + 1u) % s_count);
+                continue;
+            }
+            if (!first && time_us_64() - start >= CLI_PASS_BUDGET_US) {
+                over = true;        // s_next goes first in the next pass
+                break;
+            }
+            first = false;
+            s_next = (uint8_t)((i + 1u) % s_count);
+
+            bool again = round ? run_line(s, time_us_64()) : turn(s);
+            more = (uint8_t)(again ? (more | 1u << i) : (more & ~(1u << i)));
+        }
+    }
+
+    // the output of the pass, one segment per session
+    for (uint8_t i = 0; i < s_count; i++)
+        cli_io_tx_flush(s_sessions[i].sn);
+}
+
+void cli_server_close(uint8_t sn)
+{
+    cli_session_t *s = find(sn);
+
+    cli_io_tx_flush(sn);
+    cli_sock_disconnect(sn);
+    if (s && s->connected)
+        end(s, "exit");
+    cli_io_stop();                  // after end(): its rx reset would clear the stop
+}
+
+uint8_t cli_server_count(void)
+{
+    return s_count;
+}
+
+const cli_session_t *cli_server_session(uint8_t i)
+{
+    return (i < s_count) ? &s_sessions[i] : NULL;
+}
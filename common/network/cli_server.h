@@ -0,0 +1,83 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cli_io.h"
+#include "tcp_cli.h"
+
+/**
+ * Telnet CLI server on a pool of W6100 sockets.
+ *
+ * Sockets first .. first + n - 1 all listen on the CLI port, so every
+ * connection gets its own socket and session: its own line assembly, peer
+ * address and idle timer. A second client is taken while the first one
+ * is connected, and a stale connection only holds its own socket until
+ * its idle timeout.
+ *
+ * cli_server_service() is one pass: sessions take turns round-robin, one
+ * command each, in rounds while any has more, until CLI_PASS_BUDGET_US is
+ * used. The session whose turn did not come goes first in the next pass.
+ * A client pasting a long script so gets the time the others leave, and a
+ * typing one waits at most for one command of each other session. Every
+ * session reads at most CLI_TURN_BYTES at a time into its own buffer, the
+ * rest stays in its socket. Output goes out once per pass (cli_io.c).
+ *
+ * No SDK dependency: the socket layer is cli_sock_*() below, in network.c
+ * on the board, and the clock is time_us_64().
+ */
+#define CLI_SESSIONS_MAX        4
+#define CLI_PASS_BUDGET_US      800     // sched "cli" task budget 1000 us
+#define CLI_TURN_BYTES          128     // read of a session, a dozen short commands
+
+/* Sn_SR of a socket, as far as the server cares */
+enum {
+    CLI_SOCK_CLOSED,
+    CLI_SOCK_INIT,
+    CLI_SOCK_LISTEN,
+    CLI_SOCK_ESTABLISHED,
+    CLI_SOCK_CLOSE_WAIT,
+    CLI_SOCK_OTHER,             // opening or closing
+};
+
+typedef struct {
+    uint8_t     sn;
+    bool        connected;
+    uint8_t     ip[4];          // peer, while connected
+    uint64_t    last_rx_us;
+    uint32_t    reads;          // recv() on this connection
+    uint32_t    connects;       // connections taken on this socket
+    uint8_t     in[CLI_TURN_BYTES];     // last read, in[in_pos..in_len-1] not run yet
+    uint8_t     in_len, in_pos;
+    bool        in_more;        // the socket had more than the read
+    cli_io_rx_t rx;             // rx.lines: lines run on this connection
+} cli_session_t;
+
+/* socket layer */
+uint8_t  cli_sock_status(uint8_t sn);               // CLI_SOCK_*
+bool     cli_sock_accepted(uint8_t sn, uint8_t ip[4]);  // new connection: clears the event, peer address
+uint16_t cli_sock_rx_size(uint8_t sn);
+int32_t  cli_sock_recv(uint8_t sn, uint8_t *buf, uint16_t len);
+int32_t  cli_sock_send(uint8_t sn, uint8_t *buf, uint16_t len);
+uint16_t cli_sock_tx_free(uint8_t sn);             // send() of up to this many bytes does not wait
+bool     cli_sock_open(uint8_t sn, uint16_t port);
+bool     cli_sock_listen(uint8_t sn);
+void     cli_sock_disconnect(uint8_t sn);
+
+/* sessions on sockets first .. first + n - 1 */
+void cli_server_init(uint8_t first, uint8_t n, uint16_t port, uint32_t timeout_ms);
+void cli_server_hooks(const tcp_cli_hooks_t *hooks);
+
+/* one pass over the sessions, within CLI_PASS_BUDGET_US */
+void cli_server_service(void);
+
+/* from a command: sends its output, closes the connection, drops the rest of its read */
+void cli_server_close(uint8_t sn);
+
+uint8_t cli_server_count(void);
+const cli_session_t *cli_server_session(uint8_t i);
@@ -0,0 +1,435 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "wizchip_conf.h"
+#include "cli_cmd.h"
+#include "cli_sys.h"
+#include "cli_server.h"
+#include "network.h"
+#include "partition.h"
+#include "flash_cfg.h"
+#include "kv_store.h"
+#include "efu_update.h"
+#include "sched.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "dlog.h"
+
+static const char *s_project;
+static const char *s_version;
+
+static bool cmd_info(const cli_ctx_t *ctx)
+{
+    char msg[96];
+    const char *efu_stat_msg = "UNKNOWN";
+    uint8_t efu_status = get_efu_socket_status();
+
+    switch (efu_status) {
+        case SOCK_CLOSED:       efu_stat_msg = "SOCK_CLOSED"; break;
+        case SOCK_INIT:         efu_stat_msg = "SOCK_INIT"; break;
+        case SOCK_LISTEN:       efu_stat_msg = "SOCK_LISTEN"; break;       // after listen(TCP_EFU_SOCKET)
+        case SOCK_ESTABLISHED:  efu_stat_msg = "SOCK_ESTABLISHED"; break;
+        case SOCK_CLOSE_WAIT:   efu_stat_msg = "SOCK_CLOSE_WAIT"; break;
+    }
+
+    snprintf(msg, sizeof(msg),
+        "Project : %s\r\n"
+        "FW      : %s\r\n"
+        "EFU stat: 0x%x (%s)\r\n",
+        s_project, s_version, efu_status, efu_stat_msg);
+    cli_flush(ctx->sn, msg);
+    return true;
+}
+
+static bool cmd_part(const cli_ctx_t *ctx)
+{
+    char msg[800];     // current use 407 bytes
+    int len = partition_info(msg, sizeof(msg));
+
+    printf("Telnet sent %d bytes to console\r\n", len);
+    cli_flush(ctx->sn, msg);
+    return true;
+}
+
+static bool cmd_tasks(const cli_ctx_t *ctx)
+{
+    char msg[800];     // 9 tasks use ~720 bytes
+
+    sched_show(msg, sizeof(msg));
+    cli_flush(ctx->sn, msg);
+    return true;
+}
+
+static bool cmd_tasks_reset(const cli_ctx_t *ctx)
+{
+    sched_reset_stats();
+    cli_flush(ctx->sn, "Task statistics cleared\r\n");
+    return true;
+}
+
+/* config ip|sn|gw|dns <a.b.c.d>: edits config[1], saved with config save */
+static bool cmd_config_addr(const cli_ctx_t *ctx, uint8_t *dst, const char *what)
+{
+    uint8_t addr[4];
+    char msg[40];
+
+    if (!cli_arg_ipv4(ctx->argv[0], addr))
+        return false;
+    memcpy(dst, addr, sizeof(addr));
+    snprintf(msg, sizeof(msg), "%s updated\r\n", what);
+    cli_flush(ctx->sn, msg);
+    return true;
+}
+
+static bool cmd_config_ip(const cli_ctx_t *ctx)
+{
+    return cmd_config_addr(ctx, config_get(1)->net_info.ip, "IP");
+}
+
+static bool cmd_config_sn(const cli_ctx_t *ctx)
+{
+    return cmd_config_addr(ctx, config_get(1)->net_info.sn, "Subnet mask");
+}
+
+static bool cmd_config_gw(const cli_ctx_t *ctx)
+{
+    return cmd_config_addr(ctx, config_get(1)->net_info.gw, "Gateway");
+}
+
+static bool cmd_config_dns(const cli_ctx_t *ctx)
+{
+    return cmd_config_addr(ctx, config_get(1)->net_info.dns, "DNS");
+}
+
+static bool cmd_config_save(const cli_ctx_t *ctx)
+{
+    char msg[30];
+    bool ret = config_save(config_get(1));
+
+    snprintf(msg, sizeof(msg), "Config saved to flash: %d\r\n", ret);
+    cli_flush(ctx->sn, msg);
+    return true;
+}
+
+static bool cmd_config_show(const cli_ctx_t *ctx)
+{
+    char msg[200];     // current use ??? bytes
+
+    for (uint8_t id = 0; id < 3; id++) {
+        int len = config_show(config_get(id), id, msg, sizeof(msg));   // sending > 102 bytes
+
+        printf("Telnet sent %d bytes to console for config[%u]\r\n", len, id);
+        if (id < 2)
+            cli_send(ctx->sn, msg);
+        else
+            cli_flush(ctx->sn, msg);
+    }
+    return true;
+}
+
+static bool cmd_config_store(const cli_ctx_t *ctx)
+{
+    char msg[400];     // ~220 bytes, 320 with every counter at its widest
+
+    kv_show(msg, sizeof(msg));
+    cli_flush(ctx->sn, msg);
+    return true;
+}
+
+static bool cmd_config_clean(const cli_ctx_t *ctx)
+{
+    config_recovery();
+    cli_flush(ctx->sn, "Configuration cleaned\r\n");
+    return true;
+}
+
+static bool cmd_config_default(const cli_ctx_t *ctx)
+{
+    config_default();
+    cli_flush(ctx->sn, "Factory default configuration restored\r\n");
+    return true;
+}
+
+static bool cmd_who(const cli_ctx_t *ctx)
+{
+    char msg[96];
+    uint64_t now = time_us_64();
+
+    cli_send(ctx->sn, "sock  peer             idle s  lines  connects\r\n");
+    for (uint8_t i = 0; i < cli_server_count(); i++) {
+        const cli_session_t *s = cli_server_session(i);
+        char peer[16] = "-";
+
+        if (s->connected)
+            snprintf(peer, sizeof(peer), "%u.%u.%u.%u", s->ip[0], s->ip[1], s->ip[2], s->ip[3]);
+        snprintf(msg, sizeof(msg), "%4u  %-15s  %6lu  %5lu  %8lu%s\r\n", s->sn, peer,
+                 s->connected ? (unsigned long)((now - s->last_rx_us) / 1000000u) : 0ul,
+                 (unsigned long)s->rx.lines, (unsigned long)s->connects,
+                 (s->sn == ctx->sn) ? "  (you)" : "");
+        cli_send(ctx->sn, msg);
+    }
+    cli_flush(ctx->sn, "");
+    return true;
+}
+
+static bool cmd_tlm(const cli_ctx_t *ctx)
+{
+    char msg[160];
+    uint8_t ip[4];
+    uint16_t port;
+
+    udp_tlm_get_dest(ip, &port);
+    snprintf(msg, sizeof(msg),
+        "Telemetry: %s, period %lu ms, to %u.%u.%u.%u:%u\r\n"
+        "Sent     : %lu datagrams, %lu skipped\r\n",
+        tlm_get_period() ? "on" : "off", (unsigned long)tlm_get_period(),
+        ip[0], ip[1], ip[2], ip[3], port,
+        (unsigned long)tlm_seq(), (unsigned long)tlm_counter(TLM_TX_SKIPPED));
+    cli_flush(ctx->sn, msg);
+    return true;
+}
+
+/* tlm rate <ms>: 0 stops the datagrams */
+static bool cmd_tlm_rate(const cli_ctx_t *ctx)
+{
+    uint32_t ms;
+
+    if (!cli_arg_u32(ctx->argv[0], 0, 60000, &ms))
+        return false;
+    tlm_set_period(ms);
+    return cmd_tlm(ctx);
+}
+
+/* tlm dest <a.b.c.d> [port]: until reboot */
+static bool cmd_tlm_dest(const cli_ctx_t *ctx)
+{
+    uint8_t ip[4];
+    uint16_t port;
+    uint32_t v;
+
+    udp_tlm_get_dest(ip, &port);
+    if (!cli_arg_ipv4(ctx->argv[0], ip))
+        return false;
+    if (ctx->argc > 1) {
+        if (!cli_arg_u32(ctx->argv[1], 1, 65535, &v))
+            return false;
+        port = (uint16_t)v;
+    }
+    udp_tlm_dest(ip, port);
+    return cmd_tlm(ctx);
+}
+
+#if TRACE_ENABLE
+static bool cmd_trace(const cli_ctx_t *ctx)
+{
+    char msg[96];
+
+    snprintf(msg, sizeof(msg), "Trace: %s, %u events per core\r\n",
+             trace_enabled() ? "on" : "stopped", TRACE_RING_SIZE);
+    cli_send(ctx->sn, msg);
+    for (uint8_t c = 0; c < TRACE_CORES; c++) {
+        uint32_t n = trace_written(c);
+
+        snprintf(msg, sizeof(msg), "core %u : %lu written, %lu held\r\n", c,
+                 (unsigned long)n, (unsigned long)(n < TRACE_RING_SIZE ? n : TRACE_RING_SIZE));
+        cli_send(ctx->sn, msg);
+    }
+    cli_flush(ctx->sn, "");
+    return true;
+}
+
+static bool cmd_trace_start(const cli_ctx_t *ctx)
+{
+    trace_clear();
+    trace_enable(true);
+    return cmd_trace(ctx);
+}
+
+static bool cmd_trace_stop(const cli_ctx_t *ctx)
+{
+    trace_enable(false);
+    return cmd_trace(ctx);
+}
+
+static void trace_put(void *ctx, const char *line)
+{
+    cli_send(((const cli_ctx_t *)ctx)->sn, line);
+}
+
+/* for tools/trace/trace2perfetto.py: task names, then the rings (~35 bytes an event) */
+static bool cmd_trace_dump(const cli_ctx_t *ctx)
+{
+    char msg[40];
+    const sched_task_t *t;
+
+    for (int id = 0; (t = sched_get_task(id)) != NULL; id++) {
+        snprintf(msg, sizeof(msg), "T %d %s\r\n", id, t->name);
+        cli_send(ctx->sn, msg);
+    }
+    trace_dump(trace_put, (void *)ctx);
+    cli_flush(ctx->sn, "");
+    return true;
+}
+#endif // TRACE_ENABLE
+
+/* ---------- deferred log (dlog.h) ---------- */
+static uint8_t s_log_sn = 0xff;         // session of "log cli on"
+
+/* the session of "log cli on" while it is connected; busy is skipped, not waited for */
+static bool log_cli_out(const char *text, uint16_t len)
+{
+    uint8_t sn = s_log_sn;
+
+    if (sn == 0xff || cli_sock_status(sn) != CLI_SOCK_ESTABLISHED) {
+        s_log_sn = 0xff;                // the session is gone, so is the output
+        dlog_route(DLOG_OUT_CLI, false);
+        return false;
+    }
+    // what cli_io.c holds plus these lines, so the send() below does not wait
+    if (cli_sock_tx_free(sn) < CLI_TX_BUF_SIZE + len)
+        return false;
+    cli_send(sn, text);
+    cli_io_tx_flush(sn);
+    return true;
+}
+
+static bool cmd_log(const cli_ctx_t *ctx)
+{
+    static const char *const names[DLOG_OUTS] = { "usb", "cli", "udp" };
+    const dlog_stats_t *st = dlog_stats();
+    char msg[160];
+    uint8_t ip[4];
+    uint16_t port;
+
+    udp_log_get_dest(ip, &port);
+    snprintf(msg, sizeof(msg),
+        "Log    : usb %s, cli %s, udp %s to %u.%u.%u.%u:%u\r\n"
+        "Records: %lu logged, %lu dropped, %lu suppressed, %lu waiting, %lu of %u used at most\r\n",
+        dlog_routed(DLOG_OUT_USB) ? "on" : "off",
+        dlog_routed(DLOG_OUT_CLI) ? "on" : "off",
+        dlog_routed(DLOG_OUT_UDP) ? "on" : "off", ip[0], ip[1], ip[2], ip[3], port,
+        (unsigned long)st->logged, (unsigned long)st->dropped, (unsigned long)st->suppressed,
+        (unsigned long)dlog_pending(), (unsigned long)st->used_max, DLOG_RING_SIZE);
+    cli_send(ctx->sn, msg);
+    for (int o = 0; o < DLOG_OUTS; o++) {
+        if (!st->lost[o])
+            continue;
+        snprintf(msg, sizeof(msg), "Lost   : %lu lines on %s, output busy\r\n",
+                 (unsigned long)st->lost[o], names[o]);
+        cli_send(ctx->sn, msg);
+    }
+    cli_flush(ctx->sn, "");
+    return true;
+}
+
+static const char *const s_onoff[] = { "off", "on" };
+
+static bool cmd_log_usb(const cli_ctx_t *ctx)
+{
+    int on = cli_arg_enum(ctx->argv[0], s_onoff, (uint8_t)count_of(s_onoff));
+
+    if (on < 0)
+        return false;
+    dlog_route(DLOG_OUT_USB, on != 0);
+    return cmd_log(ctx);
+}
+
+/* log cli on: this session only, until it is closed or another one takes it */
+static bool cmd_log_cli(const cli_ctx_t *ctx)
+{
+    int on = cli_arg_enum(ctx->argv[0], s_onoff, (uint8_t)count_of(s_onoff));
+
+    if (on < 0)
+        return false;
+    if (on) {
+        s_log_sn = ctx->sn;
+        dlog_output(DLOG_OUT_CLI, log_cli_out);
+    } else if (s_log_sn != ctx->sn && s_log_sn != 0xff) {
+        cli_flush(ctx->sn, "Log goes to another session\r\n");
+        return true;
+    }
+    dlog_route(DLOG_OUT_CLI, on != 0);
+    return cmd_log(ctx);
+}
+
+/* log udp <a.b.c.d> [port] | off */
+static bool cmd_log_udp(const cli_ctx_t *ctx)
+{
+    uint8_t ip[4];
+    uint16_t port;
+    uint32_t v;
+
+    if (!strcmp(ctx->argv[0], "off")) {
+        dlog_route(DLOG_OUT_UDP, false);
+        return cmd_log(ctx);
+    }
+    udp_log_get_dest(ip, &port);
+    if (!cli_arg_ipv4(ctx->argv[0], ip))
+        return false;
+    if (ctx->argc > 1) {
+        if (!cli_arg_u32(ctx->argv[1], 1, 65535, &v))
+            return false;
+        port = (uint16_t)v;
+    }
+    udp_log_dest(ip, port);
+    dlog_route(DLOG_OUT_UDP, true);
+    return cmd_log(ctx);
+}
+
+static bool cmd_exit(const cli_ctx_t *ctx)
+{
+    cli_send(ctx->sn, "Closing connection...\r\n");
+    cli_io_tx_flush(ctx->sn);       // output is batched: out before the FIN
+    sleep_ms(2);
+    // Graceful disconnect, better to use telnet; commands after exit in the same read are dropped
+    cli_server_close(ctx->sn);
+    // close(sn);      // option, telnet has problems
+    printf("[CLI] Socket %d disconnected by user\r\n", ctx->sn);
+    return true;
+}
+
+static const cli_cmd_t s_cmds[] = {
+    { "info",           "",             "Display board and firmware information",   0, 0, cmd_info },
+    { "part",           "",             "Show partition information",               0, 0, cmd_part },
+    { "tasks",          "",             "Show main loop task timing and deadline misses", 0, 0, cmd_tasks },
+    { "tasks reset",    "",             "Clear the task statistics",                0, 0, cmd_tasks_reset },
+    { "config ip",      "<a.b.c.d>",    "Set IP address",                           1, 1, cmd_config_ip },
+    { "config sn",      "<a.b.c.d>",    "Set Subnet Mask",                          1, 1, cmd_config_sn },
+    { "config gw",      "<a.b.c.d>",    "Set Gateway",                              1, 1, cmd_config_gw },
+    { "config dns",     "<a.b.c.d>",    "Set DNS server",                           1, 1, cmd_config_dns },
+    { "config save",    "",             "Save current config to flash",             0, 0, cmd_config_save },
+    { "config show",    "",             "Show current config values",               0, 0, cmd_config_show },
+    { "config store",   "",             "Show the config store: keys, space, erases", 0, 0, cmd_config_store },
+    { "config clean",   "",             "Clean current config (use default)",       0, 0, cmd_config_clean },
+    { "config default", "",             "Restore factory default configuration",    0, 0, cmd_config_default },
+    { "tlm",            "",             "Show the telemetry stream",                0, 0, cmd_tlm },
+    { "tlm rate",       "<ms>",         "Set the telemetry period, 0 = off",        1, 1, cmd_tlm_rate },
+    { "tlm dest",       "<a.b.c.d> [port]", "Send the telemetry to another receiver", 1, 2, cmd_tlm_dest },
+#if TRACE_ENABLE
+    { "trace",          "",             "Show the trace rings",                     0, 0, cmd_trace },
+    { "trace start",    "",             "Clear the trace rings and trace",          0, 0, cmd_trace_start },
+    { "trace stop",     "",             "Stop tracing, keep the rings",             0, 0, cmd_trace_stop },
+    { "trace dump",     "",             "Dump the trace rings (tools/trace)",       0, 0, cmd_trace_dump },
+#endif
+    { "log",            "",             "Show the deferred log and its outputs",    0, 0, cmd_log },
+    { "log usb",        "on|off",       "Log to the USB console",                   1, 1, cmd_log_usb },
+    { "log cli",        "on|off",       "Log to this CLI session",                  1, 1, cmd_log_cli },
+    { "log udp",        "<a.b.c.d> [port]|off", "Log as UDP datagrams of text lines", 1, 2, cmd_log_udp },
+    { "who",            "",             "List the CLI sessions",                    0, 0, cmd_who },
+    { "exit",           "",             "Close the CLI connection",                 0, 0, cmd_exit },
+};
+
+void cli_sys_register(const char *project, const char *version)
+{
+    s_project = project;
+    s_version = version;
+    if (!cli_cmd_register(s_cmds, (uint8_t)count_of(s_cmds)))
+        printf("[CLI] system commands not registered: index full or a name taken\r\n");
+}
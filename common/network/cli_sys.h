@@ -0,0 +1,13 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+/**
+ * CLI commands every app has: info, part, tasks, config and exit.
+ * project and version are shown by info and must stay valid.
+ */
+void cli_sys_register(const char *project, const char *version);
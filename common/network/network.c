@@ -19,6 +19,7 @@
 #include <stdio.h>  
 #include <string.h>
 #include "network.h"
+#include "cli_server.h"
 
 
 //#include <port_common.h>
@@ -31,10 +32,11 @@
 #include "pico/unique_id.h"
 #include "wizchip_conf.h"
 #include "flash_cfg.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "dlog.h"
 
 
-#define _TIME_DEBUG_
-
 // Do not cross this value: _WIZCHIP_SOCK_NUM_ = 8
 //#define TCP_LOOPBACK_SOCKET  0      // with port TCP_LOOPBACK_PORT 8000
 //#define UDP_DDP_SOCKET       5      // with port UDP_DDP_PORT 4048
@@ -47,26 +49,16 @@
 #define DDP_DATA_BUF_SIZE     (DDP_HEADER_LEN + MAX_DDP_PAYLOAD)  // clamp to your RAM
 
 
-// --- CLI Variables ---
-// Buffer used for telnet
-// static uint8_t ethernet_cli_buf[ETHERNET_BUF_MAX_SIZE + 1];
-// static uint8_t *ethernet_cli_buf;
-
-static uint8_t *cli_buf_rx = NULL;  // separate pointer for CLI RX buffer, can be used for other purposes if needed
- // ETHERNET_BUF_MAX_SIZE
-static uint16_t cli_buf_size = 0;  // size of the CLI buffer, set during initialization, should not exceed
- // CLI_TIMEOUT_MS
-static int64_t cli_timeout_ms = 30000;  // 30 seconds timeout for idle CLI connections
-static uint8_t cli_sn = 0xff;
-static uint16_t cli_port = 0;
-static tcp_cli_hooks_t cli_hooks = {0}; // struct for CLI hooks, set during initialization
-
+// --- CLI ---
+// sessions, line buffers and timeouts live in cli_server.c, its socket layer is cli_sock_*() below
 
 // --- DDP Variables ---
 static uint8_t *ddp_buf_frame; // pointer to DDP payload area in the buffer for receiving DDP packets
 static uint16_t ddp_buf_size = 0; // size of the DDP buffer, set during initialization, should not exceed DDP_DATA_BUF_SIZE
 static uint8_t ddp_sn = 0xff; // UDP_DDP_SOCKET
 static uint16_t ddp_port = 0;
+static uint16_t ddp_frame_len = 0;  // end of the highest payload written since the last PUSH
+static ddp_push_fn ddp_on_push = NULL;
 
 // UDP receive buffer for interrupt processing
 #define UDP_RING_COUNT      5
@@ -218,131 +210,181 @@ static void process_ddp_packet(uint8_t *buf, uint16_t recv_len);
 
 
 
+/* ---------- socket layer of cli_server.c ---------- */
+uint8_t cli_sock_status(uint8_t sn) {
+    switch (getSn_SR(sn)) {
+    case SOCK_CLOSED:       return CLI_SOCK_CLOSED;
+    case SOCK_INIT:         return CLI_SOCK_INIT;
+    case SOCK_LISTEN:       return CLI_SOCK_LISTEN;
+    case SOCK_ESTABLISHED:  return CLI_SOCK_ESTABLISHED;
+    case SOCK_CLOSE_WAIT:   return CLI_SOCK_CLOSE_WAIT;
+    default:                return CLI_SOCK_OTHER;
+    }
+}
+
+bool cli_sock_accepted(uint8_t sn, uint8_t ip[4]) {
+    if (!(getSn_IR(sn) & Sn_IR_CON))
+        return false;
+    getSn_DIPR(sn, ip);
+    setSn_IR(sn, Sn_IR_CON);
+    return true;
+}
+
+uint16_t cli_sock_rx_size(uint8_t sn) {
+    return (uint16_t)getSn_RX_RSR(sn);
+}
+
+int32_t cli_sock_recv(uint8_t sn, uint8_t *buf, uint16_t len) {
+    return recv(sn, buf, len);
+}
+
+int32_t cli_sock_send(uint8_t sn, uint8_t *buf, uint16_t len) {
+    return send(sn, buf, len);
+}
+
+uint16_t cli_sock_tx_free(uint8_t sn) {
+    return (uint16_t)getSn_TX_FSR(sn);
+}
+
+bool cli_sock_open(uint8_t sn, uint16_t port) {
+    return socket(sn, Sn_MR_TCP, port, Sn_MR_ND) == (int8_t)sn;
+}
+
+bool cli_sock_listen(uint8_t sn) {
+    return listen(sn) == SOCK_OK;
+}
+
+void cli_sock_disconnect(uint8_t sn) {
+    disconnect(sn);
+}
+
 /**
  * Initialize TCP CLI server parameters
- * @param sn Socket number to use for CLI (must be 0-7 and not used by other services)
- * @param port TCP port to listen on (e.g. 8000)
- * @param buf Pointer to buffer for receiving CLI data (must be allocated by caller)
- * @param buf_size Size of the CLI buffer (must be sufficient for expected command length, e.g. 256 bytes)
+ * @param sn First socket of the CLI (0-7, it and the next sessions - 1 not used by other services)
+ * @param sessions Clients at the same time, one socket each (1..CLI_SESSIONS_MAX)
+ * @param port TCP port to listen on (e.g. 5000)
  * @param timeout_sec Timeout for idle CLI connections in seconds (e.g. 30 seconds)
  */
-void tcp_cli_init(uint8_t sn, uint16_t port,
-                  uint8_t *buf, uint16_t buf_size, int16_t timeout_sec) {
-    cli_sn = sn;
-    cli_port = port;
-    cli_buf_rx = buf;
-    cli_buf_size = buf_size;
-    cli_timeout_ms = timeout_sec * 1000;  // convert to milliseconds
+void tcp_cli_init(uint8_t sn, uint8_t sessions, uint16_t port, int16_t timeout_sec) {
+    cli_server_init(sn, sessions, port, (uint32_t)timeout_sec * 1000u);
 }
 
 void cli_hook_init(const tcp_cli_hooks_t *hooks) {
     // This function can be called during initialization to set up CLI hooks
-    if (hooks)
-        cli_hooks = *hooks;  // copy hooks struct if provided
-    else
-        cli_hooks = (tcp_cli_hooks_t){0}; // initialize to zero if no hooks provided
-
+    cli_server_hooks(hooks);
 }
 
 /**
- * TCP CLI service loop on one socket
+ * TCP CLI service: one round-robin pass over the CLI sockets
  */
 int32_t tcp_cli_service(void) {
-    static absolute_time_t last_rx_time = {0};   // Timestamp of last received byte
-    int32_t ret;
-    uint16_t size;
-    uint8_t destip[4];
-    uint16_t destport;
-
-    switch (getSn_SR((uint32_t)cli_sn)) {
-
-    case SOCK_ESTABLISHED:
-        // On new connection
-        if (getSn_IR((uint32_t)cli_sn) & Sn_IR_CON) {
-            getSn_DIPR((uint32_t)cli_sn, destip);
-            destport = getSn_DPORT((uint32_t)cli_sn);
-
-            printf("[CLI] Socket %d connected from %d.%d.%d.%d:%d\r\n",
-                   cli_sn, destip[0], destip[1], destip[2], destip[3], destport);
+    cli_server_service();
+    return 1;
+}
 
-            setSn_IR((uint32_t)cli_sn, Sn_IR_CON);
 
-            // Reset timeout timer
-            last_rx_time = get_absolute_time();
-            printf("[CLI] established, current time: %lld\r\n", last_rx_time);
+/* ---------- non-blocking datagrams: telemetry.c and dlog.c ---------- */
+typedef struct {
+    uint8_t  sn;                    // 0xff until the socket is open
+    uint8_t  destip[4];
+    uint16_t destport;
+    bool     in_flight;             // SEND issued, SENDOK / TIMEOUT not seen yet
+} udp_nb_t;
 
-            // telnet_greeting(cli_sn, destip);
-            if (cli_hooks.on_connect) {
-                cli_hooks.on_connect(cli_sn, destip);
-            }
-        }
+static udp_nb_t udp_tlm = { .sn = 0xff };
+static udp_nb_t udp_log = { .sn = 0xff };
 
-        // Handle received data
-        size = getSn_RX_RSR(cli_sn);
-        if (size > 0) {
-            if (size >= cli_buf_size) {
-                size = cli_buf_size - 1;  // clamp to buffer size, leaving space for null terminator
-            }
+/**
+ * sendto() waits for SENDOK, and for the ARP timeout (seconds) when the
+ * receiver is not there. This one issues SEND and returns; the previous
+ * datagram has to be finished at the next call, else this one is skipped.
+ */
+static bool udp_send_nb(udp_nb_t *u, const uint8_t *buf, uint16_t len) {
+    uint8_t sn = u->sn;
+
+    if (sn == 0xff)
+        return false;
+    if (u->in_flight) {
+        uint8_t ir = (uint8_t)getSn_IR(sn);
+
+        if (!(ir & (Sn_IR_SENDOK | Sn_IR_TIMEOUT)))
+            return false;           // still resolving the destination
+        setSn_IR(sn, ir & (Sn_IR_SENDOK | Sn_IR_TIMEOUT));
+        u->in_flight = false;
+    }
+    if (getSn_SR(sn) != SOCK_UDP || getSn_TX_FSR(sn) < len)
+        return false;
+
+    setSn_DIPR(sn, u->destip);
+    setSn_DPORTR(sn, u->destport);
+    wiz_send_data(sn, (uint8_t *)buf, len);
+    setSn_CR(sn, Sn_CR_SEND);
+    while (getSn_CR(sn));
+    u->in_flight = true;
+    return true;
+}
 
-            ret = recv(cli_sn, cli_buf_rx, size);
-            if (ret <= 0) return ret;
+static bool udp_nb_open(udp_nb_t *u, uint8_t sn, uint16_t port, const char *what) {
+    if (socket(sn, Sn_MR_UDP4, port, SOCK_IO_NONBLOCK) != (int8_t)sn) {
+        printf("%d : Fail to create %s socket.\r\n", sn, what);
+        return false;
+    }
+    u->sn = sn;
+    return true;
+}
 
-            cli_buf_rx[ret] = 0;
+static bool tlm_udp_send(const uint8_t *buf, uint16_t len) {
+    return udp_send_nb(&udp_tlm, buf, len);
+}
 
-            // Update timeout timestamp
-            last_rx_time = get_absolute_time();
+/**
+ * Open the telemetry socket and start sending
+ * @param sn UDP socket (0-7, not used by other services)
+ * @param port Local port, also the default destination port
+ * @param destip Receiver, e.g. the PC running tools/telemetry/tlm_recv.py
+ * @param period_ms Datagram period, 0 = off
+ */
+void udp_tlm_init(uint8_t sn, uint16_t port, const uint8_t destip[4], uint32_t period_ms) {
+    udp_tlm_dest(destip, port);
+    if (!udp_nb_open(&udp_tlm, sn, port, "telemetry"))
+        return;
+    tlm_init(tlm_udp_send, period_ms);
+}
 
-            // Trim CR/LF
-            char *cmd = (char*)cli_buf_rx;
-            char *newline = strpbrk(cmd, "\r\n");
-            if (newline) *newline = 0;
+void udp_tlm_dest(const uint8_t destip[4], uint16_t port) {
+    memcpy(udp_tlm.destip, destip, sizeof(udp_tlm.destip));
+    udp_tlm.destport = port;
+}
 
-            printf("[CLI] Command received: '%s'\r\n", cmd);
-            if (cli_hooks.handle_command) {
-                cli_hooks.handle_command(cmd, cli_sn);
-            } else {
-                // Default handling if no hook provided
-                const char *msg = "No command handler\r\n";
-                send(cli_sn, (uint8_t*)msg, (uint16_t)strlen(msg));
-            }
-            // handle_command(cmd, cli_sn);
-        } else {
-            // No data – check timeout
-            if (absolute_time_diff_us(last_rx_time, get_absolute_time()) >= (cli_timeout_ms * 1000)) {
-                const char *msg = "timeout\r\n";
-                send(cli_sn, (uint8_t*)msg, (uint16_t)strlen(msg));
-                printf("[CLI] Idle timeout, closing socket %d\r\n", cli_sn);
-                disconnect(cli_sn);
-                return 0;
-            }
-        }
-        break;
+void udp_tlm_get_dest(uint8_t destip[4], uint16_t *port) {
+    memcpy(destip, udp_tlm.destip, sizeof(udp_tlm.destip));
+    *port = udp_tlm.destport;
+}
 
-    case SOCK_CLOSE_WAIT:
-        printf("[CLI] Close wait, closing socket %d\r\n", cli_sn);
-        if ((ret = disconnect(cli_sn)) != SOCK_OK) return ret;
-        break;
+/* one datagram per drain batch: text lines, e.g. for nc -ul 3001 */
+static bool log_udp_send(const char *text, uint16_t len) {
+    return udp_send_nb(&udp_log, (const uint8_t *)text, len);
+}
 
-    case SOCK_INIT:
-        if ((ret = listen(cli_sn)) != SOCK_OK) {
-            printf("[CLI] Listen error %d\r\n", ret);
-            return ret;
-        }
-        printf("[CLI] Listening on port %d\r\n", cli_port);
-        break;
+/**
+ * Open the log socket; the lines go out after "log udp <a.b.c.d>"
+ * @param sn UDP socket (0-7, not used by other services)
+ * @param port Local port, also the default destination port
+ */
+void udp_log_init(uint8_t sn, uint16_t port) {
+    udp_log.destport = port;
+    if (udp_nb_open(&udp_log, sn, port, "log"))
+        dlog_output(DLOG_OUT_UDP, log_udp_send);
+}
 
-    case SOCK_CLOSED:
-        if ((ret = socket(cli_sn, Sn_MR_TCP, cli_port, Sn_MR_ND)) != cli_sn) {
-            printf("[CLI] Socket open error %d\r\n", ret);
-            return ret;
-        }
-        printf("[CLI] Socket %d opened on port %d\r\n", cli_sn, cli_port);
-        break;
+void udp_log_dest(const uint8_t destip[4], uint16_t port) {
+    memcpy(udp_log.destip, destip, sizeof(udp_log.destip));
+    udp_log.destport = port;
+}
 
-    default:
-        break;
-    }
-    return 1;
+void udp_log_get_dest(uint8_t destip[4], uint16_t *port) {
+    memcpy(destip, udp_log.destip, sizeof(udp_log.destip));
+    *port = udp_log.destport;
 }
 
 
@@ -363,24 +405,8 @@ void udp_interrupts_enable(void) {
     ctlwizchip(CW_CLR_INTERRUPT, &ir);  // wizchip_clrinterrupt(*((intr_kind*)arg));
 }
 
-#ifdef _TIME_DEBUG_
-static volatile uint32_t time_irq_start = 0, time_routine_start, time_irq_duration, time_routine_duration;
-static volatile uint32_t t_irq_routine_start, time_irq_routine_duration, time_irq_routine_max = 0;
-static volatile uint8_t irq_loop_count = 0, drain_loop_count = 0;
-static volatile uint8_t irq_packet_count = 0, irq_error_count = 0;
-
-#define TABLE_IRQ_SIZE 12
-static volatile uint32_t time_table_irq[TABLE_IRQ_SIZE];
-static volatile uint8_t time_table_idx = 0;
-static volatile uint32_t time_table_duration[TABLE_IRQ_SIZE];
-static volatile uint8_t time_duration_idx = 0;
-
-static volatile uint16_t received_size_table[TABLE_IRQ_SIZE];
-static volatile uint8_t received_size_table_idx = 0;
-
-static volatile uint32_t ik_pending_table[TABLE_IRQ_SIZE];
-static volatile uint8_t ik_pending_table_idx = 0;
-#endif
+// IRQ timing goes to telemetry.c, the handler stamps its start for ddp_loop()
+static volatile uint32_t irq_start_us;
 
 // This will be called when INTn (GPIO 21) goes low
 /* void wiznet_gpio_irq_handler_single_socket(uint gpio, uint32_t events)
@@ -473,19 +499,15 @@ void wiznet_gpio_irq_handler(uint gpio, uint32_t events)
     uint8_t addr_len;
     // uint8_t sn_ir;
     SOCKET sock_num = ddp_sn;
+    uint32_t got = 0;
+    uint8_t slot = udp_ring_idx;
 
-#ifdef _TIME_DEBUG_
-    t_irq_routine_start = time_us_32();
-    time_table_irq[time_table_idx] = t_irq_routine_start - time_irq_start;
-    time_table_idx++;
-    if (time_table_idx >= TABLE_IRQ_SIZE)
-        time_table_idx = 0;
-    time_irq_start = t_irq_routine_start;
+    uint32_t t_start = time_us_32();
+    TRACE_BEGIN(TR_W6100_IRQ, 0, 0);
 
-    ik_pending_table[ik_pending_table_idx++] = wizchip_getinterrupt();
-    if (ik_pending_table_idx >= TABLE_IRQ_SIZE)
-        ik_pending_table_idx = 0;
-#endif
+    // latency is counted from the first IRQ ddp_loop() has not seen yet
+    if (!wiznet_rx_pending)
+        irq_start_us = t_start;
     // for all sockets, check which have pending interrupts
     // this part is simplified to just one socket here
     //
@@ -507,11 +529,15 @@ void wiznet_gpio_irq_handler(uint gpio, uint32_t events)
                                    (uint16_t *)&srcport,
                                    &addr_len);
                     if (ret > 0) {
+                        if (udp_rx_buf_len[udp_ring_idx])
+                            tlm_count(TLM_DDP_OVERRUNS, 1);     // ddp_loop() is a ring behind
                         udp_rx_buf_len[udp_ring_idx++] = (uint16_t)ret;
                         udp_ring_idx %= UDP_RING_COUNT;
+                        tlm_count(TLM_DDP_PKTS, 1);
+                        tlm_count(TLM_DDP_BYTES, (uint32_t)ret);
+                        got = (uint32_t)ret;
                     } else {
-                        // recv error
-                        // irq_error_count++;
+                        tlm_count(TLM_DDP_ERRORS, 1);
                     }
                 }
                 setSn_IR((uint32_t)sock_num, Sn_IR_RECV);      // clear socket latch
@@ -520,14 +546,8 @@ void wiznet_gpio_irq_handler(uint gpio, uint32_t events)
     //     } // if (pending & sock_bit)
     // } // for all sockets
 
-#ifdef _TIME_DEBUG_
-    time_irq_routine_duration = time_us_32() - t_irq_routine_start;
-    if (time_irq_routine_duration > time_irq_routine_max)
-        time_irq_routine_max = time_irq_routine_duration;
-    time_table_duration[time_duration_idx++] = time_irq_routine_duration;
-    if (time_duration_idx >= TABLE_IRQ_SIZE)
-        time_duration_idx = 0;
-#endif
+    tlm_sample(TLM_IRQ_US, time_us_32() - t_start);
+    TRACE_END(TR_W6100_IRQ, got, slot);
     wiznet_rx_pending = true;
 }
 
@@ -558,7 +578,11 @@ void wiznet_gpio_irq_init(void) {
 }
 
 // was: udp_socket_init(void)
-// new: void tcp_cli_init(uint8_t sn, uint16_t port, uint8_t *buf, uint16_t buf_size, int16_t timeout_sec);
+// new: void tcp_cli_init(uint8_t sn, uint8_t sessions, uint16_t port, int16_t timeout_sec);
+
+void udp_ddp_push_hook(ddp_push_fn on_push) {
+    ddp_on_push = on_push;
+}
 
 void udp_ddp_init(uint8_t sn, uint16_t port, uint8_t *buf, uint16_t buf_size) {
     ddp_sn = sn;
@@ -630,7 +654,6 @@ void process_udp_ring(void) {
     for (uint8_t id = 0; id < UDP_RING_COUNT; id++) {
         // printf("UDP ring slot %d: len=%d\n", id, udp_rx_buf_len[id]);
         if (udp_rx_buf_len[rd_idx] != 0) {
-            drain_loop_count++;
             process_ddp_packet(udp_rx_ring_buf[rd_idx], udp_rx_buf_len[rd_idx]);
             udp_rx_buf_len[rd_idx] = 0;  // mark slot free
         }
@@ -656,46 +679,16 @@ int32_t ddp_loop(void) {
     if (!wiznet_rx_pending) return 0;
     wiznet_rx_pending = false;
 
-    time_irq_duration = time_us_32() - time_irq_start;
-    time_routine_start = time_us_32();
+    // timing goes to telemetry, a printf here would stretch what it measures
+    uint32_t t_start = time_us_32();
+    tlm_sample(TLM_IRQ_LATENCY_US, t_start - irq_start_us);
+    TRACE_BEGIN(TR_DDP_LOOP, 0, 0);
 
-    // printf("WIZnet IRQ serviced in %u us\n", time_irq_duration);
     // wiznet_drain_udp();
     process_udp_ring();
 
-    time_routine_duration = time_us_32() - time_routine_start;
-    printf("WIZnet service, irq_count:%d, pck_cnt:%d, err_cnt:%d,  irq_last:%u, irq_max:%u, pending:%u, routine:%u us, drain_count:%d\n", \
-           irq_loop_count, irq_packet_count, irq_error_count,
-           time_irq_routine_duration, time_irq_routine_max, time_irq_duration, time_routine_duration, drain_loop_count);
-    // don't use it: gpio_set_irq_enabled(WIZNET_INT_PIN, GPIO_IRQ_EDGE_FALL, true);  // re-enable interrupts
-    irq_loop_count = 0;
-    drain_loop_count = 0;
-    irq_packet_count = 0;
-    irq_error_count = 0;
-                //     static volatile uint32_t time_table_irq[TABLE_IRQ_SIZE];
-                // static volatile uint8_t time_table_idx = 0;
-
-                // static volatile uint16_t received_size_table[TABLE_IRQ_SIZE];
-                // static volatile uint8_t received_size_table_idx = 0;
-    for (uint8_t i = 0; i < time_table_idx; i++) {
-        printf("    IRQ time[%d]: %u us\n", i, time_table_irq[i]);
-    }
-    //  time_table_duration[TABLE_IRQ_SIZE];
-//  static volatile uint8_t time_duration_idx = 0;
-    for (uint8_t i = 0; i < time_duration_idx; i++) {
-        printf("    IRQ duration[%d]: %u us\n", i, time_table_duration[i]);
-    }
-    time_duration_idx = 0;
-    for (uint8_t i = 0; i < received_size_table_idx; i++) {
-        printf("    IRQ RX size[%d]: %u bytes\n", i, received_size_table[i]);
-    }
-    received_size_table_idx = 0;
-    time_table_idx = 0;
-    for (uint8_t i = 0; i < ik_pending_table_idx; i++) {
-        printf("    IRQ pending[%d]: 0x%08X\n", i, ik_pending_table[i]);
-    }
-    ik_pending_table_idx = 0;
-
+    TRACE_END(TR_DDP_LOOP, 0, 0);
+    tlm_sample(TLM_DDP_SERVICE_US, time_us_32() - t_start);
     return 0;
 }
 
@@ -800,11 +793,24 @@ static void process_ddp_packet(uint8_t *buf, uint16_t recv_len)
     uint16_t payload_len = recv_len - DDP_HEADER_LEN;
     if (length > payload_len) length = payload_len;
 
+    // Clamp to the frame buffer
+    if (offset >= ddp_buf_size) return;
+    if (offset + length > ddp_buf_size) length = (uint16_t)(ddp_buf_size - offset);
+
+    TRACE_INSTANT(TR_DDP_PACKET, offset, length);
     ddp_copy_payload(&buf[DDP_HEADER_LEN], offset, length);
+    if (offset + length > ddp_frame_len) ddp_frame_len = (uint16_t)(offset + length);
 
     if (flags1 & DDP_FLAGS1_PUSH) {
-        printf("DDP - push to ws2815, blocked for a while.\r\n");
-        // ws2815_show(rx_fb);   // push frame to LEDs (pass flat uint8_t pointer)
+        tlm_count(TLM_DDP_FRAMES, 1);
+        TRACE_INSTANT(TR_DDP_PUSH, ddp_frame_len, 0);
+        if (ddp_on_push) {
+            ddp_on_push(ddp_buf_frame, ddp_frame_len);
+        } else {
+            DLOG_EVERY(1000, "DDP - push to ws2815, blocked for a while.\r\n");
+            // ws2815_show(rx_fb);   // push frame to LEDs (pass flat uint8_t pointer)
+        }
+        ddp_frame_len = 0;
     }
 }
 
@@ -153,14 +153,27 @@ void wiznet_gpio_irq_init(void);
 void udp_interrupts_enable(void);
 // void udp_socket_init(void);
 void udp_ddp_init(uint8_t sn, uint16_t port, uint8_t *buf, uint16_t buf_size);
+// called from ddp_loop() with the assembled frame when a PUSH packet arrives
+typedef void (*ddp_push_fn)(const uint8_t *frame, uint16_t len);
+void udp_ddp_push_hook(ddp_push_fn on_push);
 void init_net_info(void);
 void wiznet_drain_udp(void);
 
 // CLI functions
-void tcp_cli_init(uint8_t sn, uint16_t port, uint8_t *buf, uint16_t buf_size, int16_t timeout_sec);
+void tcp_cli_init(uint8_t sn, uint8_t sessions, uint16_t port, int16_t timeout_sec);
 void cli_hook_init(const tcp_cli_hooks_t *hooks);
 int32_t tcp_cli_service(void);
 
+// Telemetry datagrams (telemetry.h), send with tlm_service()
+void udp_tlm_init(uint8_t sn, uint16_t port, const uint8_t destip[4], uint32_t period_ms);
+void udp_tlm_dest(const uint8_t destip[4], uint16_t port);
+void udp_tlm_get_dest(uint8_t destip[4], uint16_t *port);
+
+// Text lines of the deferred log (dlog.h), "log udp" turns them on
+void udp_log_init(uint8_t sn, uint16_t port);
+void udp_log_dest(const uint8_t destip[4], uint16_t port);
+void udp_log_get_dest(uint8_t destip[4], uint16_t *port);
+
 
 int32_t ddp_loop(); // (uint32_t *pkt_counter, uint32_t *last_push_ms);
 
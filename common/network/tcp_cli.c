@@ -10,21 +10,7 @@
 #include "pico/stdlib.h"
 #include "network.h"
 
-#define TELNET_PROMPT  "> "
-
-void cli_send(uint8_t sn, const char *msg) {
-    // Send the main message first
-    send(sn, (uint8_t *)msg, (uint16_t)strlen(msg));
-}
-
-void cli_flush(uint8_t sn, const char *msg) {
-    // Send the main message first
-    send(sn, (uint8_t *)msg, (uint16_t)strlen(msg));
-
-    // Then send the prompt
-    const char *prompt = TELNET_PROMPT;
-    send(sn, (uint8_t*)prompt, (uint16_t)strlen(prompt));
-}
+// cli_send() / cli_flush() batch their output in cli_io.c
 
 // --- Common functions for telnet ---
 bool parse_ipv4(const char *s, uint8_t out[4]) {
@@ -9,6 +9,7 @@
 // #include <stdio.h>
 // #include <string.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 
 typedef void (*tcp_cli_on_connect_fn)(uint8_t sn, const uint8_t *client_ip);
@@ -20,7 +21,9 @@ typedef struct
 } tcp_cli_hooks_t;
 
 // void telnet_send(uint8_t sn, const char *msg);
+// Output is buffered (cli_io.c) and sent at the end of the service pass
 void cli_send(uint8_t sn, const char *msg);
+// cli_send() and the prompt
 void cli_flush(uint8_t sn, const char *msg);
 
 // --- Common functions for telnet ---
@@ -0,0 +1,226 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dlog.h"
+
+typedef struct {
+    uint32_t    seq;                    // index + 1 once written, the drain waits for it
+    uint32_t    ts_us;
+    const dlog_site_t *site;
+    uint32_t    suppressed;
+    uint8_t     nargs;
+    uintptr_t   arg[DLOG_ARGS_MAX];
+} dlog_rec_t;
+
+static dlog_rec_t s_ring[DLOG_RING_SIZE];
+static uint32_t s_head;                 // records claimed, the next slot is head % size
+static uint32_t s_tail;                 // records taken by the drain
+static uint32_t s_dropped_shown;        // s_stats.dropped already reported
+static dlog_stats_t s_stats;
+
+static bool usb_out(const char *text, uint16_t len)
+{
+    printf("%.*s", (int)len, text);
+    return true;
+}
+
+static dlog_out_fn s_out[DLOG_OUTS] = { [DLOG_OUT_USB] = usb_out };
+static bool s_on[DLOG_OUTS] = { [DLOG_OUT_USB] = true };
+
+void dlog_write(dlog_site_t *site, uint8_t nargs, uintptr_t a, uintptr_t b, uintptr_t c, uintptr_t d)
+{
+    uint32_t now = (uint32_t)dlog_now_us();
+    uint32_t suppressed = 0;
+
+    if (site->period_us) {
+        if (site->seen && now - site->last_us < site->period_us) {
+            site->suppressed++;
+            __atomic_fetch_add(&s_stats.suppressed, 1u, __ATOMIC_RELAXED);
+            return;
+        }
+        site->seen = true;
+        site->last_us = now;
+        suppressed = site->suppressed;
+        site->suppressed = 0;
+    }
+
+    // claim a slot, only while the drain has taken what was in it
+    uint32_t head = __atomic_load_n(&s_head, __ATOMIC_RELAXED);
+    uint32_t used;
+
+    do {
+        used = head - __atomic_load_n(&s_tail, __ATOMIC_ACQUIRE);
+        if (used >= DLOG_RING_SIZE) {
+            __atomic_fetch_add(&s_stats.dropped, 1u, __ATOMIC_RELAXED);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&s_head, &head, head + 1u, true,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    dlog_rec_t *r = &s_ring[head & (DLOG_RING_SIZE - 1)];
+
+    r->ts_us = now;
+    r->site = site;
+    r->suppressed = suppressed;
+    r->nargs = nargs;
+    r->arg[0] = a;
+    r->arg[1] = b;
+    r->arg[2] = c;
+    r->arg[3] = d;
+    __atomic_store_n(&r->seq, head + 1u, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&s_stats.logged, 1u, __ATOMIC_RELAXED);
+    if (used + 1u > s_stats.used_max)
+        s_stats.used_max = used + 1u;   // two writers may race here, it is only a statistic
+}
+
+void dlog_reset(void)
+{
+    memset(s_ring, 0, sizeof(s_ring));
+    s_head = s_tail = 0;
+    s_dropped_shown = 0;
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+void dlog_output(dlog_out_t out, dlog_out_fn fn)
+{
+    s_out[out] = fn;
+}
+
+void dlog_route(dlog_out_t out, bool on)
+{
+    s_on[out] = on;
+}
+
+bool dlog_routed(dlog_out_t out)
+{
+    return s_on[out] && s_out[out];
+}
+
+uint32_t dlog_pending(void)
+{
+    return __atomic_load_n(&s_head, __ATOMIC_RELAXED) - s_tail;
+}
+
+const dlog_stats_t *dlog_stats(void)
+{
+    return &s_stats;
+}
+
+/* a copy of the oldest record, false when there is none or it is still being written */
+static bool peek(dlog_rec_t *r)
+{
+    uint32_t tail = s_tail;
+    const dlog_rec_t *slot = &s_ring[tail & (DLOG_RING_SIZE - 1)];
+
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != tail + 1u)
+        return false;
+    *r = *slot;
+    return true;
+}
+
+/* the record of peek() is done with, its slot is free again */
+static void release(void)
+{
+    __atomic_store_n(&s_tail, s_tail + 1u, __ATOMIC_RELEASE);
+}
+
+/* snprintf() that returns what it wrote, not what it wanted to */
+static size_t put(size_t size, int n)
+{
+    return (n < 0) ? 0 : ((size_t)n < size) ? (size_t)n : size - 1;
+}
+
+/* "[   12.345] text (+N suppressed)" and CRLF, the text without its own line end */
+static uint16_t format(const dlog_rec_t *r, uint64_t now, char *line)
+{
+    const size_t size = DLOG_LINE_MAX - 2;  // room for the CRLF
+    // 32 bit timestamps: the record is younger than 71 minutes
+    uint64_t ts = now - (uint32_t)((uint32_t)now - r->ts_us);
+    size_t n;
+
+    n = put(size, snprintf(line, size, "[%5lu.%03lu] ",
+            (unsigned long)(ts / 1000000u), (unsigned long)(ts / 1000u % 1000u)));
+    n += put(size - n, snprintf(line + n, size - n, r->site->fmt,
+             r->arg[0], r->arg[1], r->arg[2], r->arg[3]));
+    while (n && (line[n - 1] == '\n' || line[n - 1] == '\r'))
+        n--;
+    if (r->suppressed)
+        n += put(size - n, snprintf(line + n, size - n, " (+%lu suppressed)",
+                 (unsigned long)r->suppressed));
+    line[n++] = '\r';
+    line[n++] = '\n';
+    line[n] = '\0';
+    return (uint16_t)n;
+}
+
+static void emit(const char *text, uint16_t len, uint16_t lines)
+{
+    for (int o = 0; o < DLOG_OUTS; o++) {
+        if (s_on[o] && s_out[o] && !s_out[o](text, len))
+            s_stats.lost[o] += lines;
+    }
+}
+
+uint32_t dlog_drain(uint32_t budget_us)
+{
+    static char batch[DLOG_BATCH_SIZE];
+    char line[DLOG_LINE_MAX];
+    uint64_t t0 = dlog_now_us();
+    uint16_t len = 0, lines = 0, n;
+    uint32_t taken = 0;
+    dlog_rec_t r;
+
+    while (peek(&r)) {
+        n = format(&r, dlog_now_us(), line);
+        if (len + n >= DLOG_BATCH_SIZE) {
+            emit(batch, len, lines);
+            len = lines = 0;
+            if (dlog_now_us() - t0 >= budget_us)
+                break;                  // this record stays for the next drain
+        }
+        release();
+        memcpy(batch + len, line, (size_t)n + 1u);
+        len = (uint16_t)(len + n);
+        lines++;
+        taken++;
+    }
+    s_stats.lines += taken;
+
+    // the ring ran full: said once it is empty again, after what it kept
+    uint32_t dropped = __atomic_load_n(&s_stats.dropped, __ATOMIC_RELAXED);
+
+    if (dropped != s_dropped_shown && !dlog_pending()) {
+        uint64_t now = dlog_now_us();
+
+        n = (uint16_t)put(sizeof(line), snprintf(line, sizeof(line),
+                "[%5lu.%03lu] dlog: %lu records dropped, ring full\r\n",
+                (unsigned long)(now / 1000000u), (unsigned long)(now / 1000u % 1000u),
+                (unsigned long)(dropped - s_dropped_shown)));
+        s_dropped_shown = dropped;
+        if (len + n >= DLOG_BATCH_SIZE) {
+            emit(batch, len, lines);
+            len = lines = 0;
+        }
+        memcpy(batch + len, line, (size_t)n + 1u);
+        len = (uint16_t)(len + n);
+        lines++;
+    }
+    if (len)
+        emit(batch, len, lines);
+    return taken;
+}
+
+#ifndef DLOG_HOST
+#include "pico/time.h"
+
+uint64_t dlog_now_us(void)
+{
+    return time_us_64();
+}
+#endif // DLOG_HOST
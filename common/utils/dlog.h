@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/**
+ * Deferred log: printf() out of the hot paths.
+ *
+ * DLOG() / DLOG_EVERY() do not format anything. They put a record into a
+ * RAM ring: the address of the call site (its format string), a 32 bit
+ * microsecond timestamp and up to DLOG_ARGS_MAX integer arguments. The
+ * "log" task of the main loop runs dlog_drain() at the lowest priority:
+ * it formats the records into text lines and hands them to the outputs
+ * that are on, USB (stdout), one telnet session ("log cli") or UDP ("log
+ * udp"), within a time budget. An output that cannot take the lines at
+ * that moment (socket busy) loses them, it is never waited for.
+ *
+ * Writers claim a slot with an atomic compare and swap, so any context
+ * on any core, an interrupt handler too, can log: no lock, no interrupt
+ * masking, no SDK call but the clock. A full ring drops the new record
+ * (the oldest ones are kept) and counts it, the drain reports the count.
+ *
+ * DLOG_EVERY(ms, ...) keeps at most one record per ms for its call site;
+ * the calls in between are counted and shown with the next record, as
+ * "(+N suppressed)". The rate state belongs to the call site: a site
+ * used from two contexts may miscount its suppressed calls.
+ *
+ * Arguments are stored as integers and formatted later: %d %u %x %c and
+ * %p are fine, %s only for strings that live forever (literals), no
+ * floating point and no 64 bit values.
+ *
+ * The time base is dlog_now_us(); the pico backend is in dlog.c, a host
+ * build defines DLOG_HOST and provides it.
+ */
+#define DLOG_RING_SIZE      64          // records, power of 2
+#define DLOG_ARGS_MAX       4
+#define DLOG_LINE_MAX       128         // one formatted line, longer ones are cut
+#define DLOG_BATCH_SIZE     256         // lines handed to an output at a time
+#define DLOG_DRAIN_BUDGET_US 400        // sched "log" task budget 500 us
+
+/* one call site: static, made by the macros */
+typedef struct {
+    const char *fmt;
+    uint32_t    period_us;              // at most one record per period, 0 = every call
+    uint32_t    last_us;
+    uint32_t    suppressed;             // calls dropped by the rate limit since the last record
+    bool        seen;
+} dlog_site_t;
+
+typedef enum {
+    DLOG_OUT_USB,                       // stdout, on from the start
+    DLOG_OUT_CLI,                       // a telnet session, cli_sys.c
+    DLOG_OUT_UDP,                       // datagrams of text lines, network.c
+    DLOG_OUTS
+} dlog_out_t;
+
+/* complete lines, NUL terminated; false when the output cannot take them now */
+typedef bool (*dlog_out_fn)(const char *text, uint16_t len);
+
+typedef struct {
+    uint32_t logged;                    // records written
+    uint32_t dropped;                   // records lost to a full ring
+    uint32_t suppressed;                // calls dropped by a rate limit
+    uint32_t lines;                     // records formatted by the drain
+    uint32_t lost[DLOG_OUTS];           // lines an output did not take
+    uint32_t used_max;                  // most records in the ring at once
+} dlog_stats_t;
+
+/* the number of arguments, 0..DLOG_ARGS_MAX (and more, for the assert) */
+#define DLOG_NARGS(...)     DLOG_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define DLOG_NARGS_(z, a, b, c, d, e, f, g, h, n, ...)  n
+#define DLOG_ARGS(...)      DLOG_ARGS_(0, ##__VA_ARGS__, 0, 0, 0, 0)
+#define DLOG_ARGS_(z, a, b, c, d, ...) \
+    (uintptr_t)(a), (uintptr_t)(b), (uintptr_t)(c), (uintptr_t)(d)
+
+/* if (0) printf(): the compiler still checks the format against the arguments */
+#define DLOG_EVERY(ms, fmt, ...) do {                                           \
+    static dlog_site_t dlog_site_ = { (fmt), (uint32_t)(ms) * 1000u, 0, 0, false }; \
+    _Static_assert(DLOG_NARGS(__VA_ARGS__) <= DLOG_ARGS_MAX, "DLOG: too many arguments"); \
+    if (0)                                                                      \
+        printf(fmt, ##__VA_ARGS__);                                             \
+    dlog_write(&dlog_site_, DLOG_NARGS(__VA_ARGS__), DLOG_ARGS(__VA_ARGS__));  \
+} while (0)
+
+#define DLOG(fmt, ...)      DLOG_EVERY(0, fmt, ##__VA_ARGS__)
+
+void dlog_write(dlog_site_t *site, uint8_t nargs, uintptr_t a, uintptr_t b, uintptr_t c, uintptr_t d);
+
+/* empties the ring and the statistics, the outputs stay; nothing may log meanwhile */
+void dlog_reset(void);
+
+/* the output function of an output, NULL for none */
+void dlog_output(dlog_out_t out, dlog_out_fn fn);
+void dlog_route(dlog_out_t out, bool on);
+bool dlog_routed(dlog_out_t out);
+
+/* formats and sends records until the ring is empty or budget_us is used,
+   checked after every batch: one batch is always sent; returns the records taken */
+uint32_t dlog_drain(uint32_t budget_us);
+
+/* records waiting for the drain */
+uint32_t dlog_pending(void);
+const dlog_stats_t *dlog_stats(void);
+
+uint64_t dlog_now_us(void);
@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+#include <stdint.h>
+
+/**
+ * Small PRNGs for LED patterns.
+ *
+ * prng_t is PCG32 (XSH-RR): 64-bit state, one UMULL-class multiply per value.
+ * Every (seed, stream) pair gives an independent, reproducible sequence, so
+ * each pattern owns its stream and one pattern's draws never shift another's.
+ *
+ * prng_hash() is stateless: a value for (seed, x, y), e.g. pixel and frame.
+ * Patterns that only need "random per pixel per frame" use it instead of
+ * drawing from a stream in pixel order.
+ */
+typedef struct {
+    uint64_t state;
+    uint64_t inc;       // stream selector, always odd
+} prng_t;
+
+#define PRNG_MULT   6364136223846793005ull
+
+static inline uint32_t prng_u32(prng_t *rng) {
+    uint64_t old = rng->state;
+    rng->state = old * PRNG_MULT + rng->inc;
+    uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+    uint32_t rot = (uint32_t)(old >> 59u);
+    return (xorshifted >> rot) | (xorshifted << ((32u - rot) & 31u));
+}
+
+static inline void prng_seed(prng_t *rng, uint64_t seed, uint64_t stream) {
+    rng->state = 0;
+    rng->inc = (stream << 1u) | 1u;
+    (void)prng_u32(rng);
+    rng->state += seed;
+    (void)prng_u32(rng);
+}
+
+/**
+ * Value in [0, n) without division (Lemire multiply-shift).
+ * Bias is below n / 2^32, invisible for pixel counts and color picks.
+ */
+static inline uint32_t prng_below(prng_t *rng, uint32_t n) {
+    return (uint32_t)(((uint64_t)prng_u32(rng) * n) >> 32);
+}
+
+/**
+ * Counter-based hash (lowbias32 finalizer) of seed, x and y.
+ * No state and no loop-carried dependency, so a pixel loop using it
+ * can be unrolled or split freely.
+ */
+static inline uint32_t prng_hash(uint32_t seed, uint32_t x, uint32_t y) {
+    uint32_t h = seed ^ (x * 0x9E3779B9u) ^ (y * 0x85EBCA6Bu);
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return h;
+}
@@ -0,0 +1,198 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "sched.h"
+#include "utility.h"
+#include "trace.h"
+
+static sched_task_t tasks[SCHED_MAX_TASKS];
+static uint8_t task_count;
+static uint32_t idle_us_total;
+static uint32_t stats_start_us;
+
+// wrap-safe "a is before b" for the 32-bit microsecond clock
+static inline int32_t time_diff(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b);
+}
+
+/**
+ * Register a periodic task; returns its id or -1 when the table is full.
+ * deadline_us 0 means "by the next release".
+ */
+int sched_add(const char *name, sched_task_fn run, uint32_t period_us,
+              uint32_t deadline_us, uint32_t budget_us, uint8_t priority) {
+    if (task_count >= SCHED_MAX_TASKS || !run || !period_us)
+        return -1;
+
+    sched_task_t *t = &tasks[task_count];
+    memset(t, 0, sizeof(*t));
+    t->name = name;
+    t->run = run;
+    t->period_us = period_us;
+    t->deadline_us = (deadline_us && deadline_us < period_us) ? deadline_us : period_us;
+    t->budget_us = budget_us;
+    t->priority = priority;
+    return task_count++;
+}
+
+/**
+ * Release all tasks now; call once before sched_run()/sched_run_once()
+ */
+void sched_start(void) {
+    uint32_t now = sched_now_us();
+
+    for (uint8_t i = 0; i < task_count; i++)
+        tasks[i].release_us = now;
+    stats_start_us = now;
+    idle_us_total = 0;
+}
+
+static bool task_before(const sched_task_t *a, const sched_task_t *b) {
+    int32_t d = time_diff(a->release_us + a->deadline_us, b->release_us + b->deadline_us);
+    return d < 0 || (d == 0 && a->priority < b->priority);
+}
+
+/**
+ * Non-preemptive guard: c may start only if it ends before the latest
+ * start time of every more important task, pending or released meanwhile.
+ * A task whose budget never fits into the gaps starves; its late_max_us
+ * shows it.
+ */
+static bool task_fits(const sched_task_t *c, uint32_t now) {
+    for (uint8_t i = 0; i < task_count; i++) {
+        const sched_task_t *t = &tasks[i];
+
+        if (t == c || t->priority >= c->priority)
+            continue;
+        uint32_t latest_start = t->release_us + t->deadline_us - t->budget_us;
+        if (time_diff(latest_start, now + c->budget_us) < 0)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * One scheduling decision: run a task or idle.
+ * Returns true when a task was run.
+ */
+bool sched_run_once(void) {
+    uint32_t now = sched_now_us();
+    sched_task_t *best = NULL;
+    uint32_t wake = now + 1000000u;
+
+    for (uint8_t i = 0; i < task_count; i++) {
+        sched_task_t *t = &tasks[i];
+
+        if (time_diff(now, t->release_us) < 0) {
+            if (time_diff(t->release_us, wake) < 0)
+                wake = t->release_us;
+        } else if ((!best || task_before(t, best)) && task_fits(t, now)) {
+            best = t;
+        }
+    }
+
+    if (!best) {
+        sched_idle_until(wake);
+        idle_us_total += sched_now_us() - now;
+        return false;
+    }
+
+    uint32_t late = now - best->release_us;
+    uint32_t id = (uint32_t)(best - tasks);
+    TRACE_BEGIN(TR_TASK, id, late);
+    best->run();
+    TRACE_END(TR_TASK, id, late);
+    uint32_t end = sched_now_us();
+    uint32_t exec = end - now;
+
+    best->runs++;
+    best->exec_last_us = exec;
+    best->exec_total_us += exec;
+    if (exec > best->exec_max_us)
+        best->exec_max_us = exec;
+    if (late > best->late_max_us)
+        best->late_max_us = late;
+    if (best->budget_us && exec > best->budget_us)
+        best->overruns++;
+    if (time_diff(end, best->release_us + best->deadline_us) > 0)
+        best->misses++;
+
+    // fixed rate like "last += period"; drop releases when a period behind
+    best->release_us += best->period_us;
+    if (time_diff(end, best->release_us) >= (int32_t)best->period_us) {
+        uint32_t behind = (end - best->release_us) / best->period_us;
+        best->skipped += behind;
+        best->release_us += behind * best->period_us;
+    }
+    return true;
+}
+
+void sched_run(void) {
+    sched_start();
+    while (true)
+        sched_run_once();
+}
+
+const sched_task_t *sched_get_task(int id) {
+    if (id < 0 || id >= task_count)
+        return NULL;
+    return &tasks[id];
+}
+
+void sched_reset_stats(void) {
+    for (uint8_t i = 0; i < task_count; i++) {
+        sched_task_t *t = &tasks[i];
+        t->runs = t->overruns = t->misses = t->skipped = 0;
+        t->exec_last_us = t->exec_max_us = t->late_max_us = 0;
+        t->exec_total_us = 0;
+    }
+    stats_start_us = sched_now_us();
+    idle_us_total = 0;
+}
+
+int sched_show(char *msg, size_t msg_max_sz) {
+    char *cursor = msg;
+    size_t remaining = msg_max_sz;
+    uint32_t elapsed = sched_now_us() - stats_start_us;
+
+    msg_printf(&cursor, &remaining,
+        "task       period  dl/bgt us   runs  avg  max  late ovr miss skip\r\n");
+    for (uint8_t i = 0; i < task_count; i++) {
+        const sched_task_t *t = &tasks[i];
+        msg_printf(&cursor, &remaining, "%-10s %6lu %5lu/%-5lu %6lu %4lu %4lu %5lu %3lu %4lu %4lu\r\n",
+            t->name, (unsigned long)t->period_us,
+            (unsigned long)t->deadline_us, (unsigned long)t->budget_us,
+            (unsigned long)t->runs,
+            (unsigned long)(t->runs ? t->exec_total_us / t->runs : 0),
+            (unsigned long)t->exec_max_us, (unsigned long)t->late_max_us,
+            (unsigned long)t->overruns, (unsigned long)t->misses,
+            (unsigned long)t->skipped);
+    }
+    msg_printf(&cursor, &remaining, "idle %lu%%\r\n",
+        (unsigned long)(elapsed ? (uint64_t)idle_us_total * 100u / elapsed : 0));
+
+    return (int)(msg_max_sz - remaining);
+}
+
+#ifndef SCHED_HOST
+#include "pico/time.h"
+
+uint32_t sched_now_us(void) {
+    return time_us_32();
+}
+
+/**
+ * WFE until the next release; any interrupt (W6100, DMA, timer) also wakes us
+ */
+void sched_idle_until(uint32_t time_us) {
+    int32_t wait = time_diff(time_us, time_us_32());
+
+    if (wait > 0)
+        best_effort_wfe_or_timeout(make_timeout_time_us((uint64_t)wait));
+}
+#endif // SCHED_HOST
@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Cooperative deadline scheduler for the main loop.
+ *
+ * Every task is periodic. Of the released tasks the one with the earliest
+ * absolute deadline runs first (priority breaks ties). Tasks are not
+ * preempted, so a task is only started when its budget fits before the
+ * latest start time of every more important task; otherwise the scheduler
+ * idles until that task is released. A task that runs longer than its
+ * budget is counted as an overrun, one that finishes after its deadline
+ * as a miss.
+ *
+ * When nothing is due the core sleeps in WFE until the next release or
+ * an interrupt. The time base is sched_now_us()/sched_idle_until(); the
+ * pico backend is in sched.c, a host build defines SCHED_HOST and
+ * provides both.
+ */
+#define SCHED_MAX_TASKS     12
+
+typedef void (*sched_task_fn)(void);
+
+typedef struct {
+    const char *name;
+    sched_task_fn run;
+    uint32_t period_us;
+    uint32_t deadline_us;       // relative to release, <= period
+    uint32_t budget_us;         // expected worst-case run time
+    uint8_t  priority;          // 0 = most important
+
+    uint32_t release_us;        // next release time
+    uint32_t runs;
+    uint32_t overruns;          // ran longer than budget_us
+    uint32_t misses;            // finished after the deadline
+    uint32_t skipped;           // releases dropped after falling a period behind
+    uint32_t exec_last_us;
+    uint32_t exec_max_us;
+    uint32_t late_max_us;       // worst start delay after release
+    uint64_t exec_total_us;
+} sched_task_t;
+
+int sched_add(const char *name, sched_task_fn run, uint32_t period_us,
+              uint32_t deadline_us, uint32_t budget_us, uint8_t priority);
+void sched_start(void);
+bool sched_run_once(void);
+void sched_run(void);
+
+const sched_task_t *sched_get_task(int id);
+void sched_reset_stats(void);
+int sched_show(char *msg, size_t msg_max_sz);
+
+uint32_t sched_now_us(void);
+void sched_idle_until(uint32_t time_us);
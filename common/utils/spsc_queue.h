@@ -0,0 +1,50 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Lock-free single-producer / single-consumer queue of small values
+ * (buffer indices), safe between the two RP2350 cores or an IRQ and the
+ * main loop. One side only ever writes head, the other only tail.
+ * SPSC_QUEUE_SIZE must be a power of two; capacity is SPSC_QUEUE_SIZE.
+ */
+#define SPSC_QUEUE_SIZE     8u
+
+typedef struct {
+    volatile uint32_t head;     // written by producer
+    volatile uint32_t tail;     // written by consumer
+    uint8_t item[SPSC_QUEUE_SIZE];
+} spsc_queue_t;
+
+static inline void spsc_init(spsc_queue_t *q) {
+    q->head = 0;
+    q->tail = 0;
+}
+
+static inline bool spsc_push(spsc_queue_t *q, uint8_t v) {
+    uint32_t head = q->head;
+    if (head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) >= SPSC_QUEUE_SIZE)
+        return false;   // full
+    q->item[head & (SPSC_QUEUE_SIZE - 1u)] = v;
+    __atomic_store_n(&q->head, head + 1u, __ATOMIC_RELEASE);
+    return true;
+}
+
+static inline bool spsc_pop(spsc_queue_t *q, uint8_t *v) {
+    uint32_t tail = q->tail;
+    if (__atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == tail)
+        return false;   // empty
+    *v = q->item[tail & (SPSC_QUEUE_SIZE - 1u)];
+    __atomic_store_n(&q->tail, tail + 1u, __ATOMIC_RELEASE);
+    return true;
+}
+
+static inline uint32_t spsc_count(const spsc_queue_t *q) {
+    return __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+}
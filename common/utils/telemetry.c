@@ -0,0 +1,186 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "pico/time.h"
+#include "telemetry.h"
+
+static uint32_t       s_counters[TLM_COUNTERS];
+static tlm_histo_t    s_histos[TLM_HISTS];
+static uint32_t       s_epoch = 1;      // datagram the histogram max belongs to
+static uint32_t       s_seq;
+static uint32_t       s_period_ms;
+static uint64_t       s_next_us;
+static tlm_send_fn    s_send;
+static tlm_collect_fn s_collect;
+static uint8_t        s_buf[TLM_DGRAM_MAX];
+
+void tlm_init(tlm_send_fn send_fn, uint32_t period_ms)
+{
+    s_send = send_fn;
+    tlm_set_period(period_ms);
+}
+
+void tlm_collect_hook(tlm_collect_fn fn)
+{
+    s_collect = fn;
+}
+
+void tlm_set_period(uint32_t period_ms)
+{
+    if (period_ms && period_ms < TLM_PERIOD_MIN_MS)
+        period_ms = TLM_PERIOD_MIN_MS;
+    if (period_ms > 0xFFFFu)
+        period_ms = 0xFFFFu;
+    s_period_ms = period_ms;
+    s_next_us = time_us_64() + (uint64_t)period_ms * 1000u;
+}
+
+uint32_t tlm_get_period(void)
+{
+    return s_period_ms;
+}
+
+void tlm_count(tlm_counter_t id, uint32_t n)
+{
+    s_counters[id] += n;
+}
+
+void tlm_set(tlm_counter_t id, uint32_t value)
+{
+    s_counters[id] = value;
+}
+
+uint8_t tlm_bucket(uint32_t value)
+{
+    uint8_t b = value ? (uint8_t)(32 - __builtin_clz(value)) : 0;
+
+    return (b < TLM_BUCKETS) ? b : TLM_BUCKETS - 1;
+}
+
+void tlm_sample(tlm_hist_t id, uint32_t value)
+{
+    tlm_histo_t *h = &s_histos[id];
+    uint32_t epoch = s_epoch;
+
+    // the first sample after a datagram starts the max again
+    if (h->max_epoch != epoch || value > h->max) {
+        h->max = value;
+        h->max_epoch = epoch;
+    }
+    h->count++;
+    h->sum += value;
+    h->buckets[tlm_bucket(value)]++;
+}
+
+/* ---------- datagram ---------- */
+static uint8_t *put8(uint8_t *p, uint32_t v)
+{
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static uint8_t *put16(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t *put32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+    return p + 4;
+}
+
+uint16_t tlm_encode(uint8_t *buf, uint32_t uptime_ms)
+{
+    uint8_t *p = buf + TLM_HEADER_SIZE;
+    uint8_t counters = 0, histos = 0;
+
+    for (uint8_t i = 0; i < TLM_COUNTERS; i++) {
+        uint32_t v = s_counters[i];
+
+        if (!v)
+            continue;
+        p = put8(p, i);
+        p = put32(p, v);
+        counters++;
+    }
+
+    for (uint8_t i = 0; i < TLM_HISTS; i++) {
+        const tlm_histo_t *h = &s_histos[i];
+        uint32_t mask = 0;
+
+        if (!h->count)
+            continue;
+        for (uint8_t b = 0; b < TLM_BUCKETS; b++)
+            if (h->buckets[b])
+                mask |= 1u << b;
+        p = put8(p, i);
+        p = put32(p, h->count);
+        p = put32(p, h->sum);
+        p = put32(p, (h->max_epoch == s_epoch) ? h->max : 0);
+        p = put32(p, mask);
+        for (uint8_t b = 0; b < TLM_BUCKETS; b++)
+            if (mask >> b & 1u)
+                p = put32(p, h->buckets[b]);
+        histos++;
+    }
+
+    uint8_t *q = buf;
+    q = put8(q, 'T');
+    q = put8(q, 'M');
+    q = put8(q, TLM_VERSION);
+    q = put8(q, 0);
+    q = put32(q, s_seq);
+    q = put32(q, uptime_ms);
+    q = put16(q, s_period_ms);
+    q = put8(q, counters);
+    put8(q, histos);
+    return (uint16_t)(p - buf);
+}
+
+bool tlm_service(void)
+{
+    uint64_t now = time_us_64();
+
+    if (!s_period_ms || !s_send || now < s_next_us)
+        return false;
+    s_next_us += (uint64_t)s_period_ms * 1000u;
+    if (s_next_us <= now)
+        s_next_us = now + (uint64_t)s_period_ms * 1000u;   // fell a period behind
+
+    if (s_collect)
+        s_collect();
+    uint16_t len = tlm_encode(s_buf, (uint32_t)(now / 1000u));
+    if (!s_send(s_buf, len)) {
+        s_counters[TLM_TX_SKIPPED]++;   // the max goes with the next one
+        return false;
+    }
+    s_seq++;
+    s_epoch++;
+    return true;
+}
+
+uint32_t tlm_counter(tlm_counter_t id)
+{
+    return s_counters[id];
+}
+
+const tlm_histo_t *tlm_histo(tlm_hist_t id)
+{
+    return &s_histos[id];
+}
+
+uint32_t tlm_seq(void)
+{
+    return s_seq;
+}
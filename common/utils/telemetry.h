@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Live telemetry: counters and histograms in RAM, sent as one binary UDP
+ * datagram every period (tools/telemetry/tlm_recv.py shows them).
+ *
+ * tlm_count() and tlm_sample() only touch RAM: no printf, no SPI, a few
+ * cycles, so they can be used in an interrupt handler. Every metric has
+ * one writer (one core, one context): two writers of the same metric
+ * would lose updates. Counters and histogram counts are totals since boot
+ * and wrap at 2^32, the receiver takes the difference of two datagrams,
+ * so a lost datagram loses nothing. Only the histogram max is per
+ * datagram.
+ *
+ * A histogram has log2 buckets: bucket 0 is the value 0, bucket b the
+ * values 2^(b-1) .. 2^b - 1, the last bucket everything above.
+ *
+ * tlm_service() sends from the main loop when the period is up; a metric
+ * that was never written is left out of the datagram. No SDK dependency:
+ * the UDP send is passed in, the clock is time_us_64().
+ *
+ * Datagram, little endian:
+ *   header   magic "TM", version u8, flags u8, seq u32, uptime_ms u32,
+ *            period_ms u16, counters u8, histograms u8
+ *   counter  id u8, value u32
+ *   histo    id u8, count u32, sum u32, max u32, bucket mask u32,
+ *            u32 total of every bucket set in the mask, lowest first
+ */
+#define TLM_VERSION         1
+#define TLM_BUCKETS         24          // last one: >= 2^22 us, 4 s
+#define TLM_HEADER_SIZE     16
+#define TLM_DGRAM_MAX       1024        // every metric, every bucket: 882 bytes
+#define TLM_PERIOD_MIN_MS   50
+
+/* ids are part of the datagram: add at the end, keep tlm_recv.py in step */
+typedef enum {
+    TLM_DDP_PKTS,                       // UDP packets taken by the W6100 IRQ
+    TLM_DDP_BYTES,
+    TLM_DDP_ERRORS,                     // recvfrom() errors in the IRQ
+    TLM_DDP_OVERRUNS,                   // ring slot overwritten before ddp_loop() ran
+    TLM_DDP_FRAMES,                     // PUSH packets handed to the LEDs
+    TLM_LED_FRAMES,                     // frames started on the LED output
+    TLM_LED_DROPS,                      // frames dropped before the output
+    TLM_SENSOR_FRAMES,                  // VL53L8CX frames
+    TLM_SENSOR_ERRORS,
+    TLM_RADAR_FRAMES,                   // RD-03D frames
+    TLM_RADAR_ERRORS,                   // RD-03D bytes lost or skipped
+    TLM_SCHED_OVERRUNS,                 // all main loop tasks together
+    TLM_SCHED_MISSES,
+    TLM_CLI_LINES,
+    TLM_TX_SKIPPED,                     // datagrams not sent: socket busy
+    TLM_COUNTERS
+} tlm_counter_t;
+
+typedef enum {
+    TLM_IRQ_LATENCY_US,                 // W6100 IRQ to ddp_loop()
+    TLM_IRQ_US,                         // W6100 IRQ handler
+    TLM_DDP_SERVICE_US,                 // ddp_loop() over the ring
+    TLM_RENDER_US,                      // pattern of one frame
+    TLM_ENCODE_US,                      // frame to the DMA buffer (transpose)
+    TLM_DMA_US,                         // DMA start to its end IRQ
+    TLM_FRAME_GAP_US,                   // between two LED frames: FPS
+    TLM_HISTS
+} tlm_hist_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t sum;
+    uint32_t max;                       // of the current datagram, see max_epoch
+    uint32_t max_epoch;
+    uint32_t buckets[TLM_BUCKETS];
+} tlm_histo_t;
+
+/* the UDP send; false when the datagram could not go out now */
+typedef bool (*tlm_send_fn)(const uint8_t *buf, uint16_t len);
+
+/* called before every datagram: tlm_set() of totals kept elsewhere */
+typedef void (*tlm_collect_fn)(void);
+
+/* period_ms 0: off */
+void tlm_init(tlm_send_fn send_fn, uint32_t period_ms);
+void tlm_collect_hook(tlm_collect_fn fn);
+void tlm_set_period(uint32_t period_ms);
+uint32_t tlm_get_period(void);
+
+void tlm_count(tlm_counter_t id, uint32_t n);
+void tlm_set(tlm_counter_t id, uint32_t value);
+void tlm_sample(tlm_hist_t id, uint32_t value);
+
+uint8_t tlm_bucket(uint32_t value);
+
+/* main loop: sends a datagram when the period is up; true if it did */
+bool tlm_service(void);
+
+/* the datagram of now into buf (>= TLM_DGRAM_MAX), returns its size */
+uint16_t tlm_encode(uint8_t *buf, uint32_t uptime_ms);
+
+uint32_t tlm_counter(tlm_counter_t id);
+const tlm_histo_t *tlm_histo(tlm_hist_t id);
+uint32_t tlm_seq(void);                 // datagrams sent
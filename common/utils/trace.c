@@ -0,0 +1,132 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "trace.h"
+
+typedef struct {
+    uint32_t    head;                   // events written, the next slot is head % size
+    trace_evt_t evt[TRACE_RING_SIZE];
+} trace_ring_t;
+
+static trace_ring_t s_ring[TRACE_CORES];
+static volatile bool s_on = true;
+
+static const char *const s_names[TR_IDS] = {
+    [TR_W6100_IRQ]   = "w6100_irq",
+    [TR_DDP_LOOP]    = "ddp_loop",
+    [TR_DDP_PACKET]  = "ddp_packet",
+    [TR_DDP_PUSH]    = "ddp_push",
+    [TR_RENDER]      = "render",
+    [TR_ENCODE]      = "encode",
+    [TR_DMA]         = "dma",
+    [TR_TASK]        = "task",
+    [TR_EFU_RECV]    = "efu_recv",
+    [TR_EFU_ERASE]   = "efu_erase",
+    [TR_EFU_PROGRAM] = "efu_program",
+    [TR_EFU_CRC]     = "efu_crc",
+};
+
+void trace_event(trace_id_t id, uint8_t ph, uint32_t a, uint32_t b)
+{
+    if (!s_on)
+        return;
+
+    trace_ring_t *r = &s_ring[trace_core()];
+    // an interrupt on this core between here and the stores takes the next slot
+    uint32_t n = __atomic_fetch_add(&r->head, 1u, __ATOMIC_RELAXED);
+    trace_evt_t *e = &r->evt[n & (TRACE_RING_SIZE - 1)];
+
+    e->ts_us = trace_now_us();
+    e->id = (uint16_t)id;
+    e->ph = ph;
+    e->rsv = 0;
+    e->a = a;
+    e->b = b;
+}
+
+void trace_enable(bool on)
+{
+    s_on = on;
+}
+
+bool trace_enabled(void)
+{
+    return s_on;
+}
+
+void trace_clear(void)
+{
+    for (uint8_t c = 0; c < TRACE_CORES; c++)
+        __atomic_store_n(&s_ring[c].head, 0u, __ATOMIC_RELAXED);
+}
+
+uint32_t trace_written(uint8_t core)
+{
+    return __atomic_load_n(&s_ring[core].head, __ATOMIC_RELAXED);
+}
+
+bool trace_get(uint8_t core, uint32_t i, trace_evt_t *evt)
+{
+    uint32_t head = trace_written(core);
+    uint32_t held = (head < TRACE_RING_SIZE) ? head : TRACE_RING_SIZE;
+
+    if (i >= held)
+        return false;
+    *evt = s_ring[core].evt[(head - held + i) & (TRACE_RING_SIZE - 1)];
+    return true;
+}
+
+const char *trace_name(uint16_t id)
+{
+    return (id < TR_IDS && s_names[id]) ? s_names[id] : "?";
+}
+
+uint32_t trace_dump(trace_put_fn put, void *ctx)
+{
+    char line[64];
+    uint32_t count = 0;
+    bool was_on = s_on;
+    trace_evt_t e;
+
+    s_on = false;       // the rings hold still while they are read
+    snprintf(line, sizeof(line), "trace %u cores %u size %u now %08lx\r\n",
+             TRACE_VERSION, TRACE_CORES, TRACE_RING_SIZE, (unsigned long)trace_now_us());
+    put(ctx, line);
+    for (uint16_t id = 0; id < TR_IDS; id++) {
+        snprintf(line, sizeof(line), "N %u %s\r\n", id, trace_name(id));
+        put(ctx, line);
+    }
+    for (uint8_t c = 0; c < TRACE_CORES; c++) {
+        for (uint32_t i = 0; trace_get(c, i, &e); i++) {
+            snprintf(line, sizeof(line), "E %u %08lx %u %c %lx %lx\r\n", c,
+                     (unsigned long)e.ts_us, e.id, e.ph, (unsigned long)e.a, (unsigned long)e.b);
+            put(ctx, line);
+            count++;
+        }
+    }
+    snprintf(line, sizeof(line), "end %lu\r\n", (unsigned long)count);
+    put(ctx, line);
+    s_on = was_on;
+    return count;
+}
+
+#ifndef TRACE_HOST
+#include "pico/time.h"
+#include "pico/platform.h"
+
+uint32_t trace_now_us(void)
+{
+    return time_us_32();
+}
+
+uint8_t trace_core(void)
+{
+    return (uint8_t)get_core_num();
+}
+#endif // TRACE_HOST
@@ -0,0 +1,102 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Hot path trace: a ring of fixed size binary events per core, dumped on
+ * the CLI ("trace dump") and turned into Chrome trace / Perfetto JSON by
+ * tools/trace/trace2perfetto.py.
+ *
+ * An event is a 32 bit microsecond timestamp, an id, a phase and two
+ * arguments. Every core writes only its own ring; an interrupt on the
+ * same core takes the next slot with an atomic increment, so there is no
+ * lock and no interrupt masking. The ring keeps the newest TRACE_RING_SIZE
+ * events of each core, older ones are overwritten.
+ *
+ * The TRACE_* macros compile to nothing (arguments not evaluated) unless
+ * TRACE_ENABLE is set, see option TRACE_ENABLE in the top CMakeLists.txt.
+ * The time base is trace_now_us()/trace_core(); the pico backend is in
+ * trace.c, a host build defines TRACE_HOST and provides both.
+ */
+#define TRACE_VERSION       1
+#define TRACE_RING_SIZE     512         // events per core, power of 2
+#define TRACE_CORES         2
+
+/* ids are part of the dump: add at the end, with their name in trace.c */
+typedef enum {
+    TR_W6100_IRQ,                       // span: a = bytes received, b = ring slot
+    TR_DDP_LOOP,                        // span: ddp_loop() over the ring
+    TR_DDP_PACKET,                      // instant: a = offset, b = length
+    TR_DDP_PUSH,                        // instant: a = frame length
+    TR_RENDER,                          // span: a = pattern
+    TR_ENCODE,                          // span: frame to the DMA buffer
+    TR_DMA,                             // async: start .. end IRQ, a = strip
+    TR_TASK,                            // span: a = sched task id
+    TR_EFU_RECV,                        // instant: a = EFU state, b = bytes
+    TR_EFU_ERASE,                       // span: a = bytes
+    TR_EFU_PROGRAM,                     // span: a = bytes, b = flash offset
+    TR_EFU_CRC,                         // instant: a = ok, b = crc
+    TR_IDS
+} trace_id_t;
+
+/* phase, the letter of the Chrome trace event format */
+#define TRACE_PH_BEGIN      'B'
+#define TRACE_PH_END        'E'
+#define TRACE_PH_INSTANT    'i'
+#define TRACE_PH_ASYNC_BEGIN 'b'        // end may be on another context / core, matched by a
+#define TRACE_PH_ASYNC_END  'e'
+
+typedef struct {
+    uint32_t ts_us;
+    uint16_t id;                        // trace_id_t
+    uint8_t  ph;                        // TRACE_PH_*
+    uint8_t  rsv;
+    uint32_t a;
+    uint32_t b;
+} trace_evt_t;
+
+#if TRACE_ENABLE
+#define TRACE_BEGIN(id, a, b)       trace_event(id, TRACE_PH_BEGIN, a, b)
+#define TRACE_END(id, a, b)         trace_event(id, TRACE_PH_END, a, b)
+#define TRACE_INSTANT(id, a, b)     trace_event(id, TRACE_PH_INSTANT, a, b)
+#define TRACE_ASYNC_BEGIN(id, a, b) trace_event(id, TRACE_PH_ASYNC_BEGIN, a, b)
+#define TRACE_ASYNC_END(id, a, b)   trace_event(id, TRACE_PH_ASYNC_END, a, b)
+#else
+/* sizeof: a variable only kept for the trace is still used, nothing runs */
+#define TRACE_NONE(a, b)            ((void)(sizeof(a) + sizeof(b)))
+#define TRACE_BEGIN(id, a, b)       TRACE_NONE(a, b)
+#define TRACE_END(id, a, b)         TRACE_NONE(a, b)
+#define TRACE_INSTANT(id, a, b)     TRACE_NONE(a, b)
+#define TRACE_ASYNC_BEGIN(id, a, b) TRACE_NONE(a, b)
+#define TRACE_ASYNC_END(id, a, b)   TRACE_NONE(a, b)
+#endif
+
+void trace_event(trace_id_t id, uint8_t ph, uint32_t a, uint32_t b);
+
+/* off: trace_event() returns at once, the rings keep what they have */
+void trace_enable(bool on);
+bool trace_enabled(void);
+void trace_clear(void);
+
+/* events written on a core since the last clear, the ring holds the newest */
+uint32_t trace_written(uint8_t core);
+
+/* the i-th oldest event held for a core; false past the newest */
+bool trace_get(uint8_t core, uint32_t i, trace_evt_t *evt);
+
+const char *trace_name(uint16_t id);
+
+/* text dump, line by line: "trace" header, "N id name", "E core ts id ph a b"
+   (hex), "end count"; put() gets every line with its CRLF */
+typedef void (*trace_put_fn)(void *ctx, const char *line);
+uint32_t trace_dump(trace_put_fn put, void *ctx);
+
+uint32_t trace_now_us(void);
+uint8_t trace_core(void);
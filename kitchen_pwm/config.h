@@ -72,11 +72,12 @@
  * connect example:
  *   $ nc 192.168.14.225 5000
  *   $ telnet 192.168.14.225 5000
+ * Every client gets its own socket, TCP_CLI_SOCKET .. + TCP_CLI_SESSIONS - 1.
  */
-#define TCP_CLI_SOCKET      0
+#define TCP_CLI_SOCKET      2
+#define TCP_CLI_SESSIONS    3      // sockets 2, 3, 4
 #define TCP_CLI_PORT        5000
 #define CLI_TIMEOUT         20   // 20 seconds
-#define CLI_BUF_RX_SIZE     1024
 // #define ETHERNET_BUF_MAX_SIZE 1024
 
 /**
@@ -94,6 +95,25 @@
 #define UDP_DDP_SOCKET      5      // with port UDP_DDP_PORT 4048
 #define UDP_DDP_PORT        4048
 
+/**
+ * Live telemetry: counters and histograms as binary UDP datagrams
+ * (common/utils/telemetry.h), received with
+ *   $ python3 tools/telemetry/tlm_recv.py
+ * Receiver and period can be changed with "tlm dest" and "tlm rate".
+ */
+#define UDP_TLM_SOCKET      6
+#define UDP_TLM_PORT        3000   // local port and receiver port
+#define UDP_TLM_DESTIP      {192, 168, 14, 200}
+#define UDP_TLM_PERIOD_MS   1000   // 0 = off until "tlm rate"
+
+/**
+ * Deferred log (common/utils/dlog.h): text lines as UDP datagrams after
+ * "log udp <a.b.c.d> [port]" on the CLI, received with e.g.
+ *   $ nc -ukl 3001
+ */
+#define UDP_LOG_SOCKET      7
+#define UDP_LOG_PORT        3001   // local port and default receiver port
+
 /**
  * Configuration for future
  */
@@ -101,12 +121,6 @@
 // #define TCP_HTTP_PORT    80
 // #define TCP_OTA_SOCKET   2
 // #define TCP_OTA_PORT     4242
-//  Remote logging & variable view (for live debug)
-//  Example: a UDP packet every second with JSON text like
-//  {"t":27.5,"uptime":3221,"fps":60}
-// #define UDP_DEB_SOCKET   3
-// #define UDP_DESTIP       192.168.14.200
-// #define UDP_DESTPORT     3000
 
 #define NUM_CHANNELS        4   // 3 for RGB, or 4 for RGBW - used in DDP (network.c)
 #define NUM_PIXELS          1
@@ -150,6 +164,8 @@
 
 #endif // VL53_SPI
 
+// #define _VL53_CSV_DEBUG_   // print every zone frame as CSV on USB (for vl53_scene_replay)
+
 // doc: I2C0_SDA --> 0,
 // doc: I2C0_SCL --> 1,
 
@@ -173,6 +189,16 @@
 #define PWM_MAX      PWM_WRAP     // hardware domain
 #define PWM_MIN_ON   1
 
+/**
+ * Sigma-delta dithering of the compare value, period to period (pwm_fade.c).
+ * Bits of duty below one PWM count: effective WRAP_BITS + PWM_DITHER_BITS.
+ * The slowest dither cycle is 2^bits periods: 4 -> 125 Hz at 2 kHz.
+ * 0 = off, the compare value is written once per change (max 6).
+ */
+#ifndef PWM_DITHER_BITS
+#define PWM_DITHER_BITS   4
+#endif
+
 /**
  * Optionally 1 driver (gp3) or rgbw (gp4,5,6,7)
  */
@@ -187,6 +213,20 @@
 #define PWM_LED_R    6  // GP6 -> PWM_3A
 #define PWM_LED_G    7  // GP7 -> PWM_3B
 
+/**
+ * PWM fixtures (pwm_fixture.h): one RGBW pixel of the DDP frame each.
+ *  pins R, G, B, W (-1 = not fitted), active low per channel, gamma x10,
+ *  DDP pixel index (in pixels of the configured DDP format).
+ * GPIO 0..29 reach PWM slices 0..7 (slices 8..11 need RP2350B GPIO 32..47);
+ * free on this board: 0..3, 12 (only without VL53_SPI, its MISO), 13, 26..28
+ * (8..11 VL53, 14/15 RD-03D, 16..21 W6100).
+ */
+#define PWM_FIXTURE_MAX     6
+#define PWM_FIXTURES { \
+    { "main",    { PWM_LED_R, PWM_LED_G, PWM_LED_B, PWM_LED_W }, { true, true, true, false }, 22, 0 }, \
+    /* { "cabinet", { 0, 1, 2, 3 }, { false, false, false, false }, 22, 1 }, */ \
+}
+
 // // Fixed wiring
 // #define VL53_PIN_SPI_I2C_N -1  // tied to 3V3 on PCB
 
@@ -195,4 +235,7 @@
 #define RD03D_TX_PIN  15  // GP15 -> UART0_RX   black
 #define RD03D_RX_PIN  14  // GP14 -> UART0_TX   red
 #define RD03D_BAUDRATE 256000  // default UART rate for RD03D
+#define RD03D_UART_DMA          // UART RX by DMA into the parser ring, survives long main loop passes
+#define RD03D_RX_RING_SIZE 512  // 17 radar frames, ~1.7 s of reports
+// #define _RD03D_CSV_DEBUG_   // print every radar frame as CSV on USB (for presence_replay)
 
@@ -20,9 +20,18 @@
 #include "flash_cfg.h"      // see tree
 #include "vl53l8cx_drv.h"
 #include "pwm_api.h"
+#include "pwm_timeline.h"
 #include "rd03d_api.h"
+#include "rd03d_cli.h"
+#include "presence.h"
+#include "occupancy.h"
 #include <stdio.h>
 #include "telnet.h"
+#include "sched.h"
+#include "telemetry.h"
+#include "dlog.h"
+#include "cli_io.h"
+#include "rd03d_drv.h"
 
 
 // variables for TCP loopback
@@ -32,9 +41,6 @@
 
 int32_t ret;
 
-static repeating_timer_t timer;
-volatile uint32_t tmr_ms_tick = 0;
-
 const network_t default_network = {
     .ip  = NETINFO_IP,
     .sn  = NETINFO_SN,
@@ -42,21 +48,75 @@ const network_t default_network = {
     .dns = NETINFO_DNS
 };
 
-// bool timer_callback(repeating_timer_t *rt) {
-bool timer_callback() {
-    tmr_ms_tick++;  // Increment every 1 ms
-    return true;    // Return true to keep repeating
-}
-
 // // CLI variables
 // uint8_t cli_buf_rx[CLI_BUF_RX_SIZE];
 
 // DDP variables
 //                            (NUM_STRIPS*NUM_PIXELS*NUM_CHANNELS)
-#define DDP_DATA_BUF_SIZE     (NUM_PIXELS*NUM_CHANNELS)  // clamp to your RAM
+// one RGBW value, or a whole fade timeline (DDP_FMT_TIMELINE)
+#define DDP_DATA_BUF_SIZE     (DDP_TL_REC_LEN*PWM_TL_MAX_SEGS)  // clamp to your RAM
 uint8_t ddp_buf_frame[DDP_DATA_BUF_SIZE]; // buffer for receiving DDP packets
 // uint8_t rx_fb[NUM_STRIPS*NUM_PIXELS*NUM_CHANNELS]; // flat rx buffer for UDP DDP packets
 
+// Main loop tasks, see sched.h. Budgets are measured worst cases.
+static void task_ddp(void) {
+    ddp_loop();             //  (&pkt_counter, &last_push_ms);
+}
+
+static void task_cli(void) {
+    tcp_cli_service();      // Sockets 2-4 : CLI sessions           [5000]
+    rd03d_cli_tick();       // "rd03d dump" to the USB console
+}
+
+// Telemetry totals kept by other modules, read before every datagram
+static void tlm_collect(void) {
+    uint32_t overruns = 0, misses = 0;
+    const sched_task_t *t;
+
+    for (int i = 0; (t = sched_get_task(i)) != NULL; i++) {
+        overruns += t->overruns;
+        misses += t->misses;
+    }
+    tlm_set(TLM_SCHED_OVERRUNS, overruns);
+    tlm_set(TLM_SCHED_MISSES, misses);
+    tlm_set(TLM_CLI_LINES, cli_io_stats()->lines);
+#ifdef VL53L8CX_DEV
+    const vl53_fetch_stats_t *vl53 = vl53l8cx_fetch_stats();
+
+    tlm_set(TLM_SENSOR_FRAMES, vl53->frames);
+    tlm_set(TLM_SENSOR_ERRORS, vl53->errors + vl53->corrupt);
+#endif
+    rd03d_drv_stats_t radar = rd03d_drv_get_stats();
+
+    tlm_set(TLM_RADAR_FRAMES, radar.frames);
+    tlm_set(TLM_RADAR_ERRORS, radar.overrun_bytes + radar.resync_bytes);
+}
+
+static void task_tlm(void) {
+    tlm_service();          // UDP_TLM_SOCKET : telemetry datagrams   [3000]
+}
+
+// printf() of the hot paths, formatted here in the time the others leave
+static void task_log(void) {
+    dlog_drain(DLOG_DRAIN_BUDGET_US);   // USB, "log cli", UDP_LOG_SOCKET [3001]
+}
+
+static void register_tasks(void) {
+    sched_add("pwm", pwm_api_poll, 5000, 0, 300, 0);        // fades, non-blocking, cheap
+    sched_add("ddp", task_ddp, 2000, 0, 700, 1);
+    // radar frames may be dropped while a firmware upload is running
+    sched_add("efu", efu_server_poll, 2000, 0, 1200, 2);   // TCP_EFU_SOCKET : Eth-Fw-Upd [4243]
+    sched_add("rd03d", rd03d_api_poll, 1000, 0, 200, 3);    // 32 byte UART FIFO at 256 kbaud
+    sched_add("cli", task_cli, 5000, 0, 1000, 4);
+#ifdef VL53L8CX_DEV
+    sched_add("vl53", vl53l8cx_loop, 5000, 0, 800, 5);     // non-blocking polling
+#endif
+    // presence decisions run in the radar / VL53 frame hooks, this only times the fade-out
+    sched_add("auto", presence_poll, 100000, 0, 20, 6);
+    sched_add("tlm", task_tlm, 10000, 0, 300, 7);
+    sched_add("log", task_log, 20000, 0, 500, 8);
+}
+
 
 int main() {
     // variables for performance measurement
@@ -95,6 +155,16 @@ int main() {
     // --- Open UDP socket for DDP ---
     // udp_socket_init();
     udp_ddp_init(UDP_DDP_SOCKET, UDP_DDP_PORT, ddp_buf_frame, DDP_DATA_BUF_SIZE);
+    udp_ddp_push_hook(pwm_rgbw_ddp_ingest);    // PUSH frames go to pwm_api.c
+
+    // --- Telemetry datagrams ---
+    const uint8_t tlm_destip[4] = UDP_TLM_DESTIP;
+    udp_tlm_init(UDP_TLM_SOCKET, UDP_TLM_PORT, tlm_destip, UDP_TLM_PERIOD_MS);
+    tlm_collect_hook(tlm_collect);
+
+    // --- Deferred log over UDP, off until "log udp" ---
+    udp_log_init(UDP_LOG_SOCKET, UDP_LOG_PORT);
+
     udp_interrupts_enable();          // sets up interrupts for UDP socket for DDP reception
     wiznet_gpio_irq_init();     // sets up GPIO interrupt for WIZnet IRQ pin
 
@@ -117,12 +187,14 @@ int main() {
     rd03d_filter_cfg_t *cfg = NULL;
     rd03d_api_init(cfg);
 
-    // Create repeating timer with 1 ms interval
-    // if (!add_repeating_timer_ms(1, timer_callback, NULL, &timer)) {
-    if (!add_repeating_timer_ms(1, timer_callback, NULL, &timer)) {
-        printf("Failed to add timer\n");
-        while (1);
-    }
+    // --- radar occupancy zones, before presence: its rules read the zones of each frame ---
+    occupancy_init();
+
+    // --- presence automation: rules from flash, radar (+ VL53) frame hooks ---
+    presence_init();
+    #ifdef VL53L8CX_DEV
+    vl53l8cx_frame_hook(presence_on_vl53);
+    #endif // VL53L8CX_DEV
 
     // absolute_time_t last_log = get_absolute_time();
     // gpio_init(PIN_TEST_14);
@@ -138,32 +210,7 @@ int main() {
     #endif  // OUTDOOR_TREE_WS2815
 
     // --- Main loop ---
-    while (true) {
-        // time_start = time_us_32();  // compare with get_absolute_time()
-        // remove: loopback_loop(message_buf);
-        tcp_cli_service();          // Socket 0 : CLI                       [5000]
-        // http_server_service();   // TCP_HTTP_SOCKET : HTTP (future)      [80]
-        // tcp_ota_service(); $ vim ../pico-examples/pico_w/wifi/ota_update/README.md
-        efu_server_poll();          // TCP_EFU_SOCKET  : Eth-Fw-Upd         [4243]
-
-
-        // Poll the UDP socket
-        ddp_loop();       //  (&pkt_counter, &last_push_ms);
-
-        pwm_api_poll();   // non-blocking, cheap
-
-        rd03d_api_poll();
-
-        // Manage ws2815 loop control
-        // run_periodically_ws2815_tasks();    // ws2815_loop();
-
-        // VL53L8CX non-blocking polling
-        #ifdef VL53L8CX_DEV
-        vl53l8cx_loop();
-        #endif // VL53L8CX_DEV
-
-        tight_loop_contents(); // yield to SDK
-    }
+    // http_server_service();   // TCP_HTTP_SOCKET : HTTP (future)      [80]
+    register_tasks();
+    sched_run();                // never returns
 }
-
-
@@ -0,0 +1,289 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "occupancy.h"
+#include "config.h"
+
+/* Edge compiled for the crossing test, lower end first. Horizontal edges
+ * never cross a horizontal ray and are dropped. */
+typedef struct {
+    int16_t y0, y1;             // covers y0 <= y < y1
+    int16_t x0;                 // x at y0
+    int16_t dx, dy;             // to the upper end, dy > 0
+} occ_edge_t;
+
+typedef struct {
+    int16_t xmin, xmax, ymin, ymax;
+    uint8_t n_edges;
+    occ_edge_t e[OCC_VERTS_MAX];
+} occ_poly_t;
+
+static occ_zones_t      s_zones;
+static occ_poly_t       s_poly[OCC_ZONES_MAX];
+static occ_zone_state_t s_state[OCC_ZONES_MAX];
+static occ_event_fn     s_out;
+
+void occupancy_zones_default(occ_zones_t *z)
+{
+    memset(z, 0, sizeof(*z));
+    z->version      = OCC_ZONES_VERSION;
+    z->enter_frames = 3;        // 300 ms at the 10 Hz radar rate
+    z->exit_ms      = 2000;
+    z->zone_count   = 3;
+    z->zone[0] = (occ_zone_def_t){ .name = "sink", .n = 4, .brightness = LINEAR_MAX,
+        .v = { { -1600, 300 }, { -400, 300 }, { -400, 1300 }, { -1600, 1300 } } };
+    z->zone[1] = (occ_zone_def_t){ .name = "stove", .n = 4, .brightness = LINEAR_MAX * 4 / 5,
+        .v = { { 400, 300 }, { 1600, 300 }, { 1600, 1300 }, { 400, 1300 } } };
+    z->zone[2] = (occ_zone_def_t){ .name = "pass", .n = 4, .brightness = 0,
+        .v = { { -2500, 2500 }, { 2500, 2500 }, { 2500, 4500 }, { -2500, 4500 } } };
+}
+
+/* twice the signed area, 0 for a degenerate polygon */
+static int64_t area2(const occ_zone_def_t *d)
+{
+    int64_t a = 0;
+
+    for (uint8_t i = 0; i < d->n; i++) {
+        const occ_point_t *p = &d->v[i], *q = &d->v[(i + 1u) % d->n];
+        a += (int64_t)p->x_mm * q->y_mm - (int64_t)q->x_mm * p->y_mm;
+    }
+    return a;
+}
+
+bool occupancy_zones_valid(const occ_zones_t *z)
+{
+    if (z->version != OCC_ZONES_VERSION || z->zone_count > OCC_ZONES_MAX || z->enter_frames == 0)
+        return false;
+    for (uint8_t i = 0; i < z->zone_count; i++) {
+        const occ_zone_def_t *d = &z->zone[i];
+
+        if (d->n < 3 || d->n > OCC_VERTS_MAX || d->brightness > LINEAR_MAX)
+            return false;
+        for (uint8_t k = 0; k < d->n; k++)
+            if (d->v[k].x_mm < -OCC_COORD_MAX || d->v[k].x_mm > OCC_COORD_MAX ||
+                d->v[k].y_mm < -OCC_COORD_MAX || d->v[k].y_mm > OCC_COORD_MAX)
+                return false;
+        if (area2(d) == 0)
+            return false;
+    }
+    return true;
+}
+
+static void compile(occ_poly_t *p, const occ_zone_def_t *d)
+{
+    memset(p, 0, sizeof(*p));
+    p->xmin = p->ymin = INT16_MAX;
+    p->xmax = p->ymax = INT16_MIN;
+
+    for (uint8_t i = 0; i < d->n; i++) {
+        occ_point_t a = d->v[i], b = d->v[(i + 1u) % d->n];
+
+        if (a.x_mm < p->xmin) p->xmin = a.x_mm;
+        if (a.x_mm > p->xmax) p->xmax = a.x_mm;
+        if (a.y_mm < p->ymin) p->ymin = a.y_mm;
+        if (a.y_mm > p->ymax) p->ymax = a.y_mm;
+
+        if (a.y_mm == b.y_mm)
+            continue;
+        if (a.y_mm > b.y_mm) {
+            occ_point_t t = a;
+            a = b;
+            b = t;
+        }
+        p->e[p->n_edges++] = (occ_edge_t){
+            .y0 = a.y_mm, .y1 = b.y_mm, .x0 = a.x_mm,
+            .dx = (int16_t)(b.x_mm - a.x_mm), .dy = (int16_t)(b.y_mm - a.y_mm),
+        };
+    }
+}
+
+/**
+ * Crossing number of a ray from (x, y) towards +x. An edge counts when y
+ * is in [y0, y1) and the point lies strictly left of it, so a point on an
+ * edge shared by two zones is inside exactly one of them.
+ */
+static bool poly_contains(const occ_poly_t *p, int32_t x, int32_t y)
+{
+    bool in = false;
+
+    if (x < p->xmin || x > p->xmax || y < p->ymin || y >= p->ymax)
+        return false;
+    for (uint8_t i = 0; i < p->n_edges; i++) {
+        const occ_edge_t *e = &p->e[i];
+        if (y < e->y0 || y >= e->y1)
+            continue;
+        if ((x - e->x0) * e->dy < (y - e->y0) * e->dx)
+            in = !in;
+    }
+    return in;
+}
+
+static int32_t clamp_coord(int32_t v)
+{
+    return (v > OCC_COORD_MAX) ? OCC_COORD_MAX : (v < -OCC_COORD_MAX) ? -OCC_COORD_MAX : v;
+}
+
+bool occupancy_point_in(uint8_t zone, int16_t x_mm, int16_t y_mm)
+{
+    if (zone >= s_zones.zone_count)
+        return false;
+    return poly_contains(&s_poly[zone], clamp_coord(x_mm), clamp_coord(y_mm));
+}
+
+/* new zone set; visits in progress end without an EXIT event */
+bool occupancy_engine_init(const occ_zones_t *z, occ_event_fn out)
+{
+    if (!occupancy_zones_valid(z))
+        return false;
+
+    s_zones = *z;
+    s_out = out;
+    memset(s_state, 0, sizeof(s_state));
+    for (uint8_t i = 0; i < s_zones.zone_count; i++)
+        compile(&s_poly[i], &s_zones.zone[i]);
+    return true;
+}
+
+static void emit(uint8_t kind, uint8_t zone, uint32_t t_ms, uint32_t dwell_ms)
+{
+    occ_event_t e = { .kind = kind, .zone = zone, .t_ms = t_ms, .dwell_ms = dwell_ms };
+
+    if (s_out)
+        s_out(&e);
+}
+
+/**
+ * New radar frame: count the valid tracks in every zone, then debounce
+ * entries over enter_frames frames and exits over exit_ms.
+ */
+void occupancy_on_radar(const rd03d_state_t *st)
+{
+    uint32_t t = st->rx_time_ms;
+
+    for (uint8_t z = 0; z < s_zones.zone_count; z++) {
+        occ_zone_state_t *s = &s_state[z];
+        uint8_t n = 0;
+
+        for (int i = 0; i < RD03D_TRACKS; i++) {
+            const rd03d_track_t *tr = &st->track[i];
+            if (tr->valid && poly_contains(&s_poly[z], clamp_coord(tr->x_mm), clamp_coord(tr->y_mm)))
+                n++;
+        }
+        s->tracks = n;
+
+        if (n) {
+            if (s->frames_in == 0 && !s->occupied)
+                s->since_ms = t;            // first frame of a possible visit
+            if (s->frames_in < UINT8_MAX)
+                s->frames_in++;
+            s->last_in_ms = t;
+            if (!s->occupied && s->frames_in >= s_zones.enter_frames) {
+                s->occupied = true;
+                s->visits++;
+                emit(OCC_EVT_ENTER, z, t, 0);
+            }
+        } else {
+            s->frames_in = 0;
+            if (s->occupied && t - s->last_in_ms >= s_zones.exit_ms) {
+                uint32_t dwell = s->last_in_ms - s->since_ms;
+                s->occupied = false;
+                s->total_ms += dwell;
+                emit(OCC_EVT_EXIT, z, t, dwell);
+            }
+        }
+    }
+}
+
+uint8_t occupancy_zone_count(void)
+{
+    return s_zones.zone_count;
+}
+
+const occ_zone_state_t *occupancy_zone_state(uint8_t zone)
+{
+    return (zone < s_zones.zone_count) ? &s_state[zone] : NULL;
+}
+
+uint32_t occupancy_dwell_ms(uint8_t zone, uint32_t now_ms)
+{
+    if (zone >= s_zones.zone_count || !s_state[zone].occupied)
+        return 0;
+    return now_ms - s_state[zone].since_ms;
+}
+
+uint8_t occupancy_light_zone(uint16_t *brightness)
+{
+    uint8_t best = OCC_ZONE_NONE;
+
+    for (uint8_t z = 0; z < s_zones.zone_count; z++) {
+        uint16_t b = s_zones.zone[z].brightness;
+        if (s_state[z].occupied && b && (best == OCC_ZONE_NONE || b > s_zones.zone[best].brightness))
+            best = z;
+    }
+    if (brightness)
+        *brightness = (best == OCC_ZONE_NONE) ? 0 : s_zones.zone[best].brightness;
+    return best;
+}
+
+#ifndef OCCUPANCY_HOST
+/* ---------- target glue ---------- */
+#include <stdio.h>
+#include "flash_cfg.h"
+#include "presence.h"
+
+static occ_zones_t s_stored;        // edited by the CLI, applied by occupancy_zones_apply()
+
+static void on_event(const occ_event_t *e)
+{
+    printf("[OCC] %s %.*s t=%lu dwell=%lu ms\n", e->kind == OCC_EVT_ENTER ? "enter" : "exit",
+           OCC_NAME_LEN, s_stored.zone[e->zone].name,
+           (unsigned long)e->t_ms, (unsigned long)e->dwell_ms);
+}
+
+/* with zones the lights follow the occupied zone, without them the y bands of the rules */
+static bool apply(void)
+{
+    bool ok = occupancy_engine_init(&s_stored, on_event);
+
+    presence_zone_source(occupancy_zone_count() ? occupancy_light_zone : NULL);
+    return ok;
+}
+
+/**
+ * Zones from the Config partition (defaults when missing or stale), radar
+ * frames from rd03d_api_poll(). Call after rd03d_api_init() and before
+ * presence_init(): frame hooks run in the order they were added, so the
+ * presence rules see the zones of the same frame.
+ */
+void occupancy_init(void)
+{
+    if (!config_blob_load(CONFIG_BLOB_OCCUPANCY, &s_stored, sizeof(s_stored)) ||
+        !occupancy_zones_valid(&s_stored)) {
+        occupancy_zones_default(&s_stored);
+    }
+    apply();
+    rd03d_api_frame_hook(occupancy_on_radar);
+}
+
+occ_zones_t *occupancy_zones(void)
+{
+    return &s_stored;
+}
+
+bool occupancy_zones_apply(void)
+{
+    return apply();
+}
+
+bool occupancy_zones_save(void)
+{
+    if (!occupancy_zones_valid(&s_stored))
+        return false;
+    return config_blob_save(CONFIG_BLOB_OCCUPANCY, &s_stored, sizeof(s_stored));
+}
+#endif // OCCUPANCY_HOST
@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "rd03d_api.h"
+
+/**
+ * Radar occupancy: the valid tracks of every radar frame are placed in
+ * user-drawn polygon zones ("sink", "stove", "door"). A zone is entered
+ * after enter_frames frames with a track inside and left exit_ms after the
+ * last one; both are events, and every zone keeps its dwell time and visit
+ * count. Polygons are compiled once into integer edge tables, so a frame
+ * costs a bounding box test per track and zone, and a few multiplies for
+ * the boxes that hit. No SDK dependency; events leave through a callback.
+ *
+ * Coordinates are radar mm (x across, y away from the sensor). A point on
+ * a boundary belongs to exactly one of two zones sharing that edge.
+ */
+#define OCC_ZONES_MAX       6
+#define OCC_VERTS_MAX       6
+#define OCC_NAME_LEN        8
+#define OCC_COORD_MAX       16000       // |x|, |y| of vertices, keeps the edge tests in 32 bits
+#define OCC_ZONES_VERSION   1
+
+typedef struct {
+    int16_t x_mm, y_mm;
+} occ_point_t;
+
+typedef struct {
+    char     name[OCC_NAME_LEN];    // not terminated when all 8 are used
+    uint8_t  n;                     // vertices, 3..OCC_VERTS_MAX
+    uint8_t  reserved;
+    uint16_t brightness;            // lights at this zone, 0 = zone does not drive them
+    occ_point_t v[OCC_VERTS_MAX];   // either winding, no repeated first vertex
+} occ_zone_def_t;
+
+/* stored as a blob in the Config partition (flash_cfg.h) */
+typedef struct {
+    uint16_t version;
+    uint8_t  zone_count;
+    uint8_t  enter_frames;          // frames with a track inside before ENTER
+    uint16_t exit_ms;               // time without one before EXIT
+    uint16_t reserved;
+    occ_zone_def_t zone[OCC_ZONES_MAX];
+} occ_zones_t;
+
+typedef enum {
+    OCC_EVT_ENTER = 0,
+    OCC_EVT_EXIT,
+} occ_event_kind_t;
+
+typedef struct {
+    uint8_t  kind;                  // occ_event_kind_t
+    uint8_t  zone;
+    uint32_t t_ms;
+    uint32_t dwell_ms;              // length of the visit, EXIT only
+} occ_event_t;
+
+typedef void (*occ_event_fn)(const occ_event_t *e);
+
+typedef struct {
+    bool     occupied;
+    uint8_t  tracks;                // valid tracks inside in the last frame
+    uint8_t  frames_in;             // consecutive frames with a track inside
+    uint32_t since_ms;              // entry time of the current visit
+    uint32_t last_in_ms;            // last frame with a track inside
+    uint32_t visits;
+    uint32_t total_ms;              // dwell of the finished visits
+} occ_zone_state_t;
+
+void occupancy_zones_default(occ_zones_t *z);
+bool occupancy_zones_valid(const occ_zones_t *z);
+
+/* engine, host and target */
+bool occupancy_engine_init(const occ_zones_t *z, occ_event_fn out);
+void occupancy_on_radar(const rd03d_state_t *st);
+bool occupancy_point_in(uint8_t zone, int16_t x_mm, int16_t y_mm);
+uint8_t occupancy_zone_count(void);
+const occ_zone_state_t *occupancy_zone_state(uint8_t zone);
+uint32_t occupancy_dwell_ms(uint8_t zone, uint32_t now_ms);
+
+/* occupied zone with the highest brightness, OCC_ZONE_NONE when none drives the lights */
+#define OCC_ZONE_NONE       0xFF
+uint8_t occupancy_light_zone(uint16_t *brightness);
+
+/* target glue (occupancy.c, not in OCCUPANCY_HOST builds) */
+void occupancy_init(void);
+occ_zones_t *occupancy_zones(void);
+bool occupancy_zones_apply(void);
+bool occupancy_zones_save(void);
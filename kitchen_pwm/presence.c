@@ -0,0 +1,296 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "presence.h"
+#include "config.h"
+
+#define ZONE_NONE   0xFF
+
+static presence_rules_t   s_rules;
+static presence_action_fn s_out;
+
+static uint8_t  s_phase;
+static uint8_t  s_zone;             // zone the lights are at
+static uint8_t  s_cand_zone;        // zone waiting for zone_frames
+static uint8_t  s_cand_frames;
+static int16_t  s_y_mm;
+static uint32_t s_deadline_ms;
+static uint32_t s_actions;
+
+static bool     s_radar_seen;       // radar presence of the last frame
+static uint8_t  s_radar_zone;
+static presence_zone_fn s_zone_src; // NULL = y bands of the rules
+static uint16_t s_src_level;        // brightness of the source's zone
+static uint16_t s_vl53_mm;
+static uint32_t s_vl53_ms;
+
+void presence_rules_default(presence_rules_t *r)
+{
+    memset(r, 0, sizeof(*r));
+    r->version      = PRESENCE_RULES_VERSION;
+    r->enabled      = 1;
+    r->on_color     = (rgbw16_t){ 0, 0, 0, LINEAR_MAX };
+    r->on_fade_ms   = 500;
+    r->off_fade_ms  = 3000;
+    r->hold_ms      = 60000;
+    r->vl53_near_mm = 0;
+    r->zone_frames  = 3;        // 300 ms at the 10 Hz radar rate
+    r->zone_count   = 3;
+    r->zone[0] = (presence_zone_t){ 1500, LINEAR_MAX };         // at the counter
+    r->zone[1] = (presence_zone_t){ 3500, LINEAR_MAX * 3 / 5 }; // in the kitchen
+    r->zone[2] = (presence_zone_t){ 6000, LINEAR_MAX / 4 };     // doorway
+}
+
+bool presence_rules_valid(const presence_rules_t *r)
+{
+    if (r->version != PRESENCE_RULES_VERSION || r->zone_count > PRESENCE_ZONES_MAX)
+        return false;
+    for (uint8_t i = 0; i < r->zone_count; i++) {
+        if (r->zone[i].brightness > LINEAR_MAX)
+            return false;
+        if (i > 0 && r->zone[i].y_max_mm <= r->zone[i - 1].y_max_mm)
+            return false;
+    }
+    return true;
+}
+
+/* first zone reaching y, ZONE_NONE beyond the last one */
+static uint8_t zone_of(uint16_t y_mm)
+{
+    if (s_rules.zone_count == 0)
+        return 0;
+    for (uint8_t i = 0; i < s_rules.zone_count; i++)
+        if (y_mm <= s_rules.zone[i].y_max_mm)
+            return i;
+    return ZONE_NONE;
+}
+
+static uint16_t zone_brightness(uint8_t zone)
+{
+    if (s_zone_src && s_radar_seen)
+        return s_src_level;
+    return (s_rules.zone_count == 0) ? LINEAR_MAX : s_rules.zone[zone].brightness;
+}
+
+static void emit(uint8_t kind, uint32_t t_ms)
+{
+    presence_action_t a = {
+        .kind       = kind,
+        .zone       = s_zone,
+        .brightness = zone_brightness(s_zone),
+        .color      = s_rules.on_color,
+        .fade_ms    = (kind == PRESENCE_ACT_OFF) ? s_rules.off_fade_ms : s_rules.on_fade_ms,
+        .t_ms       = t_ms,
+    };
+
+    s_actions++;
+    if (s_out)
+        s_out(&a);
+}
+
+static bool vl53_present(uint32_t t_ms)
+{
+    return s_rules.vl53_near_mm && s_vl53_mm && s_vl53_mm < s_rules.vl53_near_mm &&
+           (uint32_t)(t_ms - s_vl53_ms) <= PRESENCE_VL53_STALE_MS;
+}
+
+/* one decision per sensor event: 'zone' is where somebody is, ZONE_NONE for nobody */
+static void decide(uint8_t zone, uint32_t t_ms)
+{
+    if (!s_rules.enabled)
+        return;
+
+    if (zone == ZONE_NONE) {
+        s_cand_frames = 0;
+        if (s_phase == PRESENCE_ON) {
+            s_phase = PRESENCE_HOLD;
+            s_deadline_ms = t_ms + s_rules.hold_ms;
+        }
+        return;
+    }
+
+    if (s_phase == PRESENCE_IDLE) {
+        s_zone = zone;
+        s_cand_frames = 0;
+        s_phase = PRESENCE_ON;
+        emit(PRESENCE_ACT_ON, t_ms);
+        return;
+    }
+
+    s_phase = PRESENCE_ON;
+    if (zone == s_zone) {
+        s_cand_frames = 0;
+        return;
+    }
+    if (zone != s_cand_zone) {
+        s_cand_zone = zone;
+        s_cand_frames = 0;
+    }
+    if (++s_cand_frames >= s_rules.zone_frames) {
+        s_zone = zone;
+        s_cand_frames = 0;
+        emit(PRESENCE_ACT_LEVEL, t_ms);
+    }
+}
+
+static uint8_t current_zone(uint32_t t_ms)
+{
+    if (s_radar_seen)
+        return s_radar_zone;
+    return vl53_present(t_ms) ? 0 : ZONE_NONE;
+}
+
+void presence_engine_init(const presence_rules_t *r, presence_action_fn out)
+{
+    s_rules = *r;
+    s_out = out;
+    s_phase = PRESENCE_IDLE;
+    s_zone = 0;
+    s_cand_zone = ZONE_NONE;
+    s_cand_frames = 0;
+    s_y_mm = -1;
+    s_deadline_ms = 0;
+    s_actions = 0;
+    s_radar_seen = false;
+    s_vl53_mm = 0;
+}
+
+/**
+ * New radar frame: the valid track with the smallest y decides the zone.
+ * Tracks beyond the last zone are ignored (passers-by outside the kitchen).
+ */
+void presence_on_radar(const rd03d_state_t *st)
+{
+    int16_t y = -1;
+
+    if (st->presence) {
+        for (int i = 0; i < RD03D_TRACKS; i++) {
+            const rd03d_track_t *t = &st->track[i];
+            int16_t ty = (int16_t)((t->y_mm < 0) ? -t->y_mm : t->y_mm);
+
+            if (t->valid && (y < 0 || ty < y))
+                y = ty;
+        }
+    }
+
+    s_y_mm = y;
+    if (s_zone_src)
+        s_radar_zone = s_zone_src(&s_src_level);
+    else
+        s_radar_zone = (y < 0) ? ZONE_NONE : zone_of((uint16_t)y);
+    s_radar_seen = (s_radar_zone != ZONE_NONE);
+    decide(current_zone(st->rx_time_ms), st->rx_time_ms);
+}
+
+void presence_zone_source(presence_zone_fn fn)
+{
+    s_zone_src = fn;
+}
+
+/**
+ * New VL53 frame, nearest valid zone distance (0 = nothing). Closer than
+ * vl53_near_mm counts as presence at zone 0 when the radar sees nobody.
+ */
+void presence_on_vl53(uint16_t nearest_mm, uint32_t t_ms)
+{
+    if (!s_rules.vl53_near_mm)
+        return;
+    s_vl53_mm = nearest_mm;
+    s_vl53_ms = t_ms;
+    decide(current_zone(t_ms), t_ms);
+}
+
+/**
+ * Fade out after hold_ms without presence. Only compares the deadline, call
+ * it at any rate that is fine enough for the fade-out (100 ms).
+ */
+void presence_tick(uint32_t now_ms)
+{
+    if (s_phase != PRESENCE_HOLD || (int32_t)(now_ms - s_deadline_ms) < 0)
+        return;
+    s_phase = PRESENCE_IDLE;
+    s_cand_frames = 0;
+    if (s_rules.enabled)
+        emit(PRESENCE_ACT_OFF, now_ms);
+}
+
+presence_status_t presence_get_status(void)
+{
+    presence_status_t st = {
+        .phase       = s_phase,
+        .zone        = s_zone,
+        .y_mm        = s_y_mm,
+        .deadline_ms = s_deadline_ms,
+        .actions     = s_actions,
+    };
+    return st;
+}
+
+#ifndef PRESENCE_HOST
+/* ---------- target glue ---------- */
+#include "pico/time.h"
+#include "flash_cfg.h"
+
+static presence_rules_t s_stored;   // edited by the CLI, applied by presence_rules_apply()
+
+static void act(const presence_action_t *a)
+{
+    switch (a->kind) {
+        case PRESENCE_ACT_ON:
+            pwm_rgbw_set_brightness(a->brightness);
+            pwm_rgbw_fade_to(a->color, a->fade_ms);
+            break;
+        case PRESENCE_ACT_LEVEL:
+            pwm_rgbw_set_brightness(a->brightness);
+            break;
+        case PRESENCE_ACT_OFF:
+            pwm_rgbw_fade_to((rgbw16_t){ 0 }, a->fade_ms);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Rules from the Config partition (defaults when missing or stale), radar
+ * frames delivered by rd03d_api_poll(). Call after pwm_mod_init() and
+ * rd03d_api_init().
+ */
+void presence_init(void)
+{
+    if (!config_blob_load(CONFIG_BLOB_PRESENCE, &s_stored, sizeof(s_stored)) ||
+        !presence_rules_valid(&s_stored)) {
+        presence_rules_default(&s_stored);
+    }
+    presence_engine_init(&s_stored, act);
+    rd03d_api_frame_hook(presence_on_radar);
+}
+
+void presence_poll(void)
+{
+    presence_tick(to_ms_since_boot(get_absolute_time()));
+}
+
+presence_rules_t *presence_rules(void)
+{
+    return &s_stored;
+}
+
+/* restart the engine with the edited rules, lights are left as they are */
+void presence_rules_apply(void)
+{
+    presence_engine_init(&s_stored, act);
+}
+
+bool presence_rules_save(void)
+{
+    if (!presence_rules_valid(&s_stored))
+        return false;
+    return config_blob_save(CONFIG_BLOB_PRESENCE, &s_stored, sizeof(s_stored));
+}
+#endif // PRESENCE_HOST
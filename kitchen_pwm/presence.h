@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "pwm_api.h"
+#include "rd03d_api.h"
+
+/**
+ * Presence automation: radar frames (and optionally the VL53 nearest
+ * distance) drive the lights with a few rules
+ *  - presence      -> fade on to on_color
+ *  - absence       -> hold_ms later fade out
+ *  - zone by y_mm  -> brightness of that zone
+ * Decisions are made on events only: a new radar / VL53 frame, or the hold
+ * deadline in presence_tick(). The engine has no SDK dependency; actions
+ * leave through a callback (pwm_api.c on the target, a recorder on the host).
+ */
+#define PRESENCE_ZONES_MAX      4
+#define PRESENCE_RULES_VERSION  1
+#define PRESENCE_VL53_STALE_MS  1000    // VL53 reading older than this is ignored
+
+typedef struct {
+    uint16_t y_max_mm;          // zone reaches up to this distance
+    uint16_t brightness;        // 0..LINEAR_MAX
+} presence_zone_t;
+
+/* stored as a blob in the Config partition (flash_cfg.h) */
+typedef struct {
+    uint16_t version;
+    uint8_t  enabled;
+    uint8_t  zone_count;        // 0 = whole radar range, full brightness
+    rgbw16_t on_color;
+    uint16_t on_fade_ms;
+    uint16_t off_fade_ms;
+    uint32_t hold_ms;           // absence before the fade-out
+    uint16_t vl53_near_mm;      // VL53 closer than this is presence, 0 = unused
+    uint8_t  zone_frames;       // frames a new zone must persist
+    uint8_t  reserved;
+    presence_zone_t zone[PRESENCE_ZONES_MAX];   // ascending y_max_mm
+} presence_rules_t;
+
+typedef enum {
+    PRESENCE_ACT_ON = 0,        // fade to color at brightness
+    PRESENCE_ACT_LEVEL,         // brightness only
+    PRESENCE_ACT_OFF,           // fade to black
+} presence_act_kind_t;
+
+typedef struct {
+    uint8_t  kind;              // presence_act_kind_t
+    uint8_t  zone;
+    uint16_t brightness;
+    rgbw16_t color;
+    uint16_t fade_ms;
+    uint32_t t_ms;              // time of the event that decided it
+} presence_action_t;
+
+typedef void (*presence_action_fn)(const presence_action_t *a);
+
+typedef enum {
+    PRESENCE_IDLE = 0,          // lights left alone / faded out
+    PRESENCE_ON,
+    PRESENCE_HOLD,              // nobody seen, waiting for hold_ms
+} presence_phase_t;
+
+typedef struct {
+    uint8_t  phase;             // presence_phase_t
+    uint8_t  zone;
+    int16_t  y_mm;              // closest valid track, -1 = none
+    uint32_t deadline_ms;       // fade-out time in PRESENCE_HOLD
+    uint32_t actions;
+} presence_status_t;
+
+void presence_rules_default(presence_rules_t *r);
+bool presence_rules_valid(const presence_rules_t *r);
+
+/**
+ * Zone of a radar frame from another layer (occupancy.c polygons) instead
+ * of the y bands of the rules: called after the frame's tracks are in,
+ * returns the zone and its brightness, 0xFF when nobody is in a zone that
+ * drives the lights. NULL goes back to the y bands.
+ */
+typedef uint8_t (*presence_zone_fn)(uint16_t *brightness);
+void presence_zone_source(presence_zone_fn fn);
+
+void presence_engine_init(const presence_rules_t *r, presence_action_fn out);
+void presence_on_radar(const rd03d_state_t *st);
+void presence_on_vl53(uint16_t nearest_mm, uint32_t t_ms);
+void presence_tick(uint32_t now_ms);
+presence_status_t presence_get_status(void);
+
+/* target glue (presence.c, not in PRESENCE_HOST builds) */
+void presence_init(void);
+void presence_poll(void);
+presence_rules_t *presence_rules(void);
+void presence_rules_apply(void);
+bool presence_rules_save(void);
@@ -7,6 +7,11 @@
 #include <stdio.h>
 #include "pwm_api.h"
 #include "pwm_drv.h"
+#include "pwm_fade.h"
+#include "pwm_fixture.h"
+#include "pwm_gamma.h"
+#include "pwm_timeline.h"
+#include "dlog.h"
 #include "config.h"
 
 #include "pico/time.h"     // absolute_time_t, get_absolute_time, absolute_time_diff_us
@@ -20,18 +25,26 @@
 
 /* ---------- Internal state (static, zero allocations) ---------- */
 // mnimal value for each color is 9, what is maximum value?
-static rgbw16_t s_current;      // what is currently being output (logical, before brightness)
-static rgbw16_t s_target;       // target value (logical, before brightness)
+// one entry per fixture (pwm_fixture.c), s_fx_count used
+static uint8_t s_fx_count;
+static rgbw16_t s_current[PWM_FIXTURE_MAX];     // what is currently being output (logical, before brightness)
+static rgbw16_t s_target[PWM_FIXTURE_MAX];      // target value (logical, before brightness)
 
 // static uint16_t s_brightness = PWM_WRAP;
 static uint16_t g_brightness; // global brightness for all channels
 
 /* Fade state */
 static bool s_fade_active = false;
-static rgbw16_t s_fade_start;
-static rgbw16_t s_fade_end;
+static rgbw16_t s_fade_start[PWM_FIXTURE_MAX];
+static rgbw16_t s_fade_end[PWM_FIXTURE_MAX];
 static absolute_time_t s_fade_t0;
 static uint32_t s_fade_dur_ms = 0;
+static bool s_fade_dma = false;     // DMA fade engine available
+static bool s_fade_hw = false;      // current fade is played by DMA
+static uint32_t s_pwm_freq = PWM_FREQ;
+
+/* Timeline state, see pwm_timeline.h */
+static pwm_timeline_t s_tl;
 
 /* DDP config */
 static pwm_rgbw_ddp_cfg_t s_ddp_cfg = {
@@ -49,29 +62,43 @@ static pwm_rgbw_ddp_cfg_t s_ddp_cfg = {
 //     return (uint16_t)v;
 // }
 
-static inline uint16_t scale8_to_wrap(uint8_t v) {
-    /* exact-ish integer scaling to [0..PWM_WRAP] */
-    return (uint16_t)((((uint32_t)v) * PWM_WRAP + 127u) / 255u);
-}
-
-static inline uint16_t scale16_to_wrap(uint16_t v16) {
-    /* map 0..65535 -> 0..PWM_WRAP */
-    return (uint16_t)((((uint32_t)v16) * PWM_WRAP + 32767u) / 65535u);
-}
-
     /* brightness in range 0..LINEAR_MAX */
     // extern uint16_t g_brightness;
 static inline uint16_t apply_brightness(uint16_t linear)
 {
-    return (uint16_t)(((uint32_t)linear * (g_brightness+1)) >> LINEAR_BITS);
+    return apply_brightness_level(linear, g_brightness);
 }
 
+/**
+ * All fixtures (one colour each) to the outputs, one register write per
+ * changed slice
+ */
 static void apply_to_hw(const rgbw16_t* logical)
 {
-    pwm_drv_ch_set(PWM_CH_R, apply_brightness(logical->r));
-    pwm_drv_ch_set(PWM_CH_G, apply_brightness(logical->g));
-    pwm_drv_ch_set(PWM_CH_B, apply_brightness(logical->b));
-    pwm_drv_ch_set(PWM_CH_W, apply_brightness(logical->w));
+    if (s_fade_dma && pwm_fade_hold(logical, g_brightness))
+        return;     // dithered, DMA keeps writing the compare registers
+
+    for (uint8_t fx = 0; fx < s_fx_count; fx++) {
+        rgbw16_t linear = {
+            .r = apply_brightness(logical[fx].r),
+            .g = apply_brightness(logical[fx].g),
+            .b = apply_brightness(logical[fx].b),
+            .w = apply_brightness(logical[fx].w),
+        };
+        pwm_fixture_stage(fx, &linear);
+    }
+    pwm_drv_commit();
+}
+
+static void fill_all(rgbw16_t* dst, rgbw16_t color)
+{
+    for (uint8_t fx = 0; fx < s_fx_count; fx++)
+        dst[fx] = color;
+}
+
+static void copy_all(rgbw16_t* dst, const rgbw16_t* src)
+{
+    memcpy(dst, src, s_fx_count * sizeof(rgbw16_t));
 }
 
 static rgbw16_t lerp_rgbw(rgbw16_t a, rgbw16_t b, uint32_t t_ms, uint32_t dur_ms)
@@ -98,36 +125,61 @@ static rgbw16_t lerp_rgbw(rgbw16_t a, rgbw16_t b, uint32_t t_ms, uint32_t dur_ms
 /* ---------- Public API ---------- */
 bool pwm_mod_init(void)
 {
-    s_current = (rgbw16_t){0};
-    s_target  = (rgbw16_t){0};
+    memset(s_current, 0, sizeof(s_current));
+    memset(s_target, 0, sizeof(s_target));
     // s_brightness = PWM_WRAP;
     g_brightness = LINEAR_MAX;
     s_fade_active = false;
+    pwm_ease_init();
+    pwm_tl_init(&s_tl);
 
     if (!pwm_drv_init(PWM_FREQ, PWM_WRAP)) {
         return false;
     }
+    s_fx_count = pwm_fixture_count();
+    s_pwm_freq = PWM_FREQ;
+    s_fade_dma = pwm_fade_init();
 
-    apply_to_hw(&s_current);
+    apply_to_hw(s_current);
     return true;
 }
 
 
+static uint32_t now_ms(void)
+{
+    return to_ms_since_boot(get_absolute_time());
+}
+
 void pwm_rgbw_set(rgbw16_t color)
 {
-    s_target = color;
+    pwm_rgbw_tl_clear();
+    fill_all(s_target, color);
     if (!s_fade_active) {
-        s_current = s_target;
-        printf("Set s_current RGBW to: %u %u %u %u\n",
-               s_current.r, s_current.g, s_current.b, s_current.w);
+        copy_all(s_current, s_target);
+        DLOG_EVERY(200, "Set s_current RGBW to: %u %u %u %u\n",
+                   color.r, color.g, color.b, color.w);
 
     } else {
-        printf("Set s_target RGBW to: %u %u %u %u\n",
-               s_target.r, s_target.g, s_target.b, s_target.w);
+        DLOG_EVERY(200, "Set s_target RGBW to: %u %u %u %u\n",
+                   color.r, color.g, color.b, color.w);
 
     }
 }
 
+/**
+ * One fixture only; false for an unknown fixture
+ */
+bool pwm_rgbw_set_fixture(uint8_t fx, rgbw16_t color)
+{
+    if (fx >= s_fx_count)
+        return false;
+    pwm_rgbw_tl_clear();
+    s_target[fx] = color;
+    if (!s_fade_active)
+        s_current[fx] = color;
+    return true;
+}
+
 
 void pwm_led_set(uint16_t w)
 {
@@ -137,13 +189,14 @@ void pwm_led_set(uint16_t w)
         .b = 0,
         .w = w,
     };
-    s_target = color;
+    pwm_rgbw_tl_clear();
+    fill_all(s_target, color);
     if (!s_fade_active) {
-        s_current = s_target;
-        printf("Set s_current W to: %u\n", s_current.w);
+        copy_all(s_current, s_target);
+        DLOG_EVERY(200, "Set s_current W to: %u\n", w);
 
     } else {
-        printf("Set s_target W to: %u\n", s_target.w);
+        DLOG_EVERY(200, "Set s_target W to: %u\n", w);
 
     }
 }
@@ -167,65 +220,145 @@ void pwm_led_set(uint16_t w)
 void pwm_rgbw_set_brightness(uint16_t brightness)
 {
     g_brightness = (brightness > LINEAR_MAX) ? LINEAR_MAX : brightness;
+    if (s_fade_hw)
+        pwm_fade_set_brightness(g_brightness);
 }
 
-void pwm_rgbw_fade_to(rgbw16_t color, uint32_t duration_ms)
+/**
+ * Fade every fixture from its current colour to s_fade_end
+ */
+static void fade_start(uint32_t duration_ms)
 {
+    pwm_rgbw_tl_clear();
+
     /* Start fade from current output state (logical) */
-    s_fade_start = s_current;
-    s_fade_end = color;
+    copy_all(s_fade_start, s_current);
     s_fade_dur_ms = duration_ms;
     s_fade_t0 = get_absolute_time();
     s_fade_active = (duration_ms != 0);
+    s_fade_hw = s_fade_active && s_fade_dma &&
+                pwm_fade_start(s_fade_start, s_fade_end, duration_ms, s_pwm_freq, g_brightness);
 
-    s_target = color;
-
-    printf("Set fade to s_target RGBW to: %u %u %u %u\n",
-               s_target.r, s_target.g, s_target.b, s_target.w);
-
+    copy_all(s_target, s_fade_end);
     if (!s_fade_active) {
-        s_current = s_target;
+        copy_all(s_current, s_target);
     }
 }
 
+void pwm_rgbw_fade_to(rgbw16_t color, uint32_t duration_ms)
+{
+    fill_all(s_fade_end, color);
+    fade_start(duration_ms);
+
+    DLOG("Set fade to s_target RGBW to: %u %u %u %u\n",
+         color.r, color.g, color.b, color.w);
+}
+
 void pwm_rgbw_fade_stop(bool snap_to_target)
 {
+    if (s_fade_hw) {
+        pwm_fade_stop();
+        s_fade_hw = false;
+    }
     s_fade_active = false;
     if (snap_to_target) {
-        s_current = s_target;
+        copy_all(s_current, s_target);
     }
 }
 
 bool pwm_rgbw_is_fading(void)
 {
-    return s_fade_active;
+    return s_fade_active || s_tl.active;
+}
+
+/**
+ * Queue a timeline segment; an idle timeline starts from the current colour.
+ * Returns false when the queue is full.
+ */
+bool pwm_rgbw_tl_add(rgbw16_t color, uint32_t duration_ms, uint8_t ease)
+{
+    if (!pwm_tl_push(&s_tl, color, duration_ms, (pwm_ease_t)ease))
+        return false;
+    if (!s_tl.active) {
+        pwm_rgbw_fade_stop(false);      // s_current holds the colour reached so far
+        pwm_tl_start(&s_tl, s_current[0], now_ms());
+    }
+    return true;
+}
+
+bool pwm_rgbw_tl_hold(uint32_t duration_ms)
+{
+    return pwm_rgbw_tl_add(s_current[0], duration_ms, PWM_EASE_HOLD);
+}
+
+void pwm_rgbw_tl_loop(bool loop)
+{
+    s_tl.loop = loop;
+}
+
+/**
+ * Drop all segments; the output stays where the timeline was
+ */
+void pwm_rgbw_tl_clear(void)
+{
+    bool loop = s_tl.loop;
+
+    if (s_tl.active)
+        copy_all(s_target, s_current);
+    pwm_tl_init(&s_tl);
+    s_tl.loop = loop;
 }
 
 void pwm_api_poll(void)
 {
-    static rgbw16_t last_target = {0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF};
+    static rgbw16_t last_target[PWM_FIXTURE_MAX];
+    static bool last_valid;
 
-    if (s_fade_active) {
+    if (s_tl.active) {
+        /* the timeline drives all fixtures with one colour */
+        rgbw16_t c;
+        bool running = pwm_tl_eval(&s_tl, now_ms(), &c);
+
+        fill_all(s_current, c);
+        fill_all(s_target, running ? pwm_tl_target(&s_tl) : c);
+    } else if (s_fade_active) {
         // calculate time from t0
         int64_t us = absolute_time_diff_us(s_fade_t0, get_absolute_time());
         uint32_t t_ms = (us <= 0) ? 0u : (uint32_t)(us / 1000);
 
-        s_current = lerp_rgbw(s_fade_start, s_fade_end, t_ms, s_fade_dur_ms);
+        for (uint8_t fx = 0; fx < s_fx_count; fx++)
+            s_current[fx] = lerp_rgbw(s_fade_start[fx], s_fade_end[fx], t_ms, s_fade_dur_ms);
+
+        if (s_fade_hw) {
+            /* DMA owns the compare registers until the table is played out */
+            if (pwm_fade_busy())
+                return;
+            copy_all(s_current, s_fade_end);
+            s_fade_active = false;
+            s_fade_hw = false;
+#if PWM_DITHER_BITS
+            apply_to_hw(s_current);     // continue with the dither pattern
+#endif
+            copy_all(last_target, s_current);   // already on the outputs
+            last_valid = true;
+            return;
+        }
 
         if (t_ms >= s_fade_dur_ms) {
-            s_current = s_fade_end;
+            copy_all(s_current, s_fade_end);
             s_fade_active = false;
         }
     } else {
         /* If target changed via pwm_rgbw_set while not fading, keep in sync */
-        s_current = s_target;
+        copy_all(s_current, s_target);
     }
 
-    if (memcmp(&s_current, &last_target, sizeof(rgbw16_t)) != 0) {
-        last_target = s_current;
-        printf("PWM target RGBW changed to: %u %u %u %u\n",
-               s_current.r, s_current.g, s_current.b, s_current.w);
-        apply_to_hw(&s_current);
+    if (!last_valid || memcmp(s_current, last_target, s_fx_count * sizeof(rgbw16_t)) != 0) {
+        copy_all(last_target, s_current);
+        last_valid = true;
+        DLOG_EVERY(200, "PWM target RGBW changed to: %u %u %u %u\n",
+                   s_current[0].r, s_current[0].g, s_current[0].b, s_current[0].w);
+        apply_to_hw(s_current);
     }
 }
 
@@ -235,11 +368,14 @@ void pwm_api_poll(void)
 pwm_rgbw_status_t pwm_rgbw_get_status(void)
 {
     pwm_rgbw_status_t st = {
-        .current = s_current,
-        .target = s_target,
+        .current = s_current[0],
+        .target = s_target[0],
         .brightness = g_brightness,
         .fading = s_fade_active,
-        .fade_remaining_ms = 0
+        .fade_remaining_ms = 0,
+        .tl_segments = s_tl.active ? s_tl.count : 0,
+        .tl_loop = s_tl.loop,
+        .fixtures = s_fx_count
     };
 
     if (s_fade_active) {
@@ -250,6 +386,20 @@ pwm_rgbw_status_t pwm_rgbw_get_status(void)
     return st;
 }
 
+/**
+ * Logical colour of one fixture; false for an unknown fixture
+ */
+bool pwm_rgbw_get_fixture(uint8_t fx, rgbw16_t* current, rgbw16_t* target)
+{
+    if (fx >= s_fx_count)
+        return false;
+    if (current)
+        *current = s_current[fx];
+    if (target)
+        *target = s_target[fx];
+    return true;
+}
+
 /**
  * Used only for debugging, check different PWM frequencies from telnet.
  */
@@ -257,11 +407,14 @@ bool pwm_rgbw_reconfigure(uint32_t pwm_freq_hz)
 {
     /* stop PWM, re-init slices, restart.
        This is safe if you do it when you are not outputting critical patterns. */
+    pwm_rgbw_fade_stop(true);
     pwm_drv_enable(false);
 
     /* NOTE: pwm_wrap must match your internal scaling assumptions.
        If you change it, update PWM_WRAP constants or store wrap in state. */
     bool ok = pwm_drv_init(pwm_freq_hz, PWM_WRAP);
+    if (ok)
+        s_pwm_freq = pwm_freq_hz;
     pwm_drv_enable(true);
 
     return ok;
@@ -274,59 +427,70 @@ void pwm_rgbw_ddp_config(const pwm_rgbw_ddp_cfg_t* cfg)
     s_ddp_cfg = *cfg;  // POD copy, no allocations
 }
 
-static bool ddp_extract_rgbw(const uint8_t* payload, uint16_t payload_len, rgbw16_t* out)
+pwm_rgbw_ddp_cfg_t pwm_rgbw_ddp_get_config(void)
 {
-    if (!payload || !out) return false;
-    if (s_ddp_cfg.channel_offset >= payload_len) return false;
-
-    const uint16_t off = s_ddp_cfg.channel_offset;
-
-    switch (s_ddp_cfg.fmt) {
-        case DDP_FMT_RGBW8: {
-            if ((uint32_t)off + 4u > payload_len) return false;
-            out->r = scale8_to_wrap(payload[off + 0]);
-            out->g = scale8_to_wrap(payload[off + 1]);
-            out->b = scale8_to_wrap(payload[off + 2]);
-            out->w = scale8_to_wrap(payload[off + 3]);
-            return true;
-        }
-        case DDP_FMT_RGB8W0: {
-            if ((uint32_t)off + 3u > payload_len) return false;
-            out->r = scale8_to_wrap(payload[off + 0]);
-            out->g = scale8_to_wrap(payload[off + 1]);
-            out->b = scale8_to_wrap(payload[off + 2]);
-            out->w = 0;
-            return true;
-        }
-        case DDP_FMT_RGBW16LE: {
-            if ((uint32_t)off + 8u > payload_len) return false;
-            uint16_t r16 = (uint16_t)payload[off + 0] | ((uint16_t)payload[off + 1] << 8);
-            uint16_t g16 = (uint16_t)payload[off + 2] | ((uint16_t)payload[off + 3] << 8);
-            uint16_t b16 = (uint16_t)payload[off + 4] | ((uint16_t)payload[off + 5] << 8);
-            uint16_t w16 = (uint16_t)payload[off + 6] | ((uint16_t)payload[off + 7] << 8);
-            out->r = scale16_to_wrap(r16);
-            out->g = scale16_to_wrap(g16);
-            out->b = scale16_to_wrap(b16);
-            out->w = scale16_to_wrap(w16);
-            return true;
-        }
-        default:
+    return s_ddp_cfg;
+}
+
+static inline uint16_t rd_u16le(const uint8_t* p)
+{
+    return (uint16_t)((uint16_t)p[0] | ((uint16_t)p[1] << 8));
+}
+
+/**
+ * DDP_FMT_TIMELINE: the frame replaces the queued timeline
+ */
+static bool ddp_ingest_timeline(const uint8_t* payload, uint16_t payload_len)
+{
+    uint32_t off = s_ddp_cfg.channel_offset;
+    uint32_t n = (off < payload_len) ? (payload_len - off) / DDP_TL_REC_LEN : 0;
+
+    if (!n)
+        return false;
+    if (n > PWM_TL_MAX_SEGS)
+        n = PWM_TL_MAX_SEGS;
+
+    pwm_rgbw_tl_clear();
+    pwm_rgbw_tl_loop((payload[off + 11] & DDP_TL_FLAG_LOOP) != 0);
+    for (uint32_t i = 0; i < n; i++, off += DDP_TL_REC_LEN) {
+        const uint8_t* rec = &payload[off];
+        rgbw16_t c = {
+            .r = scale16_to_wrap(rd_u16le(&rec[0])),
+            .g = scale16_to_wrap(rd_u16le(&rec[2])),
+            .b = scale16_to_wrap(rd_u16le(&rec[4])),
+            .w = scale16_to_wrap(rd_u16le(&rec[6])),
+        };
+        if (!pwm_rgbw_tl_add(c, rd_u16le(&rec[8]), rec[10]))
             return false;
     }
+    return true;
 }
 
+/**
+ * One frame updates every fixture (its pixel at channel_offset +
+ * ddp_pixel * pixel size); the outputs follow on the next poll with a
+ * single commit. Fixtures outside the payload keep their colour.
+ */
 bool pwm_rgbw_ddp_ingest(const uint8_t* payload, uint16_t payload_len)
 {
-    rgbw16_t c;
-    if (!ddp_extract_rgbw(payload, payload_len, &c)) {
+    rgbw16_t c[PWM_FIXTURE_MAX];
+
+    if (s_ddp_cfg.fmt == DDP_FMT_TIMELINE) {
+        return ddp_ingest_timeline(payload, payload_len);
+    }
+    copy_all(c, s_target);
+    if (!pwm_fixture_ddp_frame(payload, payload_len, s_ddp_cfg.fmt, s_ddp_cfg.channel_offset, c)) {
         return false;
     }
 
     if (s_ddp_cfg.use_fade && s_ddp_cfg.frame_fade_ms > 0) {
-        pwm_rgbw_fade_to(c, s_ddp_cfg.frame_fade_ms);
+        copy_all(s_fade_end, c);
+        fade_start(s_ddp_cfg.frame_fade_ms);
     } else {
-        pwm_rgbw_set(c);
+        pwm_rgbw_tl_clear();
         pwm_rgbw_fade_stop(false);
+        copy_all(s_target, c);
+        copy_all(s_current, c);
     }
     return true;
 }
@@ -19,35 +19,60 @@ typedef struct {
 bool pwm_mod_init(void);
 void pwm_api_poll(void);
 
-/* Immediate set (updates target; if fade inactive, applies on next poll) */
+/* Immediate set (updates target; if fade inactive, applies on next poll)
+ * The colour APIs drive all fixtures of PWM_FIXTURES (config.h) alike;
+ * pwm_rgbw_set_fixture() and DDP frames set them one by one.
+ */
 void pwm_rgbw_set(rgbw16_t color);
+bool pwm_rgbw_set_fixture(uint8_t fx, rgbw16_t color);
 void pwm_rgbw_set_brightness(uint16_t brightness);
 void pwm_rgbw_set8(uint8_t r, uint8_t g, uint8_t b, uint8_t w);
 
 /* -------- Fade engine (zero allocations) --------
- * Fade is computed in pwm_rgbw_poll() from absolute_time_t; no IRQ required.
+ * Fade is played by DMA into the PWM compare registers (pwm_fade.c), one
+ * value per PWM period. pwm_api_poll() only tracks progress; it computes
+ * the fade itself from absolute_time_t when no DMA channels are free.
+ * With PWM_DITHER_BITS (config.h) levels are sigma-delta dithered, also
+ * when steady; DMA then owns the compare registers all the time.
  */
 void pwm_rgbw_fade_to(rgbw16_t color, uint32_t duration_ms);
 void pwm_rgbw_fade_stop(bool snap_to_target);   // stop fade; optionally snap immediately
 bool pwm_rgbw_is_fading(void);
 
+/* -------- Fade timeline (pwm_timeline.c) --------
+ * Queued segments with easing curves, evaluated on pwm_api_poll().
+ * The first queued segment starts from the current colour. pwm_rgbw_set(),
+ * pwm_rgbw_fade_to() and pwm_led_set() cancel the timeline.
+ * ease: pwm_ease_t (PWM_EASE_LINEAR .. PWM_EASE_HOLD)
+ */
+bool pwm_rgbw_tl_add(rgbw16_t color, uint32_t duration_ms, uint8_t ease);
+bool pwm_rgbw_tl_hold(uint32_t duration_ms);
+void pwm_rgbw_tl_loop(bool loop);
+void pwm_rgbw_tl_clear(void);
+
 /* -------- DDP frame mapping --------
  * You call this from your ddp_loop() when a frame arrives.
+ * Fixture n reads its pixel at channel_offset + ddp_pixel * pixel size.
  */
 typedef enum {
     DDP_FMT_RGBW8 = 0,   // 4 bytes: R,G,B,W (8-bit)
     DDP_FMT_RGB8W0,      // 3 bytes: R,G,B (W forced 0)
     DDP_FMT_RGBW16LE,    // 8 bytes: Rlo,Rhi,Glo,Ghi,Blo,Bhi,Wlo,Whi (16-bit LE)
+    DDP_FMT_TIMELINE,    // 12 bytes per segment: RGBW 16-bit LE, ms 16-bit LE, ease, flags
 } ddp_rgbw_format_t;
 
+#define DDP_TL_REC_LEN      12
+#define DDP_TL_FLAG_LOOP    0x01    // flags of the first record
+
 typedef struct {
     ddp_rgbw_format_t fmt;
-    uint16_t channel_offset;  // 0-based offset within payload where R starts
+    uint16_t channel_offset;  // 0-based offset within payload where pixel 0 starts
     bool     use_fade;        // if true: apply fade on each frame (duration_ms)
     uint32_t frame_fade_ms;   // used when use_fade=true
 } pwm_rgbw_ddp_cfg_t;
 
 void pwm_rgbw_ddp_config(const pwm_rgbw_ddp_cfg_t* cfg);
+pwm_rgbw_ddp_cfg_t pwm_rgbw_ddp_get_config(void);
 bool pwm_rgbw_ddp_ingest(const uint8_t* payload, uint16_t payload_len);
 
 /* -------- CLI integration (commands) --------
@@ -63,9 +88,13 @@ typedef struct {
     uint16_t brightness;
     bool fading;
     uint32_t fade_remaining_ms;
+    uint8_t tl_segments;        // queued timeline segments, 0 = idle
+    bool tl_loop;
+    uint8_t fixtures;           // current / target are of fixture 0
 } pwm_rgbw_status_t;
 
 pwm_rgbw_status_t pwm_rgbw_get_status(void);
+bool pwm_rgbw_get_fixture(uint8_t fx, rgbw16_t* current, rgbw16_t* target);
 bool pwm_rgbw_reconfigure(uint32_t pwm_freq_hz);
 
 void pwm_led_set(uint16_t w);
@@ -21,14 +21,12 @@ typedef enum {
     PWM_CH_COUNT
 } pwm_drv_channel_t;
 
-typedef struct {
-    uint gpio;
-    uint slice;
-    uint channel;
-    bool active_low;
-} pwm_drv_hw_t;
-
+/**
+ * Outputs come from the fixture table (pwm_fixture.c); levels are staged
+ * with pwm_fixture_stage() and written by pwm_drv_commit(), one CC write
+ * per changed slice.
+ */
 bool pwm_drv_init(uint32_t pwm_freq_hz, uint16_t pwm_wrap);
 
-void pwm_drv_ch_set(pwm_drv_channel_t ch, uint16_t linear_level);
+void pwm_drv_commit(void);
 void pwm_drv_enable(bool enable);
@@ -0,0 +1,346 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "config.h"
+#include "pwm_fade.h"
+#include "pwm_fixture.h"
+#include "pwm_gamma.h"
+
+/**
+ * Number of PWM periods of a fade; 0 means "too short, set directly"
+ */
+uint32_t pwm_fade_periods(uint32_t duration_ms, uint32_t pwm_freq_hz)
+{
+    return (uint32_t)(((uint64_t)duration_ms * pwm_freq_hz) / 1000u);
+}
+
+void pwm_ramp_init(pwm_ramp_t *r, uint16_t from, uint16_t to, uint32_t periods)
+{
+    uint32_t mag = (to >= from) ? (uint32_t)(to - from) : (uint32_t)(from - to);
+
+    if (!periods)
+        periods = 1;
+    r->from = from;
+    r->dir = (to >= from) ? 1 : -1;
+    r->periods = periods;
+    r->step_q = mag / periods;
+    r->step_r = mag % periods;
+    r->q = 0;
+    r->acc = 0;
+    r->k = 0;
+}
+
+static inline uint16_t pwm_ramp_next(pwm_ramp_t *r)
+{
+    uint16_t v = (uint16_t)((r->dir < 0) ? (r->from - r->q) : (r->from + r->q));
+
+    r->k++;
+    r->q += r->step_q;
+    r->acc += r->step_r;
+    if (r->acc >= r->periods) {
+        r->acc -= r->periods;
+        r->q++;
+    }
+    return v;
+}
+
+static inline uint32_t cc_half(uint16_t pwm, bool active_low, uint32_t h)
+{
+    uint16_t out = active_low ? (uint16_t)(PWM_WRAP - pwm) : pwm;
+    return (uint32_t)out << (16u * h);
+}
+
+/**
+ * Write up to 'max' CC words (samples k .. k+n-1, the last one is k = periods).
+ * Returns the number written, 0 when the fade is complete.
+ */
+uint32_t pwm_fade_fill(pwm_fade_slice_t *s, uint16_t brightness, uint32_t *cc, uint32_t max)
+{
+    uint32_t n = 0;
+
+    while (n < max && s->ramp[0].k <= s->ramp[0].periods) {
+        uint32_t word = 0;
+
+        for (uint32_t h = 0; h < 2; h++) {
+            uint16_t level = apply_brightness_level(pwm_ramp_next(&s->ramp[h]), brightness);
+#if PWM_DITHER_BITS
+            uint16_t pwm = pwm_sd_next(&s->sd_acc[h], gamma_to_duty(s->gamma[h], level), PWM_DITHER_BITS);
+#else
+            uint16_t pwm = gamma_to_pwm(s->gamma[h], level);
+#endif
+            word |= cc_half(pwm, s->active_low[h], h);
+        }
+        cc[n++] = word;
+    }
+    return n;
+}
+
+/**
+ * One full sigma-delta cycle (2^bits CC words) of a steady level; played
+ * in a DMA ring it repeats without CPU.
+ */
+void pwm_dither_pattern(const pwm_fade_slice_t *s, const uint16_t level16[2], uint16_t brightness,
+                        uint32_t bits, uint32_t *cc)
+{
+    uint16_t acc[2] = { 0, 0 };
+    uint32_t duty[2];
+
+    for (uint32_t h = 0; h < 2; h++)
+        duty[h] = gamma_to_duty(s->gamma[h], apply_brightness_level(level16[h], brightness));
+    for (uint32_t k = 0; k < (1u << bits); k++) {
+        uint32_t word = 0;
+
+        for (uint32_t h = 0; h < 2; h++)
+            word |= cc_half(pwm_sd_next(&acc[h], duty[h], bits), s->active_low[h], h);
+        cc[k] = word;
+    }
+}
+
+#ifndef PWM_FADE_HOST
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pwm.h"
+
+typedef struct {
+    uint slice;
+    uint dma[2];                    // ping-pong channels
+    uint32_t buf[2][PWM_FADE_CHUNK];
+    pwm_fade_slice_t gen;
+} fade_hw_t;
+
+static fade_hw_t fade[PWM_SLICE_MAX];
+static uint8_t fade_slices;
+static volatile uint16_t fade_brightness;
+static volatile uint32_t fade_pending;      // armed buffers not yet played out
+
+#if PWM_DITHER_BITS
+#define DITHER_PERIOD   (1u << PWM_DITHER_BITS)
+// DMA read ring, aligned to its size
+static uint32_t hold_buf[PWM_SLICE_MAX][DITHER_PERIOD] __attribute__((aligned(DITHER_PERIOD * sizeof(uint32_t))));
+static bool fade_holding;
+#endif
+
+/**
+ * Level of half h of a slice, from one colour per fixture
+ */
+static uint16_t rgbw_channel(const rgbw16_t *c, const pwm_fade_slice_t *s, uint32_t h)
+{
+    uint16_t v;
+
+    if (s->fx[h] < 0)
+        return 0;
+    c += s->fx[h];
+    switch (s->ch[h]) {
+        case PWM_CH_R: v = c->r; break;
+        case PWM_CH_G: v = c->g; break;
+        case PWM_CH_B: v = c->b; break;
+        case PWM_CH_W: v = c->w; break;
+        default:       v = 0;    break;
+    }
+#if PWM_DITHER_BITS
+    return linear_to_level16(v);    // ramps and patterns run on 16-bit levels
+#else
+    return v;
+#endif
+}
+
+/**
+ * Fill buffer j and program its channel without triggering; the other
+ * buffer's channel chains to it. The last chunk chains to itself (= stop).
+ */
+static void fade_arm(fade_hw_t *f, uint32_t j)
+{
+    uint32_t n = pwm_fade_fill(&f->gen, fade_brightness, f->buf[j], PWM_FADE_CHUNK);
+    if (!n)
+        return;
+
+    bool last = f->gen.ramp[0].k > f->gen.ramp[0].periods;
+    dma_channel_config c = dma_channel_get_default_config(f->dma[j]);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pwm_get_dreq(f->slice));
+    channel_config_set_chain_to(&c, last ? f->dma[j] : f->dma[j ^ 1u]);
+    dma_channel_configure(f->dma[j], &c, &pwm_hw->slice[f->slice].cc, f->buf[j], n, false);
+    fade_pending++;
+}
+
+static void fade_dma_irq(void)
+{
+    for (uint8_t i = 0; i < fade_slices; i++) {
+        fade_hw_t *f = &fade[i];
+
+        for (uint32_t j = 0; j < 2; j++) {
+            if (!dma_channel_get_irq1_status(f->dma[j]))
+                continue;
+            dma_channel_acknowledge_irq1(f->dma[j]);
+            fade_pending--;
+            fade_arm(f, j);
+        }
+    }
+}
+
+static void fade_release(void)
+{
+    for (uint8_t i = 0; i < fade_slices; i++) {
+        dma_channel_unclaim(fade[i].dma[0]);
+        dma_channel_unclaim(fade[i].dma[1]);
+    }
+    fade_slices = 0;
+}
+
+/**
+ * Claim two DMA channels per used slice; false leaves fades to pwm_api_poll()
+ */
+bool pwm_fade_init(void)
+{
+    fade_release();
+    for (uint8_t i = 0; i < pwm_fixture_slice_count(); i++) {
+        const pwm_fixture_slice_t *s = pwm_fixture_slice(i);
+        int d0 = dma_claim_unused_channel(false);
+        int d1 = dma_claim_unused_channel(false);
+
+        if (d0 < 0 || d1 < 0) {
+            if (d0 >= 0)
+                dma_channel_unclaim((uint)d0);
+            if (d1 >= 0)
+                dma_channel_unclaim((uint)d1);
+            fade_release();     // all slices or none, fades stay in step
+            return false;
+        }
+
+        fade_hw_t *f = &fade[fade_slices++];
+        memset(&f->gen, 0, sizeof(f->gen));
+        f->slice = s->slice;
+        f->dma[0] = (uint)d0;
+        f->dma[1] = (uint)d1;
+        for (uint32_t h = 0; h < 2; h++) {
+            f->gen.fx[h] = s->fx[h];
+            f->gen.ch[h] = s->ch[h];
+            f->gen.active_low[h] = s->active_low[h];
+            f->gen.gamma[h] = s->gamma[h] ? s->gamma[h] : gamma_get_default();
+        }
+    }
+
+    irq_add_shared_handler(DMA_IRQ_1, fade_dma_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    for (uint8_t i = 0; i < fade_slices; i++) {
+        dma_channel_set_irq1_enabled(fade[i].dma[0], true);
+        dma_channel_set_irq1_enabled(fade[i].dma[1], true);
+    }
+    irq_set_enabled(DMA_IRQ_1, true);
+    return fade_slices != 0;
+}
+
+/**
+ * Start a fade on all fixtures; the compare registers follow the table from
+ * the next PWM wrap. Returns false when the fade is shorter than one period.
+ */
+bool pwm_fade_start(const rgbw16_t *from, const rgbw16_t *to, uint32_t duration_ms,
+                    uint32_t pwm_freq_hz, uint16_t brightness)
+{
+    uint32_t periods = pwm_fade_periods(duration_ms, pwm_freq_hz);
+    uint32_t mask = 0;
+
+    pwm_fade_stop();
+    if (!fade_slices || !periods)
+        return false;
+
+    fade_brightness = brightness;
+    for (uint8_t i = 0; i < fade_slices; i++) {
+        fade_hw_t *f = &fade[i];
+
+        for (uint32_t h = 0; h < 2; h++) {
+            pwm_ramp_init(&f->gen.ramp[h], rgbw_channel(from, &f->gen, h),
+                          rgbw_channel(to, &f->gen, h), periods);
+            f->gen.sd_acc[h] = 0;
+        }
+        fade_arm(f, 0);
+        fade_arm(f, 1);
+        mask |= 1u << f->dma[0];
+    }
+    dma_start_channel_mask(mask);   // all slices start on the same cycle
+    return true;
+}
+
+/**
+ * Applies from the next refilled chunk
+ */
+void pwm_fade_set_brightness(uint16_t brightness)
+{
+    fade_brightness = brightness;
+}
+
+/**
+ * Dither a steady level: each slice plays its pattern from a DMA read ring
+ * with an endless transfer count. While holding, a new level only rewrites
+ * the ring. Returns false when dithering is off (PWM_DITHER_BITS 0) or no
+ * DMA channels were claimed; the caller then writes the CC directly.
+ */
+bool pwm_fade_hold(const rgbw16_t *level, uint16_t brightness)
+{
+#if PWM_DITHER_BITS
+    uint32_t mask = 0;
+
+    if (!fade_slices)
+        return false;
+    for (uint8_t i = 0; i < fade_slices; i++) {
+        const fade_hw_t *f = &fade[i];
+        uint16_t level16[2] = { rgbw_channel(level, &f->gen, 0), rgbw_channel(level, &f->gen, 1) };
+
+        pwm_dither_pattern(&f->gen, level16, brightness, PWM_DITHER_BITS, hold_buf[i]);
+    }
+    if (fade_holding)
+        return true;
+
+    pwm_fade_stop();
+    for (uint8_t i = 0; i < fade_slices; i++) {
+        const fade_hw_t *f = &fade[i];
+        dma_channel_config c = dma_channel_get_default_config(f->dma[0]);
+
+        channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+        channel_config_set_read_increment(&c, true);
+        channel_config_set_write_increment(&c, false);
+        channel_config_set_ring(&c, false, PWM_DITHER_BITS + 2);    // 2^bits words
+        channel_config_set_dreq(&c, pwm_get_dreq(f->slice));
+        dma_channel_configure(f->dma[0], &c, &pwm_hw->slice[f->slice].cc, hold_buf[i],
+                              dma_encode_endless_transfer_count(), false);
+        mask |= 1u << f->dma[0];
+    }
+    dma_start_channel_mask(mask);
+    fade_holding = true;
+    return true;
+#else
+    (void)level;
+    (void)brightness;
+    return false;
+#endif
+}
+
+void pwm_fade_stop(void)
+{
+    // clear EN first so an abort cannot fire the chained channel
+    for (uint8_t i = 0; i < fade_slices; i++)
+        for (uint32_t j = 0; j < 2; j++)
+            hw_clear_bits(&dma_hw->ch[fade[i].dma[j]].al1_ctrl, DMA_CH0_CTRL_TRIG_EN_BITS);
+    for (uint8_t i = 0; i < fade_slices; i++)
+        for (uint32_t j = 0; j < 2; j++) {
+            dma_channel_abort(fade[i].dma[j]);
+            dma_channel_acknowledge_irq1(fade[i].dma[j]);
+        }
+    fade_pending = 0;
+#if PWM_DITHER_BITS
+    fade_holding = false;
+#endif
+    pwm_fixture_invalidate();   // the registers hold whatever DMA wrote last
+}
+
+bool pwm_fade_busy(void)
+{
+    return fade_pending != 0;
+}
+#endif // PWM_FADE_HOST
@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "pwm_api.h"
+#include "pwm_drv.h"
+#include "pwm_gamma.h"
+
+/**
+ * Hardware-timed fades: the compare value of every PWM period is computed
+ * ahead in chunks and DMA writes it to the slice CC register, paced by the
+ * PWM wrap DREQ. Two buffers per slice are chained ping-pong; the DMA IRQ
+ * refills the finished one, so the CPU only runs once per chunk.
+ */
+#define PWM_FADE_CHUNK      128     // PWM periods per buffer, 64 ms at 2 kHz
+
+/**
+ * Linear ramp from..to over 'periods' PWM periods, stepped once per period
+ * without a division. Sample k equals lerp_rgbw() in pwm_api.c at
+ * t = k / pwm_freq: from + (to - from) * k / periods, truncated toward from.
+ */
+typedef struct {
+    uint16_t from;
+    int8_t   dir;
+    uint32_t periods;
+    uint32_t step_q;        // |to - from| / periods
+    uint32_t step_r;        // |to - from| % periods
+    uint32_t q;             // offset from 'from' at sample k
+    uint32_t acc;
+    uint32_t k;
+} pwm_ramp_t;
+
+/**
+ * Table generator of one PWM slice: CC holds channel A in bits 15:0 and
+ * channel B in bits 31:16.
+ */
+typedef struct {
+    int8_t     fx[2];           // fixture on A / B, -1 = unused
+    int8_t     ch[2];           // pwm_drv channel of the fixture
+    bool       active_low[2];
+    const pwm_gamma_t *gamma[2];
+    pwm_ramp_t ramp[2];         // 16-bit levels when PWM_DITHER_BITS != 0
+    uint16_t   sd_acc[2];       // sigma-delta remainder
+} pwm_fade_slice_t;
+
+/**
+ * First order sigma-delta: compare value of one period for a duty in
+ * 1/2^PWM_DUTY_FRAC_BITS counts, 'bits' of the fraction carried in *acc.
+ * The mean over 2^bits periods is the duty rounded to 'bits'.
+ */
+static inline uint16_t pwm_sd_next(uint16_t *acc, uint32_t duty, uint32_t bits)
+{
+    uint32_t shift = PWM_DUTY_FRAC_BITS - bits;
+    uint32_t v = *acc + ((duty + ((1u << shift) >> 1)) >> shift);
+
+    *acc = (uint16_t)(v & ((1u << bits) - 1u));
+    return (uint16_t)(v >> bits);
+}
+
+uint32_t pwm_fade_periods(uint32_t duration_ms, uint32_t pwm_freq_hz);
+void pwm_ramp_init(pwm_ramp_t *r, uint16_t from, uint16_t to, uint32_t periods);
+uint32_t pwm_fade_fill(pwm_fade_slice_t *s, uint16_t brightness, uint32_t *cc, uint32_t max);
+void pwm_dither_pattern(const pwm_fade_slice_t *s, const uint16_t level16[2], uint16_t brightness,
+                        uint32_t bits, uint32_t *cc);
+
+bool pwm_fade_init(void);
+/* from / to / level: one colour per fixture (pwm_fixture_count()) */
+bool pwm_fade_start(const rgbw16_t *from, const rgbw16_t *to, uint32_t duration_ms,
+                    uint32_t pwm_freq_hz, uint16_t brightness);
+void pwm_fade_set_brightness(uint16_t brightness);
+bool pwm_fade_hold(const rgbw16_t *level, uint16_t brightness);
+void pwm_fade_stop(void);
+bool pwm_fade_busy(void);
@@ -0,0 +1,260 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "pwm_fixture.h"
+
+#ifdef PWM_FADE_HOST
+// as pwm_gpio_to_slice_num() / pwm_gpio_to_channel() on RP2350B
+static inline uint32_t fx_gpio_to_slice(uint32_t gpio)
+{
+    return (gpio < 32u) ? ((gpio >> 1u) & 7u) : 8u + ((gpio >> 1u) & 3u);
+}
+static inline uint32_t fx_gpio_to_channel(uint32_t gpio) { return gpio & 1u; }
+#else
+#include "hardware/pwm.h"
+#define fx_gpio_to_slice(g)     pwm_gpio_to_slice_num(g)
+#define fx_gpio_to_channel(g)   pwm_gpio_to_channel(g)
+#endif
+
+#define SLOT_NONE   0xFF
+
+static const pwm_fixture_t fixture_cfg[] = PWM_FIXTURES;
+
+static const pwm_fixture_t *fixtures;
+static uint8_t fixture_count;
+static uint8_t fixture_slot[PWM_FIXTURE_MAX][PWM_CH_COUNT];    // slice index * 2 + half
+
+static pwm_fixture_slice_t slices[PWM_SLICE_MAX];
+static uint8_t slice_count;
+
+static pwm_gamma_t gammas[PWM_GAMMA_MAX];
+static uint8_t gamma_count;
+
+static uint16_t rgbw_get(const rgbw16_t *c, uint32_t ch)
+{
+    switch (ch) {
+        case PWM_CH_R: return c->r;
+        case PWM_CH_G: return c->g;
+        case PWM_CH_B: return c->b;
+        default:       return c->w;
+    }
+}
+
+static const pwm_gamma_t *gamma_for(uint8_t gamma_x10)
+{
+    const pwm_gamma_t *def = gamma_get_default();
+
+    if (gamma_x10 == 0 || gamma_x10 == def->gamma_x10)
+        return def;
+    for (uint8_t i = 0; i < gamma_count; i++)
+        if (gammas[i].gamma_x10 == gamma_x10)
+            return &gammas[i];
+    if (gamma_count >= PWM_GAMMA_MAX)
+        return NULL;
+    gamma_curve_init(&gammas[gamma_count], gamma_x10);
+    return &gammas[gamma_count++];
+}
+
+static pwm_fixture_slice_t *slice_for(uint32_t slice)
+{
+    for (uint8_t i = 0; i < slice_count; i++)
+        if (slices[i].slice == slice)
+            return &slices[i];
+    if (slice_count >= PWM_SLICE_MAX)
+        return NULL;
+
+    pwm_fixture_slice_t *s = &slices[slice_count++];
+    memset(s, 0, sizeof(*s));
+    s->slice = (uint8_t)slice;
+    s->fx[0] = s->fx[1] = -1;
+    s->ch[0] = s->ch[1] = -1;
+    return s;
+}
+
+/**
+ * Map a fixture table to PWM slices; false when a pin is used twice, the
+ * table is too large or there are too many gamma curves.
+ * All outputs are staged off.
+ */
+bool pwm_fixture_init_table(const pwm_fixture_t *tab, uint8_t count)
+{
+    fixtures = tab;
+    fixture_count = 0;
+    slice_count = 0;
+    gamma_count = 0;
+    memset(fixture_slot, SLOT_NONE, sizeof(fixture_slot));
+    gamma_lut_init();
+
+    if (count > PWM_FIXTURE_MAX)
+        return false;
+
+    for (uint8_t fx = 0; fx < count; fx++) {
+        const pwm_gamma_t *g = gamma_for(tab[fx].gamma_x10);
+        if (!g)
+            return false;
+
+        for (uint32_t ch = 0; ch < PWM_CH_COUNT; ch++) {
+            if (tab[fx].pin[ch] < 0)
+                continue;
+
+            uint32_t gpio = (uint32_t)tab[fx].pin[ch];
+            uint32_t h = fx_gpio_to_channel(gpio);
+            pwm_fixture_slice_t *s = slice_for(fx_gpio_to_slice(gpio));
+
+            if (!s || s->fx[h] >= 0)
+                return false;
+            s->fx[h] = (int8_t)fx;
+            s->ch[h] = (int8_t)ch;
+            s->active_low[h] = tab[fx].active_low[ch];
+            s->gamma[h] = g;
+            fixture_slot[fx][ch] = (uint8_t)((s - slices) * 2 + (int)h);
+        }
+        fixture_count++;
+    }
+
+    // off: level 0, inverted for active low
+    for (uint8_t i = 0; i < slice_count; i++) {
+        pwm_fixture_slice_t *s = &slices[i];
+        s->cc = (s->active_low[0] ? PWM_WRAP : 0u) | ((s->active_low[1] ? (uint32_t)PWM_WRAP : 0u) << 16);
+        s->dirty = true;
+    }
+    return true;
+}
+
+bool pwm_fixture_init(void)
+{
+    return pwm_fixture_init_table(fixture_cfg, count_of(fixture_cfg));
+}
+
+uint8_t pwm_fixture_count(void)
+{
+    return fixture_count;
+}
+
+const pwm_fixture_t *pwm_fixture_get(uint8_t fx)
+{
+    return (fx < fixture_count) ? &fixtures[fx] : NULL;
+}
+
+uint8_t pwm_fixture_slice_count(void)
+{
+    return slice_count;
+}
+
+pwm_fixture_slice_t *pwm_fixture_slice(uint8_t i)
+{
+    return (i < slice_count) ? &slices[i] : NULL;
+}
+
+/**
+ * Stage the levels of one fixture (linear, brightness applied); the slice
+ * registers are written by pwm_drv_commit()
+ */
+void pwm_fixture_stage(uint8_t fx, const rgbw16_t *linear)
+{
+    if (fx >= fixture_count)
+        return;
+
+    for (uint32_t ch = 0; ch < PWM_CH_COUNT; ch++) {
+        uint8_t slot = fixture_slot[fx][ch];
+        if (slot == SLOT_NONE)
+            continue;
+
+        pwm_fixture_slice_t *s = &slices[slot >> 1];
+        uint32_t h = slot & 1u;
+        uint16_t pwm = gamma_to_pwm(s->gamma[h], rgbw_get(linear, ch));
+        uint32_t out = s->active_low[h] ? (uint32_t)(PWM_WRAP - pwm) : pwm;
+        uint32_t cc = (s->cc & ~(0xFFFFu << (16u * h))) | (out << (16u * h));
+
+        if (cc != s->cc) {
+            s->cc = cc;
+            s->dirty = true;
+        }
+    }
+}
+
+/**
+ * The compare registers were written behind the shadow (DMA fades); the
+ * next pwm_drv_commit() writes every slice
+ */
+void pwm_fixture_invalidate(void)
+{
+    for (uint8_t i = 0; i < slice_count; i++)
+        slices[i].dirty = true;
+}
+
+/* ---------- DDP mapping ---------- */
+uint32_t pwm_ddp_pixel_size(ddp_rgbw_format_t fmt)
+{
+    switch (fmt) {
+        case DDP_FMT_RGBW8:    return 4;
+        case DDP_FMT_RGB8W0:   return 3;
+        case DDP_FMT_RGBW16LE: return 8;
+        default:               return 0;
+    }
+}
+
+/**
+ * One RGBW pixel at byte offset 'off' of a DDP payload
+ */
+bool pwm_ddp_pixel(const uint8_t *payload, uint16_t payload_len, uint32_t off,
+                   ddp_rgbw_format_t fmt, rgbw16_t *out)
+{
+    uint32_t size = pwm_ddp_pixel_size(fmt);
+
+    if (!payload || !out || !size) return false;
+    if (off + size > payload_len) return false;
+
+    switch (fmt) {
+        case DDP_FMT_RGBW8:
+            out->r = scale8_to_wrap(payload[off + 0]);
+            out->g = scale8_to_wrap(payload[off + 1]);
+            out->b = scale8_to_wrap(payload[off + 2]);
+            out->w = scale8_to_wrap(payload[off + 3]);
+            return true;
+        case DDP_FMT_RGB8W0:
+            out->r = scale8_to_wrap(payload[off + 0]);
+            out->g = scale8_to_wrap(payload[off + 1]);
+            out->b = scale8_to_wrap(payload[off + 2]);
+            out->w = 0;
+            return true;
+        case DDP_FMT_RGBW16LE: {
+            uint16_t r16 = (uint16_t)payload[off + 0] | ((uint16_t)payload[off + 1] << 8);
+            uint16_t g16 = (uint16_t)payload[off + 2] | ((uint16_t)payload[off + 3] << 8);
+            uint16_t b16 = (uint16_t)payload[off + 4] | ((uint16_t)payload[off + 5] << 8);
+            uint16_t w16 = (uint16_t)payload[off + 6] | ((uint16_t)payload[off + 7] << 8);
+            out->r = scale16_to_wrap(r16);
+            out->g = scale16_to_wrap(g16);
+            out->b = scale16_to_wrap(b16);
+            out->w = scale16_to_wrap(w16);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+/**
+ * All fixtures of one DDP frame in one pass: out[fx] is replaced for every
+ * fixture whose pixel (base + ddp_pixel * size) is inside the payload.
+ * Returns the number of fixtures updated.
+ */
+uint8_t pwm_fixture_ddp_frame(const uint8_t *payload, uint16_t payload_len, ddp_rgbw_format_t fmt,
+                              uint16_t base, rgbw16_t *out)
+{
+    uint32_t size = pwm_ddp_pixel_size(fmt);
+    uint8_t n = 0;
+
+    for (uint8_t fx = 0; fx < fixture_count; fx++) {
+        uint32_t off = base + (uint32_t)fixtures[fx].ddp_pixel * size;
+
+        if (pwm_ddp_pixel(payload, payload_len, off, fmt, &out[fx]))
+            n++;
+    }
+    return n;
+}
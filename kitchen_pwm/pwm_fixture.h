@@ -0,0 +1,66 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+#include "pwm_api.h"
+#include "pwm_drv.h"
+#include "pwm_gamma.h"
+
+/**
+ * Table of RGBW fixtures (PWM_FIXTURES in config.h) and the PWM slices they
+ * use. Compare values are staged per slice (A in bits 15:0, B in 31:16)
+ * and pwm_drv_commit() writes each changed slice once. No SDK dependency
+ * except the GPIO -> slice mapping, the host tests run the same code.
+ */
+#define PWM_SLICE_MAX       (PWM_FIXTURE_MAX * PWM_CH_COUNT / 2)
+#define PWM_GAMMA_MAX       3           // distinct gamma curves
+
+typedef struct {
+    const char *name;
+    int8_t   pin[PWM_CH_COUNT];         // GPIO of R, G, B, W; -1 = not fitted
+    bool     active_low[PWM_CH_COUNT];
+    uint8_t  gamma_x10;                 // 22 = 2.2
+    uint16_t ddp_pixel;                 // pixel index in the DDP frame
+} pwm_fixture_t;
+
+typedef struct {
+    uint8_t  slice;
+    int8_t   fx[2];                     // fixture on A / B, -1 = unused
+    int8_t   ch[2];                     // pwm_drv_channel_t on A / B
+    bool     active_low[2];
+    const pwm_gamma_t *gamma[2];
+    uint32_t cc;                        // staged compare value
+    bool     dirty;
+} pwm_fixture_slice_t;
+
+bool pwm_fixture_init(void);
+bool pwm_fixture_init_table(const pwm_fixture_t *tab, uint8_t count);
+uint8_t pwm_fixture_count(void);
+const pwm_fixture_t *pwm_fixture_get(uint8_t fx);
+uint8_t pwm_fixture_slice_count(void);
+pwm_fixture_slice_t *pwm_fixture_slice(uint8_t i);
+
+void pwm_fixture_stage(uint8_t fx, const rgbw16_t *linear);
+void pwm_fixture_invalidate(void);
+
+uint32_t pwm_ddp_pixel_size(ddp_rgbw_format_t fmt);
+bool pwm_ddp_pixel(const uint8_t *payload, uint16_t payload_len, uint32_t off,
+                   ddp_rgbw_format_t fmt, rgbw16_t *out);
+uint8_t pwm_fixture_ddp_frame(const uint8_t *payload, uint16_t payload_len, ddp_rgbw_format_t fmt,
+                              uint16_t base, rgbw16_t *out);
+
+static inline uint16_t scale8_to_wrap(uint8_t v) {
+    /* exact-ish integer scaling to [0..PWM_WRAP] */
+    return (uint16_t)((((uint32_t)v) * PWM_WRAP + 127u) / 255u);
+}
+
+static inline uint16_t scale16_to_wrap(uint16_t v16) {
+    /* map 0..65535 -> 0..PWM_WRAP */
+    return (uint16_t)((((uint32_t)v16) * PWM_WRAP + 32767u) / 65535u);
+}
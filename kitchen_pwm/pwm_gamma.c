@@ -0,0 +1,155 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <math.h>
+
+#include "pwm_gamma.h"
+
+#define GAMMA_LUT_SHIFT  (LINEAR_BITS - GAMMA_LUT_BITS) // 12 - 9 = 3
+
+static pwm_gamma_t gamma_default;      // 2.2, used when a fixture has no own curve
+
+/**
+ * Initialize a gamma lookup table
+ *  Linear domain: LINEAR_BITS
+ *  LUT size: 512 entries → one entry per 2^GAMMA_LUT_SHIFT linear steps
+ *  LUT value: PWM duty (0 … PWM_MAX)
+ *  Gamma: typically 2.2, given in tenths
+ */
+void gamma_curve_init(pwm_gamma_t *g, uint8_t gamma_x10)
+{
+    const float gamma = (float)gamma_x10 / 10.0f;
+
+    g->gamma_x10 = gamma_x10;
+    for (uint32_t i = 0; i < GAMMA_LUT_SIZE; i++) {
+
+        uint32_t linear = i << GAMMA_LUT_SHIFT;
+
+        if (linear == 0) {
+            g->lut[i] = 0;
+            continue;
+        }
+
+        float x = (float)linear / (float)LINEAR_MAX;
+        float y = powf(x, gamma);
+
+        uint32_t pwm = (uint32_t)(y * (PWM_MAX - PWM_MIN_ON) + 0.5f)
+                       + PWM_MIN_ON;
+
+        if (pwm > PWM_MAX)
+            pwm = PWM_MAX;
+
+        g->lut[i] = (uint16_t)pwm;
+    }
+
+    for (uint32_t i = 0; i <= GAMMA_LUT_SIZE; i++) {
+        float x = (float)i / (float)GAMMA_LUT_SIZE;
+        float y = powf(x, gamma);
+
+        g->lut_hr[i] = (uint32_t)(y * (float)(PWM_MAX << PWM_DUTY_FRAC_BITS) + 0.5f);
+    }
+}
+
+/**
+ * Convert a linear light level to a PWM level using a gamma correction LUT
+ * @param linear  Linear light level in [0..LINEAR_MAX]
+ * @return        PWM level in [0..PWM_MAX]
+ */
+uint16_t gamma_to_pwm(const pwm_gamma_t *g, uint16_t linear)
+{
+    /* Split index and fractional part */
+    uint32_t idx  = linear >> GAMMA_LUT_SHIFT;                 // top 9 bits
+    uint32_t frac = linear & ((1u << GAMMA_LUT_SHIFT) - 1);    // lower 3 bits
+
+    if (idx >= GAMMA_LUT_SIZE - 1)
+        return g->lut[GAMMA_LUT_SIZE - 1];
+
+    uint32_t a = g->lut[idx];
+    uint32_t b = g->lut[idx + 1];
+
+    /* Linear interpolation between LUT entries */
+    return (uint16_t)(a + ((b - a) * frac >> GAMMA_LUT_SHIFT));
+}
+
+/**
+ * Convert a 16-bit logical level to a duty in 1/2^PWM_DUTY_FRAC_BITS counts
+ * @param level16  Light level in [0..0xFFFF]
+ * @return         Duty in [0..PWM_MAX << PWM_DUTY_FRAC_BITS]
+ */
+uint32_t gamma_to_duty(const pwm_gamma_t *g, uint16_t level16)
+{
+    const uint32_t shift = 16u - GAMMA_LUT_BITS;
+    uint32_t idx  = (uint32_t)level16 >> shift;
+    uint32_t frac = (uint32_t)level16 & ((1u << shift) - 1);
+
+    if (level16 == 0xFFFF)
+        return g->lut_hr[GAMMA_LUT_SIZE];
+
+    uint32_t a = g->lut_hr[idx];
+    uint32_t b = g->lut_hr[idx + 1];
+    return a + (((b - a) * frac) >> shift);
+}
+
+void gamma_lut_init(void)
+{
+    gamma_curve_init(&gamma_default, 22);
+}
+
+const pwm_gamma_t *gamma_get_default(void)
+{
+    return &gamma_default;
+}
+
+uint16_t linear_to_pwm(uint16_t linear)
+{
+    return gamma_to_pwm(&gamma_default, linear);
+}
+
+uint32_t level16_to_duty(uint16_t level16)
+{
+    return gamma_to_duty(&gamma_default, level16);
+}
+
+
+// static void gamma_lut_init(void)
+// {
+//     const float gamma = 2.2f;
+
+//     for (uint32_t i = 0; i < GAMMA_LUT_SIZE; i++) {
+//         /* Map LUT index to linear domain */
+//         uint32_t linear = i << GAMMA_LUT_SHIFT;   // 0..4095
+
+//         float x = (float)linear / (float)LINEAR_MAX;
+//         float y = powf(x, gamma);
+
+//         uint32_t pwm = (uint32_t)(y * PWM_MAX + 0.5f);
+//         if (pwm > PWM_MAX) pwm = PWM_MAX;
+
+//         gamma_lut[i] = (uint16_t)pwm;
+//     }
+// }
+
+// /**
+//  * Convert a linear light level to a PWM level using approximate gamma (2.2) correction
+//  * If you want perfect gamma: use a LUT (I strongly recommend this).
+//  * @param linear  Linear light level in [0..LINEAR_MAX]
+//  * @return        PWM level in [0..PWM_MAX]
+//  */
+// static inline uint16_t linear_to_pwm(uint16_t linear)
+// {
+//     /* Normalize to 0..1 in Q15 */
+//     uint32_t x = (uint32_t)linear;
+
+//     /* x^2.2 ≈ x^2 * sqrt(x) */
+//     uint64_t x2 = (uint64_t)x * x >> 16;
+//     uint64_t x3 = (x2 * x) >> 16;
+
+//     /* map to PWM range */
+//     uint32_t pwm = (uint32_t)((x3 * PWM_MAX) >> 16);
+//     if (pwm > PWM_MAX) pwm = PWM_MAX;
+
+//     return (uint16_t)pwm;
+// }
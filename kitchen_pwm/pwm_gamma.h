@@ -0,0 +1,52 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+#include <stdint.h>
+#include "config.h"
+
+/**
+ * Linear light -> PWM duty curve, shared by pwm_fixture.c (direct writes)
+ * and pwm_fade.c (DMA compare tables). No SDK dependency.
+ * lut_hr is the high resolution curve for dithering: 16-bit logical level
+ * -> duty in 1/2^PWM_DUTY_FRAC_BITS PWM counts. It has no PWM_MIN_ON
+ * offset, the lowest levels are reached by pulsing single counts.
+ */
+#define GAMMA_LUT_BITS      9                   // 512 entries
+#define GAMMA_LUT_SIZE      (1u << GAMMA_LUT_BITS)
+#define PWM_DUTY_FRAC_BITS  6
+
+typedef struct {
+    uint16_t lut[GAMMA_LUT_SIZE];
+    uint32_t lut_hr[GAMMA_LUT_SIZE + 1];        // level16 >> 7, last entry = full scale
+    uint8_t  gamma_x10;
+} pwm_gamma_t;
+
+void gamma_curve_init(pwm_gamma_t *g, uint8_t gamma_x10);
+uint16_t gamma_to_pwm(const pwm_gamma_t *g, uint16_t linear);
+uint32_t gamma_to_duty(const pwm_gamma_t *g, uint16_t level16);
+
+/* default curve, gamma 2.2 */
+void gamma_lut_init(void);
+const pwm_gamma_t *gamma_get_default(void);
+uint16_t linear_to_pwm(uint16_t linear);
+uint32_t level16_to_duty(uint16_t level16);
+
+/**
+ * LINEAR_BITS level -> 16-bit level, bit replicated so LINEAR_MAX -> 0xFFFF
+ */
+static inline uint16_t linear_to_level16(uint16_t linear)
+{
+    return (uint16_t)((linear << (16 - LINEAR_BITS)) | (linear >> (2 * LINEAR_BITS - 16)));
+}
+
+/**
+ * Global brightness in range 0..LINEAR_MAX applied to a linear level
+ */
+static inline uint16_t apply_brightness_level(uint16_t linear, uint16_t brightness)
+{
+    return (uint16_t)(((uint32_t)linear * (brightness + 1u)) >> LINEAR_BITS);
+}
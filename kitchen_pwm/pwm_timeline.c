@@ -0,0 +1,219 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "pwm_timeline.h"
+
+#define EASE_LUT_SIZE   ((1u << PWM_EASE_LUT_BITS) + 1u)
+#define EASE_LUT_SHIFT  (16u - PWM_EASE_LUT_BITS)
+#define EASE_EXP_K      8.0f        // 2^8 brightness ratio over the segment
+
+// PWM_EASE_IN .. PWM_EASE_EXP, Q15, non-decreasing, 0 .. PWM_EASE_ONE
+static uint16_t ease_lut[PWM_EASE_EXP][EASE_LUT_SIZE];
+
+static const char *const ease_names[PWM_EASE_COUNT] = {
+    "lin", "in", "out", "inout", "exp", "hold"
+};
+
+/**
+ * Build the easing LUTs; float only here, never on the poll path
+ */
+void pwm_ease_init(void)
+{
+    const uint32_t n = EASE_LUT_SIZE - 1u;      // 256
+
+    for (uint32_t i = 0; i <= n; i++) {
+        uint32_t r = n - i;
+
+        ease_lut[PWM_EASE_IN - 1][i] = (uint16_t)((i * i * PWM_EASE_ONE) / (n * n));
+        ease_lut[PWM_EASE_OUT - 1][i] = (uint16_t)(PWM_EASE_ONE - (r * r * PWM_EASE_ONE) / (n * n));
+        // 3x^2 - 2x^3
+        ease_lut[PWM_EASE_IN_OUT - 1][i] =
+            (uint16_t)(((uint64_t)(3u * n - 2u * i) * i * i * PWM_EASE_ONE) / ((uint64_t)n * n * n));
+
+        float x = (float)i / (float)n;
+        float y = (powf(2.0f, EASE_EXP_K * x) - 1.0f) / (powf(2.0f, EASE_EXP_K) - 1.0f);
+        ease_lut[PWM_EASE_EXP - 1][i] = (uint16_t)(y * (float)PWM_EASE_ONE + 0.5f);
+    }
+    ease_lut[PWM_EASE_EXP - 1][0] = 0;
+    ease_lut[PWM_EASE_EXP - 1][n] = PWM_EASE_ONE;
+}
+
+static uint16_t ease_lut_eval(pwm_ease_t ease, uint32_t pos16)
+{
+    const uint16_t *lut = ease_lut[ease - 1];
+    uint32_t idx = pos16 >> EASE_LUT_SHIFT;
+    uint32_t frac = pos16 & ((1u << EASE_LUT_SHIFT) - 1u);
+
+    if (idx >= EASE_LUT_SIZE - 1u)
+        return lut[EASE_LUT_SIZE - 1u];
+    uint32_t a = lut[idx];
+    uint32_t b = lut[idx + 1];
+    return (uint16_t)(a + (((b - a) * frac) >> EASE_LUT_SHIFT));
+}
+
+/**
+ * Progress of a segment in Q15 for position pos16 (0 .. 65536).
+ * PWM_EASE_EXP mirrors on fade-down, so dimming keeps a constant ratio too.
+ */
+uint16_t pwm_ease_q15(pwm_ease_t ease, uint32_t pos16, bool rising)
+{
+    if (pos16 > 65536u)
+        pos16 = 65536u;
+
+    switch (ease) {
+        case PWM_EASE_LINEAR:
+            return (uint16_t)(pos16 >> 1);
+        case PWM_EASE_IN:
+        case PWM_EASE_OUT:
+        case PWM_EASE_IN_OUT:
+            return ease_lut_eval(ease, pos16);
+        case PWM_EASE_EXP:
+            if (rising)
+                return ease_lut_eval(ease, pos16);
+            return (uint16_t)(PWM_EASE_ONE - ease_lut_eval(ease, 65536u - pos16));
+        default:
+            return 0;
+    }
+}
+
+const char *pwm_ease_name(pwm_ease_t ease)
+{
+    return (ease < PWM_EASE_COUNT) ? ease_names[ease] : "?";
+}
+
+/**
+ * Returns the pwm_ease_t of a CLI name, -1 when unknown
+ */
+int pwm_ease_from_name(const char *name)
+{
+    for (int i = 0; i < PWM_EASE_COUNT; i++)
+        if (strcmp(name, ease_names[i]) == 0)
+            return i;
+    return -1;
+}
+
+/* progress <= PWM_EASE_ONE, so a segment never overshoots its target */
+static uint16_t ease_channel(uint16_t a, uint16_t b, uint32_t pos16, pwm_ease_t ease)
+{
+    bool rising = b >= a;
+    uint32_t mag = rising ? (uint32_t)(b - a) : (uint32_t)(a - b);
+    uint32_t d = (mag * pwm_ease_q15(ease, pos16, rising) + (PWM_EASE_ONE >> 1)) >> 15;
+
+    return (uint16_t)(rising ? a + d : a - d);
+}
+
+void pwm_tl_init(pwm_timeline_t *tl)
+{
+    memset(tl, 0, sizeof(*tl));
+}
+
+static void tl_seg_begin(pwm_timeline_t *tl)
+{
+    uint32_t dur = tl->count ? tl->seg[tl->head].dur_ms : 0;
+
+    tl->inv_dur = dur ? 0xFFFFFFFFu / dur : 0;
+}
+
+/**
+ * Append a segment; false when the queue is full
+ */
+bool pwm_tl_push(pwm_timeline_t *tl, rgbw16_t to, uint32_t dur_ms, pwm_ease_t ease)
+{
+    if (tl->count >= PWM_TL_MAX_SEGS || ease >= PWM_EASE_COUNT)
+        return false;
+
+    pwm_tl_seg_t *s = &tl->seg[(tl->head + tl->count) % PWM_TL_MAX_SEGS];
+    s->to = to;
+    s->dur_ms = dur_ms;
+    s->ease = (uint8_t)ease;
+    tl->count++;
+    if (tl->count == 1)
+        tl_seg_begin(tl);
+    return true;
+}
+
+void pwm_tl_start(pwm_timeline_t *tl, rgbw16_t from, uint32_t now_ms)
+{
+    tl->from = from;
+    tl->t0_ms = now_ms;
+    tl->active = tl->count != 0;
+    tl_seg_begin(tl);
+}
+
+static void tl_advance(pwm_timeline_t *tl)
+{
+    pwm_tl_seg_t done = tl->seg[tl->head];
+
+    if (done.ease != PWM_EASE_HOLD)
+        tl->from = done.to;
+    tl->t0_ms += done.dur_ms;
+    tl->head = (uint8_t)((tl->head + 1u) % PWM_TL_MAX_SEGS);
+    tl->count--;
+    if (tl->loop) {
+        tl->seg[(tl->head + tl->count) % PWM_TL_MAX_SEGS] = done;
+        tl->count++;
+    }
+    tl_seg_begin(tl);
+}
+
+/**
+ * Colour at now_ms. Segment ends are taken from t0 + dur, not from the poll
+ * time, so a late poll does not stretch the timeline. Returns false once
+ * the last segment has ended (out = its target).
+ */
+bool pwm_tl_eval(pwm_timeline_t *tl, uint32_t now_ms, rgbw16_t *out)
+{
+    if (!tl->active) {
+        *out = tl->from;
+        return false;
+    }
+
+    for (uint32_t n = 0; tl->count; n++) {
+        const pwm_tl_seg_t *s = &tl->seg[tl->head];
+        int32_t dt = (int32_t)(now_ms - tl->t0_ms);
+        uint32_t t = (dt < 0) ? 0u : (uint32_t)dt;
+
+        if (n > 2u * PWM_TL_MAX_SEGS) {
+            if (n > 4u * PWM_TL_MAX_SEGS)
+                break;              // loop of 0 ms segments
+            tl->t0_ms = now_ms;     // looping faster than polled: drop the backlog
+            t = 0;
+        }
+        if (t < s->dur_ms) {
+            uint32_t pos16 = (uint32_t)(((uint64_t)t * tl->inv_dur) >> 16);
+
+            if (s->ease == PWM_EASE_HOLD) {
+                *out = tl->from;
+                return true;
+            }
+            out->r = ease_channel(tl->from.r, s->to.r, pos16, s->ease);
+            out->g = ease_channel(tl->from.g, s->to.g, pos16, s->ease);
+            out->b = ease_channel(tl->from.b, s->to.b, pos16, s->ease);
+            out->w = ease_channel(tl->from.w, s->to.w, pos16, s->ease);
+            return true;
+        }
+        tl_advance(tl);
+    }
+
+    tl->active = false;
+    *out = tl->from;
+    return false;
+}
+
+/**
+ * End colour of the playing segment
+ */
+rgbw16_t pwm_tl_target(const pwm_timeline_t *tl)
+{
+    const pwm_tl_seg_t *s = &tl->seg[tl->head];
+
+    if (!tl->count || s->ease == PWM_EASE_HOLD)
+        return tl->from;
+    return s->to;
+}
@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "pwm_api.h"
+
+/**
+ * Fade timeline: a queue of segments (fade to a colour over X ms with an
+ * easing curve, or hold), evaluated on pwm_api_poll(). Curves are Q15 LUTs
+ * built once by pwm_ease_init(); evaluation is integer only. No SDK
+ * dependency, the host model in tools/pattern_render runs the same code.
+ */
+#define PWM_TL_MAX_SEGS     16
+#define PWM_EASE_LUT_BITS   8                   // 256 intervals
+#define PWM_EASE_ONE        (1u << 15)          // Q15 1.0
+
+typedef enum {
+    PWM_EASE_LINEAR = 0,
+    PWM_EASE_IN,            // quadratic, slow start
+    PWM_EASE_OUT,           // quadratic, slow end
+    PWM_EASE_IN_OUT,        // smoothstep
+    PWM_EASE_EXP,           // constant ratio per step in the perceptual domain
+    PWM_EASE_HOLD,          // keep the colour for dur_ms
+    PWM_EASE_COUNT
+} pwm_ease_t;
+
+typedef struct {
+    rgbw16_t to;            // ignored for PWM_EASE_HOLD
+    uint32_t dur_ms;
+    uint8_t  ease;          // pwm_ease_t
+} pwm_tl_seg_t;
+
+typedef struct {
+    pwm_tl_seg_t seg[PWM_TL_MAX_SEGS];      // ring, seg[head] is playing
+    uint8_t  head;
+    uint8_t  count;
+    bool     loop;          // finished segments go back to the tail
+    bool     active;
+    rgbw16_t from;          // start colour of seg[head]
+    uint32_t t0_ms;         // start time of seg[head]
+    uint32_t inv_dur;       // 2^32 / dur_ms of seg[head]
+} pwm_timeline_t;
+
+void pwm_ease_init(void);
+uint16_t pwm_ease_q15(pwm_ease_t ease, uint32_t pos16, bool rising);
+const char *pwm_ease_name(pwm_ease_t ease);
+int pwm_ease_from_name(const char *name);
+
+void pwm_tl_init(pwm_timeline_t *tl);
+bool pwm_tl_push(pwm_timeline_t *tl, rgbw16_t to, uint32_t dur_ms, pwm_ease_t ease);
+void pwm_tl_start(pwm_timeline_t *tl, rgbw16_t from, uint32_t now_ms);
+bool pwm_tl_eval(pwm_timeline_t *tl, uint32_t now_ms, rgbw16_t *out);
+rgbw16_t pwm_tl_target(const pwm_timeline_t *tl);
@@ -5,7 +5,7 @@
  */
 
 
-// #include <stdio.h>
+#include <stdio.h>
 #include <string.h>
 // #include "pico/stdlib.h"
 // #include "hardware/uart.h"
@@ -15,39 +15,34 @@
 #include "rd03d_drv.h"
 #include "rd03d_api.h"
 
-/* ---------- RD-03D sign encoding decoder ----------
- * Manual example indicates:
- * - MSB=1 => positive, magnitude = raw - 0x8000
- * - MSB=0 => negative, magnitude = raw & 0x7FFF, value = -magnitude
- * See example decode on page 19 :contentReference[oaicite:3]{index=3}
- */
-static inline int16_t rd03d_decode_signmag(uint16_t raw)
-{
-    uint16_t mag = (uint16_t)(raw & 0x7FFF);
-    if (raw & 0x8000)
-        return (int16_t)mag;        /* positive */
-    return (int16_t)(-(int16_t)mag); /* negative */
-}
-
-typedef struct
-{
-    bool     present;
-    int16_t  x_mm;
-    int16_t  y_mm;
-    int16_t  v_cms;
-    uint16_t dist_mm;
-} det_t;
-
 static rd03d_filter_cfg_t s_cfg;
 static rd03d_state_t      s_state;
 static bool               s_state_valid;
+static rd03d_frame_fn     s_frame_hook[RD03D_FRAME_HOOKS];
 
-/* ---------- helpers ---------- */
-static inline uint32_t now_ms(void)
+#if RD03D_TRACKS != RD03D_OBJECT_SLOTS
+#error "the 3x3 assignment below expects one track per report slot"
+#endif
+
+/* Filter state per track, fixed point: position mm and velocity mm/s in Q4 */
+#define KF_Q            4
+#define KF_VMAX         (8000 << KF_Q)      /* faster than anybody walks */
+#define KF_GATE_MAX     4000                /* keeps the gain products in 32 bits */
+#define KF_DT_MIN_MS    20
+#define KF_DT_MAX_MS    2000
+#define KF_RANGE_MIN_MM 100                 /* radial speed too sensitive to the angle below */
+
+typedef struct
 {
-    return (uint32_t)to_ms_since_boot(get_absolute_time());
-}
+    int32_t x, y;
+    int32_t vx, vy;
+} kf_t;
+
+static kf_t     s_kf[RD03D_TRACKS];
+static uint32_t s_kf_ms;            /* time the filters are at */
+static uint8_t  s_next_id;
 
+/* ---------- helpers ---------- */
 static inline uint32_t u32_abs_diff(uint32_t a, uint32_t b)
 {
     return (a > b) ? (a - b) : (b - a);
@@ -58,16 +53,14 @@ static inline uint32_t sq_u32(int32_t v)
     return (uint32_t)(v * v);
 }
 
-static uint32_t dist2_mm(int16_t x1, int16_t y1, int16_t x2, int16_t y2)
+static inline int32_t clamp_i32(int32_t v, int32_t lim)
 {
-    int32_t dx = (int32_t)x1 - (int32_t)x2;
-    int32_t dy = (int32_t)y1 - (int32_t)y2;
-    return sq_u32(dx) + sq_u32(dy);
+    return (v > lim) ? lim : (v < -lim) ? -lim : v;
 }
 
-static bool det_is_zero(const rd03d_object_raw_t *o)
+static inline int16_t q_to_i16(int32_t v)
 {
-    return (o->x_raw == 0 && o->y_raw == 0 && o->v_raw == 0 && o->dist_mm == 0);
+    return (int16_t)clamp_i32((v + (1 << (KF_Q - 1))) >> KF_Q, INT16_MAX);
 }
 
 /* ---------- init ---------- */
@@ -81,71 +74,189 @@ bool rd03d_api_init(const rd03d_filter_cfg_t *cfg)
         .conf_on           = 120,
         .conf_off          = 60,
         .stale_ms          = 1500,
+        .alpha_q8          = 128,  /* walking people, ~60 mm position noise at 10 Hz */
+        .beta_q8           = 32,
+        .gamma_q8          = 64,
     };
 
     s_cfg = cfg ? *cfg : def;
+    if (s_cfg.max_match_dist_mm > KF_GATE_MAX)
+        s_cfg.max_match_dist_mm = KF_GATE_MAX;
 
     memset(&s_state, 0, sizeof(s_state));
+    memset(s_kf, 0, sizeof(s_kf));
     s_state_valid = false;
+    s_kf_ms = 0;
+    s_next_id = 0;
 
     return rd03d_drv_init();
 }
 
-/* ---------- tracking update ----------
- * Because RD-03D provides no stable IDs, object order may swap.
- * We do nearest-neighbour association into 3 persistent tracks.
+/* ---------- alpha-beta filter ---------- */
+static void kf_predict(kf_t *k, uint32_t dt_ms)
+{
+    k->x += k->vx * (int32_t)dt_ms / 1000;
+    k->y += k->vy * (int32_t)dt_ms / 1000;
+}
+
+/* Radial speed as reported (cm/s, + = moving away) pulls the velocity
+ * component along the line of sight towards it */
+static void kf_radial(kf_t *k, const rd03d_det_t *d)
+{
+    int32_t r = d->dist_mm;
+
+    if (!s_cfg.gamma_q8 || r < KF_RANGE_MIN_MM)
+        return;
+
+    int32_t pred = (d->x_mm * (k->vx >> KF_Q) + d->y_mm * (k->vy >> KF_Q)) / r;
+    int32_t err = clamp_i32((int32_t)d->v_cms * 10 - pred, 1000);
+    int32_t e = (err * s_cfg.gamma_q8) >> (8 - KF_Q);
+
+    k->vx += e * d->x_mm / r;
+    k->vy += e * d->y_mm / r;
+}
+
+static void kf_update(kf_t *k, const rd03d_det_t *d, uint32_t dt_ms)
+{
+    int32_t gate = (int32_t)s_cfg.max_match_dist_mm << KF_Q;
+    int32_t rx = clamp_i32(((int32_t)d->x_mm << KF_Q) - k->x, gate);
+    int32_t ry = clamp_i32(((int32_t)d->y_mm << KF_Q) - k->y, gate);
+    int32_t b = (int32_t)(s_cfg.beta_q8 * 1000u / dt_ms);     /* beta / dt, Q8 per s */
+
+    k->x += (rx * s_cfg.alpha_q8) >> 8;
+    k->y += (ry * s_cfg.alpha_q8) >> 8;
+    k->vx += (rx * b) >> 8;
+    k->vy += (ry * b) >> 8;
+    kf_radial(k, d);
+    k->vx = clamp_i32(k->vx, KF_VMAX);
+    k->vy = clamp_i32(k->vy, KF_VMAX);
+}
+
+/* new target: at the detection, moving along the line of sight as reported */
+static void kf_start(kf_t *k, const rd03d_det_t *d)
+{
+    k->x = (int32_t)d->x_mm << KF_Q;
+    k->y = (int32_t)d->y_mm << KF_Q;
+    k->vx = k->vy = 0;
+    kf_radial(k, d);
+}
+
+static void track_out(rd03d_track_t *tr, const kf_t *k)
+{
+    tr->x_mm = q_to_i16(k->x);
+    tr->y_mm = q_to_i16(k->y);
+    tr->vx_mms = q_to_i16(k->vx);
+    tr->vy_mms = q_to_i16(k->vy);
+}
+
+static void conf_up(rd03d_track_t *tr)
+{
+    uint16_t c = (uint16_t)tr->confidence + s_cfg.conf_inc;
+    tr->confidence = (c > 255u) ? 255u : (uint8_t)c;
+    tr->valid = (tr->confidence >= s_cfg.conf_off);
+}
+
+/* ---------- association ----------
+ * Optimal 3x3 assignment of detections to predicted tracks: all six
+ * permutations, a pair outside the gate costs the gate squared (= left
+ * unmatched). Crossing targets keep their tracks where greedy nearest
+ * neighbour hands the first track whichever is closer.
  */
-static void update_tracks(const det_t det[RD03D_OBJECT_SLOTS], uint32_t t_ms)
+static const uint8_t k_perm[6][RD03D_TRACKS] = {
+    { 0, 1, 2 }, { 0, 2, 1 }, { 1, 0, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 },
+};
+
+static void associate(const rd03d_det_t det[RD03D_OBJECT_SLOTS], int8_t match[RD03D_TRACKS])
 {
-    bool det_used[RD03D_OBJECT_SLOTS] = {false, false, false};
+    uint32_t gate2 = (uint32_t)s_cfg.max_match_dist_mm * s_cfg.max_match_dist_mm;
+    uint32_t cost[RD03D_TRACKS][RD03D_OBJECT_SLOTS];
 
-    /* 1) Attempt to match existing active tracks */
     for (int ti = 0; ti < RD03D_TRACKS; ti++)
     {
-        rd03d_track_t *tr = &s_state.track[ti];
+        const rd03d_track_t *tr = &s_state.track[ti];
 
-        /* Decay if stale or not yet valid */
-        bool active = tr->valid;
-
-        int best_di = -1;
-        uint32_t best_d2 = 0xFFFFFFFFu;
+        for (int di = 0; di < RD03D_OBJECT_SLOTS; di++)
+        {
+            cost[ti][di] = gate2;
+            if (tr->confidence == 0 || !det[di].present)
+                continue;
+
+            int32_t dx = ((int32_t)det[di].x_mm << KF_Q) - s_kf[ti].x;
+            int32_t dy = ((int32_t)det[di].y_mm << KF_Q) - s_kf[ti].y;
+            uint32_t d2 = sq_u32(clamp_i32(dx >> KF_Q, KF_GATE_MAX + 1)) +
+                          sq_u32(clamp_i32(dy >> KF_Q, KF_GATE_MAX + 1));
+            if (d2 < gate2)
+                cost[ti][di] = d2;
+        }
+    }
 
-        if (active)
+    uint32_t best = UINT32_MAX;
+    int best_p = 0;
+    for (int p = 0; p < 6; p++)
+    {
+        uint32_t sum = 0;
+        for (int ti = 0; ti < RD03D_TRACKS; ti++)
+            sum += cost[ti][k_perm[p][ti]];
+        if (sum < best)
         {
-            for (int di = 0; di < RD03D_OBJECT_SLOTS; di++)
-            {
-                if (!det[di].present || det_used[di])
-                    continue;
-
-                uint32_t d2 = dist2_mm(tr->x_mm, tr->y_mm, det[di].x_mm, det[di].y_mm);
-                uint32_t max_d2 = (uint32_t)s_cfg.max_match_dist_mm * (uint32_t)s_cfg.max_match_dist_mm;
-                if (d2 <= max_d2 && d2 < best_d2)
-                {
-                    best_d2 = d2;
-                    best_di = di;
-                }
-            }
+            best = sum;
+            best_p = p;
         }
+    }
 
-        if (best_di >= 0)
+    for (int ti = 0; ti < RD03D_TRACKS; ti++)
+    {
+        int di = k_perm[best_p][ti];
+        match[ti] = (cost[ti][di] < gate2) ? (int8_t)di : -1;
+    }
+}
+
+/* ---------- tracking update ----------
+ * Because RD-03D provides no stable IDs, object order may swap.
+ * Every track runs a constant-velocity alpha-beta filter: predicted to the
+ * frame time, associated, then corrected by its detection; missed tracks
+ * coast on the prediction until their confidence runs out.
+ */
+static void update_tracks(const rd03d_det_t det[RD03D_OBJECT_SLOTS], uint32_t t_ms)
+{
+    bool det_used[RD03D_OBJECT_SLOTS] = {false, false, false};
+    int8_t match[RD03D_TRACKS];
+    uint32_t dt = t_ms - s_kf_ms;
+
+    if (!s_kf_ms || dt < KF_DT_MIN_MS)
+        dt = KF_DT_MIN_MS;
+    else if (dt > KF_DT_MAX_MS)
+        dt = KF_DT_MAX_MS;
+    s_kf_ms = t_ms;
+
+    /* 1) Predict the live tracks to this frame and match them */
+    for (int ti = 0; ti < RD03D_TRACKS; ti++)
+        if (s_state.track[ti].confidence)
+            kf_predict(&s_kf[ti], dt);
+    associate(det, match);
+
+    for (int ti = 0; ti < RD03D_TRACKS; ti++)
+    {
+        rd03d_track_t *tr = &s_state.track[ti];
+        kf_t *k = &s_kf[ti];
+
+        if (match[ti] >= 0)
         {
-            /* Matched: update state, increase confidence */
-            const det_t *d = &det[best_di];
-            det_used[best_di] = true;
+            /* Matched: correct the filter, increase confidence */
+            const rd03d_det_t *d = &det[match[ti]];
+            det_used[match[ti]] = true;
 
-            tr->x_mm = d->x_mm;
-            tr->y_mm = d->y_mm;
+            kf_update(k, d, dt);
             tr->speed_cms = d->v_cms;
             tr->distance_mm = d->dist_mm;
             tr->last_seen_ms = t_ms;
-
-            uint16_t c = (uint16_t)tr->confidence + s_cfg.conf_inc;
-            tr->confidence = (c > 255u) ? 255u : (uint8_t)c;
-            tr->valid = (tr->confidence >= s_cfg.conf_off);
+            conf_up(tr);
         }
         else
         {
-            /* Not matched: decay confidence */
+            /* Not matched: coast with a slowing velocity, decay confidence */
+            k->vx -= k->vx / 4;
+            k->vy -= k->vy / 4;
             if (tr->confidence > s_cfg.conf_dec)
                 tr->confidence = (uint8_t)(tr->confidence - s_cfg.conf_dec);
             else
@@ -157,9 +268,10 @@ static void update_tracks(const det_t det[RD03D_OBJECT_SLOTS], uint32_t t_ms)
 
             tr->valid = (tr->confidence >= s_cfg.conf_off);
         }
+        track_out(tr, k);
     }
 
-    /* 2) Assign remaining detections to empty/low-confidence tracks */
+    /* 2) Start tracks for the remaining detections in the weakest unmatched slots */
     for (int di = 0; di < RD03D_OBJECT_SLOTS; di++)
     {
         if (!det[di].present || det_used[di])
@@ -171,7 +283,7 @@ static void update_tracks(const det_t det[RD03D_OBJECT_SLOTS], uint32_t t_ms)
         for (int ti = 0; ti < RD03D_TRACKS; ti++)
         {
             rd03d_track_t *tr = &s_state.track[ti];
-            if (tr->confidence < best_conf)
+            if (match[ti] < 0 && tr->confidence < best_conf)
             {
                 best_conf = tr->confidence;
                 best_ti = ti;
@@ -181,17 +293,19 @@ static void update_tracks(const det_t det[RD03D_OBJECT_SLOTS], uint32_t t_ms)
         if (best_ti >= 0)
         {
             rd03d_track_t *tr = &s_state.track[best_ti];
-            tr->x_mm = det[di].x_mm;
-            tr->y_mm = det[di].y_mm;
+
+            kf_start(&s_kf[best_ti], &det[di]);
+            if (++s_next_id == 0)
+                s_next_id = 1;
+            tr->id = s_next_id;
+            tr->confidence = 0;
             tr->speed_cms = det[di].v_cms;
             tr->distance_mm = det[di].dist_mm;
             tr->last_seen_ms = t_ms;
+            conf_up(tr);
+            track_out(tr, &s_kf[best_ti]);
 
-            /* bootstrap confidence */
-            uint16_t c = (uint16_t)tr->confidence + s_cfg.conf_inc;
-            tr->confidence = (c > 255u) ? 255u : (uint8_t)c;
-            tr->valid = (tr->confidence >= s_cfg.conf_off);
-
+            match[best_ti] = (int8_t)di;
             det_used[di] = true;
         }
     }
@@ -225,37 +339,47 @@ static void update_tracks(const det_t det[RD03D_OBJECT_SLOTS], uint32_t t_ms)
     }
 }
 
-/* ---------- poll ---------- */
+/* ---------- poll ----------
+ * Detections arrive decoded (rd03d_drv.c); every queued frame is tracked
+ * in order, so a late poll does not skip radar frames.
+ */
 void rd03d_api_poll(void)
 {
     rd03d_drv_poll();
 
     rd03d_frame_t f;
-    if (!rd03d_drv_get_frame(&f))
-        return;
-
-    det_t det[RD03D_OBJECT_SLOTS] = {0};
-
-    for (int i = 0; i < RD03D_OBJECT_SLOTS; i++)
+    while (rd03d_drv_get_frame(&f))
     {
-        const rd03d_object_raw_t *o = &f.report.obj[i];
+        #ifdef _RD03D_CSV_DEBUG_
+        // one line per frame, format read by tools/pattern_render/presence_replay
+        printf("R,%u", (unsigned)f.rx_time_ms);
+        for (int i = 0; i < RD03D_OBJECT_SLOTS; i++)
+            printf(",%d,%d,%d,%u", f.det[i].x_mm, f.det[i].y_mm, f.det[i].v_cms, f.det[i].dist_mm);
+        printf("\n");
+        #endif // _RD03D_CSV_DEBUG_
+
+        s_state.rx_time_ms = f.rx_time_ms;
+        update_tracks(f.det, f.rx_time_ms);
+        s_state_valid = true;
+
+        for (int i = 0; i < RD03D_FRAME_HOOKS && s_frame_hook[i]; i++)
+            s_frame_hook[i](&s_state);
+    }
+}
 
-        if (det_is_zero(o))
+bool rd03d_api_frame_hook(rd03d_frame_fn fn)
+{
+    for (int i = 0; i < RD03D_FRAME_HOOKS; i++)
+    {
+        if (s_frame_hook[i] == fn)
+            return true;
+        if (!s_frame_hook[i])
         {
-            det[i].present = false;
-            continue;
+            s_frame_hook[i] = fn;
+            return true;
         }
-
-        det[i].present = true;
-        det[i].x_mm  = rd03d_decode_signmag(o->x_raw);
-        det[i].y_mm  = rd03d_decode_signmag(o->y_raw);
-        det[i].v_cms = rd03d_decode_signmag(o->v_raw);
-        det[i].dist_mm = o->dist_mm;
     }
-
-    s_state.rx_time_ms = f.rx_time_ms;
-    update_tracks(det, f.rx_time_ms);
-    s_state_valid = true;
+    return false;
 }
 
 bool rd03d_api_get_state(rd03d_state_t *out)
@@ -267,5 +391,33 @@ bool rd03d_api_get_state(rd03d_state_t *out)
     return true;
 }
 
+/**
+ * Tracks between radar frames: the last frame's filters run forward to
+ * t_ms, at most RD03D_PREDICT_MAX_MS. The state itself is not changed.
+ */
+bool rd03d_api_predict(uint32_t t_ms, rd03d_state_t *out)
+{
+    if (!out || !s_state_valid)
+        return false;
+
+    uint32_t dt = t_ms - s_kf_ms;
+    if ((int32_t)dt < 0)
+        dt = 0;
+    else if (dt > RD03D_PREDICT_MAX_MS)
+        dt = RD03D_PREDICT_MAX_MS;
+
+    *out = s_state;
+    for (int ti = 0; ti < RD03D_TRACKS; ti++)
+    {
+        kf_t k = s_kf[ti];
+
+        if (!out->track[ti].confidence)
+            continue;
+        kf_predict(&k, dt);
+        track_out(&out->track[ti], &k);
+    }
+    return true;
+}
+
 
 
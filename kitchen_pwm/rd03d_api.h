@@ -26,13 +26,18 @@ extern "C" {
 
 #define RD03D_TRACKS 3
 
+#define RD03D_PREDICT_MAX_MS    300     /* rd03d_api_predict() extrapolates at most this far */
+
 typedef struct
 {
     bool     valid;        /* track considered active */
     uint8_t  confidence;   /* 0..255 */
-    int16_t  x_mm;
+    uint8_t  id;           /* new for every target the track picks up, never 0 */
+    int16_t  x_mm;         /* filtered position */
     int16_t  y_mm;
-    int16_t  speed_cms;
+    int16_t  vx_mms;       /* filtered velocity */
+    int16_t  vy_mms;
+    int16_t  speed_cms;    /* radial speed as reported, + = moving away */
     uint16_t distance_mm;
     uint32_t last_seen_ms;
 } rd03d_track_t;
@@ -53,12 +58,24 @@ typedef struct
     uint8_t  conf_on;              /* presence threshold */
     uint8_t  conf_off;             /* drop threshold (hysteresis) */
     uint32_t stale_ms;             /* invalidate if not seen */
+    uint8_t  alpha_q8;             /* alpha-beta position gain, /256 */
+    uint8_t  beta_q8;              /* alpha-beta velocity gain, /256 */
+    uint8_t  gamma_q8;             /* weight of the reported radial speed, /256, 0 = unused */
 } rd03d_filter_cfg_t;
 
 bool rd03d_api_init(const rd03d_filter_cfg_t *cfg);
 void rd03d_api_poll(void);
 bool rd03d_api_get_state(rd03d_state_t *out);
 
+/* state of the last frame with the tracks moved on to t_ms (constant velocity) */
+bool rd03d_api_predict(uint32_t t_ms, rd03d_state_t *out);
+
+/* Called from rd03d_api_poll() once per new radar frame, after tracking,
+ * in the order the hooks were added */
+#define RD03D_FRAME_HOOKS 4
+typedef void (*rd03d_frame_fn)(const rd03d_state_t *st);
+bool rd03d_api_frame_hook(rd03d_frame_fn fn);
+
 // typedef struct
 // {
 //     bool     presence;
@@ -7,36 +7,53 @@
 #include "rd03d_cli.h"
 #include "rd03d_api.h"
 #include "rd03d_drv.h"
+#include "pico/time.h"
+#include "pico/stdlib.h"
+#include "cli_cmd.h"
+#include "tcp_cli.h"
 
 #include <stdio.h>
 #include <string.h>
 
-/* Replace these with your actual CLI registration hooks */
-extern void cli_register(const char *name,
-                         const char *help,
-                         int (*handler)(int argc, char **argv));
+#define CONSOLE     0xFF    // print_state() to stdout instead of a CLI socket
 
 static bool s_dump_continuous = false;
 static bool s_dump_once = false;
 static bool s_dump_raw = false;
 
-static void print_state(const rd03d_state_t *st)
+static void print_line(uint8_t sn, const char *line)
 {
-    printf("[RD03D] t=%lu ms presence=%d\n",
-           (unsigned long)st->rx_time_ms, st->presence ? 1 : 0);
+    if (sn == CONSOLE)
+        printf("%s", line);
+    else
+        cli_send(sn, line);
+}
+
+static void print_state(const rd03d_state_t *st, uint8_t sn)
+{
+    char line[200];
+
+    snprintf(line, sizeof(line), "[RD03D] t=%lu ms presence=%d\r\n",
+             (unsigned long)st->rx_time_ms, st->presence ? 1 : 0);
+    print_line(sn, line);
 
     for (int i = 0; i < RD03D_TRACKS; i++)
     {
         const rd03d_track_t *tr = &st->track[i];
-        printf("  track[%d] valid=%d conf=%u x=%dmm y=%dmm v=%dcm/s d=%umm age=%lums\n",
-               i,
-               tr->valid ? 1 : 0,
-               (unsigned)tr->confidence,
-               (int)tr->x_mm,
-               (int)tr->y_mm,
-               (int)tr->speed_cms,
-               (unsigned)tr->distance_mm,
-               (unsigned long)(st->rx_time_ms - tr->last_seen_ms));
+        snprintf(line, sizeof(line),
+                 "  track[%d] id=%u valid=%d conf=%u x=%dmm y=%dmm vx=%dmm/s vy=%dmm/s v=%dcm/s d=%umm age=%lums\r\n",
+                 i,
+                 (unsigned)tr->id,
+                 tr->valid ? 1 : 0,
+                 (unsigned)tr->confidence,
+                 (int)tr->x_mm,
+                 (int)tr->y_mm,
+                 (int)tr->vx_mms,
+                 (int)tr->vy_mms,
+                 (int)tr->speed_cms,
+                 (unsigned)tr->distance_mm,
+                 (unsigned long)(st->rx_time_ms - tr->last_seen_ms));
+        print_line(sn, line);
     }
 }
 
@@ -49,76 +66,84 @@ static void dump_raw_frame_if_needed(void)
     if (!rd03d_drv_get_frame(&f))
         return;
 
-    /* Re-emit the raw report bytes for debugging */
-    const uint8_t *p = (const uint8_t *)&f.report;
-    printf("[RD03D][RAW] AA FF 03 00 ");
-    for (unsigned i = 0; i < sizeof(f.report); i++)
-        printf("%02X ", p[i]);
-    printf("55 CC\n");
+    /* Detections as decoded by the parser, before tracking */
+    printf("[RD03D][RAW] t=%lu ms", (unsigned long)f.rx_time_ms);
+    for (int i = 0; i < RD03D_OBJECT_SLOTS; i++)
+        printf("  [%d] %s x=%d y=%d v=%d d=%u", i, f.det[i].present ? "on " : "off",
+               f.det[i].x_mm, f.det[i].y_mm, f.det[i].v_cms, f.det[i].dist_mm);
+    printf("\n");
 }
 
-static int cmd_rd03d(int argc, char **argv)
+static bool cmd_rd03d_status(const cli_ctx_t *ctx)
 {
-    if (argc < 2)
-    {
-        printf("usage: rd03d status | dump on|off|once|raw\n");
-        return 0;
-    }
+    rd03d_state_t st;
+
+    if (rd03d_api_get_state(&st))
+        print_state(&st, ctx->sn);
+    else
+        cli_send(ctx->sn, "[RD03D] no data yet\r\n");
+    cli_flush(ctx->sn, "");
+    return true;
+}
 
-    if (strcmp(argv[1], "status") == 0)
+static bool cmd_rd03d_predict(const cli_ctx_t *ctx)
+{
+    /* tracks moved on from the last frame to now */
+    rd03d_state_t st;
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    char msg[40];
+
+    if (!rd03d_api_predict(now, &st))
     {
-        rd03d_state_t st;
-        if (rd03d_api_get_state(&st))
-            print_state(&st);
-        else
-            printf("[RD03D] no data yet\n");
-        return 0;
+        cli_flush(ctx->sn, "[RD03D] no data yet\r\n");
+        return true;
     }
+    print_state(&st, ctx->sn);
+    snprintf(msg, sizeof(msg), "  predicted +%lu ms\r\n", (unsigned long)(now - st.rx_time_ms));
+    cli_flush(ctx->sn, msg);
+    return true;
+}
 
-    if (strcmp(argv[1], "dump") == 0)
+/* dumps go to the USB console, from rd03d_cli_tick() */
+static bool cmd_rd03d_dump(const cli_ctx_t *ctx)
+{
+    static const char *const modes[] = { "on", "off", "once", "raw" };
+
+    switch (cli_arg_enum(ctx->argv[0], modes, (uint8_t)count_of(modes)))
     {
-        if (argc < 3)
-        {
-            printf("usage: rd03d dump on|off|once|raw\n");
-            return 0;
-        }
-
-        if (strcmp(argv[2], "on") == 0)
-        {
+        case 0:
             s_dump_continuous = true;
-            printf("[RD03D] dump on\n");
-        }
-        else if (strcmp(argv[2], "off") == 0)
-        {
+            cli_flush(ctx->sn, "[RD03D] dump on\r\n");
+            return true;
+        case 1:
             s_dump_continuous = false;
             s_dump_once = false;
             s_dump_raw = false;
-            printf("[RD03D] dump off\n");
-        }
-        else if (strcmp(argv[2], "once") == 0)
-        {
+            cli_flush(ctx->sn, "[RD03D] dump off\r\n");
+            return true;
+        case 2:
             s_dump_once = true;
-            printf("[RD03D] dump once (next frame)\n");
-        }
-        else if (strcmp(argv[2], "raw") == 0)
-        {
+            cli_flush(ctx->sn, "[RD03D] dump once (next frame)\r\n");
+            return true;
+        case 3:
             s_dump_raw = true;
-            printf("[RD03D] raw dump enabled (will consume next raw frame)\n");
-        }
-        else
-        {
-            printf("usage: rd03d dump on|off|once|raw\n");
-        }
-        return 0;
+            cli_flush(ctx->sn, "[RD03D] raw dump enabled (will consume next raw frame)\r\n");
+            return true;
+        default:
+            return false;
     }
-
-    printf("unknown subcommand\n");
-    return 0;
 }
 
+static const cli_cmd_t s_cmds[] = {
+    { "rd03d status",  "",                      "RD-03D tracks of the last frame",     0, 0, cmd_rd03d_status },
+    { "rd03d predict", "",                      "RD-03D tracks moved on to now",       0, 0, cmd_rd03d_predict },
+    { "rd03d dump",    "<on|off|once|raw>",     "RD-03D tracks or frames to the USB console", 1, 1, cmd_rd03d_dump },
+};
+
 void rd03d_cli_register(void)
 {
-    cli_register("rd03d", "RD-03D radar commands", cmd_rd03d);
+    if (!cli_cmd_register(s_cmds, (uint8_t)count_of(s_cmds)))
+        printf("[CLI] rd03d commands not registered: index full or a name taken\r\n");
 }
 
 /* Call this from your main loop periodically after rd03d_api_poll() */
@@ -137,7 +162,7 @@ void rd03d_cli_tick(void)
     rd03d_state_t st;
     if (rd03d_api_get_state(&st))
     {
-        print_state(&st);
+        print_state(&st, CONSOLE);
         if (s_dump_once)
             s_dump_once = false;
     }
@@ -5,5 +5,10 @@
  */
 
 #pragma once
-void cli_rd03d_register(void);
+
+/* rd03d status|predict|dump commands of the telnet CLI */
+void rd03d_cli_register(void);
+
+/* console dumps asked for with "rd03d dump", from the main loop */
+void rd03d_cli_tick(void);
 
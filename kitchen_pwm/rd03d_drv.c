@@ -4,11 +4,12 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 
-#include "pico/stdlib.h"
-#include "hardware/uart.h"
-#include "hardware/gpio.h"
+#include <string.h>
 
+#include "config.h"
+#include "pico/time.h"
 #include "rd03d_drv.h"
+#include "spsc_queue.h"
 
 /* Your wiring */
 #ifndef RD03D_UART
@@ -45,7 +46,7 @@
 #define RD03D_FRAME_BYTES    (4u + RD03D_PAYLOAD_BYTES + 2u)
 
 #ifndef RD03D_RX_RING_SIZE
-/* Must be power-of-two for mask indexing */
+/* Must be power-of-two for mask indexing (and the DMA ring wrap) */
 #define RD03D_RX_RING_SIZE 256
 #endif
 
@@ -53,149 +54,350 @@
 #error "RD03D_RX_RING_SIZE must be a power-of-two"
 #endif
 
-static uint8_t  s_rx[RD03D_RX_RING_SIZE];
-static uint16_t s_head, s_tail;
+#define RB_MASK     (RD03D_RX_RING_SIZE - 1u)
 
-static rd03d_frame_t s_last_frame;
-static volatile bool s_frame_ready;
+#if RD03D_FRAME_SLOTS > SPSC_QUEUE_SIZE
+#error "RD03D_FRAME_SLOTS must fit the frame queues"
+#endif
 
-/* ---------- ring buffer helpers ---------- */
-static inline uint16_t rb_count(void)
-{
-    return (uint16_t)((s_head - s_tail) & (RD03D_RX_RING_SIZE - 1));
-}
+/* Ring positions are free-running byte counts: s_wr advanced by the DMA
+ * (or the UART drain), s_scan by the parser, s_rd the oldest byte still
+ * needed (start of the frame being parsed) */
+static uint8_t  s_rx[RD03D_RX_RING_SIZE] __attribute__((aligned(RD03D_RX_RING_SIZE)));
+static uint32_t s_wr, s_rd, s_scan;
+static bool     s_dma;
 
-static inline void rb_push(uint8_t b)
+/* parser state, header bytes matched; 4 = frame at s_rd waiting in the ring */
+static uint8_t  s_pos;
+
+static rd03d_frame_t s_frames[RD03D_FRAME_SLOTS];
+static spsc_queue_t  s_free;    // slots for the parser, refilled by rd03d_drv_get_frame()
+static spsc_queue_t  s_ready;   // parsed frames, oldest first
+static rd03d_drv_stats_t s_stats;
+
+static bool     rx_start(void);
+static uint32_t rx_dma_count(void);
+static void     rx_drain(void);
+
+static const uint8_t s_hdr[4] = { RD03D_HDR0, RD03D_HDR1, RD03D_HDR2, RD03D_HDR3 };
+
+/* ---------- RD-03D sign encoding decoder ----------
+ * Manual example indicates:
+ * - MSB=1 => positive, magnitude = raw - 0x8000
+ * - MSB=0 => negative, magnitude = raw & 0x7FFF, value = -magnitude
+ * See example decode on page 19 :contentReference[oaicite:3]{index=3}
+ */
+static inline int16_t rd03d_decode_signmag(uint16_t raw)
 {
-    s_rx[s_head] = b;
-    s_head = (uint16_t)((s_head + 1) & (RD03D_RX_RING_SIZE - 1));
-    /* Overrun policy: drop oldest */
-    if (s_head == s_tail)
-        s_tail = (uint16_t)((s_tail + 1) & (RD03D_RX_RING_SIZE - 1));
+    uint16_t mag = (uint16_t)(raw & 0x7FFF);
+    if (raw & 0x8000)
+        return (int16_t)mag;        /* positive */
+    return (int16_t)(-(int16_t)mag); /* negative */
 }
 
-static inline uint8_t rb_peek(uint16_t idx_from_tail)
+/* ---------- ring buffer helpers ---------- */
+static inline void parser_reset(void)
 {
-    uint16_t idx = (uint16_t)((s_tail + idx_from_tail) & (RD03D_RX_RING_SIZE - 1));
-    return s_rx[idx];
+    s_pos = 0;
 }
 
-static inline void rb_drop(uint16_t n)
+/* Overrun policy: drop oldest. The DMA keeps writing while we parse, so a
+ * frame's worth next to the write position is given up as well. */
+static inline void rb_clip(void)
 {
-    s_tail = (uint16_t)((s_tail + n) & (RD03D_RX_RING_SIZE - 1));
+    uint32_t keep = RD03D_RX_RING_SIZE - (s_dma ? RD03D_FRAME_BYTES : 0u);
+    uint32_t n = s_wr - s_rd;
+
+    if (n > keep) {
+        s_stats.overrun_bytes += n - keep;
+        s_rd = s_wr - keep;
+        if ((int32_t)(s_scan - s_rd) < 0) {
+            s_scan = s_rd;      // the frame being parsed lost its start
+            parser_reset();
+        }
+    }
 }
 
-static inline void rb_read_bytes(uint8_t *dst, uint16_t n)
+static inline void rb_push(uint8_t b)
 {
-    for (uint16_t i = 0; i < n; i++)
-        dst[i] = rb_peek(i);
-    rb_drop(n);
+    s_rx[s_wr & RB_MASK] = b;
+    s_wr++;
+    rb_clip();
 }
 
 /* ---------- UART init ---------- */
 bool rd03d_drv_init(void)
 {
-    uart_init(RD03D_UART, RD03D_BAUDRATE);
+    s_wr = s_rd = s_scan = 0;
+    parser_reset();
+    memset(&s_stats, 0, sizeof(s_stats));
 
-    gpio_set_function(RD03D_UART_TX_PIN, GPIO_FUNC_UART);
-    gpio_set_function(RD03D_UART_RX_PIN, GPIO_FUNC_UART);
-
-    uart_set_format(RD03D_UART, 8, 1, UART_PARITY_NONE);
-    uart_set_fifo_enabled(RD03D_UART, true);
+    spsc_init(&s_free);
+    spsc_init(&s_ready);
+    for (uint8_t i = 0; i < RD03D_FRAME_SLOTS; i++)
+        spsc_push(&s_free, i);
 
-    s_head = s_tail = 0;
-    s_frame_ready = false;
+    s_dma = rx_start();
+    s_stats.dma = s_dma;
     return true;
 }
 
-/* ---------- robust resync parser ---------- */
-static void try_parse_frames(void)
-{
-    /* Scan for header within current buffered bytes.
-     * We only commit when we can also validate the tail.
-     */
-    while (rb_count() >= RD03D_FRAME_BYTES)
-    {
-        /* Find the first candidate header position within the ring.
-         * Limit scan to (count - frame_bytes + 1) positions so a full frame can exist.
-         */
-        uint16_t count = rb_count();
-        uint16_t max_scan = (uint16_t)(count - RD03D_FRAME_BYTES + 1);
-
-        int found_at = -1;
-        for (uint16_t off = 0; off <= max_scan; off++)
-        {
-            if (rb_peek(off + 0) == RD03D_HDR0 &&
-                rb_peek(off + 1) == RD03D_HDR1 &&
-                rb_peek(off + 2) == RD03D_HDR2 &&
-                rb_peek(off + 3) == RD03D_HDR3)
-            {
-                found_at = (int)off;
+/* ---------- streaming parser ----------
+ * One pass over the new bytes. The header AA FF 03 00 is matched byte by
+ * byte as it arrives; the rest of the frame is left in the ring until all
+ * of it is there, then the tail 55 CC is checked and the payload decoded
+ * from the ring straight into a queue slot. Only a bad tail looks at bytes
+ * again: the scan restarts one byte after the false header, as the frame
+ * may begin inside it.
+ */
+static void decode_frame(rd03d_frame_t *f, uint32_t at)
+{
+    for (int i = 0; i < RD03D_OBJECT_SLOTS; i++, at += 8u) {
+        uint8_t b[8];
+
+        for (uint32_t k = 0; k < 8u; k++)
+            b[k] = s_rx[(at + k) & RB_MASK];
+        f->det[i].x_mm    = rd03d_decode_signmag((uint16_t)(b[0] | b[1] << 8));
+        f->det[i].y_mm    = rd03d_decode_signmag((uint16_t)(b[2] | b[3] << 8));
+        f->det[i].v_cms   = rd03d_decode_signmag((uint16_t)(b[4] | b[5] << 8));
+        f->det[i].dist_mm = (uint16_t)(b[6] | b[7] << 8);
+        f->det[i].present = (b[0] | b[1] | b[2] | b[3] | b[4] | b[5] | b[6] | b[7]) != 0;
+    }
+    f->rx_time_ms = (uint32_t)to_ms_since_boot(get_absolute_time());
+}
+
+static void parse_bytes(void)
+{
+    uint32_t scan = s_scan;
+    uint32_t wr = s_wr;
+    uint32_t rd = s_rd;
+    uint32_t pos = s_pos;
+    uint32_t parsed = 0, resync = 0;
+
+    s_stats.parses++;
+    while (scan != wr) {
+        if (pos == 0) {
+            /* hunting: skip to the next AA */
+            uint32_t from = scan;
+            while (scan != wr && s_rx[scan & RB_MASK] != RD03D_HDR0)
+                scan++;
+            parsed += scan - from;
+            resync += scan - from;
+            if (scan == wr)
                 break;
+            rd = scan++;
+            parsed++;
+            pos = 1;
+            continue;
+        }
+
+        if (pos < 4) {
+            uint8_t b = s_rx[scan & RB_MASK];
+
+            if (b == s_hdr[pos]) {
+                pos++;
+            } else if (b == RD03D_HDR0) {
+                resync += pos;
+                rd = scan;          // AA is not repeated in the header, restart here
+                pos = 1;
+            } else {
+                resync += pos + 1u;
+                pos = 0;
             }
+            scan++;
+            parsed++;
+            continue;
         }
 
-        if (found_at < 0)
-        {
-            /* No header found; keep last 3 bytes in case header splits across polls */
-            if (count > 3)
-                rb_drop((uint16_t)(count - 3));
-            return;
+        /* header at rd; the rest of the frame waits in the ring until complete */
+        uint8_t slot;
+        if (wr - rd < RD03D_FRAME_BYTES)
+            break;
+        if (s_rx[(rd + RD03D_FRAME_BYTES - 2u) & RB_MASK] != RD03D_TAIL0 ||
+            s_rx[(rd + RD03D_FRAME_BYTES - 1u) & RB_MASK] != RD03D_TAIL1) {
+            /* False header hit; rescan from the byte after it */
+            resync++;
+            scan = rd + 1u;
+            pos = 0;
+            continue;
         }
+        if (!spsc_pop(&s_free, &slot))
+            break;                  // all slots unread, the frame waits as well
+
+        decode_frame(&s_frames[slot], rd + 4u);
+        spsc_push(&s_ready, slot);
+        s_stats.frames++;
+        parsed += RD03D_FRAME_BYTES - 4u;
+        scan = rd + RD03D_FRAME_BYTES;
+        pos = 0;
+    }
+
+    /* hunting needs nothing behind the scan position */
+    s_rd = pos ? rd : scan;
+    s_scan = scan;
+    s_pos = (uint8_t)pos;
+    s_stats.parsed_bytes += parsed;
+    s_stats.resync_bytes += resync;
+}
 
-        /* Drop noise before header */
-        if (found_at > 0)
-            rb_drop((uint16_t)found_at);
+/**
+ * Collect received bytes and parse. With the DMA ring this is a register
+ * read when nothing arrived; the parser only runs on new bytes (or bytes
+ * left behind while every frame slot was unread).
+ */
+void rd03d_drv_poll(void)
+{
+    if (s_dma) {
+        s_wr = rx_dma_count();
+        rb_clip();
+    } else {
+        rx_drain();
+    }
 
-        /* Now tail check for the candidate frame */
-        if (rb_count() < RD03D_FRAME_BYTES)
-            return;
+    if (s_scan == s_wr)
+        return;
+    if (s_pos == 4 && (s_wr - s_rd < RD03D_FRAME_BYTES || !spsc_count(&s_free)))
+        return;
+    parse_bytes();
+}
 
-        uint8_t tail0 = rb_peek((uint16_t)(RD03D_FRAME_BYTES - 2));
-        uint8_t tail1 = rb_peek((uint16_t)(RD03D_FRAME_BYTES - 1));
-        if (tail0 != RD03D_TAIL0 || tail1 != RD03D_TAIL1)
-        {
-            /* False header hit; drop one byte and rescan */
-            rb_drop(1);
-            continue;
-        }
+bool rd03d_drv_get_frame(rd03d_frame_t *out)
+{
+    uint8_t i;
+
+    if (!out || !spsc_pop(&s_ready, &i))
+        return false;
+
+    *out = s_frames[i];
+    spsc_push(&s_free, i);
+    return true;
+}
 
-        /* Valid frame. Consume header+payload+tail and publish. */
-        uint8_t raw[RD03D_FRAME_BYTES];
-        rb_read_bytes(raw, RD03D_FRAME_BYTES);
+rd03d_drv_stats_t rd03d_drv_get_stats(void)
+{
+    return s_stats;
+}
 
-        /* raw[0..3] is header; payload starts at raw[4] */
-        const uint8_t *payload = &raw[4];
+#ifndef RD03D_DRV_HOST
+/* ---------- UART / DMA backend ---------- */
+#include "pico/stdlib.h"
+#include "hardware/uart.h"
+#include "hardware/gpio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
 
-        /* Copy into packed structure (byte exact) */
-        rd03d_report_raw_t report = {0};
-        for (uint32_t i = 0; i < RD03D_PAYLOAD_BYTES; i++)
-            ((uint8_t *)&report)[i] = payload[i];
+#define RD03D_DMA_CHUNK     (1u << 24)      // transfers per re-arm, ~11 min at line rate
 
-        s_last_frame.report = report;
-        s_last_frame.rx_time_ms = (uint32_t)to_ms_since_boot(get_absolute_time());
-        s_frame_ready = true;
+static int s_dma_ch = -1;
+static volatile uint32_t s_dma_base;        // bytes of the completed chunks
 
-        /* Stop after publishing one frame (keeps latency low and avoids starving main loop) */
+static void rx_dma_irq(void)
+{
+    if (s_dma_ch < 0 || !dma_channel_get_irq1_status((uint)s_dma_ch))
         return;
-    }
+    dma_channel_acknowledge_irq1((uint)s_dma_ch);
+    s_dma_base += RD03D_DMA_CHUNK;
+    dma_channel_set_trans_count((uint)s_dma_ch, RD03D_DMA_CHUNK, true);
 }
 
-void rd03d_drv_poll(void)
+/* bytes the DMA has written since init; the 32 byte UART FIFO covers the re-arm */
+static uint32_t rx_dma_count(void)
+{
+    uint32_t save = save_and_disable_interrupts();
+    uint32_t left = dma_channel_hw_addr((uint)s_dma_ch)->transfer_count & DMA_CH0_TRANS_COUNT_COUNT_BITS;
+    uint32_t n = s_dma_base + (RD03D_DMA_CHUNK - left);
+
+    restore_interrupts(save);
+    return n;
+}
+
+static void rx_drain(void)
 {
     while (uart_is_readable(RD03D_UART))
         rb_push((uint8_t)uart_getc(RD03D_UART));
 
-    try_parse_frames();
+    /* FIFO overrun: bytes were lost before we got here */
+    if (uart_get_hw(RD03D_UART)->rsr & UART_UARTRSR_OE_BITS) {
+        uart_get_hw(RD03D_UART)->rsr = 0;      // any write clears the error bits
+        s_stats.fifo_overruns++;
+    }
 }
 
-bool rd03d_drv_get_frame(rd03d_frame_t *out)
+/**
+ * UART RX into s_rx by DMA, the write address wrapping on the ring size.
+ * The UART DREQ drains the FIFO byte by byte, so its receive timeout
+ * interrupt never fires; rd03d_drv_poll() reads the DMA count instead.
+ * Without a free channel the FIFO is drained by rd03d_drv_poll().
+ */
+static bool rx_start(void)
 {
-    if (!out || !s_frame_ready)
+    uart_init(RD03D_UART, RD03D_BAUDRATE);
+
+    gpio_set_function(RD03D_UART_TX_PIN, GPIO_FUNC_UART);
+    gpio_set_function(RD03D_UART_RX_PIN, GPIO_FUNC_UART);
+
+    uart_set_format(RD03D_UART, 8, 1, UART_PARITY_NONE);
+    uart_set_fifo_enabled(RD03D_UART, true);
+
+#ifdef RD03D_UART_DMA
+    if (s_dma_ch < 0)
+        s_dma_ch = dma_claim_unused_channel(false);
+    if (s_dma_ch < 0)
         return false;
 
-    *out = s_last_frame;
-    s_frame_ready = false;
+    uint ch = (uint)s_dma_ch;
+    dma_channel_config c = dma_channel_get_default_config(ch);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, (uint)__builtin_ctz(RD03D_RX_RING_SIZE));
+    channel_config_set_dreq(&c, uart_get_dreq_num(RD03D_UART, false));
+
+    s_dma_base = 0;
+    irq_add_shared_handler(DMA_IRQ_1, rx_dma_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    dma_channel_set_irq1_enabled(ch, true);
+    irq_set_enabled(DMA_IRQ_1, true);
+
+    dma_channel_configure(ch, &c, s_rx, &uart_get_hw(RD03D_UART)->dr, RD03D_DMA_CHUNK, true);
     return true;
+#else
+    return false;
+#endif // RD03D_UART_DMA
+}
+
+#else
+/* ---------- host model (tools/pattern_render/rd03d_rx_sim) ---------- */
+static bool s_host_dma;
+static uint32_t s_host_count;
+
+void rd03d_drv_host_mode(bool dma)
+{
+    s_host_dma = dma;
 }
 
+void rd03d_drv_host_dma_rx(uint8_t b)
+{
+    s_rx[s_host_count & RB_MASK] = b;
+    s_host_count++;
+}
+
+static bool rx_start(void)
+{
+    s_host_count = 0;
+    return s_host_dma;
+}
+
+static uint32_t rx_dma_count(void)
+{
+    return s_host_count;
+}
+
+static void rx_drain(void)
+{
+    uint8_t b;
+
+    while (rd03d_host_uart_getc(&b))
+        rb_push(b);
+}
+#endif // RD03D_DRV_HOST
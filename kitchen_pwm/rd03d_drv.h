@@ -50,6 +50,7 @@ typedef struct __attribute__((packed))
     uint16_t dist_mm; /* already uint16 in mm */
 } rd03d_object_raw_t;
 
+/* wire format of the report payload, decoded by the parser as it arrives */
 typedef struct __attribute__((packed))
 {
     rd03d_object_raw_t obj[RD03D_OBJECT_SLOTS];
@@ -57,10 +58,25 @@ typedef struct __attribute__((packed))
 
 typedef struct
 {
-    rd03d_report_raw_t report;
-    uint32_t           rx_time_ms;
+    bool     present;        /* slot not all zero */
+    int16_t  x_mm;
+    int16_t  y_mm;
+    int16_t  v_cms;
+    uint16_t dist_mm;
+} rd03d_det_t;
+
+typedef struct
+{
+    rd03d_det_t det[RD03D_OBJECT_SLOTS];
+    uint32_t    rx_time_ms;
 } rd03d_frame_t;
 
+/* frames parsed and not fetched yet, rd03d_drv_poll() leaves the bytes in
+ * the ring while all slots are taken (max SPSC_QUEUE_SIZE) */
+#ifndef RD03D_FRAME_SLOTS
+#define RD03D_FRAME_SLOTS 4
+#endif
+
 
 /* Hardware + driver init */
 bool rd03d_drv_init(void);
@@ -68,9 +84,30 @@ bool rd03d_drv_init(void);
 /* Poll UART and assemble frames */
 void rd03d_drv_poll(void);
 
-/* Non-blocking frame fetch */
+/* Non-blocking frame fetch, oldest first */
 bool rd03d_drv_get_frame(rd03d_frame_t *out);
 
+typedef struct
+{
+    bool     dma;            /* UART RX by DMA ring (RD03D_UART_DMA), else FIFO polling */
+    uint32_t frames;         /* frames published */
+    uint32_t parses;         /* parser runs (new bytes only) */
+    uint32_t parsed_bytes;   /* bytes through the parser, rescans included */
+    uint32_t overrun_bytes;  /* ring overrun, oldest bytes dropped */
+    uint32_t resync_bytes;   /* noise / broken frames skipped */
+    uint32_t fifo_overruns;  /* UART FIFO overflowed between polls (FIFO mode) */
+} rd03d_drv_stats_t;
+
+rd03d_drv_stats_t rd03d_drv_get_stats(void);
+
+#ifdef RD03D_DRV_HOST
+/* host model: receive path chosen before rd03d_drv_init(), bytes come in
+ * through the "DMA" or the tool's UART FIFO model */
+void rd03d_drv_host_mode(bool dma);
+void rd03d_drv_host_dma_rx(uint8_t b);
+bool rd03d_host_uart_getc(uint8_t *b);     /* provided by the tool */
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -17,55 +17,21 @@
 #include "pico/bootrom.h"
 #include "telnet.h"
 #include "config.h"
-#include "partition.h"
-#include "flash_cfg.h"
-#include "utility.h"
-#include "efu_update.h"
 #include "vl53_diag.h"
+#include "vl53l8cx_drv.h"
+#include "vl53_scene.h"
 #include "pwm_api.h"
+#include "pwm_fixture.h"
+#include "pwm_timeline.h"
+#include "presence.h"
+#include "occupancy.h"
+#include "rd03d_drv.h"
+#include "rd03d_cli.h"
 #include "tcp_cli.h"
+#include "cli_cmd.h"
+#include "cli_sys.h"
 #include "network.h"
 
-// This help has 790 bytes
-const char *help_msg =
-"\r\n"
-"========================================\r\n"
-"   WIZnet RP2350 Remote CLI Interface   \r\n"
-"========================================\r\n"
-"\r\n"
-"Available commands:\r\n"
-"  help   \t\t\t- Show this help menu\r\n"
-"  info   \t\t\t- Display board and firmware information\r\n"
-"  set [p]\t\t\t- Set active LED/pattern index to value [p]\r\n"
-"  get    \t\t\t- Get current pattern index\r\n"
-"  time   \t\t\t- Show timing statistics (min/max execution)\r\n"
-"  status \t\t\t- Show system analog and digital state\r\n"
-"  on     \t\t\t- Enable outputs\r\n"
-"  off    \t\t\t- Disable outputs\r\n"
-"  load   \t\t\t- Load config from flash - for debug\r\n"
-"  save   \t\t\t- Save config to flash\r\n"
-"  show   \t\t\t- Show config values\r\n"
-"  rgb <r> <g> <b> \t\t- Set color LEDs\r\n"
-"  max <value> \t\t- Show config values\r\n"
-"  part   \t\t\t- Show partition information\r\n"
-"  config ip <a.b.c.d>  \t- Set IP address\r\n"
-"  config sn <a.b.c.d>  \t- Set Subnet Mask\r\n"
-"  config gw <a.b.c.d>  \t- Set Gateway\r\n"
-"  config dns <a.b.c.d> \t- Set DNS server\r\n"
-"  config save          \t- Save current config to flash\r\n"
-"  config show          \t- Show current config values\r\n"
-"  config clean         \t- Clean current config (use default)\r\n"
-"  config default       \t- Restore factory default configuration\r\n"
-"  exit   \t\t\t- Close the CLI connection\r\n"
-"\r\n"
-"Examples:\r\n"
-"  > set 3\r\n"
-"  > get\r\n"
-"  > time\r\n"
-"\r\n"
-"Type 'help' anytime to show this menu.\r\n"
-"========================================\r\n";
-
 const char *cli_greeting =
 "\r\n"
 "========================================\r\n"
@@ -78,10 +44,6 @@ const char *cli_greeting =
 
 // #define TELNET_PROMPT  "> "
 
-// --- global variables for CLI ---
-// CLI variables
-uint8_t cli_buf_rx[CLI_BUF_RX_SIZE];
-
 
 void telnet_greeting(uint8_t sn, const uint8_t *client_ip) {
     char msg[256];
@@ -92,513 +54,589 @@ void telnet_greeting(uint8_t sn, const uint8_t *client_ip) {
     cli_flush(sn, msg);  // (uint8_t*)  , strlen(msg)
 }
 
-// static bool parse_ipv4(const char *s, uint8_t out[4]) {
-//     int a, b, c, d;
-//     if (sscanf(s, "%d.%d.%d.%d", &a, &b, &c, &d) != 4)
-//         return false;
-//     if ((a|b|c|d) & ~0xFF)
-//         return false;
-//     out[0] = (uint8_t)a;
-//     out[1] = (uint8_t)b;
-//     out[2] = (uint8_t)c;
-//     out[3] = (uint8_t)d;
-//     return true;
-// }
-
-void cmd_config_show(uint8_t sn) {
-        char msg[200];     // current use ??? bytes
-        config_t *config = NULL;
-        int len;
-        uint8_t id = 0;
-
-        config = config_get(id);
-        // snprintf(msg, sizeof(msg), "Config [0]\r\n");
-        // cli_send(sn, (uint8_t *)msg, strlen(msg));
-        len = config_show( config, id, msg, sizeof(msg));   // sending > 102 bytes
-        printf("Telnet sent %d bytes to console for config[0]\r\n", len);
-        cli_send(sn, msg); // , (uint16_t)strlen(msg));
-
-        config = config_get(++id);
-        // snprintf(msg, sizeof(msg), "Config [1]\r\n");
-        // cli_send(sn, (uint8_t *)msg); // , strlen(msg));
-        len = config_show( config, id, msg, sizeof(msg));   // sending > 102 bytes
-        printf("Telnet sent %d bytes to console for config[1]\r\n", len);
-        cli_send(sn, msg); // , (uint16_t)strlen(msg));
-
-        config = config_get(++id);
-        // snprintf(msg, sizeof(msg), "Config [2]\r\n");
-        // cli_send(sn, (uint8_t *)msg, strlen(msg));
-        len = config_show( config, id, msg, sizeof(msg));   // sending > 102 bytes
-        printf("Telnet sent %d bytes to console for config[2]\r\n", len);
-
-        cli_flush(sn, msg);
+/* ---------- light ---------- */
+static bool cmd_rgbw(const cli_ctx_t *ctx)
+{
+    uint32_t v[4];
+    char msg[64];
+
+    if (!cli_args_u32(ctx->argv, 4, 0, 1023, v))
+        return false;
+    pwm_rgbw_set((rgbw16_t){
+        .r = (uint16_t)v[0],
+        .g = (uint16_t)v[1],
+        .b = (uint16_t)v[2],
+        .w = (uint16_t)v[3],
+    });
+    snprintf(msg, sizeof(msg), "RGBW set to %u %u %u %u\r\n", v[0], v[1], v[2], v[3]);
+    cli_flush(ctx->sn, msg);
+    return true;
 }
-void cmd_config_save(uint8_t sn) {
-        bool ret;
-        char msg[30];
-        config_t *config = config_get(1);
 
-        ret = config_save(config);
-        snprintf(msg, sizeof(msg),
-                "Config saved to flash: %d\r\n", ret);
-        cli_flush(sn, msg);
-}
-void cmd_config_set_ip(uint8_t *ip) {
-        config_t *config = config_get(1);
-        memcpy(config->net_info.ip, ip, 4);
-}
-void cmd_config_set_sn(uint8_t *snm) {
-        config_t *config = config_get(1);
-        memcpy(config->net_info.sn, snm, 4);
+static bool cmd_led(const cli_ctx_t *ctx)
+{
+    uint32_t w;
+    char msg[64];
+
+    if (!cli_arg_u32(ctx->argv[0], 0, LINEAR_MAX, &w))
+        return false;
+    pwm_led_set((uint16_t)w);
+    snprintf(msg, sizeof(msg), "Set white led to %u\r\n", w);
+    cli_flush(ctx->sn, msg);
+    return true;
 }
-void cmd_config_set_gw(uint8_t *gw) {
-        config_t *config = config_get(1);
-        memcpy(config->net_info.gw, gw, 4);
+
+static bool cmd_fade(const cli_ctx_t *ctx)
+{
+    uint32_t v[4], ms;
+    char msg[64];
+
+    if (!cli_args_u32(ctx->argv, 4, 0, 1023, v) || !cli_arg_u32(ctx->argv[4], 0, 32000, &ms))
+        return false;
+    pwm_rgbw_fade_to((rgbw16_t){
+        .r = (uint16_t)v[0],
+        .g = (uint16_t)v[1],
+        .b = (uint16_t)v[2],
+        .w = (uint16_t)v[3],
+    }, ms);
+    snprintf(msg, sizeof(msg), "Fade set to %u %u %u %u\r\n", v[0], v[1], v[2], v[3]);
+    cli_flush(ctx->sn, msg);
+    return true;
 }
-void cmd_config_set_dns(uint8_t *dns) {
-        config_t *config = config_get(1);
-        memcpy(config->net_info.dns, dns, 4);
+
+static bool cmd_rgb(const cli_ctx_t *ctx)
+{
+    uint32_t v[3];
+    char msg[64];
+
+    if (!cli_args_u32(ctx->argv, 3, 0, 255, v))
+        return false;
+    // set_rgb(r, g, b);
+    snprintf(msg, sizeof(msg), "RGB set to %u %u %u\r\n", v[0], v[1], v[2]);
+    cli_flush(ctx->sn, msg);
+    return true;
 }
 
- void handle_command(const char *cmd, uint8_t sn) {
-    // int sn = TCP_CLI_SOCKET;
+static bool cmd_freq(const cli_ctx_t *ctx)
+{
+    uint32_t val;
+    char msg[64];
+
+    if (!cli_arg_u32(ctx->argv[0], 50, 20000, &val))
+        return false;
+    pwm_rgbw_reconfigure(val);
+    snprintf(msg, sizeof(msg), "Reconfigure PWM frequency to %u\r\n", val);
+    cli_flush(ctx->sn, msg);
+    return true;
+}
 
-    if (strcmp(cmd, "help") == 0) {
-        cli_flush(sn, help_msg);
-    }
-    else if (strcmp(cmd, "info") == 0) {
-        // const char *msg = "Board: RP2350\r\nFW: 1.0.4\r\n";
-        char msg[80];
-        static const char * const efu_status_table[]= {
-            "UNKNOWN",          // 0
-            "SOCK_CLOSED",      // 1
-            "SOCK_INIT",        // 2
-            "SOCK_LISTEN",      // 3
-            "SOCK_ESTABLISHED", // 4
-            "SOCK_CLOSE_WAIT"   // 5
-    };
-        const char *efu_stat_msg = efu_status_table[0];
-
-        uint8_t efu_status = get_efu_socket_status();
-        switch(efu_status) {
-            case SOCK_CLOSED:
-                efu_stat_msg = efu_status_table[1];
-                break;
-            case SOCK_INIT:
-                efu_stat_msg = efu_status_table[2];
-                break;
-            case SOCK_LISTEN:       // after listen(TCP_EFU_SOCKET)
-                efu_stat_msg = efu_status_table[3];
-                break;
-            case SOCK_ESTABLISHED:
-                efu_stat_msg = efu_status_table[4];
-                break;
-            case SOCK_CLOSE_WAIT:
-                efu_stat_msg = efu_status_table[5];
-                break;
-        }
+/* tl: timeline state, tl <ease> <ms> <r> <g> <b> <w>: queue a segment */
+static bool cmd_tl(const cli_ctx_t *ctx)
+{
+    char msg[96];
 
-        snprintf(msg, sizeof(msg),
-            "Project : stairs_ws2815\r\n"
-            "FW      : %s\r\n"
-            "EFU stat: 0x%x (%s)\r\n",
-            FW_VERSION, efu_status, efu_stat_msg);
+    if (ctx->argc == 0) {
+        pwm_rgbw_status_t st = pwm_rgbw_get_status();
 
-        cli_flush(sn, msg);
-        // read_boot_info();
-    }
-    else if (strcmp(cmd, "part") == 0) {
-        char msg[800];     // current use 407 bytes
-        int len = partition_info(msg, sizeof(msg));
-        printf("Telnet sent %d bytes to console\r\n", len);
-        cli_flush(sn, msg);
+        snprintf(msg, sizeof(msg), "Timeline: %u segments, loop %s\r\n",
+                st.tl_segments, st.tl_loop ? "on" : "off");
+        cli_flush(ctx->sn, msg);
+        return true;
     }
 
+    int ease = pwm_ease_from_name(ctx->argv[0]);
+    uint32_t ms, v[4];
 
-    else if (strncmp(cmd, "rgbw", 4) == 0) {
-        uint16_t r, g, b, w;
-
-        // Skip "rgbw" and parse four integers
-        if (sscanf(cmd + 4, "%u %u %u %u", &r, &g, &b, &w) == 4 &&
-            r <= 1023 && g <= 1023 && b <= 1023 && w <= 1023) 
-        {
-            char msg[64];
-            pwm_rgbw_set((rgbw16_t){
-                .r = r,
-                .g = g,
-                .b = b,
-                .w = w,
-            });
-
-            snprintf(msg, sizeof(msg),
-                    "RGBW set to %u %u %u %u\r\n", r, g, b, w);
-            cli_flush(sn, msg);
-        } 
-        else {
-            const char *err =
-                "Usage: rgbw <r> <g> <b> <w>\r\n"
-                "Each value must be 0–1023.\r\n";
-            cli_flush(sn, err);
-        }
-    }
+    if (ctx->argc != 6 || ease < 0 || ease == PWM_EASE_HOLD ||
+        !cli_arg_u32(ctx->argv[1], 0, UINT32_MAX, &ms) || !cli_args_u32(ctx->argv + 2, 4, 0, LINEAR_MAX, v))
+        return false;
 
-    
-    else if (strncmp(cmd, "led", 3) == 0) {
-        uint16_t w;
-
-        // Skip "rgbw" and parse four integers
-        if (sscanf(cmd + 3, "%u", &w) == 1 &&
-            w <= LINEAR_MAX) 
-        {
-            char msg[64];
-            pwm_led_set(w);
-
-            snprintf(msg, sizeof(msg),
-                    "Set white led to %u\r\n", w);
-            cli_flush(sn, msg);
-        } 
-        else {
-            char err[64];
-            // const char *err =
-            //     "Usage: led <w>\r\n"
-            //     "Each value must be 0–1023.\r\n";
-            snprintf(err, sizeof(err),
-                    "Usage: led <w>\r\nEach value must be 0–%u.\r\n", LINEAR_MAX);
-            cli_flush(sn, err);
-        }
-    }
+    bool ok = pwm_rgbw_tl_add((rgbw16_t){
+        .r = (uint16_t)v[0],
+        .g = (uint16_t)v[1],
+        .b = (uint16_t)v[2],
+        .w = (uint16_t)v[3],
+    }, ms, (uint8_t)ease);
 
+    snprintf(msg, sizeof(msg), ok ? "Timeline: %s %u ms to %u %u %u %u\r\n" : "Timeline full\r\n",
+            ctx->argv[0], ms, v[0], v[1], v[2], v[3]);
+    cli_flush(ctx->sn, msg);
+    return true;
+}
 
-    else if (strncmp(cmd, "fade", 4) == 0) {
-        uint16_t r, g, b, w, ms;
-
-        // Skip "fade" and parse four integers
-        if (sscanf(cmd + 4, "%u %u %u %u %u", &r, &g, &b, &w, &ms) == 5 &&
-            r <= 1023 && g <= 1023 && b <= 1023 && w <= 1023 && ms <= 32000) 
-        {
-            char msg[64];
-
-        // pwm_rgbw_fade_to((rgbw16_t){
-        //     .r = scale8_to_wrap((uint8_t)clamp_u16(r,0,255)),
-        //     .g = scale8_to_wrap((uint8_t)clamp_u16(g,0,255)),
-        //     .b = scale8_to_wrap((uint8_t)clamp_u16(b,0,255)),
-        //     .w = scale8_to_wrap((uint8_t)clamp_u16(w,0,255)),
-        // }, ms);
-
-            // pwm_rgbw_set((rgbw16_t){
-            pwm_rgbw_fade_to((rgbw16_t){
-                .r = r,
-                .g = g,
-                .b = b,
-                .w = w,
-            }, ms);
-
-            snprintf(msg, sizeof(msg),
-                    "Fade set to %u %u %u %u\r\n", r, g, b, w);
-            cli_flush(sn, msg);
-        } 
-        else {
-            const char *err =
-                "Usage: fade <r> <g> <b> <w> <ms>\r\n"
-                "Each r g b w value must be 0–1023 and time must be 0–65535.\r\n";
-            cli_flush(sn, err);
-        }
-    }
+static bool cmd_tl_hold(const cli_ctx_t *ctx)
+{
+    uint32_t ms;
 
+    if (!cli_arg_u32(ctx->argv[0], 0, UINT32_MAX, &ms))
+        return false;
+    cli_flush(ctx->sn, pwm_rgbw_tl_hold(ms) ? "Timeline: hold\r\n" : "Timeline full\r\n");
+    return true;
+}
 
-    else if (strncmp(cmd, "rgb", 3) == 0) {
-        uint32_t r, g, b;
-
-        // Skip "rgb" and parse three integers
-        if (sscanf(cmd + 3, "%u %u %u", &r, &g, &b) == 3 &&
-            r <= 255 && g <= 255 && b <= 255) 
-        {
-            char msg[64];
-            // Example: your function to apply RGB globally or per pattern
-            // set_global_rgb((uint8_t)r, (uint8_t)g, (uint8_t)b);
-            // set_rgb(r, g, b);
-
-            snprintf(msg, sizeof(msg),
-                    "RGB set to %u %u %u\r\n", r, g, b);
-            cli_flush(sn, msg);
-        } 
-        else {
-            const char *err =
-                "Usage: rgb <r> <g> <b>\r\n"
-                "Each value must be 0–255.\r\n";
-            cli_flush(sn, err);
-        }
-    }
-    else if (strncmp(cmd, "freq", 4) == 0) {
-        uint32_t val;
+static bool cmd_tl_loop(const cli_ctx_t *ctx)
+{
+    uint32_t on;
 
-        // Parse a single unsigned integer after "freq"
-        if (sscanf(cmd + 4, "%u", &val) == 1 && val >= 50 && val <= 20000) {
-            char msg[64];
+    if (!cli_arg_u32(ctx->argv[0], 0, 1, &on))
+        return false;
+    pwm_rgbw_tl_loop(on != 0);
+    cli_flush(ctx->sn, on ? "Timeline: loop on\r\n" : "Timeline: loop off\r\n");
+    return true;
+}
 
-            // Example: apply the parameter in your firmware
-            // set_max_value((uint16_t)val);
-            // set_max_led(val);
-            pwm_rgbw_reconfigure(val);
+static bool cmd_tl_clear(const cli_ctx_t *ctx)
+{
+    pwm_rgbw_tl_clear();
+    cli_flush(ctx->sn, "Timeline cleared\r\n");
+    return true;
+}
 
-            snprintf(msg, sizeof(msg),
-                    "Reconfigure PWM frequency to %u\r\n", val);
-            cli_flush(sn, msg);
-        }
-        else {
-            char *err =
-                "Usage: freq <value>\r\n"
-                "Value must be 50–20000.\r\n";
-            cli_flush(sn, err);
-        }
+/* fx: list the fixtures, fx <n> <r> <g> <b> <w>: set one */
+static bool cmd_fx(const cli_ctx_t *ctx)
+{
+    char msg[96];
+
+    if (ctx->argc == 5) {
+        uint32_t fx, v[4];
+
+        if (!cli_arg_u32(ctx->argv[0], 0, UINT8_MAX, &fx) || !cli_args_u32(ctx->argv + 1, 4, 0, LINEAR_MAX, v))
+            return false;
+        bool ok = pwm_rgbw_set_fixture((uint8_t)fx, (rgbw16_t){
+            .r = (uint16_t)v[0],
+            .g = (uint16_t)v[1],
+            .b = (uint16_t)v[2],
+            .w = (uint16_t)v[3],
+        });
+        snprintf(msg, sizeof(msg), ok ? "Fixture %u set to %u %u %u %u\r\n" : "No fixture %u\r\n",
+                fx, v[0], v[1], v[2], v[3]);
+        cli_flush(ctx->sn, msg);
+        return true;
     }
-    else if (strncmp(cmd, "pwm status", 10) == 0) {
-        char msg[180];
+    if (ctx->argc != 0)
+        return false;
 
-        pwm_rgbw_status_t st = pwm_rgbw_get_status();
-            /* printf or socket write:
-               current/target/brightness/fading/fade_remaining_ms */
+    for (uint8_t i = 0; i < pwm_fixture_count(); i++) {
+        const pwm_fixture_t *f = pwm_fixture_get(i);
+        rgbw16_t cur;
 
+        pwm_rgbw_get_fixture(i, &cur, NULL);
         snprintf(msg, sizeof(msg),
-                    "PWM Status:\r\n"
-                    " Current RGBW: %u %u %u %u\r\n"
-                    " Target  RGBW: %u %u %u %u\r\n"
-                    " Brightness   : %u\r\n"
-                    " Fading       : %s\r\n"
-                    " Fade Remain ms: %u\r\n",
-                    st.current.r, st.current.g, st.current.b, st.current.w,
-                    st.target.r, st.target.g, st.target.b, st.target.w,
-                    st.brightness,
-                    st.fading ? "Yes" : "No",
-                    st.fade_remaining_ms
-                );
-        cli_flush(sn, msg);
+                "%u %-8s pins %d %d %d %d  gamma %u.%u  pixel %u  rgbw %u %u %u %u\r\n",
+                i, f->name, f->pin[0], f->pin[1], f->pin[2], f->pin[3],
+                f->gamma_x10 / 10u, f->gamma_x10 % 10u, f->ddp_pixel,
+                cur.r, cur.g, cur.b, cur.w);
+        cli_flush(ctx->sn, msg);
     }
+    return true;
+}
 
+static bool cmd_ddp_fmt(const cli_ctx_t *ctx)
+{
+    static const char *const fmt_names[] = { "rgbw8", "rgb8", "rgbw16le", "tl" };
+    pwm_rgbw_ddp_cfg_t cfg = pwm_rgbw_ddp_get_config();
+    int fmt = cli_arg_enum(ctx->argv[0], fmt_names, (uint8_t)count_of(fmt_names));
+    char msg[64];
+
+    if (fmt < 0)
+        return false;
+    cfg.fmt = (ddp_rgbw_format_t)fmt;
+    pwm_rgbw_ddp_config(&cfg);
+    snprintf(msg, sizeof(msg), "DDP format set to %s\r\n", fmt_names[fmt]);
+    cli_flush(ctx->sn, msg);
+    return true;
+}
 
-    // else if (strncmp(cmd, "max", 3) == 0) {
-    //     uint32_t val;
-
-    //     // Parse a single unsigned integer after "max"
-    //     if (sscanf(cmd + 3, "%u", &val) == 1 && val <= 65535) {
-    //         char msg[64];
-
-    //         // Example: apply the parameter in your firmware
-    //         // set_max_value((uint16_t)val);
-    //         // set_max_led(val);
-
-    //         snprintf(msg, sizeof(msg),
-    //                 "Max value set to %u\r\n", val);
-    //         cli_flush(sn, msg);
-    //     }
-    //     else {
-    //         const char *err =
-    //             "Usage: max <value>\r\n"
-    //             "Value must be 0–65535.\r\n";
-    //         cli_flush(sn, err);
-    //     }
-    // }
-    else if (strncmp(cmd, "set", 3) == 0) {
-        int pattern = -1;
-        uint8_t ret_pattern = 0;
-
-        if (strlen(cmd) < 4) {
-            char msg[64];
-            // switch off LEDs
-            ret_pattern = 0;    // set_pattern_index(0);
-            snprintf(msg, sizeof(msg),
-                    "Pattern index set to %d\r\n", ret_pattern);
-            cli_flush(sn, msg);
-        }
-        else if (sscanf(cmd + 3, "%d", &pattern) == 1 && pattern >= 0) {
-            char msg[64];
-
-            ret_pattern = 0;    // set_pattern_index((uint8_t)pattern);
-            snprintf(msg, sizeof(msg),
-                    "Pattern index set to %d\r\n", ret_pattern);
-            cli_flush(sn, msg);
-        } else {
-            // ❌ parameter missing or invalid
-            char *err = "Usage: set [p]\r\nExample: set 3\r\n";
-            cli_flush(sn, err);
-        }
-    }
-    // else if (strcmp(cmd, "on") == 0) {
-    //     char msg[32];
-    //     gpio_put(OE_PIN, OE_ON);
-    //     snprintf(msg, sizeof(msg),
-    //                 "Enable outputs\r\n");
-    //         cli_flush(sn, msg);
-    // }
-    // else if (strcmp(cmd, "off") == 0) {
-    //     char msg[32];
-    //     gpio_put(OE_PIN, OE_OFF);
-    //     snprintf(msg, sizeof(msg),
-    //                 "Disable outputs\r\n");
-    //         cli_flush(sn, msg);
-    // }
-
-
-    else if (strcmp(cmd, "get") == 0) {
-        uint8_t ret_pattern;
-        char msg[64];
-
-        ret_pattern = 0; // get_pattern_index();
+static bool cmd_pwm_status(const cli_ctx_t *ctx)
+{
+    char msg[200];
+    pwm_rgbw_status_t st = pwm_rgbw_get_status();
+
+    snprintf(msg, sizeof(msg),
+                "PWM Status:\r\n"
+                " Current RGBW: %u %u %u %u\r\n"
+                " Target  RGBW: %u %u %u %u\r\n"
+                " Brightness   : %u\r\n"
+                " Fading       : %s\r\n"
+                " Fade Remain ms: %u\r\n"
+                " Fixtures     : %u (RGBW of fixture 0)\r\n",
+                st.current.r, st.current.g, st.current.b, st.current.w,
+                st.target.r, st.target.g, st.target.b, st.target.w,
+                st.brightness,
+                st.fading ? "Yes" : "No",
+                st.fade_remaining_ms,
+                st.fixtures
+            );
+    cli_flush(ctx->sn, msg);
+    return true;
+}
 
-        snprintf(msg, sizeof(msg),
-                "Pattern index: %d\r\n", ret_pattern);
-        cli_flush(sn, msg);
-    }
+/* set [p]: pattern index, none here yet */
+static bool cmd_set(const cli_ctx_t *ctx)
+{
+    uint32_t pattern = 0;
+    char msg[64];
+
+    if (ctx->argc && !cli_arg_u32(ctx->argv[0], 0, INT32_MAX, &pattern))
+        return false;
+    snprintf(msg, sizeof(msg), "Pattern index set to %d\r\n", 0);     // set_pattern_index((uint8_t)pattern);
+    cli_flush(ctx->sn, msg);
+    return true;
+}
 
-    
-    else if (strcmp(cmd, "vl53 gpio") == 0) {
-        vl53_diag_print_gpio(sn);
-    }
-    else if (strcmp(cmd, "vl53 spi") == 0) {
-        #ifdef VL53_SPI
-        vl53_diag_print_spi1(sn);
-        #endif // VL53_SPI
-    }
-    else if (strcmp(cmd, "vl53 probe") == 0) {
-        vl53_diag_probe_bus(sn);
-    }
-    else if (strcmp(cmd, "vl53 raw") == 0) {
-        #ifdef VL53_SPI
-        vl53_diag_raw_spi_test(sn);
-        #endif
-    }
-    else if (strcmp(cmd, "vl53 read") == 0) {
-        vl53_diag_read_one(sn);
-    }
-    else if (strcmp(cmd, "vl53 start") == 0) {
-        vl53_diag_start_ranging(sn);
-    }
+static bool cmd_get(const cli_ctx_t *ctx)
+{
+    char msg[64];
 
+    snprintf(msg, sizeof(msg), "Pattern index: %d\r\n", 0);          // get_pattern_index();
+    cli_flush(ctx->sn, msg);
+    return true;
+}
 
-    else if (strcmp(cmd, "cson") == 0) {
-        vl53_diag_cs_active(sn);
-    }
-    else if (strcmp(cmd, "csoff") == 0) {
-        vl53_diag_cs_inactive(sn);
+/* ---------- presence automation ---------- */
+static void auto_show(uint8_t sn)
+{
+    static const char *const phase_names[] = { "idle", "on", "hold" };
+    const presence_rules_t *r = presence_rules();
+    presence_status_t st = presence_get_status();
+    char msg[160];
+
+    snprintf(msg, sizeof(msg),
+            "Auto %s: %s, zone %u, y %d mm, hold %u ms, fade %u/%u ms, %u actions\r\n",
+            r->enabled ? "on" : "off", phase_names[st.phase], st.zone, st.y_mm,
+            r->hold_ms, r->on_fade_ms, r->off_fade_ms, st.actions);
+    cli_flush(sn, msg);
+    for (uint8_t i = 0; i < r->zone_count; i++) {
+        snprintf(msg, sizeof(msg), " zone %u: y <= %u mm, brightness %u\r\n",
+                i, r->zone[i].y_max_mm, r->zone[i].brightness);
+        cli_flush(sn, msg);
     }
+}
 
+static bool cmd_auto(const cli_ctx_t *ctx)
+{
+    auto_show(ctx->sn);
+    return true;
+}
 
+static bool cmd_auto_on(const cli_ctx_t *ctx)
+{
+    presence_rules()->enabled = true;
+    presence_rules_apply();
+    auto_show(ctx->sn);
+    return true;
+}
 
-    else if (strncmp(cmd, "config", 6) == 0) {
-        const char *p = cmd + 6;
-        while (*p == ' ') p++;
+static bool cmd_auto_off(const cli_ctx_t *ctx)
+{
+    presence_rules()->enabled = false;
+    presence_rules_apply();
+    auto_show(ctx->sn);
+    return true;
+}
 
-        if (*p == '\0') {
-            cli_flush(sn, "Usage: config <ip|sn|gw|dns|save|show|clean|default> ...\r\n");
-            return;
-        }
+static bool cmd_auto_hold(const cli_ctx_t *ctx)
+{
+    uint32_t ms;
 
-        /* --- config ip <a.b.c.d> --- */
-        if (strncmp(p, "ip", 2) == 0 && (p[2] == ' ')) {
-            uint8_t ip[4];
-            const char *arg = p + 3;
-            while (*arg == ' ') arg++;
-            if (parse_ipv4(arg, ip)) {
-                cmd_config_set_ip(ip);
-                cli_flush(sn, "IP updated\r\n");
-            } else {
-                cli_flush(sn, "Invalid IP format\r\n");
-            }
-        }
+    if (!cli_arg_u32(ctx->argv[0], 0, UINT32_MAX, &ms))
+        return false;
+    presence_rules()->hold_ms = ms;
+    presence_rules_apply();
+    auto_show(ctx->sn);
+    return true;
+}
 
-        /* --- config sn <mask> --- */
-        else if (strncmp(p, "sn", 2) == 0 && (p[2] == ' ')) {
-            uint8_t snm[4];
-            const char *arg = p + 3;
-            while (*arg == ' ') arg++;
-            if (parse_ipv4(arg, snm)) {
-                cmd_config_set_sn(snm);
-                cli_flush(sn, "Subnet mask updated\r\n");
-            } else {
-                cli_flush(sn, "Invalid subnet mask\r\n");
-            }
-        }
+static bool cmd_auto_fade(const cli_ctx_t *ctx)
+{
+    uint32_t ms[2];
+    presence_rules_t *r = presence_rules();
+
+    if (!cli_args_u32(ctx->argv, 2, 0, UINT16_MAX, ms))
+        return false;
+    r->on_fade_ms = (uint16_t)ms[0];
+    r->off_fade_ms = (uint16_t)ms[1];
+    presence_rules_apply();
+    auto_show(ctx->sn);
+    return true;
+}
 
-        /* --- config gw <a.b.c.d> --- */
-        else if (strncmp(p, "gw", 2) == 0 && (p[2] == ' ')) {
-            uint8_t gw[4];
-            const char *arg = p + 3;
-            while (*arg == ' ') arg++;
-            if (parse_ipv4(arg, gw)) {
-                cmd_config_set_gw(gw);
-                cli_flush(sn, "Gateway updated\r\n");
-            } else {
-                cli_flush(sn, "Invalid gateway\r\n");
-            }
-        }
+static bool cmd_auto_zone(const cli_ctx_t *ctx)
+{
+    uint32_t i, y_max, bright;
+    presence_rules_t *r = presence_rules();
+    presence_rules_t edit = *r;
+
+    if (!cli_arg_u32(ctx->argv[0], 0, PRESENCE_ZONES_MAX - 1, &i) ||
+        !cli_arg_u32(ctx->argv[1], 0, UINT16_MAX, &y_max) || !cli_arg_u32(ctx->argv[2], 0, LINEAR_MAX, &bright))
+        return false;
+
+    edit.zone[i] = (presence_zone_t){ (uint16_t)y_max, (uint16_t)bright };
+    if (i >= edit.zone_count)
+        edit.zone_count = (uint8_t)(i + 1);
+    if (!presence_rules_valid(&edit)) {
+        cli_flush(ctx->sn, "Zones must be set in ascending y order\r\n");
+        return true;
+    }
+    *r = edit;
+    presence_rules_apply();
+    auto_show(ctx->sn);
+    return true;
+}
 
-        /* --- config dns <a.b.c.d> --- */
-        else if (strncmp(p, "dns", 3) == 0 && (p[3] == ' ')) {
-            uint8_t dns[4];
-            const char *arg = p + 4;
-            while (*arg == ' ') arg++;
-            if (parse_ipv4(arg, dns)) {
-                cmd_config_set_dns(dns);
-                cli_flush(sn, "DNS updated\r\n");
-            } else {
-                cli_flush(sn, "Invalid DNS address\r\n");
-            }
-        }
+static bool cmd_auto_save(const cli_ctx_t *ctx)
+{
+    cli_flush(ctx->sn, presence_rules_save() ? "Presence rules saved\r\n" : "Presence rules save failed\r\n");
+    return true;
+}
 
-        /* --- config save --- */
-        else if (strcmp(p, "save") == 0) {
-            cmd_config_save(sn);
-        }
+/* ---------- radar occupancy zones ---------- */
+static void zone_show(uint8_t sn)
+{
+    const occ_zones_t *zs = occupancy_zones();
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    char msg[200];
+
+    snprintf(msg, sizeof(msg), "Zones: %u, enter after %u frames, exit after %u ms\r\n",
+            zs->zone_count, zs->enter_frames, zs->exit_ms);
+    cli_flush(sn, msg);
+    for (uint8_t i = 0; i < zs->zone_count; i++) {
+        const occ_zone_def_t *d = &zs->zone[i];
+        const occ_zone_state_t *st = occupancy_zone_state(i);
+        int len;
 
-        /* --- config show --- */
-        else if (strcmp(p, "show") == 0) {
-            cmd_config_show(sn);
-        }
+        len = snprintf(msg, sizeof(msg), " %u %-8.*s %s tracks %u dwell %u ms visits %u total %u s bright %u :",
+                i, OCC_NAME_LEN, d->name, st->occupied ? "occupied" : "free    ", st->tracks,
+                occupancy_dwell_ms(i, now), st->visits, st->total_ms / 1000u, d->brightness);
+        for (uint8_t k = 0; k < d->n && len > 0 && len < (int)sizeof(msg) - 16; k++)
+            len += snprintf(msg + len, sizeof(msg) - (size_t)len, " %d,%d", d->v[k].x_mm, d->v[k].y_mm);
+        snprintf(msg + len, sizeof(msg) - (size_t)len, "\r\n");
+        cli_flush(sn, msg);
+    }
+}
 
-        /* --- config clean --- */
-        else if (strcmp(p, "clean") == 0) {
-            config_recovery();
-            cli_flush(sn, "Configuration cleaned\r\n");
-        }
+/* an edited copy of the zones, taken when valid */
+static bool zone_apply(uint8_t sn, const occ_zones_t *edit)
+{
+    if (!occupancy_zones_valid(edit)) {
+        cli_flush(sn, "Invalid zone: 3..6 vertices within +-16000 mm, not all on a line\r\n");
+        return true;
+    }
+    *occupancy_zones() = *edit;
+    occupancy_zones_apply();
+    zone_show(sn);
+    return true;
+}
 
-        /* --- config default --- */
-        else if (strcmp(p, "default") == 0) {
-            config_default();
-            cli_flush(sn, "Factory default configuration restored\r\n");
-        }
+static bool cmd_zone(const cli_ctx_t *ctx)
+{
+    zone_show(ctx->sn);
+    return true;
+}
 
-        else {
-            cli_flush(sn, "Unknown config command\r\n");
+/* zone set <i> <name> <bright> <x,y> <x,y> <x,y>.. */
+static bool cmd_zone_set(const cli_ctx_t *ctx)
+{
+    occ_zones_t edit = *occupancy_zones();
+    uint32_t i, bright;
+
+    if (!cli_arg_u32(ctx->argv[0], 0, OCC_ZONES_MAX - 1, &i) || i > edit.zone_count ||
+        !cli_arg_u32(ctx->argv[2], 0, LINEAR_MAX, &bright))
+        return false;
+
+    occ_zone_def_t *d = &edit.zone[i];
+    memset(d, 0, sizeof(*d));
+    strncpy(d->name, ctx->argv[1], OCC_NAME_LEN);
+    d->brightness = (uint16_t)bright;
+    for (int k = 3; k < ctx->argc; k++) {
+        char *comma = strchr(ctx->argv[k], ',');
+        int32_t x, y;
+
+        if (!comma)
+            return false;
+        *comma = '\0';
+        if (!cli_arg_i32(ctx->argv[k], -OCC_COORD_MAX, OCC_COORD_MAX, &x) ||
+            !cli_arg_i32(comma + 1, -OCC_COORD_MAX, OCC_COORD_MAX, &y)) {
+            d->n = 0;               // rejected by zone_apply()
+            break;
         }
+        d->v[d->n++] = (occ_point_t){ (int16_t)x, (int16_t)y };
     }
+    if (i == edit.zone_count)
+        edit.zone_count++;
+    return zone_apply(ctx->sn, &edit);
+}
 
-    else if (strcmp(cmd, "exit") == 0) {
-        char *msg = "Closing connection...\r\n";
-        cli_send(sn, msg);   // , (uint16_t)strlen(msg));
-        sleep_ms(2);
-        // Graceful disconnect, better to use telnet
-        disconnect(sn);
-        // close(sn);      // option, telnet has problems
-        printf("[CLI] Socket %d disconnected by user\r\n", sn);
+static bool cmd_zone_del(const cli_ctx_t *ctx)
+{
+    occ_zones_t edit = *occupancy_zones();
+    uint32_t i;
+
+    if (!cli_arg_u32(ctx->argv[0], 0, OCC_ZONES_MAX - 1, &i) || i >= edit.zone_count)
+        return false;
+    memmove(&edit.zone[i], &edit.zone[i + 1], (edit.zone_count - i - 1u) * sizeof(edit.zone[0]));
+    edit.zone_count--;
+    memset(&edit.zone[edit.zone_count], 0, sizeof(edit.zone[0]));
+    return zone_apply(ctx->sn, &edit);
+}
 
-    }
+static bool cmd_zone_timing(const cli_ctx_t *ctx)
+{
+    occ_zones_t edit = *occupancy_zones();
+    uint32_t frames, exit_ms;
 
- 
+    if (!cli_arg_u32(ctx->argv[0], 1, UINT8_MAX, &frames) || !cli_arg_u32(ctx->argv[1], 0, UINT16_MAX, &exit_ms))
+        return false;
+    edit.enter_frames = (uint8_t)frames;
+    edit.exit_ms = (uint16_t)exit_ms;
+    return zone_apply(ctx->sn, &edit);
+}
 
-    else {
-        char *msg = "Unknown command\r\n";
-        cli_flush(sn, msg);
+static bool cmd_zone_save(const cli_ctx_t *ctx)
+{
+    cli_flush(ctx->sn, occupancy_zones_save() ? "Zones saved\r\n" : "Zones save failed\r\n");
+    return true;
+}
+
+/* ---------- sensors ---------- */
+static bool cmd_radar(const cli_ctx_t *ctx)
+{
+    rd03d_drv_stats_t st = rd03d_drv_get_stats();
+    char msg[160];
+
+    snprintf(msg, sizeof(msg),
+            "RD-03D %s: %u frames, %u parses, %u bytes overrun, %u bytes resync, %u FIFO overruns\r\n",
+            st.dma ? "DMA ring" : "FIFO polling", st.frames, st.parses,
+            st.overrun_bytes, st.resync_bytes, st.fifo_overruns);
+    cli_flush(ctx->sn, msg);
+    return true;
+}
+
+static bool cmd_tof(const cli_ctx_t *ctx)
+{
+    const vl53_fetch_stats_t *fs = vl53l8cx_fetch_stats();
+    const vl53_scene_t *sc = vl53_scene_get();
+    char msg[160];
+
+    snprintf(msg, sizeof(msg),
+            "VL53L8CX: %lu frames, %lu stale, %lu corrupt, %lu errors; %u zones, %u foreground, %u blobs\r\n",
+            (unsigned long)fs->frames, (unsigned long)fs->stale, (unsigned long)fs->corrupt,
+            (unsigned long)fs->errors, sc->zones, sc->fg_zones, sc->n_blobs);
+    cli_flush(ctx->sn, msg);
+    for (uint8_t i = 0; i < sc->n_blobs; i++) {
+        const vl53_blob_t *b = &sc->blob[i];
+        snprintf(msg, sizeof(msg), " blob %u: %u zones at %u.%02u,%u.%02u, %u mm (nearest %u), %d mm/s\r\n",
+                b->id, b->zones, b->cx_q8 >> 8, (b->cx_q8 & 0xFFu) * 100u / 256u,
+                b->cy_q8 >> 8, (b->cy_q8 & 0xFFu) * 100u / 256u, b->mm, b->nearest_mm, b->velocity_mm_s);
+        cli_flush(ctx->sn, msg);
     }
+    return true;
+}
+
+static bool cmd_vl53_gpio(const cli_ctx_t *ctx)
+{
+    vl53_diag_print_gpio(ctx->sn);
+    return true;
+}
+
+#ifdef VL53_SPI
+static bool cmd_vl53_spi(const cli_ctx_t *ctx)
+{
+    vl53_diag_print_spi1(ctx->sn);
+    return true;
 }
 
+static bool cmd_vl53_raw(const cli_ctx_t *ctx)
+{
+    vl53_diag_raw_spi_test(ctx->sn);
+    return true;
+}
+#endif // VL53_SPI
+
+static bool cmd_vl53_probe(const cli_ctx_t *ctx)
+{
+    vl53_diag_probe_bus(ctx->sn);
+    return true;
+}
+
+static bool cmd_vl53_read(const cli_ctx_t *ctx)
+{
+    vl53_diag_read_one(ctx->sn);
+    return true;
+}
+
+static bool cmd_vl53_start(const cli_ctx_t *ctx)
+{
+    vl53_diag_start_ranging(ctx->sn);
+    return true;
+}
+
+static bool cmd_cson(const cli_ctx_t *ctx)
+{
+    vl53_diag_cs_active(ctx->sn);
+    return true;
+}
+
+static bool cmd_csoff(const cli_ctx_t *ctx)
+{
+    vl53_diag_cs_inactive(ctx->sn);
+    return true;
+}
+
+static const cli_cmd_t s_cmds[] = {
+    { "rgbw",       "<r> <g> <b> <w>",          "Set RGBW, 0..1023 each",                       4, 4, cmd_rgbw },
+    { "led",        "<w>",                      "Set the white LED, 0..4095",                   1, 1, cmd_led },
+    { "fade",       "<r> <g> <b> <w> <ms>",     "Fade to RGBW, 0..1023 each, in 0..32000 ms",   5, 5, cmd_fade },
+    { "rgb",        "<r> <g> <b>",              "Set color LEDs, 0..255 each",                  3, 3, cmd_rgb },
+    { "freq",       "<hz>",                     "PWM frequency, 50..20000 Hz",                  1, 1, cmd_freq },
+    { "tl",         "[<lin|in|out|inout|exp> <ms> <r> <g> <b> <w>]", "Timeline state / queue a fade segment", 0, 6, cmd_tl },
+    { "tl hold",    "<ms>",                     "Queue a hold segment",                         1, 1, cmd_tl_hold },
+    { "tl loop",    "<0|1>",                    "Repeat the timeline",                          1, 1, cmd_tl_loop },
+    { "tl clear",   "",                         "Drop the timeline",                            0, 0, cmd_tl_clear },
+    { "fx",         "[<n> <r> <g> <b> <w>]",    "List fixtures / set fixture n",                0, 5, cmd_fx },
+    { "ddp fmt",    "<rgbw8|rgb8|rgbw16le|tl>", "DDP payload format",                           1, 1, cmd_ddp_fmt },
+    { "pwm status", "",                         "PWM current, target and fade state",           0, 0, cmd_pwm_status },
+    { "set",        "[p]",                      "Set active LED/pattern index to value [p]",    0, 1, cmd_set },
+    { "get",        "",                         "Get current pattern index",                    0, 0, cmd_get },
+    { "auto",       "",                         "Presence automation state",                    0, 0, cmd_auto },
+    { "auto on",    "",                         "Enable presence automation",                   0, 0, cmd_auto_on },
+    { "auto off",   "",                         "Disable presence automation",                  0, 0, cmd_auto_off },
+    { "auto hold",  "<ms>",                     "Light kept on after presence ends",            1, 1, cmd_auto_hold },
+    { "auto fade",  "<on_ms> <off_ms>",         "Fade times of the automation",                 2, 2, cmd_auto_fade },
+    { "auto zone",  "<i> <ymax_mm> <bright>",   "Brightness up to a radar distance",            3, 3, cmd_auto_zone },
+    { "auto save",  "",                         "Store the presence rules",                     0, 0, cmd_auto_save },
+    { "zone",       "",                         "Radar occupancy zones: state, dwell, visits",  0, 0, cmd_zone },
+    { "zone set",   "<i> <name> <bright> <x,y> <x,y> <x,y>..", "Polygon in radar mm",           6, 3 + OCC_VERTS_MAX, cmd_zone_set },
+    { "zone del",   "<i>",                      "Remove a zone",                                1, 1, cmd_zone_del },
+    { "zone timing", "<frames> <exit_ms>",      "Frames in before enter, time out before exit", 2, 2, cmd_zone_timing },
+    { "zone save",  "",                         "Store the zones",                              0, 0, cmd_zone_save },
+    { "radar",      "",                         "RD-03D receive statistics",                    0, 0, cmd_radar },
+    { "tof",        "",                         "VL53L8CX frames, foreground zones and blobs",  0, 0, cmd_tof },
+    { "vl53 gpio",  "",                         "VL53 pin state",                               0, 0, cmd_vl53_gpio },
+#ifdef VL53_SPI
+    { "vl53 spi",   "",                         "VL53 SPI1 registers",                          0, 0, cmd_vl53_spi },
+    { "vl53 raw",   "",                         "VL53 raw SPI transfer",                        0, 0, cmd_vl53_raw },
+#endif
+    { "vl53 probe", "",                         "Probe the VL53 bus",                           0, 0, cmd_vl53_probe },
+    { "vl53 read",  "",                         "Read one VL53 frame",                          0, 0, cmd_vl53_read },
+    { "vl53 start", "",                         "Start VL53 ranging",                           0, 0, cmd_vl53_start },
+    { "cson",       "",                         NULL,                                           0, 0, cmd_cson },
+    { "csoff",      "",                         NULL,                                           0, 0, cmd_csoff },
+};
+
 void telnet_init(void) {
     // This function can be called during initialization to set up telnet CLI
     // For example, it can initialize the TCP CLI with appropriate parameters
     tcp_cli_hooks_t hooks = {
         .on_connect = telnet_greeting,
-        .handle_command = handle_command
+        .handle_command = cli_cmd_handle
     };
 
+    cli_sys_register(PROJECT_NAME, FW_VERSION);
+    if (!cli_cmd_register(s_cmds, (uint8_t)count_of(s_cmds)))
+        printf("[CLI] %s commands not registered: index full or a name taken\r\n", PROJECT_NAME);
+    rd03d_cli_register();
+
     cli_hook_init(&hooks);
-    tcp_cli_init(TCP_CLI_SOCKET, TCP_CLI_PORT, cli_buf_rx, CLI_BUF_RX_SIZE, CLI_TIMEOUT);
+    tcp_cli_init(TCP_CLI_SOCKET, TCP_CLI_SESSIONS, TCP_CLI_PORT, CLI_TIMEOUT);
 }
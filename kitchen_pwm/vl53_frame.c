@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "vl53_frame.h"
+
+#if defined(VL53L8CX_DISABLE_DISTANCE_MM) || defined(VL53L8CX_DISABLE_TARGET_STATUS)
+#error "vl53_frame_decode() needs distance and target status in the result profile"
+#endif
+#ifdef VL53L8CX_USE_RAW_FORMAT
+#error "vl53_frame_decode() converts to the user format"
+#endif
+
+#define PER_TARGET      ((uint32_t)VL53L8CX_RESOLUTION_8X8 * VL53L8CX_NB_TARGET_PER_ZONE)
+
+/* word as SwapBuffer() leaves it: one REV on the target */
+static inline uint32_t be32(const uint8_t *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return __builtin_bswap32(v);
+}
+
+/* byte fields: each word reversed into place */
+static void copy_bytes(uint8_t *dst, const uint8_t *src, uint32_t n)
+{
+    for (uint32_t k = 0; k < n; k += 4) {
+        uint32_t v = be32(&src[k]);
+        memcpy(&dst[k], &v, sizeof(v));
+    }
+}
+
+static uint32_t min_u32(uint32_t a, uint32_t b)
+{
+    return (a < b) ? a : b;
+}
+
+uint8_t vl53_frame_decode(const uint8_t *p_buffer, uint32_t size, VL53L8CX_ResultsData *p_results)
+{
+#ifndef VL53L8CX_DISABLE_NB_TARGET_DETECTED
+    uint32_t n_zones = 0;
+#endif
+
+    if (size < 24)
+        return VL53L8CX_STATUS_CORRUPTED_FRAME;
+
+    /* blocks from offset 16 as in the ST parser, which also reads the footer as one */
+    for (uint32_t i = 16; i + 4 <= size; ) {
+        uint32_t bh = be32(&p_buffer[i]);
+        uint32_t type = bh & 0xFu, bsize = (bh >> 4) & 0xFFFu;
+        uint32_t msize = (type > 1u && type < 0xDu) ? type * bsize : bsize;
+        const uint8_t *p = &p_buffer[i + 4];
+
+        i += 4 + msize;
+        if (i > size)
+            break;
+
+        switch ((uint16_t)(bh >> 16)) {
+            case VL53L8CX_METADATA_IDX:
+                p_results->silicon_temp_degc = (int8_t)(uint8_t)be32(&p[8]);
+                break;
+#ifndef VL53L8CX_DISABLE_NB_TARGET_DETECTED
+            case VL53L8CX_NB_TARGET_DETECTED_IDX:
+                n_zones = min_u32(msize, VL53L8CX_RESOLUTION_8X8) & ~3u;
+                copy_bytes(p_results->nb_target_detected, p, n_zones);
+                break;
+#endif
+            case VL53L8CX_DISTANCE_IDX: {
+                uint32_t n = min_u32(msize / 2u, PER_TARGET) & ~1u;
+                for (uint32_t k = 0; k < n; k += 2) {
+                    uint32_t v = be32(&p[2 * k]);
+                    p_results->distance_mm[k] = (int16_t)((int16_t)v / 4);
+                    p_results->distance_mm[k + 1] = (int16_t)((int16_t)(v >> 16) / 4);
+                }
+                break;
+            }
+            case VL53L8CX_TARGET_STATUS_IDX:
+                copy_bytes(p_results->target_status, p, min_u32(msize, PER_TARGET) & ~3u);
+                break;
+            default:
+                break;
+        }
+    }
+
+#ifndef VL53L8CX_DISABLE_NB_TARGET_DETECTED
+    for (uint32_t z = 0; z < n_zones; z++) {
+        if (p_results->nb_target_detected[z] != 0)
+            continue;
+        for (uint32_t j = 0; j < VL53L8CX_NB_TARGET_PER_ZONE; j++)
+            p_results->target_status[z * VL53L8CX_NB_TARGET_PER_ZONE + j] = 255;
+    }
+#endif
+
+    /* header id in bytes 8..9, footer id in the last word: the low halves once swapped */
+    if ((be32(&p_buffer[8]) ^ be32(&p_buffer[size - 4])) & 0xFFFFu)
+        return VL53L8CX_STATUS_CORRUPTED_FRAME;
+    return VL53L8CX_STATUS_OK;
+}
@@ -0,0 +1,24 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+#include <stdint.h>
+#include "vl53l8cx_api.h"
+
+/**
+ * Ranging frame conversion for the result profile in vl53l8cx_api.h. The
+ * ST parser byte-swaps the whole frame in place, then walks the blocks and
+ * copies every enabled field before converting it in a second pass. Here
+ * each block is read once from the frame as fetched (big-endian words) and
+ * only distance, target status, target count and temperature are written,
+ * converted on the way: distance / 4, status 255 for a zone without
+ * target. The results are those of vl53l8cx_decode_ranging_data() for the
+ * zones of the frame; the frame itself is left as it is.
+ *
+ * Returns VL53L8CX_STATUS_OK or VL53L8CX_STATUS_CORRUPTED_FRAME (header
+ * and footer ids differ), as vl53l8cx_decode_ranging_data().
+ */
+uint8_t vl53_frame_decode(const uint8_t *p_buffer, uint32_t size, VL53L8CX_ResultsData *p_results);
@@ -0,0 +1,271 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "vl53_scene.h"
+
+#define EMA_DIV         2           // zone filter, per frame
+#define BG_DIV          32          // background learning while the zone is background
+#define BG_UP_DIV       16          // background moving away: something was taken out
+#define SNAP_MM         500         // median this far from the EMA restarts it
+#define WARMUP_FRAMES   15          // first second: what the zones see is background
+#define FAR_MM          4000        // background of a zone that was empty after warmup
+#define MATCH_Q8        384         // blob matched to the last frame within 1.5 zones
+#define MIN_ZONES_8X8   2           // a single 8x8 zone is noise more often than an object
+#define CANDIDATES      (VL53_SCENE_ZONES / 2)
+
+/* distances are kept in mm * 16 */
+typedef struct {
+    int16_t  hist[3];           // last valid samples, newest first
+    uint8_t  n;                 // samples in hist
+    uint8_t  miss;              // frames without a valid target
+    uint16_t fg_frames;         // foreground frames since it was last background
+    int32_t  ema_q4;            // 0 = zone dropped
+    int32_t  bg_q4;             // 0 = not learned yet
+} zone_t;
+
+static zone_t       s_zone[VL53_SCENE_ZONES];
+static vl53_scene_t s_scene;
+static vl53_blob_t  s_prev[VL53_SCENE_BLOBS_MAX];
+static uint8_t      s_prev_n;
+static uint8_t      s_next_id;
+
+void vl53_scene_reset(void)
+{
+    memset(s_zone, 0, sizeof(s_zone));
+    memset(&s_scene, 0, sizeof(s_scene));
+    s_prev_n = 0;
+    s_next_id = 0;
+}
+
+static int32_t median3(int32_t a, int32_t b, int32_t c)
+{
+    if (a > b) {
+        int32_t t = a;
+        a = b;
+        b = t;
+    }
+    if (b > c)
+        b = c;
+    return (a > b) ? a : b;
+}
+
+static int32_t iabs(int32_t v)
+{
+    return (v < 0) ? -v : v;
+}
+
+static void zone_filter(zone_t *zs, int16_t d, uint8_t status)
+{
+    if ((status == 5 || status == 9) && d > 0) {
+        zs->hist[2] = zs->hist[1];
+        zs->hist[1] = zs->hist[0];
+        zs->hist[0] = d;
+        if (zs->n < 3)
+            zs->n++;
+        zs->miss = 0;
+
+        int32_t q = 16 * ((zs->n < 3) ? d : median3(zs->hist[0], zs->hist[1], zs->hist[2]));
+        if (zs->ema_q4 == 0 || iabs(q - zs->ema_q4) > 16 * SNAP_MM)
+            zs->ema_q4 = q;
+        else
+            zs->ema_q4 += (q - zs->ema_q4) / EMA_DIV;
+        return;
+    }
+    if (zs->miss < UINT8_MAX)
+        zs->miss++;
+    if (zs->miss >= VL53_SCENE_HOLD_FRAMES) {
+        zs->n = 0;
+        zs->ema_q4 = 0;
+    }
+}
+
+/* true when the zone is foreground; learns the background otherwise */
+static bool zone_background(zone_t *zs, uint32_t seq)
+{
+    int32_t f = zs->ema_q4;
+
+    if (f == 0)
+        return false;               // a dropout does not restart the absorb count
+    if (seq < WARMUP_FRAMES) {
+        zs->bg_q4 = f;
+        return false;
+    }
+    if (zs->bg_q4 == 0)
+        zs->bg_q4 = 16 * FAR_MM;
+
+    if (f < zs->bg_q4 - 16 * VL53_SCENE_FG_MM - zs->bg_q4 / 16) {
+        if (++zs->fg_frames < VL53_SCENE_ABSORB_FRAMES)
+            return true;
+        zs->bg_q4 = f;              // has not moved for long: part of the room now
+    } else {
+        zs->bg_q4 += (f - zs->bg_q4) / ((f > zs->bg_q4) ? BG_UP_DIV : BG_DIV);
+    }
+    zs->fg_frames = 0;
+    return false;
+}
+
+typedef struct {
+    uint8_t  zones;
+    uint16_t nearest_mm;
+    uint32_t sum_col, sum_row, sum_mm;
+} blob_acc_t;
+
+/* 4-connected foreground zones with close distances */
+static uint8_t find_blobs(blob_acc_t *cand, uint8_t cols)
+{
+    uint8_t zones = (uint8_t)(cols * cols), n = 0;
+    uint8_t stack[VL53_SCENE_ZONES];
+    uint64_t seen = 0;
+
+    for (uint8_t z = 0; z < zones; z++) {
+        if (!(s_scene.fg >> z & 1u) || (seen >> z & 1u) || n == CANDIDATES)
+            continue;
+        blob_acc_t *b = &cand[n++];
+        uint8_t sp = 0;
+
+        memset(b, 0, sizeof(*b));
+        b->nearest_mm = UINT16_MAX;
+        seen |= 1ull << z;
+        stack[sp++] = z;
+        while (sp) {
+            uint8_t k = stack[--sp], col = (uint8_t)(k % cols), row = (uint8_t)(k / cols);
+            uint16_t mm = s_scene.mm[k];
+            uint8_t nb[4];
+            uint8_t nn = 0;
+
+            b->zones++;
+            b->sum_col += col;
+            b->sum_row += row;
+            b->sum_mm += mm;
+            if (mm < b->nearest_mm)
+                b->nearest_mm = mm;
+
+            if (col > 0)
+                nb[nn++] = (uint8_t)(k - 1);
+            if (col + 1u < cols)
+                nb[nn++] = (uint8_t)(k + 1);
+            if (row > 0)
+                nb[nn++] = (uint8_t)(k - cols);
+            if (row + 1u < cols)
+                nb[nn++] = (uint8_t)(k + cols);
+            for (uint8_t i = 0; i < nn; i++) {
+                uint8_t j = nb[i];
+                if (!(s_scene.fg >> j & 1u) || (seen >> j & 1u) ||
+                    iabs((int32_t)s_scene.mm[j] - mm) >= VL53_SCENE_JOIN_MM)
+                    continue;
+                seen |= 1ull << j;
+                stack[sp++] = j;
+            }
+        }
+    }
+    return n;
+}
+
+static uint16_t mean_q8(uint32_t sum, uint8_t n)
+{
+    return (uint16_t)((sum * 256u + n / 2u) / n);
+}
+
+/* largest blobs, each matched to the nearest blob of the last frame for id and velocity */
+static void make_blobs(const blob_acc_t *cand, uint8_t n, uint8_t min_zones, uint32_t dt_ms)
+{
+    uint8_t order[CANDIDATES];
+    bool used[VL53_SCENE_BLOBS_MAX] = { false };
+
+    for (uint8_t i = 0; i < n; i++) {
+        uint8_t j = i;
+        for (; j > 0 && cand[order[j - 1]].zones < cand[i].zones; j--)
+            order[j] = order[j - 1];
+        order[j] = i;
+    }
+    while (n && cand[order[n - 1]].zones < min_zones)
+        n--;
+    s_scene.n_blobs = (n < VL53_SCENE_BLOBS_MAX) ? n : VL53_SCENE_BLOBS_MAX;
+    s_scene.dropped = (uint8_t)(n - s_scene.n_blobs);
+
+    for (uint8_t i = 0; i < s_scene.n_blobs; i++) {
+        const blob_acc_t *c = &cand[order[i]];
+        vl53_blob_t *b = &s_scene.blob[i];
+        int32_t best_d = MATCH_Q8 * MATCH_Q8;
+        int best = -1;
+
+        b->zones = c->zones;
+        b->cx_q8 = mean_q8(c->sum_col, c->zones);
+        b->cy_q8 = mean_q8(c->sum_row, c->zones);
+        b->mm = (uint16_t)((c->sum_mm + c->zones / 2u) / c->zones);
+        b->nearest_mm = c->nearest_mm;
+
+        for (uint8_t p = 0; p < s_prev_n; p++) {
+            int32_t dx = (int32_t)s_prev[p].cx_q8 - b->cx_q8, dy = (int32_t)s_prev[p].cy_q8 - b->cy_q8;
+            int32_t d = dx * dx + dy * dy;
+            if (!used[p] && d < best_d) {
+                best_d = d;
+                best = p;
+            }
+        }
+        if (best < 0) {
+            if (++s_next_id == 0)
+                s_next_id = 1;
+            b->id = s_next_id;
+            b->velocity_mm_s = 0;
+            continue;
+        }
+        used[best] = true;
+        b->id = s_prev[best].id;
+        b->velocity_mm_s = s_prev[best].velocity_mm_s;
+        if (dt_ms) {
+            int32_t v = ((int32_t)b->mm - s_prev[best].mm) * 1000 / (int32_t)dt_ms;
+            v = (v + b->velocity_mm_s) / 2;
+            b->velocity_mm_s = (int16_t)((v > INT16_MAX) ? INT16_MAX : (v < INT16_MIN) ? INT16_MIN : v);
+        }
+    }
+    memcpy(s_prev, s_scene.blob, sizeof(s_prev));
+    s_prev_n = s_scene.n_blobs;
+}
+
+const vl53_scene_t *vl53_scene_frame(const int16_t *distance_mm, const uint8_t *target_status,
+                                     uint8_t zones, uint32_t t_ms)
+{
+    static blob_acc_t cand[CANDIDATES];
+    uint8_t cols = (zones == 64) ? 8 : (zones == 16) ? 4 : 0;
+
+    if (!cols)
+        return &s_scene;
+    if (zones != s_scene.zones) {
+        vl53_scene_reset();
+        s_scene.zones = zones;
+    }
+
+    uint32_t dt_ms = s_scene.seq ? t_ms - s_scene.t_ms : 0;
+    s_scene.valid = 0;
+    s_scene.fg = 0;
+    s_scene.fg_zones = 0;
+    for (uint8_t z = 0; z < zones; z++) {
+        zone_t *zs = &s_zone[z];
+
+        zone_filter(zs, distance_mm[z], target_status[z]);
+        if (zone_background(zs, s_scene.seq)) {
+            s_scene.fg |= 1ull << z;
+            s_scene.fg_zones++;
+        }
+        if (zs->ema_q4)
+            s_scene.valid |= 1ull << z;
+        s_scene.mm[z] = (uint16_t)((zs->ema_q4 + 8) / 16);
+        s_scene.bg_mm[z] = (uint16_t)((zs->bg_q4 + 8) / 16);
+    }
+
+    make_blobs(cand, find_blobs(cand, cols), (cols == 8) ? MIN_ZONES_8X8 : 1, dt_ms);
+    s_scene.seq++;
+    s_scene.t_ms = t_ms;
+    return &s_scene;
+}
+
+const vl53_scene_t *vl53_scene_get(void)
+{
+    return &s_scene;
+}
@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * VL53L8CX zone map processing, one call per ranging frame, integer only.
+ *
+ *  - per zone filter: only targets with status 5 or 9 are taken; the last
+ *    three go through a median, then an EMA (1/2). A zone without a valid
+ *    target for VL53_SCENE_HOLD_FRAMES frames is dropped.
+ *  - background: every zone learns its static distance (EMA 1/32) while it
+ *    is not foreground. A zone is foreground when it is nearer than its
+ *    background by VL53_SCENE_FG_MM plus 1/16 of the background; something
+ *    that stays put for VL53_SCENE_ABSORB_FRAMES becomes background.
+ *  - blobs: foreground zones joined with their 4 neighbours when their
+ *    distances differ by less than VL53_SCENE_JOIN_MM, at least 2 zones
+ *    in 8x8 (one zone is more often noise than an object). Each blob has its
+ *    centroid, size, distances, and an approach velocity from the blob of
+ *    the last frame nearest to it.
+ *
+ * Zones are row * cols + col in ST order, cols 4 or 8. No SDK dependency.
+ */
+#define VL53_SCENE_ZONES            64
+#define VL53_SCENE_BLOBS_MAX        6
+#define VL53_SCENE_HOLD_FRAMES      3
+#define VL53_SCENE_FG_MM            150
+#define VL53_SCENE_JOIN_MM          400
+#define VL53_SCENE_ABSORB_FRAMES    450     // 30 s at 15 Hz
+
+typedef struct {
+    uint8_t  id;                // same id while matched frame to frame, 1..255
+    uint8_t  zones;
+    uint16_t cx_q8, cy_q8;      // centroid, column / row with 8 fractional bits
+    uint16_t mm;                // mean filtered distance
+    uint16_t nearest_mm;
+    int16_t  velocity_mm_s;     // change of mm per second, < 0 approaching
+} vl53_blob_t;
+
+typedef struct {
+    uint32_t seq;               // frames processed
+    uint32_t t_ms;
+    uint8_t  zones;             // 16 or 64, 0 before the first frame
+    uint8_t  fg_zones;
+    uint8_t  n_blobs;
+    uint8_t  dropped;           // blobs beyond VL53_SCENE_BLOBS_MAX, the smallest
+    uint64_t valid;             // zone has a filtered distance
+    uint64_t fg;                // zone is foreground
+    uint16_t mm[VL53_SCENE_ZONES];      // filtered distance, 0 = none
+    uint16_t bg_mm[VL53_SCENE_ZONES];   // learned background, 0 = not yet
+    vl53_blob_t blob[VL53_SCENE_BLOBS_MAX];     // largest first
+} vl53_scene_t;
+
+void vl53_scene_reset(void);
+
+/* a new frame: distance and target status of the first target per zone */
+const vl53_scene_t *vl53_scene_frame(const int16_t *distance_mm, const uint8_t *target_status,
+                                     uint8_t zones, uint32_t t_ms);
+
+const vl53_scene_t *vl53_scene_get(void);
@@ -736,22 +736,34 @@ uint8_t vl53l8cx_check_data_ready(
 	uint8_t status = VL53L8CX_STATUS_OK;
 
 	status |= RdMulti(&(p_dev->platform), 0x0, p_dev->temp_buffer, 4);
+	status |= vl53l8cx_check_data_header(p_dev, p_dev->temp_buffer,
+			p_isReady);
 
-	if((p_dev->temp_buffer[0] != p_dev->streamcount)
-			&& (p_dev->temp_buffer[0] != (uint8_t)255)
-			&& (p_dev->temp_buffer[1] == (uint8_t)0x5)
-			&& ((p_dev->temp_buffer[2] & (uint8_t)0x5) == (uint8_t)0x5)
-			&& ((p_dev->temp_buffer[3] & (uint8_t)0x10) ==(uint8_t)0x10)
+	return status;
+}
+
+uint8_t vl53l8cx_check_data_header(
+		VL53L8CX_Configuration		*p_dev,
+		const uint8_t			*p_header,
+		uint8_t				*p_isReady)
+{
+	uint8_t status = VL53L8CX_STATUS_OK;
+
+	if((p_header[0] != p_dev->streamcount)
+			&& (p_header[0] != (uint8_t)255)
+			&& (p_header[1] == (uint8_t)0x5)
+			&& ((p_header[2] & (uint8_t)0x5) == (uint8_t)0x5)
+			&& ((p_header[3] & (uint8_t)0x10) ==(uint8_t)0x10)
 			)
 	{
 		*p_isReady = (uint8_t)1;
-		 p_dev->streamcount = p_dev->temp_buffer[0];
+		 p_dev->streamcount = p_header[0];
 	}
 	else
 	{
-        if ((p_dev->temp_buffer[3] & (uint8_t)0x80) != (uint8_t)0)
+        if ((p_header[3] & (uint8_t)0x80) != (uint8_t)0)
         {
-        	status |= p_dev->temp_buffer[2];	/* Return GO2 error status */
+        	status |= p_header[2];	/* Return GO2 error status */
         }
 
 		*p_isReady = 0;
@@ -765,19 +777,32 @@ uint8_t vl53l8cx_get_ranging_data(
 		VL53L8CX_ResultsData		*p_results)
 {
 	uint8_t status = VL53L8CX_STATUS_OK;
-	uint16_t header_id, footer_id;
-	union Block_header *bh_ptr;
-	uint32_t i, j, msize;
+
 	status |= RdMulti(&(p_dev->platform), 0x0,
 			p_dev->temp_buffer, p_dev->data_read_size);
 	p_dev->streamcount = p_dev->temp_buffer[0];
-	SwapBuffer(p_dev->temp_buffer, (uint16_t)p_dev->data_read_size);
+	status |= vl53l8cx_decode_ranging_data(p_dev, p_dev->temp_buffer,
+			p_results);
+
+	return status;
+}
+
+uint8_t vl53l8cx_decode_ranging_data(
+		VL53L8CX_Configuration		*p_dev,
+		uint8_t				*p_buffer,
+		VL53L8CX_ResultsData		*p_results)
+{
+	uint8_t status = VL53L8CX_STATUS_OK;
+	uint16_t header_id, footer_id;
+	union Block_header *bh_ptr;
+	uint32_t i, j, msize;
+	SwapBuffer(p_buffer, (uint16_t)p_dev->data_read_size);
 
 	/* Start conversion at position 16 to avoid headers */
 	for (i = (uint32_t)16; i 
              < (uint32_t)p_dev->data_read_size; i+=(uint32_t)4)
 	{
-		bh_ptr = (union Block_header *)&(p_dev->temp_buffer[i]);
+		bh_ptr = (union Block_header *)&(p_buffer[i]);
 		if ((bh_ptr->type > (uint32_t)0x1) 
                     && (bh_ptr->type < (uint32_t)0xd))
 		{
@@ -791,61 +816,61 @@ uint8_t vl53l8cx_get_ranging_data(
 		switch(bh_ptr->idx){
 			case VL53L8CX_METADATA_IDX:
 				p_results->silicon_temp_degc =
-						(int8_t)p_dev->temp_buffer[i + (uint32_t)12];
+						(int8_t)p_buffer[i + (uint32_t)12];
 				break;
 
 #ifndef VL53L8CX_DISABLE_AMBIENT_PER_SPAD
 			case VL53L8CX_AMBIENT_RATE_IDX:
 				(void)memcpy(p_results->ambient_per_spad,
-				&(p_dev->temp_buffer[i + (uint32_t)4]), msize);
+				&(p_buffer[i + (uint32_t)4]), msize);
 				break;
 #endif
 #ifndef VL53L8CX_DISABLE_NB_SPADS_ENABLED
 			case VL53L8CX_SPAD_COUNT_IDX:
 				(void)memcpy(p_results->nb_spads_enabled,
-				&(p_dev->temp_buffer[i + (uint32_t)4]), msize);
+				&(p_buffer[i + (uint32_t)4]), msize);
 				break;
 #endif
 #ifndef VL53L8CX_DISABLE_NB_TARGET_DETECTED
 			case VL53L8CX_NB_TARGET_DETECTED_IDX:
 				(void)memcpy(p_results->nb_target_detected,
-				&(p_dev->temp_buffer[i + (uint32_t)4]), msize);
+				&(p_buffer[i + (uint32_t)4]), msize);
 				break;
 #endif
 #ifndef VL53L8CX_DISABLE_SIGNAL_PER_SPAD
 			case VL53L8CX_SIGNAL_RATE_IDX:
 				(void)memcpy(p_results->signal_per_spad,
-				&(p_dev->temp_buffer[i + (uint32_t)4]), msize);
+				&(p_buffer[i + (uint32_t)4]), msize);
 				break;
 #endif
 #ifndef VL53L8CX_DISABLE_RANGE_SIGMA_MM
 			case VL53L8CX_RANGE_SIGMA_MM_IDX:
 				(void)memcpy(p_results->range_sigma_mm,
-				&(p_dev->temp_buffer[i + (uint32_t)4]), msize);
+				&(p_buffer[i + (uint32_t)4]), msize);
 				break;
 #endif
 #ifndef VL53L8CX_DISABLE_DISTANCE_MM
 			case VL53L8CX_DISTANCE_IDX:
 				(void)memcpy(p_results->distance_mm,
-				&(p_dev->temp_buffer[i + (uint32_t)4]), msize);
+				&(p_buffer[i + (uint32_t)4]), msize);
 				break;
 #endif
 #ifndef VL53L8CX_DISABLE_REFLECTANCE_PERCENT
 			case VL53L8CX_REFLECTANCE_EST_PC_IDX:
 				(void)memcpy(p_results->reflectance,
-				&(p_dev->temp_buffer[i + (uint32_t)4]), msize);
+				&(p_buffer[i + (uint32_t)4]), msize);
 				break;
 #endif
 #ifndef VL53L8CX_DISABLE_TARGET_STATUS
 			case VL53L8CX_TARGET_STATUS_IDX:
 				(void)memcpy(p_results->target_status,
-				&(p_dev->temp_buffer[i + (uint32_t)4]), msize);
+				&(p_buffer[i + (uint32_t)4]), msize);
 				break;
 #endif
 #ifndef VL53L8CX_DISABLE_MOTION_INDICATOR
 			case VL53L8CX_MOTION_DETEC_IDX:
 				(void)memcpy(&p_results->motion_indicator,
-				&(p_dev->temp_buffer[i + (uint32_t)4]), msize);
+				&(p_buffer[i + (uint32_t)4]), msize);
 				break;
 #endif
 			default:
@@ -910,12 +935,12 @@ uint8_t vl53l8cx_get_ranging_data(
 
 	/* Check if footer id and header id are matching. This allows to detect
 	 * corrupted frames */
-	header_id = ((uint16_t)(p_dev->temp_buffer[0x8])<<8) & 0xFF00U;
-	header_id |= ((uint16_t)(p_dev->temp_buffer[0x9])) & 0x00FFU;
+	header_id = ((uint16_t)(p_buffer[0x8])<<8) & 0xFF00U;
+	header_id |= ((uint16_t)(p_buffer[0x9])) & 0x00FFU;
 
-	footer_id = ((uint16_t)(p_dev->temp_buffer[p_dev->data_read_size
+	footer_id = ((uint16_t)(p_buffer[p_dev->data_read_size
 		- (uint32_t)4]) << 8) & 0xFF00U;
-	footer_id |= ((uint16_t)(p_dev->temp_buffer[p_dev->data_read_size
+	footer_id |= ((uint16_t)(p_buffer[p_dev->data_read_size
 		- (uint32_t)3])) & 0xFFU;
 
 	if(header_id != footer_id)
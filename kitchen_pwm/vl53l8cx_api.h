@@ -45,16 +45,23 @@
  * All macro below are used to configure the sensor output. User can
  * define some macros if he wants to disable selected output, in order to reduce
  * I2C access.
- */
-// #define VL53L8CX_DISABLE_AMBIENT_PER_SPAD
-// #define VL53L8CX_DISABLE_NB_SPADS_ENABLED
+ *
+ * Result profile of kitchen_pwm: the sensor sends distance, target status and
+ * the target count that vl53l8cx_decode_ranging_data() uses to mark empty
+ * zones, 320 bytes per 8x8 frame instead of 1444. vl53_frame_decode() is
+ * written for this profile. Build with VL53L8CX_RESULTS_FULL for all outputs.
+ */
+#ifndef VL53L8CX_RESULTS_FULL
+#define VL53L8CX_DISABLE_AMBIENT_PER_SPAD
+#define VL53L8CX_DISABLE_NB_SPADS_ENABLED
 // #define VL53L8CX_DISABLE_NB_TARGET_DETECTED
-// #define VL53L8CX_DISABLE_SIGNAL_PER_SPAD
-// #define VL53L8CX_DISABLE_RANGE_SIGMA_MM
+#define VL53L8CX_DISABLE_SIGNAL_PER_SPAD
+#define VL53L8CX_DISABLE_RANGE_SIGMA_MM
 // #define VL53L8CX_DISABLE_DISTANCE_MM
-// #define VL53L8CX_DISABLE_REFLECTANCE_PERCENT
+#define VL53L8CX_DISABLE_REFLECTANCE_PERCENT
 // #define VL53L8CX_DISABLE_TARGET_STATUS
-// #define VL53L8CX_DISABLE_MOTION_INDICATOR
+#define VL53L8CX_DISABLE_MOTION_INDICATOR
+#endif // VL53L8CX_RESULTS_FULL
 
 uint8_t RdByte(VL53L8CX_Platform *p_platform, uint16_t RegisterAdress,
                 uint8_t *p_value);
@@ -511,6 +518,33 @@ uint8_t vl53l8cx_get_ranging_data(
                 VL53L8CX_Configuration          *p_dev,
                 VL53L8CX_ResultsData            *p_results);
 
+/**
+ * vl53l8cx_check_data_ready() on the first 4 bytes of a frame that was
+ * already read, e.g. by the DMA fetch of vl53l8cx_drv.c.
+ * @param (VL53L8CX_Configuration) *p_dev : VL53L8CX configuration structure.
+ * @param (const uint8_t) *p_header : first 4 bytes read from address 0.
+ * @param (uint8_t) *p_isReady : 1 for a new frame, 0 otherwise.
+ * @return (uint8_t) status : 0 if OK, else the GO2 error status.
+ */
+uint8_t vl53l8cx_check_data_header(
+                VL53L8CX_Configuration          *p_dev,
+                const uint8_t                   *p_header,
+                uint8_t                         *p_isReady);
+
+/**
+ * vl53l8cx_get_ranging_data() without the bus read: converts a frame of
+ * data_read_size bytes read from address 0. The buffer is byte-swapped in
+ * place.
+ * @param (VL53L8CX_Configuration) *p_dev : VL53L8CX configuration structure.
+ * @param (uint8_t) *p_buffer : raw frame, 4-byte aligned.
+ * @param (VL53L8CX_ResultsData) *p_results : VL53L5 results structure.
+ * @return (uint8_t) status : 0 data are successfully converted.
+ */
+uint8_t vl53l8cx_decode_ranging_data(
+                VL53L8CX_Configuration          *p_dev,
+                uint8_t                         *p_buffer,
+                VL53L8CX_ResultsData            *p_results);
+
 /**
  * This function gets the current resolution (4x4 or 8x8).
  * @param (VL53L8CX_Configuration) *p_dev : VL53L8CX configuration structure.
@@ -12,6 +12,12 @@
 #include "vl53l8cx_drv.h"
 #include "vl53l8cx_platform.h"
 #include "vl53l8cx_api.h"   // ST ULD
+#include "vl53_frame.h"
+#include "vl53_scene.h"
+
+#if VL53L8CX_NB_TARGET_PER_ZONE != 1
+#error "vl53_scene_frame() takes one target per zone"
+#endif
 
 // ===== ST device instance =====
 static vl53l8cx_dev_t dev;
@@ -21,6 +27,8 @@ static bool ranging_active = false;
 // Optional: expose results later via getter
 // static vl53l8cx_results_data_t last_results;
 static vl53l8cx_results_data_t vl53_results;
+static uint8_t vl53_zones = VL53L8CX_RESOLUTION_4X4;
+static vl53_frame_fn vl53_frame_hook;
 
 
 VL53L8CX_Configuration *vl53_get_dev(void)
@@ -66,11 +74,15 @@ bool vl53l8cx_init_driver(void)
 
 
     printf("[VL53] drv start vl53l8cx_init \n");
+    uint64_t t0 = time_us_64();
     ret = vl53l8cx_init(p_dev);
     if (ret != VL53L8CX_STATUS_OK) {
         printf("[VL53] Error init: %u\n", ret);
         return false;
     }
+    // boot time, nearly all of it the ~84 KB firmware upload
+    printf("[VL53] init done in %lu ms\n", (unsigned long)((time_us_64() - t0) / 1000u));
+    (void)t0;   // only printed, printf is stubbed out in the host build
 
     #ifdef VL53_SPI
     printf("[VL53] SPI1 baud: %u\n", vl53l8cx_spi_get_baudrate(&p_dev->platform));
@@ -81,6 +93,8 @@ bool vl53l8cx_init_driver(void)
 
 bool vl53l8cx_start_drv_ranging(void)
 {
+    if (vl53l8cx_get_resolution(p_dev, &vl53_zones) != VL53L8CX_STATUS_OK)
+        return false;
     if (vl53l8cx_start_ranging(p_dev) != VL53L8CX_STATUS_OK)
         return false;
 
@@ -97,51 +111,136 @@ static void vl53_print_center_zone(void)
     uint8_t s = vl53_results.target_status[27];
 
     printf("[VL53] center: %d mm (status=%u)\n", d, s);
+    (void)d;    // only printed, as t0 in vl53l8cx_init_driver()
+    (void)s;
 }
 
-
-void vl53l8cx_loop(void)
+/* nearest zone with a valid target (status 5, or 9 = valid with wrap), 0 = none */
+static uint16_t vl53_nearest_mm(void)
 {
-    uint8_t ready = 0;
-    static absolute_time_t last_time, current_time;
+    uint16_t best = 0;
 
-    if (!ranging_active)
-        return;
+    for (uint8_t z = 0; z < vl53_zones; z++) {
+        uint32_t i = (uint32_t)z * VL53L8CX_NB_TARGET_PER_ZONE;
+        uint8_t s = vl53_results.target_status[i];
+        int16_t d = vl53_results.distance_mm[i];
 
-    // Fast GPIO check first (cheap)
-    if (!vl53_platform_int_asserted(&(p_dev->platform)))
-        return;
+        if ((s == 5 || s == 9) && d > 0 && (best == 0 || (uint16_t)d < best))
+            best = (uint16_t)d;
+    }
+    return best;
+}
 
-    // Confirm with sensor
-    if (vl53l8cx_check_data_ready(p_dev, &ready) != VL53L8CX_STATUS_OK || !ready)
-        return;
+void vl53l8cx_frame_hook(vl53_frame_fn fn)
+{
+    vl53_frame_hook = fn;
+}
 
 
-    // Blocking SPI burst read (expected)
-    if (vl53l8cx_get_ranging_data(p_dev, &vl53_results) != VL53L8CX_STATUS_OK)
+/*
+ * Frame fetch. INT starts a DMA read of the whole frame into one of two
+ * buffers and the loop returns; later steps poll it, and the step after
+ * completion checks the header and converts the frame. The header is the
+ * one vl53l8cx_check_data_ready() reads (address 0, 4 bytes), so no
+ * separate blocking read is needed. Two buffers: the next frame can be
+ * fetched before the last one has been converted.
+ */
+static uint8_t s_frame[2][VL53L8CX_MAX_RESULTS_SIZE] __attribute__((aligned(4)));
+static uint8_t s_fill;              // buffer of the next fetch
+static int8_t  s_parse = -1;        // fetched, waiting for its conversion
+static bool    s_fetching;
+static vl53_fetch_stats_t s_fetch;
+
+static void vl53_parse(uint8_t *buf)
+{
+    static absolute_time_t last_time;
+    absolute_time_t current_time;
+    uint8_t ready = 0;
+
+    if (vl53l8cx_check_data_header(p_dev, buf, &ready) != VL53L8CX_STATUS_OK || !ready) {
+        s_fetch.stale++;            // INT seen again for a frame already read
         return;
+    }
+    if (vl53_frame_decode(buf, p_dev->data_read_size, &vl53_results) != VL53L8CX_STATUS_OK) {
+        s_fetch.corrupt++;
+        return;
+    }
+    s_fetch.frames++;
+    current_time = get_absolute_time();
+
+    #ifdef _VL53_CSV_DEBUG_
+    // one line per frame, format read by tools/pattern_render/vl53_scene_replay
+    printf("Z,%lu,%u", (unsigned long)to_ms_since_boot(current_time), vl53_zones);
+    for (uint8_t z = 0; z < vl53_zones; z++)
+        printf(",%d", vl53_results.distance_mm[z]);
+    for (uint8_t z = 0; z < vl53_zones; z++)
+        printf(",%u", vl53_results.target_status[z]);
+    printf("\n");
+    #endif // _VL53_CSV_DEBUG_
 
-    // Clear interrupt inside sensor - done automatically above when get ranging data
-    // vl53l8cx_clear_interrupt(&dev);
+    vl53_scene_frame(vl53_results.distance_mm, vl53_results.target_status, vl53_zones,
+                     to_ms_since_boot(current_time));
 
     // 1sec = 1000000
-    current_time = get_absolute_time();
     if (absolute_time_diff_us(last_time, current_time) > 300000) {
         last_time = current_time;
         vl53_print_center_zone();
     }
 
-    // vl53_print_center_zone();
+    if (vl53_frame_hook)
+        vl53_frame_hook(vl53_nearest_mm(), to_ms_since_boot(current_time));
+}
+
+void vl53l8cx_loop(void)
+{
+    if (!ranging_active)
+        return;
+
+    if (s_fetching) {
+        int r = vl53_read_poll(&(p_dev->platform));
+        if (r == VL53_READ_BUSY)
+            return;
+        s_fetching = false;
+        if (r == VL53_READ_DONE) {
+            s_parse = (int8_t)s_fill;
+            s_fill ^= 1u;
+        } else {
+            s_fetch.errors++;
+        }
+        return;                     // converted on the next step
+    }
+
+    // Fast GPIO check first (cheap)
+    if (vl53_platform_int_asserted(&(p_dev->platform)) &&
+        vl53_read_start(&(p_dev->platform), 0x0, s_frame[s_fill], p_dev->data_read_size)) {
+        s_fetching = true;
+    }
 
-        // if (vl53_results.target_status[27] == 5)
-        //     use distance
-        // else
-        //     ignore
+    if (s_parse >= 0) {
+        vl53_parse(s_frame[s_parse]);
+        s_parse = -1;
+    }
+}
 
-    // TODO:
-    // - copy results to application buffer
-    // - signal new frame available
+const vl53_fetch_stats_t *vl53l8cx_fetch_stats(void)
+{
+    return &s_fetch;
+}
+
+#ifdef VL53_DRV_HOST
+/* tools/pattern_render/vl53_fetch_sim: ranging as if vl53l8cx_start_ranging() had run */
+void vl53l8cx_drv_host_start(uint32_t data_read_size)
+{
+    while (s_fetching && vl53_read_poll(&(p_dev->platform)) == VL53_READ_BUSY) {
+    }
+    s_fetching = false;
+    s_parse = -1;
+    memset(&s_fetch, 0, sizeof(s_fetch));
+    p_dev->data_read_size = data_read_size;
+    p_dev->streamcount = 255;
+    ranging_active = true;
 }
+#endif // VL53_DRV_HOST
 
 
 
@@ -15,11 +15,24 @@ bool vl53l8cx_init_driver(void);
 // Start ranging (after init)
 bool vl53l8cx_start_drv_ranging(void);
 
-// Call repeatedly from main loop
+// Call repeatedly from main loop; never waits for the bus
 void vl53l8cx_loop(void);
 
+typedef struct {
+    uint32_t frames;        // converted and passed to the frame hook
+    uint32_t stale;         // fetched, but not a new frame (header check)
+    uint32_t corrupt;       // header and footer ids differ
+    uint32_t errors;        // bus errors and timeouts of the fetch
+} vl53_fetch_stats_t;
+
+const vl53_fetch_stats_t *vl53l8cx_fetch_stats(void);
+
 VL53L8CX_Configuration *vl53_get_dev(void);
 
+// Called from vl53l8cx_loop() per frame: nearest valid zone in mm (0 = none)
+typedef void (*vl53_frame_fn)(uint16_t nearest_mm, uint32_t t_ms);
+void vl53l8cx_frame_hook(vl53_frame_fn fn);
+
 
 // #pragma once
 // #include <stdbool.h>
@@ -183,40 +183,6 @@ void vl53_gpio_init(vl53l8cx_platform_t *p_platform)
 }
 
 
-static const char *gpio_func_name(gpio_function_t f) {
-    switch (f) {
-        case GPIO_FUNC_HSTX:  return "HSTX";
-        case GPIO_FUNC_SPI:  return "SPI";
-        case GPIO_FUNC_UART: return "UART";
-        case GPIO_FUNC_I2C:  return "I2C";
-        case GPIO_FUNC_PWM:  return "PWM";
-        case GPIO_FUNC_SIO:  return "SIO";
-        case GPIO_FUNC_PIO0: return "PIO0";
-        case GPIO_FUNC_PIO1: return "PIO1";
-        case GPIO_FUNC_PIO2: return "PIO2";
-        case GPIO_FUNC_GPCK: return "GPCK";
-        case GPIO_FUNC_USB: return "USB";
-        case GPIO_FUNC_UART_AUX: return "AUX";
-        case GPIO_FUNC_NULL: return "NULL1";
-        default:             return "NULL";
-    }
-}
-static void print_one_gpio(uint pin, const char *name)
-{
-    // if (pin < 0) {
-    //     printf("  %-8s: (not connected)\r\n", name);
-    //     return;
-    // }
-
-    bool level = gpio_get(pin);
-    bool is_out = gpio_is_dir_out(pin);
-    gpio_function_t fn = gpio_get_function(pin);
-
-    // Pulls (SDK does not expose direct readback of pull config; we report level/dir/func only)
-    printf("  %-8s: GP%-2d  level=%d  dir=%s  func=%s\r\n",
-          name, pin, (int)level, is_out ? "OUT" : "IN ", gpio_func_name(fn));
-}
-
 
 #ifdef VL53_SPI
 /* -------------------------------------------------------------------------- */
@@ -262,52 +228,284 @@ static inline void vl53_spi_read(
     spi_read_blocking(p_platform->spi_port, 0x00, buf, len);
     vl53_cs_deselect(p_platform->pin_cs);
 }
+
+bool vl53_read_start(vl53l8cx_platform_t *p_platform, uint16_t index, uint8_t *dst, uint32_t size)
+{
+    vl53_spi_read(p_platform, index, dst, size);       // no DMA path for SPI yet: done on return
+    return true;
+}
+
+int vl53_read_poll(vl53l8cx_platform_t *p_platform)
+{
+    (void)p_platform;
+    return VL53_READ_DONE;
+}
 #else
 #define I2C_SUCCESS 0
 #define I2C_FAILED 1
 #define I2C_BUFFER_EXCEEDED 2
 
 // #define I2C_DEVICE i2c1
-#define MAX_I2C_BUFFER 0x8100
 
+#define VL53_I2C_EVT_ABORT  0x1u        // TX_ABRT: NACK, lost arbitration or our abort
+#define VL53_I2C_EVT_STOP   0x2u        // STOP_DET: the transaction is over
+#define VL53_I2C_ABORT_US   10000       // STOP after an abort
+
+// TX FIFO entries, laid out as IC_DATA_CMD: data byte plus these
+#define VL53_I2C_READ       0x100u
+#define VL53_I2C_STOP       0x200u      // STOP after this byte
+#define VL53_I2C_RESTART    0x400u      // repeated START before this byte
+
+#ifdef VL53_PLATFORM_HOST
+/* controller access, provided by the host bus model */
+void     vl53_i2c_tx_begin(i2c_inst_t *i2c, uint8_t addr_7_bits);
+uint32_t vl53_i2c_tx_room(i2c_inst_t *i2c);
+void     vl53_i2c_tx_push(i2c_inst_t *i2c, uint32_t cmd);
+uint32_t vl53_i2c_tx_events(i2c_inst_t *i2c);
+void     vl53_i2c_tx_abort(i2c_inst_t *i2c);
+bool     vl53_i2c_rx_dma_claim(void);
+void     vl53_i2c_rx_dma(i2c_inst_t *i2c, uint8_t *dst, uint32_t size);
+bool     vl53_i2c_rx_busy(i2c_inst_t *i2c);
+void     vl53_i2c_rx_cancel(i2c_inst_t *i2c);
+#else
+#include "hardware/dma.h"
+
+static void vl53_i2c_tx_begin(i2c_inst_t *i2c, uint8_t addr_7_bits)
+{
+    i2c_hw_t *hw = i2c_get_hw(i2c);
 
-int8_t i2c_write_register(VL53L8CX_Platform *p_platform, uint16_t index, uint8_t * values, uint32_t count){
-    // i2c_inst_t *i2c, char adresse_7_bits,
-    int stat;
-    uint8_t adresse_7_bits = p_platform->i2c_addr >> 1;
-    uint8_t buffer[MAX_I2C_BUFFER];
-    absolute_time_t timeout_time;
+    hw->enable = 0;
+    hw->tar = addr_7_bits;
+    hw->enable = 1;
+}
 
-    if(count > MAX_I2C_BUFFER - 2){
-            return I2C_BUFFER_EXCEEDED;
+/* free TX FIFO entries */
+static uint32_t vl53_i2c_tx_room(i2c_inst_t *i2c)
+{
+    return (uint32_t)i2c_get_write_available(i2c);
+}
+
+static void vl53_i2c_tx_push(i2c_inst_t *i2c, uint32_t cmd)
+{
+    i2c_get_hw(i2c)->data_cmd = cmd;
+}
+
+/* VL53_I2C_EVT_* seen since the last call, cleared on read */
+static uint32_t vl53_i2c_tx_events(i2c_inst_t *i2c)
+{
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    uint32_t raw = hw->raw_intr_stat, ev = 0;
+
+    if (raw & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+        (void)hw->clr_tx_abrt;
+        ev |= VL53_I2C_EVT_ABORT;
     }
+    if (raw & I2C_IC_RAW_INTR_STAT_STOP_DET_BITS) {
+        (void)hw->clr_stop_det;
+        ev |= VL53_I2C_EVT_STOP;
+    }
+    return ev;
+}
 
-    buffer[0] = (uint8_t)((index >> 8) & 0xFF);
-    buffer[1] = (uint8_t)(index & 0xFF);
+/* flush the FIFO and send STOP, the controller reports it as TX_ABRT */
+static void vl53_i2c_tx_abort(i2c_inst_t *i2c)
+{
+    hw_set_bits(&i2c_get_hw(i2c)->enable, I2C_IC_ENABLE_ABORT_BITS);
+}
+
+/* read commands, fed to IC_DATA_CMD as 32-bit words (a byte write would be replicated into bit 8) */
+static const uint32_t s_cmd_read = VL53_I2C_READ;
+static const uint32_t s_cmd_last = VL53_I2C_READ | VL53_I2C_STOP;
+static int s_dma_rx = -1, s_dma_cmd = -1, s_dma_last = -1;
 
-    for (uint32_t i=0; i<count; i++) {
-        buffer[2+i] = values[i];
+static bool vl53_i2c_rx_dma_claim(void)
+{
+    if (s_dma_rx < 0) {
+        s_dma_rx = dma_claim_unused_channel(false);
+        s_dma_cmd = dma_claim_unused_channel(false);
+        s_dma_last = dma_claim_unused_channel(false);
     }
+    return s_dma_rx >= 0 && s_dma_cmd >= 0 && s_dma_last >= 0;
+}
 
-    // Define timeout - now + 1s.
-    timeout_time = time_us_64() + 1000000;
+static void vl53_i2c_dma_start(int ch, uint dreq, volatile void *dst, const volatile void *src,
+                               uint32_t count, bool to_mem, int chain_to, bool trigger)
+{
+    dma_channel_config c = dma_channel_get_default_config((uint)ch);
+
+    channel_config_set_transfer_data_size(&c, to_mem ? DMA_SIZE_8 : DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, to_mem);
+    channel_config_set_dreq(&c, dreq);
+    if (chain_to >= 0)
+        channel_config_set_chain_to(&c, (uint)chain_to);
+    dma_channel_configure((uint)ch, &c, dst, src, count, trigger);
+}
 
-    print_one_gpio(p_platform->pin_sda, "SDA");
-    print_one_gpio(p_platform->pin_scl, "SCL");
-    print_one_gpio(p_platform->pin_cs, "CS ");
-    print_one_gpio(p_platform->pin_int, "INT");
-    printf("[VL53] [platform] i2c write addr=0x%x buf0=0x%x buf1=0x%x buf2=0x%x\n", adresse_7_bits<<1, buffer[0], buffer[1], buffer[2]);
-    // statu = i2c_write_blocking (i2c, adresse_7_bits, hdr, 2, 0);
-    stat = i2c_write_blocking_until (p_platform->i2c_port, adresse_7_bits, buffer, 2 + count, 0, timeout_time);
+/**
+ * Rest of a read whose first command the CPU queued: the bytes into dst,
+ * the read commands for bytes 2..size-1 and the last one with STOP, all by
+ * DMA paced by the controller's DREQs.
+ */
+static void vl53_i2c_rx_dma(i2c_inst_t *i2c, uint8_t *dst, uint32_t size)
+{
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+
+    vl53_i2c_dma_start(s_dma_rx, i2c_get_dreq(i2c, false), dst, &hw->data_cmd, size, true, -1, true);
+    if (size < 2)
+        return;
+    vl53_i2c_dma_start(s_dma_last, i2c_get_dreq(i2c, true), &hw->data_cmd, &s_cmd_last, 1, false, -1, size == 2);
+    if (size > 2)
+        vl53_i2c_dma_start(s_dma_cmd, i2c_get_dreq(i2c, true), &hw->data_cmd, &s_cmd_read, size - 2,
+                           false, s_dma_last, true);
+}
+
+static bool vl53_i2c_rx_busy(i2c_inst_t *i2c)
+{
+    (void)i2c;
+    return dma_channel_is_busy((uint)s_dma_rx);
+}
+
+static void vl53_i2c_rx_cancel(i2c_inst_t *i2c)
+{
+    (void)i2c;
+    dma_channel_abort((uint)s_dma_cmd);
+    dma_channel_abort((uint)s_dma_last);
+    dma_channel_abort((uint)s_dma_rx);
+}
+#endif // VL53_PLATFORM_HOST
+
+/* after an abort the controller flushes the FIFO and sends STOP */
+static void vl53_i2c_wait_stop(i2c_inst_t *i2c, uint32_t ev)
+{
+    uint64_t deadline = time_us_64() + VL53_I2C_ABORT_US;
+
+    while (!(ev & VL53_I2C_EVT_STOP) && time_us_64() < deadline)
+        ev |= vl53_i2c_tx_events(i2c);
+}
+
+/* twice the bus time of a transfer (9 clocks per byte) plus 10 ms */
+static uint64_t vl53_i2c_budget_us(const VL53L8CX_Platform *p_platform, uint32_t bytes)
+{
+    uint32_t khz = (p_platform->baudrate ? p_platform->baudrate : 1u) * 100u;
+
+    return (uint64_t)bytes * 18000u / khz + 10000u;
+}
 
-    if(stat == PICO_ERROR_GENERIC){
-        printf("Error: i2c write generic, addr:0x%x\n", adresse_7_bits << 1);
+static struct {
+    bool     active;
+    int      result;                // VL53_READ_DONE / _FAILED of the last read
+    uint32_t ev;
+    uint64_t deadline;
+} s_rd = { .result = VL53_READ_FAILED };
+
+/**
+ * Start reading size bytes from index into dst and return: the CPU queues
+ * the index and the first read command, DMA does the rest. false when a
+ * read is in flight or there are no DMA channels.
+ */
+bool vl53_read_start(vl53l8cx_platform_t *p_platform, uint16_t index, uint8_t *dst, uint32_t size)
+{
+    i2c_inst_t *i2c = p_platform->i2c_port;
+
+    if (s_rd.active || size == 0 || !vl53_i2c_rx_dma_claim())
+        return false;
+
+    vl53_i2c_tx_begin(i2c, (uint8_t)(p_platform->i2c_addr >> 1));
+    (void)vl53_i2c_tx_events(i2c);
+    vl53_i2c_tx_push(i2c, (uint32_t)(index >> 8));
+    vl53_i2c_tx_push(i2c, (uint32_t)(index & 0xFF));
+    vl53_i2c_tx_push(i2c, VL53_I2C_READ | VL53_I2C_RESTART | ((size == 1) ? VL53_I2C_STOP : 0u));
+    vl53_i2c_rx_dma(i2c, dst, size);
+
+    s_rd.active = true;
+    s_rd.result = VL53_READ_BUSY;
+    s_rd.ev = 0;
+    s_rd.deadline = time_us_64() + vl53_i2c_budget_us(p_platform, size + 3);
+    return true;
+}
+
+/* VL53_READ_BUSY until the last byte is in and STOP is on the bus */
+int vl53_read_poll(vl53l8cx_platform_t *p_platform)
+{
+    i2c_inst_t *i2c = p_platform->i2c_port;
+
+    if (!s_rd.active)
+        return s_rd.result;
+
+    s_rd.ev |= vl53_i2c_tx_events(i2c);
+    if (!(s_rd.ev & VL53_I2C_EVT_ABORT)) {
+        if (!vl53_i2c_rx_busy(i2c) && (s_rd.ev & VL53_I2C_EVT_STOP))
+            s_rd.result = VL53_READ_DONE;
+        else if (time_us_64() <= s_rd.deadline)
+            return VL53_READ_BUSY;
+        else
+            vl53_i2c_tx_abort(i2c);
+    }
+    if (s_rd.result != VL53_READ_DONE || (s_rd.ev & VL53_I2C_EVT_ABORT)) {
+        vl53_i2c_rx_cancel(i2c);
+        vl53_i2c_wait_stop(i2c, s_rd.ev);
+        s_rd.result = VL53_READ_FAILED;
+    }
+    s_rd.active = false;
+    return s_rd.result;
+}
+
+/* blocking callers share the bus: let a read in flight finish first */
+static void vl53_read_wait(vl53l8cx_platform_t *p_platform)
+{
+    while (s_rd.active && vl53_read_poll(p_platform) == VL53_READ_BUSY) {
+    }
+}
+
+/// @brief Blocking write of a register block as one I2C transaction
+/// @details The 2-byte index and then the payload go straight from the
+/// caller into the 16-entry TX FIFO, topped up as the bus drains it, with
+/// STOP on the last byte. The firmware image is sent from flash as is; no
+/// staging copy, so the stack cost no longer grows with count.
+/// @return I2C_SUCCESS, or I2C_FAILED after a NACK or a timeout
+int8_t i2c_write_register(VL53L8CX_Platform *p_platform, uint16_t index, const uint8_t *values, uint32_t count){
+    i2c_inst_t *i2c = p_platform->i2c_port;
+    uint8_t adresse_7_bits = p_platform->i2c_addr >> 1;
+    uint8_t hdr[2] = {
+        (uint8_t)((index >> 8) & 0xFF),
+        (uint8_t)(index & 0xFF)
+    };
+    uint32_t total = count + 2, sent = 0, ev = 0;
+    uint64_t deadline = time_us_64() + vl53_i2c_budget_us(p_platform, total);
+    bool aborting = false;
+
+    vl53_read_wait(p_platform);
+    vl53_i2c_tx_begin(i2c, adresse_7_bits);
+    (void)vl53_i2c_tx_events(i2c);     // STOP of an earlier read
+
+    // STOP follows the last byte, a NACK or an abort: the bus is free again after it
+    while (!(ev & VL53_I2C_EVT_STOP)) {
+        for (uint32_t room = (ev & VL53_I2C_EVT_ABORT) ? 0 : vl53_i2c_tx_room(i2c);
+             room && sent < total; room--, sent++)
+            vl53_i2c_tx_push(i2c, ((sent < 2) ? hdr[sent] : values[sent - 2]) |
+                                  ((sent + 1 == total) ? VL53_I2C_STOP : 0u));
+        ev |= vl53_i2c_tx_events(i2c);
+
+        if (!(ev & VL53_I2C_EVT_STOP) && time_us_64() > deadline) {
+            if (aborting) {
+                printf("Error: i2c write stuck, addr:0x%x\n", adresse_7_bits << 1);
+                return I2C_FAILED;
+            }
+            vl53_i2c_tx_abort(i2c);
+            aborting = true;
+            deadline = time_us_64() + VL53_I2C_ABORT_US;
+        }
+    }
+
+    if (aborting) {
+        printf("Error: i2c write timeout, addr:0x%x at %u/%u\n", adresse_7_bits << 1, (unsigned)sent, (unsigned)total);
         return I2C_FAILED;
-    } else if(stat == PICO_ERROR_TIMEOUT){
-        printf("Error: i2c write timeout, addr:0x%x\n", adresse_7_bits << 1);
+    }
+    if (ev & VL53_I2C_EVT_ABORT) {
+        printf("Error: i2c write nack, addr:0x%x\n", adresse_7_bits << 1);
         return I2C_FAILED;
     }
-
     return I2C_SUCCESS;
 }
 
@@ -336,6 +534,7 @@ int8_t i2c_read_register(VL53L8CX_Platform *p_platform, uint16_t index, uint8_t
         // index_to_unint8[0] =  (index >> 8) & 0xFF;
         // index_to_unint8[1] =  index & 0xFF;
 
+    vl53_read_wait(p_platform);
     statu = i2c_write_blocking (p_platform->i2c_port, adresse_7_bits, hdr, 2, 0);
     if(statu == PICO_ERROR_GENERIC){
         // printf("I2C - Write - Envoi registre Echec %x\n", adresse_7_bits);
@@ -374,7 +573,7 @@ uint8_t RdByte(
     status = i2c_read_register(p_platform, RegisterAdress, p_value, 1);
     vl53_cs_set_inactive(p_platform);
 
-    if (status < 0) {
+    if (status != I2C_SUCCESS) {
         return 255; // Custom error code for failure
     }
     return 0; // Success
@@ -396,7 +595,7 @@ uint8_t WrByte(
     vl53_cs_set_active(p_platform);
     status = i2c_write_register(p_platform, RegisterAdress, &value, 1);
     vl53_cs_set_inactive(p_platform);
-    if (status < 0) {
+    if (status != I2C_SUCCESS) {
         return 255; // Custom error code for failure
     }
     return 0; // Success
@@ -420,7 +619,7 @@ uint8_t RdMulti(
     vl53_cs_set_active(p_platform);
     status = i2c_read_register(p_platform, RegisterAdress, p_values, size);
     vl53_cs_set_inactive(p_platform);
-    if (status < 0) {
+    if (status != I2C_SUCCESS) {
         return 255; // Custom error code for failure
     }
     return 0; // Success
@@ -443,7 +642,7 @@ uint8_t WrMulti(
     vl53_cs_set_active(p_platform);
     status = i2c_write_register(p_platform, RegisterAdress, p_values, size);
     vl53_cs_set_inactive(p_platform);
-    if (status < 0) {
+    if (status != I2C_SUCCESS) {
         return 255; // Custom error code for failure
     }
     return 0; // Success
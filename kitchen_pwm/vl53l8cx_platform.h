@@ -65,6 +65,18 @@ void vl53_gpio_init(vl53l8cx_platform_t *p_platform);
 uint vl53l8cx_spi_get_baudrate(vl53l8cx_platform_t *p_platform);
 #endif // VL53_SPI
 
+/*
+ * Non-blocking block read for the ranging data: on I2C the controller paces
+ * DMA into dst, the main loop polls. One read at a time; the blocking calls
+ * below wait for it first. dst stays in use until the poll is not BUSY.
+ */
+#define VL53_READ_BUSY      0
+#define VL53_READ_DONE      1
+#define VL53_READ_FAILED    (-1)
+
+bool vl53_read_start(vl53l8cx_platform_t *p_platform, uint16_t index, uint8_t *dst, uint32_t size);
+int  vl53_read_poll(vl53l8cx_platform_t *p_platform);
+
 void vl53_cs_set_active(vl53l8cx_platform_t *p_platform);
 void vl53_cs_set_inactive(vl53l8cx_platform_t *p_platform);
 
@@ -65,11 +65,12 @@
  * connect example:
  *   $ nc 192.168.14.225 5000
  *   $ telnet 192.168.14.225 5000
+ * Every client gets its own socket, TCP_CLI_SOCKET .. + TCP_CLI_SESSIONS - 1.
  */
-#define TCP_CLI_SOCKET      0
+#define TCP_CLI_SOCKET      2
+#define TCP_CLI_SESSIONS    3      // sockets 2, 3, 4
 #define TCP_CLI_PORT        5000
 #define CLI_TIMEOUT         20   // 20 seconds
-#define CLI_BUF_RX_SIZE     1024
 
 /**
  * An Over-The-Air (OTA) software update mechanism
@@ -86,6 +87,25 @@
 #define UDP_DDP_SOCKET      5      // with port UDP_DDP_PORT 4048
 #define UDP_DDP_PORT        4048
 
+/**
+ * Live telemetry: counters and histograms as binary UDP datagrams
+ * (common/utils/telemetry.h), received with
+ *   $ python3 tools/telemetry/tlm_recv.py
+ * Receiver and period can be changed with "tlm dest" and "tlm rate".
+ */
+#define UDP_TLM_SOCKET      6
+#define UDP_TLM_PORT        3000   // local port and receiver port
+#define UDP_TLM_DESTIP      {192, 168, 178, 200}
+#define UDP_TLM_PERIOD_MS   1000   // 0 = off until "tlm rate"
+
+/**
+ * Deferred log (common/utils/dlog.h): text lines as UDP datagrams after
+ * "log udp <a.b.c.d> [port]" on the CLI, received with e.g.
+ *   $ nc -ukl 3001
+ */
+#define UDP_LOG_SOCKET      7
+#define UDP_LOG_PORT        3001   // local port and default receiver port
+
 /**
  * Configuration for future
  */
@@ -93,12 +113,6 @@
 // #define TCP_HTTP_PORT    80
 // #define TCP_OTA_SOCKET   2
 // #define TCP_OTA_PORT     4242
-//  Remote logging & variable view (for live debug)
-//  Example: a UDP packet every second with JSON text like
-//  {"t":27.5,"uptime":3221,"fps":60}
-// #define UDP_DEB_SOCKET   3
-// #define UDP_DESTIP       192.168.14.200
-// #define UDP_DESTPORT     3000
 
 /**
  * Configuration for WS2815 LED strip
@@ -107,6 +121,7 @@
 #define NUM_PIXELS          57  // number of pixels per strip, steps: 1-14=55px; 15-16=57px
 #define NUM_STRIPS          16  // number of parallel strips being driven
 #define WS2815_PIN_BASE     0   // first GPIO of 16 used for parallel output
+// #define WS2815_CORE1            // patterns, transpose and DMA on core 1; network stays on core 0
 
 #define _LOOPBACK_DEBUG_    // Enable LOOPBACK debug messages on USB
 #define _DDP_DEBUG_         // Enable DDP debug messages on USB
@@ -14,6 +14,8 @@
 #include <math.h>
 
 #include "config.h"
+#include "prng.h"
+#include "led_pattern.h"
 
 
 // dir == 1 ? "(forward)" : dir ? "(backward)" : "(still)" dir = [-1, 0, 1]
@@ -96,16 +98,30 @@ static uint32_t start_column_pos[NUM_PIXELS];  // random start positions for pat
 static uint8_t start_column_sel_color[NUM_PIXELS];  // random color selection for columns
 
 
+/**
+ * Start positions come from a seeded PRNG stream, per-pixel randomness from
+ * prng_hash() of (pixel, frame), so every pattern is reproducible from the seed.
+ */
+static uint32_t pattern_seed = LED_PATTERN_SEED;
+static prng_t start_rng;
+
+void led_pattern_seed(uint32_t seed) {
+    pattern_seed = seed;
+    prng_seed(&start_rng, seed, 0);
+}
+
 void init_start_strips(void) {
     uint16_t y, x;
     uint8_t color, r, g, b, val;
 
+    led_pattern_seed(pattern_seed);
+
     for (y = 0; y < NUM_STRIPS; ++y) {
-        start_strip_pos[y] = (uint32_t)(rand() % NUM_PIXELS);
+        start_strip_pos[y] = prng_below(&start_rng, NUM_PIXELS);
     }
     for (y = 0; y < NUM_STRIPS; ++y) {
-        color = (typeof(color))(rand() % 7);
-        val = (typeof(val))(rand() % 256);
+        color = (typeof(color))prng_below(&start_rng, 7);
+        val = (typeof(val))prng_u32(&start_rng);
         r = (color & 0x4) ? val : 0;
         g = (color & 0x2) ? val : 0;
         b = (color & 0x1) ? val : 0;
@@ -113,10 +129,10 @@ void init_start_strips(void) {
         start_strip_color[y] = urgb_u32(r, g, b);
     }
     for (x = 0; x < NUM_PIXELS; ++x) {
-        start_column_pos[x] = (uint32_t)(rand() % NUM_STRIPS);
+        start_column_pos[x] = prng_below(&start_rng, NUM_STRIPS);
     }
     for (x = 0; x < NUM_PIXELS; ++x) {
-        start_column_sel_color[x] = (uint8_t)(rand() % 8);
+        start_column_sel_color[x] = (uint8_t)(prng_u32(&start_rng) & 0x7);
     }
 
     for (y = 0; y < sizeof(linear_brightness_percent); y++) {
@@ -164,8 +180,9 @@ void pattern_random(uint8_t *buffer, uint strips, uint pixels) {
      for ( y = 0; y < strips; ++y) {
         current_strip_out = buffer + y * pixels * NUM_CHANNELS;
         for (uint i = 0; i < pixels; ++i) {
-            color = (typeof(color))(rand() % 7);
-            val = (typeof(val))(rand() % 256);
+            uint32_t rnd = prng_hash(pattern_seed, y * pixels + i, t);
+            color = (typeof(color))(((rnd & 0xFFFF) * 7) >> 16);
+            val = (typeof(val))(rnd >> 24);
             r = (color & 0x4) ? val : 0;
             g = (color & 0x2) ? val : 0;
             b = (color & 0x1) ? val : 0;
@@ -188,7 +205,7 @@ void pattern_sparkle(uint8_t *buffer, uint strips, uint pixels) {
     for ( y = 0; y < strips; ++y) {
         current_strip_out = buffer + y * pixels * NUM_CHANNELS;
         for (uint i = 0; i < pixels; ++i) {
-            if (!flip && rand() % 32 == 0) {
+            if (!flip && (prng_hash(pattern_seed, y * pixels + i, t) & 0x1F) == 0) {
                 put_pixel(urgb_u32(0xff, 0xff, 0xff));
             } else {
                 put_pixel(0);
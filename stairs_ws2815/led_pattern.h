@@ -7,6 +7,11 @@
 #define LED_PATTERN_H
 #include <stdint.h>
 
+#ifndef LED_PATTERN_SEED
+#define LED_PATTERN_SEED    0xA341316Cu     // default seed of the pattern PRNG streams
+#endif
+
+void led_pattern_seed(uint32_t seed);
 void init_start_strips(void);
 // typedef void (*pattern_func_t)(uint len, uint t);
 // typedef void (*pattern)(uint len, uint t);
@@ -17,6 +17,14 @@
 // #include "generated/ws2815_parallel.pio.h"
 #include "ws2815.pio.h"
 #include "led_pattern.h"
+#include "prng.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "dlog.h"
+#ifdef WS2815_CORE1
+#include "pico/multicore.h"
+#include "spsc_queue.h"
+#endif // WS2815_CORE1
 
 
 // --------------  old structures and defines from ws2812_parallel.c  ----------------
@@ -28,7 +36,9 @@ typedef struct {
 
 // One color bit plane (uint32_t) consists of bits for all strips at given bit position
 // For NUM_STRIPS strips, we need NUM_PIXELS * NUM_CHANNELS such planes
-static value_bits_t colors[NUM_PIXELS * NUM_CHANNELS];
+// Two sets: the next frame is transposed while DMA still reads the current one
+static value_bits_t colors[2][NUM_PIXELS * NUM_CHANNELS];
+static uint8_t colors_back = 0;
 
 
 // ------------------- Framebuffer for display 2D (NUM_PIXELS * NUM_STRIPS) patterns ------------------
@@ -43,6 +53,23 @@ uint32_t ddp_update_timeout = 0;
 bool ddp_update_framebuf = false;
 bool patern_update_framebuf = false;
 
+#ifdef WS2815_CORE1
+/**
+ * DDP frames handed from core 0 to core 1.
+ * A buffer index is owned by exactly one side at a time:
+ *  - in fb_free_q or held by ws2815_show(): core 0 may write it
+ *  - in fb_ready_q or being transposed:    core 1 reads it
+ * Core 1 renders patterns into framebuf, which only it touches.
+ */
+#define DDP_FB_COUNT 3
+static strip_buffer_t ddp_fb[DDP_FB_COUNT][NUM_STRIPS];
+static spsc_queue_t fb_free_q;      // core 1 -> core 0
+static spsc_queue_t fb_ready_q;     // core 0 -> core 1
+static volatile uint32_t core1_frames_out;
+static volatile uint32_t core0_frames_dropped;     // no free buffer in ws2815_show
+static volatile uint32_t core1_frames_dropped;     // superseded by a newer frame
+#endif // WS2815_CORE1
+
 // ---------------- DMA control code ----------------
 // bit plane content dma channel
 #define DMA_CHANNEL 0
@@ -60,6 +87,8 @@ static uintptr_t fragment_start[NUM_PIXELS * NUM_CHANNELS + 1];
 static struct semaphore reset_delay_complete_sem;
 // alarm handle for handling delay
 alarm_id_t reset_delay_alarm_id;
+// start of the running DMA, TLM_DMA_US
+static uint32_t dma_start_us;
 
 int64_t reset_delay_complete(__unused alarm_id_t id, __unused void *user_data) {
     reset_delay_alarm_id = 0;
@@ -72,6 +101,8 @@ void __isr dma_complete_handler() {
     if (dma_hw->ints0 & DMA_CHANNEL_MASK) {
         // clear IRQ
         dma_hw->ints0 = DMA_CHANNEL_MASK;
+        tlm_sample(TLM_DMA_US, time_us_32() - dma_start_us);
+        TRACE_ASYNC_END(TR_DMA, 0, 0);
         // when the dma is complete we start the reset delay timer
         if (reset_delay_alarm_id) cancel_alarm(reset_delay_alarm_id);
         reset_delay_alarm_id = add_alarm_in_us(400, reset_delay_complete, NULL, true);  // for ws2815 reset time is 280us
@@ -113,6 +144,8 @@ void output_strips_dma(value_bits_t *bits, uint value_length) {
         fragment_start[i] = (uintptr_t) bits[i].planes; // MSB first
     }
     fragment_start[value_length] = 0;
+    dma_start_us = time_us_32();
+    TRACE_ASYNC_BEGIN(TR_DMA, 0, value_length);
     dma_channel_hw_addr(DMA_CB_CHANNEL)->al3_read_addr_trig = (uintptr_t) fragment_start;
 }
 
@@ -225,11 +258,14 @@ void transform_framebuf(strip_buffer_t *strips, uint num_strips, value_bits_t *v
 #define PAT_ZERO    201
 #define PAT_IDLE    202
 uint8_t pattern_index = 0x00, pattern_last_index;
+static prng_t auto_rng;            // PAT_AUTO pattern selection
 
 void ws2815_init(void) {
     PIO pio;
     uint sm;
     uint offset;
+
+    prng_seed(&auto_rng, LED_PATTERN_SEED, 1);     // own stream, PAT_AUTO order is reproducible
     // This function initializes the PIO and DMA for WS2815 control.
     bool success = pio_claim_free_sm_and_add_program_for_gpio_range(&ws2815_parallel_program, \
                                                                     &pio, &sm, &offset, \
@@ -302,7 +338,7 @@ void ws2815_pattern_loop(uint32_t period_ms) {
             loop_count = 0;
             // change pattern
 
-            uint tmp = (uint)((unsigned)rand() % count_of(pattern_table));
+            uint tmp = (uint)prng_below(&auto_rng, count_of(pattern_table));
             pat = (typeof(pat))(tmp);
             // pat = (typeof(pat))(rand() % (count_of(pattern_table)));
 
@@ -326,10 +362,16 @@ void ws2815_pattern_loop(uint32_t period_ms) {
         return;
     }
 
+    uint32_t t_render = time_us_32();
+    TRACE_BEGIN(TR_RENDER, pat, 0);
     pattern_table[pat].pat(&framebuf[0][0][0], NUM_STRIPS, NUM_PIXELS);
+    TRACE_END(TR_RENDER, pat, 0);
+    tlm_sample(TLM_RENDER_US, time_us_32() - t_render);
     patern_update_framebuf = true;
 }
 
+static void ws2815_output(strip_buffer_t *fb);
+
 /**
  * Main loop function called periodically (2 ms) to manage WS2815 output
  */
@@ -343,8 +385,23 @@ void ws2815_loop(uint32_t period_ms) {
     ddp_update_framebuf = false;
     patern_update_framebuf = false;
 
+    ws2815_output(framebuf);
+}
+
+/**
+ * Transpose one frame into the back bit-plane set and start its DMA as soon
+ * as the previous frame (and its reset delay) is finished.
+ */
+static void ws2815_output(strip_buffer_t *fb) {
+    static uint32_t last_us;        // TLM_FRAME_GAP_US
+    value_bits_t *planes = colors[colors_back];
+    uint32_t t_encode = time_us_32();
+
+    TRACE_BEGIN(TR_ENCODE, colors_back, 0);
     // transform_strips(strips, count_of(strips), colors, NUM_PIXELS * NUM_CHANNELS);  // , brightness
-    transform_framebuf(framebuf, count_of(framebuf), colors, NUM_PIXELS * NUM_CHANNELS);
+    transform_framebuf(fb, NUM_STRIPS, planes, NUM_PIXELS * NUM_CHANNELS);
+    TRACE_END(TR_ENCODE, colors_back, 0);
+    tlm_sample(TLM_ENCODE_US, time_us_32() - t_encode);
 
     //for(int c=0; c<3; c++) {
     //    printf("Color:%d\n", c);
@@ -356,12 +413,29 @@ void ws2815_loop(uint32_t period_ms) {
 
     sem_acquire_blocking(&reset_delay_complete_sem);
             // output_strips_dma(states[current], NUM_PIXELS * NUM_CHANNELS);
-    output_strips_dma(colors, NUM_PIXELS * NUM_CHANNELS);
+    output_strips_dma(planes, NUM_PIXELS * NUM_CHANNELS);
     // output_plains_sm(pio, sm, colors, NUM_PIXELS * NUM_CHANNELS);
+    colors_back ^= 1u;
 
+    uint32_t now = time_us_32();
+    if (last_us)
+        tlm_sample(TLM_FRAME_GAP_US, now - last_us);
+    last_us = now;
+    tlm_count(TLM_LED_FRAMES, 1);
 }
 
 void ws2815_show(uint8_t *fb) {
+#ifdef WS2815_CORE1
+    uint8_t idx;
+
+    // no free buffer: core 1 is behind, drop this frame
+    if (!spsc_pop(&fb_free_q, &idx)) {
+        core0_frames_dropped++;
+        return;
+    }
+    memcpy(ddp_fb[idx], fb, sizeof(ddp_fb[0]));
+    spsc_push(&fb_ready_q, idx);
+#else
     strip_buffer_t *pixel;
     pixel = &framebuf[0];
 
@@ -369,6 +443,65 @@ void ws2815_show(uint8_t *fb) {
     ddp_update_framebuf = true;
     ddp_update_timeout = DDP_COM_TIMEOUT_MS;
     // printf("Framebuf recieved. Value pixel[0]=%#04x,%#04x,%#04x pixel[1]=%#04x,%#04x,%#04x\n", sb[0][0], sb[0][1], sb[0][2], sb[1][0], sb[1][1], sb[1][2]);
-    printf("Framebuf recieved. Value pixel[0]=%#04x,%#04x,%#04x pixel[1]=%#04x,%#04x,%#04x\n", pixel[0][0], pixel[0][1], pixel[0][2], pixel[1][0], pixel[1][1], pixel[1][2]);
+    DLOG_EVERY(1000, "Framebuf recieved. Value pixel[0]=%#04x,%#04x,%#04x\n", pixel[0][0][0], pixel[0][0][1], pixel[0][0][2]);
+#endif // WS2815_CORE1
+}
+
+#ifdef WS2815_CORE1
+/**
+ * Core 1: owns PIO, DMA (its IRQ is installed here) and the pattern engine.
+ * DDP frames win over patterns; only the newest queued DDP frame is shown.
+ */
+static void ws2815_core1_entry(void) {
+    uint32_t last_patt;
+    uint8_t idx, newer;
+
+    multicore_lockout_victim_init();    // let core 0 park us during flash writes
+    ws2815_init();
+    last_patt = to_ms_since_boot(get_absolute_time());
+
+    while (true) {
+        if (spsc_pop(&fb_ready_q, &idx)) {
+            while (spsc_pop(&fb_ready_q, &newer)) {
+                spsc_push(&fb_free_q, idx);
+                core1_frames_dropped++;
+                idx = newer;
+            }
+            ws2815_output(ddp_fb[idx]);
+            spsc_push(&fb_free_q, idx);     // DMA reads the bit planes, not ddp_fb
+            core1_frames_out++;
+            ddp_update_timeout = DDP_COM_TIMEOUT_MS;
+            continue;
+        }
+
+        uint32_t now = to_ms_since_boot(get_absolute_time());
+        if (now - last_patt >= 20) {
+            last_patt += 20;
+            ws2815_pattern_loop(20);
+        }
+        if (patern_update_framebuf) {
+            patern_update_framebuf = false;
+            ws2815_output(framebuf);
+            core1_frames_out++;
+        }
+    }
+}
+
+/**
+ * Called on core 0 instead of ws2815_init() and the periodic ws2815 tasks
+ */
+void ws2815_core1_launch(void) {
+    spsc_init(&fb_free_q);
+    spsc_init(&fb_ready_q);
+    for (uint8_t i = 0; i < DDP_FB_COUNT; i++)
+        spsc_push(&fb_free_q, i);
+
+    multicore_launch_core1(ws2815_core1_entry);
+}
+
+void ws2815_core1_stats(uint32_t *frames_out, uint32_t *frames_dropped) {
+    *frames_out = core1_frames_out;
+    *frames_dropped = core0_frames_dropped + core1_frames_dropped;
 }
+#endif // WS2815_CORE1
 
@@ -16,4 +16,8 @@ void ws2815_show(uint8_t *fb);
 uint8_t set_pattern_index(uint8_t index);
 uint8_t get_pattern_index(void);
 
+// WS2815_CORE1: patterns, transpose and DMA run on core 1
+void ws2815_core1_launch(void);
+void ws2815_core1_stats(uint32_t *frames_out, uint32_t *frames_dropped);
+
 #endif /* WS2815_CONTROL_DMA_PARALLEL_H */
@@ -0,0 +1,635 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Telnet CLI dispatcher (common/network/cli_cmd.c) driven with command
+ * strings, and its cost against the strcmp/strncmp chain it replaced.
+ *
+ *   cli_dispatch_test [-v] [-n lines] [-r seed]
+ *
+ * The command table is the one of kitchen_pwm with the common commands and
+ * the RD-03D ones. Checked: the tokenizer, one and two word names with the
+ * longer one winning, usage answers for wrong word counts and handler
+ * rejects, group usage ("config"), help, duplicate and overflowing tables,
+ * the typed argument parsers on their edge cases, and the lookup against a
+ * linear scan on random lines. Then the time per line of the lookup
+ * against the chain of kitchen_pwm/telnet.c before the tables, and of the
+ * typed argument parsing against sscanf().
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "cli_cmd.h"
+#include "prng.h"
+
+static uint32_t errors;
+static bool verbose;
+
+#define FAIL(...) do { if (errors++ < 10) printf(__VA_ARGS__); } while (0)
+
+static uint64_t cpu_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* ---------- socket model: what the client would read ---------- */
+static char out[8192];
+static size_t out_len;
+static uint32_t prompts;
+
+void cli_send(uint8_t sn, const char *msg)
+{
+    size_t n = strlen(msg);
+
+    (void)sn;
+    if (out_len + n < sizeof(out)) {
+        memcpy(out + out_len, msg, n + 1);
+        out_len += n;
+    }
+}
+
+void cli_flush(uint8_t sn, const char *msg)
+{
+    cli_send(sn, msg);
+    prompts++;
+}
+
+static void out_clear(void)
+{
+    out[0] = '\0';
+    out_len = 0;
+    prompts = 0;
+}
+
+/* ---------- command table ---------- */
+static bool h_ret = true;
+static uint32_t h_calls;
+static int h_argc;
+static char h_argv[CLI_ARGS_MAX][64];
+
+static bool h(const cli_ctx_t *ctx)
+{
+    h_calls++;
+    h_argc = ctx->argc;
+    for (int i = 0; i < ctx->argc; i++)
+        snprintf(h_argv[i], sizeof(h_argv[i]), "%s", ctx->argv[i]);
+    cli_flush(ctx->sn, "ok\r\n");
+    return h_ret;
+}
+
+static const cli_cmd_t app_cmds[] = {
+    { "rgbw",       "<r> <g> <b> <w>",          "Set RGBW",                 4, 4, h },
+    { "led",        "<w>",                      "Set the white LED",        1, 1, h },
+    { "fade",       "<r> <g> <b> <w> <ms>",     "Fade to RGBW",             5, 5, h },
+    { "rgb",        "<r> <g> <b>",              "Set color LEDs",           3, 3, h },
+    { "freq",       "<hz>",                     "PWM frequency",            1, 1, h },
+    { "tl",         "[<ease> <ms> <r> <g> <b> <w>]", "Timeline",            0, 6, h },
+    { "tl hold",    "<ms>",                     "Hold segment",             1, 1, h },
+    { "tl loop",    "<0|1>",                    "Repeat the timeline",      1, 1, h },
+    { "tl clear",   "",                         "Drop the timeline",        0, 0, h },
+    { "fx",         "[<n> <r> <g> <b> <w>]",    "Fixtures",                 0, 5, h },
+    { "ddp fmt",    "<rgbw8|rgb8|rgbw16le|tl>", "DDP payload format",       1, 1, h },
+    { "pwm status", "",                         "PWM state",                0, 0, h },
+    { "set",        "[p]",                      "Pattern index",            0, 1, h },
+    { "get",        "",                         "Pattern index",            0, 0, h },
+    { "auto",       "",                         "Presence automation",      0, 0, h },
+    { "auto on",    "",                         "Enable",                   0, 0, h },
+    { "auto off",   "",                         "Disable",                  0, 0, h },
+    { "auto hold",  "<ms>",                     "Hold",                     1, 1, h },
+    { "auto fade",  "<on_ms> <off_ms>",         "Fade times",               2, 2, h },
+    { "auto zone",  "<i> <ymax_mm> <bright>",   "Zone",                     3, 3, h },
+    { "auto save",  "",                         "Store",                    0, 0, h },
+    { "zone",       "",                         "Occupancy zones",          0, 0, h },
+    { "zone set",   "<i> <name> <bright> <x,y> <x,y> <x,y>..", "Polygon",   6, 9, h },
+    { "zone del",   "<i>",                      "Remove a zone",            1, 1, h },
+    { "zone timing", "<frames> <exit_ms>",      "Enter and exit timing",    2, 2, h },
+    { "zone save",  "",                         "Store the zones",          0, 0, h },
+    { "radar",      "",                         "RD-03D statistics",        0, 0, h },
+    { "tof",        "",                         "VL53L8CX state",           0, 0, h },
+    { "vl53 gpio",  "",                         "VL53 pins",                0, 0, h },
+    { "vl53 probe", "",                         "Probe the VL53 bus",       0, 0, h },
+    { "vl53 read",  "",                         "Read one VL53 frame",      0, 0, h },
+    { "vl53 start", "",                         "Start VL53 ranging",       0, 0, h },
+    { "cson",       "",                         NULL,                       0, 0, h },
+    { "csoff",      "",                         NULL,                       0, 0, h },
+};
+
+static const cli_cmd_t sys_cmds[] = {
+    { "info",           "",             "Board and firmware",       0, 0, h },
+    { "part",           "",             "Partitions",               0, 0, h },
+    { "tasks",          "",             "Task timing",              0, 0, h },
+    { "tasks reset",    "",             "Clear the task statistics", 0, 0, h },
+    { "config ip",      "<a.b.c.d>",    "Set IP address",           1, 1, h },
+    { "config sn",      "<a.b.c.d>",    "Set Subnet Mask",          1, 1, h },
+    { "config gw",      "<a.b.c.d>",    "Set Gateway",              1, 1, h },
+    { "config dns",     "<a.b.c.d>",    "Set DNS server",           1, 1, h },
+    { "config save",    "",             "Save config",              0, 0, h },
+    { "config show",    "",             "Show config",              0, 0, h },
+    { "config clean",   "",             "Clean config",             0, 0, h },
+    { "config default", "",             "Factory default",          0, 0, h },
+    { "exit",           "",             "Close the connection",     0, 0, h },
+};
+
+static const cli_cmd_t rd03d_cmds[] = {
+    { "rd03d status",  "",                  "RD-03D tracks",            0, 0, h },
+    { "rd03d predict", "",                  "RD-03D tracks now",        0, 0, h },
+    { "rd03d dump",    "<on|off|once|raw>", "RD-03D console dumps",     1, 1, h },
+};
+
+#define N_APP   ((uint8_t)(sizeof(app_cmds) / sizeof(app_cmds[0])))
+#define N_SYS   ((uint8_t)(sizeof(sys_cmds) / sizeof(sys_cmds[0])))
+#define N_RD    ((uint8_t)(sizeof(rd03d_cmds) / sizeof(rd03d_cmds[0])))
+
+static void register_all(void)
+{
+    cli_cmd_reset();
+    if (!cli_cmd_register(sys_cmds, N_SYS) || !cli_cmd_register(app_cmds, N_APP) ||
+        !cli_cmd_register(rd03d_cmds, N_RD))
+        FAIL("register: tables rejected\n");
+}
+
+/* one line through the dispatcher, with what the client reads */
+static bool run(const char *line)
+{
+    char buf[CLI_LINE_MAX];
+    bool known;
+
+    out_clear();
+    h_calls = 0;
+    snprintf(buf, sizeof(buf), "%s", line);
+    known = cli_cmd_dispatch(buf, 0);
+    if (verbose)
+        printf("> %s\n%s", line, out);
+    return known;
+}
+
+/* ---------- checks ---------- */
+static void test_tokenize(void)
+{
+    char line[128], *argv[CLI_ARGS_MAX];
+    int argc;
+
+    strcpy(line, "  a\tbb  ccc ");
+    argc = cli_cmd_tokenize(line, argv, CLI_ARGS_MAX);
+    if (argc != 3 || strcmp(argv[0], "a") || strcmp(argv[1], "bb") || strcmp(argv[2], "ccc"))
+        FAIL("tokenize: spaces and tabs, %d words\n", argc);
+
+    strcpy(line, " \t ");
+    if (cli_cmd_tokenize(line, argv, CLI_ARGS_MAX) != 0)
+        FAIL("tokenize: blank line\n");
+
+    strcpy(line, "a b c d e");
+    argc = cli_cmd_tokenize(line, argv, 3);
+    if (argc != 3 || strcmp(argv[2], "c d e"))
+        FAIL("tokenize: last word keeps the rest, got %d '%s'\n", argc, argc == 3 ? argv[2] : "");
+}
+
+static void expect_find(const char *line, const char *name, int words)
+{
+    char buf[128], *argv[CLI_ARGS_MAX];
+    int argc, w;
+    const cli_cmd_t *c;
+
+    snprintf(buf, sizeof(buf), "%s", line);
+    argc = cli_cmd_tokenize(buf, argv, CLI_ARGS_MAX);
+    c = cli_cmd_find(argc, argv, &w);
+    if ((name == NULL) != (c == NULL) || (c && (strcmp(c->name, name) || w != words)))
+        FAIL("find '%s': got '%s' (%d words), expected '%s'\n", line, c ? c->name : "-", w, name ? name : "-");
+}
+
+static void test_lookup(void)
+{
+    expect_find("rgbw 1 2 3 4", "rgbw", 1);
+    expect_find("rgb 1 2 3", "rgb", 1);
+    expect_find("rgbwx", NULL, 0);
+    expect_find("rg", NULL, 0);
+    expect_find("config ip 10.0.0.2", "config ip", 2);
+    expect_find("config   dns\t8.8.8.8", "config dns", 2);
+    expect_find("config", NULL, 0);
+    expect_find("tl lin 500 1 2 3 4", "tl", 1);
+    expect_find("tl hold 100", "tl hold", 2);
+    expect_find("tl", "tl", 1);
+    expect_find("tasks", "tasks", 1);
+    expect_find("tasks reset", "tasks reset", 2);
+    expect_find("zone timing 3 2000", "zone timing", 2);
+    expect_find("zone", "zone", 1);
+    expect_find("auto zone 0 1500 4095", "auto zone", 2);
+    expect_find("a", NULL, 0);
+    expect_find("zzz", NULL, 0);
+    expect_find("cson", "cson", 1);
+    expect_find("rd03d dump on", "rd03d dump", 2);
+}
+
+static void test_dispatch(void)
+{
+    if (!run("rgbw 1 2 3 4") || h_calls != 1 || h_argc != 4 || strcmp(h_argv[3], "4"))
+        FAIL("dispatch rgbw: calls %u argc %d\n", h_calls, h_argc);
+    if (prompts != 1)
+        FAIL("dispatch rgbw: %u prompts\n", prompts);
+
+    run("config   ip   192.168.1.9  ");
+    if (h_calls != 1 || h_argc != 1 || strcmp(h_argv[0], "192.168.1.9"))
+        FAIL("dispatch config ip: argc %d '%s'\n", h_argc, h_argv[0]);
+
+    run("tl inout 500 1 2 3 4");
+    if (h_calls != 1 || h_argc != 6 || strcmp(h_argv[0], "inout"))
+        FAIL("dispatch tl <ease>: argc %d\n", h_argc);
+
+    run("rgbw 1 2 3");
+    if (h_calls != 0 || strcmp(out, "Usage: rgbw <r> <g> <b> <w>\r\n") || prompts != 1)
+        FAIL("usage for too few words: '%s'\n", out);
+    run("tl hold 1 2");
+    if (h_calls != 0 || strncmp(out, "Usage: tl hold <ms>", 19))
+        FAIL("usage for too many words: '%s'\n", out);
+
+    h_ret = false;
+    run("led 99999");
+    h_ret = true;
+    if (h_calls != 1 || !strstr(out, "Usage: led <w>\r\n") || prompts != 2)
+        FAIL("usage after a handler reject: '%s'\n", out);
+
+    if (run("rgbwx 1") || strcmp(out, "Unknown command\r\n") || prompts != 1)
+        FAIL("unknown command: '%s'\n", out);
+    if (run("help2"))
+        FAIL("help2 taken as help\n");
+
+    if (!run("config") || h_calls != 0 || strncmp(out, "Usage:\r\n  config clean\r\n  config default\r\n", 40) ||
+        !strstr(out, "  config sn <a.b.c.d>\r\n") || strstr(out, "exit"))
+        FAIL("config alone: '%s'\n", out);
+    if (!run("config bogus") || !strstr(out, "config ip <a.b.c.d>"))
+        FAIL("config with an unknown word: '%s'\n", out);
+
+    if (!run("") || out_len != 0 || prompts != 1)
+        FAIL("empty line: '%s', %u prompts\n", out, prompts);
+    if (!run("   \t "))
+        FAIL("blank line\n");
+
+    // a line longer than the dispatcher keeps
+    char longline[1024];
+    memset(longline, 'x', sizeof(longline) - 1);
+    longline[sizeof(longline) - 1] = '\0';
+    out_clear();
+    cli_cmd_handle(longline, 0);
+    if (strcmp(out, "Unknown command\r\n"))
+        FAIL("long line: '%.40s'\n", out);
+}
+
+static void test_help(void)
+{
+    const char *p, *prev = NULL;
+    uint32_t lines = 0;
+
+    run("help");
+    for (p = strstr(out, "\r\n  "); p; p = strstr(p + 1, "\r\n  ")) {
+        if (prev && strncmp(prev + 4, "help", 4) && strncmp(p + 4, "help", 4) && strcmp(prev + 4, p + 4) > 0)
+            FAIL("help: not sorted at '%.20s'\n", p + 4);
+        prev = p;
+        lines++;
+    }
+    // every command with a help line, and help itself
+    if (lines != N_APP + N_SYS + N_RD - 2 + 1 || strstr(out, "cson") || prompts != 1)
+        FAIL("help: %u lines, %u prompts\n", lines, prompts);
+
+    run("help zone");
+    if (!strstr(out, "zone timing") || !strstr(out, "zone save") || strstr(out, "auto zone") || strstr(out, "rgbw"))
+        FAIL("help zone: '%s'\n", out);
+    run("help nothing");
+    if (strcmp(out, "No such command\r\n"))
+        FAIL("help nothing: '%s'\n", out);
+}
+
+static void test_register(void)
+{
+    static const cli_cmd_t dup[] = { { "radar", "", "again", 0, 0, h } };
+    static const cli_cmd_t self_dup[] = { { "new", "", "", 0, 0, h }, { "new", "", "", 0, 0, h } };
+    static cli_cmd_t many[CLI_CMDS_MAX];
+    static char names[CLI_CMDS_MAX][8];     // "c127"
+
+    if (cli_cmd_register(dup, 1))
+        FAIL("register: duplicate name taken\n");
+    if (cli_cmd_register(self_dup, 2))
+        FAIL("register: duplicate within a table taken\n");
+    if (!run("radar") || h_calls != 1)
+        FAIL("register: a rejected table changed the index\n");
+
+    for (int i = 0; i < CLI_CMDS_MAX; i++) {
+        snprintf(names[i], sizeof(names[i]), "c%03d", i);
+        many[i] = (cli_cmd_t){ names[i], "", "", 0, 0, h };
+    }
+    if (cli_cmd_register(many, CLI_CMDS_MAX))
+        FAIL("register: more than CLI_CMDS_MAX taken\n");
+    cli_cmd_reset();
+    if (!cli_cmd_register(many, CLI_CMDS_MAX) || !run("c127") || h_calls != 1 || !run("c000"))
+        FAIL("register: a full index\n");
+
+    // the app tables with room to spare, then a table that goes past the limit
+    register_all();
+    uint8_t room = (uint8_t)(CLI_CMDS_MAX - N_SYS - N_APP - N_RD);
+
+    if (room < 16)
+        FAIL("register: %u free of %u with all tables, no headroom\n", room, CLI_CMDS_MAX);
+    if (cli_cmd_register(many, (uint8_t)(room + 1)))
+        FAIL("register: %u commands taken with room for %u\n", room + 1, room);
+    if (run("c000") || !run("radar"))
+        FAIL("register: a table past the limit changed the index\n");
+    if (!cli_cmd_register(many, room) || !run("c000") || !run("radar"))
+        FAIL("register: the last %u slots\n", room);
+    register_all();
+}
+
+static void test_args(void)
+{
+    static const struct { const char *s; uint32_t min, max; bool ok; uint32_t v; } u[] = {
+        { "0", 0, 10, true, 0 },        { "10", 0, 10, true, 10 },      { "11", 0, 10, false, 0 },
+        { "49", 50, 100, false, 0 },    { "4294967295", 0, UINT32_MAX, true, UINT32_MAX },
+        { "4294967296", 0, UINT32_MAX, false, 0 }, { "99999999999", 0, UINT32_MAX, false, 0 },
+        { "-1", 0, 10, false, 0 },      { "+1", 0, 10, false, 0 },      { "1x", 0, 10, false, 0 },
+        { "", 0, 10, false, 0 },        { "0x10", 0, 100, false, 0 },   { "007", 0, 10, true, 7 },
+    };
+    static const struct { const char *s; bool ok; int32_t v; } i32[] = {
+        { "-16000", true, -16000 },     { "16000", true, 16000 },       { "16001", false, 0 },
+        { "-16001", false, 0 },         { "-", false, 0 },              { "--1", false, 0 },
+        { "-0", true, 0 },              { "3,4", false, 0 },
+    };
+    static const struct { const char *s; bool ok; } ip[] = {
+        { "192.168.1.1", true },        { "0.0.0.0", true },            { "255.255.255.255", true },
+        { "256.1.1.1", false },         { "1.2.3", false },             { "1.2.3.4.5", false },
+        { "1..2.3", false },            { "1.2.3.4 ", false },          { "01.2.3.4", true },
+        { "1.2.3.0004", false },        { "a.b.c.d", false },           { "", false },
+    };
+
+    for (size_t k = 0; k < sizeof(u) / sizeof(u[0]); k++) {
+        uint32_t v = 12345;
+        bool ok = cli_arg_u32(u[k].s, u[k].min, u[k].max, &v);
+        if (ok != u[k].ok || (ok && v != u[k].v) || (!ok && v != 12345))
+            FAIL("cli_arg_u32('%s', %u, %u): %d %u\n", u[k].s, u[k].min, u[k].max, ok, v);
+    }
+    for (size_t k = 0; k < sizeof(i32) / sizeof(i32[0]); k++) {
+        int32_t v = 12345;
+        bool ok = cli_arg_i32(i32[k].s, -16000, 16000, &v);
+        if (ok != i32[k].ok || (ok && v != i32[k].v))
+            FAIL("cli_arg_i32('%s'): %d %d\n", i32[k].s, ok, v);
+    }
+    int32_t v;
+    if (!cli_arg_i32("-2147483648", INT32_MIN, INT32_MAX, &v) || v != INT32_MIN ||
+        cli_arg_i32("2147483648", INT32_MIN, INT32_MAX, &v) || cli_arg_i32("-2147483649", INT32_MIN, INT32_MAX, &v))
+        FAIL("cli_arg_i32: int32 limits\n");
+    for (size_t k = 0; k < sizeof(ip) / sizeof(ip[0]); k++) {
+        uint8_t a[4] = { 9, 9, 9, 9 };
+        bool ok = cli_arg_ipv4(ip[k].s, a);
+        if (ok != ip[k].ok || (!ok && a[0] != 9))
+            FAIL("cli_arg_ipv4('%s'): %d\n", ip[k].s, ok);
+    }
+    uint8_t a[4];
+    if (!cli_arg_ipv4("10.20.30.40", a) || a[0] != 10 || a[1] != 20 || a[2] != 30 || a[3] != 40)
+        FAIL("cli_arg_ipv4: bytes\n");
+
+    static const char *const fmts[] = { "rgbw8", "rgb8", "rgbw16le", "tl" };
+    if (cli_arg_enum("rgb8", fmts, 4) != 1 || cli_arg_enum("tl", fmts, 4) != 3 || cli_arg_enum("rgb", fmts, 4) != -1)
+        FAIL("cli_arg_enum\n");
+
+    char w0[] = "1023", w1[] = "0", w2[] = "1024";
+    char *words[] = { w0, w1, w2 };
+    uint32_t vals[3];
+    if (!cli_args_u32(words, 2, 0, 1023, vals) || vals[0] != 1023 || cli_args_u32(words, 3, 0, 1023, vals))
+        FAIL("cli_args_u32\n");
+}
+
+/* ---------- lookup against a linear scan on random lines ---------- */
+static const cli_cmd_t *all[64];
+static uint32_t n_all;
+
+static const cli_cmd_t *linear_find(int argc, char **argv, int *words)
+{
+    char key[128];
+
+    for (int w = (argc >= 2) ? 2 : 1; w >= 1 && w <= argc; w--) {
+        snprintf(key, sizeof(key), "%s%s%s", argv[0], (w == 2) ? " " : "", (w == 2) ? argv[1] : "");
+        for (uint32_t i = 0; i < n_all; i++) {
+            if (strcmp(all[i]->name, key) == 0) {
+                *words = w;
+                return all[i];
+            }
+        }
+    }
+    *words = 0;
+    return NULL;
+}
+
+static prng_t rng;
+
+static const char *const vocab[] = {
+    "rgbw", "rgb", "rg", "rgbww", "led", "fade", "freq", "tl", "hold", "loop", "clear", "lin",
+    "fx", "ddp", "fmt", "pwm", "status", "set", "get", "auto", "on", "off", "zone", "del",
+    "timing", "save", "radar", "tof", "vl53", "gpio", "probe", "read", "start", "cson", "csoff",
+    "info", "part", "tasks", "reset", "config", "ip", "sn", "gw", "dns", "show", "clean",
+    "default", "exit", "rd03d", "predict", "dump", "1", "255", "10.0.0.1", "x", "", "help",
+};
+
+static void random_line(char *line, size_t size)
+{
+    uint32_t n = prng_below(&rng, 5);
+    size_t len = 0;
+
+    line[0] = '\0';
+    for (uint32_t i = 0; i < n; i++) {
+        const char *w = vocab[prng_below(&rng, (uint32_t)(sizeof(vocab) / sizeof(vocab[0])))];
+        const char *sep = prng_below(&rng, 4) ? " " : (prng_below(&rng, 2) ? "\t" : "   ");
+        len += (size_t)snprintf(line + len, size - len, "%s%s", i ? sep : (prng_below(&rng, 4) ? "" : " "), w);
+    }
+}
+
+static void test_random(uint32_t n)
+{
+    uint32_t mismatches = 0;
+
+    for (uint32_t i = 0; i < N_SYS; i++) all[n_all++] = &sys_cmds[i];
+    for (uint32_t i = 0; i < N_APP; i++) all[n_all++] = &app_cmds[i];
+    for (uint32_t i = 0; i < N_RD; i++) all[n_all++] = &rd03d_cmds[i];
+
+    for (uint32_t k = 0; k < n; k++) {
+        char line[128], *argv[CLI_ARGS_MAX];
+        int argc, w1, w2;
+
+        random_line(line, sizeof(line));
+        argc = cli_cmd_tokenize(line, argv, CLI_ARGS_MAX);
+        const cli_cmd_t *a = cli_cmd_find(argc, argv, &w1);
+        const cli_cmd_t *b = linear_find(argc, argv, &w2);
+        if (a != b || w1 != w2) {
+            if (mismatches++ < 5)
+                FAIL("random line %u: '%s' %s vs linear %s\n", k, line, a ? a->name : "-", b ? b->name : "-");
+        }
+    }
+    printf("  lookup vs linear scan: %u random lines, %u mismatches\n", n, mismatches);
+}
+
+/* ---------- cost against the chain ---------- */
+static volatile uint32_t sink;
+
+/* the branch selection of kitchen_pwm/telnet.c before the tables, in its order */
+static int chain(const char *cmd)
+{
+    if (strcmp(cmd, "help") == 0) return 0;
+    if (strcmp(cmd, "info") == 0) return 1;
+    if (strcmp(cmd, "part") == 0) return 2;
+    if (strncmp(cmd, "tasks", 5) == 0) return 3;
+    if (strncmp(cmd, "rgbw", 4) == 0) return 4;
+    if (strncmp(cmd, "led", 3) == 0) return 5;
+    if (strncmp(cmd, "fade", 4) == 0) return 6;
+    if (strncmp(cmd, "rgb", 3) == 0) return 7;
+    if (strncmp(cmd, "freq", 4) == 0) return 8;
+    if (strncmp(cmd, "tl", 2) == 0 && (cmd[2] == ' ' || cmd[2] == '\0')) return 9;
+    if (strncmp(cmd, "fx", 2) == 0 && (cmd[2] == ' ' || cmd[2] == '\0')) return 10;
+    if (strncmp(cmd, "auto", 4) == 0 && (cmd[4] == ' ' || cmd[4] == '\0')) return 11;
+    if (strncmp(cmd, "zone", 4) == 0 && (cmd[4] == ' ' || cmd[4] == '\0')) return 12;
+    if (strcmp(cmd, "radar") == 0) return 13;
+    if (strcmp(cmd, "tof") == 0) return 14;
+    if (strncmp(cmd, "ddp fmt", 7) == 0) return 15;
+    if (strncmp(cmd, "pwm status", 10) == 0) return 16;
+    if (strncmp(cmd, "set", 3) == 0) return 17;
+    if (strcmp(cmd, "get") == 0) return 18;
+    if (strcmp(cmd, "vl53 gpio") == 0) return 19;
+    if (strcmp(cmd, "vl53 spi") == 0) return 20;
+    if (strcmp(cmd, "vl53 probe") == 0) return 21;
+    if (strcmp(cmd, "vl53 raw") == 0) return 22;
+    if (strcmp(cmd, "vl53 read") == 0) return 23;
+    if (strcmp(cmd, "vl53 start") == 0) return 24;
+    if (strcmp(cmd, "cson") == 0) return 25;
+    if (strcmp(cmd, "csoff") == 0) return 26;
+    if (strncmp(cmd, "config", 6) == 0) {
+        const char *p = cmd + 6;
+        while (*p == ' ') p++;
+        if (strncmp(p, "ip", 2) == 0 && p[2] == ' ') return 27;
+        if (strncmp(p, "sn", 2) == 0 && p[2] == ' ') return 28;
+        if (strncmp(p, "gw", 2) == 0 && p[2] == ' ') return 29;
+        if (strncmp(p, "dns", 3) == 0 && p[3] == ' ') return 30;
+        if (strcmp(p, "save") == 0) return 31;
+        if (strcmp(p, "show") == 0) return 32;
+        return 33;
+    }
+    if (strcmp(cmd, "exit") == 0) return 34;
+    return -1;
+}
+
+static bool h_null(const cli_ctx_t *ctx)
+{
+    sink += (uint32_t)ctx->argc;
+    return true;
+}
+
+static void bench(uint32_t n)
+{
+    static const char *const lines[] = {
+        "rgbw 1023 512 0 4095", "led 100", "fade 1 2 3 4 500", "freq 1000", "tl lin 500 1 2 3 4",
+        "tl hold 200", "fx", "auto", "auto hold 30000", "zone", "zone timing 3 2000", "radar", "tof",
+        "ddp fmt rgbw8", "pwm status", "set 3", "get", "vl53 gpio", "vl53 start", "tasks", "info",
+        "config ip 192.168.1.20", "config show", "exit", "help", "unknown",
+    };
+    enum { N_LINES = sizeof(lines) / sizeof(lines[0]) };
+    static cli_cmd_t bench_cmds[CLI_CMDS_MAX];
+    char buf[N_LINES][64];
+    uint64_t t0, t_chain, t_table, t_sscanf, t_typed;
+    uint32_t reps = n / N_LINES + 1;
+
+    // the same names with handlers that do nothing, so only the dispatch is timed
+    cli_cmd_reset();
+    for (uint32_t i = 0; i < n_all; i++) {
+        bench_cmds[i] = *all[i];
+        bench_cmds[i].fn = h_null;
+        bench_cmds[i].min_args = 0;
+        bench_cmds[i].max_args = CLI_ARGS_MAX;
+    }
+    cli_cmd_register(bench_cmds, (uint8_t)n_all);
+
+    t0 = cpu_time_ns();
+    for (uint32_t r = 0; r < reps; r++)
+        for (int i = 0; i < N_LINES; i++)
+            sink += (uint32_t)chain(lines[i]);
+    t_chain = cpu_time_ns() - t0;
+
+    t0 = cpu_time_ns();
+    for (uint32_t r = 0; r < reps; r++) {
+        for (int i = 0; i < N_LINES; i++) {
+            char *argv[CLI_ARGS_MAX];
+            int argc, words;
+            strcpy(buf[i], lines[i]);       // the dispatcher splits in place, the chain would not
+            argc = cli_cmd_tokenize(buf[i], argv, CLI_ARGS_MAX);
+            const cli_cmd_t *c = cli_cmd_find(argc, argv, &words);
+            if (c) {
+                cli_ctx_t ctx = { 0, argc - words, argv + words };
+                c->fn(&ctx);
+            }
+        }
+    }
+    t_table = cpu_time_ns() - t0;
+
+    // arguments of "rgbw 1023 512 0 4095": sscanf after the name against the split words
+    t0 = cpu_time_ns();
+    for (uint32_t r = 0; r < reps * N_LINES; r++) {
+        unsigned v[4];
+        sink += (uint32_t)sscanf(lines[0] + 4, "%u %u %u %u", &v[0], &v[1], &v[2], &v[3]) + v[3];
+    }
+    t_sscanf = cpu_time_ns() - t0;
+
+    t0 = cpu_time_ns();
+    for (uint32_t r = 0; r < reps * N_LINES; r++) {
+        char line[32], *argv[CLI_ARGS_MAX];
+        uint32_t v[4];
+        strcpy(line, lines[0]);
+        int argc = cli_cmd_tokenize(line, argv, CLI_ARGS_MAX);
+        sink += cli_args_u32(argv + 1, argc - 1, 0, 4095, v) + v[3];
+    }
+    t_typed = cpu_time_ns() - t0;
+
+    double per = (double)reps * N_LINES;
+    printf("  lookup, %u names, %d lines x %u: chain %.0f ns, tokenize + binary search %.0f ns per line\n",
+           n_all, N_LINES, reps, t_chain / per, t_table / per);
+    printf("  arguments of 'rgbw 1023 512 0 4095': sscanf %.0f ns, tokenize + cli_args_u32 %.0f ns\n",
+           t_sscanf / per, t_typed / per);
+    register_all();
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t n = 200000;
+    uint64_t seed = 44;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "vn:r:")) != -1) {
+        switch (opt) {
+            case 'v': verbose = true; break;
+            case 'n': n = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'r': seed = strtoull(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-v] [-n lines] [-r seed]\n", argv[0]);
+                return 1;
+        }
+    }
+    prng_seed(&rng, seed, 1);
+
+    printf("telnet CLI dispatch:\n");
+    register_all();
+    test_tokenize();
+    test_lookup();
+    test_dispatch();
+    test_help();
+    test_register();
+    test_args();
+    test_random(n);
+    bench(n);
+
+    printf("%s: %u errors\n", errors ? "FAIL" : "OK", errors);
+    return errors ? 1 : 0;
+}
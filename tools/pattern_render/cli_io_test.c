@@ -0,0 +1,454 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Telnet CLI byte stream (common/network/cli_io.c) on a socket model: the
+ * recv() side gets packets cut anywhere, the send() side counts segments.
+ *
+ *   cli_io_test [-v] [-n scripts] [-r seed]
+ *
+ * A pass is one read through cli_io_rx(), all its lines, then
+ * cli_io_tx_flush(). Checked: a command split over reads runs once
+ * with all its words, several commands in one read all run in order, every
+ * end of line (CR, LF, CRLF, CR NUL, also split between reads), telnet
+ * negotiation and backspace, overlong lines, output longer than the TX
+ * buffer, "exit" dropping the rest of its read, and random scripts cut
+ * into random reads against the same script read whole and against a
+ * plain line splitter. Then the segments per command: writes are what
+ * went out as one send() each before the TX buffer.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "cli_io.h"
+#include "cli_cmd.h"
+#include "tcp_cli.h"
+#include "prng.h"
+
+#define SN          2
+
+static uint32_t errors;
+static bool verbose;
+
+#define FAIL(...) do { if (errors++ < 10) printf(__VA_ARGS__); } while (0)
+
+/* ---------- socket model: what the client reads ---------- */
+static char out[65536];
+static size_t out_len;
+static uint32_t segments, seg_max, seg_bad_sn;
+
+static int32_t model_send(uint8_t sn, uint8_t *buf, uint16_t len)
+{
+    if (sn != SN)
+        seg_bad_sn++;
+    if (len > seg_max)
+        seg_max = len;
+    segments++;
+    if (out_len + len < sizeof(out)) {
+        memcpy(out + out_len, buf, len);
+        out_len += len;
+        out[out_len] = '\0';
+    }
+    return len;
+}
+
+/* what ran: "name args|" per command */
+static char run_log[16384];
+static size_t log_len;
+
+static void clear(void)
+{
+    out[0] = '\0';
+    out_len = 0;
+    segments = 0;
+    seg_max = 0;
+    run_log[0] = '\0';
+    log_len = 0;
+}
+
+static void log_cmd(const char *name, const cli_ctx_t *ctx)
+{
+    log_len += (size_t)snprintf(run_log + log_len, sizeof(run_log) - log_len, "%s", name);
+    for (int i = 0; i < ctx->argc && log_len < sizeof(run_log); i++)
+        log_len += (size_t)snprintf(run_log + log_len, sizeof(run_log) - log_len, " %s", ctx->argv[i]);
+    if (log_len < sizeof(run_log) - 1) {
+        run_log[log_len++] = '|';
+        run_log[log_len] = '\0';
+    }
+}
+
+/* ---------- commands, shaped like the ones of the boards ---------- */
+static bool cmd_set(const cli_ctx_t *ctx)
+{
+    log_cmd("set", ctx);
+    cli_flush(ctx->sn, "OK\r\n");
+    return true;
+}
+
+/* like cli_sys "info": a line per cli_send() */
+static bool cmd_info(const cli_ctx_t *ctx)
+{
+    char msg[64];
+
+    log_cmd("info", ctx);
+    cli_send(ctx->sn, "\r\n=== kitchen_pwm ===\r\n");
+    for (int i = 0; i < 12; i++) {
+        snprintf(msg, sizeof(msg), "  field %-2d      : value %d\r\n", i, i * 7);
+        cli_send(ctx->sn, msg);
+    }
+    cli_flush(ctx->sn, "\r\n");
+    return true;
+}
+
+/* more output than the TX buffer */
+static bool cmd_dump(const cli_ctx_t *ctx)
+{
+    char msg[64];
+
+    log_cmd("dump", ctx);
+    for (int i = 0; i < 100; i++) {
+        snprintf(msg, sizeof(msg), "%03d 0123456789abcdef0123456789abcdef\r\n", i);
+        cli_send(ctx->sn, msg);
+    }
+    cli_flush(ctx->sn, "");
+    return true;
+}
+
+/* like cli_sys "exit" */
+static bool cmd_exit(const cli_ctx_t *ctx)
+{
+    log_cmd("exit", ctx);
+    cli_send(ctx->sn, "Closing connection...\r\n");
+    cli_io_tx_flush(ctx->sn);
+    cli_io_stop();
+    return true;
+}
+
+static const cli_cmd_t s_cmds[] = {
+    { "set",    "<a> [b] [c] [d]",  "Set values",           1, 4, cmd_set },
+    { "info",   "",                 "Board information",    0, 0, cmd_info },
+    { "dump",   "",                 "Long output",          0, 0, cmd_dump },
+    { "exit",   "",                 "Close the connection", 0, 0, cmd_exit },
+};
+
+/* cli_server.c: on_line() without the console print */
+static void on_line(char *line, uint8_t sn)
+{
+    cli_cmd_dispatch(line, sn);
+}
+
+/* one turn of a session */
+static cli_io_rx_t rx;
+
+static void pass(const void *data, size_t len)
+{
+    cli_io_rx(&rx, SN, (const uint8_t *)data, (uint16_t)len, UINT16_MAX);
+    cli_io_tx_flush(SN);
+}
+
+static void pass_str(const char *s)
+{
+    pass(s, strlen(s));
+}
+
+static void expect_log(const char *what, const char *want)
+{
+    if (strcmp(run_log, want) != 0)
+        FAIL("%s: ran '%s', want '%s'\n", what, run_log, want);
+}
+
+/* ---------- fixed cases ---------- */
+static void test_split_merged(void)
+{
+    clear();
+    pass_str("set 1 2");
+    pass_str(" 3 4\r\n");
+    expect_log("split in a word gap", "set 1 2 3 4|");
+    if (segments != 1)
+        FAIL("split: %u segments, want 1 (nothing before the line ends)\n", segments);
+
+    clear();
+    pass_str("se");
+    pass_str("t 7");
+    pass_str("5\r");
+    pass_str("\n");
+    expect_log("split in words, CR | LF", "set 75|");
+    if (strcmp(out, "OK\r\n> ") != 0)
+        FAIL("split: output '%s', CRLF over two reads made an empty line\n", out);
+
+    clear();
+    static const char merged[] = "set 1\r\nset 2\nset 3\r\0set 4\rset 5\r\n";
+    pass(merged, sizeof(merged) - 1);
+    expect_log("merged, all ends of line", "set 1|set 2|set 3|set 4|set 5|");
+    if (segments != 1)
+        FAIL("merged: %u segments, want 1\n", segments);
+
+    clear();
+    pass_str("\r\n\n\r");
+    expect_log("empty lines", "");
+    if (strcmp(out, "> > > ") != 0)
+        FAIL("empty lines: output '%s', want three prompts\n", out);
+    pass_str("\n");                 // the LF of the last CR
+    if (strcmp(out, "> > > ") != 0)
+        FAIL("empty lines: LF after CR over reads gave a prompt\n");
+}
+
+static void test_telnet(void)
+{
+    // what a telnet client sends when it connects, then a command
+    static const uint8_t nego[] = {
+        255, 251, 24, 255, 253, 1, 255, 250, 24, 0, 'x', 't', 'e', 'r', 'm', 255, 240,
+        's', 'e', 't', ' ', '9', 255, 255, '\r', 0,
+    };
+
+    for (size_t cut = 0; cut <= sizeof(nego); cut++) {
+        clear();
+        pass(nego, cut);
+        pass(nego + cut, sizeof(nego) - cut);
+        if (strcmp(run_log, "set 9|") != 0)
+            FAIL("telnet cut at %zu: ran '%s'\n", cut, run_log);
+    }
+
+    clear();
+    pass_str("sex\bt 1\x7f""2\r\n");
+    expect_log("backspace / DEL", "set 2|");
+    clear();
+    pass_str("\b\bset\t3\r\n");
+    expect_log("backspace on empty, tab", "set 3|");
+}
+
+static void test_long(void)
+{
+    char line[CLI_LINE_MAX + 64];
+    const cli_io_stats_t *st = cli_io_stats();
+    uint32_t dropped = st->dropped;
+
+    memset(line, 'a', sizeof(line));
+    memcpy(line, "set ", 4);
+    clear();
+    pass(line, sizeof(line));
+    pass_str("\x7f\x7f\r\nset 5\r\n");
+    expect_log("overlong line", "set 5|");
+    if (strncmp(out, "Line too long\r\n> ", 17) != 0)
+        FAIL("overlong line: output '%.40s'\n", out);
+    if (st->dropped != dropped + 1)
+        FAIL("overlong line: dropped %u\n", st->dropped - dropped);
+
+    // the longest line that fits
+    clear();
+    memset(line, 'b', CLI_LINE_MAX - 1);
+    memcpy(line, "set ", 4);
+    memcpy(line + CLI_LINE_MAX - 1, "\r\n", 2);
+    pass(line, CLI_LINE_MAX + 1);
+    if (strncmp(run_log, "set bbb", 7) != 0 || strlen(run_log) != CLI_LINE_MAX)
+        FAIL("longest line: ran %zu chars\n", strlen(run_log));
+}
+
+static void test_big_output(void)
+{
+    char want[8192];
+    size_t n = 0;
+
+    for (int i = 0; i < 100; i++)
+        n += (size_t)snprintf(want + n, sizeof(want) - n, "%03d 0123456789abcdef0123456789abcdef\r\n", i);
+    n += (size_t)snprintf(want + n, sizeof(want) - n, "> ");
+
+    clear();
+    pass_str("dump\r\n");
+    if (strcmp(out, want) != 0)
+        FAIL("dump: output differs from the lines sent\n");
+    if (seg_max != CLI_TX_BUF_SIZE || segments != (n + CLI_TX_BUF_SIZE - 1) / CLI_TX_BUF_SIZE)
+        FAIL("dump: %zu bytes in %u segments, largest %u\n", n, segments, seg_max);
+}
+
+static void test_exit(void)
+{
+    clear();
+    pass_str("set 1\r\nexit\r\nset 2\r\nse");
+    pass_str("set 3\r\n");        // the next connection: nothing left of the last one
+    expect_log("exit", "set 1|exit|set 3|");
+    if (strcmp(out, "OK\r\n> Closing connection...\r\nOK\r\n> ") != 0)
+        FAIL("exit: output '%s'\n", out);
+}
+
+static void test_sockets(void)
+{
+    clear();
+    seg_bad_sn = 0;
+    cli_send(SN + 1, "other");
+    cli_send(SN, "x");
+    cli_io_tx_flush(SN);
+    if (seg_bad_sn != 1 || segments != 2 || strcmp(out, "otherx") != 0)
+        FAIL("two sockets: %u segments, %u to the other one, '%s'\n", segments, seg_bad_sn, out);
+    clear();
+    cli_send(SN, "x");
+    cli_io_tx_flush(SN + 1);
+    if (segments != 0)
+        FAIL("flush of another socket sent the pending output\n");
+    cli_io_tx_flush(SN);
+}
+
+/* ---------- random scripts ---------- */
+static prng_t rng;
+
+static const struct { const char *s; size_t len; } eols[] = {
+    { "\r\n", 2 }, { "\n", 1 }, { "\r", 1 }, { "\r\0", 2 },
+};
+
+/* the lines of the whole stream, one per entry in lines[] */
+static int split_lines(const char *s, size_t len, char lines[][64], int max)
+{
+    int n = 0;
+    size_t i = 0;
+
+    while (i < len && n < max) {
+        size_t k = 0;
+
+        while (i < len && s[i] != '\r' && s[i] != '\n' && k < 63)
+            lines[n][k++] = s[i++];
+        lines[n++][k] = '\0';
+        if (i < len && s[i] == '\r' && i + 1 < len && (s[i + 1] == '\n' || s[i + 1] == '\0'))
+            i++;
+        i++;
+    }
+    return n;
+}
+
+static void test_random(uint32_t scripts)
+{
+    static char script[8192], log_whole[16384], out_whole[65536];
+    static char lines[512][64];
+
+    for (uint32_t s = 0; s < scripts; s++) {
+        size_t len = 0;
+        int n_lines = 1 + (int)prng_below(&rng, 60);
+
+        for (int l = 0; l < n_lines; l++) {
+            uint32_t e = prng_below(&rng, 4);
+
+            switch (prng_below(&rng, 4)) {
+            case 0:
+                len += (size_t)sprintf(script + len, "info");
+                break;
+            case 1:
+                len += (size_t)sprintf(script + len, "set %u %u", prng_below(&rng, 1000), prng_below(&rng, 1000));
+                break;
+            case 2:
+                len += (size_t)sprintf(script + len, "  set\t%u ", prng_below(&rng, 10));
+                break;
+            default:
+                len += (size_t)sprintf(script + len, "help s");
+                break;
+            }
+            memcpy(script + len, eols[e].s, eols[e].len);
+            len += eols[e].len;
+        }
+
+        // read whole
+        clear();
+        pass(script, len);
+        strcpy(log_whole, run_log);
+        memcpy(out_whole, out, out_len + 1);
+        uint32_t seg_whole = segments;
+
+        // against a plain splitter
+        int n = split_lines(script, len, lines, 512);
+        if (n != n_lines)
+            FAIL("script %u: splitter found %d lines of %d\n", s, n, n_lines);
+
+        // cut into random reads
+        clear();
+        for (size_t i = 0; i < len;) {
+            size_t k = 1 + prng_below(&rng, (prng_below(&rng, 4) == 0) ? 3 : 64);
+            if (k > len - i)
+                k = len - i;
+            pass(script + i, k);
+            i += k;
+        }
+        if (strcmp(run_log, log_whole) != 0)
+            FAIL("script %u: cut reads ran '%.60s', whole '%.60s'\n", s, run_log, log_whole);
+        if (out_len != strlen(out_whole) || memcmp(out, out_whole, out_len) != 0)
+            FAIL("script %u: cut reads answered differently\n", s);
+        if (verbose)
+            printf("script %3u: %2d lines, %4zu bytes, %u segments read whole\n", s, n_lines, len, seg_whole);
+    }
+}
+
+/* ---------- segments per command ---------- */
+static void measure(const char *what, const char *script, int commands)
+{
+    const cli_io_stats_t *st = cli_io_stats();
+    uint32_t writes = st->writes, segs = st->segments;
+
+    clear();
+    pass_str(script);
+    writes = st->writes - writes;
+    segs = st->segments - segs;
+    printf("  %-26s %3d cmd  %5zu bytes  before %4u segments (%5.1f/cmd)  now %3u (%4.2f/cmd)\n",
+           what, commands, out_len, writes, (double)writes / commands, segs, (double)segs / commands);
+    if (segs != segments)
+        FAIL("%s: stats %u segments, socket model %u\n", what, segs, segments);
+}
+
+static void test_segments(void)
+{
+    static char script[4096];
+    size_t len = 0;
+
+    for (int i = 0; i < 40; i++)
+        len += (size_t)snprintf(script + len, sizeof(script) - len, "set %d %d\r\n", i, i * 3);
+
+    printf("segments per command (one service pass):\n");
+    measure("set", "set 1 2\r\n", 1);
+    measure("info", "info\r\n", 1);
+    measure("help", "help\r\n", 1);
+    measure("dump", "dump\r\n", 1);
+    measure("pasted script of set", script, 40);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t scripts = 2000;
+    uint32_t seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "vn:r:")) != -1) {
+        switch (opt) {
+        case 'v': verbose = true; break;
+        case 'n': scripts = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'r': seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-v] [-n scripts] [-r seed]\n", argv[0]);
+            return 2;
+        }
+    }
+    prng_seed(&rng, seed, 45);
+
+    cli_cmd_reset();
+    if (!cli_cmd_register(s_cmds, (uint8_t)(sizeof(s_cmds) / sizeof(s_cmds[0])))) {
+        printf("FAIL: table\n");
+        return 1;
+    }
+    cli_io_init(model_send, on_line);
+
+    test_split_merged();
+    test_telnet();
+    test_long();
+    test_big_output();
+    test_exit();
+    test_sockets();
+    test_random(scripts);
+    test_segments();
+
+    printf("%s: %u errors\n", errors ? "FAIL" : "OK", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,590 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Telnet CLI server (common/network/cli_server.c) on a simulated socket
+ * layer and clock: W6100 sockets with their Sn_SR states, clients that
+ * connect, type, paste, exit, hang up and go silent.
+ *
+ *   cli_server_test [-v] [-n passes] [-r seed]
+ *
+ * A pass is the sched "cli" task, every 5 ms. Commands cost simulated time
+ * ("work <us>"). Checked:
+ *  - two clients at once, each gets only its own answers
+ *  - a client beyond the pool is refused, and taken once a socket is free
+ *  - a silent client is timed out alone, the others go on
+ *  - "exit" closes its session only and drops the rest of its read
+ *  - fairness: two clients pasting long scripts against one typing; the
+ *    typing one's answer latency in passes, how far one pasting client
+ *    gets ahead of the other, and no pass over its budget by more than
+ *    one command
+ *  - churn: random clients for many passes; every connection's received
+ *    stream is exactly its greeting, its answers in order, and its end
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "cli_server.h"
+#include "cli_cmd.h"
+#include "prng.h"
+
+#define FIRST_SN        2
+#define SESSIONS        3
+#define PORT            5000
+#define TIMEOUT_MS      20000
+#define PASS_US         5000
+#define SOCK_OP_US      4           // one SPI register access
+#define CLIENTS_MAX     8
+
+static uint32_t errors;
+static bool verbose;
+static prng_t rng;
+
+#define FAIL(...) do { if (errors++ < 10) printf(__VA_ARGS__); } while (0)
+
+/* ---------- clock ---------- */
+static uint64_t now_us;
+
+uint64_t time_us_64(void)
+{
+    return now_us;
+}
+
+/* ---------- socket model ---------- */
+typedef struct {
+    uint8_t  state;             // CLI_SOCK_*
+    uint8_t  closing;           // passes left in CLI_SOCK_OTHER before CLI_SOCK_CLOSED
+    bool     con;               // Sn_IR_CON
+    int      client;            // -1 none
+    uint8_t  rx[8192];          // sent by the client, not read yet
+    uint16_t rx_len;
+} sock_t;
+
+static sock_t socks[8];
+static uint32_t refused;
+
+typedef struct {
+    int      sn;                // -1: not connected
+    uint32_t seq;               // echo commands sent on this connection
+    uint32_t answered;          // prompts received
+    char     got[16384];        // received on this connection
+    size_t   got_len;
+    char     want[16384];       // what it has to be
+    size_t   want_len;
+    bool     silent;            // never types, to be timed out
+    bool     exited;
+    uint32_t connections;
+} client_t;
+
+static client_t clients[CLIENTS_MAX];
+static uint32_t pass_no;
+
+static void sock_drop(int sn, uint8_t passes)
+{
+    sock_t *k = &socks[sn];
+
+    k->state = CLI_SOCK_OTHER;
+    k->closing = passes;
+    k->rx_len = 0;
+    k->con = false;
+    k->client = -1;
+}
+
+uint8_t cli_sock_status(uint8_t sn)
+{
+    now_us += SOCK_OP_US;
+    return socks[sn].state;
+}
+
+bool cli_sock_accepted(uint8_t sn, uint8_t ip[4])
+{
+    now_us += SOCK_OP_US;
+    if (!socks[sn].con)
+        return false;
+    socks[sn].con = false;
+    ip[0] = 192; ip[1] = 168; ip[2] = 14; ip[3] = (uint8_t)(100 + socks[sn].client);
+    return true;
+}
+
+uint16_t cli_sock_rx_size(uint8_t sn)
+{
+    now_us += SOCK_OP_US;
+    return socks[sn].rx_len;
+}
+
+int32_t cli_sock_recv(uint8_t sn, uint8_t *buf, uint16_t len)
+{
+    sock_t *k = &socks[sn];
+
+    if (len > k->rx_len)
+        len = k->rx_len;
+    memcpy(buf, k->rx, len);
+    memmove(k->rx, k->rx + len, k->rx_len - len);
+    k->rx_len = (uint16_t)(k->rx_len - len);
+    now_us += SOCK_OP_US + len / 8u;
+    return len;
+}
+
+static uint32_t segments;
+
+int32_t cli_sock_send(uint8_t sn, uint8_t *buf, uint16_t len)
+{
+    sock_t *k = &socks[sn];
+
+    now_us += SOCK_OP_US + len / 8u;
+    segments++;
+    if (k->state != CLI_SOCK_ESTABLISHED && k->state != CLI_SOCK_CLOSE_WAIT)
+        return -4;
+    if (k->client >= 0) {
+        client_t *c = &clients[k->client];
+        if (c->got_len + len < sizeof(c->got)) {
+            memcpy(c->got + c->got_len, buf, len);
+            c->got_len += len;
+        }
+        // prompts of what it sent
+        for (uint16_t i = 0; i + 1 < len; i++)
+            if (buf[i] == '>' && buf[i + 1] == ' ')
+                c->answered++;
+    }
+    return len;
+}
+
+bool cli_sock_open(uint8_t sn, uint16_t port)
+{
+    (void)port;
+    now_us += SOCK_OP_US;
+    socks[sn].state = CLI_SOCK_INIT;
+    return true;
+}
+
+bool cli_sock_listen(uint8_t sn)
+{
+    now_us += SOCK_OP_US;
+    socks[sn].state = CLI_SOCK_LISTEN;
+    return true;
+}
+
+void cli_sock_disconnect(uint8_t sn)
+{
+    now_us += SOCK_OP_US;
+    if (socks[sn].client >= 0)
+        clients[socks[sn].client].sn = -1;
+    sock_drop(sn, 1);
+}
+
+/* ---------- clients ---------- */
+static void want(client_t *c, const char *s)
+{
+    size_t n = strlen(s);
+
+    if (c->want_len + n < sizeof(c->want)) {
+        memcpy(c->want + c->want_len, s, n);
+        c->want_len += n;
+    }
+}
+
+/* the stream of the connection that just ended has to be exactly want */
+static void check_stream(int id, const char *why)
+{
+    client_t *c = &clients[id];
+
+    if (c->got_len != c->want_len || memcmp(c->got, c->want, c->got_len) != 0) {
+        FAIL("client %d, connection %u (%s): got %zu bytes '%.60s', want %zu '%.60s'\n",
+             id, c->connections, why, c->got_len, c->got, c->want_len, c->want);
+    }
+    c->got_len = c->want_len = 0;
+}
+
+/* SYN to the port: the lowest listening socket takes it */
+static bool client_connect(int id)
+{
+    client_t *c = &clients[id];
+
+    for (int sn = FIRST_SN; sn < FIRST_SN + SESSIONS; sn++) {
+        sock_t *k = &socks[sn];
+        if (k->state != CLI_SOCK_LISTEN)
+            continue;
+        k->state = CLI_SOCK_ESTABLISHED;
+        k->con = true;
+        k->client = id;
+        k->rx_len = 0;
+        c->sn = sn;
+        c->seq = c->answered = 0;
+        c->got_len = c->want_len = 0;
+        c->exited = false;
+        c->connections++;
+        want(c, "hi\r\n> ");
+        return true;
+    }
+    refused++;
+    return false;
+}
+
+static void client_type(int id, const char *s)
+{
+    client_t *c = &clients[id];
+    sock_t *k = &socks[c->sn];
+    size_t n = strlen(s);
+
+    if (k->rx_len + n <= sizeof(k->rx)) {
+        memcpy(k->rx + k->rx_len, s, n);
+        k->rx_len = (uint16_t)(k->rx_len + n);
+    }
+}
+
+/* "echo <id> <seq>" lines, answered "<id> <seq>" */
+static void client_echo(int id, int lines)
+{
+    client_t *c = &clients[id];
+    char line[48], want_line[48];
+
+    for (int i = 0; i < lines; i++) {
+        snprintf(line, sizeof(line), "echo %d %u\r\n", id, c->seq);
+        snprintf(want_line, sizeof(want_line), "%d %u\r\n> ", id, c->seq);
+        c->seq++;
+        client_type(id, line);
+        want(c, want_line);
+    }
+}
+
+/* FIN from the client: only when all it typed is answered */
+static void client_close(int id)
+{
+    client_t *c = &clients[id];
+
+    socks[c->sn].state = CLI_SOCK_CLOSE_WAIT;
+    socks[c->sn].client = -1;
+    c->sn = -1;
+    check_stream(id, "closed by client");
+}
+
+/* ---------- commands ---------- */
+static void greeting(uint8_t sn, const uint8_t *ip)
+{
+    (void)ip;
+    cli_flush(sn, "hi\r\n");
+}
+
+static bool cmd_echo(const cli_ctx_t *ctx)
+{
+    char msg[48];
+
+    snprintf(msg, sizeof(msg), "%s %s\r\n", ctx->argv[0], ctx->argv[1]);
+    cli_flush(ctx->sn, msg);
+    return true;
+}
+
+static bool cmd_work(const cli_ctx_t *ctx)
+{
+    uint32_t us;
+
+    if (!cli_arg_u32(ctx->argv[0], 0, 100000, &us))
+        return false;
+    now_us += us;
+    cli_flush(ctx->sn, "done\r\n");
+    return true;
+}
+
+static bool cmd_exit(const cli_ctx_t *ctx)
+{
+    cli_send(ctx->sn, "bye\r\n");
+    cli_io_tx_flush(ctx->sn);
+    cli_server_close(ctx->sn);
+    return true;
+}
+
+static const cli_cmd_t s_cmds[] = {
+    { "echo",   "<id> <seq>",   "Answer id seq",            2, 2, cmd_echo },
+    { "work",   "<us>",         "Take us of CPU",           1, 1, cmd_work },
+    { "exit",   "",             "Close the connection",     0, 0, cmd_exit },
+};
+
+static void setup(void)
+{
+    tcp_cli_hooks_t hooks = { .on_connect = greeting, .handle_command = cli_cmd_handle };
+
+    memset(socks, 0, sizeof(socks));
+    for (int sn = 0; sn < 8; sn++)
+        socks[sn].client = -1;
+    memset(clients, 0, sizeof(clients));
+    for (int i = 0; i < CLIENTS_MAX; i++)
+        clients[i].sn = -1;
+    refused = 0;
+    segments = 0;
+    now_us = 1000000;
+    pass_no = 0;
+    cli_server_init(FIRST_SN, SESSIONS, PORT, TIMEOUT_MS);
+    cli_server_hooks(&hooks);
+}
+
+/* one sched "cli" release: the socket model moves on, then the server pass */
+static uint64_t last_pass_us;
+
+static void pass(void)
+{
+    uint64_t start;
+
+    for (int sn = 0; sn < 8; sn++) {
+        sock_t *k = &socks[sn];
+        if (k->state == CLI_SOCK_OTHER && k->closing-- == 0)
+            k->state = CLI_SOCK_CLOSED;
+    }
+    now_us = (now_us + PASS_US - 1) / PASS_US * PASS_US;
+    start = now_us;
+    cli_server_service();
+    last_pass_us = now_us - start;
+    pass_no++;
+}
+
+static void passes(int n)
+{
+    while (n--)
+        pass();
+}
+
+/* the client saw the socket go: what it got has to be complete */
+static void client_gone(int id, const char *why)
+{
+    check_stream(id, why);
+}
+
+/* ---------- fixed cases ---------- */
+static void test_two_clients(void)
+{
+    setup();
+    passes(3);                          // CLOSED -> INIT -> LISTEN
+    if (!client_connect(0) || !client_connect(1))
+        FAIL("two clients: refused\n");
+    passes(1);
+    client_echo(0, 3);
+    client_echo(1, 2);
+    client_type(0, "echo 0 ");          // split over reads
+    passes(1);
+    client_type(0, "3\r\n");
+    want(&clients[0], "0 3\r\n> ");
+    clients[0].seq++;
+    passes(2);
+    if (clients[0].answered != 5 || clients[1].answered != 3)
+        FAIL("two clients: %u / %u prompts\n", clients[0].answered, clients[1].answered);
+    client_close(0);
+    client_close(1);
+    passes(4);
+    for (int sn = FIRST_SN; sn < FIRST_SN + SESSIONS; sn++)
+        if (socks[sn].state != CLI_SOCK_LISTEN)
+            FAIL("two clients: socket %d state %u after close\n", sn, socks[sn].state);
+}
+
+static void test_pool_full(void)
+{
+    setup();
+    passes(3);
+    for (int i = 0; i < SESSIONS; i++)
+        client_connect(i);
+    passes(1);
+    if (client_connect(SESSIONS) || refused != 1)
+        FAIL("pool full: client %d taken\n", SESSIONS);
+    client_type(1, "exit\r\necho 1 99\r\n");
+    want(&clients[1], "bye\r\n");
+    passes(1);
+    if (clients[1].sn != -1)
+        FAIL("pool full: exit left the socket connected\n");
+    client_gone(1, "exit");
+    passes(3);
+    if (!client_connect(SESSIONS))
+        FAIL("pool full: freed socket not taken again\n");
+    passes(1);
+    client_echo(SESSIONS, 1);
+    client_echo(0, 1);
+    passes(1);
+    if (clients[SESSIONS].answered != 2 || clients[0].answered != 2)
+        FAIL("pool full: new client %u prompts, old %u\n", clients[SESSIONS].answered, clients[0].answered);
+    const cli_session_t *s = cli_server_session(1);
+    if (s->connects != 2 || s->rx.lines != 1)
+        FAIL("pool full: session 1 %u connects, %u lines\n", s->connects, s->rx.lines);
+}
+
+static void test_timeout(void)
+{
+    int silent_passes = TIMEOUT_MS * 1000 / PASS_US;
+
+    setup();
+    passes(3);
+    client_connect(0);
+    client_connect(1);
+    passes(1);
+    for (int p = 0; p < silent_passes + 10; p++) {
+        if (p % 100 == 0)
+            client_echo(1, 1);          // client 1 types every 0.5 s, client 0 never
+        pass();
+    }
+    want(&clients[0], "timeout\r\n");
+    if (clients[0].sn != -1)
+        FAIL("timeout: silent client still connected\n");
+    else
+        client_gone(0, "timeout");
+    if (clients[1].sn < 0 || clients[1].answered != clients[1].seq + 1)
+        FAIL("timeout: typing client dropped or unanswered\n");
+}
+
+/* two pasting, one typing */
+#define PASTED      600
+#define WORK_MIN    200
+#define WORK_MAX    500
+
+static void test_fairness(void)
+{
+    static char line[64];
+    uint32_t worst_wait = 0, waited = 0, over = 0, lag = 0, sent = 0;
+    uint64_t worst_pass = 0;
+    const cli_session_t *a, *b;
+
+    setup();
+    passes(3);
+    for (int i = 0; i < 3; i++)
+        client_connect(i);
+    passes(1);
+    for (int i = 0; i < 2; i++) {
+        for (int l = 0; l < PASTED; l++) {
+            snprintf(line, sizeof(line), "work %u\r\n", WORK_MIN + prng_below(&rng, WORK_MAX - WORK_MIN));
+            client_type(i, line);
+        }
+    }
+    a = cli_server_session(0);
+    b = cli_server_session(1);
+
+    for (int p = 0; p < 20000 && (a->rx.lines < PASTED || b->rx.lines < PASTED); p++) {
+        if (clients[2].answered == clients[2].seq + 1) {
+            client_echo(2, 1);              // next key press once the last one is answered
+            sent = pass_no;
+        }
+        pass();
+        if (clients[2].answered == clients[2].seq + 1) {
+            uint32_t wait = pass_no - sent;
+            if (wait > worst_wait)
+                worst_wait = wait;
+            waited++;
+        }
+        if (last_pass_us > worst_pass)
+            worst_pass = last_pass_us;
+        // a pass ends at the first turn after the budget: one command over at most
+        if (last_pass_us > CLI_PASS_BUDGET_US + WORK_MAX + 100)
+            over++;
+        uint32_t d = (a->rx.lines > b->rx.lines) ? a->rx.lines - b->rx.lines : b->rx.lines - a->rx.lines;
+        if (d > lag)
+            lag = d;
+    }
+    printf("fairness: 2 x %u pasted commands of %u..%u us, 1 typing: typed answer within %u passes (%u answers)\n"
+           "          pasted run %u / %u, lead at most %u, worst pass %llu us (budget %u)\n",
+           PASTED, WORK_MIN, WORK_MAX, worst_wait, waited, a->rx.lines, b->rx.lines, lag,
+           (unsigned long long)worst_pass, CLI_PASS_BUDGET_US);
+    if (worst_wait > SESSIONS - 1)
+        FAIL("fairness: typing client waited %u passes\n", worst_wait);
+    if (a->rx.lines != PASTED || b->rx.lines != PASTED)
+        FAIL("fairness: pasted scripts not run through: %u / %u\n", a->rx.lines, b->rx.lines);
+    if (lag > 2)
+        FAIL("fairness: one pasting client ran %u commands ahead\n", lag);
+    if (over)
+        FAIL("fairness: %u passes over the budget by more than a command\n", over);
+    pass();                             // the last key press
+    check_stream(2, "typing");
+}
+
+/* ---------- churn ---------- */
+static void test_churn(uint32_t n_passes)
+{
+    uint32_t connects = 0, exits = 0, closes = 0, timeouts = 0;
+
+    setup();
+    passes(3);
+    for (int i = 0; i < CLIENTS_MAX; i++)
+        clients[i].silent = (i == CLIENTS_MAX - 1);
+
+    for (uint32_t p = 0; p < n_passes; p++) {
+        for (int id = 0; id < CLIENTS_MAX; id++) {
+            client_t *c = &clients[id];
+            uint32_t r = prng_below(&rng, 1000);
+
+            if (c->sn < 0) {
+                if (r < 20 && client_connect(id))
+                    connects++;
+                continue;
+            }
+            if (c->silent)
+                continue;
+            bool idle = (c->answered == c->seq + 1);
+            if (r < 5 && idle) {
+                client_close(id);
+                closes++;
+            } else if (r < 8) {
+                // exit, maybe after commands, lines after it never run
+                if (r == 5)
+                    client_echo(id, 1 + (int)prng_below(&rng, 5));
+                client_type(id, "exit\r\necho 9 9\r\n");
+                want(c, "bye\r\n");
+                c->exited = true;
+                exits++;
+            } else if (r < 120 && !c->exited) {
+                client_echo(id, 1 + (int)prng_below(&rng, (r < 20) ? 40 : 3));
+            }
+        }
+        pass();
+        // clients whose socket went away: exit or timeout
+        for (int id = 0; id < CLIENTS_MAX; id++) {
+            client_t *c = &clients[id];
+            if (c->sn < 0 && (c->got_len || c->want_len)) {
+                if (!c->exited) {
+                    want(c, "timeout\r\n");
+                    timeouts++;
+                }
+                client_gone(id, c->exited ? "exit" : "timeout");
+            }
+        }
+    }
+    printf("churn: %u passes, %u connections, %u closed by client, %u exits, %u timeouts, %u refused\n",
+           n_passes, connects, closes, exits, timeouts, refused);
+    if (!connects || !closes || !exits || !timeouts || !refused)
+        FAIL("churn: a case did not happen\n");
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t n_passes = 200000;
+    uint32_t seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "vn:r:")) != -1) {
+        switch (opt) {
+        case 'v': verbose = true; break;
+        case 'n': n_passes = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'r': seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-v] [-n passes] [-r seed]\n", argv[0]);
+            return 2;
+        }
+    }
+    prng_seed(&rng, seed, 46);
+
+    cli_cmd_reset();
+    if (!cli_cmd_register(s_cmds, (uint8_t)count_of(s_cmds))) {
+        printf("FAIL: table\n");
+        return 1;
+    }
+
+    test_two_clients();
+    test_pool_full();
+    test_timeout();
+    test_fairness();
+    test_churn(n_passes);
+
+    printf("%s: %u errors\n", errors ? "FAIL" : "OK", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,508 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Deferred log (common/utils/dlog.c) on the host: a simulated clock, a
+ * signal handler as the interrupt that logs in the middle of a write or a
+ * drain, threads as the other core.
+ *
+ *   dlog_test [-v] [-n calls] [-r seed]
+ *
+ * Checked:
+ *  - the drained line: timestamp, arguments, own line end replaced by CRLF,
+ *    too long lines cut
+ *  - a full ring keeps the oldest records, counts the new ones as dropped
+ *    and says so once it is empty again
+ *  - DLOG_EVERY() keeps one record per period and reports the calls in
+ *    between as suppressed
+ *  - an output that is busy loses its lines, the other outputs still get
+ *    them; an output that is off is not called
+ *  - the drain stops when its budget is used, the rest stays for later
+ *  - writes from an interrupt and from other threads while draining: no
+ *    record lost but the counted drops, none torn, every writer in order
+ *  - cost of a call, against snprintf() and a write in place
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "dlog.h"
+#include "prng.h"
+
+static uint32_t errors;
+static bool verbose;
+static prng_t rng;
+
+#define FAIL(...) do { if (errors++ < 10) printf(__VA_ARGS__); } while (0)
+
+/* ---------- time base of dlog.c ---------- */
+static volatile uint64_t now_us;
+
+uint64_t dlog_now_us(void)
+{
+    return now_us;
+}
+
+static uint64_t host_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* ---------- outputs ---------- */
+typedef struct {
+    char     text[64 * 1024];
+    size_t   len;
+    uint32_t calls;
+    bool     busy;                  // refuses every batch
+    uint32_t cost_us;               // time a batch takes, on the simulated clock
+} cap_t;
+
+static cap_t cap_usb, cap_udp;
+
+static bool cap_put(cap_t *c, const char *text, uint16_t len)
+{
+    c->calls++;
+    now_us += c->cost_us;
+    if (c->busy)
+        return false;
+    if (strlen(text) != len)
+        FAIL("output: %u bytes said, %zu there\n", len, strlen(text));
+    if (c->len + len < sizeof(c->text)) {
+        memcpy(c->text + c->len, text, (size_t)len + 1u);
+        c->len += len;
+    }
+    return true;
+}
+
+static bool out_usb(const char *text, uint16_t len)
+{
+    return cap_put(&cap_usb, text, len);
+}
+
+static bool out_udp(const char *text, uint16_t len)
+{
+    return cap_put(&cap_udp, text, len);
+}
+
+static bool out_null(const char *text, uint16_t len)
+{
+    (void)text;
+    (void)len;
+    return true;
+}
+
+static void restart(void)
+{
+    dlog_reset();
+    memset(&cap_usb, 0, sizeof(cap_usb));
+    memset(&cap_udp, 0, sizeof(cap_udp));
+    dlog_output(DLOG_OUT_USB, out_usb);
+    dlog_output(DLOG_OUT_CLI, NULL);
+    dlog_output(DLOG_OUT_UDP, out_udp);
+    dlog_route(DLOG_OUT_USB, true);
+    dlog_route(DLOG_OUT_CLI, false);
+    dlog_route(DLOG_OUT_UDP, false);
+    now_us = 0;
+}
+
+static uint32_t count_lines(const char *text)
+{
+    uint32_t n = 0;
+
+    for (const char *p = text; (p = strstr(p, "\r\n")) != NULL; p += 2)
+        n++;
+    return n;
+}
+
+/* ---------- one line ---------- */
+static void test_format(void)
+{
+    static char long_text[2 * DLOG_LINE_MAX];
+
+    restart();
+    now_us = 12345678;
+    DLOG("a %d b %u c %x %s\r\n", -5, 7u, 0xabu, "str");
+    dlog_drain(1000);
+    now_us = 5000000000ull + 1000;      // past 2^32 us: the record keeps the low 32 bits
+    DLOG("no args\n");
+    DLOG("no line end");
+    memset(long_text, 'x', sizeof(long_text) - 1);
+    DLOG("%s\n", long_text);
+    dlog_drain(1000);
+
+    const char *want =
+        "[   12.345] a -5 b 7 c ab str\r\n"
+        "[ 5000.001] no args\r\n"
+        "[ 5000.001] no line end\r\n";
+    if (strncmp(cap_usb.text, want, strlen(want)))
+        FAIL("format: got\n%s", cap_usb.text);
+    const char *last = cap_usb.text + strlen(want);
+    if (strlen(last) != DLOG_LINE_MAX - 1 || strcmp(last + DLOG_LINE_MAX - 3, "\r\n"))
+        FAIL("format: long line of %zu bytes: %s", strlen(last), last);
+    if (dlog_stats()->logged != 4 || dlog_stats()->lines != 4 || dlog_pending())
+        FAIL("format: %u logged, %u lines, %u pending\n", dlog_stats()->logged,
+             dlog_stats()->lines, dlog_pending());
+}
+
+/* ---------- full ring ---------- */
+static void test_overflow(uint32_t extra)
+{
+    char want[64];
+
+    restart();
+    for (uint32_t i = 0; i < DLOG_RING_SIZE + extra; i++)
+        DLOG("rec %u\n", i);
+    if (dlog_pending() != DLOG_RING_SIZE || dlog_stats()->dropped != extra ||
+        dlog_stats()->used_max != DLOG_RING_SIZE)
+        FAIL("overflow %u: %u pending, %u dropped, %u used at most\n", extra, dlog_pending(),
+             dlog_stats()->dropped, dlog_stats()->used_max);
+
+    uint32_t taken = dlog_drain(100000);
+    if (taken != DLOG_RING_SIZE)
+        FAIL("overflow %u: drain took %u\n", extra, taken);
+
+    // the oldest kept, in order, then the drop report
+    const char *p = cap_usb.text;
+    for (uint32_t i = 0; i < DLOG_RING_SIZE; i++) {
+        unsigned v;
+
+        if (!(p = strstr(p, "] rec ")) || sscanf(p, "] rec %u", &v) != 1 || v != i) {
+            FAIL("overflow %u: record %u missing or out of order\n", extra, i);
+            return;
+        }
+        p++;
+    }
+    snprintf(want, sizeof(want), "dlog: %u records dropped", extra);
+    if (extra && !strstr(p, want))
+        FAIL("overflow %u: no \"%s\"\n", extra, want);
+    if (!extra && strstr(cap_usb.text, "dropped"))
+        FAIL("overflow 0: drops reported\n");
+
+    // reported once; new drops only
+    size_t before = cap_usb.len;
+    dlog_drain(100000);
+    if (cap_usb.len != before)
+        FAIL("overflow %u: reported twice\n", extra);
+    for (uint32_t i = 0; i < DLOG_RING_SIZE + 3; i++)
+        DLOG("again %u\n", i);
+    dlog_drain(100000);
+    if (!strstr(cap_usb.text + before, "dlog: 3 records dropped"))
+        FAIL("overflow %u: second overflow not reported as 3\n", extra);
+}
+
+/* ---------- rate limit ---------- */
+static void tick(uint32_t i)
+{
+    DLOG_EVERY(100, "tick %u\n", i);
+}
+
+static void test_rate(void)
+{
+    restart();
+    now_us = 1000;
+    for (uint32_t i = 0; i < 100; i++, now_us += 10000)     // 1 s of calls every 10 ms
+        tick(i);
+    dlog_drain(100000);
+
+    if (dlog_stats()->logged != 10 || dlog_stats()->suppressed != 90)
+        FAIL("rate: %u logged, %u suppressed, expected 10 / 90\n", dlog_stats()->logged,
+             dlog_stats()->suppressed);
+    const char *p = cap_usb.text;
+    for (uint32_t k = 0; k < 10; k++) {
+        unsigned v, sup = 0;
+
+        if (!(p = strstr(p, "] tick ")) || sscanf(p, "] tick %u (+%u suppressed)", &v, &sup) < 1 ||
+            v != k * 10 || sup != (k ? 9u : 0u)) {
+            FAIL("rate: line %u: %.40s\n", k, p ? p : "missing");
+            return;
+        }
+        p++;
+    }
+
+    // a call after a long silence is not suppressed, the count carries over
+    now_us += 5000000;
+    tick(1000);
+    dlog_drain(1000);
+    if (!strstr(cap_usb.text, "tick 1000 (+9 suppressed)"))
+        FAIL("rate: last line %s", strrchr(cap_usb.text, '['));
+}
+
+/* ---------- outputs ---------- */
+static void test_outputs(void)
+{
+    restart();
+    dlog_route(DLOG_OUT_UDP, true);
+    cap_usb.busy = true;
+    for (uint32_t i = 0; i < 20; i++)
+        DLOG("out %u\n", i);
+    dlog_drain(100000);
+    if (dlog_stats()->lost[DLOG_OUT_USB] != 20 || dlog_stats()->lost[DLOG_OUT_UDP] != 0 ||
+        count_lines(cap_udp.text) != 20)
+        FAIL("outputs: usb lost %u, udp lost %u, udp got %u lines\n", dlog_stats()->lost[DLOG_OUT_USB],
+             dlog_stats()->lost[DLOG_OUT_UDP], count_lines(cap_udp.text));
+    if (cap_udp.calls < 2)
+        FAIL("outputs: 20 lines in %u batch\n", cap_udp.calls);
+    if (dlog_pending())
+        FAIL("outputs: a busy output kept %u records\n", dlog_pending());
+
+    // off: not called; none on: the records still go
+    uint32_t calls = cap_udp.calls;
+    dlog_route(DLOG_OUT_UDP, false);
+    dlog_route(DLOG_OUT_USB, false);
+    DLOG("nobody\n");
+    dlog_drain(1000);
+    if (cap_udp.calls != calls || dlog_pending())
+        FAIL("outputs: off output called, %u pending\n", dlog_pending());
+    if (dlog_routed(DLOG_OUT_CLI))
+        FAIL("outputs: cli without a function is routed\n");
+}
+
+/* ---------- budget ---------- */
+static void test_budget(void)
+{
+    restart();
+    cap_usb.cost_us = 300;
+    for (uint32_t i = 0; i < DLOG_RING_SIZE; i++)
+        DLOG("budget %u\n", i);
+
+    uint32_t rounds = 0, first = 0;
+    while (dlog_pending() && rounds < 100) {
+        uint32_t calls = cap_usb.calls;
+        uint32_t taken = dlog_drain(400);
+
+        if (!rounds)
+            first = taken;
+        if (cap_usb.calls - calls > 2)
+            FAIL("budget: %u batches of 300 us in a 400 us drain\n", cap_usb.calls - calls);
+        rounds++;
+    }
+    if (first == 0 || first >= DLOG_RING_SIZE || rounds < 2)
+        FAIL("budget: first drain took %u of %u, %u drains\n", first, DLOG_RING_SIZE, rounds);
+    if (count_lines(cap_usb.text) != DLOG_RING_SIZE)
+        FAIL("budget: %u lines of %u\n", count_lines(cap_usb.text), DLOG_RING_SIZE);
+
+    // budget 0: still one batch
+    DLOG("one\n");
+    if (dlog_drain(0) != 1)
+        FAIL("budget: nothing drained with budget 0\n");
+    if (verbose)
+        printf("  budget: %u drains of 400 us for %u records\n", rounds, DLOG_RING_SIZE);
+}
+
+/* ---------- writers of other contexts ---------- */
+typedef struct {
+    uint32_t next[8];               // expected next number of every writer
+    uint32_t lines, torn, order;
+} check_t;
+
+static check_t chk;
+
+/* "w <writer> <n> <~n>": numbers go up per writer, gaps are drops */
+static bool out_check(const char *text, uint16_t len)
+{
+    const char *p = text;
+
+    (void)len;
+    while ((p = strstr(p, "] w ")) != NULL) {
+        unsigned w, n, inv;
+
+        p += 4;
+        if (sscanf(p, "%u %u %u", &w, &n, &inv) != 3 || w >= 8 || inv != (~n & 0xFFFFFFFFu)) {
+            chk.torn++;
+            continue;
+        }
+        if (n < chk.next[w])
+            chk.order++;
+        chk.next[w] = n + 1;
+        chk.lines++;
+    }
+    return true;
+}
+
+static void restart_check(void)
+{
+    restart();
+    memset(&chk, 0, sizeof(chk));
+    dlog_output(DLOG_OUT_USB, out_check);
+}
+
+static void check_totals(const char *what, uint32_t written)
+{
+    const dlog_stats_t *st = dlog_stats();
+
+    if (chk.torn || chk.order)
+        FAIL("%s: %u torn, %u out of order\n", what, chk.torn, chk.order);
+    if (st->logged + st->dropped != written || chk.lines != st->logged || dlog_pending())
+        FAIL("%s: %u written, %u logged + %u dropped, %u lines, %u pending\n", what, written,
+             st->logged, st->dropped, chk.lines, dlog_pending());
+    if (verbose)
+        printf("  %s: %u written, %u dropped, %u used at most\n", what, written, st->dropped, st->used_max);
+}
+
+static volatile uint32_t irq_n;
+
+static void on_alarm(int sig)
+{
+    (void)sig;
+    DLOG("w 1 %u %u\n", irq_n, ~irq_n);
+    irq_n++;
+}
+
+static void test_preempt(uint32_t ms)
+{
+    struct itimerval it = { { 0, 29 }, { 0, 29 } };
+    uint64_t end = host_ns() + (uint64_t)ms * 1000000u;
+    uint32_t main_n = 0;
+
+    restart_check();
+    irq_n = 0;
+    signal(SIGALRM, on_alarm);
+    setitimer(ITIMER_REAL, &it, NULL);
+    while (host_ns() < end) {
+        uint32_t burst = 1 + prng_below(&rng, DLOG_RING_SIZE);
+
+        for (uint32_t i = 0; i < burst; i++, main_n++)
+            DLOG("w 0 %u %u\n", main_n, ~main_n);
+        dlog_drain(1000);       // the signal comes in the drain too
+    }
+    memset(&it, 0, sizeof(it));
+    setitimer(ITIMER_REAL, &it, NULL);
+    signal(SIGALRM, SIG_DFL);
+    while (dlog_drain(1000))
+        ;
+    check_totals("preempt", main_n + irq_n);
+    if (!irq_n)
+        FAIL("preempt: no signal came\n");
+}
+
+#define THREADS         3
+static volatile bool threads_done;
+
+static void *writer_thread(void *arg)
+{
+    uint32_t w = (uint32_t)(uintptr_t)arg;
+
+    for (uint32_t i = 0; i < 200000; i++) {
+        DLOG("w %u %u %u\n", w, i, ~i);
+        if ((i & 63) == 0)
+            usleep(20);             // the drain keeps up with some of it
+    }
+    return NULL;
+}
+
+static void *drain_thread(void *arg)
+{
+    (void)arg;
+    while (!threads_done || dlog_pending())
+        dlog_drain(1000);
+    return NULL;
+}
+
+static void test_threads(void)
+{
+    pthread_t t[THREADS], d;
+
+    restart_check();
+    threads_done = false;
+    pthread_create(&d, NULL, drain_thread, NULL);
+    for (uintptr_t w = 0; w < THREADS; w++)
+        pthread_create(&t[w], NULL, writer_thread, (void *)(w + 2));
+    for (int w = 0; w < THREADS; w++)
+        pthread_join(t[w], NULL);
+    threads_done = true;
+    pthread_join(d, NULL);
+    dlog_drain(1000);           // the drop report
+    check_totals("threads", THREADS * 200000u);
+}
+
+/* ---------- cost ---------- */
+static void test_cost(uint32_t n)
+{
+    static char line[DLOG_LINE_MAX];
+    FILE *null = fopen("/dev/null", "w");
+    uint64_t t_log = 0, t_drain = 0, t_sup, t_fmt;
+    uint32_t lines = 0;
+
+    restart();
+    dlog_output(DLOG_OUT_USB, out_null);
+    for (uint32_t i = 0; i < n; i += DLOG_RING_SIZE) {
+        uint64_t t0 = host_ns();
+
+        for (uint32_t k = 0; k < DLOG_RING_SIZE; k++)
+            DLOG("PWM target RGBW changed to: %u %u %u %u\n", i, k, 3u, 4u);
+        uint64_t t1 = host_ns();
+        lines += dlog_drain(1000000);
+        t_drain += host_ns() - t1;
+        t_log += t1 - t0;
+    }
+    if (dlog_stats()->dropped)
+        FAIL("cost: %u dropped\n", dlog_stats()->dropped);
+
+    // suppressed: the clock stands still, every call after the first is rate limited
+    uint64_t t0 = host_ns();
+    for (uint32_t i = 0; i < n; i++)
+        DLOG_EVERY(100, "suppressed %u\n", i);
+    t_sup = host_ns() - t0;
+    dlog_drain(1000);
+
+    // what the call site did before: format and write in place
+    t0 = host_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        int len = snprintf(line, sizeof(line), "PWM target RGBW changed to: %u %u %u %u\n", i, i, 3u, 4u);
+
+        fwrite(line, 1, (size_t)len, null);
+    }
+    fflush(null);
+    t_fmt = host_ns() - t0;
+    fclose(null);
+
+    printf("  DLOG %.1f ns, suppressed %.1f ns, printf in place %.1f ns, drain %.1f ns a line\n",
+           (double)t_log / n, (double)t_sup / n, (double)t_fmt / n, (double)t_drain / (lines ? lines : 1));
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t n = 0, seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "vn:r:")) != -1) {
+        switch (opt) {
+        case 'v': verbose = true; break;
+        case 'n': n = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'r': seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-v] [-n calls] [-r seed]\n", argv[0]);
+            return 2;
+        }
+    }
+    prng_seed(&rng, seed, 49);
+
+    test_format();
+    test_overflow(0);
+    test_overflow(1);
+    test_overflow(3 * DLOG_RING_SIZE);
+    test_rate();
+    test_outputs();
+    test_budget();
+    test_preempt(200);
+    test_threads();
+    test_cost(n ? n : 1000000);
+
+    printf("%s: %u errors\n", errors ? "FAIL" : "OK", errors);
+    return errors ? 1 : 0;
+}
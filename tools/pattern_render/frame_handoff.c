@@ -0,0 +1,269 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Host emulation of the stairs WS2815_CORE1 frame handoff.
+ * Two threads stand in for the cores and use the same spsc_queue.h and
+ * buffer ownership rules as ws2815_control_dma_parallel.c:
+ *   core 0: network receive (simulated cost), copy into a free buffer, push ready
+ *   core 1: pop newest ready frame, bit-plane transpose, wait for "DMA", return buffer
+ * Every buffer carries an owner tag and a sequence number stamped over the whole
+ * frame, so a write into a buffer owned by the other side, a torn frame or an
+ * out-of-order frame is reported.
+ * The same work is then run as the single-core loop to compare frame rates.
+ *
+ * Network, render and DMA times are target costs simulated with sleeps, so
+ * the numbers hold on a single-CPU host; the real transpose also runs for
+ * the tear check.
+ *
+ *   frame_handoff [-n frames] [-w net_us] [-r render_us] [-d dma_us]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "spsc_queue.h"
+
+#define NUM_CHANNELS        3       // stairs_ws2815/config.h
+#define NUM_PIXELS          57
+#define NUM_STRIPS          16
+#define VALUE_PLANE_COUNT   8
+#define DDP_FB_COUNT        3
+
+#define OWNER_CORE0         0
+#define OWNER_CORE1         1
+
+typedef uint8_t strip_buffer_t[NUM_PIXELS][NUM_CHANNELS];
+typedef struct {
+    uint32_t planes[VALUE_PLANE_COUNT];
+} value_bits_t;
+
+static strip_buffer_t rx_frame[NUM_STRIPS];                 // socket buffer of core 0
+static strip_buffer_t ddp_fb[DDP_FB_COUNT][NUM_STRIPS];
+static volatile uint32_t ddp_owner[DDP_FB_COUNT];
+static value_bits_t colors[2][NUM_PIXELS * NUM_CHANNELS];
+static spsc_queue_t fb_free_q, fb_ready_q;
+
+static uint32_t net_us = 1500;      // W6100 SPI read + DDP parse of one 2736 byte frame
+static uint32_t render_us = 900;    // transform_framebuf() on the RP2350
+static uint32_t dma_us = 2050;      // 57 px * 24 bit * 1.25 us + 300 us reset
+static uint64_t dma_done_ns;
+
+static volatile bool producer_done;
+static uint32_t errors, frames_out, frames_dropped, last_seq;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t t) {
+    struct timespec ts = { (time_t)(t / 1000000000u), (long)(t % 1000000000u) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL))
+        ;
+}
+
+static void sleep_us(uint32_t us) {
+    sleep_until_ns(now_ns() + (uint64_t)us * 1000u);
+}
+
+/**
+ * Same transpose as transform_framebuf() in ws2815_control_dma_parallel.c
+ */
+static void transform_framebuf(strip_buffer_t *strips, value_bits_t *values) {
+    for (uint32_t p = 0; p < NUM_PIXELS; p++) {
+        uint32_t g = p * NUM_CHANNELS, r = g + 1, b = g + 2;
+        memset(&values[g], 0, sizeof(values[0]) * NUM_CHANNELS);
+        for (uint32_t i = 0; i < NUM_STRIPS; i++) {
+            uint8_t value_red = strips[i][p][0];
+            uint8_t value_green = strips[i][p][1];
+            uint8_t value_blue = strips[i][p][2];
+            for (int j = 0; j < VALUE_PLANE_COUNT; j++) {
+                if (value_red & 1u)
+                    values[r].planes[VALUE_PLANE_COUNT - 1 - j] |= 1u << i;
+                if (value_green & 1u)
+                    values[g].planes[VALUE_PLANE_COUNT - 1 - j] |= 1u << i;
+                if (value_blue & 1u)
+                    values[b].planes[VALUE_PLANE_COUNT - 1 - j] |= 1u << i;
+                value_red >>= 1u;
+                value_green >>= 1u;
+                value_blue >>= 1u;
+                if (!(value_red || value_green || value_blue))
+                    break;
+            }
+        }
+    }
+}
+
+/**
+ * Network side of one frame: "receive" it into the socket buffer.
+ * The sequence number is stamped into every pixel, low byte in the
+ * first channel and high bits spread over the rest.
+ */
+static void net_receive(uint32_t seq) {
+    sleep_us(net_us);
+    for (uint32_t s = 0; s < NUM_STRIPS; s++)
+        for (uint32_t p = 0; p < NUM_PIXELS; p++) {
+            rx_frame[s][p][0] = (uint8_t)seq;
+            rx_frame[s][p][1] = (uint8_t)(seq >> 8);
+            rx_frame[s][p][2] = (uint8_t)(seq >> 16);
+        }
+}
+
+static uint32_t frame_seq(strip_buffer_t *fb) {
+    return fb[0][0][0] | (uint32_t)fb[0][0][1] << 8 | (uint32_t)fb[0][0][2] << 16;
+}
+
+/**
+ * Output side: transpose into the back plane set, wait for the previous
+ * DMA (sem_acquire_blocking on target) and start the next one.
+ */
+static void output(strip_buffer_t *fb, uint8_t *back) {
+    uint64_t t = now_ns();
+    transform_framebuf(fb, colors[*back]);
+    sleep_until_ns(t + (uint64_t)render_us * 1000u);
+    sleep_until_ns(dma_done_ns);
+    dma_done_ns = now_ns() + (uint64_t)dma_us * 1000u;
+    *back ^= 1u;
+}
+
+static void check_frame(strip_buffer_t *fb) {
+    uint32_t seq = frame_seq(fb);
+
+    if (memcmp(fb[0], fb[NUM_STRIPS - 1], sizeof(fb[0])) != 0) {
+        fprintf(stderr, "torn frame %u\n", seq);
+        errors++;
+    }
+    if (seq <= last_seq) {
+        fprintf(stderr, "frame %u after %u\n", seq, last_seq);
+        errors++;
+    }
+    last_seq = seq;
+}
+
+static void *core1_thread(void *arg) {
+    uint8_t idx, newer, back = 0;
+    (void)arg;
+
+    for (;;) {
+        if (!spsc_pop(&fb_ready_q, &idx)) {
+            if (__atomic_load_n(&producer_done, __ATOMIC_ACQUIRE) && !spsc_count(&fb_ready_q))
+                break;
+            sleep_us(20);
+            continue;
+        }
+        while (spsc_pop(&fb_ready_q, &newer)) {
+            ddp_owner[idx] = OWNER_CORE0;
+            spsc_push(&fb_free_q, idx);
+            frames_dropped++;
+            idx = newer;
+        }
+        if (ddp_owner[idx] != OWNER_CORE1) {
+            fprintf(stderr, "core 1 got buffer %u owned by core 0\n", idx);
+            errors++;
+        }
+        check_frame(ddp_fb[idx]);
+        output(ddp_fb[idx], &back);
+        ddp_owner[idx] = OWNER_CORE0;
+        spsc_push(&fb_free_q, idx);
+        frames_out++;
+    }
+    return NULL;
+}
+
+static double run_dual(uint32_t frames) {
+    pthread_t th;
+    uint32_t dropped_core0 = 0;
+    uint8_t idx;
+
+    spsc_init(&fb_free_q);
+    spsc_init(&fb_ready_q);
+    for (uint8_t i = 0; i < DDP_FB_COUNT; i++) {
+        ddp_owner[i] = OWNER_CORE0;
+        spsc_push(&fb_free_q, i);
+    }
+    producer_done = false;
+    frames_out = frames_dropped = last_seq = 0;
+    dma_done_ns = 0;
+
+    uint64_t t0 = now_ns();
+    pthread_create(&th, NULL, core1_thread, NULL);
+    for (uint32_t seq = 1; seq <= frames; seq++) {
+        net_receive(seq);
+        if (!spsc_pop(&fb_free_q, &idx)) {
+            dropped_core0++;
+            continue;
+        }
+        if (ddp_owner[idx] != OWNER_CORE0) {
+            fprintf(stderr, "core 0 got buffer %u owned by core 1\n", idx);
+            errors++;
+        }
+        memcpy(ddp_fb[idx], rx_frame, sizeof(ddp_fb[0]));
+        ddp_owner[idx] = OWNER_CORE1;
+        spsc_push(&fb_ready_q, idx);
+    }
+    __atomic_store_n(&producer_done, true, __ATOMIC_RELEASE);
+    pthread_join(th, NULL);
+    uint64_t dt = now_ns() - t0;
+
+    frames_dropped += dropped_core0;
+    printf("dual core  : %u frames out, %u dropped, %.1f fps\n",
+           frames_out, frames_dropped, frames_out * 1e9 / (double)dt);
+    return frames_out * 1e9 / (double)dt;
+}
+
+static double run_single(uint32_t frames) {
+    strip_buffer_t framebuf[NUM_STRIPS];
+    uint8_t back = 0;
+
+    dma_done_ns = 0;
+    last_seq = 0;
+
+    uint64_t t0 = now_ns();
+    for (uint32_t seq = 1; seq <= frames; seq++) {
+        net_receive(seq);
+        memcpy(framebuf, rx_frame, sizeof(framebuf));   // ws2815_show()
+        check_frame(framebuf);
+        output(framebuf, &back);                        // ws2815_loop()
+    }
+    uint64_t dt = now_ns() - t0;
+
+    printf("single core: %u frames out, %.1f fps\n", frames, frames * 1e9 / (double)dt);
+    return frames * 1e9 / (double)dt;
+}
+
+int main(int argc, char **argv) {
+    uint32_t frames = 500;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:w:r:d:")) != -1) {
+        switch (opt) {
+        case 'n': frames = (uint32_t)atoi(optarg); break;
+        case 'w': net_us = (uint32_t)atoi(optarg); break;
+        case 'r': render_us = (uint32_t)atoi(optarg); break;
+        case 'd': dma_us = (uint32_t)atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n frames] [-w net_us] [-r render_us] [-d dma_us]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!frames || frames > 0xFFFFFFu)
+        frames = 500;
+
+    printf("per frame  : network %u us, render %u us, DMA %u us\n", net_us, render_us, dma_us);
+
+    double single = run_single(frames);
+    double dual = run_dual(frames);
+
+    printf("speedup    : %.2fx, handoff errors: %u\n", dual / single, errors);
+    return errors ? 1 : 0;
+}
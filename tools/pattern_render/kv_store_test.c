@@ -0,0 +1,627 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Config partition key/value store (common/flash/kv_store.c) on a NOR
+ * flash emulator: erase sets a sector to 0xFF, program only clears bits.
+ * The power goes at a chosen byte: the byte being programmed keeps some
+ * of its new bits, the 256 bytes being erased get some of theirs back.
+ *
+ *   kv_store_test [-v] [-n ops] [-r seed]
+ *
+ * Checked:
+ *  - put / get / delete / lengths / limits, the same after a remount
+ *  - random puts, deletes and transactions against a RAM model, with
+ *    remounts: the ring wraps many times, every sector is erased as often
+ *    as the others, within two (the format erases one sector out of turn)
+ *  - a power cut at every byte of a put that rolls the ring, of a
+ *    transaction across a roll and of a format with import, then another
+ *    cut in the mount that follows: the store has the state before the
+ *    operation or the one after, nothing else, and takes new puts
+ *  - random cuts during a long run, the same
+ *  - write amplification of "config save" and of a mixed load, against
+ *    the erase and rewrite of a sector per save that was there before
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "kv_store.h"
+#include "prng.h"
+
+static uint32_t errors;
+static bool verbose;
+static prng_t rng;
+
+#define FAIL(...) do { if (errors++ < 10) printf(__VA_ARGS__); } while (0)
+
+/* ---------- NOR flash emulator ---------- */
+#define FLASH_SIZE      (KV_SECTORS * KV_SECTOR_SIZE)
+#define ERASE_UNIT      256             // an erase goes 256 bytes at a time
+
+typedef struct {
+    uint64_t read;                      // bytes
+    uint64_t programmed;                // bytes
+    uint64_t pages;                     // 256 byte pages a program touched
+    uint64_t erases;
+    uint32_t sector_erases[KV_SECTORS];
+    uint32_t overprogrammed;            // bytes programmed with a 1 where the flash had a 0
+} flash_stats_t;
+
+static uint8_t s_flash[FLASH_SIZE];
+static flash_stats_t fl;
+static int64_t cut_left = -1;           // bytes programmed / erase units until the power goes
+static bool dead;
+
+static bool spend(void)
+{
+    if (dead)
+        return false;
+    if (cut_left < 0)
+        return true;
+    if (cut_left == 0) {
+        dead = true;
+        return false;
+    }
+    cut_left--;
+    return true;
+}
+
+bool kv_flash_read(uint32_t offset, void *data, uint32_t len)
+{
+    if (offset + len > FLASH_SIZE)
+        return false;
+    memcpy(data, s_flash + offset, len);
+    fl.read += len;
+    return true;
+}
+
+bool kv_flash_program(uint32_t offset, const void *data, uint32_t len)
+{
+    const uint8_t *d = data;
+
+    if (dead || offset + len > FLASH_SIZE)
+        return false;
+    if (len)
+        fl.pages += (offset + len - 1) / 256 - offset / 256 + 1;
+    for (uint32_t i = 0; i < len; i++) {
+        uint8_t *p = &s_flash[offset + i];
+
+        if (!spend()) {
+            *p &= (uint8_t)(d[i] | prng_below(&rng, 256));  // some of the bits made it
+            return false;
+        }
+        if ((*p & d[i]) != d[i])
+            fl.overprogrammed++;
+        *p &= d[i];
+        fl.programmed++;
+    }
+    return true;
+}
+
+bool kv_flash_erase(uint32_t offset)
+{
+    if (dead || offset % KV_SECTOR_SIZE || offset >= FLASH_SIZE)
+        return false;
+    fl.erases++;
+    fl.sector_erases[offset / KV_SECTOR_SIZE]++;
+    for (uint32_t u = 0; u < KV_SECTOR_SIZE; u += ERASE_UNIT) {
+        uint8_t *p = s_flash + offset + u;
+
+        if (!spend()) {
+            for (uint32_t i = 0; i < ERASE_UNIT; i++)
+                p[i] |= (uint8_t)prng_below(&rng, 256);
+            return false;
+        }
+        memset(p, 0xFF, ERASE_UNIT);
+    }
+    return true;
+}
+
+static void flash_blank(void)
+{
+    memset(s_flash, 0xFF, sizeof(s_flash));
+    memset(&fl, 0, sizeof(fl));
+    cut_left = -1;
+    dead = false;
+}
+
+/* the power comes back */
+static void power_on(void)
+{
+    cut_left = -1;
+    dead = false;
+}
+
+/* ---------- RAM model ---------- */
+#define KEYS            20
+
+typedef struct {
+    bool     present[KEYS];
+    uint16_t len[KEYS];
+    uint8_t  val[KEYS][KV_VALUE_MAX];
+} model_t;
+
+static uint16_t key_of(uint32_t i)
+{
+    return KV_KEY(KV_TYPE_NET + i % 5, i / 5);
+}
+
+static bool model_eq(const model_t *m, bool report, const char *what)
+{
+    static uint8_t buf[KV_VALUE_MAX];
+
+    for (uint32_t i = 0; i < KEYS; i++) {
+        int len = kv_get(key_of(i), buf, sizeof(buf));
+
+        if (!m->present[i] ? len == -1 :
+            (len == m->len[i] && !memcmp(buf, m->val[i], m->len[i])))
+            continue;
+        if (report)
+            FAIL("%s: key %04x has %d bytes, %s %u\n", what, key_of(i), len,
+                 m->present[i] ? "want" : "want none, not", m->len[i]);
+        return false;
+    }
+    return true;
+}
+
+/* ---------- operations ---------- */
+#define OP_PUTS         4
+
+typedef struct {
+    uint8_t  n;
+    bool     txn;
+    uint8_t  key[OP_PUTS];
+    bool     del[OP_PUTS];
+    uint16_t len[OP_PUTS];
+    uint8_t  val[OP_PUTS][KV_VALUE_MAX];
+} op_t;
+
+static uint16_t random_len(void)
+{
+    return (uint16_t)(prng_below(&rng, 8) ? prng_below(&rng, 200) : prng_below(&rng, KV_VALUE_MAX + 1));
+}
+
+static void op_random(op_t *op)
+{
+    uint32_t r = prng_below(&rng, 100);
+
+    op->txn = r >= 80;
+    op->n = (uint8_t)(op->txn ? 1 + prng_below(&rng, OP_PUTS) : 1);
+    for (uint8_t j = 0; j < op->n; j++) {
+        op->key[j] = (uint8_t)prng_below(&rng, KEYS);
+        op->del[j] = prng_below(&rng, 10) == 0;
+        op->len[j] = op->txn ? (uint16_t)prng_below(&rng, 400) : random_len();
+        for (uint16_t b = 0; b < op->len[j]; b++)
+            op->val[j][b] = (uint8_t)prng_u32(&rng);
+    }
+}
+
+static bool op_run(const op_t *op)
+{
+    bool ok = true;
+
+    if (op->txn && !kv_begin())
+        return false;
+    for (uint8_t j = 0; j < op->n && ok; j++) {
+        uint16_t key = key_of(op->key[j]);
+
+        ok = op->del[j] ? kv_delete(key) : kv_put(key, op->val[j], op->len[j]);
+    }
+    if (!op->txn)
+        return ok;
+    if (!ok) {
+        kv_abort();
+        return false;
+    }
+    return kv_commit();
+}
+
+static void op_apply(model_t *m, const op_t *op)
+{
+    for (uint8_t j = 0; j < op->n; j++) {
+        uint8_t k = op->key[j];
+
+        m->present[k] = !op->del[j];
+        m->len[k] = op->del[j] ? 0 : op->len[j];
+        memcpy(m->val[k], op->val[j], m->len[k]);
+    }
+}
+
+static bool mount_after_cut(uint32_t second_cut)
+{
+    power_on();
+    if (second_cut) {
+        cut_left = second_cut;          // and once more while mounting
+        kv_mount();
+        power_on();
+    }
+    return kv_mount();
+}
+
+/* after a cut in op: the state before it or after it; the model follows */
+static void check_cut(model_t *m, const op_t *op, const char *what, uint32_t *before, uint32_t *after)
+{
+    static model_t next;
+
+    next = *m;
+    op_apply(&next, op);
+    if (model_eq(m, false, what)) {
+        (*before)++;
+    } else if (model_eq(&next, false, what)) {
+        (*after)++;
+        *m = next;
+    } else {
+        FAIL("%s: neither the state before nor after\n", what);
+        model_eq(m, true, what);
+        model_eq(&next, true, what);
+    }
+}
+
+/* ---------- basics ---------- */
+static void test_basic(void)
+{
+    uint8_t big[KV_VALUE_MAX + 1], buf[KV_VALUE_MAX + 1];
+    const uint16_t a = KV_KEY(KV_TYPE_NET, 0), b = KV_KEY(KV_TYPE_LAYOUT, 3);
+
+    flash_blank();
+    memset(big, 0x5A, sizeof(big));
+    if (kv_mount())
+        FAIL("basic: mounted a blank partition\n");
+    if (kv_put(a, "x", 1))
+        FAIL("basic: put without a store\n");
+    if (!kv_format(0, NULL, NULL))
+        FAIL("basic: format\n");
+    if (kv_get(a, buf, sizeof(buf)) != -1)
+        FAIL("basic: value in a new store\n");
+    if (!kv_put(a, "hello", 5) || !kv_put(b, big, KV_VALUE_MAX) || !kv_put(a, "hello world", 11))
+        FAIL("basic: put\n");
+    if (kv_put(b, big, KV_VALUE_MAX + 1) || kv_put(0xFFFF, "x", 1) || kv_put(0xFFFE, "x", 1))
+        FAIL("basic: put of a value too long or a reserved key\n");
+    if (kv_get(a, buf, 10) != -1)
+        FAIL("basic: got a value into a buffer too short\n");
+    for (int pass = 0; pass < 2; pass++) {
+        if (kv_get(a, buf, sizeof(buf)) != 11 || memcmp(buf, "hello world", 11))
+            FAIL("basic: get after overwrite, pass %d\n", pass);
+        if (kv_get(b, buf, sizeof(buf)) != KV_VALUE_MAX || memcmp(buf, big, KV_VALUE_MAX))
+            FAIL("basic: get of the longest value, pass %d\n", pass);
+        if (!kv_mount())
+            FAIL("basic: remount\n");
+    }
+    if (!kv_delete(a) || kv_get(a, buf, sizeof(buf)) != -1 || !kv_delete(a))
+        FAIL("basic: delete\n");
+    if (!kv_put(a, "", 0) || kv_get(a, buf, sizeof(buf)) != 0)
+        FAIL("basic: empty value\n");
+    if (!kv_mount() || kv_get(a, buf, sizeof(buf)) != 0 || kv_get(b, buf, sizeof(buf)) != KV_VALUE_MAX)
+        FAIL("basic: remount after delete and empty value\n");
+
+    // a transaction: nothing before its commit, nothing after an abort
+    if (!kv_begin() || kv_begin() || !kv_put(a, "t1", 2) || !kv_delete(b))
+        FAIL("basic: transaction\n");
+    if (kv_get(a, buf, sizeof(buf)) != 0 || kv_get(b, buf, sizeof(buf)) != KV_VALUE_MAX)
+        FAIL("basic: transaction seen before its commit\n");
+    if (!kv_commit() || kv_get(a, buf, sizeof(buf)) != 2 || kv_get(b, buf, sizeof(buf)) != -1)
+        FAIL("basic: commit\n");
+    if (!kv_begin() || !kv_put(a, "t2", 2))
+        FAIL("basic: second transaction\n");
+    kv_abort();
+    if (!kv_begin() || !kv_put(b, "t3", 2) || !kv_commit())
+        FAIL("basic: transaction after an abort\n");
+    if (!kv_mount() || kv_get(a, buf, sizeof(buf)) != 2 || memcmp(buf, "t1", 2) ||
+        kv_get(b, buf, sizeof(buf)) != 2)
+        FAIL("basic: aborted transaction counts\n");
+    kv_delete(b);
+
+    // keys and space
+    uint32_t n = 0;
+    while (kv_put(KV_KEY(KV_TYPE_PATTERN, n), &n, sizeof(n)))
+        n++;
+    if (n != KV_KEYS_MAX - 1)
+        FAIL("basic: %u keys taken, want %u\n", n + 1, KV_KEYS_MAX);
+    for (uint32_t i = 0; i < n; i++)
+        kv_delete(KV_KEY(KV_TYPE_PATTERN, i));
+    for (n = 0; kv_put(KV_KEY(KV_TYPE_CALIB, n), big, KV_VALUE_MAX); n++)
+        ;
+    kv_stats_t st;
+    kv_stats(&st);
+    if (n < KV_LIVE_MAX / (KV_VALUE_MAX + 16) - 1 || st.live > KV_LIVE_MAX)
+        FAIL("basic: %u values of %u bytes fit, %u bytes live\n", n, KV_VALUE_MAX, st.live);
+    if (!kv_mount() || kv_get(KV_KEY(KV_TYPE_CALIB, n - 1), buf, sizeof(buf)) != KV_VALUE_MAX)
+        FAIL("basic: full store after remount\n");
+    if (fl.overprogrammed)
+        FAIL("basic: %u bytes programmed over programmed ones\n", fl.overprogrammed);
+}
+
+/* ---------- random operations, no cuts ---------- */
+static void test_model(uint32_t ops)
+{
+    static model_t m;
+    static op_t op;
+
+    flash_blank();
+    memset(&m, 0, sizeof(m));
+    kv_format(3, NULL, NULL);
+    for (uint32_t i = 0; i < ops; i++) {
+        if (prng_below(&rng, 50) == 0 && !kv_mount())
+            FAIL("model: remount %u\n", i);
+        op_random(&op);
+        if (!op_run(&op)) {
+            FAIL("model: op %u failed\n", i);
+            break;
+        }
+        op_apply(&m, &op);
+        if (!model_eq(&m, true, "model"))
+            break;
+    }
+
+    uint32_t lo = UINT32_MAX, hi = 0;
+    for (int s = 0; s < KV_SECTORS; s++) {
+        lo = (fl.sector_erases[s] < lo) ? fl.sector_erases[s] : lo;
+        hi = (fl.sector_erases[s] > hi) ? fl.sector_erases[s] : hi;
+    }
+    if (hi - lo > 2 || hi < 10)
+        FAIL("model: sector erases %u..%u\n", lo, hi);
+    if (fl.overprogrammed)
+        FAIL("model: %u bytes programmed over programmed ones\n", fl.overprogrammed);
+    if (verbose) {
+        char msg[400];
+
+        kv_show(msg, sizeof(msg));
+        printf("model: %u ops, sector erases %u..%u\n%s", ops, lo, hi, msg);
+    }
+}
+
+/* ---------- a cut at every byte of one operation ---------- */
+typedef enum { SWEEP_ROLL, SWEEP_TXN, SWEEP_FORMAT } sweep_t;
+
+static const char *const sweep_names[] = { "roll", "txn", "format" };
+
+static model_t s_import;
+
+static bool import_model(void *ctx)
+{
+    const model_t *m = ctx;
+
+    for (uint32_t i = 0; i < KEYS; i++) {
+        if (m->present[i] && !kv_put(key_of(i), m->val[i], m->len[i]))
+            return false;
+    }
+    return true;
+}
+
+static void sweep(sweep_t kind)
+{
+    static uint8_t image[FLASH_SIZE];
+    static model_t m0, m;
+    static op_t op;
+    uint32_t before = 0, after = 0, cut;
+    bool done = false;
+    kv_stats_t st;
+
+    // the state the operation starts from
+    flash_blank();
+    memset(&m0, 0, sizeof(m0));
+    if (kv_format(0, NULL, NULL)) {
+        for (uint32_t i = 0; ; i++) {
+            op.txn = false;
+            op.n = 1;
+            op.key[0] = (uint8_t)(i % 12);
+            op.del[0] = false;
+            op.len[0] = (uint16_t)(100 + prng_below(&rng, 200));
+            memset(op.val[0], (int)i, op.len[0]);
+            op_run(&op);
+            op_apply(&m0, &op);
+            kv_stats(&st);
+            if (st.seq > KV_SECTORS + 2 && st.free >= 150 && st.free < 300)
+                break;                  // a 100 byte put fits, a 400 byte one rolls
+        }
+    }
+    memset(&op, 0, sizeof(op));
+    op.txn = kind == SWEEP_TXN;
+    op.n = op.txn ? 3 : 1;
+    for (uint8_t j = 0; j < op.n; j++) {
+        op.key[j] = (uint8_t)(j * 5);
+        op.len[j] = (op.txn && j == 0) ? 100 : 400;
+        memset(op.val[j], 0xA0 + j, op.len[j]);
+    }
+    if (kind == SWEEP_FORMAT) {
+        // an older layout in every sector: not a store, the import comes from RAM
+        for (uint32_t i = 0; i < FLASH_SIZE; i++)
+            s_flash[i] = (uint8_t)prng_u32(&rng);
+        memset(&m0, 0, sizeof(m0));
+        memset(&s_import, 0, sizeof(s_import));
+        op.n = 0;
+        for (uint8_t i = 0; i < 6; i++) {
+            s_import.present[i * 3] = true;
+            s_import.len[i * 3] = (uint16_t)(50 * i + 10);
+            memset(s_import.val[i * 3], i, s_import.len[i * 3]);
+        }
+    }
+    memcpy(image, s_flash, sizeof(image));
+
+    for (cut = 0; !done; cut++) {
+        memcpy(s_flash, image, sizeof(image));
+        power_on();
+        m = m0;
+        if (kind != SWEEP_FORMAT && !kv_mount()) {
+            FAIL("sweep %s: mount of the start state\n", sweep_names[kind]);
+            return;
+        }
+        cut_left = cut;
+        if (kind == SWEEP_FORMAT) {
+            done = kv_format(2, import_model, &s_import) && !dead;
+            // no store yet: the next boot formats again, from the older layout that is still there
+            if (!mount_after_cut(prng_below(&rng, 3) ? 0 : prng_below(&rng, 200))) {
+                power_on();
+                before++;
+                continue;
+            }
+            if (!model_eq(&s_import, true, "sweep format"))
+                return;
+            after++;
+            m = s_import;
+        } else {
+            done = op_run(&op) && !dead;
+            if (!mount_after_cut(prng_below(&rng, 3) ? 0 : prng_below(&rng, 5000))) {
+                FAIL("sweep %s: no mount after a cut at %u\n", sweep_names[kind], cut);
+                return;
+            }
+            check_cut(&m, &op, sweep_names[kind], &before, &after);
+        }
+        // and it goes on
+        uint32_t back = 0;
+
+        if (!kv_put(key_of(19), &cut, sizeof(cut)) || !kv_mount() ||
+            kv_get(key_of(19), &back, sizeof(back)) != sizeof(back) || back != cut)
+            FAIL("sweep %s: no put after a cut at %u\n", sweep_names[kind], cut);
+        if (errors > 10)
+            return;
+    }
+    if (!after || !before)
+        FAIL("sweep %s: %u cuts before, %u after\n", sweep_names[kind], before, after);
+    if (verbose)
+        printf("sweep %s: %u cut points, %u left the state before, %u the one after\n",
+               sweep_names[kind], cut, before, after);
+}
+
+/* ---------- random cuts in a long run ---------- */
+static void test_cuts(uint32_t ops)
+{
+    static model_t m;
+    static op_t op;
+    uint32_t before = 0, after = 0, cuts = 0;
+
+    flash_blank();
+    memset(&m, 0, sizeof(m));
+    kv_format(5, NULL, NULL);
+    for (uint32_t i = 0; i < ops && errors < 10; i++) {
+        op_random(&op);
+        if (prng_below(&rng, 3)) {
+            if (!op_run(&op))
+                FAIL("cuts: op %u failed\n", i);
+            op_apply(&m, &op);
+            continue;
+        }
+        cut_left = prng_below(&rng, 6000);
+        if (op_run(&op) && !dead) {
+            op_apply(&m, &op);
+            cut_left = -1;
+            continue;
+        }
+        if (!dead)
+            FAIL("cuts: op %u failed without a cut\n", i);
+        cuts++;
+        if (!mount_after_cut(prng_below(&rng, 4) ? 0 : prng_below(&rng, 6000)))
+            FAIL("cuts: no mount after op %u\n", i);
+        check_cut(&m, &op, "cuts", &before, &after);
+    }
+    if (!kv_mount() || !model_eq(&m, true, "cuts end"))
+        FAIL("cuts: end state\n");
+    if (verbose) {
+        kv_stats_t st;
+
+        kv_stats(&st);
+        printf("cuts: %u ops, %u cut (%u before, %u after), %u torn records in the last mount\n",
+               ops, cuts, before, after, st.torn);
+    }
+}
+
+/* ---------- write amplification ---------- */
+typedef struct {
+    const char *name;
+    uint8_t  keys;                      // of KEYS
+    uint16_t len[KEYS];
+    uint8_t  weight[KEYS];
+} load_t;
+
+static const load_t loads[] = {
+    { "config save", 1, { 116 }, { 1 } },           // config_t with the W6100 wiz_NetInfo
+    // net, presence, occupancy, 4 layouts, 8 patterns, 2 calibrations
+    { "mixed", 17,
+      { 116, 200, 150, 600, 600, 600, 600, 64, 64, 64, 64, 64, 64, 64, 64, 32, 32 },
+      { 10, 20, 20, 3, 3, 2, 2, 4, 4, 4, 4, 4, 4, 3, 3, 5, 5 } },
+};
+
+static void bench(const load_t *ld, uint32_t saves)
+{
+    static uint8_t val[KV_VALUE_MAX];
+    uint32_t total = 0, lo = UINT32_MAX, hi = 0;
+    uint64_t user = 0;
+    kv_stats_t st;
+
+    flash_blank();
+    kv_format(0, NULL, NULL);
+    for (uint8_t k = 0; k < ld->keys; k++)
+        total += ld->weight[k];
+    for (uint8_t k = 0; k < ld->keys; k++)
+        kv_put(key_of(k), val, ld->len[k]);     // all of them there first
+    memset(&fl, 0, sizeof(fl));
+    for (uint32_t i = 0; i < saves; i++) {
+        uint32_t r = prng_below(&rng, total);
+        uint8_t k = 0;
+
+        while (r >= ld->weight[k])
+            r -= ld->weight[k++];
+        val[0] = (uint8_t)i;
+        if (!kv_put(key_of(k), val, ld->len[k]))
+            FAIL("bench %s: save %u failed\n", ld->name, i);
+        user += ld->len[k];
+    }
+    kv_stats(&st);
+    for (int s = 0; s < KV_SECTORS; s++) {
+        lo = (fl.sector_erases[s] < lo) ? fl.sector_erases[s] : lo;
+        hi = (fl.sector_erases[s] > hi) ? fl.sector_erases[s] : hi;
+    }
+
+    // before: a sector erased and a page programmed per save, always the same sector
+    double wa = (double)fl.programmed / (double)user;
+    double per_erase = fl.erases ? (double)saves / (double)fl.erases : (double)saves;
+
+    printf("bench %-11s: %u saves, %llu value bytes, %llu programmed (x%.2f), %llu pages, "
+           "%llu erases (%.1f saves each), %u records copied, sector erases %u..%u\n",
+           ld->name, saves, (unsigned long long)user, (unsigned long long)fl.programmed, wa,
+           (unsigned long long)fl.pages, (unsigned long long)fl.erases, per_erase, st.copied, lo, hi);
+    printf("bench %-11s: before, %u erases of one sector and %u pages; 100k erase cycles last "
+           "%.0fx as many saves now\n", ld->name, saves, saves,
+           hi ? (double)saves / (double)hi : (double)saves);
+    if (hi - lo > 2)
+        FAIL("bench %s: wear %u..%u\n", ld->name, lo, hi);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t n = 0, seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "vn:r:")) != -1) {
+        switch (opt) {
+        case 'v': verbose = true; break;
+        case 'n': n = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'r': seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-v] [-n ops] [-r seed]\n", argv[0]);
+            return 2;
+        }
+    }
+    prng_seed(&rng, seed, 50);
+
+    test_basic();
+    test_model(n ? n : 20000);
+    sweep(SWEEP_ROLL);
+    sweep(SWEEP_TXN);
+    sweep(SWEEP_FORMAT);
+    test_cuts(n ? n : 20000);
+    for (size_t i = 0; i < sizeof(loads) / sizeof(loads[0]); i++)
+        bench(&loads[i], 20000);
+
+    printf("%s: %u errors\n", errors ? "FAIL" : "OK", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,410 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Host checks of kitchen_pwm/occupancy.c, the radar polygon zones:
+ *  - points on edges and vertices of a square, by the half-open rule
+ *  - zones sharing edges (grid, diagonal, zigzag): every point of the
+ *    union in exactly one zone, none outside
+ *  - concave and extreme-coordinate polygons against a floating point
+ *    winding number, away from the boundary
+ *  - zone validation (too few vertices, collinear, out of range)
+ *  - enter / exit events, dwell time, short blips and gaps, the zone
+ *    handed to the presence rules
+ * then the cost of a frame (3 tracks, 6 zones) and of one point test.
+ *
+ *   occupancy_test [-n random_points] [-s seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "config.h"
+#include "occupancy.h"
+#include "prng.h"
+
+static uint32_t errors;
+
+#define FAIL(...) do { if (errors++ < 10) printf(__VA_ARGS__); } while (0)
+
+static uint64_t cpu_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* ---------- zone sets ---------- */
+static occ_zones_t zs;
+
+static void zones_begin(void)
+{
+    memset(&zs, 0, sizeof(zs));
+    zs.version = OCC_ZONES_VERSION;
+    zs.enter_frames = 3;
+    zs.exit_ms = 2000;
+}
+
+static void zone_add(const char *name, uint16_t bright, int n, const int16_t *xy)
+{
+    occ_zone_def_t *d = &zs.zone[zs.zone_count++];
+
+    strncpy(d->name, name, OCC_NAME_LEN);
+    d->brightness = bright;
+    d->n = (uint8_t)n;
+    for (int i = 0; i < n; i++)
+        d->v[i] = (occ_point_t){ xy[2 * i], xy[2 * i + 1] };
+}
+
+static bool zones_load(const char *what)
+{
+    if (!occupancy_engine_init(&zs, NULL)) {
+        FAIL("%s: zones rejected\n", what);
+        return false;
+    }
+    return true;
+}
+
+/* winding number in doubles, only trusted away from the boundary */
+static bool ref_inside(const occ_zone_def_t *d, double x, double y, double *edge_dist)
+{
+    double wind = 0.0, dmin = 1e30;
+
+    for (int i = 0; i < d->n; i++) {
+        double ax = d->v[i].x_mm, ay = d->v[i].y_mm;
+        double bx = d->v[(i + 1) % d->n].x_mm, by = d->v[(i + 1) % d->n].y_mm;
+        double ex = bx - ax, ey = by - ay;
+        double t = ((x - ax) * ex + (y - ay) * ey) / (ex * ex + ey * ey);
+        t = (t < 0.0) ? 0.0 : (t > 1.0) ? 1.0 : t;
+        double dd = hypot(ax + t * ex - x, ay + t * ey - y);
+        if (dd < dmin)
+            dmin = dd;
+        wind += atan2((ax - x) * (by - y) - (ay - y) * (bx - x), (ax - x) * (bx - x) + (ay - y) * (by - y));
+    }
+    *edge_dist = dmin;
+    return fabs(wind) > M_PI;
+}
+
+/* ---------- geometry ---------- */
+static void test_square_boundary(void)
+{
+    static const int16_t sq[] = { 0, 0, 1000, 0, 1000, 1000, 0, 1000 };
+    static const struct { int16_t x, y; bool in; } pts[] = {
+        { 500, 500, true },
+        { 0, 500, true },       // left edge
+        { 1000, 500, false },   // right edge
+        { 500, 0, true },       // bottom edge
+        { 500, 1000, false },   // top edge
+        { 0, 0, true },         // vertices: only the bottom left one
+        { 1000, 0, false },
+        { 1000, 1000, false },
+        { 0, 1000, false },
+        { -1, 500, false },
+        { 999, 999, true },
+        { 500, -1, false },
+    };
+
+    zones_begin();
+    zone_add("sq", 0, 4, sq);
+    if (!zones_load("square"))
+        return;
+    for (uint32_t i = 0; i < count_of(pts); i++)
+        if (occupancy_point_in(0, pts[i].x, pts[i].y) != pts[i].in)
+            FAIL("square: (%d, %d) should be %s\n", pts[i].x, pts[i].y, pts[i].in ? "in" : "out");
+
+    // the same square wound the other way round and starting elsewhere
+    static const int16_t sq_cw[] = { 1000, 1000, 1000, 0, 0, 0, 0, 1000 };
+    zones_begin();
+    zone_add("sq", 0, 4, sq_cw);
+    if (!zones_load("square cw"))
+        return;
+    for (uint32_t i = 0; i < count_of(pts); i++)
+        if (occupancy_point_in(0, pts[i].x, pts[i].y) != pts[i].in)
+            FAIL("square cw: (%d, %d) should be %s\n", pts[i].x, pts[i].y, pts[i].in ? "in" : "out");
+}
+
+/* zones tiling [x0, x1) x [y0, y1): every grid point in exactly one inside, none outside */
+static void check_tiling(const char *what, int16_t x0, int16_t y0, int16_t x1, int16_t y1, int step)
+{
+    for (int y = y0 - 2 * step; y <= y1 + 2 * step; y += step) {
+        for (int x = x0 - 2 * step; x <= x1 + 2 * step; x += step) {
+            int hits = 0;
+            for (uint8_t z = 0; z < zs.zone_count; z++)
+                hits += occupancy_point_in(z, (int16_t)x, (int16_t)y);
+            int want = (x >= x0 && x < x1 && y >= y0 && y < y1) ? 1 : 0;
+            if (hits != want)
+                FAIL("%s: (%d, %d) in %d zones, want %d\n", what, x, y, hits, want);
+        }
+    }
+}
+
+static void test_shared_edges(void)
+{
+    // 3 x 2 grid of squares
+    zones_begin();
+    for (int gy = 0; gy < 2; gy++) {
+        for (int gx = 0; gx < 3; gx++) {
+            int16_t x = (int16_t)(gx * 700 - 1000), y = (int16_t)(gy * 700 + 500);
+            int16_t sq[] = { x, y, (int16_t)(x + 700), y, (int16_t)(x + 700), (int16_t)(y + 700), x, (int16_t)(y + 700) };
+            zone_add("g", 0, 4, sq);
+        }
+    }
+    if (zones_load("grid"))
+        check_tiling("grid", -1000, 500, 1100, 1900, 25);
+
+    // rectangle cut along the diagonal, one triangle wound each way
+    static const int16_t lo[] = { 0, 0, 3000, 0, 3000, 1000 };
+    static const int16_t hi[] = { 0, 0, 0, 1000, 3000, 1000 };
+    zones_begin();
+    zone_add("lo", 0, 3, lo);
+    zone_add("hi", 0, 3, hi);
+    if (zones_load("diagonal"))
+        check_tiling("diagonal", 0, 0, 3000, 1000, 3);      // hits the diagonal every third row
+
+    // rectangle cut by a zigzag: two concave hexagons with horizontal edges
+    static const int16_t left[] = { 0, 0, 1000, 0, 600, 500, 1000, 1000, 0, 1000, 0, 500 };
+    static const int16_t right[] = { 1000, 0, 2000, 0, 2000, 1000, 1000, 1000, 600, 500, 2000, 500 };
+    zones_begin();
+    zone_add("left", 0, 6, left);
+    zone_add("right", 0, 5, right);     // first five vertices: same outline, the 6th is on an edge
+    if (zones_load("zigzag"))
+        check_tiling("zigzag", 0, 0, 2000, 1000, 20);
+}
+
+static void test_against_reference(prng_t *rng, uint32_t points)
+{
+    // concave arrow, a star-like hexagon and a box at the coordinate limits
+    static const int16_t arrow[] = { -2000, 500, 0, 1500, 2000, 500, 2000, 3500, 0, 2000, -2000, 3500 };
+    static const int16_t bowtie[] = { -1500, 800, 1500, 4000, 1500, 800, -1500, 4000, 0, 2400, -400, 2400 };
+    static const int16_t big[] = { -OCC_COORD_MAX, -OCC_COORD_MAX, OCC_COORD_MAX, -OCC_COORD_MAX,
+                                   OCC_COORD_MAX, OCC_COORD_MAX, -OCC_COORD_MAX + 1, OCC_COORD_MAX };
+    static const int16_t sliver[] = { -OCC_COORD_MAX, -3, OCC_COORD_MAX, 3, OCC_COORD_MAX, 9 };
+    static const struct { const char *name; int n; const int16_t *xy; } polys[] = {
+        { "arrow", 6, arrow }, { "bowtie", 6, bowtie }, { "big", 4, big }, { "sliver", 3, sliver },
+    };
+
+    for (uint32_t k = 0; k < count_of(polys); k++) {
+        uint32_t checked = 0;
+
+        zones_begin();
+        zone_add(polys[k].name, 0, polys[k].n, polys[k].xy);
+        if (!zones_load(polys[k].name))
+            continue;
+        for (uint32_t i = 0; i < points; i++) {
+            int16_t x = (int16_t)((int32_t)prng_below(rng, 2 * OCC_COORD_MAX + 1) - OCC_COORD_MAX);
+            int16_t y = (int16_t)((int32_t)prng_below(rng, 2 * OCC_COORD_MAX + 1) - OCC_COORD_MAX);
+            if (k < 2) {        // keep most points near the small polygons
+                x = (int16_t)(x / 6);
+                y = (int16_t)(y / 6 + 2000);
+            }
+            double dist;
+            bool want = ref_inside(&zs.zone[0], x, y, &dist);
+            if (dist < 1.0)
+                continue;
+            checked++;
+            // even-odd for the self-intersecting bowtie: its centre lobe overlap counts twice
+            if (occupancy_point_in(0, x, y) != want && !(k == 1 && !want))
+                FAIL("%s: (%d, %d) should be %s\n", polys[k].name, x, y, want ? "in" : "out");
+        }
+        if (checked < points / 2)
+            FAIL("%s: only %u of %u points away from the boundary\n", polys[k].name, checked, points);
+    }
+}
+
+static void test_validation(void)
+{
+    static const int16_t line[] = { 0, 0, 1000, 1000, 2000, 2000 };
+    static const int16_t two[] = { 0, 0, 1000, 0 };
+    static const int16_t far[] = { 0, 0, OCC_COORD_MAX + 1, 0, 0, 1000 };
+    static const int16_t ok[] = { 0, 0, 1000, 0, 0, 1000 };
+    occ_zones_t def;
+
+    occupancy_zones_default(&def);
+    if (!occupancy_zones_valid(&def) || sizeof(occ_zones_t) > 244)
+        FAIL("defaults invalid or larger than a config blob (%u bytes)\n", (unsigned)sizeof(occ_zones_t));
+
+    zones_begin();
+    zone_add("line", 0, 3, line);
+    if (occupancy_zones_valid(&zs))
+        FAIL("collinear polygon accepted\n");
+    zones_begin();
+    zone_add("two", 0, 2, two);
+    if (occupancy_zones_valid(&zs))
+        FAIL("two vertex polygon accepted\n");
+    zones_begin();
+    zone_add("far", 0, 3, far);
+    if (occupancy_zones_valid(&zs))
+        FAIL("vertex beyond OCC_COORD_MAX accepted\n");
+    zones_begin();
+    zone_add("bright", LINEAR_MAX + 1, 3, ok);
+    if (occupancy_zones_valid(&zs))
+        FAIL("brightness above LINEAR_MAX accepted\n");
+    zones_begin();
+    zs.enter_frames = 0;
+    zone_add("ok", 0, 3, ok);
+    if (occupancy_zones_valid(&zs))
+        FAIL("enter_frames 0 accepted\n");
+}
+
+/* ---------- events ---------- */
+static occ_event_t events[16];
+static uint32_t n_events;
+
+static void record(const occ_event_t *e)
+{
+    if (n_events < count_of(events))
+        events[n_events] = *e;
+    n_events++;
+}
+
+static rd03d_state_t frame_at(int16_t x, int16_t y, uint32_t t_ms)
+{
+    rd03d_state_t st;
+
+    memset(&st, 0, sizeof(st));
+    st.rx_time_ms = t_ms;
+    st.track[1] = (rd03d_track_t){ .valid = true, .confidence = 200, .id = 7, .x_mm = x, .y_mm = y };
+    return st;
+}
+
+static void test_events(void)
+{
+    occ_zones_t def;
+    uint32_t t = 1000;
+    uint16_t bright;
+
+    occupancy_zones_default(&def);
+    if (!occupancy_engine_init(&def, record))
+        FAIL("defaults rejected\n");
+    n_events = 0;
+
+    // one frame at the sink, then 1.5 s gone: no visit
+    rd03d_state_t st = frame_at(-1000, 800, t);
+    occupancy_on_radar(&st);
+    for (int i = 0; i < 15; i++) {
+        t += 100;
+        st = frame_at(0, 6000, t);
+        occupancy_on_radar(&st);
+    }
+    if (n_events)
+        FAIL("a one frame blip made %u events\n", n_events);
+
+    // 5 s at the sink with a 1 s gap (shorter than exit_ms), then the passage, then gone
+    uint32_t t_in = t + 100;
+    for (int i = 0; i < 50; i++) {
+        t += 100;
+        st = (i >= 20 && i < 30) ? frame_at(0, 6000, t) : frame_at(-1000, 800, t);
+        occupancy_on_radar(&st);
+        if (i == 2 && (n_events != 1 || events[0].kind != OCC_EVT_ENTER || events[0].zone != 0))
+            FAIL("no ENTER at the sink after %u frames\n", def.enter_frames);
+        if (i == 10 && (occupancy_light_zone(&bright) != 0 || bright != def.zone[0].brightness))
+            FAIL("sink not handed to the lights\n");
+        if (i == 10 && occupancy_dwell_ms(0, t) != t - t_in)
+            FAIL("dwell %u ms at the sink, want %u\n", occupancy_dwell_ms(0, t), t - t_in);
+    }
+    uint32_t t_last = t;
+    for (int i = 0; i < 40; i++) {
+        t += 100;
+        st = frame_at(0, 3500, t);
+        occupancy_on_radar(&st);
+    }
+    if (occupancy_light_zone(&bright) != OCC_ZONE_NONE)
+        FAIL("the passage (brightness 0) drives the lights\n");
+
+    const occ_zone_state_t *sink = occupancy_zone_state(0), *pass = occupancy_zone_state(2);
+    if (n_events != 3 || events[1].kind != OCC_EVT_ENTER || events[1].zone != 2 ||
+        events[2].kind != OCC_EVT_EXIT || events[2].zone != 0)
+        FAIL("events: %u, want sink ENTER, pass ENTER, sink EXIT\n", n_events);
+    else if (events[2].dwell_ms != t_last - t_in || events[2].t_ms - t_last < def.exit_ms)
+        FAIL("sink EXIT at %u dwell %u ms, want dwell %u ms after %u ms\n",
+             events[2].t_ms, events[2].dwell_ms, t_last - t_in, def.exit_ms);
+    if (!sink || sink->occupied || sink->visits != 1 || sink->total_ms != t_last - t_in)
+        FAIL("sink state after the visit\n");
+    if (!pass || !pass->occupied || pass->tracks != 1)
+        FAIL("pass state while walking through\n");
+}
+
+/* ---------- cost ---------- */
+static void bench(prng_t *rng)
+{
+    static rd03d_state_t frames[4096];
+    occ_zones_t z;
+    uint32_t hits = 0;
+
+    // six zones, the last two hexagons
+    occupancy_zones_default(&z);
+    static const int16_t hex1[] = { -800, 1500, 0, 1200, 800, 1500, 800, 2200, 0, 2500, -800, 2200 };
+    static const int16_t hex2[] = { -3000, 500, -2000, 500, -1700, 1500, -2000, 2500, -3000, 2500, -3300, 1500 };
+    static const int16_t tri[] = { 2000, 500, 3500, 500, 3500, 2500 };
+    zs = z;
+    zone_add("island", LINEAR_MAX / 2, 6, hex1);
+    zone_add("table", LINEAR_MAX / 2, 6, hex2);
+    zone_add("fridge", 0, 3, tri);
+    occupancy_engine_init(&zs, NULL);
+
+    for (uint32_t i = 0; i < count_of(frames); i++) {
+        memset(&frames[i], 0, sizeof(frames[i]));
+        frames[i].rx_time_ms = i * 100u;
+        for (int k = 0; k < RD03D_TRACKS; k++)
+            frames[i].track[k] = (rd03d_track_t){ .valid = true,
+                .x_mm = (int16_t)((int32_t)prng_below(rng, 8000) - 4000),
+                .y_mm = (int16_t)prng_below(rng, 6000) };
+    }
+
+    const uint32_t reps = 200;
+    uint64_t t0 = cpu_time_ns();
+    for (uint32_t r = 0; r < reps; r++)
+        for (uint32_t i = 0; i < count_of(frames); i++)
+            occupancy_on_radar(&frames[i]);
+    uint64_t t1 = cpu_time_ns();
+    for (uint32_t r = 0; r < reps; r++)
+        for (uint32_t i = 0; i < count_of(frames); i++)
+            for (uint8_t zi = 0; zi < zs.zone_count; zi++)
+                hits += occupancy_point_in(zi, frames[i].track[r % 3].x_mm, frames[i].track[r % 3].y_mm);
+    uint64_t t2 = cpu_time_ns();
+
+    double n = (double)reps * count_of(frames);
+    printf("  cost: %.0f ns per frame (%d tracks, %u zones), %.1f ns per point test (%u hits)\n",
+           (double)(t1 - t0) / n, RD03D_TRACKS, zs.zone_count,
+           (double)(t2 - t1) / (n * zs.zone_count), hits);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t points = 200000;
+    uint64_t seed = 39;
+    prng_t rng;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+            case 'n': points = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 's': seed = strtoull(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-n random_points] [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+    prng_seed(&rng, seed, 1);
+
+    test_square_boundary();
+    test_shared_edges();
+    test_against_reference(&rng, points);
+    test_validation();
+    test_events();
+    printf("occupancy zones: boundary, shared edges, %u random points per polygon, events\n", points);
+    bench(&rng);
+
+    printf("%s: %u errors\n", errors ? "FAIL" : "OK", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,292 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Offline pattern renderer.
+ * Links the unmodified led_pattern.c of one app (tree or stairs) against the
+ * stubs in stub/ and runs a pattern for N frames on the host.
+ *
+ *   render_tree   -p <index> -n <frames> [-o out.ppm] [-r out.raw] [-t]
+ *   render_tree   -c [-n <frames>]
+ *   render_tree   -g
+ *
+ * -o  writes a PPM where every frame is one row per strip (time runs down)
+ * -r  writes the raw RGB888 frames back to back (NUM_STRIPS * NUM_PIXELS * 3)
+ * -t  prints CPU time per frame in microseconds
+ * -c  prints a checksum line for every pattern in the table, to diff against
+ *     a previous run when touching led_pattern.c
+ * -g  renders every pattern for RENDER_GOLDEN_FRAMES frames and compares the
+ *     checksums with the golden ones in render_table, exits 1 on a mismatch.
+ *     After an intended change of a pattern, update its golden value from -c.
+ * -b  compares random values per microsecond of libc rand() and prng.h
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "pico/stdio.h"       // host stub: uint, count_of
+#include "prng.h"
+
+#include "config.h"
+#include "led_pattern.h"
+
+#define RENDER_FRAME_BYTES  (NUM_STRIPS * NUM_PIXELS * 3)
+#define RENDER_GOLDEN_FRAMES 500    // the -c default, LED_PATTERN_SEED
+
+#if defined(RENDER_TREE)
+static uint32_t render_buf[NUM_PIXELS];
+
+static const struct {
+    pattern pat;
+    const char *name;
+    uint32_t golden;            // checksum of RENDER_GOLDEN_FRAMES frames
+} render_table[] = {
+        {pattern_breath, "breath", 0x70d23b6c},
+        {pattern_rainbow, "rainbow", 0x750b300b},
+        {pattern_color_wipe, "color_wipe", 0x7ab3263d},
+        {pattern_twinkle, "twinkle", 0x4880d2d4},
+        {pattern_chase, "chase", 0xe64a6dff},
+        {pattern_fire, "fire", 0xb729a331},
+        {pattern_snow, "snow", 0x5a3192ed},
+        {pattern_christmas_fade, "christmas_fade", 0xd50fa4e1},
+        {pattern_christmas_fade_wave, "christmas_fade_wave", 0x45b0fc91},
+        {pattern_christmas_palette, "christmas_palette", 0xc701d470},
+        {pattern_warm_white_with_sparks, "warm_white_with_sparks", 0xb0ad217d},
+        {pattern_falling_sparks, "falling_sparks", 0x1ef916e7},
+        {pattern_ornaments, "ornaments", 0xe70449d8},
+        {pattern_ornaments_multicolor, "ornaments_multicolor", 0x42cd5439},
+        {pattern_ornaments_cycling, "ornaments_cycling", 0x057ea6b9},
+        {pattern_ornament_clusters, "ornament_clusters", 0x236f4410},
+        {pattern_global_color_fade, "global_color_fade", 0x609eebaa},
+        {pattern_cluster_color_fade, "cluster_color_fade", 0xc814e6b7},
+        {pattern_snakes1, "snakes1", 0xa29c3ac5},
+        {pattern_snakes2, "snakes2", 0x76fda0b1},
+        {pattern_snakes3, "snakes3", 0x2300475d},
+        {pattern_snakes4, "snakes4", 0xce3d210e},
+        {pattern_snakes5, "snakes5", 0x502c32c3},
+        {pattern_connection_show, "connection_show", 0xb5acf6d5},
+        {pattern_fade_show, "fade_show", 0xd6d19a8a},
+};
+
+static void render_frame(uint32_t index, uint8_t *rgb) {
+    render_table[index].pat(render_buf, NUM_PIXELS, 1);
+    // same layout as ws2815_control_dma.c: 0xRRGGBB00
+    for (uint32_t i = 0; i < NUM_PIXELS; i++) {
+        rgb[i * 3 + 0] = (uint8_t)(render_buf[i] >> 24);
+        rgb[i * 3 + 1] = (uint8_t)(render_buf[i] >> 16);
+        rgb[i * 3 + 2] = (uint8_t)(render_buf[i] >> 8);
+    }
+}
+#elif defined(RENDER_STAIRS)
+static uint8_t render_buf[NUM_STRIPS * NUM_PIXELS * NUM_CHANNELS];
+
+static const struct {
+    pattern pat;
+    const char *name;
+    uint32_t golden;            // checksum of RENDER_GOLDEN_FRAMES frames
+} render_table[] = {
+        {pattern_snakes, "snakes", 0xbe477301},
+        {pattern_random, "random", 0x6cd80f0a},
+        {pattern_sparkle, "sparkle", 0x9840d30d},
+        {pattern_drop1, "drop1", 0x6272a345},
+        {pattern_solid, "solid", 0x93929045},
+        {pattern_jaremek, "jaremek", 0x5cdd83b5},
+};
+
+static void render_frame(uint32_t index, uint8_t *rgb) {
+    render_table[index].pat(render_buf, NUM_STRIPS, NUM_PIXELS);
+    // framebuf[NUM_STRIPS][NUM_PIXELS][NUM_CHANNELS], first 3 channels are RGB
+    for (uint32_t i = 0; i < NUM_STRIPS * NUM_PIXELS; i++) {
+        memcpy(&rgb[i * 3], &render_buf[i * NUM_CHANNELS], 3);
+    }
+}
+#else
+#error "define RENDER_TREE or RENDER_STAIRS"
+#endif
+
+static uint8_t frame_rgb[RENDER_FRAME_BYTES];
+
+static uint64_t cpu_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// FNV-1a, 32 bit
+static uint32_t fnv1a(uint32_t h, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        h ^= data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * Every run starts from the same state as a fresh boot: the pattern code
+ * keeps its state in statics, so the renderer is re-executed per pattern
+ * in checksum mode (see main).
+ */
+static uint32_t render_one(uint32_t index, uint32_t frames, FILE *ppm, FILE *raw, int timing) {
+    uint64_t total = 0, worst = 0;
+    uint32_t h = 2166136261u;
+
+    memset(render_buf, 0, sizeof(render_buf));
+    init_start_strips();
+
+    if (ppm)
+        fprintf(ppm, "P6\n%d %u\n255\n", NUM_PIXELS, frames * NUM_STRIPS);
+
+    for (uint32_t f = 0; f < frames; f++) {
+        uint64_t t0 = cpu_time_ns();
+        render_frame(index, frame_rgb);
+        uint64_t dt = cpu_time_ns() - t0;
+
+        total += dt;
+        if (dt > worst)
+            worst = dt;
+        if (timing)
+            fprintf(stderr, "%u\t%.3f\n", f, (double)dt / 1000.0);
+
+        h = fnv1a(h, frame_rgb, sizeof(frame_rgb));
+        if (ppm)
+            fwrite(frame_rgb, 1, sizeof(frame_rgb), ppm);
+        if (raw)
+            fwrite(frame_rgb, 1, sizeof(frame_rgb), raw);
+    }
+
+    fprintf(stderr, "%-24s frames=%u avg=%.3fus max=%.3fus crc=%08x\n",
+            render_table[index].name, frames,
+            frames ? (double)total / frames / 1000.0 : 0.0,
+            (double)worst / 1000.0, h);
+    return h;
+}
+
+/* every pattern in a child of its own, as for -c; returns the mismatches */
+static uint32_t check_golden(void) {
+    uint32_t errors = 0;
+
+    fflush(stderr);
+    for (uint32_t i = 0; i < count_of(render_table); i++) {
+        pid_t pid = fork();
+        int status;
+
+        if (pid < 0) {
+            perror("fork");
+            return errors + 1;
+        }
+        if (pid == 0) {
+            uint32_t h = render_one(i, RENDER_GOLDEN_FRAMES, NULL, NULL, 0);
+            fflush(stderr);
+            _exit(h == render_table[i].golden ? 0 : 1);
+        }
+        if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "%-24s mismatch, golden crc=%08x\n", render_table[i].name, render_table[i].golden);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+static void bench_prng(void) {
+    const uint32_t n = 10000000;
+    volatile uint32_t sink = 0;
+    uint32_t acc = 0;
+    uint64_t t0;
+    prng_t rng;
+
+    prng_seed(&rng, LED_PATTERN_SEED, 0);
+
+    t0 = cpu_time_ns();
+    for (uint32_t i = 0; i < n; i++)
+        acc += (uint32_t)rand();
+    fprintf(stderr, "rand()      %7.1f values/us\n", n * 1000.0 / (double)(cpu_time_ns() - t0));
+
+    t0 = cpu_time_ns();
+    for (uint32_t i = 0; i < n; i++)
+        acc += prng_u32(&rng);
+    fprintf(stderr, "prng_u32()  %7.1f values/us\n", n * 1000.0 / (double)(cpu_time_ns() - t0));
+
+    t0 = cpu_time_ns();
+    for (uint32_t i = 0; i < n; i++)
+        acc += prng_hash(LED_PATTERN_SEED, i, 7);
+    fprintf(stderr, "prng_hash() %7.1f values/us\n", n * 1000.0 / (double)(cpu_time_ns() - t0));
+
+    sink = acc;
+    (void)sink;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s -p <index> [-n frames] [-o out.ppm] [-r out.raw] [-t]\n"
+            "       %s -c [-n frames]\n"
+            "       %s -g\n"
+            "       %s -b\n"
+            "patterns:\n", prog, prog, prog, prog);
+    for (uint32_t i = 0; i < count_of(render_table); i++)
+        fprintf(stderr, "  %2u  %s\n", i, render_table[i].name);
+}
+
+int main(int argc, char **argv) {
+    long index = -1;
+    uint32_t frames = 500;      // 10 s at the 20 ms pattern period
+    const char *ppm_name = NULL, *raw_name = NULL;
+    int timing = 0, checksum = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:n:o:r:tcgb")) != -1) {
+        switch (opt) {
+        case 'p': index = strtol(optarg, NULL, 0); break;
+        case 'n': frames = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'o': ppm_name = optarg; break;
+        case 'r': raw_name = optarg; break;
+        case 't': timing = 1; break;
+        case 'c': checksum = 1; break;
+        case 'g': {
+            uint32_t errors = check_golden();
+            fprintf(stdout, "%s: %u errors\n", errors ? "FAIL" : "OK", errors);
+            return errors ? 1 : 0;
+        }
+        case 'b': bench_prng(); return 0;
+        default: usage(argv[0]); return 2;
+        }
+    }
+
+    if (checksum) {
+        // pattern state lives in statics of led_pattern.c - run each pattern
+        // in its own process so the checksums do not depend on table order
+        for (uint32_t i = 0; i < count_of(render_table); i++) {
+            char cmd[512];
+            snprintf(cmd, sizeof(cmd), "\"%s\" -p %u -n %u", argv[0], i, frames);
+            if (system(cmd) != 0)
+                return 1;
+        }
+        return 0;
+    }
+
+    if (index < 0 || (size_t)index >= count_of(render_table)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    FILE *ppm = ppm_name ? fopen(ppm_name, "wb") : NULL;
+    FILE *raw = raw_name ? fopen(raw_name, "wb") : NULL;
+    if ((ppm_name && !ppm) || (raw_name && !raw)) {
+        perror("fopen");
+        return 1;
+    }
+
+    render_one((uint32_t)index, frames, ppm, raw, timing);
+
+    if (ppm)
+        fclose(ppm);
+    if (raw)
+        fclose(raw);
+    return 0;
+}
@@ -0,0 +1,380 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Replay of radar traces through kitchen_pwm/rd03d_api.c (tracking) and
+ * kitchen_pwm/presence.c (rules), the frame path of the firmware with the
+ * UART driver replaced by the trace. Input is either a capture of the
+ * _RD03D_CSV_DEBUG_ lines
+ *     R,<ms>,x,y,v,dist,x,y,v,dist,x,y,v,dist
+ * (other lines are skipped, so a whole USB log can be fed) or, with -s, a
+ * synthetic evening of kitchen visits: walk in through the doorway, stand
+ * at one or two spots, walk out, with passers-by beyond the last zone.
+ *
+ * Ground truth is taken from the raw frames: somebody is in while a raw
+ * detection lies inside the zones, the zone is the one of the closest. For
+ * every decision the latency is reported
+ *  - ON     first detection inside the zones -> fade on
+ *  - LEVEL  raw zone change -> brightness change
+ *  - OFF    last detection -> fade out, minus hold_ms
+ * With -s the decisions are also checked (one ON / OFF per visit, right
+ * zone, bounded latency, passers-by ignored), then the cost per frame.
+ *
+ *   presence_replay [-H hold_ms] [-n visits] (-s | trace.txt)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "config.h"
+#include "rd03d_drv.h"
+#include "rd03d_api.h"
+#include "presence.h"
+#include "prng.h"
+
+#define FRAME_MS        100         // RD-03D report rate
+#define TICK_MS         100         // presence_poll() period in main.c
+#define PASSER_Y_MM     7000        // beyond the last default zone
+
+static uint32_t errors;
+
+#define FAIL(...) do { if (errors++ < 10) printf(__VA_ARGS__); } while (0)
+
+static uint64_t cpu_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* ---------- fake rd03d_drv.c: one pending frame ---------- */
+static rd03d_frame_t pending;
+static bool          pending_valid;
+
+bool rd03d_drv_init(void) { return true; }
+void rd03d_drv_poll(void) { }
+
+bool rd03d_drv_get_frame(rd03d_frame_t *out)
+{
+    if (!pending_valid)
+        return false;
+    *out = pending;
+    pending_valid = false;
+    return true;
+}
+
+typedef struct {
+    int16_t  x_mm, y_mm, v_cms;
+    uint16_t dist_mm;           // 0 with the rest = empty slot
+} det_in_t;
+
+/* ---------- decisions ---------- */
+typedef struct {
+    uint32_t n, sum, max;
+} lat_t;
+
+static void lat_add(lat_t *l, int32_t ms)
+{
+    uint32_t v = (ms < 0) ? 0 : (uint32_t)ms;
+    l->n++;
+    l->sum += v;
+    if (v > l->max)
+        l->max = v;
+}
+
+static void lat_print(const char *name, const lat_t *l)
+{
+    if (l->n)
+        printf("  %-6s %4u decisions, latency avg %5u ms, max %5u ms\n",
+               name, l->n, l->sum / l->n, l->max);
+    else
+        printf("  %-6s    0 decisions\n", name);
+}
+
+static presence_rules_t rules;
+static lat_t lat_on, lat_level, lat_off;
+static uint32_t n_on, n_off, wrong_zone;
+
+/* raw-frame truth */
+static bool     truth_in;
+static uint8_t  truth_zone;
+static uint32_t truth_enter_ms, truth_last_ms, truth_zone_ms;
+static bool     lights_on;
+
+static uint8_t truth_zone_of(uint16_t y)
+{
+    for (uint8_t i = 0; i < rules.zone_count; i++)
+        if (y <= rules.zone[i].y_max_mm)
+            return i;
+    return rules.zone_count ? 0xFF : 0;
+}
+
+static void truth_frame(const det_in_t det[RD03D_OBJECT_SLOTS], uint32_t t_ms)
+{
+    uint8_t zone = 0xFF;
+
+    for (int i = 0; i < RD03D_OBJECT_SLOTS; i++) {
+        if (!det[i].dist_mm)
+            continue;
+        uint8_t z = truth_zone_of((uint16_t)abs(det[i].y_mm));
+        if (z < zone)
+            zone = z;
+    }
+    if (zone == 0xFF)
+        return;
+
+    if (!truth_in && !lights_on) {
+        truth_enter_ms = t_ms;
+        truth_zone_ms = t_ms;
+        truth_zone = zone;
+    }
+    if (zone != truth_zone) {
+        truth_zone = zone;
+        truth_zone_ms = t_ms;
+    }
+    truth_in = true;
+    truth_last_ms = t_ms;
+}
+
+static void on_action(const presence_action_t *a)
+{
+    switch (a->kind) {
+        case PRESENCE_ACT_ON:
+            n_on++;
+            lights_on = true;
+            lat_add(&lat_on, (int32_t)(a->t_ms - truth_enter_ms));
+            if (a->zone != truth_zone)
+                wrong_zone++;
+            break;
+        case PRESENCE_ACT_LEVEL:
+            if (a->zone == truth_zone)
+                lat_add(&lat_level, (int32_t)(a->t_ms - truth_zone_ms));
+            else
+                wrong_zone++;
+            break;
+        case PRESENCE_ACT_OFF:
+            n_off++;
+            lights_on = false;
+            truth_in = false;
+            lat_add(&lat_off, (int32_t)(a->t_ms - truth_last_ms - rules.hold_ms));
+            break;
+        default:
+            break;
+    }
+}
+
+/* ---------- replay ---------- */
+static uint32_t clock_ms, frames;
+static uint64_t frame_ns;
+
+static void advance_to(uint32_t t_ms)
+{
+    while ((int32_t)(t_ms - clock_ms) > 0) {
+        clock_ms += TICK_MS;
+        presence_tick(clock_ms);
+    }
+}
+
+static void feed(const det_in_t det[RD03D_OBJECT_SLOTS], uint32_t t_ms)
+{
+    advance_to(t_ms);
+
+    for (int i = 0; i < RD03D_OBJECT_SLOTS; i++) {
+        pending.det[i] = (rd03d_det_t){
+            .present = det[i].dist_mm != 0,
+            .x_mm    = det[i].x_mm,
+            .y_mm    = det[i].y_mm,
+            .v_cms   = det[i].v_cms,
+            .dist_mm = det[i].dist_mm,
+        };
+    }
+    pending.rx_time_ms = t_ms;
+    pending_valid = true;
+
+    truth_frame(det, t_ms);
+
+    uint64_t t0 = cpu_time_ns();
+    rd03d_api_poll();           // tracking, then presence_on_radar() through the hook
+    frame_ns += cpu_time_ns() - t0;
+    frames++;
+}
+
+static int replay_file(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[256];
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        det_in_t det[RD03D_OBJECT_SLOTS];
+        int v[12];
+        unsigned t;
+
+        if (sscanf(line, "R,%u,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d", &t,
+                   &v[0], &v[1], &v[2], &v[3], &v[4], &v[5],
+                   &v[6], &v[7], &v[8], &v[9], &v[10], &v[11]) != 13)
+            continue;
+        for (int i = 0; i < RD03D_OBJECT_SLOTS; i++)
+            det[i] = (det_in_t){ (int16_t)v[i * 4], (int16_t)v[i * 4 + 1],
+                                 (int16_t)v[i * 4 + 2], (uint16_t)v[i * 4 + 3] };
+        feed(det, t);
+    }
+    fclose(f);
+    return 0;
+}
+
+/* ---------- synthetic evening ---------- */
+static det_in_t person(int32_t x, int32_t y, int32_t v_cms)
+{
+    double dist = sqrt((double)x * x + (double)y * y);
+    return (det_in_t){ (int16_t)x, (int16_t)y, (int16_t)v_cms, (uint16_t)lround(dist) };
+}
+
+/* a spot inside a zone, at least 200 mm from its edges */
+static int32_t spot_y(prng_t *rng, uint8_t zone)
+{
+    int32_t lo = zone ? rules.zone[zone - 1].y_max_mm : 0;
+    int32_t hi = rules.zone[zone].y_max_mm;
+    return lo + 300 + (int32_t)prng_below(rng, (uint32_t)(hi - lo - 500));
+}
+
+static void synthetic(uint32_t visits)
+{
+    prng_t rng;
+    uint32_t t = 1000;
+    int32_t door_y = rules.zone[rules.zone_count - 1].y_max_mm + 500;
+
+    prng_seed(&rng, 35, 1);
+
+    for (uint32_t v = 0; v < visits; v++) {
+        det_in_t det[RD03D_OBJECT_SLOTS];
+        uint32_t n_on0 = n_on, n_off0 = n_off;
+
+        // empty kitchen, somebody walking past the doorway now and then
+        uint32_t gap = rules.hold_ms + 4000 + prng_below(&rng, 10000);
+        for (uint32_t g = 0; g < gap; g += FRAME_MS, t += FRAME_MS) {
+            memset(det, 0, sizeof(det));
+            if ((g / 1000) % 7 == 3)
+                det[0] = person(-2000 + (int32_t)(g % 1000) * 4, PASSER_Y_MM, 100);
+            feed(det, t);
+        }
+        if (n_on != n_on0)
+            FAIL("visit %u: passer-by at %u mm switched the lights on\n", v, PASSER_Y_MM);
+        n_off0 = n_off;     // the previous visit fades out during the gap
+
+        // in through the doorway (first seen inside the last zone) at 1 m/s
+        // to one spot, then maybe a second one
+        int32_t x = (int32_t)prng_below(&rng, 2000) - 1000;
+        int32_t y = door_y - 800;
+        int spots = 1 + (int)prng_below(&rng, 2);
+        for (int s = 0; s < spots; s++) {
+            int32_t to = spot_y(&rng, (uint8_t)prng_below(&rng, rules.zone_count));
+            while (y != to) {
+                int32_t step = (to < y) ? -100 : 100;
+                y = (abs(to - y) < 100) ? to : y + step;
+                memset(det, 0, sizeof(det));
+                det[0] = person(x, y, step);
+                feed(det, t);
+                t += FRAME_MS;
+            }
+            uint32_t dwell = 3000 + prng_below(&rng, 10000);
+            for (uint32_t d = 0; d < dwell; d += FRAME_MS, t += FRAME_MS) {
+                memset(det, 0, sizeof(det));
+                det[0] = person(x + (int32_t)prng_below(&rng, 100) - 50,
+                                y + (int32_t)prng_below(&rng, 100) - 50, 0);
+                feed(det, t);
+            }
+        }
+        // walk out through the doorway and vanish
+        while (y < door_y) {
+            y += 100;
+            memset(det, 0, sizeof(det));
+            det[0] = person(x, y, 100);
+            feed(det, t);
+            t += FRAME_MS;
+        }
+
+        if (n_on - n_on0 != 1)
+            FAIL("visit %u: %u ON decisions, expected 1\n", v, n_on - n_on0);
+        if (n_off != n_off0)
+            FAIL("visit %u: lights went off while somebody was in\n", v);
+    }
+
+    // let the last hold run out
+    det_in_t none[RD03D_OBJECT_SLOTS] = { 0 };
+    for (uint32_t g = 0; g < rules.hold_ms + 5000; g += FRAME_MS, t += FRAME_MS)
+        feed(none, t);
+
+    if (n_off != visits)
+        FAIL("%u OFF decisions for %u visits\n", n_off, visits);
+    if (wrong_zone)
+        FAIL("%u decisions at a zone nobody was in\n", wrong_zone);
+    if (lat_on.max > 1000)
+        FAIL("ON latency %u ms > 1000 ms\n", lat_on.max);
+    if (lat_level.max > 1500)
+        FAIL("LEVEL latency %u ms > 1500 ms\n", lat_level.max);
+    if (lat_off.max > 2500)
+        FAIL("OFF latency past hold %u ms > 2500 ms\n", lat_off.max);
+}
+
+int main(int argc, char **argv)
+{
+    bool synth = false;
+    uint32_t hold_ms = 5000;
+    uint32_t visits = 50;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "H:n:s")) != -1) {
+        switch (opt) {
+            case 'H': hold_ms = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'n': visits = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 's': synth = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-H hold_ms] [-n visits] (-s | trace.txt)\n", argv[0]);
+                return 1;
+        }
+    }
+    if (!synth && optind >= argc) {
+        fprintf(stderr, "usage: %s [-H hold_ms] [-n visits] (-s | trace.txt)\n", argv[0]);
+        return 1;
+    }
+
+    presence_rules_default(&rules);
+    rules.hold_ms = hold_ms;
+    presence_engine_init(&rules, on_action);
+    rd03d_api_init(NULL);
+    rd03d_api_frame_hook(presence_on_radar);
+
+    if (synth)
+        synthetic(visits);
+    else if (replay_file(argv[optind]) < 0)
+        return 1;
+    else
+        advance_to(clock_ms + hold_ms + 5000);
+
+    printf("%u frames, %u ON, %u OFF, hold %u ms\n", frames, n_on, n_off, hold_ms);
+    lat_print("ON", &lat_on);
+    lat_print("LEVEL", &lat_level);
+    lat_print("OFF", &lat_off);
+    printf("  cost: %.0f ns per frame (tracking + rules)\n",
+           frames ? (double)frame_ns / frames : 0.0);
+
+    if (synth) {
+        printf("%s: %u errors\n", errors ? "FAIL" : "OK", errors);
+        return errors ? 1 : 0;
+    }
+    return 0;
+}
@@ -0,0 +1,278 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * PRNGs of the LED patterns (common/utils/prng.h) on the host.
+ *
+ *   prng_test [-v] [-n draws] [-r seed]
+ *
+ * Checked:
+ *  - prng_u32() against the PCG32 reference output (seed 42, stream 54),
+ *    the same seed and stream again give the same sequence
+ *  - other seeds and streams give other sequences
+ *  - per-pattern streams are independent: a stream gives the same values
+ *    however many draws the other streams take in between, and re-seeding
+ *    one stream leaves the others where they were
+ *  - prng_below() stays in [0, n) for small, odd and 32-bit n, and hits
+ *    every value of a small n about equally often
+ *  - prng_hash() against known values, the same (seed, pixel, frame) gives
+ *    the same value in any order of evaluation, every bit is set half the
+ *    time and one flipped input bit changes about half the output bits
+ *
+ * -r seeds the order of the interleaved draws, -n sets the draws of the
+ * statistical checks. Exits 1 on any error.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "prng.h"
+
+static uint32_t errors;
+static bool verbose;
+static prng_t rng;                  // order of the draws, from -r
+
+#define FAIL(...) do { if (errors++ < 10) printf(__VA_ARGS__); } while (0)
+
+#define SEED        0xA341316Cu     // LED_PATTERN_SEED of tree and stairs
+#define STREAMS     8               // one per pattern, as led_pattern.c does
+#define SEQ_LEN     4096
+
+/* pcg32-demo of the PCG reference implementation: pcg32_srandom_r(&rng, 42u, 54u) */
+static const uint32_t pcg32_ref[] = {
+        0xa15c02b7u, 0x7b47f409u, 0xba1d3330u, 0x83d2f293u, 0xbfa4784bu, 0xcbed606eu,
+};
+
+static const struct {
+    uint32_t seed, x, y, h;
+} hash_ref[] = {
+        {0xa341316cu, 0, 0, 0x74f5ca1cu},
+        {0xa341316cu, 1, 0, 0x4fac70a5u},
+        {0xa341316cu, 0, 1, 0xb4bfb70fu},
+        {0xa341316cu, 299, 499, 0xbf45a576u},
+        {0x00000001u, 0, 0, 0x688990c0u},
+        {0xffffffffu, 0xffffffffu, 0xffffffffu, 0x533c4b30u},
+};
+
+static uint32_t popcount(uint32_t v)
+{
+    return (uint32_t)__builtin_popcount(v);
+}
+
+static void fill(uint32_t *seq, uint64_t seed, uint64_t stream)
+{
+    prng_t r;
+
+    prng_seed(&r, seed, stream);
+    for (uint32_t i = 0; i < SEQ_LEN; i++)
+        seq[i] = prng_u32(&r);
+}
+
+static void test_sequence(void)
+{
+    static uint32_t a[SEQ_LEN], b[SEQ_LEN];
+    prng_t r;
+
+    prng_seed(&r, 42u, 54u);
+    for (uint32_t i = 0; i < count_of(pcg32_ref); i++) {
+        uint32_t v = prng_u32(&r);
+        if (v != pcg32_ref[i])
+            FAIL("sequence: value %u of seed 42 stream 54 is %08x, reference %08x\n", i, v, pcg32_ref[i]);
+    }
+
+    fill(a, SEED, 3);
+    fill(b, SEED, 3);
+    if (memcmp(a, b, sizeof(a)))
+        FAIL("sequence: seed and stream seeded twice differ\n");
+
+    /* other seed, other stream: no value in the same place */
+    const struct {
+        uint64_t seed, stream;
+    } other[] = {{SEED + 1, 3}, {SEED, 4}, {SEED ^ 0x80000000u, 3}, {(uint64_t)SEED << 32, 3}};
+    for (uint32_t k = 0; k < count_of(other); k++) {
+        uint32_t same = 0;
+        fill(b, other[k].seed, other[k].stream);
+        for (uint32_t i = 0; i < SEQ_LEN; i++)
+            same += a[i] == b[i];
+        if (same > 1)
+            FAIL("sequence: seed %llx stream %llu repeats %u values of seed %x stream 3\n",
+                 (unsigned long long)other[k].seed, (unsigned long long)other[k].stream, same, SEED);
+    }
+}
+
+static void test_streams(uint32_t draws)
+{
+    static uint32_t ref[STREAMS][SEQ_LEN];
+    uint32_t pos[STREAMS] = {0};
+    prng_t s[STREAMS];
+
+    for (uint32_t k = 0; k < STREAMS; k++) {
+        fill(ref[k], SEED, k);
+        prng_seed(&s[k], SEED, k);
+    }
+
+    /* draws in a random order, bursts of random length, as the patterns take them */
+    for (uint32_t d = 0; d < draws;) {
+        uint32_t k = prng_u32(&rng) % STREAMS;   // not prng_below(), it is under test
+        uint32_t burst = 1 + prng_u32(&rng) % 64;
+        for (uint32_t j = 0; j < burst && pos[k] < SEQ_LEN; j++, d++) {
+            uint32_t v = prng_u32(&s[k]);
+            if (v != ref[k][pos[k]])
+                FAIL("streams: stream %u value %u is %08x interleaved, %08x alone\n", k, pos[k], v, ref[k][pos[k]]);
+            pos[k]++;
+        }
+        if (pos[k] == SEQ_LEN) {
+            /* a pattern restarting: re-seeding must not move the others */
+            prng_seed(&s[k], SEED, k);
+            pos[k] = 0;
+        }
+    }
+
+    /* values of two streams in the same place */
+    for (uint32_t k = 1; k < STREAMS; k++) {
+        uint32_t same = 0;
+        for (uint32_t i = 0; i < SEQ_LEN; i++)
+            same += ref[0][i] == ref[k][i];
+        if (same > 1)
+            FAIL("streams: streams 0 and %u share %u of %u values\n", k, same, SEQ_LEN);
+    }
+}
+
+static void test_below(uint32_t draws)
+{
+    static const uint32_t limits[] = {
+            1, 2, 3, 7, 10, 255, 300, 1000, 65537, 0x7FFFFFFFu, 0x80000000u, 0xFFFFFFFEu, 0xFFFFFFFFu,
+    };
+    static uint32_t hist[1000];
+    prng_t r;
+
+    prng_seed(&r, SEED, 1);
+    for (uint32_t l = 0; l < count_of(limits); l++) {
+        uint32_t n = limits[l], top = 0;
+
+        if (n <= count_of(hist))
+            memset(hist, 0, sizeof(hist));
+        for (uint32_t i = 0; i < draws; i++) {
+            uint32_t v = prng_below(&r, n);
+            if (v >= n) {
+                FAIL("below: %u out of [0, %u)\n", v, n);
+                break;
+            }
+            if (v > top)
+                top = v;
+            if (n <= count_of(hist))
+                hist[v]++;
+        }
+        /* the top of the range is reached too, not only the low half */
+        if (draws >= 1000 && top < n - 1 - n / 64)
+            FAIL("below: largest of %u draws below %u is %u\n", draws, n, top);
+        if (n > count_of(hist))
+            continue;
+
+        /* every value, each within 6 sigma of draws / n */
+        double expect = (double)draws / n, sigma = sqrt(expect * (1.0 - 1.0 / n));
+        double worst = 0.0;
+        for (uint32_t v = 0; v < n; v++) {
+            double dev = fabs((double)hist[v] - expect);
+            if (dev > worst)
+                worst = dev;
+            if (dev > 6.0 * sigma + 1.0) {
+                FAIL("below: %u of [0, %u) drawn %u times, expected %.0f\n", v, n, hist[v], expect);
+                break;
+            }
+        }
+        if (verbose)
+            printf("below %-10u worst bucket %.1f sigma\n", n, sigma > 0.0 ? worst / sigma : 0.0);
+    }
+}
+
+static void test_hash(uint32_t draws)
+{
+    enum { PIXELS = 300, FRAMES = 500 };
+    static uint32_t grid[FRAMES][PIXELS];
+    uint32_t bits[32] = {0}, flips = 0, flip_tests = 0;
+
+    for (uint32_t i = 0; i < count_of(hash_ref); i++) {
+        uint32_t h = prng_hash(hash_ref[i].seed, hash_ref[i].x, hash_ref[i].y);
+        if (h != hash_ref[i].h)
+            FAIL("hash: (%08x, %u, %u) is %08x, known %08x\n", hash_ref[i].seed, hash_ref[i].x, hash_ref[i].y,
+                 h, hash_ref[i].h);
+    }
+
+    /* pixel by pixel per frame, then frame by frame per pixel: same values */
+    for (uint32_t f = 0; f < FRAMES; f++)
+        for (uint32_t p = 0; p < PIXELS; p++)
+            grid[f][p] = prng_hash(SEED, p, f);
+    for (uint32_t p = PIXELS; p-- > 0;)
+        for (uint32_t f = FRAMES; f-- > 0;) {
+            uint32_t h = prng_hash(SEED, p, f);
+            if (h != grid[f][p])
+                FAIL("hash: pixel %u frame %u is %08x, %08x before\n", p, f, h, grid[f][p]);
+            for (uint32_t b = 0; b < 32; b++)
+                bits[b] += (h >> b) & 1u;
+        }
+
+    /* neighbours in space and time are not equal */
+    uint32_t same = 0;
+    for (uint32_t f = 1; f < FRAMES; f++)
+        for (uint32_t p = 1; p < PIXELS; p++)
+            same += grid[f][p] == grid[f][p - 1] || grid[f][p] == grid[f - 1][p];
+    if (same > 1)
+        FAIL("hash: %u pixels equal to a neighbour\n", same);
+
+    /* each bit set half the time: 6 sigma of PIXELS * FRAMES fair coins */
+    double half = PIXELS * FRAMES / 2.0, sigma = sqrt(half / 2.0);
+    for (uint32_t b = 0; b < 32; b++)
+        if (fabs((double)bits[b] - half) > 6.0 * sigma)
+            FAIL("hash: bit %u set %u of %u times\n", b, bits[b], PIXELS * FRAMES);
+
+    /* one flipped bit of seed, pixel or frame changes about 16 of 32 */
+    for (uint32_t i = 0; i < draws / 16; i++) {
+        uint32_t s = prng_u32(&rng), x = prng_u32(&rng), y = prng_u32(&rng);
+        uint32_t h = prng_hash(s, x, y), b = 1u << (prng_u32(&rng) & 31u);
+        flips += popcount(h ^ prng_hash(s ^ b, x, y));
+        flips += popcount(h ^ prng_hash(s, x ^ b, y));
+        flips += popcount(h ^ prng_hash(s, x, y ^ b));
+        flip_tests += 3;
+    }
+    double avg = flip_tests ? (double)flips / flip_tests : 16.0;
+    if (avg < 15.5 || avg > 16.5)
+        FAIL("hash: one flipped input bit changes %.2f output bits on average\n", avg);
+    if (verbose)
+        printf("hash avalanche %.3f bits of 32 over %u flips\n", avg, flip_tests);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t n = 0, seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "vn:r:")) != -1) {
+        switch (opt) {
+        case 'v': verbose = true; break;
+        case 'n': n = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'r': seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-v] [-n draws] [-r seed]\n", argv[0]);
+            return 2;
+        }
+    }
+    prng_seed(&rng, seed, 51);
+
+    test_sequence();
+    test_streams(n ? n : 1000000);
+    test_below(n ? n : 1000000);
+    test_hash(n ? n : 1000000);
+
+    printf("%s: %u errors\n", errors ? "FAIL" : "OK", errors);
+    return errors ? 1 : 0;
+}
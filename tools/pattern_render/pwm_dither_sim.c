@@ -0,0 +1,181 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Host simulation of the kitchen_pwm sigma-delta dithering (pwm_fade.c).
+ * A sweep of 16-bit logical levels is turned into the CC patterns the DMA
+ * ring plays; the emitted duty cycles are integrated per level and compared
+ * with the ideal gamma curve.
+ *  - eff bits: log2(full scale / smallest non-zero mean duty)
+ *  - distinct: different mean duties in the bottom 1/8 of the logical range
+ *  - rms err:  mean duty vs ideal curve in the bottom 1/8, in PWM counts
+ *  - LF mod:   worst modulation of the light below the cutoff frequency,
+ *              relative to its mean (visible flicker)
+ *  - LF energy: worst relative flicker power below the cutoff
+ * The first row is the path without dithering (10-bit level, linear_to_pwm).
+ * Exits with 1 when a pattern's mean differs from the dithered duty.
+ *
+ *   pwm_dither_sim [-f pwm_hz] [-c cutoff_hz]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <unistd.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "config.h"
+#include "pwm_fade.h"
+#include "pwm_gamma.h"
+
+#define SWEEP_STEP      16u             // 4096 levels
+#define BOTTOM_LEVEL    0x2000u         // night light range
+#define GAMMA           2.2
+
+static uint32_t errors;
+
+typedef struct {
+    double step;            // smallest non-zero mean duty, counts
+    uint32_t distinct;
+    double rms_err;
+    double lf_mod;
+    double lf_energy;
+} dither_stats_t;
+
+/**
+ * Periodic CC sequence of one level; bits < 0 is the undithered path
+ */
+static uint32_t level_pattern(uint16_t level16, int bits, uint16_t *seq)
+{
+    if (bits < 0) {
+        seq[0] = linear_to_pwm((uint16_t)(level16 >> (16 - LINEAR_BITS)));
+        return 1;
+    }
+
+    const pwm_fade_slice_t slice = { .fx = { 0, -1 }, .ch = { 0, -1 },
+                                     .gamma = { gamma_get_default(), gamma_get_default() } };
+    const uint16_t level[2] = { level16, 0 };
+    uint32_t cc[1u << 6];
+    uint32_t n = 1u << bits;
+
+    pwm_dither_pattern(&slice, level, LINEAR_MAX, (uint32_t)bits, cc);
+    for (uint32_t k = 0; k < n; k++)
+        seq[k] = (uint16_t)cc[k];
+
+    // the mean must be the duty rounded to 'bits'
+    uint32_t sum = 0, shift = PWM_DUTY_FRAC_BITS - (uint32_t)bits;
+    for (uint32_t k = 0; k < n; k++)
+        sum += seq[k];
+    uint32_t duty = level16_to_duty(apply_brightness_level(level16, LINEAR_MAX));
+    if (sum != (duty + ((1u << shift) >> 1)) >> shift) {
+        if (errors++ < 10)
+            printf("bits %d level %u: pattern sum %u, duty %u\n", bits, level16, sum, duty);
+    }
+    return n;
+}
+
+/**
+ * Low frequency content of the per-period duty (the eye integrates the
+ * carrier itself). The pattern repeats every n periods, so only harmonics
+ * of pwm_hz / n exist; those up to cutoff_hz are summed.
+ */
+static void flicker(const uint16_t *seq, uint32_t n, double mean, uint32_t pwm_hz, uint32_t cutoff_hz,
+                    double *mod, double *energy)
+{
+    *mod = 0.0;
+    *energy = 0.0;
+    for (uint32_t j = 1; j < n && (uint64_t)j * pwm_hz <= (uint64_t)cutoff_hz * n; j++) {
+        double re = 0.0, im = 0.0;
+
+        for (uint32_t k = 0; k < n; k++) {
+            double a = 2.0 * M_PI * (double)j * (double)k / (double)n;
+            re += seq[k] * cos(a);
+            im -= seq[k] * sin(a);
+        }
+        double amp = 2.0 * sqrt(re * re + im * im) / (double)n / mean;
+        if (amp > *mod)
+            *mod = amp;
+        *energy += amp * amp / 2.0;
+    }
+}
+
+static dither_stats_t run(int bits, uint32_t pwm_hz, uint32_t cutoff_hz)
+{
+    dither_stats_t st = { .step = 1e9 };
+    uint16_t seq[1u << 6];
+    double last_mean = -1.0, err2 = 0.0;
+    uint32_t bottom = 0;
+
+    for (uint32_t l = 0; l <= 0xFFFF; l += SWEEP_STEP) {
+        uint16_t level16 = (uint16_t)l;
+        uint32_t n = level_pattern(level16, bits, seq);
+        double mean = 0.0;
+
+        for (uint32_t k = 0; k < n; k++)
+            mean += seq[k];
+        mean /= n;
+
+        if (mean > 0.0 && mean < st.step)
+            st.step = mean;
+        if (l < BOTTOM_LEVEL) {
+            double ideal = pow((double)level16 / 65535.0, GAMMA) * PWM_MAX;
+            err2 += (mean - ideal) * (mean - ideal);
+            bottom++;
+            if (mean != last_mean)
+                st.distinct++;
+            last_mean = mean;
+        }
+        if (mean > 0.0 && n > 1) {
+            double mod, energy;
+            flicker(seq, n, mean, pwm_hz, cutoff_hz, &mod, &energy);
+            if (mod > st.lf_mod)
+                st.lf_mod = mod;
+            if (energy > st.lf_energy)
+                st.lf_energy = energy;
+        }
+    }
+    st.rms_err = sqrt(err2 / bottom);
+    return st;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t pwm_hz = PWM_FREQ, cutoff_hz = 100;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:c:")) != -1) {
+        switch (opt) {
+        case 'f': pwm_hz = (uint32_t)atoi(optarg); break;
+        case 'c': cutoff_hz = (uint32_t)atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-f pwm_hz] [-c cutoff_hz]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!pwm_hz)
+        pwm_hz = PWM_FREQ;
+
+    gamma_lut_init();
+    printf("PWM %u Hz, wrap %u, flicker cutoff %u Hz, firmware PWM_DITHER_BITS %u\n",
+           pwm_hz, PWM_WRAP, cutoff_hz, PWM_DITHER_BITS);
+    printf("dither  cycle Hz  eff bits  min duty %%  distinct  rms err  LF mod %%  LF energy\n");
+
+    for (int bits = -1; bits <= 6; bits++) {
+        dither_stats_t st = run(bits, pwm_hz, cutoff_hz);
+        double full = PWM_WRAP + 1.0;
+
+        if (bits < 0)
+            printf("off        -     ");
+        else
+            printf("%3d   %7.1f     ", bits, (double)pwm_hz / (1u << bits));
+        printf("%5.2f    %8.5f  %8u  %7.3f  %8.2f  %9.2e\n",
+               log2(full / st.step), 100.0 * st.step / full, st.distinct, st.rms_err,
+               100.0 * st.lf_mod, st.lf_energy);
+    }
+    return errors ? 1 : 0;
+}
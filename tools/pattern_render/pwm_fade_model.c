@@ -0,0 +1,163 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Host model of the kitchen_pwm DMA fade tables.
+ * pwm_fade_fill() output, generated chunk by chunk as the DMA IRQ does, is
+ * compared per PWM period with the poll-based fade it replaces:
+ * lerp_rgbw() (copied below from pwm_api.c) + apply_brightness + linear_to_pwm.
+ *  - every period that falls on a whole millisecond must match exactly
+ *  - periods in between must lie between the neighbouring millisecond values
+ *  - the table ends with the target value
+ *
+ *   pwm_fade_model [-n fades]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "config.h"
+#include "pwm_fade.h"
+#include "pwm_gamma.h"
+#include "prng.h"
+
+#define TABLE_MAX   (60u * 20000u + 1u)     // 60 s at 20 kHz
+
+static uint32_t table[TABLE_MAX];
+static uint32_t errors;
+
+/* reference: one channel of lerp_rgbw() in pwm_api.c */
+static uint16_t ref_lerp(uint16_t a, uint16_t b, uint32_t t_ms, uint32_t dur_ms)
+{
+    if (dur_ms == 0) return b;
+    if (t_ms >= dur_ms) return b;
+    int32_t da = (int32_t)b - (int32_t)a;
+    return (uint16_t)((int32_t)a + (int32_t)((da * (int32_t)t_ms) / (int32_t)dur_ms));
+}
+
+static uint16_t ref_out(uint16_t a, uint16_t b, uint32_t t_ms, uint32_t dur_ms,
+                        uint16_t brightness, bool active_low)
+{
+    uint16_t pwm = linear_to_pwm(apply_brightness_level(ref_lerp(a, b, t_ms, dur_ms), brightness));
+    return active_low ? (uint16_t)(PWM_WRAP - pwm) : pwm;
+}
+
+static uint64_t cpu_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * One fade on one slice (two channels); returns the number of periods
+ */
+static uint32_t check_fade(const uint16_t from[2], const uint16_t to[2], const bool active_low[2],
+                           uint32_t dur_ms, uint32_t freq, uint16_t brightness, uint64_t *gen_ns)
+{
+    pwm_fade_slice_t s = { .fx = { 0, 0 }, .ch = { 0, 1 }, .active_low = { active_low[0], active_low[1] },
+                           .gamma = { gamma_get_default(), gamma_get_default() } };
+    uint32_t periods = pwm_fade_periods(dur_ms, freq);
+    uint32_t n = 0, got;
+    bool exact = ((uint64_t)dur_ms * freq) % 1000u == 0;
+
+    if (!periods || periods >= TABLE_MAX)
+        return 0;
+    for (int h = 0; h < 2; h++)
+        pwm_ramp_init(&s.ramp[h], from[h], to[h], periods);
+
+    uint64_t t0 = cpu_time_ns();
+    while ((got = pwm_fade_fill(&s, brightness, &table[n], PWM_FADE_CHUNK)) != 0)
+        n += got;
+    *gen_ns += cpu_time_ns() - t0;
+
+    if (n != periods + 1) {
+        printf("length %u, expected %u (dur %u ms, %u Hz)\n", n, periods + 1, dur_ms, freq);
+        errors++;
+        return n;
+    }
+
+    for (uint32_t k = 0; k < n; k++) {
+        for (int h = 0; h < 2; h++) {
+            uint16_t v = (uint16_t)(table[k] >> (16 * h));
+            uint64_t t_us = (uint64_t)k * 1000000u / freq;
+            uint32_t t_ms = (uint32_t)(t_us / 1000u);
+            uint16_t e0 = ref_out(from[h], to[h], t_ms, dur_ms, brightness, active_low[h]);
+            uint16_t e1 = ref_out(from[h], to[h], t_ms + 1, dur_ms, brightness, active_low[h]);
+            bool on_ms = ((uint64_t)k * 1000u) % freq == 0;
+            bool ok;
+
+            if (k == n - 1)
+                ok = v == ref_out(from[h], to[h], dur_ms, dur_ms, brightness, active_low[h]);
+            else if (on_ms && exact)
+                ok = v == e0;
+            else
+                ok = (v >= (e0 < e1 ? e0 : e1) && v <= (e0 > e1 ? e0 : e1)) ||
+                     (!exact && v >= (e0 < e1 ? e0 : e1) - 1 && v <= (e0 > e1 ? e0 : e1) + 1);
+            if (!ok) {
+                if (errors < 10)
+                    printf("mismatch %u->%u %u ms %u Hz bri %u: period %u ch %d = %u, ref %u..%u\n",
+                           from[h], to[h], dur_ms, freq, brightness, k, h, v, e0, e1);
+                errors++;
+            }
+        }
+    }
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    static const uint32_t durations[] = { 1, 7, 100, 250, 1000, 3000, 10000 };
+    static const uint32_t freqs[] = { PWM_FREQ, 600, 1000, 20000 };
+    static const uint16_t brightness[] = { LINEAR_MAX, 512, 0 };
+    uint32_t fades = 200, checked = 0;
+    uint64_t periods_total = 0, gen_ns = 0;
+    prng_t rng;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n': fades = (uint32_t)atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n fades]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    gamma_lut_init();
+    prng_seed(&rng, 2024, 1);
+
+    for (uint32_t i = 0; i < fades; i++) {
+        uint16_t from[2], to[2];
+        bool active_low[2] = { prng_below(&rng, 2) != 0, prng_below(&rng, 2) != 0 };
+
+        for (int h = 0; h < 2; h++) {
+            from[h] = (uint16_t)prng_below(&rng, LINEAR_MAX + 1);
+            to[h] = (uint16_t)prng_below(&rng, LINEAR_MAX + 1);
+        }
+        if (i % 8 == 0)
+            to[0] = from[0];        // channel that does not change
+        uint32_t dur = durations[i % count_of(durations)];
+        uint32_t freq = freqs[(i / count_of(durations)) % count_of(freqs)];
+        uint16_t bri = brightness[i % count_of(brightness)];
+
+        periods_total += check_fade(from, to, active_low, dur, freq, bri, &gen_ns);
+        checked++;
+    }
+
+    printf("%u fades, %llu PWM periods, %u mismatches\n",
+           checked, (unsigned long long)periods_total, errors);
+    printf("table generation: %.1f ns per period (2 channels), %.1f us per %u-period chunk\n",
+           periods_total ? (double)gen_ns / (double)periods_total : 0.0,
+           periods_total ? (double)gen_ns / (double)periods_total * PWM_FADE_CHUNK / 1000.0 : 0.0,
+           PWM_FADE_CHUNK);
+    return errors ? 1 : 0;
+}
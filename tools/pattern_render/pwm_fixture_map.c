@@ -0,0 +1,299 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Host check of kitchen_pwm/pwm_fixture.c, the DDP frame -> fixture ->
+ * PWM slice mapping. A test table with mixed polarity, per-fixture gamma,
+ * an unfitted channel and shared slices is fed random DDP frames in every
+ * pixel format, and
+ *  - each fixture must get the pixel at offset + ddp_pixel * pixel size
+ *  - fixtures beyond a short payload must keep their colour
+ *  - the staged CC of every pin must be its fixture's gamma curve,
+ *    inverted when active low, in the A / B half of its GPIO
+ *  - a frame that changes nothing must leave every slice clean
+ *  - bad tables (pin used twice, too many gamma curves) must be refused
+ * then the cost of one frame (map, stage, commit) is reported.
+ *
+ *   pwm_fixture_map [-n frames]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "config.h"
+#include "pwm_fixture.h"
+#include "prng.h"
+
+#define FRAME_MAX   512
+
+static uint32_t errors;
+
+#define FAIL(...) do { if (errors++ < 10) printf(__VA_ARGS__); } while (0)
+
+/* 10 slices (8, 9 on RP2350B GPIO 32..35), B of "shelf" not fitted, slice 7
+ * shared by two fixtures, 5 fixtures on 3 gamma curves */
+static const pwm_fixture_t test_fixtures[] = {
+    { "main",    { 6, 7, 5, 4 },      { true, true, true, false },     22, 0 },
+    { "cabinet", { 8, 9, 10, 11 },    { false, false, false, false },  28, 1 },
+    { "shelf",   { 12, 13, -1, 14 },  { true, false, true, false },    18, 3 },
+    { "plinth",  { 15, 0, 1, 2 },     { false, false, false, false },  22, 2 },
+    { "desk",    { 32, 33, 34, 35 },  { true, true, true, true },      28, 7 },
+};
+
+static uint32_t gpio_slice(uint32_t gpio)
+{
+    return (gpio < 32) ? ((gpio >> 1) & 7u) : 8u + ((gpio >> 1) & 3u);
+}
+
+static pwm_gamma_t ref_gamma[3];
+
+static const pwm_gamma_t *ref_curve(uint8_t gamma_x10)
+{
+    for (int i = 0; i < 3; i++)
+        if (ref_gamma[i].gamma_x10 == gamma_x10)
+            return &ref_gamma[i];
+    return NULL;
+}
+
+static uint64_t cpu_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint16_t ch(const rgbw16_t *c, int i)
+{
+    const uint16_t v[4] = { c->r, c->g, c->b, c->w };
+    return v[i];
+}
+
+/* reference decoding of one pixel, straight from the format description */
+static bool ref_pixel(const uint8_t *p, uint32_t len, uint32_t off, ddp_rgbw_format_t fmt, rgbw16_t *out)
+{
+    uint16_t v[4] = { 0, 0, 0, 0 };
+
+    switch (fmt) {
+        case DDP_FMT_RGBW8:
+        case DDP_FMT_RGB8W0: {
+            uint32_t n = (fmt == DDP_FMT_RGBW8) ? 4 : 3;
+            if (off + n > len)
+                return false;
+            for (uint32_t i = 0; i < n; i++)
+                v[i] = (uint16_t)((p[off + i] * PWM_WRAP + 127u) / 255u);
+            break;
+        }
+        case DDP_FMT_RGBW16LE:
+            if (off + 8 > len)
+                return false;
+            for (uint32_t i = 0; i < 4; i++)
+                v[i] = (uint16_t)(((p[off + 2 * i] | (uint32_t)p[off + 2 * i + 1] << 8) * PWM_WRAP + 32767u) / 65535u);
+            break;
+        default:
+            return false;
+    }
+    *out = (rgbw16_t){ v[0], v[1], v[2], v[3] };
+    return true;
+}
+
+static uint32_t commit(void)
+{
+    uint32_t writes = 0;
+
+    for (uint8_t i = 0; i < pwm_fixture_slice_count(); i++) {
+        pwm_fixture_slice_t *s = pwm_fixture_slice(i);
+        if (s->dirty) {
+            s->dirty = false;
+            writes++;
+        }
+    }
+    return writes;
+}
+
+/* the CC half of every fitted pin against the reference curve */
+static void check_cc(const rgbw16_t *col, uint8_t count)
+{
+    for (uint8_t fx = 0; fx < count; fx++) {
+        const pwm_fixture_t *f = &test_fixtures[fx];
+
+        for (int c = 0; c < PWM_CH_COUNT; c++) {
+            if (f->pin[c] < 0)
+                continue;
+
+            uint32_t slice = gpio_slice((uint32_t)f->pin[c]), h = (uint32_t)f->pin[c] & 1u;
+            const pwm_fixture_slice_t *s = NULL;
+            for (uint8_t i = 0; i < pwm_fixture_slice_count(); i++)
+                if (pwm_fixture_slice(i)->slice == slice)
+                    s = pwm_fixture_slice(i);
+            if (!s) {
+                FAIL("%s pin %d: no slice %u\n", f->name, f->pin[c], slice);
+                continue;
+            }
+
+            uint16_t pwm = gamma_to_pwm(ref_curve(f->gamma_x10), ch(&col[fx], c));
+            uint16_t want = f->active_low[c] ? (uint16_t)(PWM_WRAP - pwm) : pwm;
+            uint16_t got = (uint16_t)(s->cc >> (16u * h));
+            if (got != want)
+                FAIL("%s ch %d pin %d: cc %u, expected %u (level %u)\n",
+                     f->name, c, f->pin[c], got, want, ch(&col[fx], c));
+        }
+    }
+}
+
+static void check_tables(void)
+{
+    pwm_fixture_t bad[3];
+
+    memcpy(bad, test_fixtures, sizeof(bad));
+    bad[1].pin[2] = 7;                      // G of "main"
+    if (pwm_fixture_init_table(bad, 3))
+        FAIL("pin used twice accepted\n");
+
+    memcpy(bad, test_fixtures, sizeof(bad));
+    bad[0].gamma_x10 = 16;
+    bad[1].gamma_x10 = 20;
+    bad[2].gamma_x10 = 24;
+    if (!pwm_fixture_init_table(bad, 3))
+        FAIL("%u extra gamma curves refused\n", PWM_GAMMA_MAX);
+
+    pwm_fixture_t many[PWM_FIXTURE_MAX + 1];
+    for (int i = 0; i <= PWM_FIXTURE_MAX; i++)
+        many[i] = (pwm_fixture_t){ "x", { -1, -1, -1, -1 }, { false }, (uint8_t)(10 + i), (uint16_t)i };
+    if (pwm_fixture_init_table(many, PWM_FIXTURE_MAX + 1))
+        FAIL("%u fixtures accepted\n", PWM_FIXTURE_MAX + 1);
+    if (pwm_fixture_init_table(many, PWM_GAMMA_MAX + 1))
+        FAIL("%u gamma curves accepted\n", PWM_GAMMA_MAX + 1);
+}
+
+/**
+ * Random frames in all formats; returns the number of fixture updates checked
+ */
+static uint32_t check_frames(prng_t *rng, uint32_t frames)
+{
+    const uint8_t count = (uint8_t)count_of(test_fixtures);
+    uint8_t payload[FRAME_MAX];
+    rgbw16_t col[PWM_FIXTURE_MAX];
+    uint32_t checked = 0;
+
+    if (!pwm_fixture_init_table(test_fixtures, count)) {
+        FAIL("test table refused\n");
+        return 0;
+    }
+    if (pwm_fixture_slice_count() != 10)
+        FAIL("%u slices, expected 10\n", pwm_fixture_slice_count());
+    memset(col, 0, sizeof(col));
+    commit();
+
+    for (uint32_t n = 0; n < frames; n++) {
+        ddp_rgbw_format_t fmt = (ddp_rgbw_format_t)prng_below(rng, DDP_FMT_TIMELINE);
+        uint16_t base = (uint16_t)prng_below(rng, 16);
+        // mostly full frames, sometimes cut inside the fixture pixels
+        uint32_t full = base + 8u * pwm_ddp_pixel_size(fmt);
+        uint16_t len = (uint16_t)(prng_below(rng, 4) ? full : prng_below(rng, full + 1));
+        rgbw16_t want[PWM_FIXTURE_MAX];
+        uint8_t expect = 0;
+
+        for (uint32_t i = 0; i < len; i++)
+            payload[i] = (uint8_t)prng_u32(rng);
+        memcpy(want, col, sizeof(want));
+        for (uint8_t fx = 0; fx < count; fx++)
+            if (ref_pixel(payload, len, base + test_fixtures[fx].ddp_pixel * pwm_ddp_pixel_size(fmt), fmt, &want[fx]))
+                expect++;
+
+        uint8_t got = pwm_fixture_ddp_frame(payload, len, fmt, base, col);
+        if (got != expect)
+            FAIL("frame %u fmt %d len %u: %u fixtures updated, expected %u\n", n, fmt, len, got, expect);
+        for (uint8_t fx = 0; fx < count; fx++) {
+            if (memcmp(&col[fx], &want[fx], sizeof(rgbw16_t)) != 0)
+                FAIL("frame %u fmt %d fixture %u: %u %u %u %u, expected %u %u %u %u\n", n, fmt, fx,
+                     col[fx].r, col[fx].g, col[fx].b, col[fx].w, want[fx].r, want[fx].g, want[fx].b, want[fx].w);
+            pwm_fixture_stage(fx, &col[fx]);
+            checked++;
+        }
+        check_cc(col, count);
+        commit();
+
+        // the same frame again: nothing to write
+        for (uint8_t fx = 0; fx < count; fx++)
+            pwm_fixture_stage(fx, &col[fx]);
+        if (commit())
+            FAIL("frame %u: unchanged frame dirtied slices\n", n);
+    }
+    return checked;
+}
+
+/**
+ * Full table, one RGBW8 frame per iteration: map + stage + commit
+ */
+static double bench_ingest(prng_t *rng, uint32_t frames, uint32_t *writes)
+{
+    pwm_fixture_t tab[PWM_FIXTURE_MAX];
+    uint8_t payload[FRAME_MAX];
+    rgbw16_t col[PWM_FIXTURE_MAX];
+
+    // all 12 RP2350B slices: GPIO 0..15 and 32..39, default curve
+    for (int i = 0; i < PWM_FIXTURE_MAX; i++) {
+        tab[i] = (pwm_fixture_t){ "bench", { 0 }, { true, true, true, false }, 22, (uint16_t)i };
+        for (int c = 0; c < PWM_CH_COUNT; c++)
+            tab[i].pin[c] = (int8_t)((i < 4 ? 0 : 16) + i * PWM_CH_COUNT + c);
+    }
+    pwm_fixture_init_table(tab, PWM_FIXTURE_MAX);
+    memset(col, 0, sizeof(col));
+    *writes = 0;
+
+    uint64_t ns = 0;
+    for (uint32_t n = 0; n < frames; n++) {
+        for (uint32_t i = 0; i < PWM_FIXTURE_MAX * 4; i++)
+            payload[i] = (uint8_t)prng_u32(rng);
+
+        uint64_t t0 = cpu_time_ns();
+        pwm_fixture_ddp_frame(payload, PWM_FIXTURE_MAX * 4, DDP_FMT_RGBW8, 0, col);
+        for (uint8_t fx = 0; fx < PWM_FIXTURE_MAX; fx++)
+            pwm_fixture_stage(fx, &col[fx]);
+        *writes += commit();
+        ns += cpu_time_ns() - t0;
+    }
+    return (double)ns / frames;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frames = 20000;
+    prng_t rng;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n': frames = (uint32_t)atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n frames]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    gamma_lut_init();
+    gamma_curve_init(&ref_gamma[0], 22);
+    gamma_curve_init(&ref_gamma[1], 28);
+    gamma_curve_init(&ref_gamma[2], 18);
+    prng_seed(&rng, 0x5eed, 34);
+
+    check_tables();
+    uint32_t checked = check_frames(&rng, frames);
+
+    uint32_t writes;
+    double ns = bench_ingest(&rng, frames, &writes);
+
+    printf("%u frames, %u fixture updates checked, %u errors\n", frames, checked, errors);
+    printf("ingest %u fixtures / %u slices: %.0f ns per frame (host), %.2f slice writes per frame\n",
+           PWM_FIXTURE_MAX, pwm_fixture_slice_count(), ns, (double)writes / frames);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,248 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Host check of kitchen_pwm/pwm_timeline.c, sampled at 1 kHz like a fast
+ * pwm_api_poll(). Random timelines (all easing curves, holds, 0 ms jumps)
+ * are played and every sample is checked for
+ *  - monotonicity: each channel moves only toward the segment target
+ *  - accuracy: within 1 LSB of the float curve
+ *  - endpoints: a segment starts exactly on the previous target and the
+ *    timeline ends exactly on the last one
+ * plus loop periodicity and sparse polling (no drift), then the cost of
+ * one evaluation is reported.
+ *
+ *   pwm_timeline_model [-n timelines]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "config.h"
+#include "pwm_timeline.h"
+#include "prng.h"
+
+static uint32_t errors;
+
+#define FAIL(...) do { if (errors++ < 10) printf(__VA_ARGS__); } while (0)
+
+static uint16_t ch(const rgbw16_t *c, int i)
+{
+    const uint16_t v[4] = { c->r, c->g, c->b, c->w };
+    return v[i];
+}
+
+static bool rgbw_eq(rgbw16_t a, rgbw16_t b)
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.w == b.w;
+}
+
+static double ref_curve(pwm_ease_t ease, double x, bool rising)
+{
+    switch (ease) {
+        case PWM_EASE_IN:     return x * x;
+        case PWM_EASE_OUT:    return 1.0 - (1.0 - x) * (1.0 - x);
+        case PWM_EASE_IN_OUT: return x * x * (3.0 - 2.0 * x);
+        case PWM_EASE_EXP:
+            if (!rising)
+                return 1.0 - ref_curve(ease, 1.0 - x, true);
+            return (pow(2.0, 8.0 * x) - 1.0) / (pow(2.0, 8.0) - 1.0);
+        default:              return x;
+    }
+}
+
+static uint64_t cpu_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static rgbw16_t random_rgbw(prng_t *rng)
+{
+    return (rgbw16_t){
+        .r = (uint16_t)prng_below(rng, LINEAR_MAX + 1),
+        .g = (uint16_t)prng_below(rng, LINEAR_MAX + 1),
+        .b = (uint16_t)prng_below(rng, LINEAR_MAX + 1),
+        .w = (uint16_t)prng_below(rng, LINEAR_MAX + 1),
+    };
+}
+
+/**
+ * Play one random timeline at 1 kHz and check every sample; returns samples
+ */
+static uint32_t check_timeline(prng_t *rng, uint32_t t0, double *max_err)
+{
+    static const uint32_t durations[] = { 0, 1, 5, 37, 250, 1000, 3000 };
+    pwm_timeline_t tl;
+    pwm_tl_seg_t seg[PWM_TL_MAX_SEGS];
+    uint32_t nseg = 1 + prng_below(rng, PWM_TL_MAX_SEGS);
+    rgbw16_t start = random_rgbw(rng);
+    uint32_t samples = 0;
+
+    pwm_tl_init(&tl);
+    for (uint32_t i = 0; i < nseg; i++) {
+        seg[i].to = random_rgbw(rng);
+        seg[i].dur_ms = durations[prng_below(rng, count_of(durations))];
+        seg[i].ease = (uint8_t)prng_below(rng, PWM_EASE_COUNT);
+        if (!pwm_tl_push(&tl, seg[i].to, seg[i].dur_ms, (pwm_ease_t)seg[i].ease))
+            FAIL("push %u refused\n", i);
+    }
+    if (pwm_tl_push(&tl, start, 1, PWM_EASE_LINEAR) != (nseg < PWM_TL_MAX_SEGS))
+        FAIL("push on a full queue\n");
+    if (nseg < PWM_TL_MAX_SEGS)
+        seg[nseg++] = (pwm_tl_seg_t){ .to = start, .dur_ms = 1, .ease = PWM_EASE_LINEAR };
+    pwm_tl_start(&tl, start, t0);
+
+    rgbw16_t from = start, prev = start;
+    uint32_t seg_t0 = 0, idx = 0;
+
+    for (uint32_t t = 0; ; t++) {
+        rgbw16_t out;
+        bool running = pwm_tl_eval(&tl, t0 + t, &out);
+
+        // segments that ended at or before t, including 0 ms ones
+        while (idx < nseg && t >= seg_t0 + seg[idx].dur_ms) {
+            if (seg[idx].ease != PWM_EASE_HOLD)
+                from = seg[idx].to;
+            seg_t0 += seg[idx].dur_ms;
+            idx++;
+            prev = from;
+        }
+        samples++;
+        if (idx == nseg) {
+            if (running || !rgbw_eq(out, from))
+                FAIL("end at %u ms: running %d\n", t, running);
+            break;
+        }
+        if (!running) {
+            FAIL("stopped early at %u ms, segment %u of %u\n", t, idx, nseg);
+            break;
+        }
+
+        const pwm_tl_seg_t *s = &seg[idx];
+        uint32_t ts = t - seg_t0;
+        for (int c = 0; c < 4; c++) {
+            uint16_t a = ch(&from, c), v = ch(&out, c), p = ch(&prev, c);
+            uint16_t b = (s->ease == PWM_EASE_HOLD) ? a : ch(&s->to, c);
+            bool rising = b >= a;
+            double ref = a + (b - a) * ref_curve((pwm_ease_t)s->ease, (double)ts / s->dur_ms, rising);
+            double err = fabs(v - ref);
+
+            if (ts == 0 && v != a)
+                FAIL("segment %u (%s) starts at %u, previous target %u\n",
+                     idx, pwm_ease_name((pwm_ease_t)s->ease), v, a);
+            if (rising ? (v < p || v > b) : (v > p || v < b))
+                FAIL("segment %u (%s) ch %d not monotonic: %u after %u, %u -> %u\n",
+                     idx, pwm_ease_name((pwm_ease_t)s->ease), c, v, p, a, b);
+            if (err > 1.0)
+                FAIL("segment %u (%s) ch %d at %u/%u ms: %u, float %.2f\n",
+                     idx, pwm_ease_name((pwm_ease_t)s->ease), c, ts, s->dur_ms, v, ref);
+            if (err > *max_err)
+                *max_err = err;
+        }
+        prev = out;
+    }
+    return samples;
+}
+
+/**
+ * A looping timeline repeats with its cycle length, also when polled
+ * every 37 ms instead of every 1 ms
+ */
+static void check_loop(prng_t *rng)
+{
+    pwm_timeline_t dense, sparse;
+    rgbw16_t start = random_rgbw(rng);
+    uint32_t cycle = 0;
+
+    pwm_tl_init(&dense);
+    for (int i = 0; i < 4; i++) {
+        uint32_t dur = 100 + prng_below(rng, 400);
+        pwm_tl_push(&dense, random_rgbw(rng), dur, (pwm_ease_t)(i % PWM_EASE_COUNT));
+        cycle += dur;
+    }
+    pwm_tl_push(&dense, start, 200, PWM_EASE_EXP);       // back to the start colour
+    cycle += 200;
+    dense.loop = true;
+    sparse = dense;
+    pwm_tl_start(&dense, start, 0);
+    pwm_tl_start(&sparse, start, 0);
+
+    static rgbw16_t first[5000];
+    for (uint32_t t = 0; t < 5 * cycle; t++) {
+        rgbw16_t a, b;
+
+        if (!pwm_tl_eval(&dense, t, &a))
+            FAIL("loop stopped at %u ms\n", t);
+        if (t < cycle && t < count_of(first))
+            first[t] = a;
+        else if (t % cycle < count_of(first) && !rgbw_eq(a, first[t % cycle]))
+            FAIL("loop cycle %u differs at %u ms\n", t / cycle, t % cycle);
+        if (t % 37 == 0) {
+            pwm_tl_eval(&sparse, t, &b);
+            if (!rgbw_eq(a, b))
+                FAIL("sparse poll differs at %u ms\n", t);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t timelines = 300;
+    uint64_t samples = 0;
+    double max_err = 0.0;
+    prng_t rng;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n': timelines = (uint32_t)atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n timelines]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    pwm_ease_init();
+    prng_seed(&rng, 2024, 2);
+
+    for (uint32_t i = 0; i < timelines; i++) {
+        // every 4th timeline crosses the 32-bit millisecond wrap
+        uint32_t t0 = (i % 4 == 0) ? 0xFFFFFFFFu - prng_below(&rng, 20000) : prng_below(&rng, 1u << 30);
+        samples += check_timeline(&rng, t0, &max_err);
+    }
+    for (int i = 0; i < 20; i++)
+        check_loop(&rng);
+
+    // cost of one evaluation, as on the poll path
+    pwm_timeline_t tl;
+    rgbw16_t out = { 0 };
+    uint64_t sink = 0, n = 0;
+    pwm_tl_init(&tl);
+    for (int i = 0; i < PWM_TL_MAX_SEGS; i++)
+        pwm_tl_push(&tl, random_rgbw(&rng), 1000, (pwm_ease_t)(i % PWM_EASE_HOLD));
+    tl.loop = true;
+    pwm_tl_start(&tl, out, 0);
+    uint64_t c0 = cpu_time_ns();
+    for (uint32_t t = 0; t < 4000000; t += 3, n++) {
+        pwm_tl_eval(&tl, t, &out);
+        sink += out.r + out.w;
+    }
+    uint64_t cost = cpu_time_ns() - c0;
+
+    printf("%u timelines, %llu samples at 1 kHz, max error %.2f LSB, %u failures\n",
+           timelines, (unsigned long long)samples, max_err, errors);
+    printf("pwm_tl_eval: %.1f ns per sample (checksum %llu)\n",
+           (double)cost / (double)n, (unsigned long long)(sink & 0xFFFF));
+    return errors ? 1 : 0;
+}
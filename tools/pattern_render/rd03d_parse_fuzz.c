@@ -0,0 +1,333 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Fuzz and benchmark of the kitchen_pwm/rd03d_drv.c streaming parser.
+ * Random streams of valid reports, noise, truncated frames, bad tails,
+ * runs of header bytes and reports with a header inside the payload are
+ * fed through the DMA ring in random chunk sizes, with the consumer now
+ * and then late so the frame queue fills up. The frames out must equal
+ * those of the rescanning parser it replaced (kept below as reference):
+ * same frames, same order, same decoded detections.
+ * Then the parse throughput of both, in bytes per microsecond of CPU
+ * time (the cost of filling the ring taken out).
+ *
+ *   rd03d_parse_fuzz [-n streams] [-s seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "pico/time.h"
+#include "config.h"
+#include "rd03d_drv.h"
+#include "prng.h"
+
+#define STREAM_MAX      2048
+#define FRAME_LEN       30
+#define OUT_MAX         (STREAM_MAX / FRAME_LEN + 1)
+#define REF_RING        4096        // power of two, holds a whole stream
+#define BENCH_STREAMS   4000
+
+static uint32_t errors;
+
+#define FAIL(...) do { if (errors++ < 10) printf(__VA_ARGS__); } while (0)
+
+static uint64_t cpu_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+absolute_time_t get_absolute_time(void) { return 0; }
+uint32_t to_ms_since_boot(absolute_time_t t) { return (uint32_t)t; }
+bool rd03d_host_uart_getc(uint8_t *b) { (void)b; return false; }
+
+static int16_t signmag(uint16_t raw)
+{
+    return (raw & 0x8000u) ? (int16_t)(raw & 0x7FFFu) : (int16_t)-(int16_t)(raw & 0x7FFFu);
+}
+
+/* ---------- reference: the rescanning parser before the streaming one ---------- */
+typedef struct {
+    uint8_t  rx[REF_RING];
+    uint16_t head, tail;
+} ref_t;
+
+static uint16_t ref_count(const ref_t *r) { return (uint16_t)((r->head - r->tail) & (REF_RING - 1)); }
+static uint8_t  ref_peek(const ref_t *r, uint16_t i) { return r->rx[(r->tail + i) & (REF_RING - 1)]; }
+static void     ref_drop(ref_t *r, uint16_t n) { r->tail = (uint16_t)((r->tail + n) & (REF_RING - 1)); }
+
+static void ref_push(ref_t *r, uint8_t b)
+{
+    r->rx[r->head] = b;
+    r->head = (uint16_t)((r->head + 1) & (REF_RING - 1));
+}
+
+/* one frame per call, as try_parse_frames() + the api decode did */
+static bool ref_parse(ref_t *r, rd03d_frame_t *out)
+{
+    while (ref_count(r) >= FRAME_LEN) {
+        uint16_t count = ref_count(r);
+        uint16_t max_scan = (uint16_t)(count - FRAME_LEN + 1);
+        int found_at = -1;
+
+        for (uint16_t off = 0; off <= max_scan; off++) {
+            if (ref_peek(r, off) == 0xAA && ref_peek(r, off + 1) == 0xFF &&
+                ref_peek(r, off + 2) == 0x03 && ref_peek(r, off + 3) == 0x00) {
+                found_at = (int)off;
+                break;
+            }
+        }
+        if (found_at < 0) {
+            ref_drop(r, (uint16_t)(max_scan + 1));
+            return false;
+        }
+        if (found_at > 0)
+            ref_drop(r, (uint16_t)found_at);
+        if (ref_count(r) < FRAME_LEN)
+            return false;
+        if (ref_peek(r, FRAME_LEN - 2) != 0x55 || ref_peek(r, FRAME_LEN - 1) != 0xCC) {
+            ref_drop(r, 1);
+            continue;
+        }
+
+        uint8_t raw[FRAME_LEN];
+        rd03d_report_raw_t rep;
+        for (uint16_t i = 0; i < FRAME_LEN; i++)
+            raw[i] = ref_peek(r, i);
+        ref_drop(r, FRAME_LEN);
+        for (uint32_t i = 0; i < sizeof(rep); i++)
+            ((uint8_t *)&rep)[i] = raw[4 + i];
+
+        for (int i = 0; i < RD03D_OBJECT_SLOTS; i++) {
+            const rd03d_object_raw_t *o = &rep.obj[i];
+            out->det[i] = (rd03d_det_t){
+                .present = (o->x_raw || o->y_raw || o->v_raw || o->dist_mm),
+                .x_mm = signmag(o->x_raw), .y_mm = signmag(o->y_raw),
+                .v_cms = signmag(o->v_raw), .dist_mm = o->dist_mm,
+            };
+        }
+        out->rx_time_ms = 0;
+        return true;
+    }
+    return false;
+}
+
+/* ---------- stream generator ---------- */
+static const uint8_t hdr[4] = { 0xAA, 0xFF, 0x03, 0x00 };
+
+static uint32_t gen_stream(prng_t *rng, uint8_t *s, bool clean)
+{
+    uint32_t n = 0;
+
+    while (n + 64 < STREAM_MAX) {
+        uint32_t kind = clean ? 0 : prng_below(rng, 8);
+        uint8_t payload[FRAME_LEN - 6];
+
+        for (uint32_t i = 0; i < sizeof(payload); i++)
+            payload[i] = (uint8_t)prng_u32(rng);
+        if (kind == 6)
+            memset(payload, 0, sizeof(payload));        // three empty slots
+        if (kind == 5)
+            memcpy(&payload[prng_below(rng, sizeof(payload) - 3)], hdr, 4);
+
+        switch (kind) {
+            case 1:     // line noise
+                for (uint32_t i = 1 + prng_below(rng, 40); i; i--)
+                    s[n++] = (uint8_t)prng_u32(rng);
+                break;
+            case 2:     // truncated frame
+                memcpy(&s[n], hdr, 4);
+                n += 4;
+                for (uint32_t i = prng_below(rng, sizeof(payload)); i; i--)
+                    s[n++] = payload[i];
+                break;
+            case 4:     // header fragments
+                for (uint32_t i = 1 + prng_below(rng, 12); i; i--) {
+                    uint32_t k = 1 + prng_below(rng, 4);
+                    memcpy(&s[n], hdr, k);
+                    n += k;
+                }
+                break;
+            default:    // 0, 5, 6 valid; 3 with a bad tail; 7 tail only half right
+                memcpy(&s[n], hdr, 4);
+                memcpy(&s[n + 4], payload, sizeof(payload));
+                n += 4 + (uint32_t)sizeof(payload);
+                s[n++] = 0x55;
+                s[n++] = (kind == 3) ? (uint8_t)(0xCC ^ (1 + prng_below(rng, 255))) : 0xCC;
+                if (kind == 7)
+                    s[n - 2] = 0xAA;
+                break;
+        }
+    }
+    return n;
+}
+
+static bool frame_eq(const rd03d_frame_t *a, const rd03d_frame_t *b)
+{
+    for (int i = 0; i < RD03D_OBJECT_SLOTS; i++) {
+        const rd03d_det_t *x = &a->det[i], *y = &b->det[i];
+        if (x->present != y->present || x->x_mm != y->x_mm || x->y_mm != y->y_mm ||
+            x->v_cms != y->v_cms || x->dist_mm != y->dist_mm)
+            return false;
+    }
+    return true;
+}
+
+/* ---------- feeding ---------- */
+static rd03d_frame_t got[OUT_MAX + RD03D_FRAME_SLOTS];
+static rd03d_frame_t want[OUT_MAX];
+static ref_t ref;
+
+static uint32_t drv_run(prng_t *rng, const uint8_t *s, uint32_t n, uint32_t chunk_max, bool parse)
+{
+    uint32_t ngot = 0, late = 0;
+
+    rd03d_drv_host_mode(true);
+    rd03d_drv_init();
+
+    for (uint32_t i = 0; i < n; ) {
+        uint32_t c = rng ? 1 + prng_below(rng, chunk_max) : chunk_max;
+        if (c > n - i)
+            c = n - i;
+        for (uint32_t k = 0; k < c; k++)
+            rd03d_drv_host_dma_rx(s[i + k]);
+        i += c;
+        if (!parse)
+            continue;
+
+        rd03d_drv_poll();
+        // consumer late now and then, never more than two polls in a row
+        if (rng && late < 2 && prng_below(rng, 4) == 0) {
+            late++;
+        } else {
+            late = 0;
+            while (ngot < count_of(got) && rd03d_drv_get_frame(&got[ngot]))
+                ngot++;
+        }
+    }
+    for (int k = 0; parse && k < 4; k++) {
+        rd03d_drv_poll();
+        while (ngot < count_of(got) && rd03d_drv_get_frame(&got[ngot]))
+            ngot++;
+    }
+    return ngot;
+}
+
+static uint32_t ref_run(const uint8_t *s, uint32_t n, uint32_t chunk, bool parse)
+{
+    uint32_t nwant = 0;
+
+    ref.head = ref.tail = 0;
+    for (uint32_t i = 0; i < n; ) {
+        uint32_t c = (chunk > n - i) ? n - i : chunk;
+        for (uint32_t k = 0; k < c; k++)
+            ref_push(&ref, s[i + k]);
+        i += c;
+
+        while (parse && nwant < OUT_MAX && ref_parse(&ref, &want[nwant]))
+            nwant++;
+    }
+    return nwant;
+}
+
+/* CPU time of whole streams, less the same run without parsing (feeding the ring) */
+static uint64_t bench_ns(bool drv, bool parse, uint32_t chunk, uint32_t streams,
+                         uint8_t s[][STREAM_MAX], const uint32_t *n)
+{
+    uint64_t t0 = cpu_time_ns();
+
+    for (uint32_t i = 0; i < streams; i++) {
+        if (drv)
+            drv_run(NULL, s[i], n[i], chunk, parse);
+        else
+            ref_run(s[i], n[i], chunk, parse);
+    }
+    return cpu_time_ns() - t0;
+}
+
+static void bench(const char *name, prng_t *rng, bool clean, uint32_t chunk)
+{
+    static uint8_t s[BENCH_STREAMS][STREAM_MAX];
+    static uint32_t n[BENCH_STREAMS];
+    uint64_t bytes = 0;
+    double rate[2];
+
+    for (uint32_t i = 0; i < BENCH_STREAMS; i++) {
+        n[i] = gen_stream(rng, s[i], clean);
+        bytes += n[i];
+    }
+    for (int drv = 0; drv < 2; drv++) {
+        uint64_t feed = bench_ns(drv, false, chunk, BENCH_STREAMS, s, n);
+        uint64_t all = bench_ns(drv, true, chunk, BENCH_STREAMS, s, n);
+        rate[drv] = (double)bytes * 1000.0 / (double)(all > feed ? all - feed : 1);
+    }
+    printf("  %-6s %4u byte polls  streaming %6.1f bytes/us   rescanning %6.1f bytes/us\n",
+           name, chunk, rate[1], rate[0]);
+}
+
+int main(int argc, char **argv)
+{
+    static uint8_t s[STREAM_MAX];
+    uint32_t streams = 20000;
+    uint64_t seed = 37;
+    uint64_t frames = 0;
+    prng_t rng;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+            case 'n': streams = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 's': seed = strtoull(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-n streams] [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+    prng_seed(&rng, seed, 1);
+
+    for (uint32_t it = 0; it < streams; it++) {
+        uint32_t n = gen_stream(&rng, s, false);
+        uint32_t nwant = ref_run(s, n, n, true);
+        uint32_t ngot = drv_run(&rng, s, n, 64, true);
+        rd03d_drv_stats_t st = rd03d_drv_get_stats();
+
+        frames += nwant;
+        if (ngot != nwant) {
+            FAIL("stream %u: %u frames, reference %u\n", it, ngot, nwant);
+            continue;
+        }
+        for (uint32_t i = 0; i < ngot; i++) {
+            if (!frame_eq(&got[i], &want[i])) {
+                FAIL("stream %u: frame %u differs from the reference\n", it, i);
+                break;
+            }
+        }
+        if (st.overrun_bytes)
+            FAIL("stream %u: %u bytes overrun\n", it, st.overrun_bytes);
+        if (st.frames != ngot)
+            FAIL("stream %u: %u frames counted, %u fetched\n", it, st.frames, ngot);
+    }
+    printf("%u streams, %llu frames compared with the reference parser\n",
+           streams, (unsigned long long)frames);
+
+    // 25 bytes is one 1 ms "rd03d" task period at 256000 baud
+    bench("clean", &rng, true, 25);
+    bench("noisy", &rng, false, 25);
+    bench("clean", &rng, true, 256);
+    bench("noisy", &rng, false, 256);
+
+    printf("%s: %u errors\n", errors ? "FAIL" : "OK", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,270 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Host model of the kitchen_pwm/rd03d_drv.c receive paths. The RD-03D
+ * byte stream (30 byte reports at 10 Hz, 256000 baud, with some line
+ * noise) goes either through a 32 byte UART FIFO model drained by
+ * rd03d_drv_poll(), or straight into the DMA ring. The main loop polls
+ * every millisecond with stalls of up to -d ms injected (an EFU sector
+ * erase, a long CLI command). For each stall length the frame loss of
+ * both paths is reported, and
+ *  - every frame delivered must be byte exact and in order
+ *  - the DMA path must not lose frames while a stall fits in the ring
+ *  - the parser must see each byte about once (bytes parsed per frame)
+ *
+ *   rd03d_rx_sim [-t seconds] [-p stall_permille] [-d max_stall_ms]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "pico/time.h"
+#include "config.h"
+#include "rd03d_drv.h"
+#include "prng.h"
+
+#define FRAME_PERIOD_US     100000u
+#define BYTE_US             (10.0 * 1e6 / RD03D_BAUDRATE)
+#define FRAME_LEN           30
+#define FIFO_DEPTH          32
+#define POLL_US             1000u       // "rd03d" task period in main.c
+#define SENT_KEEP           1024
+#define GAP_WINDOW          4           // polls to drain a full ring, RD03D_FRAME_SLOTS frames per poll
+
+static uint32_t errors;
+
+#define FAIL(...) do { if (errors++ < 10) printf(__VA_ARGS__); } while (0)
+
+/* ---------- simulated clock, pico/time.h for rd03d_drv.c ---------- */
+static uint64_t sim_us;
+
+absolute_time_t get_absolute_time(void) { return sim_us; }
+uint32_t to_ms_since_boot(absolute_time_t t) { return (uint32_t)(t / 1000u); }
+
+/* ---------- UART FIFO model ---------- */
+static uint8_t  fifo[FIFO_DEPTH];
+static uint32_t fifo_wr, fifo_rd, fifo_lost;
+
+bool rd03d_host_uart_getc(uint8_t *b)
+{
+    if (fifo_rd == fifo_wr)
+        return false;
+    *b = fifo[fifo_rd++ % FIFO_DEPTH];
+    return true;
+}
+
+/* ---------- radar byte stream ---------- */
+typedef struct {
+    prng_t   rng;
+    uint8_t  buf[FRAME_LEN + 8];
+    int      len, pos;
+    uint32_t seq;               // frames started
+    double   next_us;           // arrival time of buf[pos]
+} radar_t;
+
+static rd03d_report_raw_t sent[SENT_KEEP];
+
+/* reference decoding, sign + magnitude with MSB set = positive */
+static int16_t signmag(uint16_t raw)
+{
+    return (raw & 0x8000u) ? (int16_t)(raw & 0x7FFFu) : (int16_t)-(int16_t)(raw & 0x7FFFu);
+}
+
+static bool frame_matches(const rd03d_frame_t *f, const rd03d_report_raw_t *rep)
+{
+    for (int i = 0; i < RD03D_OBJECT_SLOTS; i++) {
+        const rd03d_object_raw_t *o = &rep->obj[i];
+        const rd03d_det_t *d = &f->det[i];
+
+        if (d->present != (o->x_raw || o->y_raw || o->v_raw || o->dist_mm) ||
+            d->x_mm != signmag(o->x_raw) || d->y_mm != signmag(o->y_raw) ||
+            d->v_cms != signmag(o->v_raw) || d->dist_mm != o->dist_mm)
+            return false;
+    }
+    return true;
+}
+
+static void radar_frame(radar_t *r)
+{
+    rd03d_report_raw_t rep;
+    uint8_t *p = (uint8_t *)&rep;
+    int noise = (prng_below(&r->rng, 10) == 0) ? 1 + (int)prng_below(&r->rng, 5) : 0;
+
+    for (uint32_t i = 0; i < sizeof(rep); i++)
+        p[i] = (uint8_t)prng_u32(&r->rng);
+    rep.obj[0].dist_mm = (uint16_t)r->seq;      // sequence number for the checker
+    sent[r->seq % SENT_KEEP] = rep;
+
+    r->len = 0;
+    for (int i = 0; i < noise; i++)
+        r->buf[r->len++] = (uint8_t)prng_u32(&r->rng);
+    r->buf[r->len++] = 0xAA;
+    r->buf[r->len++] = 0xFF;
+    r->buf[r->len++] = 0x03;
+    r->buf[r->len++] = 0x00;
+    memcpy(&r->buf[r->len], &rep, sizeof(rep));
+    r->len += (int)sizeof(rep);
+    r->buf[r->len++] = 0x55;
+    r->buf[r->len++] = 0xCC;
+
+    r->pos = 0;
+    r->next_us = (double)r->seq * FRAME_PERIOD_US + prng_below(&r->rng, 2000);
+    r->seq++;
+}
+
+/* bytes that arrived up to 'now' into the FIFO or the DMA ring */
+static void radar_deliver(radar_t *r, uint64_t now, uint64_t end_us, bool dma)
+{
+    while (r->next_us <= (double)now) {
+        uint8_t b = r->buf[r->pos++];
+
+        if (dma) {
+            rd03d_drv_host_dma_rx(b);
+        } else if (fifo_wr - fifo_rd < FIFO_DEPTH) {
+            fifo[fifo_wr++ % FIFO_DEPTH] = b;
+        } else {
+            fifo_lost++;
+        }
+
+        r->next_us += BYTE_US;
+        if (r->pos == r->len) {
+            if ((uint64_t)r->seq * FRAME_PERIOD_US >= end_us) {
+                r->next_us = 1e300;
+                return;
+            }
+            radar_frame(r);
+        }
+    }
+}
+
+/* ---------- one run ---------- */
+typedef struct {
+    uint32_t sent, received, corrupt;
+    uint32_t polls;
+    uint32_t max_gap_ms;        // longest time over GAP_WINDOW polls
+    rd03d_drv_stats_t drv;
+} run_t;
+
+static run_t run(bool dma, uint32_t seconds, uint32_t stall_permille, uint32_t max_stall_ms)
+{
+    radar_t r;
+    prng_t loop;
+    run_t res;
+    uint64_t end_us = (uint64_t)seconds * 1000000u;
+    int32_t last_seq = -1;
+    uint32_t gaps[GAP_WINDOW] = { 0 }, window_ms = 0;
+
+    memset(&res, 0, sizeof(res));
+    memset(&r, 0, sizeof(r));
+    prng_seed(&r.rng, 36, 1);
+    prng_seed(&loop, 36, 2 + max_stall_ms);     // same radar stream for both paths
+    fifo_wr = fifo_rd = fifo_lost = 0;
+    sim_us = 0;
+
+    rd03d_drv_host_mode(dma);
+    rd03d_drv_init();
+    radar_frame(&r);
+
+    // keep polling 2 s after the last frame so the ring drains
+    while (sim_us < end_us + 2000000u) {
+        radar_deliver(&r, sim_us, end_us, dma);
+
+        rd03d_drv_poll();
+        rd03d_frame_t f;
+        res.polls++;
+
+        while (rd03d_drv_get_frame(&f)) {           // as rd03d_api_poll()
+            uint16_t seq16 = f.det[0].dist_mm;
+            // unwrap the 16 bit sequence against the last one seen
+            int32_t seq = last_seq + 1 + (int32_t)(uint16_t)(seq16 - (uint16_t)(last_seq + 1));
+
+            if (seq <= last_seq || seq >= (int32_t)r.seq ||
+                !frame_matches(&f, &sent[(uint32_t)seq % SENT_KEEP])) {
+                res.corrupt++;
+            } else {
+                res.received++;
+                last_seq = seq;
+            }
+        }
+
+        uint32_t gap_ms = POLL_US / 1000u;
+        if (stall_permille && prng_below(&loop, 1000) < stall_permille)
+            gap_ms += 1u + prng_below(&loop, max_stall_ms);
+        // a backlog drains a few frames per poll, so stalls close together add up
+        window_ms += gap_ms - gaps[res.polls % GAP_WINDOW];
+        gaps[res.polls % GAP_WINDOW] = gap_ms;
+        if (window_ms > res.max_gap_ms)
+            res.max_gap_ms = window_ms;
+        sim_us += 1000u * gap_ms;
+    }
+
+    res.sent = r.seq;
+    res.drv = rd03d_drv_get_stats();
+    return res;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t seconds = 600;
+    uint32_t stall_permille = 5;        // one stall per 200 polls
+    uint32_t max_stall = 1000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:p:d:")) != -1) {
+        switch (opt) {
+            case 't': seconds = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'p': stall_permille = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'd': max_stall = (uint32_t)strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-t seconds] [-p stall_permille] [-d max_stall_ms]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    // the DMA ring must hold every frame that arrives during a stall
+    uint32_t ring_ms = (uint32_t)((RD03D_RX_RING_SIZE - 2 * FRAME_LEN) / (FRAME_LEN + 1)) * 100u;
+
+    printf("%u s of RD-03D reports, %u byte ring (DMA holds ~%u ms), stalls %u/1000 polls\n",
+           seconds, RD03D_RX_RING_SIZE, ring_ms, stall_permille);
+    printf("  max stall |  FIFO lost  bytes/frame |   DMA lost  bytes/frame\n");
+
+    static const uint32_t stalls[] = { 0, 2, 5, 20, 100, 500, 1000, 2000, 5000 };
+    for (uint32_t i = 0; i < count_of(stalls); i++) {
+        uint32_t d = stalls[i];
+        if (d > max_stall)
+            break;
+
+        run_t fifo_run = run(false, seconds, d ? stall_permille : 0, d);
+        run_t dma_run  = run(true,  seconds, d ? stall_permille : 0, d);
+
+        printf("  %6u ms |  %6.2f %%  %10.2f  |  %6.2f %%  %10.2f\n", d,
+               100.0 * (fifo_run.sent - fifo_run.received) / fifo_run.sent,
+               (double)fifo_run.drv.parsed_bytes / (fifo_run.drv.frames ? fifo_run.drv.frames : 1),
+               100.0 * (dma_run.sent - dma_run.received) / dma_run.sent,
+               (double)dma_run.drv.parsed_bytes / (dma_run.drv.frames ? dma_run.drv.frames : 1));
+
+        if (fifo_run.corrupt || dma_run.corrupt)
+            FAIL("stall %u ms: %u / %u corrupt frames (FIFO / DMA)\n", d, fifo_run.corrupt, dma_run.corrupt);
+        if (dma_run.max_gap_ms < ring_ms && dma_run.received != dma_run.sent)
+            FAIL("stall %u ms: DMA lost %u frames, at most %u ms in %u polls\n", d,
+                 dma_run.sent - dma_run.received, dma_run.max_gap_ms, GAP_WINDOW);
+        if (!dma_run.drv.dma || fifo_run.drv.dma)
+            FAIL("receive path not selected\n");
+        // 30 bytes per frame and a little line noise, no rescans of the ring
+        if (dma_run.drv.parsed_bytes > dma_run.drv.frames * (FRAME_LEN + 2u))
+            FAIL("stall %u ms: DMA path parsed %u bytes for %u frames\n", d,
+                 dma_run.drv.parsed_bytes, dma_run.drv.frames);
+    }
+
+    printf("%s: %u errors\n", errors ? "FAIL" : "OK", errors);
+    return errors ? 1 : 0;
+}
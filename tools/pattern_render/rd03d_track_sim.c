@@ -0,0 +1,386 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Host simulation of the kitchen_pwm/rd03d_api.c tracker on crossing
+ * targets. Every run has two or three people walking straight lines that
+ * cross near one spot; the radar reports them at 10 Hz with position
+ * noise, radial speed noise, missed detections and the slots in random
+ * order (the RD-03D keeps no IDs). The same frames go through
+ *  - rd03d_api.c, the alpha-beta tracker with optimal 3x3 association
+ *  - the greedy nearest-neighbour tracker it replaced (copied below)
+ * and for both are reported: ID switches per crossing, position RMSE of
+ * the tracks against the truth (next to the raw detection error), the
+ * error of rd03d_api_predict() half way between frames against holding
+ * the last position, and the cost per update.
+ *
+ *   rd03d_track_sim [-n runs] [-N noise_mm] [-s seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "pico/time.h"
+#include "rd03d_drv.h"
+#include "rd03d_api.h"
+#include "prng.h"
+
+#define FRAME_MS        100         // RD-03D report rate
+#define RUN_MS          16000
+#define MATCH_MM        800         // a track this close to a target is following it
+#define WARMUP_FRAMES   5           // frames a target is seen before it is scored
+
+static uint32_t errors;
+
+#define FAIL(...) do { if (errors++ < 10) printf(__VA_ARGS__); } while (0)
+
+static uint64_t cpu_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t cycles(void)
+{
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+absolute_time_t get_absolute_time(void) { return 0; }
+uint32_t to_ms_since_boot(absolute_time_t t) { return (uint32_t)t; }
+
+/* ---------- fake rd03d_drv.c: one pending frame ---------- */
+static rd03d_frame_t pending;
+static bool          pending_valid;
+
+bool rd03d_drv_init(void) { return true; }
+void rd03d_drv_poll(void) { }
+
+bool rd03d_drv_get_frame(rd03d_frame_t *out)
+{
+    if (!pending_valid)
+        return false;
+    *out = pending;
+    pending_valid = false;
+    return true;
+}
+
+/* ---------- previous tracker: greedy nearest neighbour, raw positions ---------- */
+static rd03d_track_t g_track[RD03D_TRACKS];
+static uint8_t g_next_id;
+
+static void greedy_update(const rd03d_det_t det[RD03D_OBJECT_SLOTS], uint32_t t_ms)
+{
+    const uint32_t max_d2 = 600u * 600u;
+    bool used[RD03D_OBJECT_SLOTS] = { false, false, false };
+
+    for (int ti = 0; ti < RD03D_TRACKS; ti++) {
+        rd03d_track_t *tr = &g_track[ti];
+        int best = -1;
+        uint32_t best_d2 = UINT32_MAX;
+
+        for (int di = 0; tr->confidence && di < RD03D_OBJECT_SLOTS; di++) {
+            int32_t dx = det[di].x_mm - tr->x_mm, dy = det[di].y_mm - tr->y_mm;
+            uint32_t d2 = (uint32_t)(dx * dx + dy * dy);
+            if (det[di].present && !used[di] && d2 <= max_d2 && d2 < best_d2) {
+                best_d2 = d2;
+                best = di;
+            }
+        }
+        if (best >= 0) {
+            used[best] = true;
+            tr->x_mm = det[best].x_mm;
+            tr->y_mm = det[best].y_mm;
+            tr->last_seen_ms = t_ms;
+            tr->confidence = (uint8_t)((tr->confidence + 35 > 255) ? 255 : tr->confidence + 35);
+        } else {
+            tr->confidence = (uint8_t)((tr->confidence > 15) ? tr->confidence - 15 : 0);
+            if (t_ms - tr->last_seen_ms > 1500)
+                tr->confidence = 0;
+        }
+        tr->valid = tr->confidence >= 60;
+    }
+    for (int di = 0; di < RD03D_OBJECT_SLOTS; di++) {
+        int best = -1;
+        uint8_t best_conf = 255;
+
+        if (!det[di].present || used[di])
+            continue;
+        for (int ti = 0; ti < RD03D_TRACKS; ti++) {
+            if (g_track[ti].confidence < best_conf) {
+                best_conf = g_track[ti].confidence;
+                best = ti;
+            }
+        }
+        if (best >= 0) {
+            rd03d_track_t *tr = &g_track[best];
+            if (tr->confidence == 0 && ++g_next_id == 0)
+                g_next_id = 1;
+            if (tr->confidence == 0)
+                tr->id = g_next_id;
+            tr->x_mm = det[di].x_mm;
+            tr->y_mm = det[di].y_mm;
+            tr->last_seen_ms = t_ms;
+            tr->confidence = (uint8_t)((tr->confidence + 35 > 255) ? 255 : tr->confidence + 35);
+            tr->valid = tr->confidence >= 60;
+            used[di] = true;
+        }
+    }
+}
+
+/* ---------- people ---------- */
+typedef struct {
+    double x0, y0, vx, vy;      // position at t = 0 (mm), velocity (mm/s)
+} walker_t;
+
+static double gauss(prng_t *rng)
+{
+    double u = ((double)prng_u32(rng) + 1.0) / 4294967297.0;
+    double v = (double)prng_u32(rng) / 4294967296.0;
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+static double urand(prng_t *rng, double lo, double hi)
+{
+    return lo + (hi - lo) * (double)prng_u32(rng) / 4294967296.0;
+}
+
+static void walker_at(const walker_t *w, double t_s, double *x, double *y)
+{
+    *x = w->x0 + w->vx * t_s;
+    *y = w->y0 + w->vy * t_s;
+}
+
+/* inside the radar's field of view: 0.3 .. 7 m, +-60 degrees */
+static bool in_view(double x, double y)
+{
+    double r = sqrt(x * x + y * y);
+    return y > 300.0 && r < 7000.0 && fabs(x) < y * 1.732;
+}
+
+/* ---------- scoring ---------- */
+typedef struct {
+    uint64_t frames, crossings;
+    uint32_t id_switches;
+    double   se, se_raw, se_pred, se_hold;
+    uint64_t n, n_raw, n_pred;
+} score_t;
+
+/* which track follows each walker (CLEAR MOT): the one it had while that
+ * stays within MATCH_MM, else the nearest free one; a new one is a switch */
+static void score_frame(score_t *sc, const rd03d_track_t *tr, const walker_t *w, int nw,
+                        double t_s, const bool *scored, uint8_t *last_id)
+{
+    bool taken[RD03D_TRACKS] = { false, false, false };
+    int  follow[3] = { -1, -1, -1 };
+    double wx[3], wy[3];
+
+    for (int wi = 0; wi < nw; wi++) {
+        walker_at(&w[wi], t_s, &wx[wi], &wy[wi]);
+        for (int ti = 0; scored[wi] && last_id[wi] && ti < RD03D_TRACKS; ti++) {
+            if (tr[ti].valid && tr[ti].id == last_id[wi] && !taken[ti] &&
+                hypot(tr[ti].x_mm - wx[wi], tr[ti].y_mm - wy[wi]) < MATCH_MM) {
+                taken[ti] = true;
+                follow[wi] = ti;
+            }
+        }
+    }
+
+    for (int wi = 0; wi < nw; wi++) {
+        int best = follow[wi];
+        double best_d = MATCH_MM;
+
+        if (!scored[wi])
+            continue;
+        for (int ti = 0; follow[wi] < 0 && ti < RD03D_TRACKS; ti++) {
+            double d = hypot(tr[ti].x_mm - wx[wi], tr[ti].y_mm - wy[wi]);
+            if (tr[ti].valid && !taken[ti] && d < best_d) {
+                best_d = d;
+                best = ti;
+            }
+        }
+        if (best < 0)
+            continue;
+
+        int ti = best;
+        double d = hypot(tr[ti].x_mm - wx[wi], tr[ti].y_mm - wy[wi]);
+        taken[ti] = true;
+        sc->se += d * d;
+        sc->n++;
+        if (last_id[wi] && last_id[wi] != tr[ti].id)
+            sc->id_switches++;
+        last_id[wi] = tr[ti].id;
+    }
+}
+
+static void run(prng_t *rng, double noise_mm, score_t *kf, score_t *gr, uint64_t *ns, uint64_t *cyc)
+{
+    walker_t w[3];
+    int nw = 2 + (int)prng_below(rng, 2);
+    double cx = urand(rng, -1200.0, 1200.0), cy = urand(rng, 2000.0, 4000.0);
+    double tc = RUN_MS / 2000.0;
+    uint32_t seen[3] = { 0, 0, 0 };
+    uint8_t id_kf[3] = { 0, 0, 0 }, id_gr[3] = { 0, 0, 0 };
+
+    // all walkers pass the crossing spot within +-0.4 s, from different directions
+    double a0 = urand(rng, 0.0, 2.0 * M_PI);
+    for (int i = 0; i < nw; i++) {
+        double a = a0 + (2.0 * M_PI / nw) * i + urand(rng, -0.4, 0.4);
+        double v = urand(rng, 500.0, 1400.0);
+        double t = tc + urand(rng, -0.4, 0.4);
+        w[i].vx = v * cos(a);
+        w[i].vy = v * sin(a);
+        w[i].x0 = cx - w[i].vx * t;
+        w[i].y0 = cy - w[i].vy * t;
+    }
+
+    rd03d_api_init(NULL);
+    memset(g_track, 0, sizeof(g_track));
+    kf->crossings++;
+    gr->crossings++;
+
+    for (uint32_t t_ms = FRAME_MS; t_ms <= RUN_MS; t_ms += FRAME_MS) {
+        double t_s = t_ms / 1000.0;
+        bool scored[3] = { false, false, false };
+        int slot[3] = { 0, 1, 2 };
+
+        // the RD-03D lists its targets in no stable order
+        for (int i = 2; i > 0; i--) {
+            int j = (int)prng_below(rng, (uint32_t)i + 1);
+            int k = slot[i]; slot[i] = slot[j]; slot[j] = k;
+        }
+        memset(&pending, 0, sizeof(pending));
+        pending.rx_time_ms = t_ms;
+        for (int i = 0; i < nw; i++) {
+            double x, y;
+            walker_at(&w[i], t_s, &x, &y);
+            if (!in_view(x, y) || prng_below(rng, 100) < 5)
+                continue;
+            double r = sqrt(x * x + y * y);
+            double vr = (x * w[i].vx + y * w[i].vy) / r;    // + = moving away
+            rd03d_det_t *d = &pending.det[slot[i]];
+            d->present = true;
+            d->x_mm = (int16_t)lround(x + noise_mm * gauss(rng));
+            d->y_mm = (int16_t)lround(y + noise_mm * gauss(rng));
+            d->v_cms = (int16_t)lround(vr / 10.0 + 5.0 * gauss(rng));
+            d->dist_mm = (uint16_t)lround(hypot(d->x_mm, d->y_mm));
+            kf->se_raw += (d->x_mm - x) * (d->x_mm - x) + (d->y_mm - y) * (d->y_mm - y);
+            kf->n_raw++;
+            scored[i] = ++seen[i] > WARMUP_FRAMES;
+        }
+        pending_valid = true;
+
+        uint64_t t0 = cpu_time_ns(), c0 = cycles();
+        rd03d_api_poll();
+        *cyc += cycles() - c0;
+        *ns += cpu_time_ns() - t0;
+        greedy_update(pending.det, t_ms);
+
+        rd03d_state_t st;
+        rd03d_api_get_state(&st);
+        score_frame(kf, st.track, w, nw, t_s, scored, id_kf);
+        score_frame(gr, g_track, w, nw, t_s, scored, id_gr);
+        kf->frames++;
+        gr->frames++;
+
+        // half way to the next frame: prediction against the last position
+        rd03d_state_t pr;
+        rd03d_api_predict(t_ms + FRAME_MS / 2, &pr);
+        for (int wi = 0; wi < nw; wi++) {
+            double x, y, best_d = MATCH_MM;
+            int best = -1;
+            if (!scored[wi])
+                continue;
+            walker_at(&w[wi], t_s + FRAME_MS / 2000.0, &x, &y);
+            for (int ti = 0; ti < RD03D_TRACKS; ti++) {
+                double d = hypot(st.track[ti].x_mm - x, st.track[ti].y_mm - y);
+                if (st.track[ti].valid && st.track[ti].id == id_kf[wi] && d < best_d) {
+                    best_d = d;
+                    best = ti;
+                }
+            }
+            if (best < 0)
+                continue;
+            kf->se_hold += best_d * best_d;
+            kf->se_pred += pow(hypot(pr.track[best].x_mm - x, pr.track[best].y_mm - y), 2.0);
+            kf->n_pred++;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t runs = 2000;
+    double noise_mm = 60.0;
+    uint64_t seed = 38;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:N:s:")) != -1) {
+        switch (opt) {
+            case 'n': runs = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'N': noise_mm = strtod(optarg, NULL); break;
+            case 's': seed = strtoull(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-n runs] [-N noise_mm] [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    prng_t rng;
+    score_t kf, gr;
+    uint64_t ns = 0, cyc = 0;
+
+    prng_seed(&rng, seed, 1);
+    memset(&kf, 0, sizeof(kf));
+    memset(&gr, 0, sizeof(gr));
+    for (uint32_t i = 0; i < runs; i++)
+        run(&rng, noise_mm, &kf, &gr, &ns, &cyc);
+
+    double rmse_raw = sqrt(kf.se_raw / (double)(kf.n_raw ? kf.n_raw : 1));
+    double rmse_kf = sqrt(kf.se / (double)(kf.n ? kf.n : 1));
+    double rmse_gr = sqrt(gr.se / (double)(gr.n ? gr.n : 1));
+    double rmse_pred = sqrt(kf.se_pred / (double)(kf.n_pred ? kf.n_pred : 1));
+    double rmse_hold = sqrt(kf.se_hold / (double)(kf.n_pred ? kf.n_pred : 1));
+    double sw_kf = (double)kf.id_switches / (double)kf.crossings;
+    double sw_gr = (double)gr.id_switches / (double)gr.crossings;
+
+    printf("%u crossings of 2-3 walkers, %.0f mm detection noise, %llu frames\n",
+           runs, noise_mm, (unsigned long long)kf.frames);
+    printf("                      ID switches/crossing   RMSE mm   tracked\n");
+    printf("  alpha-beta + 3x3        %8.3f           %7.1f   %5.1f %%\n", sw_kf, rmse_kf,
+           100.0 * (double)kf.n / (double)(kf.n_raw ? kf.n_raw : 1));
+    printf("  greedy, raw positions   %8.3f           %7.1f   %5.1f %%\n", sw_gr, rmse_gr,
+           100.0 * (double)gr.n / (double)(kf.n_raw ? kf.n_raw : 1));
+    printf("  raw detections                             %7.1f\n", rmse_raw);
+    printf("  +%d ms between frames: predicted %.1f mm, last position %.1f mm\n",
+           FRAME_MS / 2, rmse_pred, rmse_hold);
+    printf("  cost: %.0f ns, %.0f cycles (host TSC) per update\n",
+           (double)ns / (double)kf.frames, (double)cyc / (double)kf.frames);
+
+    if (sw_kf > sw_gr)
+        FAIL("more ID switches than the greedy tracker\n");
+    if (rmse_kf >= rmse_raw || rmse_kf >= rmse_gr)
+        FAIL("filtered tracks no closer than the raw detections\n");
+    if (rmse_pred >= rmse_hold)
+        FAIL("prediction worse than the last position\n");
+
+    printf("%s: %u errors\n", errors ? "FAIL" : "OK", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,181 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Host backend for common/utils/sched.c on a simulated clock.
+ * The main loop tasks of stairs/tree are replaced by their measured costs,
+ * CLI and EFU generate load, and the LED output task (ws2815_loop, 2 ms)
+ * is checked against its deadline - once under the old tmr_ms_tick
+ * superloop and once under the scheduler.
+ *
+ *   sched_sim [-t seconds] [-e efu_chunk_us] [-c cli_cmd_us] [-v]
+ *
+ * Exits with 1 when the scheduler lets the LED task miss a deadline.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "sched.h"
+
+#define LED_PERIOD_US       2000
+#define LED_COST_US         350     // transpose + DMA kick-off, stairs
+#define PATT_PERIOD_US      20000
+#define PATT_COST_US        1200
+#define DDP_FRAME_US        25000   // 40 fps DDP stream
+#define DDP_FRAME_COST_US   600
+#define POLL_COST_US        20      // idle socket poll
+#define CLI_CMD_PERIOD_US   100000
+
+static uint32_t sim_clock;
+static uint32_t efu_chunk_us = 1000;    // flash_range_program of one TCP segment
+static uint32_t cli_cmd_us = 800;       // e.g. "part" or "config show"
+static uint32_t next_ddp, next_cli;
+
+// LED deadline check shared by both loops
+static uint32_t led_release, led_runs, led_misses, led_late_max;
+
+uint32_t sched_now_us(void) {
+    return sim_clock;
+}
+
+void sched_idle_until(uint32_t time_us) {
+    if ((int32_t)(time_us - sim_clock) > 0)
+        sim_clock = time_us;
+}
+
+static void busy(uint32_t us) {
+    sim_clock += us;
+}
+
+// ---------------- simulated main loop work ----------------
+static void cli_service(void) {
+    if ((int32_t)(sim_clock - next_cli) >= 0) {
+        next_cli += CLI_CMD_PERIOD_US;
+        busy(cli_cmd_us);
+    } else {
+        busy(POLL_COST_US);
+    }
+}
+
+static void efu_poll(void) {
+    busy(efu_chunk_us ? efu_chunk_us : POLL_COST_US);     // upload in progress
+}
+
+static void ddp_poll(void) {
+    if ((int32_t)(sim_clock - next_ddp) >= 0) {
+        next_ddp += DDP_FRAME_US;
+        busy(DDP_FRAME_COST_US);
+    } else {
+        busy(POLL_COST_US);
+    }
+}
+
+static void pattern_loop(void) {
+    busy(PATT_COST_US);
+}
+
+static void led_loop(void) {
+    uint32_t late = sim_clock - led_release;
+
+    busy(LED_COST_US);
+    if ((int32_t)(sim_clock - (led_release + LED_PERIOD_US)) > 0)
+        led_misses++;
+    if (late > led_late_max)
+        led_late_max = late;
+    led_runs++;
+    led_release += LED_PERIOD_US;
+}
+
+static void reset_load(void) {
+    sim_clock = 0;
+    next_ddp = next_cli = 0;
+    led_release = led_runs = led_misses = led_late_max = 0;
+}
+
+/**
+ * main.c before the scheduler: every pass polls all services, then
+ * run_periodically_ws2815_tasks() compares tmr_ms_tick with 2/20 ms.
+ */
+static void run_superloop(uint32_t duration_us) {
+    uint32_t last_tmr_loop = 0, last_tmr_patt = 0;
+
+    reset_load();
+    while (sim_clock < duration_us) {
+        cli_service();
+        efu_poll();
+        ddp_poll();
+
+        uint32_t tmr_ms_tick = sim_clock / 1000u;
+        if (tmr_ms_tick - last_tmr_patt >= PATT_PERIOD_US / 1000) {
+            last_tmr_patt += PATT_PERIOD_US / 1000;
+            pattern_loop();
+        }
+        if (tmr_ms_tick - last_tmr_loop >= LED_PERIOD_US / 1000) {
+            last_tmr_loop += LED_PERIOD_US / 1000;
+            led_release = last_tmr_loop * 1000u;
+            led_loop();
+        }
+    }
+}
+
+static void run_scheduler(uint32_t duration_us, bool verbose) {
+    reset_load();
+    led_release = 0;
+    // same registration as the firmware main.c
+    sched_add("ws2815", led_loop, LED_PERIOD_US, 0, 400, 0);
+    sched_add("pattern", pattern_loop, PATT_PERIOD_US, 0, 1500, 1);
+    sched_add("ddp", ddp_poll, 2000, 0, 700, 2);
+    sched_add("cli", cli_service, 5000, 0, 1000, 3);
+    sched_add("efu", efu_poll, 2000, 0, 1200, 4);
+    sched_start();
+
+    while (sim_clock < duration_us)
+        sched_run_once();
+
+    if (verbose) {
+        char msg[1024];
+        sched_show(msg, sizeof(msg));
+        fputs(msg, stdout);
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t seconds = 10;
+    bool verbose = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:e:c:v")) != -1) {
+        switch (opt) {
+        case 't': seconds = (uint32_t)atoi(optarg); break;
+        case 'e': efu_chunk_us = (uint32_t)atoi(optarg); break;
+        case 'c': cli_cmd_us = (uint32_t)atoi(optarg); break;
+        case 'v': verbose = true; break;
+        default:
+            fprintf(stderr, "usage: %s [-t seconds] [-e efu_chunk_us] [-c cli_cmd_us] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!seconds || seconds > 3000)
+        seconds = 10;
+
+    printf("load: EFU %u us per poll, CLI command %u us every %u ms, DDP frame %u us every %u ms\n",
+           efu_chunk_us, cli_cmd_us, CLI_CMD_PERIOD_US / 1000, DDP_FRAME_COST_US, DDP_FRAME_US / 1000);
+
+    run_superloop(seconds * 1000000u);
+    printf("superloop: ws2815 %6u runs, %5u deadline misses, worst start %4u us after release\n",
+           led_runs, led_misses, led_late_max);
+
+    run_scheduler(seconds * 1000000u, verbose);
+    printf("scheduler: ws2815 %6u runs, %5u deadline misses, worst start %4u us after release\n",
+           led_runs, led_misses, led_late_max);
+
+    return led_misses ? 1 : 0;
+}
@@ -0,0 +1,22 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/* Host stub: declarations only, a host tool that drives the bus defines them. */
+#pragma once
+
+#include "pico/stdio.h"
+
+#define PICO_ERROR_GENERIC  (-1)
+#define PICO_ERROR_TIMEOUT  (-2)
+
+typedef struct i2c_inst i2c_inst_t;
+
+extern i2c_inst_t i2c1_inst;
+#define i2c1 (&i2c1_inst)
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop);
@@ -0,0 +1,10 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/* Host stub: nothing from this header is used by the pattern code. */
+#pragma once
+
+#include "pico/stdio.h"
@@ -0,0 +1,12 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/* Host stub: only the instance type is needed by the host-built sources. */
+#pragma once
+
+#include "pico/stdio.h"
+
+typedef struct spi_inst spi_inst_t;
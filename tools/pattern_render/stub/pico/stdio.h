@@ -0,0 +1,26 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Host stub of the pico SDK headers pulled in by led_pattern.c.
+ * Provides the SDK basic types and macros the pattern code relies on;
+ * printf chatter from the patterns is silenced so it does not skew timing.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef unsigned int uint;
+
+#ifndef count_of
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+#endif
+
+#ifndef RENDER_KEEP_PRINTF
+#define printf(...) ((void)0)
+#endif
@@ -0,0 +1,10 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/* Host stub: only the basic types are needed by the host-built sources. */
+#pragma once
+
+#include "pico/stdio.h"
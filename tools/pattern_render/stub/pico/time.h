@@ -0,0 +1,19 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/* Host stub: only the basic types are needed by the host-built sources. */
+#pragma once
+
+#include "pico/stdio.h"
+
+/* declared for sources that read the clock, a host tool that calls them defines them */
+typedef uint64_t absolute_time_t;
+absolute_time_t get_absolute_time(void);
+uint32_t to_ms_since_boot(absolute_time_t t);
+uint64_t time_us_64(void);
+void sleep_ms(uint32_t ms);
+void sleep_us(uint64_t us);
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to);
@@ -0,0 +1,10 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/* Host stub: config.h includes this only for the network types. */
+#pragma once
+
+#include <stdint.h>
@@ -0,0 +1,451 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Live telemetry (common/utils/telemetry.c) over a real UDP socket to a
+ * receiver on localhost, with a simulated clock.
+ *
+ *   telemetry_test [-v] [-n samples] [-r seed]
+ *   telemetry_test -d port [-n datagrams]     # stream to tools/telemetry/tlm_recv.py
+ *
+ * Checked:
+ *  - log2 buckets at their edges
+ *  - one datagram per period, none when off, the period clamped
+ *  - every datagram decoded by the receiver equals the counters and
+ *    histograms in RAM; metrics never written are left out
+ *  - the histogram max is per datagram, a skipped datagram (socket busy)
+ *    hands its max to the next one and is counted
+ *  - totals survive a lost datagram: the difference of the two around it
+ *  - every metric with every bucket fits one datagram
+ *  - cost of tlm_sample() and of one datagram
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "telemetry.h"
+#include "prng.h"
+
+static uint32_t errors;
+static bool verbose;
+static prng_t rng;
+
+#define FAIL(...) do { if (errors++ < 10) printf(__VA_ARGS__); } while (0)
+
+/* ---------- clock ---------- */
+static uint64_t now_us;
+static bool real_clock;
+
+static uint64_t host_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+uint64_t time_us_64(void)
+{
+    return real_clock ? host_us() : now_us;
+}
+
+/* ---------- UDP: sender and the localhost receiver ---------- */
+static int tx_fd = -1, rx_fd = -1;
+static struct sockaddr_in rx_addr;
+static bool tx_busy;                // the W6100 socket still sending
+static uint32_t sent;
+
+static bool udp_send(const uint8_t *buf, uint16_t len)
+{
+    if (tx_busy)
+        return false;
+    if (sendto(tx_fd, buf, len, 0, (struct sockaddr *)&rx_addr, sizeof(rx_addr)) != len) {
+        FAIL("sendto %u bytes failed\n", len);
+        return false;
+    }
+    sent++;
+    return true;
+}
+
+static void udp_open(uint16_t port)
+{
+    socklen_t alen = sizeof(rx_addr);
+    struct timeval tv = { .tv_sec = 1 };
+
+    memset(&rx_addr, 0, sizeof(rx_addr));
+    rx_addr.sin_family = AF_INET;
+    rx_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    rx_addr.sin_port = htons(port);
+    tx_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (port)
+        return;                     // -d: the receiver is tlm_recv.py
+
+    rx_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (rx_fd < 0 || bind(rx_fd, (struct sockaddr *)&rx_addr, sizeof(rx_addr)) < 0 ||
+        getsockname(rx_fd, (struct sockaddr *)&rx_addr, &alen) < 0) {
+        printf("FAIL: no localhost UDP socket\n");
+        exit(1);
+    }
+    setsockopt(rx_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+/* ---------- receiver side decoder, as tools/telemetry/tlm_recv.py ---------- */
+typedef struct {
+    uint32_t seq, uptime_ms;
+    uint16_t period_ms;
+    bool     has_c[TLM_COUNTERS], has_h[TLM_HISTS];
+    uint32_t c[TLM_COUNTERS];
+    uint32_t count[TLM_HISTS], sum[TLM_HISTS], max[TLM_HISTS];
+    uint32_t buckets[TLM_HISTS][TLM_BUCKETS];
+} dgram_t;
+
+static uint32_t get32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static bool decode(const uint8_t *p, size_t len, dgram_t *d)
+{
+    const uint8_t *end = p + len, *q = p + TLM_HEADER_SIZE;
+
+    memset(d, 0, sizeof(*d));
+    if (len < TLM_HEADER_SIZE || p[0] != 'T' || p[1] != 'M' || p[2] != TLM_VERSION)
+        return false;
+    d->seq = get32(p + 4);
+    d->uptime_ms = get32(p + 8);
+    d->period_ms = (uint16_t)(p[12] | p[13] << 8);
+    for (uint8_t i = 0; i < p[14]; i++, q += 5) {
+        if (q + 5 > end || q[0] >= TLM_COUNTERS)
+            return false;
+        d->has_c[q[0]] = true;
+        d->c[q[0]] = get32(q + 1);
+    }
+    for (uint8_t i = 0; i < p[15]; i++) {
+        if (q + 17 > end || q[0] >= TLM_HISTS)
+            return false;
+        uint8_t id = q[0];
+        uint32_t mask = get32(q + 13);
+
+        d->has_h[id] = true;
+        d->count[id] = get32(q + 1);
+        d->sum[id] = get32(q + 5);
+        d->max[id] = get32(q + 9);
+        q += 17;
+        for (uint8_t b = 0; b < TLM_BUCKETS; b++) {
+            if (!(mask >> b & 1u))
+                continue;
+            if (q + 4 > end)
+                return false;
+            d->buckets[id][b] = get32(q);
+            q += 4;
+        }
+    }
+    return q == end;
+}
+
+static bool receive(dgram_t *d)
+{
+    uint8_t buf[2048];
+    ssize_t n = recv(rx_fd, buf, sizeof(buf), 0);
+
+    if (n <= 0) {
+        FAIL("no datagram on localhost\n");
+        return false;
+    }
+    if (!decode(buf, (size_t)n, d)) {
+        FAIL("datagram of %zd bytes does not decode\n", n);
+        return false;
+    }
+    return true;
+}
+
+/* the datagram has what is in RAM, max of the window given */
+static void check_dgram(const dgram_t *d, const uint32_t *max, const char *what)
+{
+    for (int i = 0; i < TLM_COUNTERS; i++) {
+        uint32_t v = tlm_counter((tlm_counter_t)i);
+
+        if (d->has_c[i] != (v != 0) || d->c[i] != v)
+            FAIL("%s: counter %d %u, sent %u%s\n", what, i, v, d->c[i], d->has_c[i] ? "" : " (left out)");
+    }
+    for (int i = 0; i < TLM_HISTS; i++) {
+        const tlm_histo_t *h = tlm_histo((tlm_hist_t)i);
+
+        if (d->has_h[i] != (h->count != 0) || d->count[i] != h->count || d->sum[i] != h->sum)
+            FAIL("%s: histogram %d count %u sum %u, sent %u %u\n", what, i, h->count, h->sum,
+                 d->count[i], d->sum[i]);
+        if (max && d->max[i] != max[i])
+            FAIL("%s: histogram %d max %u, expected %u\n", what, i, d->max[i], max[i]);
+        if (memcmp(d->buckets[i], h->buckets, sizeof(h->buckets)))
+            FAIL("%s: histogram %d buckets differ\n", what, i);
+    }
+}
+
+/* ---------- tests ---------- */
+static void test_buckets(void)
+{
+    static const struct { uint32_t v; uint8_t b; } t[] = {
+        { 0, 0 }, { 1, 1 }, { 2, 2 }, { 3, 2 }, { 4, 3 }, { 1023, 10 }, { 1024, 11 },
+        { (1u << 22) - 1, 22 }, { 1u << 22, 23 }, { UINT32_MAX, 23 },
+    };
+
+    for (size_t i = 0; i < count_of(t); i++)
+        if (tlm_bucket(t[i].v) != t[i].b)
+            FAIL("bucket of %u: %u, expected %u\n", t[i].v, tlm_bucket(t[i].v), t[i].b);
+}
+
+/* datagrams sent while the clock runs for ms in 1 ms steps (the sched task runs every 10) */
+static uint32_t run_ms(uint32_t ms)
+{
+    uint32_t before = sent;
+
+    for (uint32_t i = 0; i < ms; i++) {
+        now_us += 1000;
+        tlm_service();
+    }
+    return sent - before;
+}
+
+static void drain(void)
+{
+    dgram_t d;
+
+    for (uint32_t n = sent; n; n--)
+        receive(&d);
+    sent = 0;
+}
+
+static void test_period(void)
+{
+    tlm_init(udp_send, 100);
+    if (run_ms(99) != 0 || run_ms(1) != 1)
+        FAIL("period 100 ms: not one datagram after 100 ms\n");
+    if (run_ms(1000) != 10)
+        FAIL("period 100 ms: not 10 datagrams a second\n");
+    tlm_set_period(0);
+    if (run_ms(10000) != 0)
+        FAIL("off: datagrams sent\n");
+    tlm_set_period(10);
+    if (tlm_get_period() != TLM_PERIOD_MIN_MS || run_ms(1000) != 1000 / TLM_PERIOD_MIN_MS)
+        FAIL("period 10 ms: not clamped to %u ms\n", TLM_PERIOD_MIN_MS);
+    drain();
+}
+
+static void test_content(uint32_t samples)
+{
+    uint32_t max[TLM_HISTS];
+    dgram_t d, prev = { 0 };
+
+    tlm_init(udp_send, 1000);
+    run_ms(1000);
+    if (!receive(&d) || d.has_c[TLM_DDP_PKTS] || d.has_h[TLM_DMA_US])
+        FAIL("empty datagram: metrics that were never written\n");
+    sent = 0;
+
+    for (int round = 0; round < 5; round++) {
+        memset(max, 0, sizeof(max));
+        for (uint32_t i = 0; i < samples; i++) {
+            tlm_hist_t h = (tlm_hist_t)prng_below(&rng, TLM_HISTS - 1);   // no frame gap in this window
+            uint32_t v = prng_below(&rng, 1u << prng_below(&rng, 24));
+
+            tlm_sample(h, v);
+            if (v > max[h])
+                max[h] = v;
+            tlm_count((tlm_counter_t)prng_below(&rng, TLM_COUNTERS - 1), 1 + prng_below(&rng, 1500));
+        }
+        if (run_ms(1000) != 1 || !receive(&d)) {
+            FAIL("round %d: no datagram\n", round);
+            return;
+        }
+        check_dgram(&d, max, "content");
+        if (d.has_h[TLM_FRAME_GAP_US])
+            FAIL("frame gap sent, never written\n");
+        if (round && d.seq != prev.seq + 1)
+            FAIL("seq %u after %u\n", d.seq, prev.seq);
+        if (d.period_ms != 1000 || d.uptime_ms != (uint32_t)(now_us / 1000u))
+            FAIL("header: period %u uptime %u\n", d.period_ms, d.uptime_ms);
+        prev = d;
+    }
+
+    // a window without samples: the totals stay, the max is 0
+    memset(max, 0, sizeof(max));
+    run_ms(1000);
+    if (receive(&d))
+        check_dgram(&d, max, "quiet window");
+    sent = 0;
+}
+
+static void test_skipped(void)
+{
+    uint32_t max[TLM_HISTS] = { 0 };
+    uint32_t skipped = tlm_counter(TLM_TX_SKIPPED);
+    uint32_t seq = tlm_seq();
+    dgram_t d;
+
+    tlm_sample(TLM_DMA_US, 900);
+    tx_busy = true;
+    run_ms(1000);
+    tx_busy = false;
+    if (tlm_counter(TLM_TX_SKIPPED) != skipped + 1 || tlm_seq() != seq)
+        FAIL("busy socket: skipped %u seq %u\n", tlm_counter(TLM_TX_SKIPPED) - skipped, tlm_seq() - seq);
+
+    tlm_sample(TLM_DMA_US, 300);
+    max[TLM_DMA_US] = 900;          // the skipped window's max goes with this one
+    run_ms(1000);
+    if (receive(&d)) {
+        check_dgram(&d, max, "after a skipped datagram");
+        if (d.seq != seq)
+            FAIL("seq %u after a skipped datagram, expected %u\n", d.seq, seq);
+    }
+    sent = 0;
+}
+
+static void test_lost(void)
+{
+    dgram_t a, b;
+
+    run_ms(1000);
+    receive(&a);
+    for (int i = 0; i < 3; i++) {
+        tlm_count(TLM_LED_FRAMES, 50);
+        tlm_sample(TLM_FRAME_GAP_US, 20000);
+        run_ms(1000);
+        if (i < 2)
+            receive(&b);            // lost on the way
+    }
+    if (receive(&b)) {
+        if (b.c[TLM_LED_FRAMES] - a.c[TLM_LED_FRAMES] != 150 ||
+            b.count[TLM_FRAME_GAP_US] - a.count[TLM_FRAME_GAP_US] != 3)
+            FAIL("two lost datagrams: %u frames, %u gaps, expected 150, 3\n",
+                 b.c[TLM_LED_FRAMES] - a.c[TLM_LED_FRAMES],
+                 b.count[TLM_FRAME_GAP_US] - a.count[TLM_FRAME_GAP_US]);
+        if (b.seq - a.seq != 3)
+            FAIL("seq %u after %u: the loss is not visible\n", b.seq, a.seq);
+    }
+    sent = 0;
+}
+
+static void test_full(void)
+{
+    uint32_t expect = TLM_HEADER_SIZE + TLM_COUNTERS * 5 + TLM_HISTS * (17 + TLM_BUCKETS * 4);
+    dgram_t d;
+
+    for (int c = 0; c < TLM_COUNTERS; c++)
+        tlm_count((tlm_counter_t)c, 1);
+    for (int h = 0; h < TLM_HISTS; h++) {
+        tlm_sample((tlm_hist_t)h, 0);
+        for (int b = 0; b < TLM_BUCKETS - 1; b++)
+            tlm_sample((tlm_hist_t)h, 1u << b);
+    }
+
+    uint8_t buf[TLM_DGRAM_MAX];
+    uint16_t len = tlm_encode(buf, 0);
+    if (len != expect || len > TLM_DGRAM_MAX)
+        FAIL("all metrics: %u bytes, expected %u, max %u\n", len, expect, TLM_DGRAM_MAX);
+    run_ms(1000);
+    if (receive(&d))
+        check_dgram(&d, NULL, "all metrics");
+    sent = 0;
+    if (verbose)
+        printf("  all metrics, all buckets: %u bytes\n", len);
+}
+
+static void test_cost(void)
+{
+    uint8_t buf[TLM_DGRAM_MAX];
+    uint32_t n = 2000000, sink = 0;
+    uint64_t t0 = host_us();
+
+    for (uint32_t i = 0; i < n; i++)
+        tlm_sample(TLM_IRQ_US, i & 0xFFF);
+    uint64_t t1 = host_us();
+    for (uint32_t i = 0; i < 20000; i++)
+        sink += tlm_encode(buf, i);
+    uint64_t t2 = host_us();
+
+    printf("  tlm_sample %.1f ns, datagram encode %.2f us (%u bytes), host\n",
+           (double)(t1 - t0) * 1000.0 / n, (double)(t2 - t1) / 20000.0, sink / 20000u);
+}
+
+/* -d: a synthetic board, one datagram per 200 ms */
+static int stream(uint16_t port, uint32_t n)
+{
+    real_clock = true;
+    udp_open(port);
+    tlm_init(udp_send, 200);
+
+    uint64_t next_frame = host_us();
+    while (sent < n) {
+        uint64_t now = host_us();
+
+        if (now >= next_frame) {
+            next_frame += 20000;    // 50 fps
+            tlm_count(TLM_DDP_PKTS, 3);
+            tlm_count(TLM_DDP_BYTES, 3 * 1242);
+            tlm_count(TLM_DDP_FRAMES, 1);
+            tlm_count(TLM_LED_FRAMES, 1);
+            tlm_sample(TLM_IRQ_US, 40 + prng_below(&rng, 20));
+            tlm_sample(TLM_IRQ_LATENCY_US, 100 + prng_below(&rng, 1900));
+            tlm_sample(TLM_RENDER_US, 600 + prng_below(&rng, 400));
+            tlm_sample(TLM_ENCODE_US, 250 + prng_below(&rng, 30));
+            tlm_sample(TLM_DMA_US, 1400 + prng_below(&rng, 10));
+            tlm_sample(TLM_FRAME_GAP_US, 20000 + prng_below(&rng, 200) - 100);
+        }
+        tlm_service();
+        usleep(1000);
+    }
+    printf("%u datagrams sent to 127.0.0.1:%u\n", sent, port);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t samples = 20000, dest = 0, n = 0;
+    uint32_t seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "vn:r:d:")) != -1) {
+        switch (opt) {
+        case 'v': verbose = true; break;
+        case 'n': n = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'r': seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'd': dest = (uint32_t)strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-v] [-n samples] [-r seed] | -d port [-n datagrams]\n", argv[0]);
+            return 2;
+        }
+    }
+    prng_seed(&rng, seed, 47);
+    if (dest)
+        return stream((uint16_t)dest, n ? n : 50);
+    if (n)
+        samples = n;
+
+    now_us = 1000000;
+    udp_open(0);
+    if (verbose)
+        printf("  receiver on 127.0.0.1:%u\n", ntohs(rx_addr.sin_port));
+
+    test_buckets();
+    test_period();
+    test_content(samples);
+    test_skipped();
+    test_lost();
+    test_full();
+    test_cost();
+
+    printf("%s: %u errors\n", errors ? "FAIL" : "OK", errors);
+    return errors ? 1 : 0;
+}
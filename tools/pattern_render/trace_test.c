@@ -0,0 +1,416 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Hot path trace rings (common/utils/trace.c) on the host: a thread per
+ * core, a signal handler as the interrupt that preempts a write.
+ *
+ *   trace_test [-v] [-n events] [-r seed]
+ *   trace_test -d [-n ms]          # dump of a simulated main loop, for tools/trace/trace2perfetto.py
+ *
+ * Checked:
+ *  - events come back oldest first with their fields, the ring keeps the
+ *    newest TRACE_RING_SIZE and counts every write
+ *  - off writes nothing, clear empties the rings
+ *  - an interrupt between the slot claim and the stores of the preempted
+ *    event takes its own slot: no event lost or torn
+ *  - two cores at once: every ring holds only its own core's events
+ *  - the text dump reads back to the same events, no line is cut
+ *  - cost of one event
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "trace.h"
+#include "prng.h"
+
+static uint32_t errors;
+static bool verbose;
+static prng_t rng;
+
+#define FAIL(...) do { if (errors++ < 10) printf(__VA_ARGS__); } while (0)
+
+/* ---------- time base and core of trace.c ---------- */
+static uint32_t now_us;
+static __thread uint8_t core_id;
+
+uint32_t trace_now_us(void)
+{
+    return now_us;
+}
+
+uint8_t trace_core(void)
+{
+    return core_id;
+}
+
+static uint64_t host_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void restart(void)
+{
+    trace_clear();
+    trace_enable(true);
+}
+
+/* ---------- ring ---------- */
+static void test_order(uint32_t n)
+{
+    trace_evt_t e;
+
+    restart();
+    for (uint32_t i = 0; i < n; i++) {
+        now_us = 1000 + i;
+        trace_event((trace_id_t)(i % TR_IDS), TRACE_PH_INSTANT, i, ~i);
+    }
+    uint32_t held = n < TRACE_RING_SIZE ? n : TRACE_RING_SIZE;
+    if (trace_written(0) != n || trace_written(1) != 0)
+        FAIL("%u events: written %u / %u\n", n, trace_written(0), trace_written(1));
+    for (uint32_t i = 0; i < held; i++) {
+        uint32_t k = n - held + i;      // the oldest held is the n - held th written
+
+        if (!trace_get(0, i, &e)) {
+            FAIL("%u events: slot %u missing\n", n, i);
+            return;
+        }
+        if (e.ts_us != 1000 + k || e.id != k % TR_IDS || e.ph != TRACE_PH_INSTANT ||
+            e.a != k || e.b != ~k) {
+            FAIL("%u events: slot %u is ts %u id %u a %u, expected event %u\n", n, i, e.ts_us, e.id, e.a, k);
+            return;
+        }
+    }
+    if (trace_get(0, held, &e))
+        FAIL("%u events: more than %u held\n", n, held);
+}
+
+static void test_off(void)
+{
+    trace_evt_t e;
+
+    restart();
+    TRACE_INSTANT(TR_DDP_PUSH, 1, 2);
+    trace_enable(false);
+    TRACE_INSTANT(TR_DDP_PUSH, 3, 4);
+    if (trace_written(0) != 1)
+        FAIL("off: %u events written, expected 1\n", trace_written(0));
+    trace_clear();
+    if (trace_written(0) || trace_get(0, 0, &e))
+        FAIL("clear: events left\n");
+    trace_enable(true);
+}
+
+/* ---------- interrupt preempting a write ---------- */
+static volatile uint32_t irq_seq;
+
+static void on_alarm(int sig)
+{
+    (void)sig;
+    TRACE_BEGIN(TR_W6100_IRQ, irq_seq, ~irq_seq);
+    irq_seq++;
+    TRACE_END(TR_W6100_IRQ, irq_seq, ~irq_seq);
+    irq_seq++;
+}
+
+static void test_preempt(uint32_t ms)
+{
+    struct itimerval it = { { 0, 37 }, { 0, 37 } };
+    trace_evt_t e;
+    uint32_t main_seq = 0;
+    uint64_t end = host_ns() + (uint64_t)ms * 1000000u;
+
+    restart();
+    irq_seq = 0;
+    signal(SIGALRM, on_alarm);
+    setitimer(ITIMER_REAL, &it, NULL);
+    while (host_ns() < end) {
+        for (int i = 0; i < 1000; i++, main_seq++)
+            TRACE_INSTANT(TR_DDP_PACKET, main_seq, ~main_seq);
+    }
+    memset(&it, 0, sizeof(it));
+    setitimer(ITIMER_REAL, &it, NULL);
+    signal(SIGALRM, SIG_DFL);
+
+    if (trace_written(0) != main_seq + irq_seq)
+        FAIL("preempt: %u written, %u + %u events\n", trace_written(0), main_seq, irq_seq);
+
+    // every held slot whole, both sequences in order
+    uint32_t last_main = 0, last_irq = 0;
+    bool seen_main = false, seen_irq = false;
+    for (uint32_t i = 0; trace_get(0, i, &e); i++) {
+        bool irq = e.id == TR_W6100_IRQ;
+
+        if (e.b != ~e.a || (!irq && e.id != TR_DDP_PACKET)) {
+            FAIL("preempt: slot %u torn, id %u a %08x b %08x\n", i, e.id, e.a, e.b);
+            break;
+        }
+        if (irq ? (seen_irq && e.a != last_irq + 1) : (seen_main && e.a != last_main + 1)) {
+            FAIL("preempt: slot %u %s %u after %u\n", i, irq ? "irq" : "main", e.a,
+                 irq ? last_irq : last_main);
+            break;
+        }
+        if (irq) {
+            last_irq = e.a;
+            seen_irq = true;
+        } else {
+            last_main = e.a;
+            seen_main = true;
+        }
+    }
+    if (verbose)
+        printf("  preempt: %u events, %u of them in %u signals\n", main_seq + irq_seq, irq_seq, irq_seq / 2);
+    if (!irq_seq)
+        FAIL("preempt: no signal came\n");
+}
+
+/* ---------- two cores ---------- */
+#define CORE_EVENTS     200000u
+
+static void *core_thread(void *arg)
+{
+    core_id = (uint8_t)(uintptr_t)arg;
+    for (uint32_t i = 0; i < CORE_EVENTS; i++)
+        trace_event(TR_RENDER, TRACE_PH_INSTANT, core_id, i);
+    return NULL;
+}
+
+static void test_cores(void)
+{
+    pthread_t t[TRACE_CORES];
+    trace_evt_t e;
+
+    restart();
+    for (uintptr_t c = 0; c < TRACE_CORES; c++)
+        pthread_create(&t[c], NULL, core_thread, (void *)c);
+    for (int c = 0; c < TRACE_CORES; c++)
+        pthread_join(t[c], NULL);
+    for (uint8_t c = 0; c < TRACE_CORES; c++) {
+        if (trace_written(c) != CORE_EVENTS)
+            FAIL("core %u: %u written, expected %u\n", c, trace_written(c), CORE_EVENTS);
+        for (uint32_t i = 0; trace_get(c, i, &e); i++) {
+            if (e.a != c || e.b != CORE_EVENTS - TRACE_RING_SIZE + i) {
+                FAIL("core %u: slot %u is core %u event %u\n", c, i, e.a, e.b);
+                break;
+            }
+        }
+    }
+}
+
+/* ---------- text dump ---------- */
+typedef struct {
+    char     text[96 * 1024];
+    size_t   len;
+    size_t   longest;
+} dump_buf_t;
+
+static void put_line(void *ctx, const char *line)
+{
+    dump_buf_t *d = ctx;
+    size_t n = strlen(line);
+
+    if (n > d->longest)
+        d->longest = n;
+    if (d->len + n < sizeof(d->text)) {
+        memcpy(d->text + d->len, line, n + 1);
+        d->len += n;
+    }
+}
+
+static void put_stdout(void *ctx, const char *line)
+{
+    (void)ctx;
+    fputs(line, stdout);
+}
+
+static void test_dump(void)
+{
+    static dump_buf_t d;
+    static trace_evt_t ref[TRACE_CORES][TRACE_RING_SIZE];
+    uint32_t held[TRACE_CORES] = { 0 };
+    uint32_t names = 0, count = 0, got = 0, end = 0;
+    char *save;
+
+    restart();
+    for (uint32_t i = 0; i < 3 * TRACE_RING_SIZE / 2; i++) {
+        static const uint8_t ph[] = { TRACE_PH_BEGIN, TRACE_PH_END, TRACE_PH_INSTANT,
+                                      TRACE_PH_ASYNC_BEGIN, TRACE_PH_ASYNC_END };
+
+        now_us = 0xFFFFF000u + i * 7;    // wraps in the middle
+        core_id = (uint8_t)(prng_below(&rng, 3) == 0);
+        trace_event((trace_id_t)prng_below(&rng, TR_IDS), ph[prng_below(&rng, (uint32_t)sizeof(ph))],
+                    prng_below(&rng, 1u << 31) * 2 + 1, prng_below(&rng, 100000));
+    }
+    core_id = 0;
+    for (uint8_t c = 0; c < TRACE_CORES; c++)
+        while (trace_get(c, held[c], &ref[c][held[c]]))
+            held[c]++;
+
+    memset(&d, 0, sizeof(d));
+    count = trace_dump(put_line, &d);
+    if (!trace_enabled())
+        FAIL("dump: tracing left off\n");
+
+    for (char *line = strtok_r(d.text, "\r\n", &save); line; line = strtok_r(NULL, "\r\n", &save)) {
+        unsigned c, id, ver, cores, size;
+        unsigned long ts, a, b, now;
+        char ph, name[32];
+
+        if (sscanf(line, "trace %u cores %u size %u now %lx", &ver, &cores, &size, &now) == 4) {
+            if (ver != TRACE_VERSION || cores != TRACE_CORES || size != TRACE_RING_SIZE || now != now_us)
+                FAIL("dump header: %s\n", line);
+        } else if (sscanf(line, "N %u %31s", &id, name) == 2) {
+            if (id != names || strcmp(name, trace_name((uint16_t)id)))
+                FAIL("dump names: %s\n", line);
+            names++;
+        } else if (sscanf(line, "E %u %lx %u %c %lx %lx", &c, &ts, &id, &ph, &a, &b) == 6) {
+            uint32_t i = got - (c ? held[0] : 0);
+            const trace_evt_t *r = &ref[c < TRACE_CORES ? c : 0][i < TRACE_RING_SIZE ? i : 0];
+
+            if (c >= TRACE_CORES || i >= held[c] || ts != r->ts_us || id != r->id || ph != r->ph ||
+                a != r->a || b != r->b) {
+                FAIL("dump event %u: %s\n", got, line);
+                break;
+            }
+            got++;
+        } else if (sscanf(line, "end %u", &end) != 1) {
+            FAIL("dump: line not understood: %s\n", line);
+        }
+    }
+    if (names != TR_IDS || got != held[0] + held[1] || count != got || end != count)
+        FAIL("dump: %u names, %u events of %u, returned %u, end %u\n", names, got,
+             held[0] + held[1], count, end);
+    if (d.longest >= 64)
+        FAIL("dump: a line of %zu bytes, the buffer is 64\n", d.longest);
+    if (verbose)
+        printf("  dump: %u events, %zu bytes, longest line %zu\n", count, d.len, d.longest);
+}
+
+/* ---------- cost ---------- */
+static void test_cost(void)
+{
+    const uint32_t n = 4000000;
+
+    restart();
+    uint64_t t0 = host_ns();
+    for (uint32_t i = 0; i < n; i++)
+        TRACE_INSTANT(TR_DDP_PACKET, i, 0);
+    uint64_t t1 = host_ns();
+    trace_enable(false);
+    for (uint32_t i = 0; i < n; i++)
+        TRACE_INSTANT(TR_DDP_PACKET, i, 0);
+    uint64_t t2 = host_ns();
+    trace_enable(true);
+    printf("  trace_event %.1f ns, %.1f ns when off\n", (double)(t1 - t0) / n, (double)(t2 - t1) / n);
+}
+
+/* ---------- a simulated main loop for the decoder ---------- */
+static void span(trace_id_t id, uint32_t a, uint32_t us)
+{
+    TRACE_BEGIN(id, a, 0);
+    now_us += us;
+    TRACE_END(id, a, 0);
+}
+
+static int dump_sim(uint32_t ms)
+{
+    static const char *const tasks[] = { "ddp", "leds", "pattern", "cli", "efu", "tlm" };
+    uint32_t dma_end = 0, frame_len = 0;
+
+    restart();
+    now_us = 0xFFFF0000u;       // the clock wraps during the run
+    for (uint32_t t = 0; t < ms * 1000u; t += 250, now_us += 250) {
+        core_id = 0;
+        if (prng_below(&rng, 20) == 0) {            // W6100 IRQ, ddp task
+            uint32_t len = 1000 + prng_below(&rng, 400);
+
+            TRACE_BEGIN(TR_W6100_IRQ, 0, 0);
+            now_us += 6 + prng_below(&rng, 4);
+            TRACE_END(TR_W6100_IRQ, len, t % 5);
+            now_us += 30 + prng_below(&rng, 200);
+            TRACE_BEGIN(TR_TASK, 0, 40);
+            TRACE_BEGIN(TR_DDP_LOOP, 0, 0);
+            TRACE_INSTANT(TR_DDP_PACKET, frame_len, len);
+            frame_len += len;
+            now_us += 15;
+            if (frame_len > 2500) {
+                TRACE_INSTANT(TR_DDP_PUSH, frame_len, 0);
+                frame_len = 0;
+            }
+            TRACE_END(TR_DDP_LOOP, 0, 0);
+            TRACE_END(TR_TASK, 0, 40);
+        }
+        if (t % 20000 == 0) {                       // pattern task renders, core 1 encodes and sends
+            TRACE_BEGIN(TR_TASK, 2, 12);
+            span(TR_RENDER, 3, 180 + prng_below(&rng, 60));
+            TRACE_END(TR_TASK, 2, 12);
+            core_id = 1;
+            span(TR_ENCODE, t / 20000 & 1, 90);
+            TRACE_ASYNC_BEGIN(TR_DMA, 0, 171);
+            dma_end = now_us + 1750;
+            now_us -= 90;
+        }
+        if (dma_end && (int32_t)(now_us - dma_end) >= 0) {
+            core_id = 1;
+            TRACE_ASYNC_END(TR_DMA, 0, 0);
+            dma_end = 0;
+        }
+        core_id = 0;
+        if (t % 100000 == 50000)
+            span(TR_TASK, 5, 35);
+    }
+    for (unsigned i = 0; i < count_of(tasks); i++)
+        printf("T %u %s\r\n", i, tasks[i]);
+    trace_dump(put_stdout, NULL);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t n = 0, seed = 1;
+    bool dump = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "vn:r:d")) != -1) {
+        switch (opt) {
+        case 'v': verbose = true; break;
+        case 'n': n = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'r': seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'd': dump = true; break;
+        default:
+            fprintf(stderr, "usage: %s [-v] [-n events] [-r seed] | -d [-n ms]\n", argv[0]);
+            return 2;
+        }
+    }
+    prng_seed(&rng, seed, 48);
+    if (dump)
+        return dump_sim(n ? n : 200);
+
+    test_order(10);
+    test_order(TRACE_RING_SIZE);
+    test_order(n ? n : 3 * TRACE_RING_SIZE + 7);
+    test_off();
+    test_preempt(200);
+    test_cores();
+    test_dump();
+    test_cost();
+
+    printf("%s: %u errors\n", errors ? "FAIL" : "OK", errors);
+    return errors ? 1 : 0;
+}
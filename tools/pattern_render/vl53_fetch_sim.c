@@ -0,0 +1,444 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Main loop blocking of the kitchen_pwm VL53L8CX frame fetch. The driver,
+ * the ST API and the platform layer are built as is (VL53_DRV_HOST,
+ * VL53_PLATFORM_HOST) on a bus model: a sensor producing 8x8 frames at
+ * 15 Hz with INT held until the frame is read, blocking reads costing
+ * their bus time, and the DMA read completing in the background.
+ *
+ * "blocking" runs the old loop step: INT, vl53l8cx_check_data_ready(),
+ * vl53l8cx_get_ranging_data(). "dma" runs vl53l8cx_loop(). Both are called
+ * every 5 ms as by the scheduler; reported per bus clock are the longest
+ * and the mean time a step keeps the loop, its share of the loop time, and
+ * the frames handed to the frame hook. Those must be the same frames, with
+ * the same nearest distance, on both paths.
+ *
+ *   vl53_fetch_sim [-t seconds] [-s seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "pico/time.h"
+#include "hardware/gpio.h"
+#include "config.h"
+#include "vl53l8cx_drv.h"
+#include "vl53_frame.h"
+#include "prng.h"
+
+#define STEP_US         5000.0          // vl53l8cx_loop period in main.c
+#define FRAME_HZ        15
+#define CPU_US          0.25            // per driver call into the platform
+#define FRAMES_MAX      4096
+
+void vl53l8cx_drv_host_start(uint32_t data_read_size);
+
+static uint32_t errors;
+
+#define FAIL(...) do { if (errors++ < 10) printf(__VA_ARGS__); } while (0)
+
+static uint64_t cpu_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* ---------- sensor and bus model ---------- */
+struct i2c_inst { int unused; };
+i2c_inst_t i2c1_inst;
+
+static struct {
+    double   now_us, byte_us;
+    uint8_t  mem[VL53L8CX_TEMPORARY_BUFFER_SIZE];  // frame as the sensor serves it from address 0
+    uint32_t size;                                  // data_read_size
+    uint32_t frame;                                 // frames produced
+    double   next_frame_us;
+    bool     int_low;
+    uint16_t index;                                 // register of the last index write
+    uint32_t pushed;                                // TX FIFO entries of the current transaction
+    // DMA read in flight
+    uint8_t  *rx_dst;
+    uint32_t rx_size;
+    double   rx_done_us;
+    bool     rx_stop;
+} m;
+
+static prng_t rng;
+
+static uint32_t frame_word(const uint8_t *b)
+{
+    return (uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24;
+}
+
+static void put_word(uint8_t *b, uint32_t v)
+{
+    b[0] = (uint8_t)v;
+    b[1] = (uint8_t)(v >> 8);
+    b[2] = (uint8_t)(v >> 16);
+    b[3] = (uint8_t)(v >> 24);
+}
+
+/* the output list of vl53l8cx_start_ranging() for the result profile, 8x8, one target */
+static const uint32_t outputs[] = {
+    VL53L8CX_START_BH, VL53L8CX_METADATA_BH, VL53L8CX_COMMONDATA_BH,
+#ifndef VL53L8CX_DISABLE_AMBIENT_PER_SPAD
+    VL53L8CX_AMBIENT_RATE_BH,
+#endif
+#ifndef VL53L8CX_DISABLE_NB_SPADS_ENABLED
+    VL53L8CX_SPAD_COUNT_BH,
+#endif
+#ifndef VL53L8CX_DISABLE_NB_TARGET_DETECTED
+    VL53L8CX_NB_TARGET_DETECTED_BH,
+#endif
+#ifndef VL53L8CX_DISABLE_SIGNAL_PER_SPAD
+    VL53L8CX_SIGNAL_RATE_BH,
+#endif
+#ifndef VL53L8CX_DISABLE_RANGE_SIGMA_MM
+    VL53L8CX_RANGE_SIGMA_MM_BH,
+#endif
+    VL53L8CX_DISTANCE_BH,
+#ifndef VL53L8CX_DISABLE_REFLECTANCE_PERCENT
+    VL53L8CX_REFLECTANCE_BH,
+#endif
+    VL53L8CX_TARGET_STATUS_BH,
+#ifndef VL53L8CX_DISABLE_MOTION_INDICATOR
+    VL53L8CX_MOTION_DETECT_BH,
+#endif
+};
+
+/* block header with the size vl53l8cx_start_ranging() puts in, and its payload bytes */
+static uint32_t block(uint32_t bh, uint32_t *payload)
+{
+    uint32_t type = bh & 0xF, size = (bh >> 4) & 0xFFF, idx = bh >> 16;
+
+    if (type >= 1 && type < 0xD) {
+        size = (idx >= 0x54D0 && idx < 0x54D0 + 960) ? 64u : 64u * VL53L8CX_NB_TARGET_PER_ZONE;
+        bh = (bh & 0xFFFF000Fu) | size << 4;
+        *payload = type * size;
+    } else {
+        *payload = size;
+    }
+    return bh;
+}
+
+static uint32_t frame_size(void)
+{
+    uint32_t n = 0, payload;
+
+    for (uint32_t i = 0; i < count_of(outputs); i++) {
+        (void)block(outputs[i], &payload);
+        n += payload + 4;
+    }
+    return n + 24;
+}
+
+/* a new frame: someone walking towards the sensor in a few zones, noise elsewhere */
+static void sensor_frame(void)
+{
+    static uint8_t f[VL53L8CX_TEMPORARY_BUFFER_SIZE];
+    uint32_t i = 16, payload;
+    uint8_t sc = (uint8_t)(m.frame % 255u);
+    uint16_t id = (uint16_t)(0x1000u + m.frame);
+
+    memset(f, 0, sizeof(f));
+    f[8] = (uint8_t)(id >> 8);
+    f[9] = (uint8_t)id;
+    for (uint32_t k = 1; k < count_of(outputs); k++) {
+        uint32_t bh = block(outputs[k], &payload), idx = bh >> 16;
+        put_word(&f[i], bh);
+        for (uint32_t z = 0; z < payload; z++)
+            f[i + 4 + z] = (uint8_t)prng_u32(&rng);
+        if (idx == VL53L8CX_DISTANCE_IDX) {
+            for (uint32_t z = 0; z < 64; z++) {
+                int16_t mm = (int16_t)(z % 8 >= 3 && z % 8 <= 4 ? 3000 - (int32_t)(m.frame % 120) * 20 : 3500);
+                uint16_t raw = (uint16_t)(mm * 4 + (int16_t)prng_below(&rng, 4));
+                f[i + 4 + 2 * z] = (uint8_t)raw;
+                f[i + 5 + 2 * z] = (uint8_t)(raw >> 8);
+            }
+        } else if (idx == VL53L8CX_TARGET_STATUS_IDX) {
+            for (uint32_t z = 0; z < 64; z++)
+                f[i + 4 + z] = (prng_below(&rng, 10) == 0) ? 4 : 5;
+        } else if (idx == VL53L8CX_NB_TARGET_DETECTED_IDX) {
+            for (uint32_t z = 0; z < 64; z++)
+                f[i + 4 + z] = 1;
+        }
+        i += 4 + payload;
+    }
+    f[m.size - 4] = (uint8_t)(id >> 8);
+    f[m.size - 3] = (uint8_t)id;
+
+    // served big-endian per 32-bit word; the first word is the status the ready check reads
+    for (i = 0; i < m.size; i += 4) {
+        uint32_t w = frame_word(&f[i]);
+        m.mem[i] = (uint8_t)(w >> 24);
+        m.mem[i + 1] = (uint8_t)(w >> 16);
+        m.mem[i + 2] = (uint8_t)(w >> 8);
+        m.mem[i + 3] = (uint8_t)w;
+    }
+    m.mem[0] = sc;
+    m.mem[1] = 0x5;
+    m.mem[2] = 0x5;
+    m.mem[3] = 0x10;
+    m.int_low = true;
+    m.frame++;
+}
+
+static void advance(double us)
+{
+    m.now_us += us;
+    while (m.now_us >= m.next_frame_us) {
+        sensor_frame();
+        m.next_frame_us += 1e6 / FRAME_HZ;
+    }
+}
+
+/* a read of address 0 takes the frame and releases INT */
+static void sensor_read(uint16_t index, uint8_t *dst, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++)
+        dst[i] = (index + i < sizeof(m.mem)) ? m.mem[index + i] : 0;
+    if (index == 0 && len >= m.size)
+        m.int_low = false;
+}
+
+/* blocking SDK calls: the bus time is the caller's */
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop)
+{
+    (void)i2c; (void)addr; (void)nostop;
+    if (len >= 2)
+        m.index = (uint16_t)(src[0] << 8 | src[1]);
+    advance((double)(len + 1) * m.byte_us);
+    return (int)len;
+}
+
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop)
+{
+    (void)i2c; (void)addr; (void)nostop;
+    advance((double)(len + 1) * m.byte_us);
+    sensor_read(m.index, dst, (uint32_t)len);
+    return (int)len;
+}
+
+/* the controller port: index bytes and the first read command from the CPU, the rest by DMA */
+void vl53_i2c_tx_begin(i2c_inst_t *i2c, uint8_t addr_7_bits) { (void)i2c; (void)addr_7_bits; m.pushed = 0; advance(CPU_US); }
+uint32_t vl53_i2c_tx_room(i2c_inst_t *i2c) { (void)i2c; advance(CPU_US); return 16; }
+void vl53_i2c_tx_abort(i2c_inst_t *i2c) { (void)i2c; m.rx_dst = NULL; m.rx_stop = true; }
+bool vl53_i2c_rx_dma_claim(void) { return true; }
+void vl53_i2c_rx_cancel(i2c_inst_t *i2c) { (void)i2c; m.rx_dst = NULL; }
+
+void vl53_i2c_tx_push(i2c_inst_t *i2c, uint32_t cmd)
+{
+    (void)i2c;
+    advance(CPU_US);
+    if (m.pushed < 2)
+        m.index = (uint16_t)(m.pushed == 0 ? (cmd & 0xFF) << 8 : m.index | (cmd & 0xFF));
+    else if (!(cmd & 0x100))
+        advance(m.byte_us);     // writes are not used by the loop, charged as sent
+    m.pushed++;
+}
+
+void vl53_i2c_rx_dma(i2c_inst_t *i2c, uint8_t *dst, uint32_t size)
+{
+    (void)i2c;
+    advance(CPU_US * 6);        // three channels configured
+    memset(dst, 0xA5, size);    // the buffer is in flux until the read is done
+    m.rx_dst = dst;
+    m.rx_size = size;
+    m.rx_done_us = m.now_us + (double)(size + 4) * m.byte_us;
+}
+
+static void rx_run(void)
+{
+    if (m.rx_dst && m.now_us >= m.rx_done_us) {
+        sensor_read(m.index, m.rx_dst, m.rx_size);
+        m.rx_dst = NULL;
+        m.rx_stop = true;
+    }
+}
+
+bool vl53_i2c_rx_busy(i2c_inst_t *i2c)
+{
+    (void)i2c;
+    advance(CPU_US);
+    rx_run();
+    return m.rx_dst != NULL;
+}
+
+uint32_t vl53_i2c_tx_events(i2c_inst_t *i2c)
+{
+    (void)i2c;
+    advance(CPU_US);
+    rx_run();
+    uint32_t ev = m.rx_stop ? 0x2u : 0u;
+    m.rx_stop = false;
+    return ev;
+}
+
+uint64_t time_us_64(void) { advance(CPU_US); return (uint64_t)m.now_us; }
+absolute_time_t get_absolute_time(void) { return time_us_64(); }
+uint32_t to_ms_since_boot(absolute_time_t t) { return (uint32_t)(t / 1000u); }
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) { return (int64_t)(to - from); }
+void sleep_ms(uint32_t ms) { advance(ms * 1000.0); }
+void sleep_us(uint64_t us) { advance((double)us); }
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) { (void)i2c; return baudrate; }
+void gpio_init(uint gpio) { (void)gpio; }
+void gpio_set_function(uint gpio, gpio_function_t fn) { (void)gpio; (void)fn; }
+void gpio_set_dir(uint gpio, bool out) { (void)gpio; (void)out; }
+void gpio_put(uint gpio, bool value) { (void)gpio; (void)value; }
+void gpio_pull_up(uint gpio) { (void)gpio; }
+void gpio_disable_pulls(uint gpio) { (void)gpio; }
+
+bool gpio_get(uint gpio)
+{
+    advance(CPU_US);
+    return gpio == VL53_PIN_INT ? !m.int_low : true;
+}
+
+/* ---------- runs ---------- */
+static uint16_t hook_mm[FRAMES_MAX];
+static uint32_t hook_n;
+
+static void on_frame(uint16_t nearest_mm, uint32_t t_ms)
+{
+    (void)t_ms;
+    if (hook_n < FRAMES_MAX)
+        hook_mm[hook_n] = nearest_mm;
+    hook_n++;
+}
+
+/* the vl53l8cx_loop() step before the DMA fetch */
+static void loop_blocking(void)
+{
+    static VL53L8CX_ResultsData r;
+    VL53L8CX_Configuration *dev = vl53_get_dev();
+    uint8_t ready = 0;
+
+    if (!vl53_platform_int_asserted(&dev->platform))
+        return;
+    if (vl53l8cx_check_data_ready(dev, &ready) != VL53L8CX_STATUS_OK || !ready)
+        return;
+    if (vl53l8cx_get_ranging_data(dev, &r) != VL53L8CX_STATUS_OK)
+        return;
+
+    uint16_t best = 0;
+    for (uint32_t z = 0; z < 64; z++) {
+        int16_t d = r.distance_mm[z * VL53L8CX_NB_TARGET_PER_ZONE];
+        uint8_t s = r.target_status[z * VL53L8CX_NB_TARGET_PER_ZONE];
+        if ((s == 5 || s == 9) && d > 0 && (best == 0 || (uint16_t)d < best))
+            best = (uint16_t)d;
+    }
+    on_frame(best, 0);
+}
+
+typedef struct {
+    double   max_us, sum_us;
+    uint32_t steps, frames;
+} run_t;
+
+static run_t run(bool dma, uint32_t baud_100k, double seconds, uint64_t seed)
+{
+    run_t r = { 0 };
+    VL53L8CX_Configuration *dev = vl53_get_dev();
+
+    memset(&m, 0, sizeof(m));
+    m.byte_us = 90.0 / baud_100k;
+    m.size = frame_size();
+    m.next_frame_us = 1000.0;
+    prng_seed(&rng, seed, 3);
+
+    dev->platform.pin_int = VL53_PIN_INT;
+    dev->platform.baudrate = baud_100k;
+    vl53l8cx_drv_host_start(m.size);
+    vl53l8cx_frame_hook(on_frame);
+    hook_n = 0;
+
+    for (double t = 0; t < seconds * 1e6; t += STEP_US) {
+        if (m.now_us < t)
+            advance(t - m.now_us);
+        double t0 = m.now_us;
+        if (dma)
+            vl53l8cx_loop();
+        else
+            loop_blocking();
+        double dt = m.now_us - t0;
+        r.sum_us += dt;
+        if (dt > r.max_us)
+            r.max_us = dt;
+        r.steps++;
+    }
+    r.frames = hook_n;
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = 20;
+    uint64_t seed = 41;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:s:")) != -1) {
+        switch (opt) {
+            case 't': seconds = strtod(optarg, NULL); break;
+            case 's': seed = strtoull(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-t seconds] [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    printf("VL53 frame fetch, 8x8 result profile (%u bytes) at %u Hz, loop step every %.0f ms, %.0f s:\n",
+           frame_size(), FRAME_HZ, STEP_US / 1000.0, seconds);
+    static const uint32_t speeds[] = { 1, 4, 10 };
+    for (uint32_t k = 0; k < count_of(speeds); k++) {
+        static uint16_t ref[FRAMES_MAX];
+
+        run_t b = run(false, speeds[k], seconds, seed);
+        memcpy(ref, hook_mm, sizeof(ref));
+        run_t d = run(true, speeds[k], seconds, seed);
+        const vl53_fetch_stats_t *st = vl53l8cx_fetch_stats();
+
+        printf("  %4u kHz  blocking: max %7.2f ms mean %6.3f ms (%4.1f %% of the loop), %u frames\n",
+               speeds[k] * 100u, b.max_us / 1000.0, b.sum_us / b.steps / 1000.0,
+               100.0 * b.sum_us / (seconds * 1e6), b.frames);
+        printf("            dma:      max %7.3f ms mean %6.3f ms (%4.1f %% of the loop), %u frames\n",
+               d.max_us / 1000.0, d.sum_us / d.steps / 1000.0, 100.0 * d.sum_us / (seconds * 1e6), d.frames);
+
+        // at 100 kHz a frame takes longer on the bus than the sensor takes to make one
+        uint32_t expect = (uint32_t)(seconds * FRAME_HZ) - 1;
+        bool carries = (double)(frame_size() + 4u) * 90.0 / speeds[k] < 1e6 / FRAME_HZ;
+        if (!carries)
+            printf("            the bus carries fewer than %u frames/s, both paths skip frames\n", FRAME_HZ);
+        else if (b.frames < expect || d.frames < expect)
+            FAIL("%u kHz: frames lost (%u / %u of %u)\n", speeds[k] * 100u, b.frames, d.frames, expect);
+        if (d.frames != b.frames || memcmp(ref, hook_mm, sizeof(uint16_t) * (d.frames < FRAMES_MAX ? d.frames : FRAMES_MAX)))
+            FAIL("%u kHz: the two paths handed different frames to the hook\n", speeds[k] * 100u);
+        if (st->corrupt || st->errors)
+            FAIL("%u kHz: %u corrupt, %u fetch errors\n", speeds[k] * 100u, st->corrupt, st->errors);
+        if (d.max_us > 1000.0)
+            FAIL("%u kHz: a dma step blocked %.0f us\n", speeds[k] * 100u, d.max_us);
+    }
+
+    // conversion of a fetched frame, the one step left on the CPU (host time)
+    static VL53L8CX_ResultsData res;
+    const uint32_t reps = 20000;
+    sensor_frame();
+    uint64_t t0 = cpu_time_ns();
+    for (uint32_t i = 0; i < reps; i++)
+        (void)vl53_frame_decode(m.mem, m.size, &res);
+    printf("  conversion step: %.0f ns per frame on this host\n", (double)(cpu_time_ns() - t0) / reps);
+
+    printf("%s: %u errors\n", errors ? "FAIL" : "OK", errors);
+    return errors ? 1 : 0;
+}
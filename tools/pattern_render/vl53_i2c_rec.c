@@ -0,0 +1,373 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * I2C transaction recorder for kitchen_pwm/vl53l8cx_platform.c. The
+ * platform file is built as is (VL53_PLATFORM_HOST); its controller access
+ * lands on a model of the RP2350 I2C block: 16-entry TX FIFO, bytes shifted
+ * out at the bus clock, the bus held while the FIFO is empty, STOP only
+ * where a byte asks for it, TX_ABRT on a NACK or an abort.
+ *
+ * Every write must come out as one transaction equal to the one of the
+ * staging buffer it replaced: address, index high, index low, payload,
+ * STOP after the last byte and nowhere else. Checked for random blocks, the
+ * firmware download sequence of vl53l8cx_init(), a NACK anywhere in a block
+ * and a bus that stops clocking. Then the upload time of the ~84 KB
+ * firmware at 100 kHz, 400 kHz and 1 MHz, and how busy the bus is kept.
+ *
+ *   vl53_i2c_rec [-n blocks] [-s seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "pico/time.h"
+#include "hardware/gpio.h"
+#include "config.h"
+#include "vl53l8cx_buffers.h"           // VL53L8CX_FIRMWARE, defined here once
+#include "prng.h"
+
+#define FIFO_DEPTH      16
+#define TX_MAX          (0x8000 + 2)
+#define LOG_MAX         16
+#define CPU_US          0.25            // per controller access, ~40 cycles at 150 MHz
+
+static uint32_t errors;
+
+#define FAIL(...) do { if (errors++ < 10) printf(__VA_ARGS__); } while (0)
+
+/* ---------- controller model ---------- */
+struct i2c_inst { int unused; };
+static i2c_inst_t bus;
+
+typedef struct {
+    uint8_t  addr;
+    bool     read, aborted, stop_inside;
+    uint32_t len;
+    uint8_t  *b;
+} txn_t;
+
+static struct {
+    double   now_us, byte_us, busy_us, done_us;  // done_us: end of the byte on the wire
+    uint16_t fifo[FIFO_DEPTH];                    // IC_DATA_CMD: byte | 0x200 = STOP after it
+    uint32_t head, count;
+    uint32_t events;
+    bool     open, stalled, flushing;            // flushing: TX_ABRT not cleared, writes dropped
+    int64_t  nack_at;                            // byte of the transaction to NACK, -1 none
+    uint8_t  addr;
+    txn_t    cur;
+} c;
+
+static txn_t log_[LOG_MAX];
+static uint32_t n_log;
+
+static void txn_end(bool aborted)
+{
+    c.cur.aborted = aborted;
+    if (n_log < LOG_MAX)
+        log_[n_log] = c.cur;
+    else
+        free(c.cur.b);
+    n_log++;
+    memset(&c.cur, 0, sizeof(c.cur));
+    c.open = false;
+    c.count = 0;
+    c.events |= 0x2;            // STOP_DET
+}
+
+static void txn_open(void)
+{
+    if (!c.open) {
+        c.open = true;
+        c.cur = (txn_t){ .addr = c.addr, .b = malloc(TX_MAX) };
+    }
+}
+
+static void txn_byte(uint8_t b)
+{
+    txn_open();
+    if (c.cur.len < TX_MAX)
+        c.cur.b[c.cur.len] = b;
+    c.cur.len++;
+}
+
+static void bus_run(void)
+{
+    c.now_us += CPU_US;
+    while (c.count && !c.stalled && c.now_us >= c.done_us) {
+        uint16_t w = c.fifo[c.head];
+        c.head = (c.head + 1) % FIFO_DEPTH;
+        c.count--;
+        txn_open();
+        if ((int64_t)c.cur.len == c.nack_at) {
+            c.nack_at = -1;
+            c.events |= 0x1;    // TX_ABRT, the FIFO is flushed
+            c.flushing = true;
+            txn_end(true);
+            break;
+        }
+        txn_byte((uint8_t)w);
+        c.busy_us += c.byte_us;
+        if (w & 0x200) {
+            if (c.count)
+                c.cur.stop_inside = true;
+            txn_end(false);
+            break;
+        }
+        if (c.count)
+            c.done_us += c.byte_us;     // next byte follows without a gap
+    }
+}
+
+void vl53_i2c_tx_begin(i2c_inst_t *i2c, uint8_t addr_7_bits)
+{
+    (void)i2c;
+    bus_run();
+    if (c.open || c.count)
+        FAIL("begin inside an open transaction\n");
+    c.addr = addr_7_bits;
+}
+
+uint32_t vl53_i2c_tx_room(i2c_inst_t *i2c)
+{
+    (void)i2c;
+    bus_run();
+    return FIFO_DEPTH - c.count;
+}
+
+void vl53_i2c_tx_push(i2c_inst_t *i2c, uint32_t cmd)
+{
+    (void)i2c;
+    c.now_us += CPU_US;
+    if (c.flushing)
+        return;
+    if (c.count == FIFO_DEPTH) {
+        FAIL("TX FIFO overflow\n");
+        return;
+    }
+    if (c.count == 0)       // bus held or idle: this byte starts now (START + address first)
+        c.done_us = c.now_us + (c.open ? 1.0 : 2.0) * c.byte_us;
+    if (!c.open && c.count == 0)
+        c.busy_us += c.byte_us;
+    if (cmd & ~0x2FFu)
+        FAIL("write with read or restart bits 0x%x\n", cmd);
+    c.fifo[(c.head + c.count) % FIFO_DEPTH] = (uint16_t)cmd;
+    c.count++;
+}
+
+uint32_t vl53_i2c_tx_events(i2c_inst_t *i2c)
+{
+    (void)i2c;
+    bus_run();
+    uint32_t ev = c.events;
+    c.events = 0;
+    c.flushing = false;
+    return ev;
+}
+
+void vl53_i2c_tx_abort(i2c_inst_t *i2c)
+{
+    (void)i2c;
+    c.now_us += CPU_US;
+    c.events |= 0x1;
+    c.stalled = false;
+    c.flushing = true;
+    txn_end(true);
+}
+
+/* the DMA read of the ranging data is vl53_fetch_sim's business */
+bool vl53_i2c_rx_dma_claim(void) { return false; }
+void vl53_i2c_rx_dma(i2c_inst_t *i2c, uint8_t *dst, uint32_t size) { (void)i2c; (void)dst; (void)size; }
+bool vl53_i2c_rx_busy(i2c_inst_t *i2c) { (void)i2c; return false; }
+void vl53_i2c_rx_cancel(i2c_inst_t *i2c) { (void)i2c; }
+
+/* reads still go through the SDK calls, logged as a write of the index and a read */
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop)
+{
+    (void)i2c; (void)nostop;
+    c.addr = addr;
+    for (size_t i = 0; i < len; i++)
+        txn_byte(src[i]);
+    txn_end(false);
+    c.events = 0;
+    return (int)len;
+}
+
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop)
+{
+    (void)i2c; (void)nostop;
+    c.addr = addr;
+    memset(dst, 0x5A, len);
+    txn_byte(0);
+    c.cur.read = true;
+    c.cur.len = (uint32_t)len;
+    txn_end(false);
+    c.events = 0;
+    return (int)len;
+}
+
+uint64_t time_us_64(void) { c.now_us += CPU_US; bus_run(); return (uint64_t)c.now_us; }
+void sleep_ms(uint32_t ms) { c.now_us += ms * 1000.0; }
+void sleep_us(uint64_t us) { c.now_us += (double)us; }
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) { (void)i2c; return baudrate; }
+void gpio_init(uint gpio) { (void)gpio; }
+void gpio_set_function(uint gpio, gpio_function_t fn) { (void)gpio; (void)fn; }
+void gpio_set_dir(uint gpio, bool out) { (void)gpio; (void)out; }
+void gpio_put(uint gpio, bool value) { (void)gpio; (void)value; }
+bool gpio_get(uint gpio) { (void)gpio; return true; }
+void gpio_pull_up(uint gpio) { (void)gpio; }
+void gpio_disable_pulls(uint gpio) { (void)gpio; }
+
+static VL53L8CX_Platform plat;
+
+/* bus clock in units of 100 kHz, as VL53_BAUDRATE */
+static void bus_reset(uint32_t baud_100k)
+{
+    for (uint32_t i = 0; i < n_log && i < LOG_MAX; i++)
+        free(log_[i].b);
+    n_log = 0;
+    free(c.cur.b);
+    memset(&c, 0, sizeof(c));
+    c.nack_at = -1;
+    c.byte_us = 9.0 * 10.0 / baud_100k;
+    plat = (VL53L8CX_Platform){ .i2c_port = &bus, .i2c_addr = VL53_I2C_ADDR,
+                                .pin_sda = VL53_PIN_SDA, .pin_scl = VL53_PIN_SCL,
+                                .pin_cs = VL53_PIN_CS, .pin_int = VL53_PIN_INT,
+                                .baudrate = baud_100k };
+}
+
+/* the transaction the staging buffer sent: address, index, payload, STOP */
+static bool same_as_staged(const txn_t *t, uint16_t index, const uint8_t *v, uint32_t n)
+{
+    return t->addr == (VL53_I2C_ADDR >> 1) && !t->read && !t->aborted && !t->stop_inside &&
+           t->len == n + 2 && t->b[0] == (uint8_t)(index >> 8) && t->b[1] == (uint8_t)index &&
+           memcmp(t->b + 2, v, n) == 0;
+}
+
+/* ---------- tests ---------- */
+static void test_blocks(prng_t *rng, uint32_t blocks)
+{
+    static uint8_t v[0x8000];
+    static const uint32_t edge[] = { 0, 1, 2, 13, 14, 15, 16, 17, 31, 0x8000 };
+
+    for (uint32_t i = 0; i < blocks; i++) {
+        uint32_t n = (i < count_of(edge)) ? edge[i] : prng_below(rng, (i & 7) ? 300 : 0x8000);
+        uint16_t index = (uint16_t)prng_u32(rng);
+
+        bus_reset((i & 1) ? 10 : 4);
+        for (uint32_t k = 0; k < n; k++)
+            v[k] = (uint8_t)prng_u32(rng);
+        uint8_t st = (n == 1 && (i & 2)) ? WrByte(&plat, index, v[0]) : WrMulti(&plat, index, v, n);
+        if (st != 0 || n_log != 1 || !same_as_staged(&log_[0], index, v, n))
+            FAIL("block %u: %u bytes at 0x%04x: status %u, %u transactions, %s\n", i, n, index, st,
+                 n_log, n_log ? (log_[0].stop_inside ? "STOP inside" : "bytes differ") : "none");
+    }
+}
+
+/* the download sequence of vl53l8cx_init(): page select, 32 KB, ..., 20 KB */
+static double upload(uint32_t baud_100k, bool check)
+{
+    static const struct { uint8_t page; uint32_t off, len; } chunk[] = {
+        { 0x09, 0, 0x8000 }, { 0x0a, 0x8000, 0x8000 }, { 0x0b, 0x10000, 0x5000 },
+    };
+    uint8_t st = 0;
+
+    bus_reset(baud_100k);
+    double t0 = c.now_us;
+    for (uint32_t k = 0; k < count_of(chunk); k++) {
+        st |= WrByte(&plat, 0x7fff, chunk[k].page);
+        st |= WrMulti(&plat, 0, (uint8_t *)&VL53L8CX_FIRMWARE[chunk[k].off], chunk[k].len);
+    }
+    st |= WrByte(&plat, 0x7fff, 0x01);
+    double t = c.now_us - t0;
+
+    if (!check)
+        return t;
+    if (st != 0 || n_log != 2 * count_of(chunk) + 1)
+        FAIL("firmware: status %u, %u transactions\n", st, n_log);
+    for (uint32_t k = 0; k < count_of(chunk) && 2 * k + 1 < n_log; k++) {
+        if (!same_as_staged(&log_[2 * k], 0x7fff, &chunk[k].page, 1) ||
+            !same_as_staged(&log_[2 * k + 1], 0, &VL53L8CX_FIRMWARE[chunk[k].off], chunk[k].len))
+            FAIL("firmware chunk %u differs from the staged stream\n", k);
+    }
+    return t;
+}
+
+static void test_nack(prng_t *rng)
+{
+    static uint8_t v[600];
+
+    for (uint32_t i = 0; i < 200; i++) {
+        uint32_t n = 1 + prng_below(rng, sizeof(v));
+
+        bus_reset(10);
+        c.nack_at = (int64_t)prng_below(rng, n + 2);
+        if (WrMulti(&plat, 0x2c34, v, n) == 0)
+            FAIL("NACK at byte %lld of %u not reported\n", (long long)c.nack_at, n + 2);
+        if (n_log != 1 || !log_[0].aborted)
+            FAIL("NACK: %u transactions, aborted %d\n", n_log, n_log ? log_[0].aborted : 0);
+        // the next write starts clean
+        if (WrByte(&plat, 0x7fff, 0x02) != 0 || n_log != 2 || !same_as_staged(&log_[1], 0x7fff, (const uint8_t[]){ 0x02 }, 1))
+            FAIL("write after a NACK\n");
+    }
+}
+
+static void test_stall(void)
+{
+    static uint8_t v[256];
+
+    bus_reset(10);
+    c.stalled = true;           // SCL held low by the sensor
+    double t0 = c.now_us;
+    if (WrMulti(&plat, 0x2e18, v, sizeof(v)) == 0)
+        FAIL("stalled bus not reported\n");
+    if (n_log != 1 || !log_[0].aborted)
+        FAIL("stalled bus: transaction not aborted\n");
+    if (c.now_us - t0 > 50000.0)
+        FAIL("stalled bus: gave up after %.0f us\n", c.now_us - t0);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t blocks = 400;
+    uint64_t seed = 40;
+    prng_t rng;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+            case 'n': blocks = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 's': seed = strtoull(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-n blocks] [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+    prng_seed(&rng, seed, 1);
+
+    test_blocks(&rng, blocks);
+    upload(10, true);
+    test_nack(&rng);
+    test_stall();
+    printf("VL53 I2C writes: %u blocks, firmware sequence, NACKs, stalled bus\n", blocks);
+
+    printf("  firmware upload (%u bytes), %.2f us per FIFO access:\n", 0x15000u, CPU_US);
+    static const uint32_t speeds[] = { 1, 4, 10 };
+    for (uint32_t k = 0; k < count_of(speeds); k++) {
+        double t = upload(speeds[k], false);
+        printf("    %4u kHz: %7.1f ms, bus busy %.1f %%\n", speeds[k] * 100u, t / 1000.0, 100.0 * c.busy_us / t);
+    }
+    printf("  write stack: no staging buffer (was 0x8100 bytes per write)\n");
+
+    bus_reset(1);
+    printf("%s: %u errors\n", errors ? "FAIL" : "OK", errors);
+    return errors ? 1 : 0;
+}
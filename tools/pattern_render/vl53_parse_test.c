@@ -0,0 +1,328 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * kitchen_pwm/vl53_frame.c against the stock ST parser. Frames in the
+ * layout the sensor sends for the result profile of vl53l8cx_api.h (4x4
+ * and 8x8, random distances including negative ones, zones without
+ * target, damaged footers), or raw frames recorded from the sensor, go
+ * through vl53l8cx_decode_ranging_data() and vl53_frame_decode(); every
+ * field the profile keeps must come out equal for the zones of the frame,
+ * and so must the returned status.
+ *
+ * Then what the profile saves: bytes per 8x8 frame against all outputs and
+ * their bus time, and the conversion time of both parsers on this host.
+ *
+ *   vl53_parse_test [-n frames] [-s seed] [-r frames.bin -z 16|64]
+ *
+ * frames.bin holds frames as read from address 0, data_read_size bytes
+ * each, back to back.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "pico/time.h"
+#include "hardware/gpio.h"
+#include "vl53l8cx_api.h"
+#include "vl53_frame.h"
+#include "prng.h"
+
+static uint32_t errors;
+
+#define FAIL(...) do { if (errors++ < 10) printf(__VA_ARGS__); } while (0)
+
+static uint64_t cpu_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* no sensor on this host: the platform layer is linked for SwapBuffer() */
+struct i2c_inst { int unused; };
+i2c_inst_t i2c1_inst;
+void vl53_i2c_tx_begin(i2c_inst_t *i2c, uint8_t addr_7_bits) { (void)i2c; (void)addr_7_bits; }
+uint32_t vl53_i2c_tx_room(i2c_inst_t *i2c) { (void)i2c; return 0; }
+void vl53_i2c_tx_push(i2c_inst_t *i2c, uint32_t cmd) { (void)i2c; (void)cmd; }
+uint32_t vl53_i2c_tx_events(i2c_inst_t *i2c) { (void)i2c; return 0; }
+void vl53_i2c_tx_abort(i2c_inst_t *i2c) { (void)i2c; }
+bool vl53_i2c_rx_dma_claim(void) { return false; }
+void vl53_i2c_rx_dma(i2c_inst_t *i2c, uint8_t *dst, uint32_t size) { (void)i2c; (void)dst; (void)size; }
+bool vl53_i2c_rx_busy(i2c_inst_t *i2c) { (void)i2c; return false; }
+void vl53_i2c_rx_cancel(i2c_inst_t *i2c) { (void)i2c; }
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop)
+{ (void)i2c; (void)addr; (void)src; (void)len; (void)nostop; return -1; }
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop)
+{ (void)i2c; (void)addr; (void)dst; (void)len; (void)nostop; return -1; }
+uint64_t time_us_64(void) { return 0; }
+void sleep_ms(uint32_t ms) { (void)ms; }
+void sleep_us(uint64_t us) { (void)us; }
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) { (void)i2c; return baudrate; }
+void gpio_init(uint gpio) { (void)gpio; }
+void gpio_set_function(uint gpio, gpio_function_t fn) { (void)gpio; (void)fn; }
+void gpio_set_dir(uint gpio, bool out) { (void)gpio; (void)out; }
+void gpio_put(uint gpio, bool value) { (void)gpio; (void)value; }
+bool gpio_get(uint gpio) { (void)gpio; return true; }
+void gpio_pull_up(uint gpio) { (void)gpio; }
+void gpio_disable_pulls(uint gpio) { (void)gpio; }
+
+/* ---------- frames as the sensor sends them ---------- */
+static const uint32_t all_outputs[] = {
+    VL53L8CX_START_BH, VL53L8CX_METADATA_BH, VL53L8CX_COMMONDATA_BH, VL53L8CX_AMBIENT_RATE_BH,
+    VL53L8CX_SPAD_COUNT_BH, VL53L8CX_NB_TARGET_DETECTED_BH, VL53L8CX_SIGNAL_RATE_BH,
+    VL53L8CX_RANGE_SIGMA_MM_BH, VL53L8CX_DISTANCE_BH, VL53L8CX_REFLECTANCE_BH,
+    VL53L8CX_TARGET_STATUS_BH, VL53L8CX_MOTION_DETECT_BH,
+};
+
+/* the blocks vl53l8cx_start_ranging() enables for the profile */
+static bool in_profile(uint32_t bh)
+{
+    switch (bh) {
+#ifdef VL53L8CX_DISABLE_AMBIENT_PER_SPAD
+        case VL53L8CX_AMBIENT_RATE_BH:          return false;
+#endif
+#ifdef VL53L8CX_DISABLE_NB_SPADS_ENABLED
+        case VL53L8CX_SPAD_COUNT_BH:            return false;
+#endif
+#ifdef VL53L8CX_DISABLE_NB_TARGET_DETECTED
+        case VL53L8CX_NB_TARGET_DETECTED_BH:    return false;
+#endif
+#ifdef VL53L8CX_DISABLE_SIGNAL_PER_SPAD
+        case VL53L8CX_SIGNAL_RATE_BH:           return false;
+#endif
+#ifdef VL53L8CX_DISABLE_RANGE_SIGMA_MM
+        case VL53L8CX_RANGE_SIGMA_MM_BH:        return false;
+#endif
+#ifdef VL53L8CX_DISABLE_REFLECTANCE_PERCENT
+        case VL53L8CX_REFLECTANCE_BH:           return false;
+#endif
+#ifdef VL53L8CX_DISABLE_MOTION_INDICATOR
+        case VL53L8CX_MOTION_DETECT_BH:         return false;
+#endif
+        default:                                return true;
+    }
+}
+
+/* block header with the size vl53l8cx_start_ranging() puts in, and its payload bytes */
+static uint32_t block(uint32_t bh, uint32_t zones, uint32_t *payload)
+{
+    uint32_t type = bh & 0xF, size = (bh >> 4) & 0xFFF, idx = bh >> 16;
+
+    if (type >= 1 && type < 0xD) {
+        size = (idx >= 0x54D0 && idx < 0x54D0 + 960) ? zones : zones * VL53L8CX_NB_TARGET_PER_ZONE;
+        bh = (bh & 0xFFFF000Fu) | size << 4;
+        *payload = type * size;
+    } else {
+        *payload = size;
+    }
+    return bh;
+}
+
+/* data_read_size as vl53l8cx_start_ranging() computes it */
+static uint32_t frame_size(uint32_t zones, bool profile)
+{
+    uint32_t n = 0, payload;
+
+    for (uint32_t i = 0; i < count_of(all_outputs); i++) {
+        if (profile && !in_profile(all_outputs[i]))
+            continue;
+        (void)block(all_outputs[i], zones, &payload);
+        n += payload + 4;
+    }
+    return n + 24;
+}
+
+static void put_be32(uint8_t *b, uint32_t v)
+{
+    b[0] = (uint8_t)(v >> 24);
+    b[1] = (uint8_t)(v >> 16);
+    b[2] = (uint8_t)(v >> 8);
+    b[3] = (uint8_t)v;
+}
+
+/* one frame in sensor byte order (big-endian words) */
+static uint32_t make_frame(uint8_t *out, uint32_t zones, prng_t *rng)
+{
+    uint32_t size = frame_size(zones, true), i = 16, payload;
+    uint32_t hdr_id = prng_below(rng, 0x10000);
+    static uint8_t f[VL53L8CX_TEMPORARY_BUFFER_SIZE];
+
+    memset(f, 0, size);             // the footer block header stays 0
+    for (uint32_t k = 0; k < 16; k++)
+        f[k] = (uint8_t)prng_u32(rng);
+    f[8] = (uint8_t)(hdr_id >> 8);
+    f[9] = (uint8_t)hdr_id;
+    for (uint32_t k = 1; k < count_of(all_outputs); k++) {
+        if (!in_profile(all_outputs[k]))
+            continue;
+        uint32_t bh = block(all_outputs[k], zones, &payload), idx = bh >> 16;
+
+        f[i] = (uint8_t)bh;
+        f[i + 1] = (uint8_t)(bh >> 8);
+        f[i + 2] = (uint8_t)(bh >> 16);
+        f[i + 3] = (uint8_t)(bh >> 24);
+        for (uint32_t z = 0; z < payload; z++)
+            f[i + 4 + z] = (uint8_t)prng_u32(rng);
+        if (idx == VL53L8CX_NB_TARGET_DETECTED_IDX) {
+            for (uint32_t z = 0; z < payload; z++)
+                f[i + 4 + z] = (uint8_t)prng_below(rng, VL53L8CX_NB_TARGET_PER_ZONE + 1u);
+        } else if (idx == VL53L8CX_TARGET_STATUS_IDX) {
+            for (uint32_t z = 0; z < payload; z++)
+                f[i + 4 + z] = (uint8_t)(prng_below(rng, 3) ? 5 : prng_below(rng, 256));
+        }
+        i += 4 + payload;
+    }
+    // footer id: mostly the header's, damaged in one frame out of eight
+    uint32_t ftr_id = prng_below(rng, 8) ? hdr_id : hdr_id ^ (1u << prng_below(rng, 16));
+    f[size - 4] = (uint8_t)(ftr_id >> 8);
+    f[size - 3] = (uint8_t)ftr_id;
+
+    for (i = 0; i < size; i += 4)
+        put_be32(&out[i], (uint32_t)f[i] | (uint32_t)f[i + 1] << 8 |
+                          (uint32_t)f[i + 2] << 16 | (uint32_t)f[i + 3] << 24);
+    return size;
+}
+
+/* ---------- comparison ---------- */
+static VL53L8CX_Configuration dev;
+
+static uint8_t stock(const uint8_t *raw, uint32_t size, VL53L8CX_ResultsData *r)
+{
+    static uint8_t buf[VL53L8CX_TEMPORARY_BUFFER_SIZE] __attribute__((aligned(4)));
+
+    memcpy(buf, raw, size);
+    dev.data_read_size = size;
+    return vl53l8cx_decode_ranging_data(&dev, buf, r);
+}
+
+static void compare(const uint8_t *raw, uint32_t size, uint32_t zones, uint32_t n)
+{
+    static VL53L8CX_ResultsData a, b;
+    uint32_t targets = zones * VL53L8CX_NB_TARGET_PER_ZONE;
+
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+    uint8_t sa = stock(raw, size, &a);
+    uint8_t sb = vl53_frame_decode(raw, size, &b);
+
+    if (sa != sb)
+        FAIL("frame %u: status %u, stock %u\n", n, sb, sa);
+    if (a.silicon_temp_degc != b.silicon_temp_degc)
+        FAIL("frame %u: temperature %d, stock %d\n", n, b.silicon_temp_degc, a.silicon_temp_degc);
+#ifndef VL53L8CX_DISABLE_NB_TARGET_DETECTED
+    if (memcmp(a.nb_target_detected, b.nb_target_detected, zones))
+        FAIL("frame %u: nb_target_detected differs\n", n);
+#endif
+    for (uint32_t t = 0; t < targets; t++) {
+        if (a.distance_mm[t] != b.distance_mm[t]) {
+            FAIL("frame %u: distance[%u] %d, stock %d\n", n, t, b.distance_mm[t], a.distance_mm[t]);
+            break;
+        }
+        if (a.target_status[t] != b.target_status[t]) {
+            FAIL("frame %u: status[%u] %u, stock %u\n", n, t, b.target_status[t], a.target_status[t]);
+            break;
+        }
+    }
+}
+
+static uint32_t recorded(const char *path, uint32_t zones)
+{
+    static uint8_t raw[VL53L8CX_TEMPORARY_BUFFER_SIZE] __attribute__((aligned(4)));
+    uint32_t size = frame_size(zones, true), n = 0;
+    FILE *f = fopen(path, "rb");
+
+    if (!f) {
+        FAIL("%s: cannot open\n", path);
+        return 0;
+    }
+    while (fread(raw, 1, size, f) == size)
+        compare(raw, size, zones, n++);
+    fclose(f);
+    return n;
+}
+
+static double ns_per_frame(bool fused, const uint8_t *raw, uint32_t size, uint32_t reps)
+{
+    static VL53L8CX_ResultsData r;
+    static uint8_t buf[VL53L8CX_TEMPORARY_BUFFER_SIZE] __attribute__((aligned(4)));
+    uint64_t t0 = cpu_time_ns();
+
+    dev.data_read_size = size;
+    for (uint32_t i = 0; i < reps; i++) {
+        if (fused) {
+            (void)vl53_frame_decode(raw, size, &r);
+        } else {
+            memcpy(buf, raw, size);     // the stock parser swaps in place
+            (void)vl53l8cx_decode_ranging_data(&dev, buf, &r);
+        }
+    }
+    return (double)(cpu_time_ns() - t0) / reps;
+}
+
+int main(int argc, char **argv)
+{
+    static uint8_t raw[VL53L8CX_TEMPORARY_BUFFER_SIZE] __attribute__((aligned(4)));
+    uint32_t frames = 20000, zones = 64;
+    uint64_t seed = 42;
+    const char *path = NULL;
+    prng_t rng;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:r:z:")) != -1) {
+        switch (opt) {
+            case 'n': frames = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 's': seed = strtoull(optarg, NULL, 0); break;
+            case 'r': path = optarg; break;
+            case 'z': zones = (uint32_t)strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-n frames] [-s seed] [-r frames.bin -z 16|64]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (zones != 16 && zones != 64) {
+        fprintf(stderr, "-z: 16 or 64 zones\n");
+        return 1;
+    }
+    prng_seed(&rng, seed, 1);
+
+    if (path) {
+        uint32_t n = recorded(path, zones);
+        printf("%s: %u recorded frames of %u bytes compared\n", path, n, frame_size(zones, true));
+    } else {
+        for (uint32_t n = 0; n < frames; n++) {
+            uint32_t z = (n & 1u) ? 16u : 64u;
+            uint32_t size = make_frame(raw, z, &rng);
+            compare(raw, size, z, n);
+        }
+        printf("%u synthetic frames (4x4 and 8x8) compared\n", frames);
+    }
+
+    uint32_t full = frame_size(64, false), prof = frame_size(64, true);
+    if (prof > VL53L8CX_MAX_RESULTS_SIZE)
+        FAIL("profile frame %u bytes, VL53L8CX_MAX_RESULTS_SIZE %u\n", prof, (uint32_t)VL53L8CX_MAX_RESULTS_SIZE);
+    printf("8x8 frame: %u bytes with all outputs, %u with the profile\n", full, prof);
+    static const uint32_t khz[] = { 100, 400, 1000 };
+    for (uint32_t k = 0; k < count_of(khz); k++)
+        printf("  %4u kHz: %6.2f ms -> %5.2f ms on the bus per frame\n", khz[k],
+               (full + 4) * 9.0 / khz[k], (prof + 4) * 9.0 / khz[k]);
+
+    const uint32_t reps = 200000;
+    uint32_t size = make_frame(raw, 64, &rng);
+    double t_stock = ns_per_frame(false, raw, size, reps);
+    double t_fused = ns_per_frame(true, raw, size, reps);
+    printf("conversion, 8x8 profile frame: stock %.0f ns, fused %.0f ns per frame on this host\n",
+           t_stock, t_fused);
+
+    printf("%s: %u errors\n", errors ? "FAIL" : "OK", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,212 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * VL53 zone replay for the tree app.
+ * Feeds recorded zone frames through vl53_zones.c and the pattern engine
+ * (pattern step(s) + led_pattern_modulate) and measures the time from
+ * publishing a frame to the modulated pixel buffer.
+ *
+ *   vl53_replay [-p pattern] [-o out.ppm] capture.txt
+ *   vl53_replay [-p pattern] -s                 synthetic hand sweep
+ *
+ * Capture lines come from the firmware built with _VL53_CSV_DEBUG_:
+ *   Z,<time_ms>,<zones>,<distance_mm x zones>,<target_status x zones>
+ * Other lines of the USB log are skipped.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"       // host stub: uint, count_of
+#include "config.h"
+#include "led_pattern.h"
+#include "vl53_zones.h"
+
+#define WS2815_BIT_US       1.0     // 1 MHz PIO clock in ws2815_control_dma.c
+#define RENDER_PERIOD_MS    40      // ws2815_pattern_loop renders every 2nd 20 ms tick
+
+typedef struct {
+    uint32_t time_ms;
+    uint8_t  zones;
+    int16_t  distance_mm[VL53_ZONES_MAX];
+    uint8_t  target_status[VL53_ZONES_MAX];
+} replay_frame_t;
+
+static uint32_t pattern_buf[NUM_PIXELS];
+static uint32_t out_buf[NUM_PIXELS];
+static uint8_t frame_rgb[NUM_PIXELS * 3];
+
+static uint64_t cpu_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int parse_line(const char *line, replay_frame_t *fr) {
+    char *end;
+    const char *p = line;
+
+    if (strncmp(p, "Z,", 2) != 0)
+        return 0;
+    p += 2;
+    fr->time_ms = (uint32_t)strtoul(p, &end, 10);
+    if (*end != ',')
+        return 0;
+    fr->zones = (uint8_t)strtoul(end + 1, &end, 10);
+    if (fr->zones != 16 && fr->zones != 64)
+        return 0;
+    for (int i = 0; i < fr->zones; i++) {
+        if (*end != ',')
+            return 0;
+        fr->distance_mm[i] = (int16_t)strtol(end + 1, &end, 10);
+    }
+    for (int i = 0; i < fr->zones; i++) {
+        if (*end != ',')
+            return 0;
+        fr->target_status[i] = (uint8_t)strtoul(end + 1, &end, 10);
+    }
+    return 1;
+}
+
+/**
+ * Synthetic capture: a hand moves across the 8x8 field while approaching
+ * from 2 m to 20 cm, 15 Hz frames.
+ */
+static int synth_frame(uint32_t n, replay_frame_t *fr) {
+    const uint32_t frames = 150;
+    if (n >= frames)
+        return 0;
+
+    int col = (int)(n * 8 / frames);
+    int16_t hand = (int16_t)(2000 - (int)(n * 1800 / frames));
+
+    fr->time_ms = n * 66;
+    fr->zones = 64;
+    for (int z = 0; z < 64; z++) {
+        int x = z % 8;
+        bool in_hand = (x == col || x == col + 1) && (z / 8) >= 2 && (z / 8) <= 5;
+        fr->distance_mm[z] = in_hand ? hand : 3500;     // wall behind
+        fr->target_status[z] = 5;
+    }
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    int pat = 0, synth = 0, opt;
+    const char *ppm_name = NULL;
+    uint64_t total = 0, worst = 0;
+    uint32_t count = 0;
+    uint16_t speed_acc = 0;
+    replay_frame_t fr;
+    FILE *in = NULL, *ppm = NULL;
+
+    while ((opt = getopt(argc, argv, "p:o:s")) != -1) {
+        switch (opt) {
+        case 'p': pat = atoi(optarg); break;
+        case 'o': ppm_name = optarg; break;
+        case 's': synth = 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-p 0..4] [-o out.ppm] (-s | capture.txt)\n", argv[0]);
+            return 2;
+        }
+    }
+
+    static const pattern patterns[] = {
+        pattern_rainbow, pattern_breath, pattern_twinkle, pattern_christmas_palette, pattern_snakes3
+    };
+    if (pat < 0 || pat >= (int)count_of(patterns))
+        pat = 0;
+
+    if (!synth) {
+        if (optind >= argc || !(in = fopen(argv[optind], "r"))) {
+            perror("capture");
+            return 1;
+        }
+    }
+    if (ppm_name) {
+        ppm = fopen(ppm_name, "wb");
+        if (!ppm) {
+            perror("fopen");
+            return 1;
+        }
+        // header is rewritten with the final row count at the end
+        fprintf(ppm, "P6\n%d %10u\n255\n", NUM_PIXELS, 0u);
+    }
+
+    init_start_strips();
+
+    char line[2048];
+    for (uint32_t n = 0;; n++) {
+        if (synth) {
+            if (!synth_frame(n, &fr))
+                break;
+        } else {
+            if (!fgets(line, sizeof(line), in))
+                break;
+            if (!parse_line(line, &fr))
+                continue;
+        }
+
+        // sensor frame in -> modulated pixels out, as in the firmware
+        uint64_t t0 = cpu_time_ns();
+        pattern_mod_t mod;
+        uint32_t now_us = fr.time_ms * 1000u;
+
+        vl53_zones_publish(fr.distance_mm, fr.target_status, fr.zones, now_us);
+        vl53_zones_get_modulation(&mod, now_us);
+        speed_acc = (uint16_t)(speed_acc + mod.speed);
+        for (uint32_t steps = speed_acc >> 7; steps; steps--)
+            patterns[pat](pattern_buf, NUM_PIXELS, 1);
+        speed_acc &= 0x7F;
+        led_pattern_modulate(out_buf, pattern_buf, NUM_PIXELS, &mod);
+        uint64_t dt = cpu_time_ns() - t0;
+
+        total += dt;
+        if (dt > worst)
+            worst = dt;
+        count++;
+
+        const vl53_features_t *f = vl53_zones_get_features();
+        printf("%6u ms  near=%4u mm  cx=%5.2f  motion=%3u  -> speed=%3u bri=%3u hue=%3u  %.2f us\n",
+               fr.time_ms, f->nearest_mm, f->centroid_x_q8 / 256.0, f->motion_mm,
+               mod.speed, mod.brightness, mod.hue, (double)dt / 1000.0);
+
+        if (ppm) {
+            for (uint32_t i = 0; i < NUM_PIXELS; i++) {
+                frame_rgb[i * 3 + 0] = (uint8_t)(out_buf[i] >> 24);
+                frame_rgb[i * 3 + 1] = (uint8_t)(out_buf[i] >> 16);
+                frame_rgb[i * 3 + 2] = (uint8_t)(out_buf[i] >> 8);
+            }
+            fwrite(frame_rgb, 1, sizeof(frame_rgb), ppm);
+        }
+    }
+
+    if (ppm) {
+        fseek(ppm, 0, SEEK_SET);
+        fprintf(ppm, "P6\n%d %10u\n255\n", NUM_PIXELS, count);
+        fclose(ppm);
+    }
+    if (in)
+        fclose(in);
+
+    if (!count) {
+        fprintf(stderr, "no frames\n");
+        return 1;
+    }
+
+    double dma_ms = NUM_PIXELS * 24 * WS2815_BIT_US / 1000.0;
+    fprintf(stderr,
+            "frames=%u  publish->pixels avg=%.2f us max=%.2f us\n"
+            "sensor-to-pixel on target adds: render tick wait <= %d ms, DMA %.1f ms, latch 0.35 ms\n",
+            count, (double)total / count / 1000.0, (double)worst / 1000.0,
+            RENDER_PERIOD_MS, dma_ms);
+    return 0;
+}
@@ -0,0 +1,289 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * Zone map processing of the kitchen app (kitchen_pwm/vl53_scene.c) on
+ * recorded or synthetic VL53L8CX frames, with its cost per frame.
+ *
+ *   vl53_scene_replay [-v] capture.txt       frames from the USB log
+ *   vl53_scene_replay [-v] -s [-r seed]      synthetic kitchen, checked
+ *
+ * Capture lines come from kitchen_pwm built with _VL53_CSV_DEBUG_ (the
+ * format of tree_ws2815 and vl53_replay):
+ *   Z,<time_ms>,<zones>,<distance_mm x zones>,<target_status x zones>
+ *
+ * The synthetic kitchen is 8x8 at 15 Hz with per zone noise, spikes and
+ * dropouts in front of a wall and a counter: empty for 10 s, someone
+ * walking in and towards the sensor at 0.3 m/s, two people side by side at
+ * different depths, then a box put down that has to fade into the
+ * background. Checked: no blobs in the empty kitchen, the walker found
+ * with its centroid and approach velocity, two blobs for two people, the
+ * box absorbed, and the cost per frame.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RENDER_KEEP_PRINTF            // this file reports on stdout
+#include "pico/stdio.h"
+#include "vl53_scene.h"
+#include "prng.h"
+
+#define FRAME_MS        66          // 15 Hz
+#define BUDGET_US       1000        // per frame on the target
+
+typedef struct {
+    uint32_t time_ms;
+    uint8_t  zones;
+    int16_t  distance_mm[VL53_SCENE_ZONES];
+    uint8_t  target_status[VL53_SCENE_ZONES];
+} replay_frame_t;
+
+static uint32_t errors;
+static bool verbose;
+
+#define FAIL(...) do { if (errors++ < 10) printf(__VA_ARGS__); } while (0)
+
+static uint64_t cpu_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int parse_line(const char *line, replay_frame_t *fr)
+{
+    char *end;
+
+    if (strncmp(line, "Z,", 2) != 0)
+        return 0;
+    fr->time_ms = (uint32_t)strtoul(line + 2, &end, 10);
+    if (*end != ',')
+        return 0;
+    fr->zones = (uint8_t)strtoul(end + 1, &end, 10);
+    if (fr->zones != 16 && fr->zones != 64)
+        return 0;
+    for (int i = 0; i < fr->zones; i++) {
+        if (*end != ',')
+            return 0;
+        fr->distance_mm[i] = (int16_t)strtol(end + 1, &end, 10);
+    }
+    for (int i = 0; i < fr->zones; i++) {
+        if (*end != ',')
+            return 0;
+        fr->target_status[i] = (uint8_t)strtoul(end + 1, &end, 10);
+    }
+    return 1;
+}
+
+/* ---------- cost ---------- */
+static uint64_t cost_sum, cost_max;
+static uint32_t cost_n;
+
+static const vl53_scene_t *process(const replay_frame_t *fr)
+{
+    uint64_t t0 = cpu_time_ns();
+    const vl53_scene_t *sc = vl53_scene_frame(fr->distance_mm, fr->target_status, fr->zones, fr->time_ms);
+    uint64_t dt = cpu_time_ns() - t0;
+
+    cost_sum += dt;
+    if (dt > cost_max)
+        cost_max = dt;
+    cost_n++;
+
+    if (verbose) {
+        printf("%7u ms fg %2u", fr->time_ms, sc->fg_zones);
+        for (uint8_t i = 0; i < sc->n_blobs; i++) {
+            const vl53_blob_t *b = &sc->blob[i];
+            printf("  #%u %uz (%.1f,%.1f) %u mm %+d mm/s", b->id, b->zones,
+                   b->cx_q8 / 256.0, b->cy_q8 / 256.0, b->mm, b->velocity_mm_s);
+        }
+        printf("\n");
+    }
+    return sc;
+}
+
+/* ---------- synthetic kitchen ---------- */
+typedef struct {
+    double col, row;            // top left zone
+    int    w, h;                // zones
+    double mm;
+} object_t;
+
+static prng_t rng;
+
+static double noise(double sigma)
+{
+    double s = 0;
+    for (int i = 0; i < 4; i++)
+        s += prng_u32(&rng) / 4294967296.0 - 0.5;
+    return s * sigma * 1.732;
+}
+
+static bool covers(const object_t *o, int col, int row)
+{
+    int c0 = (int)lround(o->col), r0 = (int)lround(o->row);
+    return col >= c0 && col < c0 + o->w && row >= r0 && row < r0 + o->h;
+}
+
+static void synth(replay_frame_t *fr, uint32_t t_ms, const object_t *obj, int n_obj)
+{
+    fr->time_ms = t_ms;
+    fr->zones = 64;
+    for (int z = 0; z < 64; z++) {
+        int col = z % 8, row = z / 8;
+        double mm = (row >= 6) ? 900 + 40 * abs(col - 4) : 3100 + 60 * col;   // counter below, wall behind
+
+        for (int i = 0; i < n_obj; i++)
+            if (covers(&obj[i], col, row) && obj[i].mm < mm)
+                mm = obj[i].mm;
+        mm += noise(mm / 150.0);
+        if (prng_below(&rng, 40) == 0)
+            mm += (prng_below(&rng, 2) ? 600 : -600);           // ranging spike
+
+        fr->distance_mm[z] = (int16_t)lround(mm);
+        fr->target_status[z] = (prng_below(&rng, 12) == 0) ? (prng_below(&rng, 2) ? 255 : 4) : 5;
+        if (row == 0 && col == 7)
+            fr->target_status[z] = 255;                         // a corner that never ranges
+    }
+}
+
+static void run_synthetic(void)
+{
+    uint32_t empty_frames = 0, empty_blob = 0;
+    uint32_t walk_frames = 0, walk_found = 0, walk_vel_ok = 0, walk_pos_ok = 0, walk_vel_n = 0;
+    uint32_t pair_frames = 0, pair_ok = 0;
+    uint32_t box_frames = 0, box_seen = 0, box_late = 0, box_late_blob = 0;
+    replay_frame_t fr;
+
+    vl53_scene_reset();
+    for (uint32_t t = 0; t < 75000; t += FRAME_MS) {
+        object_t obj[2];
+        int n = 0;
+        double walk_col = 0, walk_mm = 0;
+
+        if (t >= 10000 && t < 20000) {
+            // walker: in from the right, towards the sensor at 0.3 m/s, 2x4 zones
+            double s = (t - 10000) / 1000.0;
+            walk_col = 5.0 - s * 0.3;
+            walk_mm = 2900 - 300 * s;
+            if (walk_mm < 600)
+                walk_mm = 600;
+            obj[n++] = (object_t){ walk_col, 1, 2, 4, walk_mm };
+        } else if (t >= 25000 && t < 30000) {
+            obj[n++] = (object_t){ 2, 1, 2, 4, 1200 };
+            obj[n++] = (object_t){ 4, 1, 2, 4, 2200 };
+        } else if (t >= 35000) {
+            obj[n++] = (object_t){ 3, 4, 2, 2, 1500 };          // a box put down, stays
+        }
+        synth(&fr, t, obj, n);
+        const vl53_scene_t *sc = process(&fr);
+
+        if (t >= 2000 && t < 10000) {
+            empty_frames++;
+            empty_blob += sc->n_blobs != 0;
+        } else if (t >= 11000 && t < 20000) {
+            const vl53_blob_t *b = sc->n_blobs ? &sc->blob[0] : NULL;
+            walk_frames++;
+            if (!b)
+                continue;
+            walk_found++;
+            // centroid of a 2 wide block starting at walk_col: walk_col + 0.5, row 2.5
+            double cx = lround(walk_col) + 0.5;
+            if (fabs(b->cx_q8 / 256.0 - cx) <= 0.75 && fabs(b->cy_q8 / 256.0 - 2.5) <= 0.75)
+                walk_pos_ok++;
+            if (walk_mm > 700) {
+                walk_vel_n++;
+                if (b->velocity_mm_s < -200 && b->velocity_mm_s > -400)
+                    walk_vel_ok++;
+            }
+        } else if (t >= 25500 && t < 30000) {
+            bool near = false, far = false;
+            pair_frames++;
+            for (uint8_t i = 0; i < sc->n_blobs; i++) {
+                near |= abs(sc->blob[i].mm - 1200) < 150;
+                far |= abs(sc->blob[i].mm - 2200) < 250;
+            }
+            pair_ok += near && far;
+        } else if (t >= 35500 && t < 40000) {
+            box_frames++;
+            box_seen += sc->n_blobs != 0;
+        } else if (t >= 35000 + VL53_SCENE_ABSORB_FRAMES * FRAME_MS + 3000) {
+            box_late++;
+            box_late_blob += sc->n_blobs != 0;
+        }
+    }
+
+    printf("synthetic kitchen, 8x8 at 15 Hz, 75 s:\n");
+    printf("  empty     : %u of %u frames with a blob\n", empty_blob, empty_frames);
+    printf("  walker    : found %u / %u, centroid ok %u, velocity -300 mm/s +-100 %u / %u\n",
+           walk_found, walk_frames, walk_pos_ok, walk_vel_ok, walk_vel_n);
+    printf("  two people: both blobs in %u / %u frames\n", pair_ok, pair_frames);
+    printf("  box       : seen in %u / %u frames after it was put down, %u of %u frames with a blob once absorbed\n",
+           box_seen, box_frames, box_late_blob, box_late);
+
+    if (empty_blob * 100 > empty_frames)
+        FAIL("empty kitchen: blobs in %u of %u frames\n", empty_blob, empty_frames);
+    if (walk_found * 100 < walk_frames * 95 || walk_pos_ok * 100 < walk_found * 90)
+        FAIL("walker: found %u, centroid ok %u of %u frames\n", walk_found, walk_pos_ok, walk_frames);
+    if (walk_vel_ok * 100 < walk_vel_n * 85)
+        FAIL("walker: velocity within 100 mm/s in %u of %u frames\n", walk_vel_ok, walk_vel_n);
+    if (pair_ok * 100 < pair_frames * 90)
+        FAIL("two people: both in %u of %u frames\n", pair_ok, pair_frames);
+    if (box_seen * 100 < box_frames * 95 || box_late_blob)
+        FAIL("box: seen %u frames, %u frames with a blob after absorption\n", box_seen, box_late_blob);
+}
+
+int main(int argc, char **argv)
+{
+    bool synthetic = false;
+    uint64_t seed = 43;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "vsr:")) != -1) {
+        switch (opt) {
+            case 'v': verbose = true; break;
+            case 's': synthetic = true; break;
+            case 'r': seed = strtoull(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-v] (-s [-r seed] | capture.txt)\n", argv[0]);
+                return 1;
+        }
+    }
+    prng_seed(&rng, seed, 1);
+
+    if (synthetic) {
+        run_synthetic();
+    } else {
+        static char line[4096];
+        replay_frame_t fr;
+        uint32_t blob_frames = 0;
+        FILE *in;
+
+        if (optind >= argc || !(in = fopen(argv[optind], "r"))) {
+            fprintf(stderr, "usage: %s [-v] (-s [-r seed] | capture.txt)\n", argv[0]);
+            return 1;
+        }
+        vl53_scene_reset();
+        while (fgets(line, sizeof(line), in))
+            if (parse_line(line, &fr))
+                blob_frames += process(&fr)->n_blobs != 0;
+        fclose(in);
+        printf("%s: %u frames, %u with a blob\n", argv[optind], cost_n, blob_frames);
+    }
+
+    if (cost_n) {
+        printf("  cost: mean %.2f us, max %.2f us per frame on this host (budget %u us on the target)\n",
+               cost_sum / 1000.0 / cost_n, cost_max / 1000.0, BUDGET_US);
+    }
+    printf("%s: %u errors\n", errors ? "FAIL" : "OK", errors);
+    return errors ? 1 : 0;
+}
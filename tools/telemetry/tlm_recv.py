@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+# Receiver of the live telemetry datagrams (common/utils/telemetry.h)
+#
+# The boards send one datagram per period (UDP_TLM_PERIOD_MS, "tlm rate")
+# to UDP_TLM_DESTIP:UDP_TLM_PORT (config.h, "tlm dest"). Counters and
+# histogram counts are totals since boot; this shows what changed since the
+# previous datagram: rates per second, and count / mean / p50 / p95 / max
+# of every histogram. p50 / p95 are the upper edges of log2 buckets.
+#
+#   $ python3 tools/telemetry/tlm_recv.py                   # port 3000, text
+#   $ python3 tools/telemetry/tlm_recv.py --json            # one JSON line per datagram
+#   $ python3 tools/telemetry/tlm_recv.py --plot led_frames irq_latency_us
+#   $ build_render/telemetry_test -d 3000 &                 # synthetic stream to localhost
+
+import argparse
+import json
+import socket
+import struct
+import sys
+
+VERSION = 1
+HEADER = struct.Struct("<2sBBIIHBB")
+BUCKETS = 24
+
+# ids of telemetry.h, same order
+COUNTERS = [
+    "ddp_pkts", "ddp_bytes", "ddp_errors", "ddp_overruns", "ddp_frames",
+    "led_frames", "led_drops", "sensor_frames", "sensor_errors",
+    "radar_frames", "radar_errors", "sched_overruns", "sched_misses",
+    "cli_lines", "tx_skipped",
+]
+HISTS = [
+    "irq_latency_us", "irq_us", "ddp_service_us", "render_us",
+    "encode_us", "dma_us", "frame_gap_us",
+]
+
+
+def name(table, i):
+    return table[i] if i < len(table) else "id%d" % i
+
+
+def decode(data):
+    """One datagram to a dict; ValueError when it is not one"""
+    if len(data) < HEADER.size:
+        raise ValueError("short datagram")
+    magic, ver, _flags, seq, uptime, period, nc, nh = HEADER.unpack_from(data)
+    if magic != b"TM" or ver != VERSION:
+        raise ValueError("not a telemetry datagram v%d" % VERSION)
+    pos = HEADER.size
+    out = {"seq": seq, "uptime_ms": uptime, "period_ms": period,
+           "counters": {}, "hists": {}}
+    for _ in range(nc):
+        cid, value = struct.unpack_from("<BI", data, pos)
+        pos += 5
+        out["counters"][name(COUNTERS, cid)] = value
+    for _ in range(nh):
+        hid, count, total, vmax, mask = struct.unpack_from("<BIIII", data, pos)
+        pos += 17
+        buckets = [0] * BUCKETS
+        for b in range(BUCKETS):
+            if mask >> b & 1:
+                buckets[b], = struct.unpack_from("<I", data, pos)
+                pos += 4
+        out["hists"][name(HISTS, hid)] = {"count": count, "sum": total,
+                                          "max": vmax, "buckets": buckets}
+    if pos != len(data):
+        raise ValueError("%d bytes left over" % (len(data) - pos))
+    return out
+
+
+def bucket_top(b):
+    """largest value of bucket b, the last one is open"""
+    return 0 if b == 0 else (1 << b) - 1
+
+
+def percentile(buckets, p):
+    n = sum(buckets)
+    if not n:
+        return 0
+    acc = 0
+    for b, c in enumerate(buckets):
+        acc += c
+        if acc * 100 >= p * n:
+            return bucket_top(b)
+    return bucket_top(BUCKETS - 1)
+
+
+def diff(cur, prev):
+    """what changed between two datagrams of one boot"""
+    dt = (cur["uptime_ms"] - prev["uptime_ms"]) / 1000.0 or 1e-3
+    d = {"seq": cur["seq"], "uptime_ms": cur["uptime_ms"], "dt": dt,
+         "lost": (cur["seq"] - prev["seq"] - 1) & 0xFFFFFFFF,
+         "rates": {}, "hists": {}}
+    for k, v in cur["counters"].items():
+        d["rates"][k] = ((v - prev["counters"].get(k, 0)) & 0xFFFFFFFF) / dt
+    for k, h in cur["hists"].items():
+        p = prev["hists"].get(k, {"count": 0, "sum": 0, "buckets": [0] * BUCKETS})
+        n = (h["count"] - p["count"]) & 0xFFFFFFFF
+        s = (h["sum"] - p["sum"]) & 0xFFFFFFFF
+        bk = [(a - b) & 0xFFFFFFFF for a, b in zip(h["buckets"], p["buckets"])]
+        top = h["max"] or bucket_top(BUCKETS - 1)     # a bucket edge above the max says less
+        d["hists"][k] = {"n": n, "mean": s / n if n else 0.0, "max": h["max"],
+                         "p50": min(percentile(bk, 50), top), "p95": min(percentile(bk, 95), top)}
+    return d
+
+
+def show(src, d):
+    lines = ["%s seq %u  up %.1f s  dt %.2f s%s" % (
+        src, d["seq"], d["uptime_ms"] / 1000.0, d["dt"],
+        ("  LOST %u" % d["lost"]) if d["lost"] else "")]
+    rates = "  ".join("%s %.1f/s" % (k, v) for k, v in d["rates"].items())
+    if rates:
+        lines.append("  " + rates)
+    for k, h in d["hists"].items():
+        lines.append("  %-15s n %6u  mean %8.1f  p50 %6u  p95 %6u  max %6u" % (
+            k, h["n"], h["mean"], h["p50"], h["p95"], h["max"]))
+    print("\n".join(lines), flush=True)
+
+
+def value_of(d, metric):
+    """a rate for a counter, the mean for a histogram ("dma_us.max" for another field)"""
+    key, _, field = metric.partition(".")
+    if key in d["hists"]:
+        return d["hists"][key][field or "mean"]
+    return d["rates"].get(key)
+
+
+class Plot:
+    def __init__(self, metrics, points=300):
+        import matplotlib.pyplot as plt     # only needed for --plot
+        self.plt = plt
+        self.metrics = metrics
+        self.points = points
+        self.t = []
+        self.y = {m: [] for m in metrics}
+        plt.ion()
+        self.fig, axes = plt.subplots(len(metrics), 1, sharex=True, squeeze=False)
+        self.lines = {}
+        for ax, m in zip(axes[:, 0], metrics):
+            self.lines[m], = ax.plot([], [])
+            ax.set_ylabel(m)
+        axes[-1, 0].set_xlabel("uptime s")
+
+    def add(self, d):
+        self.t = (self.t + [d["uptime_ms"] / 1000.0])[-self.points:]
+        for m in self.metrics:
+            v = value_of(d, m)
+            self.y[m] = (self.y[m] + [float("nan") if v is None else v])[-self.points:]
+            self.lines[m].set_data(self.t, self.y[m])
+            self.lines[m].axes.relim()
+            self.lines[m].axes.autoscale_view()
+        self.plt.pause(0.001)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Receiver of the board telemetry datagrams")
+    ap.add_argument("--port", type=int, default=3000)
+    ap.add_argument("--bind", default="0.0.0.0")
+    ap.add_argument("--count", type=int, default=0, help="exit after N datagrams")
+    ap.add_argument("--timeout", type=float, default=0, help="exit after S seconds without one")
+    ap.add_argument("--json", action="store_true", help="one JSON line per datagram")
+    ap.add_argument("--raw", action="store_true", help="totals as sent, not differences")
+    ap.add_argument("--plot", nargs="+", metavar="METRIC",
+                    help="live plot: counter rates, histogram means (dma_us.p95 ...)")
+    args = ap.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.bind, args.port))
+    if args.timeout:
+        sock.settimeout(args.timeout)
+    plot = Plot(args.plot) if args.plot else None
+    prev = {}
+    got = bad = 0
+
+    while not args.count or got < args.count:
+        try:
+            data, addr = sock.recvfrom(2048)
+        except socket.timeout:
+            print("no datagram for %.1f s" % args.timeout, file=sys.stderr)
+            return 1
+        try:
+            cur = decode(data)
+        except (ValueError, struct.error) as e:
+            bad += 1
+            print("%s: %s" % (addr[0], e), file=sys.stderr)
+            continue
+        got += 1
+        src = addr[0]
+        last = prev.get(src)
+        prev[src] = cur
+        if args.raw:
+            print(json.dumps(dict(cur, src=src)) if args.json else "%s %s" % (src, cur), flush=True)
+            continue
+        if last is None or cur["seq"] <= last["seq"] or cur["uptime_ms"] < last["uptime_ms"]:
+            print("%s: stream start, seq %u, up %.1f s" % (
+                src, cur["seq"], cur["uptime_ms"] / 1000.0), flush=True)
+            continue        # first one or a reboot: nothing to take the difference with
+        d = diff(cur, last)
+        if args.json:
+            print(json.dumps(dict(d, src=src)), flush=True)
+        else:
+            show(src, d)
+        if plot:
+            plot.add(d)
+    return 1 if bad else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
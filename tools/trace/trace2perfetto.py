@@ -0,0 +1,180 @@
+#!/usr/bin/env python3
+# Decoder of the hot path trace rings (common/utils/trace.h)
+#
+# "trace dump" on the board CLI prints the rings of both cores as text; this
+# turns them into Chrome trace JSON, opened by https://ui.perfetto.dev or
+# chrome://tracing. One track per core: spans (W6100 IRQ, ddp_loop, tasks,
+# render, encode, EFU erase / program) nest, instants are marks, the DMA of
+# a frame is an async slice from its start to its end IRQ.
+#
+#   $ python3 tools/trace/trace2perfetto.py --host 192.168.178.50 -o trace.json
+#   $ python3 tools/trace/trace2perfetto.py dump.txt -o trace.json    # saved "trace dump" output
+#   $ build_render/trace_test -d | python3 tools/trace/trace2perfetto.py - -o trace.json
+
+import argparse
+import json
+import socket
+import sys
+
+VERSION = 1
+
+
+def fetch(host, port, timeout):
+    """runs "trace dump" on the CLI, returns its lines"""
+    with socket.create_connection((host, port), timeout=timeout) as s:
+        s.sendall(b"trace dump\r\n")
+        data = b""
+        while True:
+            chunk = s.recv(4096)
+            if not chunk:
+                break
+            data += chunk
+            tail = data.rsplit(b"\n", 2)
+            if any(t.lstrip(b"> ").startswith(b"end ") for t in tail[-2:]):
+                break
+        s.sendall(b"exit\r\n")
+    return data.decode("ascii", "replace").splitlines()
+
+
+def signed32(v):
+    v &= 0xFFFFFFFF
+    return v - (1 << 32) if v & 0x80000000 else v
+
+
+def parse(lines):
+    """the dump to {now, names, tasks, events}; ValueError when it is not one"""
+    dump = {"now": None, "names": {}, "tasks": {}, "events": [], "end": None}
+    for line in lines:
+        f = line.strip().lstrip("> ").split()      # the CLI prompt may lead a line
+        if not f:
+            continue
+        if f[0] == "trace" and len(f) >= 8:
+            if int(f[1]) != VERSION:
+                raise ValueError("trace dump v%s, not v%d" % (f[1], VERSION))
+            dump["now"] = int(f[7], 16)
+        elif f[0] == "N" and len(f) == 3:
+            dump["names"][int(f[1])] = f[2]
+        elif f[0] == "T" and len(f) == 3:
+            dump["tasks"][int(f[1])] = f[2]
+        elif f[0] == "E" and len(f) == 7:
+            dump["events"].append((int(f[1]), int(f[2], 16), int(f[3]), f[4],
+                                   int(f[5], 16), int(f[6], 16)))
+        elif f[0] == "end" and len(f) == 2:
+            dump["end"] = int(f[1])
+    if dump["now"] is None:
+        raise ValueError("no trace header")
+    if dump["end"] != len(dump["events"]):
+        raise ValueError("%d events, the dump says %s" % (len(dump["events"]), dump["end"]))
+    return dump
+
+
+def to_chrome(dump):
+    """Chrome trace events; time in us, 0 = oldest event held"""
+    names, tasks = dump["names"], dump["tasks"]
+    # 32 bit us timestamps wrap after 71 min: relative to the dump time
+    evts = [(signed32(e[1] - dump["now"]), n, e) for n, e in enumerate(dump["events"])]
+    evts.sort(key=lambda x: (x[0], x[1]))   # an IRQ may stamp before the slot it preempted
+    t0 = evts[0][0] if evts else 0
+
+    out = [{"ph": "M", "pid": 1, "name": "process_name", "args": {"name": "board"}}]
+    for core in sorted({e[0] for e in dump["events"]}):
+        out.append({"ph": "M", "pid": 1, "tid": core, "name": "thread_name",
+                    "args": {"name": "core %d" % core}})
+    stacks = {}
+    async_open = set()
+    dropped = 0
+    for rel, _, (core, _ts, eid, ph, a, b) in evts:
+        name = names.get(eid, "id%d" % eid)
+        if name == "task" and a in tasks:
+            name = tasks[a]
+        ev = {"name": name, "ph": ph, "ts": rel - t0, "pid": 1, "tid": core,
+              "args": {"a": a, "b": b}}
+        stack = stacks.setdefault(core, [])
+        if ph == "B":
+            stack.append(name)
+        elif ph == "E":
+            if name not in stack:
+                dropped += 1            # began before the oldest event held
+                continue
+            while stack[-1] != name:    # an end lost to the ring: close the inner ones here
+                out.append(dict(ev, name=stack.pop(), args={}))
+            stack.pop()
+        elif ph == "i":
+            ev["s"] = "t"
+        elif ph in "be":
+            key = (name, a)
+            ev.update(cat=name, id=a)
+            if ph == "b":
+                async_open.add(key)
+            elif key in async_open:
+                async_open.discard(key)
+            else:
+                dropped += 1
+                continue
+        out.append(ev)
+    return out, dropped
+
+
+def stats(chrome):
+    """count / mean / max us of every span name"""
+    open_ts, res = {}, {}
+    for ev in chrome:
+        if ev["ph"] in "BE":
+            key = (ev["tid"], ev["name"])
+        else:
+            key = (ev["name"], ev.get("id"))    # async: start and end may be on two cores
+        if ev["ph"] in "Bb":
+            open_ts.setdefault(key, []).append(ev["ts"])
+        elif ev["ph"] in "Ee" and open_ts.get(key):
+            d = ev["ts"] - open_ts[key].pop()
+            r = res.setdefault(ev["name"], [0, 0, 0])
+            r[0] += 1
+            r[1] += d
+            r[2] = max(r[2], d)
+    return res
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Board trace dump to Chrome trace / Perfetto JSON")
+    ap.add_argument("dump", nargs="?", help="saved \"trace dump\" output, - for stdin")
+    ap.add_argument("--host", help="board to run \"trace dump\" on")
+    ap.add_argument("--port", type=int, default=5000, help="CLI port (TCP_CLI_PORT)")
+    ap.add_argument("--timeout", type=float, default=5.0)
+    ap.add_argument("--save", help="keep the text dump too")
+    ap.add_argument("-o", "--out", default="trace.json")
+    args = ap.parse_args()
+
+    if args.host:
+        lines = fetch(args.host, args.port, args.timeout)
+    elif args.dump:
+        with (sys.stdin if args.dump == "-" else open(args.dump)) as f:
+            lines = f.read().splitlines()
+    else:
+        ap.error("a dump file or --host")
+    if args.save:
+        with open(args.save, "w") as f:
+            f.write("\n".join(lines) + "\n")
+
+    try:
+        dump = parse(lines)
+    except ValueError as e:
+        print("not a trace dump: %s" % e, file=sys.stderr)
+        return 1
+    chrome, dropped = to_chrome(dump)
+    with open(args.out, "w") as f:
+        json.dump({"traceEvents": chrome, "displayTimeUnit": "ms"}, f)
+
+    span = 0
+    if dump["events"]:
+        rel = [signed32(e[1] - dump["now"]) for e in dump["events"]]
+        span = max(rel) - min(rel)
+    print("%d events, %.1f ms, %d ends without a start; %s" % (
+        len(dump["events"]), span / 1000.0, dropped, args.out), file=sys.stderr)
+    for name, (n, total, vmax) in sorted(stats(chrome).items()):
+        print("  %-12s n %5d  mean %8.1f us  max %6d us" % (name, n, total / n, vmax),
+              file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
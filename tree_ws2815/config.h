@@ -73,11 +73,12 @@
  * connect example:
  *   $ nc 192.168.14.225 5000
  *   $ telnet 192.168.14.225 5000
+ * Every client gets its own socket, TCP_CLI_SOCKET .. + TCP_CLI_SESSIONS - 1.
  */
-#define TCP_CLI_SOCKET      0
+#define TCP_CLI_SOCKET      2
+#define TCP_CLI_SESSIONS    3      // sockets 2, 3, 4
 #define TCP_CLI_PORT        5000
 #define CLI_TIMEOUT         20   // 20 seconds
-#define CLI_BUF_RX_SIZE     1024
 // #define ETHERNET_BUF_MAX_SIZE 1024
 
 /**
@@ -95,6 +96,25 @@
 #define UDP_DDP_SOCKET      5      // with port UDP_DDP_PORT 4048
 #define UDP_DDP_PORT        4048
 
+/**
+ * Live telemetry: counters and histograms as binary UDP datagrams
+ * (common/utils/telemetry.h), received with
+ *   $ python3 tools/telemetry/tlm_recv.py
+ * Receiver and period can be changed with "tlm dest" and "tlm rate".
+ */
+#define UDP_TLM_SOCKET      6
+#define UDP_TLM_PORT        3000   // local port and receiver port
+#define UDP_TLM_DESTIP      {192, 168, 178, 200}
+#define UDP_TLM_PERIOD_MS   1000   // 0 = off until "tlm rate"
+
+/**
+ * Deferred log (common/utils/dlog.h): text lines as UDP datagrams after
+ * "log udp <a.b.c.d> [port]" on the CLI, received with e.g.
+ *   $ nc -ukl 3001
+ */
+#define UDP_LOG_SOCKET      7
+#define UDP_LOG_PORT        3001   // local port and default receiver port
+
 /**
  * Configuration for future
  */
@@ -102,12 +122,6 @@
 // #define TCP_HTTP_PORT    80
 // #define TCP_OTA_SOCKET   2
 // #define TCP_OTA_PORT     4242
-//  Remote logging & variable view (for live debug)
-//  Example: a UDP packet every second with JSON text like
-//  {"t":27.5,"uptime":3221,"fps":60}
-// #define UDP_DEB_SOCKET   3
-// #define UDP_DESTIP       192.168.14.200
-// #define UDP_DESTPORT     3000
 
 /**
  * Configuration for WS2815 LED strip
@@ -156,6 +170,7 @@
  */
 
 // #define VL53L8CX_DEV // to implement communcation with VL53L8CX sensor
+// #define _VL53_CSV_DEBUG_   // print every zone frame as CSV on USB (for vl53_replay)
 // #define VL53_SPI           spi1
 #ifdef VL53_SPI
 #define VL53_BAUDRATE      4   // 4 MHz for bring-up
@@ -14,6 +14,8 @@
 #include <math.h>
 
 #include "config.h"
+#include "prng.h"
+#include "led_pattern.h"
 
 
 // dir == 1 ? "(forward)" : dir ? "(backward)" : "(still)" dir = [-1, 0, 1]
@@ -99,18 +101,47 @@ static uint32_t start_strip_color[NUM_STRIPS];  // random color with random brig
 static uint32_t start_column_pos[NUM_PIXELS];  // random start positions for patterns
 static uint8_t start_column_sel_color[NUM_PIXELS];  // random color selection for columns
 
+/**
+ * One PRNG stream per pattern (or group of init code), all derived from one
+ * seed, so the patterns are reproducible and do not disturb each other.
+ */
+enum {
+    RNG_START_STRIPS,
+    RNG_WARM_SPARKS,
+    RNG_FALLING_SPARKS,
+    RNG_ORNAMENTS,
+    RNG_ORNAMENT_CLUSTERS,
+    RNG_FADE_CLUSTERS,
+    RNG_GLOBAL_COLOR_FADE,
+    RNG_CLUSTER_COLOR_FADE,
+    RNG_FADE_SHOW,
+    RNG_COUNT
+};
+
+static uint32_t pattern_seed = LED_PATTERN_SEED;
+static prng_t rng[RNG_COUNT];
+
+void led_pattern_seed(uint32_t seed) {
+    pattern_seed = seed;
+    for (uint32_t i = 0; i < RNG_COUNT; i++)
+        prng_seed(&rng[i], seed, i);
+}
+
 static void init_ornaments(void);
 
 void init_start_strips(void) {
     uint16_t y, x;
     uint8_t color, r, g, b, val;
+    prng_t *rs = &rng[RNG_START_STRIPS];
+
+    led_pattern_seed(pattern_seed);
 
     for (y = 0; y < NUM_STRIPS; ++y) {
-        start_strip_pos[y] = (uint32_t)(rand() % NUM_PIXELS);
+        start_strip_pos[y] = prng_below(rs, NUM_PIXELS);
     }
     for (y = 0; y < NUM_STRIPS; ++y) {
-        color = (typeof(color))(rand() % 7);
-        val = (typeof(val))(rand() % 256);
+        color = (typeof(color))prng_below(rs, 7);
+        val = (typeof(val))prng_u32(rs);
         r = (color & 0x4) ? val : 0;
         g = (color & 0x2) ? val : 0;
         b = (color & 0x1) ? val : 0;
@@ -118,10 +149,10 @@ void init_start_strips(void) {
         start_strip_color[y] = urgb_u32(r, g, b);
     }
     for (x = 0; x < NUM_PIXELS; ++x) {
-        start_column_pos[x] = (uint32_t)(rand() % NUM_STRIPS);
+        start_column_pos[x] = prng_below(rs, NUM_STRIPS);
     }
     for (x = 0; x < NUM_PIXELS; ++x) {
-        start_column_sel_color[x] = (uint8_t)(rand() % 8);
+        start_column_sel_color[x] = (uint8_t)(prng_u32(rs) & 0x7);
     }
 
     for (y = 0; y < sizeof(linear_brightness_percent); y++) {
@@ -647,7 +678,7 @@ void pattern_color_wipe(uint32_t *buffer, uint32_t pixels, int dir) {
  */
 void pattern_twinkle(uint32_t *buffer, uint32_t pixels, int dir) {
     for (uint32_t i = 0; i < pixels; ++i) {
-        uint32_t v = (i * 37 + t * 13) & 0xFF;
+        uint32_t v = prng_hash(pattern_seed, i, t) & 0xFF;
         if (v < 8)
             *buffer++ = urgb_u32(255, 255, 255);
         else
@@ -885,13 +916,6 @@ static uint32_t frame_div;
 //     x ^= x << 5;
 //     return x;
 // }
-static inline uint32_t xorshift32(void) {
-    static uint32_t x = 0xA341316C;
-    x ^= x << 13;
-    x ^= x >> 17;
-    x ^= x << 5;
-    return x;
-}
 
 void pattern_warm_white_with_sparks(uint32_t *buffer,
                                     uint32_t pixels,
@@ -914,8 +938,8 @@ void pattern_warm_white_with_sparks(uint32_t *buffer,
     if (tick_25hz) {
         // ~1 spark per second
         // if ((xorshift32() & 0xFF) < 10) {
-        if ((xorshift32() & 0xF) < 10) {
-            uint32_t idx = xorshift32() % pixels;
+        if ((prng_u32(&rng[RNG_WARM_SPARKS]) & 0xF) < 10) {
+            uint32_t idx = prng_below(&rng[RNG_WARM_SPARKS], pixels);
             // spark_level[idx] = 180 + (xorshift32() & 0x3F);
             spark_level[idx] = 220;
         }
@@ -987,12 +1011,12 @@ void pattern_falling_sparks(uint32_t *buffer,
         buffer[i] = urgb_u32(base_r, base_g, base_b);
 
     // ---- spawn new spark occasionally ----
-    if ((xorshift32() & 0x1F) < 10) {  // ~1–2 per second
+    if ((prng_u32(&rng[RNG_FALLING_SPARKS]) & 0x1F) < 10) {  // ~1–2 per second
         for (int i = 0; i < MAX_FALLING_SPARKS; ++i) {
             if (!falling[i].active) {
                 falling[i].active = 1;
                 falling[i].pos   = 0;                 // top
-                falling[i].speed = 300 + (xorshift32() & 0xFF); // ~1–2 px/frame
+                falling[i].speed = 300 + (int)(prng_u32(&rng[RNG_FALLING_SPARKS]) & 0xFF); // ~1–2 px/frame
                 falling[i].life  = 40;
                 break;
             }
@@ -1039,7 +1063,7 @@ void pattern_falling_sparks(uint32_t *buffer,
  * More ornaments   ORNAMENT_SPACING 30
  * Bigger bulbs     ORNAMENT_RADIUS 8
  * Faster falling sparks    falling[i].speed += 200;
- * Fewer sparks             (xorshift32() & 0xFF) < 5
+ * Fewer sparks             (prng_u32(&rng[RNG_FALLING_SPARKS]) & 0xFF) < 5
  * 
  */
 #define ORNAMENT_SPACING 40   // pixels between bulbs
@@ -1120,14 +1144,16 @@ static void init_ornaments(void) {
     init_fade_clusters(NUM_PIXELS);
 
 
+    prng_t *rs = &rng[RNG_ORNAMENTS];
+
     for (int i = 0; i < 32; ++i) {
-        ornaments[i].hue   = xorshift32() & 0xFF;
-        ornaments[i].phase = xorshift32() & 0xFF;
+        ornaments[i].hue   = prng_u32(rs) & 0xFF;
+        ornaments[i].phase = prng_u32(rs) & 0xFF;
 
-        switch (xorshift32() % 3) {
-            case 0: ornaments[i] = (ornament_t){220, 40,  20, (uint8_t)xorshift32(), 0}; break; // red
-            case 1: ornaments[i] = (ornament_t){255, 180, 60, (uint8_t)xorshift32(), 0}; break; // gold
-            case 2: ornaments[i] = (ornament_t){40,  180, 60, (uint8_t)xorshift32(), 0}; break; // green
+        switch (prng_below(rs, 3)) {
+            case 0: ornaments[i] = (ornament_t){220, 40,  20, (uint8_t)prng_u32(rs), 0}; break; // red
+            case 1: ornaments[i] = (ornament_t){255, 180, 60, (uint8_t)prng_u32(rs), 0}; break; // gold
+            case 2: ornaments[i] = (ornament_t){40,  180, 60, (uint8_t)prng_u32(rs), 0}; break; // green
         }
     }
     ornaments_init = 1;
@@ -1284,13 +1310,14 @@ static uint8_t clusters_init;
 
 static void init_ornament_clusters(uint32_t pixels) {
     uint32_t pos = CLUSTER_SPACING / 2;
+    prng_t *rs = &rng[RNG_ORNAMENT_CLUSTERS];
 
     for (int i = 0; i < MAX_CLUSTERS && pos < pixels; ++i) {
         clusters[i].center = (uint16_t)pos;
-        clusters[i].size   = CLUSTER_MIN_SIZE +
-                              (xorshift32() % (CLUSTER_MAX_SIZE - CLUSTER_MIN_SIZE + 1));
-        clusters[i].hue    = xorshift32() & 0xFF;
-        clusters[i].phase  = xorshift32() & 0xFF;
+        clusters[i].size   = (uint8_t)(CLUSTER_MIN_SIZE +
+                              prng_below(rs, CLUSTER_MAX_SIZE - CLUSTER_MIN_SIZE + 1));
+        clusters[i].hue    = prng_u32(rs) & 0xFF;
+        clusters[i].phase  = prng_u32(rs) & 0xFF;
 
         pos += CLUSTER_SPACING;
     }
@@ -1383,17 +1410,17 @@ void pattern_ornament_clusters(uint32_t *buffer,
 /**
  * Random color generator (pleasant range)
  */
-static rgb_t random_soft_color(void) {
+static rgb_t random_soft_color(prng_t *rs) {
     rgb_t c;
-    c.r = (uint8_t)(80  + (xorshift32() & 0x7F));
-    c.g = (uint8_t)(80  + (xorshift32() & 0x7F));
-    c.b = (uint8_t)(80  + (xorshift32() & 0x7F));
+    c.r = (uint8_t)(80  + (prng_u32(rs) & 0x7F));
+    c.g = (uint8_t)(80  + (prng_u32(rs) & 0x7F));
+    c.b = (uint8_t)(80  + (prng_u32(rs) & 0x7F));
     return c;
 }
 
-static rgb_t random_visible_color(void) {
+static rgb_t random_visible_color(prng_t *rs) {
     rgb_t c;
-    uint8_t h = xorshift32() & 0xFF;
+    uint8_t h = prng_u32(rs) & 0xFF;
 
     if (h < 85) {                 // red → yellow
         c.r = (uint8_t)255;
@@ -1436,8 +1463,8 @@ void pattern_global_color_fade(uint32_t *buffer,
     (void)dir;
 
     if (!init) {
-        from = random_visible_color();
-        to   = random_visible_color();
+        from = random_visible_color(&rng[RNG_GLOBAL_COLOR_FADE]);
+        to   = random_visible_color(&rng[RNG_GLOBAL_COLOR_FADE]);
         pos  = 0;
         init = 1;
     }
@@ -1464,7 +1491,7 @@ void pattern_global_color_fade(uint32_t *buffer,
     if (pos >= 255) {
         pos = 0;
         from = to;
-        to   = random_visible_color();
+        to   = random_visible_color(&rng[RNG_GLOBAL_COLOR_FADE]);
     }
 }
 
@@ -1516,11 +1543,11 @@ static void init_fade_clusters(uint32_t pixels) {
     for (int i = 0; i < MAX_CLUSTERS && pos < pixels; ++i) {
         fade_clusters[i].center = (uint16_t)pos;
         fade_clusters[i].size   = (uint8_t)(CLUSTER_MIN_SIZE +
-                                  (xorshift32() %
-                                   (CLUSTER_MAX_SIZE - CLUSTER_MIN_SIZE + 1)));
-        fade_clusters[i].from   = random_soft_color();
-        fade_clusters[i].to     = random_soft_color();
-        fade_clusters[i].pos    = xorshift32() & 0x0FFF;
+                                  prng_below(&rng[RNG_FADE_CLUSTERS],
+                                             CLUSTER_MAX_SIZE - CLUSTER_MIN_SIZE + 1));
+        fade_clusters[i].from   = random_soft_color(&rng[RNG_FADE_CLUSTERS]);
+        fade_clusters[i].to     = random_soft_color(&rng[RNG_FADE_CLUSTERS]);
+        fade_clusters[i].pos    = prng_u32(&rng[RNG_FADE_CLUSTERS]) & 0x0FFF;
         pos += CLUSTER_SPACING;
     }
 
@@ -1548,11 +1575,11 @@ void pattern_cluster_color_fade(uint32_t *buffer,
         uint16_t p = CLUSTER_SPACING / 2;
         for (int i = 0; i < MAX_CLUSTERS && p < pixels; ++i) {
             cl[i].center = p;
-            cl[i].size   = 2 + (uint8_t)(xorshift32() % 3);
-            cl[i].from   = random_visible_color();
-            cl[i].to     = random_visible_color();
-            cl[i].pos    = xorshift32() & 0xFF;
-            cl[i].breath = xorshift32() & 0xFF;
+            cl[i].size   = 2 + (uint8_t)prng_below(&rng[RNG_CLUSTER_COLOR_FADE], 3);
+            cl[i].from   = random_visible_color(&rng[RNG_CLUSTER_COLOR_FADE]);
+            cl[i].to     = random_visible_color(&rng[RNG_CLUSTER_COLOR_FADE]);
+            cl[i].pos    = prng_u32(&rng[RNG_CLUSTER_COLOR_FADE]) & 0xFF;
+            cl[i].breath = prng_u32(&rng[RNG_CLUSTER_COLOR_FADE]) & 0xFF;
             p += CLUSTER_SPACING;
         }
         init = 1;
@@ -1607,7 +1634,7 @@ void pattern_cluster_color_fade(uint32_t *buffer,
 
         if (cl[i].pos == 0) {
             cl[i].from = cl[i].to;
-            cl[i].to   = random_visible_color();
+            cl[i].to   = random_visible_color(&rng[RNG_CLUSTER_COLOR_FADE]);
         }
     }
 }
@@ -1732,7 +1759,7 @@ void pattern_fade_show(uint32_t *buffer,
     if (pos >= 255) {
         pos = 0;
         from = to;
-        to   = random_visible_color();
+        to   = random_visible_color(&rng[RNG_FADE_SHOW]);
     }
 }
 
@@ -1749,6 +1776,58 @@ void pattern_zero(uint32_t *buffer,
 }
 
 
+static inline uint8_t clamp_u8(int32_t v) {
+    return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+/**
+ * Copy a rendered frame to the output buffer, applying brightness and hue.
+ * Hue is a rotation around the grey axis; brightness is folded into the same
+ * 3x3 Q8 matrix, so the per-pixel cost is 9 multiplies whatever is active.
+ * The matrix is built once per frame (float is fine at that rate).
+ */
+void led_pattern_modulate(uint32_t *dst, const uint32_t *src, uint32_t pixels,
+                          const pattern_mod_t *mod) {
+    if (!mod->active || (mod->brightness == 255 && mod->hue == 0)) {
+        if (dst != src)
+            memcpy(dst, src, pixels * sizeof(uint32_t));
+        return;
+    }
+
+    if (mod->hue == 0) {
+        // brightness only: two channels per multiply (R,B and G lanes)
+        uint32_t k = (uint32_t)mod->brightness + 1u;
+        for (uint32_t i = 0; i < pixels; ++i) {
+            uint32_t px = src[i];
+            uint32_t rb = ((((px >> 8) & 0x00FF00FFu) * k) >> 8) & 0x00FF00FFu;
+            uint32_t g  = ((((px >> 16) & 0xFFu) * k) >> 8) & 0xFFu;
+            dst[i] = (rb << 8) | (g << 16);
+        }
+        return;
+    }
+
+    float a = (float)mod->hue * (6.2831853f / 256.0f);
+    float c = cosf(a), s = sinf(a);
+    float k = (float)mod->brightness * (256.0f / 255.0f);
+    float d = (1.0f - c) / 3.0f;
+    float e = s * 0.57735027f;      // sin / sqrt(3)
+    int32_t m0 = (int32_t)((c + d) * k);
+    int32_t m1 = (int32_t)((d - e) * k);
+    int32_t m2 = (int32_t)((d + e) * k);
+
+    // rotation about (1,1,1) is circulant: rows are shifts of (m0, m1, m2)
+    for (uint32_t i = 0; i < pixels; ++i) {
+        uint32_t px = src[i];
+        int32_t r = (int32_t)(px >> 24);
+        int32_t g = (int32_t)((px >> 16) & 0xFFu);
+        int32_t b = (int32_t)((px >> 8) & 0xFFu);
+        dst[i] = urgb_u32(clamp_u8((m0 * r + m1 * g + m2 * b) >> 8),
+                          clamp_u8((m2 * r + m0 * g + m1 * b) >> 8),
+                          clamp_u8((m1 * r + m2 * g + m0 * b) >> 8));
+    }
+}
+
+
 
 
 
@@ -1793,7 +1872,7 @@ Effect	Change
 Bigger ornaments	ORNAMENT_RADIUS 8
 More ornaments	ORNAMENT_SPACING 30
 Slower breathing	o->phase += (dir >> 1)
-Fewer snowflakes	(xorshift32() & 0xFF) < 6
+Fewer snowflakes	(prng_u32(rs) & 0xFF) < 6
 Stronger sway	sway -= 12
 */
 
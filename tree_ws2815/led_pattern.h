@@ -7,9 +7,27 @@
 #define LED_PATTERN_H
 #include <stdint.h>
 
+#ifndef LED_PATTERN_SEED
+#define LED_PATTERN_SEED    0xA341316Cu     // default seed of the pattern PRNG streams
+#endif
+
+void led_pattern_seed(uint32_t seed);
 void init_start_strips(void);
 typedef void (*pattern)(uint32_t *buffer, uint32_t pixels, int dir);
 
+/**
+ * Modulation applied on top of any pattern (e.g. from the VL53 zone map)
+ */
+typedef struct {
+    uint8_t active;
+    uint8_t speed;          // pattern steps per render, 128 = 1x, 255 ~ 2x
+    uint8_t brightness;     // 255 = unchanged
+    uint8_t hue;            // hue rotation, 0 = unchanged, 255 ~ 360 deg
+} pattern_mod_t;
+
+void led_pattern_modulate(uint32_t *dst, const uint32_t *src, uint32_t pixels,
+                          const pattern_mod_t *mod);
+
 void pattern_zero(uint32_t *buffer, uint32_t pixels, int dir);
 
 // void pattern_simple(uint32_t *buffer, uint8_t *rgb, uint32_t pixels);
@@ -22,6 +22,13 @@
 #include "flash_cfg.h"
 #include "vl53l8cx_drv.h"
 #include "telnet.h"
+#include "sched.h"
+#include "telemetry.h"
+#include "dlog.h"
+#include "cli_io.h"
+#ifdef VL53L8CX_DEV
+#include "vl53_zones.h"
+#endif // VL53L8CX_DEV
 
 // variables for TCP loopback
 // static uint8_t message_buf[2] = {
@@ -30,9 +37,6 @@
 
 int32_t ret;
 
-static repeating_timer_t timer;
-volatile uint32_t tmr_ms_tick = 0;
-
 const network_t default_network = {
     .ip  = NETINFO_IP,
     .sn  = NETINFO_SN,
@@ -40,12 +44,6 @@ const network_t default_network = {
     .dns = NETINFO_DNS
 };
 
-bool timer_callback(repeating_timer_t *rt) {
-    (void)rt;
-    tmr_ms_tick++;     // Increment every 1 ms
-    return true;    // Return true to keep repeating
-}
-
 // // CLI variables
 // uint8_t cli_buf_rx[CLI_BUF_RX_SIZE];
 
@@ -54,22 +52,63 @@ bool timer_callback(repeating_timer_t *rt) {
 #define DDP_DATA_BUF_SIZE     (NUM_PIXELS*NUM_CHANNELS)  // clamp to your RAM
 uint8_t ddp_buf_frame[DDP_DATA_BUF_SIZE]; // buffer for receiving DDP packets
 
-void run_periodically_ws2815_tasks(void) {
-    static uint32_t last_tmr_loop = 0;
-    static uint32_t last_tmr_patt = 0;
-    uint32_t period_loop = 2;   // ms
-    uint32_t period_patt = 20;  // ms
+// Main loop tasks, see sched.h. Budgets are measured worst cases.
+#define WS2815_LOOP_PERIOD_MS   2
+#define WS2815_PATT_PERIOD_MS   20
 
-    // Create pattern, in the loop every 20 ms
-    if (tmr_ms_tick - last_tmr_patt >= period_patt) {
-        last_tmr_patt += period_patt;
-        ws2815_pattern_loop(period_patt);
-    }
-    // Check WS2815 update loop every 2 ms
-    if (tmr_ms_tick - last_tmr_loop >= period_loop) {
-        last_tmr_loop += period_loop;
-        ws2815_loop(period_loop);
+static void task_ws2815_loop(void) {
+    ws2815_loop(WS2815_LOOP_PERIOD_MS);
+}
+
+static void task_ws2815_pattern(void) {
+    ws2815_pattern_loop(WS2815_PATT_PERIOD_MS);
+}
+
+static void task_ddp(void) {
+    ret = ddp_loop();       //  (&pkt_counter, &last_push_ms);
+}
+
+static void task_cli(void) {
+    tcp_cli_service();      // Sockets 2-4 : CLI sessions           [5000]
+}
+
+// Telemetry totals kept by other modules, read before every datagram
+static void tlm_collect(void) {
+    uint32_t overruns = 0, misses = 0;
+    const sched_task_t *t;
+
+    for (int i = 0; (t = sched_get_task(i)) != NULL; i++) {
+        overruns += t->overruns;
+        misses += t->misses;
     }
+    tlm_set(TLM_SCHED_OVERRUNS, overruns);
+    tlm_set(TLM_SCHED_MISSES, misses);
+    tlm_set(TLM_CLI_LINES, cli_io_stats()->lines);
+#ifdef VL53L8CX_DEV
+    tlm_set(TLM_SENSOR_FRAMES, vl53_zones_get_map()->seq);
+#endif
+}
+
+static void task_tlm(void) {
+    tlm_service();          // UDP_TLM_SOCKET : telemetry datagrams   [3000]
+}
+
+// printf() of the hot paths, formatted here in the time the others leave
+static void task_log(void) {
+    dlog_drain(DLOG_DRAIN_BUDGET_US);   // USB, "log cli", UDP_LOG_SOCKET [3001]
+}
+
+static void register_tasks(void) {
+    sched_add("ws2815", task_ws2815_loop, WS2815_LOOP_PERIOD_MS * 1000, 0, 400, 0);
+    sched_add("pattern", task_ws2815_pattern, WS2815_PATT_PERIOD_MS * 1000, 0, 1500, 1);
+    sched_add("ddp", task_ddp, 2000, 0, 700, 2);
+#ifdef VL53L8CX_DEV
+    sched_add("vl53", vl53l8cx_loop, 5000, 0, 800, 3);     // non-blocking polling
+#endif
+    sched_add("cli", task_cli, 5000, 0, 1000, 4);
+    sched_add("efu", efu_server_poll, 2000, 0, 1200, 5);   // TCP_EFU_SOCKET : Eth-Fw-Upd [4243]
+    sched_add("tlm", task_tlm, 10000, 0, 300, 6);
+    sched_add("log", task_log, 20000, 0, 500, 7);
 }
 
 
@@ -111,6 +150,15 @@ int main() {
     // --- Open UDP socket for DDP ---
     // udp_socket_init();
     udp_ddp_init(UDP_DDP_SOCKET, UDP_DDP_PORT, ddp_buf_frame, DDP_DATA_BUF_SIZE);
+
+    // --- Telemetry datagrams ---
+    const uint8_t tlm_destip[4] = UDP_TLM_DESTIP;
+    udp_tlm_init(UDP_TLM_SOCKET, UDP_TLM_PORT, tlm_destip, UDP_TLM_PERIOD_MS);
+    tlm_collect_hook(tlm_collect);
+
+    // --- Deferred log over UDP, off until "log udp" ---
+    udp_log_init(UDP_LOG_SOCKET, UDP_LOG_PORT);
+
     udp_interrupts_enable();          // sets up interrupts for UDP socket for DDP reception
     wiznet_gpio_irq_init();     // sets up GPIO interrupt for WIZnet IRQ pin
 
@@ -128,11 +176,6 @@ int main() {
     ws2815_init(); // Initialize WS2815 LED control
 
 
-    // Create repeating timer with 1 ms interval
-    if (!add_repeating_timer_ms(1, timer_callback, NULL, &timer)) {
-        printf("Failed to add timer\n");
-        while (1);
-    }
 
     // absolute_time_t last_log = get_absolute_time();
     // gpio_init(PIN_TEST_14);
@@ -148,29 +191,7 @@ int main() {
     #endif  // OUTDOOR_TREE_WS2815
     
     // --- Main loop ---
-    while (true) {
-        // time_start = time_us_32();  // compare with get_absolute_time()
-        // remove: loopback_loop(message_buf);
-        tcp_cli_service();          // Socket 0 : CLI                       [5000]
-        // http_server_service();   // TCP_HTTP_SOCKET : HTTP (future)      [80]
-        // tcp_ota_service(); $ vim ../pico-examples/pico_w/wifi/ota_update/README.md
-        efu_server_poll();          // TCP_EFU_SOCKET  : Eth-Fw-Upd         [4243]
-
-
-        // Poll the UDP socket
-        ret = ddp_loop();       //  (&pkt_counter, &last_push_ms);
-  
-
-        // Manage ws2815 loop control
-        run_periodically_ws2815_tasks();    // ws2815_loop();
-
-        // VL53L8CX non-blocking polling
-        #ifdef VL53L8CX_DEV
-        vl53l8cx_loop();
-        #endif // VL53L8CX_DEV
-
-        tight_loop_contents(); // yield to SDK
-    }
+    // http_server_service();   // TCP_HTTP_SOCKET : HTTP (future)      [80]
+    register_tasks();
+    sched_run();                // never returns
 }
-
-
@@ -18,54 +18,13 @@
 #include "telnet.h"
 #include "ws2815_control_dma.h"
 #include "config.h"
-#include "partition.h"
-#include "flash_cfg.h"
-#include "utility.h"
-#include "efu_update.h"
 #include "vl53_diag.h"
+#include "vl53_zones.h"
 #include "tcp_cli.h"
+#include "cli_cmd.h"
+#include "cli_sys.h"
 #include "network.h"
 
-// This help has 790 bytes
-const char *help_msg =
-"\r\n"
-"========================================\r\n"
-"   WIZnet RP2350 Remote CLI Interface   \r\n"
-"========================================\r\n"
-"\r\n"
-"Available commands:\r\n"
-"  help   \t\t\t- Show this help menu\r\n"
-"  info   \t\t\t- Display board and firmware information\r\n"
-"  set [p]\t\t\t- Set active LED/pattern index to value [p]\r\n"
-"  get    \t\t\t- Get current pattern index\r\n"
-"  time   \t\t\t- Show timing statistics (min/max execution)\r\n"
-"  status \t\t\t- Show system analog and digital state\r\n"
-"  on     \t\t\t- Enable outputs\r\n"
-"  off    \t\t\t- Disable outputs\r\n"
-"  load   \t\t\t- Load config from flash - for debug\r\n"
-"  save   \t\t\t- Save config to flash\r\n"
-"  show   \t\t\t- Show config values\r\n"
-"  rgb <r> <g> <b> \t\t- Set color LEDs\r\n"
-"  max <value> \t\t- Show config values\r\n"
-"  part   \t\t\t- Show partition information\r\n"
-"  config ip <a.b.c.d>  \t- Set IP address\r\n"
-"  config sn <a.b.c.d>  \t- Set Subnet Mask\r\n"
-"  config gw <a.b.c.d>  \t- Set Gateway\r\n"
-"  config dns <a.b.c.d> \t- Set DNS server\r\n"
-"  config save          \t- Save current config to flash\r\n"
-"  config show          \t- Show current config values\r\n"
-"  config clean         \t- Clean current config (use default)\r\n"
-"  config default       \t- Restore factory default configuration\r\n"
-"  exit   \t\t\t- Close the CLI connection\r\n"
-"\r\n"
-"Examples:\r\n"
-"  > set 3\r\n"
-"  > get\r\n"
-"  > time\r\n"
-"\r\n"
-"Type 'help' anytime to show this menu.\r\n"
-"========================================\r\n";
-
 const char *cli_greeting =
 "\r\n"
 "========================================\r\n"
@@ -78,10 +37,6 @@ const char *cli_greeting =
 
 // #define TELNET_PROMPT  "> "
 
-// --- global variables for CLI ---
-// CLI variables
-uint8_t cli_buf_rx[CLI_BUF_RX_SIZE];
-
 /**
  * In network called by:
  * cli_hooks.on_connect(cli_sn, destip);
@@ -96,418 +51,175 @@ void telnet_greeting(uint8_t sn, const uint8_t *client_ip) {
     cli_flush(sn, msg);  // (uint8_t*)  , strlen(msg)
 }
 
-// static bool parse_ipv4(const char *s, uint8_t out[4]) {
-//     int a, b, c, d;
-//     if (sscanf(s, "%d.%d.%d.%d", &a, &b, &c, &d) != 4)
-//         return false;
-//     if ((a|b|c|d) & ~0xFF)
-//         return false;
-//     out[0] = (uint8_t)a;
-//     out[1] = (uint8_t)b;
-//     out[2] = (uint8_t)c;
-//     out[3] = (uint8_t)d;
-//     return true;
-// }
-
-void cmd_config_show(uint8_t sn) {
-        char msg[200];     // current use ??? bytes
-        config_t *config = NULL;
-        int len;
-        uint8_t id = 0;
-
-        config = config_get(id);
-        // snprintf(msg, sizeof(msg), "Config [0]\r\n");
-        // send(sn, msg, strlen(msg));
-        len = config_show( config, id, msg, sizeof(msg));   // sending > 102 bytes
-        printf("Telnet sent %d bytes to console for config[0]\r\n", len);
-        cli_send(sn, msg); // , (uint16_t)strlen(msg));
-
-        config = config_get(++id);
-        // snprintf(msg, sizeof(msg), "Config [1]\r\n");
-        // send(sn, msg, strlen(msg));
-        len = config_show( config, id, msg, sizeof(msg));   // sending > 102 bytes
-        printf("Telnet sent %d bytes to console for config[1]\r\n", len);
-        cli_send(sn, msg); // , (uint16_t)strlen(msg));
-
-        config = config_get(++id);
-        // snprintf(msg, sizeof(msg), "Config [2]\r\n");
-        // send(sn, msg, strlen(msg));
-        len = config_show( config, id, msg, sizeof(msg));   // sending > 102 bytes
-        printf("Telnet sent %d bytes to console for config[2]\r\n", len);
-
-        cli_flush(sn, msg);
+static bool cmd_rgb(const cli_ctx_t *ctx)
+{
+    uint32_t v[3];
+    char msg[64];
+
+    if (!cli_args_u32(ctx->argv, 3, 0, 255, v))
+        return false;
+    set_rgb((uint8_t)v[0], (uint8_t)v[1], (uint8_t)v[2]);
+    snprintf(msg, sizeof(msg), "RGB set to %u %u %u\r\n", v[0], v[1], v[2]);
+    cli_flush(ctx->sn, msg);
+    return true;
 }
-void cmd_config_save(uint8_t sn) {
-        bool ret;
-        char msg[30];
-        config_t *config = config_get(1);
-
-        ret = config_save(config);
-        snprintf(msg, sizeof(msg),
-                "Config saved to flash: %d\r\n", ret);
-        cli_flush((uint32_t)sn, msg);
+
+static bool cmd_max(const cli_ctx_t *ctx)
+{
+    uint32_t val;
+    char msg[64];
+
+    if (!cli_arg_u32(ctx->argv[0], 0, 65535, &val))
+        return false;
+    set_max_led(val);
+    snprintf(msg, sizeof(msg), "Max value set to %u\r\n", val);
+    cli_flush(ctx->sn, msg);
+    return true;
 }
-void cmd_config_set_ip(int sn, uint8_t *ip) {
-    (void)sn;    
-    config_t *config = config_get(1);
-    memcpy(config->net_info.ip, ip, 4);
+
+static bool cmd_set(const cli_ctx_t *ctx)
+{
+    uint32_t index = 0;         // no index: switch off LEDs
+    char msg[64];
+
+    if (ctx->argc && !cli_arg_u32(ctx->argv[0], 0, UINT8_MAX, &index))
+        return false;
+    snprintf(msg, sizeof(msg), "Pattern index set to %d\r\n", set_pattern_index((uint8_t)index));
+    cli_flush(ctx->sn, msg);
+    return true;
 }
-void cmd_config_set_sn(int sn, uint8_t *snm) {
-    (void)sn;
-    config_t *config = config_get(1);
-    memcpy(config->net_info.sn, snm, 4);
+
+static bool cmd_get(const cli_ctx_t *ctx)
+{
+    char msg[64];
+
+    snprintf(msg, sizeof(msg), "Pattern index: %d\r\n", get_pattern_index());
+    cli_flush(ctx->sn, msg);
+    return true;
 }
-void cmd_config_set_gw(int sn, uint8_t *gw) {
-    (void)sn;
-    config_t *config = config_get(1);
-    memcpy(config->net_info.gw, gw, 4);
+
+static bool cmd_on(const cli_ctx_t *ctx)
+{
+    gpio_put(OE_PIN, OE_ON);
+    cli_flush(ctx->sn, "Enable outputs\r\n");
+    return true;
 }
-void cmd_config_set_dns(int sn, uint8_t *dns) {
-    (void)sn;
-    config_t *config = config_get(1);
-    memcpy(config->net_info.dns, dns, 4);
+
+static bool cmd_off(const cli_ctx_t *ctx)
+{
+    gpio_put(OE_PIN, OE_OFF);
+    cli_flush(ctx->sn, "Disable outputs\r\n");
+    return true;
 }
 
- void handle_command(const char *cmd, uint8_t sn) {
-    // int sn = TCP_CLI_SOCKET;
-
-    if (strcmp(cmd, "help") == 0) {
-        cli_flush(sn, help_msg);
-    }
-    else if (strcmp(cmd, "info") == 0) {
-        // const char *msg = "Board: RP2350\r\nFW: 1.0.4\r\n";
-        char msg[80];
-        static const char * const efu_status_table[]= {
-            "UNKNOWN",          // 0
-            "SOCK_CLOSED",      // 1
-            "SOCK_INIT",        // 2
-            "SOCK_LISTEN",      // 3
-            "SOCK_ESTABLISHED", // 4
-            "SOCK_CLOSE_WAIT"   // 5
-    };
-        const char *efu_stat_msg = efu_status_table[0];
-
-        uint8_t efu_status = get_efu_socket_status();
-        switch(efu_status) {
-            case SOCK_CLOSED:
-                efu_stat_msg = efu_status_table[1];
-                break;
-            case SOCK_INIT:
-                efu_stat_msg = efu_status_table[2];
-                break;
-            case SOCK_LISTEN:       // after listen(TCP_EFU_SOCKET)
-                efu_stat_msg = efu_status_table[3];
-                break;
-            case SOCK_ESTABLISHED:
-                efu_stat_msg = efu_status_table[4];
-                break;
-            case SOCK_CLOSE_WAIT:
-                efu_stat_msg = efu_status_table[5];
-                break;
-        }
-
-        snprintf(msg, sizeof(msg),
-            "Project : stairs_ws2815\r\n"
-            "FW      : %s\r\n"
-            "EFU stat: 0x%x (%s)\r\n",
-            FW_VERSION, efu_status, efu_stat_msg);
-
-        cli_flush(sn, msg);
-        // read_boot_info();
-    }
-    else if (strcmp(cmd, "part") == 0) {
-        char msg[800];     // current use 407 bytes
-        int len = partition_info(msg, sizeof(msg));
-        printf("Telnet sent %d bytes to console\r\n", len);
-        cli_flush(sn, msg);
-    }
-
-
-    else if (strncmp(cmd, "rgb", 3) == 0) {
-        uint16_t r, g, b;
-
-        // Skip "rgb" and parse three integers
-        if (sscanf(cmd + 3, "%u %u %u", &r, &g, &b) == 3 &&
-            r <= 255 && g <= 255 && b <= 255) 
-        {
-            char msg[64];
-            // Example: your function to apply RGB globally or per pattern
-            // set_global_rgb((uint8_t)r, (uint8_t)g, (uint8_t)b);
-            set_rgb((uint8_t)r, (uint8_t)g, (uint8_t)b);
-
-            snprintf(msg, sizeof(msg),
-                    "RGB set to %u %u %u\r\n", r, g, b);
-            cli_flush(sn, msg);
-        } 
-        else {
-            const char *err =
-                "Usage: rgb <r> <g> <b>\r\n"
-                "Each value must be 0–255.\r\n";
-            cli_flush(sn, err);
-        }
-    }
-    else if (strncmp(cmd, "max", 3) == 0) {
-        uint32_t val;
-
-        // Parse a single unsigned integer after "max"
-        if (sscanf(cmd + 3, "%u", &val) == 1 && val <= 65535) {
-            char msg[64];
-
-            // Example: apply the parameter in your firmware
-            // set_max_value((uint16_t)val);
-            set_max_led(val);
-
-            snprintf(msg, sizeof(msg),
-                    "Max value set to %u\r\n", val);
-            cli_flush(sn, msg);
-        }
-        else {
-            const char *err =
-                "Usage: max <value>\r\n"
-                "Value must be 0–65535.\r\n";
-            cli_flush(sn, err);
-        }
-    }
-
-
-
-    else if (strncmp(cmd, "set", 3) == 0) {
-        int pattern = -1;
-        uint8_t ret_pattern = 0;
-
-        if (strlen(cmd) < 4) {
-            char msg[64];
-            // switch off LEDs
-            ret_pattern = set_pattern_index(0);
-            snprintf(msg, sizeof(msg),
-                    "Pattern index set to %d\r\n", ret_pattern);
-            cli_flush(sn, msg);
-        }
-        else if (sscanf(cmd + 3, "%d", &pattern) == 1 && pattern >= 0) {
-            char msg[64];
-
-            ret_pattern = set_pattern_index((uint8_t)pattern);
-            snprintf(msg, sizeof(msg),
-                    "Pattern index set to %d\r\n", ret_pattern);
-            cli_flush(sn, msg);
-        } else {
-            // ❌ parameter missing or invalid
-            const char *err = "Usage: set [p]\r\nExample: set 3\r\n";
-            cli_flush(sn, err);
-        }
-    }
-    else if (strcmp(cmd, "on") == 0) {
-        char msg[32];
-        gpio_put(OE_PIN, OE_ON);
-        snprintf(msg, sizeof(msg),
-                    "Enable outputs\r\n");
-            cli_flush(sn, msg);
-    }
-    else if (strcmp(cmd, "off") == 0) {
-        char msg[32];
-        gpio_put(OE_PIN, OE_OFF);
-        snprintf(msg, sizeof(msg),
-                    "Disable outputs\r\n");
-            cli_flush(sn, msg);
-    }
-
-
-    else if (strcmp(cmd, "get") == 0) {
-        uint8_t ret_pattern;
-        char msg[64];
-
-        ret_pattern = get_pattern_index();
-
-        snprintf(msg, sizeof(msg),
-                "Pattern index: %d\r\n", ret_pattern);
-        cli_flush(sn, msg);
-    }
-
-    
-    else if (strcmp(cmd, "vl53 gpio") == 0) {
-        vl53_diag_print_gpio(sn);
-    }
-    else if (strcmp(cmd, "vl53 spi") == 0) {
-        #ifdef VL53_SPI
-        vl53_diag_print_spi1(sn);
-        #endif // VL53_SPI
-    }
-    else if (strcmp(cmd, "vl53 probe") == 0) {
-        vl53_diag_probe_bus(sn);
-    }
-    else if (strcmp(cmd, "vl53 raw") == 0) {
-        #ifdef VL53_SPI
-        vl53_diag_raw_spi_test(sn);
-        #endif
-    }
-    else if (strcmp(cmd, "vl53 read") == 0) {
-        vl53_diag_read_one(sn);
-    }
-    else if (strcmp(cmd, "vl53 start") == 0) {
-        vl53_diag_start_ranging(sn);
-    }
-
-
-    else if (strcmp(cmd, "cson") == 0) {
-        vl53_diag_cs_active(sn);
-    }
-    else if (strcmp(cmd, "csoff") == 0) {
-        vl53_diag_cs_inactive(sn);
-    }
-
-
-
-    else if (strncmp(cmd, "config", 6) == 0) {
-        const char *p = cmd + 6;
-        while (*p == ' ') p++;
-
-        if (*p == '\0') {
-            cli_flush(sn, "Usage: config <ip|sn|gw|dns|save|show|clean|default> ...\r\n");
-            return;
-        }
-
-        /* --- config ip <a.b.c.d> --- */
-        if (strncmp(p, "ip", 2) == 0 && (p[2] == ' ')) {
-            uint8_t ip[4];
-            const char *arg = p + 3;
-            while (*arg == ' ') arg++;
-            if (parse_ipv4(arg, ip)) {
-                cmd_config_set_ip(sn, ip);
-                cli_flush(sn, "IP updated\r\n");
-            } else {
-                cli_flush(sn, "Invalid IP format\r\n");
-            }
-        }
-
-        /* --- config sn <mask> --- */
-        else if (strncmp(p, "sn", 2) == 0 && (p[2] == ' ')) {
-            uint8_t snm[4];
-            const char *arg = p + 3;
-            while (*arg == ' ') arg++;
-            if (parse_ipv4(arg, snm)) {
-                cmd_config_set_sn(sn, snm);
-                cli_flush(sn, "Subnet mask updated\r\n");
-            } else {
-                cli_flush(sn, "Invalid subnet mask\r\n");
-            }
-        }
-
-        /* --- config gw <a.b.c.d> --- */
-        else if (strncmp(p, "gw", 2) == 0 && (p[2] == ' ')) {
-            uint8_t gw[4];
-            const char *arg = p + 3;
-            while (*arg == ' ') arg++;
-            if (parse_ipv4(arg, gw)) {
-                cmd_config_set_gw(sn, gw);
-                cli_flush(sn, "Gateway updated\r\n");
-            } else {
-                cli_flush(sn, "Invalid gateway\r\n");
-            }
-        }
-
-        /* --- config dns <a.b.c.d> --- */
-        else if (strncmp(p, "dns", 3) == 0 && (p[3] == ' ')) {
-            uint8_t dns[4];
-            const char *arg = p + 4;
-            while (*arg == ' ') arg++;
-            if (parse_ipv4(arg, dns)) {
-                cmd_config_set_dns(sn, dns);
-                cli_flush(sn, "DNS updated\r\n");
-            } else {
-                cli_flush(sn, "Invalid DNS address\r\n");
-            }
-        }
-
-        /* --- config save --- */
-        else if (strcmp(p, "save") == 0) {
-            cmd_config_save(sn);
-        }
-
-        /* --- config show --- */
-        else if (strcmp(p, "show") == 0) {
-            cmd_config_show(sn);
-        }
-
-        /* --- config clean --- */
-        else if (strcmp(p, "clean") == 0) {
-            config_recovery();
-            cli_flush(sn, "Configuration cleaned\r\n");
-        }
-
-        /* --- config default --- */
-        else if (strcmp(p, "default") == 0) {
-            config_default();
-            cli_flush(sn, "Factory default configuration restored\r\n");
-        }
-
-        else {
-            cli_flush(sn, "Unknown config command\r\n");
-        }
-    }
-
-    else if (strcmp(cmd, "exit") == 0) {
-        const char *msg="Closing connection...\r\n";
-        cli_send(sn, msg); // , (uint16_t)strlen(msg));
-        sleep_ms(2);
-        // Graceful disconnect, better to use telnet
-        disconnect(sn);
-        // close(sn);      // option, telnet has problems
-        printf("[CLI] Socket %d disconnected by user\r\n", sn);
-
-    }
-
-    // else if (strcmp(cmd, "led 0") == 0) {
-    //     gpio_put(PICO_DEFAULT_LED_PIN, 0);
-    //     cli_flush(sn, "LED OFF\r\n"); // , 9
-    // }
-    // else if (strcmp(cmd, "reboot") == 0) {
-    //     cli_flush(sn, "Rebooting...\r\n");    // , 14
-    //     sleep_ms(100);
-    //     reset_usb_boot(0, 0);
-    // }
-
-    // else if (strcmp(cmd, "init") == 0) {
-    //     int ret;
-    //     char msg[30];
-
-    //     printf("Call function: config_init\r\n");
-    //     ret = config_init();
-    //     snprintf(msg, sizeof(msg),
-    //             "Config initialized: %d\r\n", ret);
-    //     cli_flush(sn, msg);
-    // }
-
-
-    // else if (strncmp(cmd, "flash_erase", 11) == 0) {
-    //     uint32_t offs = 0, size = 4096;
-    //     if (sscanf(cmd + 11, "%x %u", &offs, &size) >= 1) {
-    //         printf("[TELNET] Erasing flash offset 0x%08x, size %u\n", offs, size);
-    //         // Make sure offset is within range
-    //         if ((offs + size) <= (PICO_FLASH_SIZE_BYTES/2)) {
-    //             util_flash_erase(offs, size);
-    //             printf("[TELNET] Done.\n");
-    //         } else {
-    //             printf("[TELNET] Range out of flash.\n");
-    //         }
-    //     } else {
-    //         printf("Usage: flash_erase <hex_offset> [size]\n");
-    //     }
-    // }
-
-    else {
-        const char *msg = "Unknown command\r\n";
-        cli_flush(sn, msg);
-    }
+static bool cmd_vl53_gpio(const cli_ctx_t *ctx)
+{
+    vl53_diag_print_gpio(ctx->sn);
+    return true;
+}
+
+#ifdef VL53_SPI
+static bool cmd_vl53_spi(const cli_ctx_t *ctx)
+{
+    vl53_diag_print_spi1(ctx->sn);
+    return true;
+}
+
+static bool cmd_vl53_raw(const cli_ctx_t *ctx)
+{
+    vl53_diag_raw_spi_test(ctx->sn);
+    return true;
+}
+#endif // VL53_SPI
+
+static bool cmd_vl53_probe(const cli_ctx_t *ctx)
+{
+    vl53_diag_probe_bus(ctx->sn);
+    return true;
+}
+
+static bool cmd_vl53_read(const cli_ctx_t *ctx)
+{
+    vl53_diag_read_one(ctx->sn);
+    return true;
+}
+
+static bool cmd_vl53_start(const cli_ctx_t *ctx)
+{
+    vl53_diag_start_ranging(ctx->sn);
+    return true;
+}
+
+#ifdef VL53L8CX_DEV
+static bool cmd_vl53_zones(const cli_ctx_t *ctx)
+{
+    char msg[768];
+
+    vl53_zones_show(msg, sizeof(msg));
+    cli_flush(ctx->sn, msg);
+    return true;
 }
 
+static bool cmd_vl53_mod(const cli_ctx_t *ctx)
+{
+    static const char *const modes[] = { "off", "on" };
+    int on = cli_arg_enum(ctx->argv[0], modes, (uint8_t)count_of(modes));
+
+    if (on < 0)
+        return false;
+    set_sensor_modulation(on != 0);
+    cli_flush(ctx->sn, on ? "Sensor modulation on\r\n" : "Sensor modulation off\r\n");
+    return true;
+}
+#endif // VL53L8CX_DEV
+
+static bool cmd_cson(const cli_ctx_t *ctx)
+{
+    vl53_diag_cs_active(ctx->sn);
+    return true;
+}
+
+static bool cmd_csoff(const cli_ctx_t *ctx)
+{
+    vl53_diag_cs_inactive(ctx->sn);
+    return true;
+}
+
+static const cli_cmd_t s_cmds[] = {
+    { "rgb",        "<r> <g> <b>",  "Set color LEDs, 0..255 each",                  3, 3, cmd_rgb },
+    { "max",        "<value>",      "Maximum LED value, 0..65535",                  1, 1, cmd_max },
+    { "set",        "[p]",          "Set active LED/pattern index to value [p]",    0, 1, cmd_set },
+    { "get",        "",             "Get current pattern index",                    0, 0, cmd_get },
+    { "on",         "",             "Enable outputs",                               0, 0, cmd_on },
+    { "off",        "",             "Disable outputs",                              0, 0, cmd_off },
+    { "vl53 gpio",  "",             "VL53 pin state",                               0, 0, cmd_vl53_gpio },
+#ifdef VL53_SPI
+    { "vl53 spi",   "",             "VL53 SPI1 registers",                          0, 0, cmd_vl53_spi },
+    { "vl53 raw",   "",             "VL53 raw SPI transfer",                        0, 0, cmd_vl53_raw },
+#endif
+    { "vl53 probe", "",             "Probe the VL53 bus",                           0, 0, cmd_vl53_probe },
+    { "vl53 read",  "",             "Read one VL53 frame",                          0, 0, cmd_vl53_read },
+    { "vl53 start", "",             "Start VL53 ranging",                           0, 0, cmd_vl53_start },
+#ifdef VL53L8CX_DEV
+    { "vl53 zones", "",             "VL53 zone distances",                          0, 0, cmd_vl53_zones },
+    { "vl53 mod",   "<on|off>",     "Pattern modulation by the sensor",             1, 1, cmd_vl53_mod },
+#endif
+    { "cson",       "",             NULL,                                           0, 0, cmd_cson },
+    { "csoff",      "",             NULL,                                           0, 0, cmd_csoff },
+};
+
 void telnet_init(void) {
     // This function can be called during initialization to set up telnet CLI
     // For example, it can initialize the TCP CLI with appropriate parameters
     tcp_cli_hooks_t hooks = {
         .on_connect = telnet_greeting,
-        .handle_command = handle_command
+        .handle_command = cli_cmd_handle
     };
 
+    cli_sys_register(PROJECT_NAME, FW_VERSION);
+    if (!cli_cmd_register(s_cmds, (uint8_t)count_of(s_cmds)))
+        printf("[CLI] %s commands not registered: index full or a name taken\r\n", PROJECT_NAME);
+
     cli_hook_init(&hooks);
-    tcp_cli_init(TCP_CLI_SOCKET, TCP_CLI_PORT, cli_buf_rx, CLI_BUF_RX_SIZE, CLI_TIMEOUT);
+    tcp_cli_init(TCP_CLI_SOCKET, TCP_CLI_SESSIONS, TCP_CLI_PORT, CLI_TIMEOUT);
 }
@@ -0,0 +1,172 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * VL53L8CX zone map for the application.
+ * vl53l8cx_loop() publishes every ranging frame here; the pattern loop reads
+ * the latest map/features without touching the ULD results structure.
+ *
+ * Double buffered: the writer fills the back slot and then flips the front
+ * index, so a reader always sees one complete frame.
+ * No SDK dependency - also built by tools/pattern_render for replay.
+ */
+#include <string.h>
+#include <stdio.h>
+
+#include "vl53_zones.h"
+#include "utility.h"
+
+static vl53_zone_map_t zone_map[2];
+static vl53_features_t zone_feat[2];
+static volatile uint8_t zone_front;
+
+/**
+ * ST recommends status 5 (range valid) and 9 (valid, large pulse);
+ * everything else is treated as "no target" in this zone.
+ */
+static inline bool zone_status_valid(uint8_t status) {
+    return status == 5 || status == 9;
+}
+
+/**
+ * Publish one ranging frame and compute its features in a single pass.
+ *
+ * @param distance_mm   results distance_mm[], one target per zone
+ * @param target_status results target_status[]
+ * @param zones         16 (4x4) or 64 (8x8)
+ * @param time_us       capture time, used for staleness
+ */
+void vl53_zones_publish(const int16_t *distance_mm, const uint8_t *target_status,
+                        uint8_t zones, uint32_t time_us) {
+    uint8_t front = zone_front;
+    uint8_t back = front ^ 1u;
+    const vl53_zone_map_t *prev = &zone_map[front];
+    vl53_zone_map_t *map = &zone_map[back];
+    vl53_features_t *f = &zone_feat[back];
+    uint32_t cols = (zones == 16) ? 4 : 8;
+    uint32_t sum_w = 0, sum_wx = 0, sum_wy = 0;
+    uint32_t sum_delta = 0, n_delta = 0;
+    uint16_t nearest = 0xFFFF;
+    uint8_t nearest_zone = 0, valid_zones = 0;
+    uint64_t valid = 0;
+
+    if (zones > VL53_ZONES_MAX)
+        zones = VL53_ZONES_MAX;
+
+    for (uint32_t z = 0; z < zones; z++) {
+        int16_t d = distance_mm[z];
+        int16_t delta = 0;
+
+        if (!zone_status_valid(target_status[z]) || d <= 0 || d >= VL53_RANGE_MAX_MM) {
+            map->distance_mm[z] = 0;
+            f->delta_mm[z] = 0;
+            continue;
+        }
+
+        map->distance_mm[z] = d;
+        valid |= 1ull << z;
+        valid_zones++;
+
+        if (d < nearest) {
+            nearest = (uint16_t)d;
+            nearest_zone = (uint8_t)z;
+        }
+
+        // closeness weight, a near object pulls the centroid
+        uint32_t w = (uint32_t)(VL53_RANGE_MAX_MM - d);
+        sum_w += w;
+        sum_wx += w * (z % cols);
+        sum_wy += w * (z / cols);
+
+        if (prev->valid & (1ull << z)) {
+            delta = (int16_t)(d - prev->distance_mm[z]);
+            int32_t ad = delta < 0 ? -delta : delta;
+            sum_delta += (uint32_t)ad;
+            n_delta++;
+        }
+        f->delta_mm[z] = delta;
+    }
+
+    map->valid = valid;
+    map->zones = zones;
+    map->seq = prev->seq + 1;
+    map->time_us = time_us;
+
+    f->seq = map->seq;
+    f->time_us = time_us;
+    f->valid_zones = valid_zones;
+    f->nearest_mm = valid_zones ? nearest : 0;
+    f->nearest_zone = nearest_zone;
+    f->centroid_x_q8 = sum_w ? (uint16_t)((sum_wx << 8) / sum_w) : (uint16_t)((cols - 1) << 7);
+    f->centroid_y_q8 = sum_w ? (uint16_t)((sum_wy << 8) / sum_w) : (uint16_t)((cols - 1) << 7);
+    f->motion_mm = n_delta ? (uint16_t)(sum_delta / n_delta) : 0;
+
+    __atomic_store_n(&zone_front, back, __ATOMIC_RELEASE);
+}
+
+const vl53_zone_map_t *vl53_zones_get_map(void) {
+    return &zone_map[__atomic_load_n(&zone_front, __ATOMIC_ACQUIRE)];
+}
+
+const vl53_features_t *vl53_zones_get_features(void) {
+    return &zone_feat[__atomic_load_n(&zone_front, __ATOMIC_ACQUIRE)];
+}
+
+/**
+ * Map the latest features to pattern modulation inputs:
+ *  nearest distance -> brightness (near = bright)
+ *  motion           -> speed (still = normal rate, moving = up to 2x)
+ *  centroid column  -> hue rotation
+ * Returns inactive (neutral) modulation with no frame or a stale frame.
+ */
+void vl53_zones_get_modulation(pattern_mod_t *mod, uint32_t now_us) {
+    const vl53_features_t *f = vl53_zones_get_features();
+    const vl53_zone_map_t *map = vl53_zones_get_map();
+    uint32_t cols = (map->zones == 16) ? 4 : 8;
+
+    mod->active = 0;
+    mod->speed = 128;
+    mod->brightness = 255;
+    mod->hue = 0;
+
+    if (!f->seq || (now_us - f->time_us) > VL53_ZONES_STALE_US)
+        return;
+
+    mod->active = 1;
+
+    if (!f->valid_zones) {
+        mod->brightness = 64;       // nobody in front, dim idle level
+        return;
+    }
+
+    uint32_t m = (uint32_t)f->motion_mm * 2u;
+    mod->speed = (uint8_t)(128u + (m > 127u ? 127u : m));
+    mod->brightness = (uint8_t)(64u + 191u * (uint32_t)(VL53_RANGE_MAX_MM - f->nearest_mm) / VL53_RANGE_MAX_MM);
+    mod->hue = (uint8_t)(((uint32_t)f->centroid_x_q8 * 255u) / ((cols - 1) << 8));
+}
+
+int vl53_zones_show(char *msg, size_t msg_max_sz) {
+    const vl53_features_t *f = vl53_zones_get_features();
+    const vl53_zone_map_t *map = vl53_zones_get_map();
+    uint32_t cols = (map->zones == 16) ? 4 : 8;
+    char *cursor = msg;
+    size_t remaining = msg_max_sz;
+
+    msg_printf(&cursor, &remaining,
+        "VL53 frame %u: %u valid zones, nearest %u mm (zone %u)\r\n"
+        "  centroid x=%u.%02u y=%u.%02u  motion %u mm/frame\r\n",
+        f->seq, f->valid_zones, f->nearest_mm, f->nearest_zone,
+        f->centroid_x_q8 >> 8, ((f->centroid_x_q8 & 0xFF) * 100) >> 8,
+        f->centroid_y_q8 >> 8, ((f->centroid_y_q8 & 0xFF) * 100) >> 8,
+        f->motion_mm);
+
+    for (uint32_t z = 0; z < map->zones; z++) {
+        msg_printf(&cursor, &remaining, "%5d%s", map->distance_mm[z],
+                   (z % cols == cols - 1) ? "\r\n" : "");
+    }
+
+    return (int)(msg_max_sz - remaining);
+}
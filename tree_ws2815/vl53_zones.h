@@ -0,0 +1,54 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "led_pattern.h"
+
+#define VL53_ZONES_MAX      64      // 8x8
+#define VL53_RANGE_MAX_MM   4000    // longest distance taken into account
+#define VL53_ZONES_STALE_US 500000  // modulation falls back to neutral after this
+
+/**
+ * One ranging frame as seen by the application.
+ * Zones with an unusable target_status hold distance 0.
+ */
+typedef struct {
+    int16_t  distance_mm[VL53_ZONES_MAX];
+    uint64_t valid;             // bit per zone
+    uint8_t  zones;             // 16 or 64
+    uint32_t seq;               // frame counter, 0 = no frame yet
+    uint32_t time_us;           // time of publish
+} vl53_zone_map_t;
+
+/**
+ * Features computed while publishing, against the previous frame.
+ * Centroid is weighted by closeness, so a hand near the sensor dominates.
+ */
+typedef struct {
+    uint32_t seq;
+    uint32_t time_us;
+    uint16_t nearest_mm;        // 0 when no zone is valid
+    uint8_t  nearest_zone;
+    uint8_t  valid_zones;
+    uint16_t centroid_x_q8;     // column 0..cols-1, 8 fractional bits
+    uint16_t centroid_y_q8;     // row 0..cols-1, 8 fractional bits
+    uint16_t motion_mm;         // mean |delta| over zones valid in both frames
+    int16_t  delta_mm[VL53_ZONES_MAX];
+} vl53_features_t;
+
+void vl53_zones_publish(const int16_t *distance_mm, const uint8_t *target_status,
+                        uint8_t zones, uint32_t time_us);
+
+const vl53_zone_map_t *vl53_zones_get_map(void);
+const vl53_features_t *vl53_zones_get_features(void);
+
+void vl53_zones_get_modulation(pattern_mod_t *mod, uint32_t now_us);
+
+int vl53_zones_show(char *msg, size_t msg_max_sz);
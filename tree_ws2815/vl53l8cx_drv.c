@@ -12,11 +12,13 @@
 #include "vl53l8cx_drv.h"
 #include "vl53l8cx_platform.h"
 #include "vl53l8cx_api.h"   // ST ULD
+#include "vl53_zones.h"
 
 // ===== ST device instance =====
 static vl53l8cx_dev_t dev;
 static vl53l8cx_dev_t *p_dev = &dev;
 static bool ranging_active = false;
+static uint8_t ranging_zones = VL53L8CX_RESOLUTION_4X4;   // 16 or 64, read at start
 
 // Optional: expose results later via getter
 // static vl53l8cx_results_data_t last_results;
@@ -81,6 +83,9 @@ bool vl53l8cx_init_driver(void)
 
 bool vl53l8cx_start_drv_ranging(void)
 {
+    if (vl53l8cx_get_resolution(p_dev, &ranging_zones) != VL53L8CX_STATUS_OK)
+        return false;
+
     if (vl53l8cx_start_ranging(p_dev) != VL53L8CX_STATUS_OK)
         return false;
 
@@ -124,6 +129,20 @@ void vl53l8cx_loop(void)
     // Clear interrupt inside sensor - done automatically above when get ranging data
     // vl53l8cx_clear_interrupt(&dev);
 
+    // copy results to application buffer, pattern loop picks up the new frame
+    vl53_zones_publish(vl53_results.distance_mm, vl53_results.target_status,
+                       ranging_zones, time_us_32());
+
+    #ifdef _VL53_CSV_DEBUG_
+    // one line per frame, format read by tools/pattern_render/vl53_replay
+    printf("Z,%u,%u", to_ms_since_boot(get_absolute_time()), ranging_zones);
+    for (uint8_t z = 0; z < ranging_zones; z++)
+        printf(",%d", vl53_results.distance_mm[z]);
+    for (uint8_t z = 0; z < ranging_zones; z++)
+        printf(",%u", vl53_results.target_status[z]);
+    printf("\n");
+    #endif // _VL53_CSV_DEBUG_
+
     // 1sec = 1000000
     current_time = get_absolute_time();
     if (absolute_time_diff_us(last_time, current_time) > 300000) {
@@ -137,10 +156,6 @@ void vl53l8cx_loop(void)
         //     use distance
         // else
         //     ignore
-
-    // TODO:
-    // - copy results to application buffer
-    // - signal new frame available
 }
 
 
@@ -16,6 +16,12 @@
 #include "ws2815_control_dma.h"
 #include "ws2815.pio.h"
 #include "led_pattern.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "dlog.h"
+#ifdef VL53L8CX_DEV
+#include "vl53_zones.h"
+#endif // VL53L8CX_DEV
 
 // const float ws_freq = 700000.0f;   //
 // const float ws_freq = 800000.0f;   // WS2815 = 800 kHz nominal, shuld work 1000000.0f too
@@ -76,6 +82,15 @@ uint32_t max_led = NUM_PIXELS;
 // LED framebuffer
 uint32_t ws2815_buf[NUM_PIXELS];      // LED buffer
 
+#ifdef VL53L8CX_DEV
+// patterns render here, ws2815_buf gets the sensor-modulated copy
+static uint32_t pattern_buf[NUM_PIXELS];
+static bool sensor_modulation = false;
+#define PATTERN_BUF pattern_buf
+#else
+#define PATTERN_BUF ws2815_buf
+#endif // VL53L8CX_DEV
+
 
 
 // --- for WS2815 ---
@@ -101,6 +116,7 @@ typedef struct {
     int      dma_ch;
     volatile bool dma_done;
     volatile bool refresh;
+    uint32_t dma_start_us;     // TLM_DMA_US
 
     absolute_time_t latch_deadline;
 } ws_strip_t;
@@ -146,6 +162,7 @@ volatile bool ws2815_dma_done = true;
 
 // Latch timing
 absolute_time_t ws2815_latch_deadline;
+static uint32_t ws2815_dma_start_us;    // TLM_DMA_US
 #endif // WS2815_PARALLEL
 
 
@@ -166,6 +183,8 @@ void __isr ws2815_dma_irq_handler(void)
             dma_hw->ints0 = 1u << s->dma_ch;   // clear IRQ
             s->dma_done = true;
             s->latch_deadline = make_timeout_time_us(350);
+            tlm_sample(TLM_DMA_US, time_us_32() - s->dma_start_us);
+            TRACE_ASYNC_END(TR_DMA, (uint32_t)i, 0);
         }
     }
 }
@@ -178,6 +197,8 @@ void __isr dma_handler_ws2815(void)
 {
     dma_hw->ints0 = 1u << ws2815_dma_ch;   // clear interrupt
     ws2815_dma_done = true;
+    tlm_sample(TLM_DMA_US, time_us_32() - ws2815_dma_start_us);
+    TRACE_ASYNC_END(TR_DMA, 0, 0);
 
     // schedule latch (WS2815 requires 280–300 µs LOW)
     ws2815_latch_deadline = make_timeout_time_us(350);
@@ -256,6 +277,8 @@ void ws2815_start_dma(ws_strip_t *s)
     if (!s->dma_done) return;
 
     s->dma_done = false;
+    s->dma_start_us = time_us_32();
+    TRACE_ASYNC_BEGIN(TR_DMA, (uint32_t)(s - strips), s->led_count);
 
     dma_channel_set_read_addr(s->dma_ch, s->buf, false);
     dma_channel_set_trans_count(s->dma_ch, s->led_count, true);
@@ -301,6 +324,8 @@ void ws2815_start_dma_write(uint led_count)
     if (!ws2815_dma_done) return;   // still busy
 
     ws2815_dma_done = false;
+    ws2815_dma_start_us = time_us_32();
+    TRACE_ASYNC_BEGIN(TR_DMA, 0, led_count);
 
     dma_channel_set_read_addr((uint)ws2815_dma_ch, ws2815_buf, false);
     dma_channel_set_trans_count((uint)ws2815_dma_ch, led_count, true);
@@ -408,7 +433,29 @@ void ws2815_pattern_loop(uint32_t period_ms) {
                 // printf("Pattern %d=%s dir:%s\n", pat + 1, pattern_table[pat].name, dir == 1 ? "(forward)" : dir ? "(backward)" : "(still)");
                 printf("Pattern %d=%s\n", pat + 1, pattern_table[pat].name);
             } 
-            pattern_table[pat].pat(ws2815_buf, max_led, (int)1);
+            uint32_t t_render = time_us_32();
+            TRACE_BEGIN(TR_RENDER, (uint32_t)pat, 0);
+            #ifdef VL53L8CX_DEV
+            pattern_mod_t mod = { 0 };
+            static uint16_t speed_acc = 0;
+            uint32_t steps = 1;
+
+            if (sensor_modulation)
+                vl53_zones_get_modulation(&mod, time_us_32());
+            if (mod.active) {
+                // speed 128 = one pattern step per render, 255 ~ two
+                speed_acc = (uint16_t)(speed_acc + mod.speed);
+                steps = speed_acc >> 7;
+                speed_acc &= 0x7F;
+            }
+            while (steps--)
+                pattern_table[pat].pat(PATTERN_BUF, max_led, (int)1);
+            led_pattern_modulate(ws2815_buf, PATTERN_BUF, max_led, &mod);
+            #else
+            pattern_table[pat].pat(PATTERN_BUF, max_led, (int)1);
+            #endif // VL53L8CX_DEV
+            TRACE_END(TR_RENDER, (uint32_t)pat, 0);
+            tlm_sample(TLM_RENDER_US, time_us_32() - t_render);
         } else {
             // pattern_warm_white_with_sparks(ws2815_buf, max_led, (int)1);
             if (zero_counter) {
@@ -431,6 +478,20 @@ void ws2815_pattern_loop(uint32_t period_ms) {
 }
 
 
+/**
+ * LED frame rate for the telemetry: frames and the gap between them
+ */
+static void frame_started(void)
+{
+    static uint32_t last_us;
+    uint32_t now = time_us_32();
+
+    if (last_us)
+        tlm_sample(TLM_FRAME_GAP_US, now - last_us);
+    last_us = now;
+    tlm_count(TLM_LED_FRAMES, 1);
+}
+
 /**
  * DMA controlled WS2815 output loop
  */
@@ -438,6 +499,8 @@ void ws2815_loop(uint32_t period_ms)
 {
     (void)period_ms;
 #ifdef WS2815_PARALLEL
+    bool started = false;
+
     for (int i = 0; i < NUM_STRIPS; i++) {
         ws_strip_t *s = &strips[i];
 
@@ -452,7 +515,10 @@ void ws2815_loop(uint32_t period_ms)
 
         s->refresh = false;
         ws2815_start_dma(s);
+        started = true;
     }
+    if (started)
+        frame_started();
 #else
     if (!ws2815_dma_done)
         return;     // still transmitting frame
@@ -466,6 +532,7 @@ void ws2815_loop(uint32_t period_ms)
     ws2815_refresh_required = false;
 
     ws2815_start_dma_write(NUM_PIXELS);
+    frame_started();
 #endif // WS2815_PARALLEL
 }
 
@@ -493,6 +560,8 @@ void ws2815_show(uint8_t *fb) {
     input_byte = fb;
     // pixel = &framebuf[0];
 
+    uint32_t t_encode = time_us_32();
+    TRACE_BEGIN(TR_ENCODE, NUM_PIXELS, 0);
     for (id = 0; id < NUM_PIXELS; id++) {
         r = *input_byte++;
         g = *input_byte++;
@@ -500,6 +569,8 @@ void ws2815_show(uint8_t *fb) {
         // color = (r << 24) | (g << 16) | (b << 8);
         ws2815_buf[id] = (r << 24) | (g << 16) | (b << 8);
     }
+    TRACE_END(TR_ENCODE, NUM_PIXELS, 0);
+    tlm_sample(TLM_ENCODE_US, time_us_32() - t_encode);
   
 #ifdef WS2815_PARALLEL
     // convert from linear buffer to buffers for each strip
@@ -513,7 +584,7 @@ void ws2815_show(uint8_t *fb) {
     // ddp_update_framebuf = true;
     ddp_update_timeout = DDP_COM_TIMEOUT_MS;
     // printf("Framebuf recieved. Value pixel[0]=%#04x,%#04x,%#04x pixel[1]=%#04x,%#04x,%#04x\n", sb[0][0], sb[0][1], sb[0][2], sb[1][0], sb[1][1], sb[1][2]);
-    printf("Framebuf recieved.\n");
+    DLOG_EVERY(1000, "Framebuf recieved.\n");
 }
 
 
@@ -533,6 +604,15 @@ void set_max_led(uint32_t max) {
         max_led = NUM_PIXELS;
 }
 
+#ifdef VL53L8CX_DEV
+void set_sensor_modulation(bool on) {
+    sensor_modulation = on;
+}
+bool get_sensor_modulation(void) {
+    return sensor_modulation;
+}
+#endif // VL53L8CX_DEV
+
 uint8_t set_pattern_index(uint8_t index) {
     if (index > count_of(pattern_table))
         pattern_index = PAT_AUTO;
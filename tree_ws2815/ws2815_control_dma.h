@@ -8,6 +8,7 @@
 #define WS2815_CONTROL_DMA_PARALLEL_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 void ws2815_init(void);
 void ws2815_pattern_loop(uint32_t period_ms);
@@ -19,4 +20,8 @@ uint8_t get_pattern_index(void);
 void set_rgb(uint8_t r, uint8_t g, uint8_t b);
 void set_max_led(uint32_t max);
 
+// VL53 zone features modulate speed/brightness/hue of the running pattern
+void set_sensor_modulation(bool on);
+bool get_sensor_modulation(void);
+
 #endif /* WS2815_CONTROL_DMA_PARALLEL_H */